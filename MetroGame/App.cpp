@@ -117,6 +117,8 @@ void App::Load(Platform::String^ entryPoint)
 	if (m_main == nullptr)
 	{
 		m_main = std::unique_ptr<DXFrameworkMain>(new DXFrameworkMain(m_deviceResources));
+		m_main->ApplyLaunchArguments(m_launchArguments);
+		m_launchArguments.clear();
 	}
 }
 
@@ -167,6 +169,17 @@ void App::Uninitialize()
 
 void App::OnActivated(CoreApplicationView^ applicationView, IActivatedEventArgs^ args)
 {
+	// e.g. a benchmark run
+	if (args->Kind == ActivationKind::Launch)
+	{
+		m_launchArguments = static_cast<LaunchActivatedEventArgs^>(args)->Arguments->Data();
+		if (m_main != nullptr)
+		{
+			m_main->ApplyLaunchArguments(m_launchArguments);
+			m_launchArguments.clear();
+		}
+	}
+
 	// Run() won't start until the CoreWindow is activated.
 	CoreWindow::GetForCurrentThread()->Activate();
 }
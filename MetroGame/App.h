@@ -46,6 +46,7 @@ namespace DXFramework
 	private:
 		std::shared_ptr<DX::DeviceResources> m_deviceResources;
 		std::unique_ptr<DXFrameworkMain> m_main;
+		std::wstring m_launchArguments;	// Until m_main exists
 		bool m_windowClosed;
 		bool m_windowVisible;
 
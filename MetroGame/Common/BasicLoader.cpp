@@ -11,6 +11,7 @@
 
 #include "DDSTextureLoader.h"
 #include "DirectXHelper.h"
+#include "Profiler.h"
 #include <collection.h>
 #include <memory>
 
@@ -117,6 +118,8 @@ void BasicLoader::CreateTexture(
     Platform::String^ debugName
     )
 {
+    DX_PROFILE_ZONE("BasicLoader::CreateTexture");
+
     ComPtr<ID3D11ShaderResourceView> shaderResourceView;
     ComPtr<ID3D11Texture2D> texture2D;
 
@@ -293,6 +296,8 @@ void BasicLoader::CreateInputLayout(
     ID3D11InputLayout** layout
     )
 {
+    DX_PROFILE_ZONE("BasicLoader::CreateInputLayout");
+
     if (layoutDesc == nullptr)
     {
         // If no input layout is specified, use the BasicVertex layout.
@@ -436,6 +441,8 @@ void BasicLoader::LoadTextureArray(
 	ID3D11ShaderResourceView** textureView
 	)
 {
+	DX_PROFILE_ZONE("BasicLoader::LoadTextureArray");
+
 	//
 	// Load the texture elements individually from file.  These textures
 	// won't be used by the GPU (0 bind flags), they are just used to 
@@ -0,0 +1,391 @@
+#include "BoundingVolumeHierarchy.h"
+#include <algorithm>
+#include <float.h>
+#include <limits.h>
+#include <string.h>
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+	const UINT InvalidNode = UINT_MAX;
+	// Frustums per walk, so that their planes fit in one 64 bit mask.
+	const UINT MaxFrustumsPerWalk = 8;
+
+	float HalfArea(const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		float x = max.x - min.x, y = max.y - min.y, z = max.z - min.z;
+		return x * y + y * z + z * x;
+	}
+
+	void Grow(XMFLOAT3& min, XMFLOAT3& max, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+	{
+		min.x = (std::min)(min.x, boxMin.x); min.y = (std::min)(min.y, boxMin.y); min.z = (std::min)(min.z, boxMin.z);
+		max.x = (std::max)(max.x, boxMax.x); max.y = (std::max)(max.y, boxMax.y); max.z = (std::max)(max.z, boxMax.z);
+	}
+
+	void Reset(XMFLOAT3& min, XMFLOAT3& max)
+	{
+		min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	}
+
+	float Axis(const XMFLOAT3& v, int axis)
+	{
+		return (&v.x)[axis];
+	}
+
+	// Distance at which the ray enters the box, or FLT_MAX if it misses it.
+	float RayBox(FXMVECTOR origin, FXMVECTOR invDirection, const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&min), origin), invDirection);
+		XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&max), origin), invDirection);
+		XMFLOAT3 lo, hi;
+		XMStoreFloat3(&lo, XMVectorMin(t0, t1));
+		XMStoreFloat3(&hi, XMVectorMax(t0, t1));
+		float enter = (std::max)((std::max)(lo.x, lo.y), (std::max)(lo.z, 0.0f));
+		float exit = (std::min)((std::min)(hi.x, hi.y), hi.z);
+		return enter <= exit ? enter : FLT_MAX;
+	}
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+}
+
+void BoundingVolumeHierarchy::Clear()
+{
+	m_nodes.clear();
+	m_parents.clear();
+	m_items.clear();
+	m_leaves.clear();
+	m_boxes.clear();
+}
+
+void BoundingVolumeHierarchy::Build(const std::vector<BoundingBox>& boxes)
+{
+	Clear();
+	UINT count = (UINT)boxes.size();
+	if (count == 0)
+		return;
+
+	m_boxes.resize(count);
+	std::vector<XMFLOAT3> centroids(count);
+	for (UINT i = 0; i < count; ++i)
+	{
+		const BoundingBox& box = boxes[i];
+		m_boxes[i].Min = XMFLOAT3(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+		m_boxes[i].Max = XMFLOAT3(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+		centroids[i] = box.Center;
+	}
+
+	m_items.resize(count);
+	for (UINT i = 0; i < count; ++i)
+		m_items[i] = i;
+	m_leaves.resize(count);
+	m_nodes.reserve(2 * count);
+	m_parents.reserve(2 * count);
+	BuildNode(InvalidNode, 0, count, centroids);
+}
+
+UINT BoundingVolumeHierarchy::BuildNode(UINT parent, UINT begin, UINT end, const std::vector<XMFLOAT3>& centroids)
+{
+	UINT index = (UINT)m_nodes.size();
+	m_nodes.push_back(Node());
+	m_parents.push_back(parent);
+
+	Node node;
+	XMFLOAT3 centroidMin, centroidMax;
+	Reset(node.Min, node.Max);
+	Reset(centroidMin, centroidMax);
+	for (UINT i = begin; i < end; ++i)
+	{
+		UINT item = m_items[i];
+		Grow(node.Min, node.Max, m_boxes[item].Min, m_boxes[item].Max);
+		Grow(centroidMin, centroidMax, centroids[item], centroids[item]);
+	}
+
+	// Bin the centroids along every axis and take the split with the lowest
+	// sum of area times item count on both sides.
+	int bestAxis = -1;
+	UINT bestSplit = 0;
+	float bestCost = FLT_MAX;
+	if (end - begin > MaxLeafSize)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float origin = Axis(centroidMin, axis);
+			float extent = Axis(centroidMax, axis) - origin;
+			if (extent <= 0.0f)
+				continue;
+			float scale = BinCount / extent;
+
+			UINT binCounts[BinCount] = {};
+			Bounds bins[BinCount];
+			for (UINT b = 0; b < BinCount; ++b)
+				Reset(bins[b].Min, bins[b].Max);
+			for (UINT i = begin; i < end; ++i)
+			{
+				UINT item = m_items[i];
+				UINT b = (std::min)(BinCount - 1, (UINT)((Axis(centroids[item], axis) - origin) * scale));
+				++binCounts[b];
+				Grow(bins[b].Min, bins[b].Max, m_boxes[item].Min, m_boxes[item].Max);
+			}
+
+			// rightCost[b] is the cost of bins b and above.
+			float rightCost[BinCount];
+			XMFLOAT3 min, max;
+			Reset(min, max);
+			UINT rightCount = 0;
+			for (UINT b = BinCount - 1; b > 0; --b)
+			{
+				rightCount += binCounts[b];
+				Grow(min, max, bins[b].Min, bins[b].Max);
+				rightCost[b] = rightCount ? rightCount * HalfArea(min, max) : FLT_MAX;
+			}
+
+			Reset(min, max);
+			UINT leftCount = 0;
+			for (UINT b = 1; b < BinCount; ++b)
+			{
+				leftCount += binCounts[b - 1];
+				Grow(min, max, bins[b - 1].Min, bins[b - 1].Max);
+				if (leftCount == 0 || rightCost[b] == FLT_MAX)
+					continue;
+				float cost = leftCount * HalfArea(min, max) + rightCost[b];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+	}
+
+	// Small nodes and items sharing one centroid become leaves.
+	if (bestAxis < 0)
+	{
+		node.Offset = begin;
+		node.Count = end - begin;
+		m_nodes[index] = node;
+		for (UINT i = begin; i < end; ++i)
+			m_leaves[m_items[i]] = index;
+		return index;
+	}
+
+	float origin = Axis(centroidMin, bestAxis);
+	float scale = BinCount / (Axis(centroidMax, bestAxis) - origin);
+	UINT mid = (UINT)(std::partition(m_items.begin() + begin, m_items.begin() + end, [&](UINT item)
+	{
+		return (std::min)(BinCount - 1, (UINT)((Axis(centroids[item], bestAxis) - origin) * scale)) < bestSplit;
+	}) - m_items.begin());
+
+	BuildNode(index, begin, mid, centroids);
+	node.Offset = BuildNode(index, mid, end, centroids);
+	node.Count = 0;
+	m_nodes[index] = node;
+	return index;
+}
+
+bool BoundingVolumeHierarchy::FitNode(UINT index)
+{
+	Node& node = m_nodes[index];
+	XMFLOAT3 min, max;
+	Reset(min, max);
+	if (node.Count)
+	{
+		for (UINT i = node.Offset; i < node.Offset + node.Count; ++i)
+			Grow(min, max, m_boxes[m_items[i]].Min, m_boxes[m_items[i]].Max);
+	}
+	else
+	{
+		Grow(min, max, m_nodes[index + 1].Min, m_nodes[index + 1].Max);
+		Grow(min, max, m_nodes[node.Offset].Min, m_nodes[node.Offset].Max);
+	}
+
+	if (memcmp(&min, &node.Min, sizeof(min)) == 0 && memcmp(&max, &node.Max, sizeof(max)) == 0)
+		return false;
+	node.Min = min;
+	node.Max = max;
+	return true;
+}
+
+void BoundingVolumeHierarchy::Refit(UINT i, const BoundingBox& box)
+{
+	m_boxes[i].Min = XMFLOAT3(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+	m_boxes[i].Max = XMFLOAT3(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+
+	// Stop at the first ancestor which keeps its bounds.
+	for (UINT node = m_leaves[i]; node != InvalidNode && FitNode(node); node = m_parents[node]);
+}
+
+void BoundingVolumeHierarchy::Query(const FrustumCuller& frustum, std::vector<UINT>& visible)const
+{
+	Query(&frustum, 1, &visible);
+}
+
+void BoundingVolumeHierarchy::Query(const FrustumCuller* frustums, UINT count, std::vector<UINT>* visible)const
+{
+	for (UINT first = 0; first < count; first += MaxFrustumsPerWalk)
+	{
+		UINT walkCount = (std::min)(count - first, MaxFrustumsPerWalk);
+		for (UINT f = 0; f < walkCount; ++f)
+			visible[first + f].clear();
+		if (m_nodes.empty())
+			continue;
+
+		UINT live = (1u << walkCount) - 1;
+		uint64_t planes = (1ull << (walkCount * 6)) - 1;
+		QueryNode(0, frustums + first, walkCount, live, planes, visible + first);
+		for (UINT f = 0; f < walkCount; ++f)
+			std::sort(visible[first + f].begin(), visible[first + f].end());
+	}
+}
+
+// live has a bit for every frustum which may still see the node, planes has six
+// bits per frustum for the planes the parent wasn't completely inside of.
+void BoundingVolumeHierarchy::QueryNode(UINT index, const FrustumCuller* frustums, UINT count, UINT live, uint64_t planes,
+	std::vector<UINT>* visible)const
+{
+	const Node& node = m_nodes[index];
+	XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&node.Min), XMLoadFloat3(&node.Max)), 0.5f);
+	XMVECTOR extents = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&node.Max), XMLoadFloat3(&node.Min)), 0.5f);
+
+	for (UINT f = 0; f < count; ++f)
+	{
+		if (!(live & (1u << f)))
+			continue;
+		const XMFLOAT4* p = frustums[f].GetPlanes();
+		for (UINT k = 0; k < 6; ++k)
+		{
+			uint64_t bit = 1ull << (f * 6 + k);
+			if (!(planes & bit))
+				continue;
+			XMVECTOR plane = XMLoadFloat4(&p[k]);
+			float distance = XMVectorGetX(XMPlaneDotCoord(plane, center));
+			float radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(plane), extents));
+			if (distance < -radius)
+			{
+				live &= ~(1u << f);
+				break;
+			}
+			if (distance >= radius)
+				planes &= ~bit;
+		}
+	}
+	if (!live)
+		return;
+
+	if (node.Count == 0)
+	{
+		QueryNode(index + 1, frustums, count, live, planes, visible);
+		QueryNode(node.Offset, frustums, count, live, planes, visible);
+		return;
+	}
+
+	for (UINT i = node.Offset; i < node.Offset + node.Count; ++i)
+	{
+		UINT item = m_items[i];
+		const Bounds& box = m_boxes[item];
+		XMVECTOR itemCenter = XMVectorScale(XMVectorAdd(XMLoadFloat3(&box.Min), XMLoadFloat3(&box.Max)), 0.5f);
+		XMVECTOR itemExtents = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&box.Max), XMLoadFloat3(&box.Min)), 0.5f);
+		for (UINT f = 0; f < count; ++f)
+		{
+			if (!(live & (1u << f)))
+				continue;
+			const XMFLOAT4* p = frustums[f].GetPlanes();
+			bool inside = true;
+			for (UINT k = 0; k < 6 && inside; ++k)
+			{
+				if (!(planes & (1ull << (f * 6 + k))))
+					continue;
+				XMVECTOR plane = XMLoadFloat4(&p[k]);
+				float distance = XMVectorGetX(XMPlaneDotCoord(plane, itemCenter));
+				float radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(plane), itemExtents));
+				inside = distance >= -radius;
+			}
+			if (inside)
+				visible[f].push_back(item);
+		}
+	}
+}
+
+bool BoundingVolumeHierarchy::RayCast(FXMVECTOR origin, FXMVECTOR direction, UINT& item, float& distance,
+	const std::function<bool(UINT item, float& distance)>& test)const
+{
+	item = UINT_MAX;
+	distance = FLT_MAX;
+	if (m_nodes.empty())
+		return false;
+
+	// Axis parallel rays divide by a tiny value instead of zero, so that no slab gives NaN.
+	XMVECTOR tiny = XMVectorReplicate(1e-20f);
+	XMVECTOR d = XMVectorSelect(direction, XMVectorOrInt(tiny, XMVectorAndInt(direction, XMVectorSplatSignMask())),
+		XMVectorLess(XMVectorAbs(direction), tiny));
+	RayCastNode(0, origin, XMVectorReciprocal(d), item, distance, test);
+	return item != UINT_MAX;
+}
+
+void BoundingVolumeHierarchy::RayCastNode(UINT index, FXMVECTOR origin, FXMVECTOR invDirection, UINT& item, float& distance,
+	const std::function<bool(UINT item, float& distance)>& test)const
+{
+	const Node& node = m_nodes[index];
+	if (node.Count == 0)
+	{
+		// The nearer child first, so that the farther one is often skipped.
+		UINT children[2] = { index + 1, node.Offset };
+		float t[2];
+		for (int c = 0; c < 2; ++c)
+			t[c] = RayBox(origin, invDirection, m_nodes[children[c]].Min, m_nodes[children[c]].Max);
+		int first = t[1] < t[0] ? 1 : 0;
+		for (int k = 0; k < 2; ++k)
+		{
+			int c = k ? first ^ 1 : first;
+			if (t[c] < distance)
+				RayCastNode(children[c], origin, invDirection, item, distance, test);
+		}
+		return;
+	}
+
+	for (UINT i = node.Offset; i < node.Offset + node.Count; ++i)
+	{
+		UINT candidate = m_items[i];
+		float t = RayBox(origin, invDirection, m_boxes[candidate].Min, m_boxes[candidate].Max);
+		if (t >= distance)
+			continue;
+		if (test && (!test(candidate, t) || t >= distance))
+			continue;
+		item = candidate;
+		distance = t;
+	}
+}
+
+void FrustumQueryCache::Query(const BoundingVolumeHierarchy& bvh, const XMFLOAT4X4* viewProjs, UINT count)
+{
+	// The vectors only grow, so that the results of every frame reuse their memory.
+	m_count = count;
+	if (m_frustums.size() < count)
+	{
+		m_viewProjs.resize(count);
+		m_frustums.resize(count);
+		m_visible.resize(count);
+	}
+	for (UINT f = 0; f < count; ++f)
+	{
+		m_viewProjs[f] = viewProjs[f];
+		m_frustums[f].SetViewProj(viewProjs[f]);
+	}
+	bvh.Query(m_frustums.data(), count, m_visible.data());
+}
+
+const std::vector<UINT>* FrustumQueryCache::Find(const XMFLOAT4X4& viewProj)const
+{
+	for (UINT f = 0; f < m_count; ++f)
+	{
+		if (memcmp(&m_viewProjs[f], &viewProj, sizeof(viewProj)) == 0)
+			return &m_visible[f];
+	}
+	return nullptr;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <functional>
+#include <vector>
+#include "FrustumCuller.h"
+
+// Bounding volume hierarchy over the world space boxes of scene instances.
+// It is built with the surface area heuristic over binned centroids and stored
+// flattened in depth-first order: the left child of a node directly follows it,
+// so a walk down the left spine stays in the same cache lines. A moved item is
+// refitted in place up to the root; the tree is not restructured, so Build
+// again after most items moved far.
+// The translation unit doesn't use the precompiled header, so that the culling
+// tests build headless.
+
+namespace DX
+{
+	class BoundingVolumeHierarchy
+	{
+	public:
+		BoundingVolumeHierarchy();
+
+		void Build(const std::vector<DirectX::BoundingBox>& boxes);
+		void Clear();
+		// Changes the box of item i and enlarges or shrinks its ancestors.
+		void Refit(UINT i, const DirectX::BoundingBox& box);
+
+		// Clears visible and fills it with the items whose box intersects the frustum,
+		// in increasing order.
+		void Query(const FrustumCuller& frustum, std::vector<UINT>& visible)const;
+		// Same for count frustums in one walk, e.g. the faces of a cube map;
+		// visible[f] receives the items of frustums[f].
+		void Query(const FrustumCuller* frustums, UINT count, std::vector<UINT>* visible)const;
+
+		// Finds the closest item hit by the ray; direction must be normalized.
+		// The box is tested first, then test, if given, may reject the item or
+		// move the hit further by returning false or a larger distance.
+		bool RayCast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, UINT& item, float& distance,
+			const std::function<bool(UINT item, float& distance)>& test = nullptr)const;
+
+	public:
+		UINT GetItemCount()const { return (UINT)m_boxes.size(); }
+		UINT GetNodeCount()const { return (UINT)m_nodes.size(); }
+
+	private:
+		// 32 bytes. An inner node has Count 0 and Offset is its right child,
+		// a leaf holds Count items from m_items[Offset].
+		struct Node
+		{
+			DirectX::XMFLOAT3 Min;
+			UINT Offset;
+			DirectX::XMFLOAT3 Max;
+			UINT Count;
+		};
+
+		struct Bounds
+		{
+			DirectX::XMFLOAT3 Min;
+			DirectX::XMFLOAT3 Max;
+		};
+
+		UINT BuildNode(UINT parent, UINT begin, UINT end, const std::vector<DirectX::XMFLOAT3>& centroids);
+		bool FitNode(UINT node);
+		void QueryNode(UINT node, const FrustumCuller* frustums, UINT count, UINT live, uint64_t planes,
+			std::vector<UINT>* visible)const;
+		void RayCastNode(UINT node, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR invDirection, UINT& item, float& distance,
+			const std::function<bool(UINT item, float& distance)>& test)const;
+
+	private:
+		static const UINT BinCount = 16;
+		static const UINT MaxLeafSize = 4;
+
+		std::vector<Node> m_nodes;
+		std::vector<UINT> m_parents;
+		std::vector<UINT> m_items;
+		std::vector<UINT> m_leaves;		// Leaf of every item
+		std::vector<Bounds> m_boxes;
+	};
+
+	// The items inside the frustums of the passes of a frame, e.g. the shadow and the
+	// camera passes, found in one walk of the hierarchy. Each pass looks its frustum
+	// up by view-projection instead of walking the hierarchy again.
+	class FrustumQueryCache
+	{
+	public:
+		FrustumQueryCache() : m_count(0) {}
+
+		// viewProjs are the untransposed view-projection matrices of the passes.
+		void Query(const BoundingVolumeHierarchy& bvh, const DirectX::XMFLOAT4X4* viewProjs, UINT count);
+		// Forgets the results, e.g. after an item moved.
+		void Clear() { m_count = 0; }
+		// The items of the frustum of viewProj, in increasing order, or nullptr if it
+		// wasn't queried.
+		const std::vector<UINT>* Find(const DirectX::XMFLOAT4X4& viewProj)const;
+
+	private:
+		UINT m_count;
+		std::vector<DirectX::XMFLOAT4X4> m_viewProjs;
+		std::vector<FrustumCuller> m_frustums;
+		std::vector<std::vector<UINT>> m_visible;
+	};
+}
@@ -2,7 +2,6 @@
 // Camera.h by Frank Luna (C) 2011 All Rights Reserved.
 //***************************************************************************************
 
-#include "pch.h"
 #include "Camera.h"
 #include "MathHelper.h"
 
@@ -174,6 +173,20 @@ XMMATRIX Camera::ViewProj()const
 	return XMMatrixMultiply(View(), Proj());
 }
 
+void Camera::GetPickRay(float x, float y, float width, float height, XMVECTOR& origin, XMVECTOR& direction)const
+{
+	// Unproject the pixel on the near and far planes, so that the orientation
+	// folded into the projection is undone as well.
+	XMVECTOR det;
+	XMMATRIX invViewProj = XMMatrixInverse(&det, ViewProj());
+	float ndcX = 2.0f * x / width - 1.0f;
+	float ndcY = 1.0f - 2.0f * y / height;
+	XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), invViewProj);
+	XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), invViewProj);
+	origin = nearPoint;
+	direction = XMVector3Normalize(XMVectorSubtract(farPoint, nearPoint));
+}
+
 void Camera::Strafe(float d)
 {
 	// m_position += d*m_right
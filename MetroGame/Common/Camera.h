@@ -6,11 +6,14 @@
 //    so that the view matrix can be constructed.  
 //   -It keeps track of the viewing frustum of the camera so that the projection
 //    matrix can be obtained.
+//   -The translation unit doesn't use the precompiled header, so that the
+//    headless scene benchmark builds it.
 //***************************************************************************************
 
 #pragma once
 
-#include "DirectXHelper.h"
+#include <Windows.h>
+#include <DirectXMath.h>
 
 namespace DX
 {
@@ -60,6 +63,11 @@ namespace DX
 		DirectX::XMMATRIX Proj()const;
 		DirectX::XMMATRIX ViewProj()const;
 
+		// Get the world space ray through pixel (x, y) of a width x height target,
+		// for picking. direction is normalized.
+		void GetPickRay(float x, float y, float width, float height,
+			DirectX::XMVECTOR& origin, DirectX::XMVECTOR& direction)const;
+
 		// Strafe/Walk the camera a distance d.
 		void Strafe(float d);
 		void Walk(float d);
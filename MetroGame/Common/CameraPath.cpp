@@ -0,0 +1,85 @@
+#include "CameraPath.h"
+#include "MathHelper.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace DX;
+using namespace DirectX;
+
+CameraPath CameraPath::Orbit(const XMFLOAT3& center, float radius, float height, double seconds, UINT keyCount)
+{
+	keyCount = (std::max)(keyCount, 2u);
+	CameraPath path;
+	for (UINT k = 0; k < keyCount; ++k)
+	{
+		float t = (float)k / (keyCount - 1);
+		float angle = 2.0f * MathHelper::Pi * t;
+		XMFLOAT3 position(center.x + radius * sinf(angle), center.y + height, center.z - radius * cosf(angle));
+
+		Key key;
+		key.Time = seconds * t;
+		key.Position = position;
+		XMStoreFloat3(&key.Look, XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&center), XMLoadFloat3(&position))));
+		key.Up = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		path.m_keys.push_back(key);
+	}
+	return path;
+}
+
+void CameraPath::Record(double time, const Camera& camera)
+{
+	if (!m_keys.empty() && time <= m_keys.back().Time)
+		return;
+
+	Key key = { time, camera.GetPosition(), camera.GetLook(), camera.GetUp() };
+	m_keys.push_back(key);
+}
+
+void CameraPath::Apply(double time, Camera& camera)const
+{
+	if (m_keys.empty())
+		return;
+
+	// The last key at or before time, and the one after it.
+	auto next = std::upper_bound(m_keys.begin(), m_keys.end(), time, [](double t, const Key& key) { return t < key.Time; });
+	const Key& a = next == m_keys.begin() ? *next : *(next - 1);
+	const Key& b = next == m_keys.end() ? a : *next;
+	float s = b.Time > a.Time ? (float)((time - a.Time) / (b.Time - a.Time)) : 0.0f;
+	s = MathHelper::Clamp(s, 0.0f, 1.0f);
+
+	XMVECTOR position = XMVectorLerp(XMLoadFloat3(&a.Position), XMLoadFloat3(&b.Position), s);
+	XMVECTOR look = XMVector3Normalize(XMVectorLerp(XMLoadFloat3(&a.Look), XMLoadFloat3(&b.Look), s));
+	XMVECTOR up = XMVector3Normalize(XMVectorLerp(XMLoadFloat3(&a.Up), XMLoadFloat3(&b.Up), s));
+	camera.LookAt(position, XMVectorAdd(position, look), up);
+	camera.UpdateViewMatrix();
+}
+
+void CameraPath::Save(std::ostream& out)const
+{
+	out.precision(9);
+	for (const Key& key : m_keys)
+	{
+		out << key.Time << ' '
+			<< key.Position.x << ' ' << key.Position.y << ' ' << key.Position.z << ' '
+			<< key.Look.x << ' ' << key.Look.y << ' ' << key.Look.z << ' '
+			<< key.Up.x << ' ' << key.Up.y << ' ' << key.Up.z << '\n';
+	}
+}
+
+void CameraPath::Load(std::istream& in)
+{
+	std::vector<Key> keys;
+	Key key;
+	while (in >> key.Time
+		>> key.Position.x >> key.Position.y >> key.Position.z
+		>> key.Look.x >> key.Look.y >> key.Look.z
+		>> key.Up.x >> key.Up.y >> key.Up.z)
+	{
+		if (!keys.empty() && key.Time <= keys.back().Time)
+			throw std::invalid_argument("Camera path times must increase!");
+		keys.push_back(key);
+	}
+	if (!in.eof())
+		throw std::invalid_argument("Malformed camera path!");
+	m_keys.swap(keys);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Camera.h"
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace DX
+{
+	// Camera poses over time, recorded from a live camera or built, and replayed by
+	// interpolating between the poses around a time. Saved as text, one pose a line:
+	// time, position, look and up. The translation unit doesn't use the precompiled
+	// header.
+	class CameraPath
+	{
+	public:
+		struct Key
+		{
+			double Time;	// Seconds
+			DirectX::XMFLOAT3 Position;
+			DirectX::XMFLOAT3 Look;
+			DirectX::XMFLOAT3 Up;
+		};
+
+		// A circle around center at the given radius and height, looking at center.
+		static CameraPath Orbit(const DirectX::XMFLOAT3& center, float radius, float height, double seconds, UINT keyCount = 64);
+
+		// Appends the pose of camera; times must increase.
+		void Record(double time, const Camera& camera);
+		// Poses camera at time, clamped to the path, and rebuilds its view matrix.
+		void Apply(double time, Camera& camera)const;
+		void Clear() { m_keys.clear(); }
+
+		void Save(std::ostream& out)const;
+		void Load(std::istream& in);
+
+		bool IsEmpty()const { return m_keys.empty(); }
+		size_t GetKeyCount()const { return m_keys.size(); }
+		double GetDuration()const { return m_keys.empty() ? 0.0 : m_keys.back().Time - m_keys.front().Time; }
+
+	private:
+		std::vector<Key> m_keys;
+	};
+}
@@ -1,10 +1,14 @@
 #pragma once
 
-#include "DirectXHelper.h"
 #include "LightHelper.h"
+#include "RenderContext.h"
+#include "RenderDevice.h"
+#include <stdexcept>
+#include <wrl/client.h>
 
 //  brief Wrapper class for cbuffers that handles creation and updating
 //  for a fixed type specified by the template parameter T.
+//  Needs only the Direct3D 11 types and DirectXMath, so it builds headless.
 namespace DX
 {
 	// Constant buffers shared by multi renderers
@@ -96,10 +100,8 @@ namespace DX
 		bool GetInitalizeState() { return m_initialized; }
 
 		// Initializes the constant buffer.
-		void Initialize(ID3D11Device* device)
+		void Initialize(RenderDevice* device)
 		{
-			HRESULT hr = S_OK;
-
 			// Make constant buffer multiple of 16 bytes.
 			D3D11_BUFFER_DESC desc;
 			desc.Usage = D3D11_USAGE_DYNAMIC;
@@ -109,13 +111,14 @@ namespace DX
 			desc.ByteWidth = static_cast<UINT>(sizeof(T) + (16 - (sizeof(T) % 16)));
 			desc.StructureByteStride = 0;
 
-			DX::ThrowIfFailed(device->CreateBuffer(&desc, 0, m_buffer.GetAddressOf()));
+			if (FAILED(device->CreateBuffer(&desc, 0, m_buffer.GetAddressOf())))
+				throw std::runtime_error("Failed to create the constant buffer!");
 			m_initialized = true;
 		}
 
 		// Copies the system memory constant buffer data to the GPU constant buffer.
 		// This call should be made as infrequently as possible.
-		void ApplyChanges(ID3D11DeviceContext* dc)
+		void ApplyChanges(RenderContext* dc)
 		{
 			_ASSERT(m_initialized);
 
@@ -0,0 +1,99 @@
+#include "ConstantRingBuffer.h"
+#include <stdexcept>
+#include <string.h>
+
+using namespace DX;
+
+ConstantRingBuffer::ConstantRingBuffer() :
+	m_device(nullptr), m_byteWidth(0), m_head(0)
+{
+}
+
+void ConstantRingBuffer::Initialize(RenderDevice* device, UINT byteWidth)
+{
+	Reset();
+	m_device = device;
+	CreateBuffer(byteWidth);
+}
+
+void ConstantRingBuffer::Reset()
+{
+	m_buffer.Reset();
+	m_device = nullptr;
+	m_byteWidth = 0;
+	m_head = 0;
+	m_batch.clear();
+}
+
+void ConstantRingBuffer::CreateBuffer(UINT byteWidth)
+{
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = 0;
+	desc.ByteWidth = (byteWidth + Alignment - 1) / Alignment * Alignment;
+	desc.StructureByteStride = 0;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	if (FAILED(m_device->CreateBuffer(&desc, nullptr, buffer.GetAddressOf())))
+		throw std::runtime_error("Failed to create the constant ring buffer!");
+
+	m_buffer = buffer;
+	m_byteWidth = desc.ByteWidth;
+	m_head = m_byteWidth;
+}
+
+UINT ConstantRingBuffer::Allocate(const void* data, UINT size)
+{
+	UINT offset = (UINT)m_batch.size();
+	m_batch.resize(offset + (size + Alignment - 1) / Alignment * Alignment);
+	memcpy(m_batch.data() + offset, data, size);
+	return offset;
+}
+
+bool ConstantRingBuffer::Commit(RenderContext* context, UINT& base)
+{
+	UINT size = (UINT)m_batch.size();
+	if (size == 0)
+	{
+		base = m_head;
+		return true;
+	}
+	if (size > m_byteWidth)
+	{
+		UINT byteWidth = m_byteWidth;
+		while (byteWidth < size)
+			byteWidth *= 2;
+		CreateBuffer(byteWidth);
+	}
+
+	// What is after the head hasn't been written since the last discard.
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (m_head + size > m_byteWidth)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		m_head = 0;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(m_buffer.Get(), 0, mapType, 0, &mapped)))
+	{
+		m_batch.clear();
+		return false;
+	}
+	memcpy(static_cast<BYTE*>(mapped.pData) + m_head, m_batch.data(), size);
+	context->Unmap(m_buffer.Get(), 0);
+
+	base = m_head;
+	m_head += size;
+	m_batch.clear();
+	return true;
+}
+
+void ConstantRingBuffer::GetWindow(UINT offset, UINT size, UINT& firstConstant, UINT& numConstants)
+{
+	const UINT constantsPerAlignment = Alignment / 16;
+	firstConstant = offset / 16;
+	numConstants = ((size + 15) / 16 + constantsPerAlignment - 1) / constantsPerAlignment * constantsPerAlignment;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "RenderContext.h"
+#include "RenderDevice.h"
+#include <vector>
+#include <wrl/client.h>
+
+// One large dynamic constant buffer the constants of many draws are written to
+// with a single map, each at an offset bound as a window with SetConstantBuffers1.
+// Allocate copies a draw's constants into a batch and Commit writes the batch after
+// what was written before, mapping without overwriting, so that what the GPU still
+// reads stays; a batch that doesn't fit discards the buffer and starts from its
+// beginning, and one larger than the buffer grows it.
+// Needs the offsets of Direct3D 11.1, see SupportsConstantBufferOffsets. The
+// translation unit doesn't use the precompiled header.
+
+namespace DX
+{
+	class ConstantRingBuffer
+	{
+	public:
+		// Windows start at multiples of 16 constants.
+		static const UINT Alignment = 256;
+
+		ConstantRingBuffer();
+
+		// Creates the buffer; the device is kept to grow it.
+		void Initialize(RenderDevice* device, UINT byteWidth);
+		void Reset();
+
+		ID3D11Buffer* GetBuffer() const { return m_buffer.Get(); }
+		UINT GetByteWidth() const { return m_byteWidth; }
+
+		// Copies size bytes into the batch, returning their offset from its start, a
+		// multiple of Alignment.
+		UINT Allocate(const void* data, UINT size);
+		UINT GetBatchSize() const { return (UINT)m_batch.size(); }
+
+		// Writes the batch with one map and empties it. The allocations are at base plus
+		// their offsets. False if the map fails.
+		bool Commit(RenderContext* context, UINT& base);
+
+		// The window of size bytes at offset, in the constants SetConstantBuffers1 takes.
+		static void GetWindow(UINT offset, UINT size, UINT& firstConstant, UINT& numConstants);
+
+	private:
+		void CreateBuffer(UINT byteWidth);
+
+	private:
+		RenderDevice* m_device;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_buffer;
+		UINT m_byteWidth;
+		UINT m_head;			// Where the next batch goes; the end until the first discard
+		std::vector<BYTE> m_batch;
+	};
+}
@@ -0,0 +1,246 @@
+#include "pch.h"
+#include "D3D11RenderContext.h"
+
+using namespace DX;
+
+D3D11RenderContext::D3D11RenderContext(ID3D11DeviceContext1* context) :
+	m_context(context), m_constantBufferOffsets(false)
+{
+	// Ring buffered constants need both, from the 11.1 runtime and drivers.
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	m_context->GetDevice(&device);
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+		m_constantBufferOffsets = options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+}
+
+void D3D11RenderContext::SetShader(ShaderStage stage, ID3D11DeviceChild* shader)
+{
+	switch (stage)
+	{
+	case ShaderStage::Vertex:
+		m_context->VSSetShader(static_cast<ID3D11VertexShader*>(shader), nullptr, 0);
+		break;
+	case ShaderStage::Hull:
+		m_context->HSSetShader(static_cast<ID3D11HullShader*>(shader), nullptr, 0);
+		break;
+	case ShaderStage::Domain:
+		m_context->DSSetShader(static_cast<ID3D11DomainShader*>(shader), nullptr, 0);
+		break;
+	case ShaderStage::Geometry:
+		m_context->GSSetShader(static_cast<ID3D11GeometryShader*>(shader), nullptr, 0);
+		break;
+	case ShaderStage::Pixel:
+		m_context->PSSetShader(static_cast<ID3D11PixelShader*>(shader), nullptr, 0);
+		break;
+	case ShaderStage::Compute:
+		m_context->CSSetShader(static_cast<ID3D11ComputeShader*>(shader), nullptr, 0);
+		break;
+	}
+}
+
+void D3D11RenderContext::SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	switch (stage)
+	{
+	case ShaderStage::Vertex:
+		m_context->VSSetConstantBuffers(startSlot, numBuffers, buffers);
+		break;
+	case ShaderStage::Hull:
+		m_context->HSSetConstantBuffers(startSlot, numBuffers, buffers);
+		break;
+	case ShaderStage::Domain:
+		m_context->DSSetConstantBuffers(startSlot, numBuffers, buffers);
+		break;
+	case ShaderStage::Geometry:
+		m_context->GSSetConstantBuffers(startSlot, numBuffers, buffers);
+		break;
+	case ShaderStage::Pixel:
+		m_context->PSSetConstantBuffers(startSlot, numBuffers, buffers);
+		break;
+	case ShaderStage::Compute:
+		m_context->CSSetConstantBuffers(startSlot, numBuffers, buffers);
+		break;
+	}
+}
+
+void D3D11RenderContext::SetConstantBuffers1(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers,
+	const UINT* firstConstants, const UINT* numConstants)
+{
+	switch (stage)
+	{
+	case ShaderStage::Vertex:
+		m_context->VSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+		break;
+	case ShaderStage::Hull:
+		m_context->HSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+		break;
+	case ShaderStage::Domain:
+		m_context->DSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+		break;
+	case ShaderStage::Geometry:
+		m_context->GSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+		break;
+	case ShaderStage::Pixel:
+		m_context->PSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+		break;
+	case ShaderStage::Compute:
+		m_context->CSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+		break;
+	}
+}
+
+void D3D11RenderContext::SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	switch (stage)
+	{
+	case ShaderStage::Vertex:
+		m_context->VSSetShaderResources(startSlot, numViews, views);
+		break;
+	case ShaderStage::Hull:
+		m_context->HSSetShaderResources(startSlot, numViews, views);
+		break;
+	case ShaderStage::Domain:
+		m_context->DSSetShaderResources(startSlot, numViews, views);
+		break;
+	case ShaderStage::Geometry:
+		m_context->GSSetShaderResources(startSlot, numViews, views);
+		break;
+	case ShaderStage::Pixel:
+		m_context->PSSetShaderResources(startSlot, numViews, views);
+		break;
+	case ShaderStage::Compute:
+		m_context->CSSetShaderResources(startSlot, numViews, views);
+		break;
+	}
+}
+
+void D3D11RenderContext::SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	switch (stage)
+	{
+	case ShaderStage::Vertex:
+		m_context->VSSetSamplers(startSlot, numSamplers, samplers);
+		break;
+	case ShaderStage::Hull:
+		m_context->HSSetSamplers(startSlot, numSamplers, samplers);
+		break;
+	case ShaderStage::Domain:
+		m_context->DSSetSamplers(startSlot, numSamplers, samplers);
+		break;
+	case ShaderStage::Geometry:
+		m_context->GSSetSamplers(startSlot, numSamplers, samplers);
+		break;
+	case ShaderStage::Pixel:
+		m_context->PSSetSamplers(startSlot, numSamplers, samplers);
+		break;
+	case ShaderStage::Compute:
+		m_context->CSSetSamplers(startSlot, numSamplers, samplers);
+		break;
+	}
+}
+
+void D3D11RenderContext::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	m_context->IASetInputLayout(inputLayout);
+}
+
+void D3D11RenderContext::IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	m_context->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+}
+
+void D3D11RenderContext::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	m_context->IASetIndexBuffer(buffer, format, offset);
+}
+
+void D3D11RenderContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	m_context->IASetPrimitiveTopology(topology);
+}
+
+void D3D11RenderContext::SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets)
+{
+	m_context->SOSetTargets(numBuffers, targets, offsets);
+}
+
+void D3D11RenderContext::CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* views, const UINT* initialCounts)
+{
+	m_context->CSSetUnorderedAccessViews(startSlot, numViews, views, initialCounts);
+}
+
+void D3D11RenderContext::RSSetState(ID3D11RasterizerState* state)
+{
+	m_context->RSSetState(state);
+}
+
+void D3D11RenderContext::RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports)
+{
+	m_context->RSSetViewports(numViewports, viewports);
+}
+
+void D3D11RenderContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView)
+{
+	m_context->OMSetRenderTargets(numViews, views, depthStencilView);
+}
+
+void D3D11RenderContext::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+	m_context->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void D3D11RenderContext::OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef)
+{
+	m_context->OMSetDepthStencilState(state, stencilRef);
+}
+
+void D3D11RenderContext::ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4])
+{
+	m_context->ClearRenderTargetView(view, color);
+}
+
+void D3D11RenderContext::ClearDepthStencilView(ID3D11DepthStencilView* view, UINT clearFlags, FLOAT depth, UINT8 stencil)
+{
+	m_context->ClearDepthStencilView(view, clearFlags, depth, stencil);
+}
+
+HRESULT D3D11RenderContext::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped)
+{
+	return m_context->Map(resource, subresource, mapType, mapFlags, mapped);
+}
+
+void D3D11RenderContext::Unmap(ID3D11Resource* resource, UINT subresource)
+{
+	m_context->Unmap(resource, subresource);
+}
+
+void D3D11RenderContext::GenerateMips(ID3D11ShaderResourceView* view)
+{
+	m_context->GenerateMips(view);
+}
+
+void D3D11RenderContext::Draw(UINT vertexCount, UINT startVertex)
+{
+	m_context->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	m_context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderContext::DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+	m_context->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D11RenderContext::DrawAuto()
+{
+	m_context->DrawAuto();
+}
+
+void D3D11RenderContext::Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ)
+{
+	m_context->Dispatch(groupsX, groupsY, groupsZ);
+}
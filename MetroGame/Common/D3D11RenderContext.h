@@ -0,0 +1,52 @@
+#pragma once
+
+#include "RenderContext.h"
+
+namespace DX
+{
+	// Forwards every call to a Direct3D 11 device context, which must outlive it.
+	class D3D11RenderContext : public RenderContext
+	{
+	public:
+		explicit D3D11RenderContext(ID3D11DeviceContext1* context);
+
+		ID3D11DeviceContext* GetD3DDeviceContext() const { return m_context; }
+
+		virtual void SetShader(ShaderStage stage, ID3D11DeviceChild* shader);
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers);
+		virtual void SetConstantBuffers1(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers,
+			const UINT* firstConstants, const UINT* numConstants);
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views);
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers);
+
+		virtual void IASetInputLayout(ID3D11InputLayout* inputLayout);
+		virtual void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+		virtual void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+		virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+		virtual void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets);
+		virtual void CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* views, const UINT* initialCounts);
+		virtual void RSSetState(ID3D11RasterizerState* state);
+		virtual void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports);
+		virtual void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView);
+		virtual void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask);
+		virtual void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef);
+
+		virtual void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]);
+		virtual void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT clearFlags, FLOAT depth, UINT8 stencil);
+		virtual HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped);
+		virtual void Unmap(ID3D11Resource* resource, UINT subresource);
+		virtual void GenerateMips(ID3D11ShaderResourceView* view);
+
+		virtual void Draw(UINT vertexCount, UINT startVertex);
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+		virtual void DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+		virtual void DrawAuto();
+		virtual void Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ);
+
+		virtual bool SupportsConstantBufferOffsets() const { return m_constantBufferOffsets; }
+
+	private:
+		ID3D11DeviceContext1* m_context;
+		bool m_constantBufferOffsets;
+	};
+}
@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "D3D11RenderDevice.h"
+
+using namespace DX;
+
+D3D11RenderDevice::D3D11RenderDevice(ID3D11Device* device) :
+	m_device(device)
+{
+}
+
+HRESULT D3D11RenderDevice::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer)
+{
+	return m_device->CreateBuffer(desc, initialData, buffer);
+}
+
+HRESULT D3D11RenderDevice::CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture1D** texture)
+{
+	return m_device->CreateTexture1D(desc, initialData, texture);
+}
+
+HRESULT D3D11RenderDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture)
+{
+	return m_device->CreateTexture2D(desc, initialData, texture);
+}
+
+HRESULT D3D11RenderDevice::CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture)
+{
+	return m_device->CreateTexture3D(desc, initialData, texture);
+}
+
+HRESULT D3D11RenderDevice::CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc,
+	ID3D11ShaderResourceView** view)
+{
+	return m_device->CreateShaderResourceView(resource, desc, view);
+}
+
+HRESULT D3D11RenderDevice::CreateUnorderedAccessView(ID3D11Resource* resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC* desc,
+	ID3D11UnorderedAccessView** view)
+{
+	return m_device->CreateUnorderedAccessView(resource, desc, view);
+}
+
+HRESULT D3D11RenderDevice::CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc,
+	ID3D11RenderTargetView** view)
+{
+	return m_device->CreateRenderTargetView(resource, desc, view);
+}
+
+HRESULT D3D11RenderDevice::CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc,
+	ID3D11DepthStencilView** view)
+{
+	return m_device->CreateDepthStencilView(resource, desc, view);
+}
+
+HRESULT D3D11RenderDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT numElements,
+	const void* byteCode, SIZE_T byteCodeLength, ID3D11InputLayout** inputLayout)
+{
+	return m_device->CreateInputLayout(elements, numElements, byteCode, byteCodeLength, inputLayout);
+}
+
+HRESULT D3D11RenderDevice::CreateVertexShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+	ID3D11VertexShader** shader)
+{
+	return m_device->CreateVertexShader(byteCode, byteCodeLength, classLinkage, shader);
+}
+
+HRESULT D3D11RenderDevice::CreateHullShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+	ID3D11HullShader** shader)
+{
+	return m_device->CreateHullShader(byteCode, byteCodeLength, classLinkage, shader);
+}
+
+HRESULT D3D11RenderDevice::CreateDomainShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+	ID3D11DomainShader** shader)
+{
+	return m_device->CreateDomainShader(byteCode, byteCodeLength, classLinkage, shader);
+}
+
+HRESULT D3D11RenderDevice::CreateGeometryShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+	ID3D11GeometryShader** shader)
+{
+	return m_device->CreateGeometryShader(byteCode, byteCodeLength, classLinkage, shader);
+}
+
+HRESULT D3D11RenderDevice::CreateGeometryShaderWithStreamOutput(const void* byteCode, SIZE_T byteCodeLength,
+	const D3D11_SO_DECLARATION_ENTRY* entries, UINT numEntries, const UINT* strides, UINT numStrides,
+	UINT rasterizedStream, ID3D11ClassLinkage* classLinkage, ID3D11GeometryShader** shader)
+{
+	return m_device->CreateGeometryShaderWithStreamOutput(byteCode, byteCodeLength, entries, numEntries, strides, numStrides,
+		rasterizedStream, classLinkage, shader);
+}
+
+HRESULT D3D11RenderDevice::CreatePixelShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+	ID3D11PixelShader** shader)
+{
+	return m_device->CreatePixelShader(byteCode, byteCodeLength, classLinkage, shader);
+}
+
+HRESULT D3D11RenderDevice::CreateComputeShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+	ID3D11ComputeShader** shader)
+{
+	return m_device->CreateComputeShader(byteCode, byteCodeLength, classLinkage, shader);
+}
+
+HRESULT D3D11RenderDevice::CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state)
+{
+	return m_device->CreateBlendState(desc, state);
+}
+
+HRESULT D3D11RenderDevice::CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state)
+{
+	return m_device->CreateDepthStencilState(desc, state);
+}
+
+HRESULT D3D11RenderDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state)
+{
+	return m_device->CreateRasterizerState(desc, state);
+}
+
+HRESULT D3D11RenderDevice::CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** state)
+{
+	return m_device->CreateSamplerState(desc, state);
+}
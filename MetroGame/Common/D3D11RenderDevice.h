@@ -0,0 +1,55 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+namespace DX
+{
+	// Forwards every call to a Direct3D 11 device, which must outlive it.
+	class D3D11RenderDevice : public RenderDevice
+	{
+	public:
+		explicit D3D11RenderDevice(ID3D11Device* device);
+
+		ID3D11Device* GetD3DDevice() const { return m_device; }
+
+		virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer);
+		virtual HRESULT CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture1D** texture);
+		virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture);
+		virtual HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture);
+
+		virtual HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc,
+			ID3D11ShaderResourceView** view);
+		virtual HRESULT CreateUnorderedAccessView(ID3D11Resource* resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC* desc,
+			ID3D11UnorderedAccessView** view);
+		virtual HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc,
+			ID3D11RenderTargetView** view);
+		virtual HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc,
+			ID3D11DepthStencilView** view);
+
+		virtual HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT numElements,
+			const void* byteCode, SIZE_T byteCodeLength, ID3D11InputLayout** inputLayout);
+		virtual HRESULT CreateVertexShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11VertexShader** shader);
+		virtual HRESULT CreateHullShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11HullShader** shader);
+		virtual HRESULT CreateDomainShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11DomainShader** shader);
+		virtual HRESULT CreateGeometryShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11GeometryShader** shader);
+		virtual HRESULT CreateGeometryShaderWithStreamOutput(const void* byteCode, SIZE_T byteCodeLength,
+			const D3D11_SO_DECLARATION_ENTRY* entries, UINT numEntries, const UINT* strides, UINT numStrides,
+			UINT rasterizedStream, ID3D11ClassLinkage* classLinkage, ID3D11GeometryShader** shader);
+		virtual HRESULT CreatePixelShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11PixelShader** shader);
+		virtual HRESULT CreateComputeShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11ComputeShader** shader);
+
+		virtual HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state);
+		virtual HRESULT CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state);
+		virtual HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state);
+		virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** state);
+
+	private:
+		ID3D11Device* m_device;
+	};
+}
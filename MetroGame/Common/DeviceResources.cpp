@@ -76,6 +76,7 @@ DX::DeviceResources::DeviceResources(MSAATYPE msaaType, bool restrictDpi /* = fa
 	m_dpi(-1.0f),
 	m_effectiveDpi(-1.0f),
 	m_deviceNotify(nullptr),
+	m_renderContext(nullptr),
 	m_offScreenSurface(nullptr),
 	m_backBuffer(nullptr),
 	m_msaaQuality(0),
@@ -207,6 +208,16 @@ void DX::DeviceResources::CreateDeviceResources()
 	DX::ThrowIfFailed(
 		context.As(&m_d3dContext)
 		);
+	m_d3dRenderDevice = std::make_unique<D3D11RenderDevice>(m_d3dDevice.Get());
+	m_d3dRenderContext = std::make_unique<D3D11RenderContext>(m_d3dContext.Get());
+	m_stateCache = std::make_unique<StateCacheRenderContext>(m_d3dRenderContext.get());
+	m_renderContext = m_stateCache.get();
+	m_constantRing.reset();
+	if (m_d3dRenderContext->SupportsConstantBufferOffsets())
+	{
+		m_constantRing = std::make_unique<ConstantRingBuffer>();
+		m_constantRing->Initialize(m_d3dRenderDevice.get(), 256 * 1024);
+	}
 
 	// Create the Direct2D device object and a corresponding context.
 	ComPtr<IDXGIDevice3> dxgiDevice;
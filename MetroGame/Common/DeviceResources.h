@@ -1,5 +1,10 @@
 ﻿#pragma once
 
+#include "ConstantRingBuffer.h"
+#include "D3D11RenderContext.h"
+#include "D3D11RenderDevice.h"
+#include "StateCacheRenderContext.h"
+
 namespace DX
 {
     // Provides an interface for an application that owns DeviceResources to be notified of the device being lost or created.
@@ -52,6 +57,18 @@ namespace DX
 		D3D11_VIEWPORT				GetScreenViewport() const { return m_screenViewport; }
 		DirectX::XMFLOAT4X4			GetOrientationTransform3D() const { return m_orientationTransform3D; }
 
+		// The device components create their resources through.
+		RenderDevice*				GetRenderDevice() const { return m_d3dRenderDevice.get(); }
+		// The context components submit through: the state cache in front of the D3D11
+		// one, or one set in its place like a recording context. nullptr sets the state
+		// cache back.
+		RenderContext*				GetRenderContext() const { return m_renderContext; }
+		RenderContext*				GetD3DRenderContext() const { return m_d3dRenderContext.get(); }
+		StateCacheRenderContext*	GetStateCache() const { return m_stateCache.get(); }
+		void						SetRenderContext(RenderContext* context) { m_renderContext = context ? context : m_stateCache.get(); }
+		// nullptr where constant buffers can't be bound by offset.
+		ConstantRingBuffer*			GetConstantRing() const { return m_constantRing.get(); }
+
 		// D2D Accessors.
 		ID2D1Factory3*				GetD2DFactory() const { return m_d2dFactory.Get(); }
 		ID2D1Device2*				GetD2DDevice() const { return m_d2dDevice.Get(); }
@@ -72,6 +89,11 @@ namespace DX
 		Microsoft::WRL::ComPtr<ID3D11Device3>			m_d3dDevice;
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext3>	m_d3dContext;
 		Microsoft::WRL::ComPtr<IDXGISwapChain3>			m_swapChain;
+		std::unique_ptr<D3D11RenderDevice>				m_d3dRenderDevice;
+		std::unique_ptr<D3D11RenderContext>				m_d3dRenderContext;
+		std::unique_ptr<StateCacheRenderContext>		m_stateCache;
+		RenderContext*									m_renderContext;
+		std::unique_ptr<ConstantRingBuffer>				m_constantRing;
 
 		// Direct3D rendering objects. Required for 3D.
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView1>	m_d3dRenderTargetView;
@@ -5,6 +5,7 @@
 #include <sstream>
 #include <DirectXPackedVector.h>
 #include <DirectXCollision.h>
+#include "RenderDevice.h"
 
 namespace DX
 {
@@ -88,9 +89,7 @@ namespace DX
 		return x;
 	}
 
-	void ExtractFrustumPlanes(DirectX::XMFLOAT4 planes[6], const DirectX::XMFLOAT4X4& M);
-
-	void CreateRandomTexture1DSRV(ID3D11Device* device, ID3D11ShaderResourceView** textureView);
+	void CreateRandomTexture1DSRV(RenderDevice* device, ID3D11ShaderResourceView** textureView);
 
 	// #define XMGLOBALCONST extern CONST __declspec(selectany)
 	//   1. extern so there is only one copy of the variable, and not a separate
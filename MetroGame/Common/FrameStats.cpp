@@ -0,0 +1,140 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <math.h>
+
+using namespace DX;
+
+FrameStats::FrameStats(unsigned windowFrames, double hitchMs) :
+	m_frames((std::max)(windowFrames, 1u)), m_buckets(BucketCount + 1), m_hitchUs(ToUs(hitchMs))
+{
+	Reset();
+}
+
+void FrameStats::AddFrame(double frameMs, double updateMs, double renderMs)
+{
+	Frame frame = { ToUs(frameMs), ToUs(updateMs), ToUs(renderMs) };
+
+	// The oldest frame leaves a full window.
+	Frame& slot = m_frames[m_next];
+	if (m_count == m_frames.size())
+	{
+		--m_buckets[BucketOf(slot.FrameUs)];
+		m_frameSumUs -= slot.FrameUs;
+		m_updateSumUs -= slot.UpdateUs;
+		m_renderSumUs -= slot.RenderUs;
+		if (slot.FrameUs > m_hitchUs)
+			--m_hitches;
+	}
+	else
+	{
+		++m_count;
+	}
+
+	slot = frame;
+	++m_buckets[BucketOf(frame.FrameUs)];
+	m_frameSumUs += frame.FrameUs;
+	m_updateSumUs += frame.UpdateUs;
+	m_renderSumUs += frame.RenderUs;
+	if (frame.FrameUs > m_hitchUs)
+	{
+		++m_hitches;
+		++m_totalHitches;
+	}
+	++m_totalFrames;
+	m_next = (m_next + 1) % m_frames.size();
+}
+
+void FrameStats::Reset()
+{
+	std::fill(m_buckets.begin(), m_buckets.end(), 0);
+	m_next = m_count = 0;
+	m_frameSumUs = m_updateSumUs = m_renderSumUs = 0;
+	m_hitches = 0;
+	m_totalHitches = m_totalFrames = 0;
+}
+
+void FrameStats::SetHitchMs(double hitchMs)
+{
+	m_hitchUs = ToUs(hitchMs);
+	m_hitches = 0;
+	for (unsigned k = 0; k < m_count; ++k)
+	{
+		if (m_frames[k].FrameUs > m_hitchUs)
+			++m_hitches;
+	}
+}
+
+double FrameStats::GetPercentileMs(double p)const
+{
+	if (m_count == 0)
+		return 0.0;
+
+	unsigned rank = (std::max)((unsigned)ceil(p * m_count), 1u);
+	unsigned count = 0;
+	for (unsigned k = 0; k < BucketCount; ++k)
+	{
+		count += m_buckets[k];
+		if (count >= rank)
+			return (std::min)((k + 1) * BucketUs / 1000.0, GetMaxMs());
+	}
+	return GetMaxMs();
+}
+
+double FrameStats::GetMaxMs()const
+{
+	unsigned maxUs = 0;
+	for (unsigned k = 0; k < m_count; ++k)
+		maxUs = (std::max)(maxUs, m_frames[k].FrameUs);
+	return maxUs / 1000.0;
+}
+
+double FrameStats::GetAverageMs()const
+{
+	return m_count > 0 ? m_frameSumUs / 1000.0 / m_count : 0.0;
+}
+
+double FrameStats::GetAverageUpdateMs()const
+{
+	return m_count > 0 ? m_updateSumUs / 1000.0 / m_count : 0.0;
+}
+
+double FrameStats::GetAverageRenderMs()const
+{
+	return m_count > 0 ? m_renderSumUs / 1000.0 / m_count : 0.0;
+}
+
+void FrameStats::WriteCsv(std::ostream& out)const
+{
+	out << "frame,frame_ms,update_ms,render_ms\n";
+	unsigned first = m_count == m_frames.size() ? m_next : 0;
+	unsigned long long index = m_totalFrames - m_count;
+	for (unsigned k = 0; k < m_count; ++k)
+	{
+		const Frame& frame = m_frames[(first + k) % m_frames.size()];
+		out << index + k << ',' << frame.FrameUs / 1000.0 << ',' << frame.UpdateUs / 1000.0 << ','
+			<< frame.RenderUs / 1000.0 << '\n';
+	}
+}
+
+void FrameStats::WriteSummaryCsvHeader(std::ostream& out)
+{
+	out << "label,frames,avg_ms,p50_ms,p95_ms,p99_ms,max_ms,hitches,hitch_ms,update_ms,render_ms\n";
+}
+
+void FrameStats::WriteSummaryCsv(std::ostream& out, const std::string& label)const
+{
+	out << label << ',' << m_count << ',' << GetAverageMs() << ',' << GetPercentileMs(0.5) << ','
+		<< GetPercentileMs(0.95) << ',' << GetPercentileMs(0.99) << ',' << GetMaxMs() << ','
+		<< m_hitches << ',' << GetHitchMs() << ',' << GetAverageUpdateMs() << ',' << GetAverageRenderMs() << '\n';
+}
+
+unsigned FrameStats::ToUs(double ms)
+{
+	// Negative and NaN times count as zero.
+	return ms > 0.0 ? (unsigned)(std::min)(ms * 1000.0 + 0.5, 4.0e9) : 0;
+}
+
+unsigned FrameStats::BucketOf(unsigned us)
+{
+	return (std::min)(us / BucketUs, BucketCount);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Frame time statistics over a sliding window of the last frames. Times are kept
+// in whole microseconds, so that the running sums stay exact, in a ring of the
+// window's frames and in a histogram of 0.1 ms buckets up to 100 ms, which frames
+// enter and leave with the window. Adding a frame allocates nothing and costs the
+// same for any window; percentiles scan the histogram once.
+// It only depends on the standard library; the translation unit doesn't use the
+// precompiled header.
+
+namespace DX
+{
+	class FrameStats
+	{
+	public:
+		static const unsigned BucketUs = 100;
+		static const unsigned BucketCount = 1000;	// Plus one for longer frames
+
+		// Frames longer than hitchMs count as hitches.
+		explicit FrameStats(unsigned windowFrames = 600, double hitchMs = 33.3);
+
+		// Times of one frame in milliseconds, update and render are parts of it.
+		void AddFrame(double frameMs, double updateMs, double renderMs);
+		void Reset();
+		void SetHitchMs(double hitchMs);
+
+		// Over the window. p is in [0, 1], the result rounded up to the bucket.
+		double GetPercentileMs(double p)const;
+		double GetMaxMs()const;
+		double GetAverageMs()const;
+		double GetAverageUpdateMs()const;
+		double GetAverageRenderMs()const;
+		unsigned GetHitches()const { return m_hitches; }
+		unsigned GetFrameCount()const { return m_count; }
+
+		// Since the last reset.
+		unsigned long long GetTotalHitches()const { return m_totalHitches; }
+		unsigned long long GetTotalFrames()const { return m_totalFrames; }
+
+		double GetHitchMs()const { return m_hitchUs / 1000.0; }
+		unsigned GetWindowFrames()const { return (unsigned)m_frames.size(); }
+
+		// The frames of the window, oldest first, with a header line.
+		void WriteCsv(std::ostream& out)const;
+		// One line with the statistics of the window, after the header line.
+		static void WriteSummaryCsvHeader(std::ostream& out);
+		void WriteSummaryCsv(std::ostream& out, const std::string& label)const;
+
+	private:
+		struct Frame
+		{
+			unsigned FrameUs;
+			unsigned UpdateUs;
+			unsigned RenderUs;
+		};
+
+		static unsigned ToUs(double ms);
+		static unsigned BucketOf(unsigned us);
+
+	private:
+		std::vector<Frame> m_frames;	// Ring of the window
+		unsigned m_next;
+		unsigned m_count;
+		std::vector<unsigned> m_buckets;
+
+		unsigned long long m_frameSumUs;
+		unsigned long long m_updateSumUs;
+		unsigned long long m_renderSumUs;
+		unsigned m_hitchUs;
+		unsigned m_hitches;
+		unsigned long long m_totalHitches;
+		unsigned long long m_totalFrames;
+	};
+}
@@ -0,0 +1,146 @@
+#include "FrustumCuller.h"
+
+using namespace DX;
+using namespace DirectX;
+
+void DX::ExtractFrustumPlanes(XMFLOAT4 planes[6], const XMFLOAT4X4& M)
+{
+	//
+	// Left
+	//
+	planes[0].x = M(0, 3) + M(0, 0);
+	planes[0].y = M(1, 3) + M(1, 0);
+	planes[0].z = M(2, 3) + M(2, 0);
+	planes[0].w = M(3, 3) + M(3, 0);
+
+	//
+	// Right
+	//
+	planes[1].x = M(0, 3) - M(0, 0);
+	planes[1].y = M(1, 3) - M(1, 0);
+	planes[1].z = M(2, 3) - M(2, 0);
+	planes[1].w = M(3, 3) - M(3, 0);
+
+	//
+	// Bottom
+	//
+	planes[2].x = M(0, 3) + M(0, 1);
+	planes[2].y = M(1, 3) + M(1, 1);
+	planes[2].z = M(2, 3) + M(2, 1);
+	planes[2].w = M(3, 3) + M(3, 1);
+
+	//
+	// Top
+	//
+	planes[3].x = M(0, 3) - M(0, 1);
+	planes[3].y = M(1, 3) - M(1, 1);
+	planes[3].z = M(2, 3) - M(2, 1);
+	planes[3].w = M(3, 3) - M(3, 1);
+
+	//
+	// Near
+	//
+	planes[4].x = M(0, 2);
+	planes[4].y = M(1, 2);
+	planes[4].z = M(2, 2);
+	planes[4].w = M(3, 2);
+
+	//
+	// Far
+	//
+	planes[5].x = M(0, 3) - M(0, 2);
+	planes[5].y = M(1, 3) - M(1, 2);
+	planes[5].z = M(2, 3) - M(2, 2);
+	planes[5].w = M(3, 3) - M(3, 2);
+
+	// Normalize the plane equations.
+	for (int i = 0; i < 6; ++i)
+	{
+		XMVECTOR v = XMPlaneNormalize(XMLoadFloat4(&planes[i]));
+		XMStoreFloat4(&planes[i], v);
+	}
+}
+
+FrustumCuller::FrustumCuller()
+{
+	// Nothing is culled until a frustum is set.
+	for (int i = 0; i < 6; ++i)
+		m_planes[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void FrustumCuller::SetViewProj(const XMFLOAT4X4& viewProj)
+{
+	ExtractFrustumPlanes(m_planes, viewProj);
+}
+
+void FrustumCuller::Cull(const BoundingSphere& sphere, const XMFLOAT4X4* worlds, UINT count,
+	std::vector<UINT>& visible, float padding)const
+{
+	visible.clear();
+	if (count == 0)
+		return;
+
+	XMVECTOR centerX = XMVectorReplicate(sphere.Center.x);
+	XMVECTOR centerY = XMVectorReplicate(sphere.Center.y);
+	XMVECTOR centerZ = XMVectorReplicate(sphere.Center.z);
+	XMVECTOR negRadius = XMVectorReplicate(-sphere.Radius);
+	XMVECTOR negPadding = XMVectorReplicate(-padding);
+
+	for (UINT i = 0; i < count; i += 4)
+	{
+		// The last block repeats the last world, the extra results are dropped.
+		const XMFLOAT4X4* w[4];
+		for (UINT k = 0; k < 4; ++k)
+			w[k] = &worlds[i + k < count ? i + k : count - 1];
+
+		// Transpose the rows of four worlds, so that every register holds the
+		// same element of all of them.
+		XMMATRIX r[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			r[j] = XMMatrixTranspose(XMMATRIX(
+				XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(w[0]->m[j])),
+				XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(w[1]->m[j])),
+				XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(w[2]->m[j])),
+				XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(w[3]->m[j]))));
+		}
+
+		// World space centers.
+		XMVECTOR x = XMVectorMultiplyAdd(centerX, r[0].r[0], r[3].r[0]);
+		x = XMVectorMultiplyAdd(centerY, r[1].r[0], x);
+		x = XMVectorMultiplyAdd(centerZ, r[2].r[0], x);
+		XMVECTOR y = XMVectorMultiplyAdd(centerX, r[0].r[1], r[3].r[1]);
+		y = XMVectorMultiplyAdd(centerY, r[1].r[1], y);
+		y = XMVectorMultiplyAdd(centerZ, r[2].r[1], y);
+		XMVECTOR z = XMVectorMultiplyAdd(centerX, r[0].r[2], r[3].r[2]);
+		z = XMVectorMultiplyAdd(centerY, r[1].r[2], z);
+		z = XMVectorMultiplyAdd(centerZ, r[2].r[2], z);
+
+		// The radius grows with the largest scale of the world, like BoundingSphere::Transform.
+		XMVECTOR scale = XMVectorZero();
+		for (int j = 0; j < 3; ++j)
+		{
+			XMVECTOR lengthSq = XMVectorMultiply(r[j].r[0], r[j].r[0]);
+			lengthSq = XMVectorMultiplyAdd(r[j].r[1], r[j].r[1], lengthSq);
+			lengthSq = XMVectorMultiplyAdd(r[j].r[2], r[j].r[2], lengthSq);
+			scale = XMVectorMax(scale, lengthSq);
+		}
+		XMVECTOR negR = XMVectorMultiplyAdd(negRadius, XMVectorSqrt(scale), negPadding);
+
+		// Visible unless it is completely behind one plane.
+		XMVECTOR inside = XMVectorTrueInt();
+		for (int p = 0; p < 6; ++p)
+		{
+			XMVECTOR d = XMVectorMultiplyAdd(XMVectorReplicate(m_planes[p].x), x, XMVectorReplicate(m_planes[p].w));
+			d = XMVectorMultiplyAdd(XMVectorReplicate(m_planes[p].y), y, d);
+			d = XMVectorMultiplyAdd(XMVectorReplicate(m_planes[p].z), z, d);
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(d, negR));
+		}
+
+		uint32_t mask[4];
+		XMStoreInt4(mask, inside);
+		for (UINT k = 0; k < 4 && i + k < count; ++k)
+			if (mask[k])
+				visible.push_back(i + k);
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+
+// Culls the instances of an object against the frustum of one pass.
+// The planes come from ExtractFrustumPlanes, so the orthographic volume of the
+// shadow pass works the same as the camera frustum. The bounding sphere of four
+// instances is moved to world space and tested against all six planes at once.
+// The translation unit doesn't use the precompiled header, so that the culling
+// tests build headless.
+
+namespace DX
+{
+	// Inward facing, normalized planes of the frustum of the untransposed M:
+	// left, right, bottom, top, near and far.
+	void ExtractFrustumPlanes(DirectX::XMFLOAT4 planes[6], const DirectX::XMFLOAT4X4& M);
+
+	class FrustumCuller
+	{
+	public:
+		FrustumCuller();
+
+		// viewProj is the untransposed view-projection matrix of the pass.
+		void SetViewProj(const DirectX::XMFLOAT4X4& viewProj);
+		// Clears visible and fills it with the indices of the worlds which put
+		// sphere, given in object space, inside the frustum, in increasing order.
+		// padding is added to the world space radius, e.g. for displacement.
+		void Cull(const DirectX::BoundingSphere& sphere, const DirectX::XMFLOAT4X4* worlds, UINT count,
+			std::vector<UINT>& visible, float padding = 0.0f)const;
+
+	public:
+		const DirectX::XMFLOAT4* GetPlanes()const { return m_planes; }
+
+	private:
+		// Inward facing and normalized.
+		DirectX::XMFLOAT4 m_planes[6];
+	};
+}
@@ -1,10 +1,13 @@
 ﻿#pragma once
 
-#include <wrl.h>
+#include <Windows.h>
+#include <stdexcept>
+#include <stdlib.h>
 
 namespace DX
 {
-	// Helper class for animation and simulation timing.
+	// Helper class for animation and simulation timing. It only needs the Windows
+	// types, so the headless scene benchmark steps scenes with it too.
 	class GameTimer
 	{
 	public:
@@ -21,12 +24,12 @@ namespace DX
 		{
 			if (!QueryPerformanceFrequency(&m_qpcFrequency))
 			{
-				throw ref new Platform::FailureException();
+				throw std::runtime_error("The performance counter failed!");
 			}
 
 			if (!QueryPerformanceCounter(&m_qpcLastTime))
 			{
-				throw ref new Platform::FailureException();
+				throw std::runtime_error("The performance counter failed!");
 			}
 
 			// Initialize max delta to 1/10 of a second.
@@ -34,31 +37,31 @@ namespace DX
 		}
 
 		// Get elapsed time since the previous Update call.
-		uint64 GetElapsedTicks() const						{ return m_elapsedTicks; }
+		UINT64 GetElapsedTicks() const						{ return m_elapsedTicks; }
 		double GetElapsedSeconds() const					{ return TicksToSeconds(m_elapsedTicks); }
 
 		// Get total time since the start of the program.
-		uint64 GetTotalTicks() const						{ return m_totalTicks; }
+		UINT64 GetTotalTicks() const						{ return m_totalTicks; }
 		double GetTotalSeconds() const						{ return TicksToSeconds(m_totalTicks); }
 
 		// Get total number of updates since start of the program.
-		uint32 GetFrameCount() const						{ return m_frameCount; }
+		UINT32 GetFrameCount() const						{ return m_frameCount; }
 
 		// Get the current framerate.
-		uint32 GetFramesPerSecond() const					{ return m_framesPerSecond; }
+		UINT32 GetFramesPerSecond() const					{ return m_framesPerSecond; }
 
 		// Set whether to use fixed or variable timestep mode.
 		void SetFixedTimeStep(bool isFixedTimestep)			{ m_isFixedTimeStep = isFixedTimestep; }
 
 		// Set how often to call Update when in fixed timestep mode.
-		void SetTargetElapsedTicks(uint64 targetElapsed)	{ m_targetElapsedTicks = targetElapsed; }
+		void SetTargetElapsedTicks(UINT64 targetElapsed)	{ m_targetElapsedTicks = targetElapsed; }
 		void SetTargetElapsedSeconds(double targetElapsed)	{ m_targetElapsedTicks = SecondsToTicks(targetElapsed); }
 
 		// Integer format represents time using 10,000,000 ticks per second.
-		static const uint64 TicksPerSecond = 10000000;
+		static const UINT64 TicksPerSecond = 10000000;
 
-		static double TicksToSeconds(uint64 ticks)			{ return static_cast<double>(ticks) / TicksPerSecond; }
-		static uint64 SecondsToTicks(double seconds)		{ return static_cast<uint64>(seconds * TicksPerSecond); }
+		static double TicksToSeconds(UINT64 ticks)			{ return static_cast<double>(ticks) / TicksPerSecond; }
+		static UINT64 SecondsToTicks(double seconds)		{ return static_cast<UINT64>(seconds * TicksPerSecond); }
 
 		// After an intentional timing discontinuity (for instance a blocking IO operation)
 		// call this to avoid having the fixed timestep logic attempt a set of catch-up 
@@ -68,7 +71,7 @@ namespace DX
 		{
 			if (!QueryPerformanceCounter(&m_qpcLastTime))
 			{
-				throw ref new Platform::FailureException();
+				throw std::runtime_error("The performance counter failed!");
 			}
 
 			m_leftOverTicks = 0;
@@ -86,10 +89,10 @@ namespace DX
 
 			if (!QueryPerformanceCounter(&currentTime))
 			{
-				throw ref new Platform::FailureException();
+				throw std::runtime_error("The performance counter failed!");
 			}
 
-			uint64 timeDelta = currentTime.QuadPart - m_qpcLastTime.QuadPart;
+			UINT64 timeDelta = currentTime.QuadPart - m_qpcLastTime.QuadPart;
 
 			m_qpcLastTime = currentTime;
 			m_qpcSecondCounter += timeDelta;
@@ -104,7 +107,7 @@ namespace DX
 			timeDelta *= TicksPerSecond;
 			timeDelta /= m_qpcFrequency.QuadPart;
 
-			uint32 lastFrameCount = m_frameCount;
+			UINT32 lastFrameCount = m_frameCount;
 
 			if (m_isFixedTimeStep)
 			{
@@ -117,7 +120,7 @@ namespace DX
 				// accumulate enough tiny errors that it would drop a frame. It is better to just round 
 				// small deviations down to zero to leave things running smoothly.
 
-				if (abs(static_cast<int64>(timeDelta - m_targetElapsedTicks)) < TicksPerSecond / 4000)
+				if (abs(static_cast<INT64>(timeDelta - m_targetElapsedTicks)) < TicksPerSecond / 4000)
 				{
 					timeDelta = m_targetElapsedTicks;
 				}
@@ -151,7 +154,38 @@ namespace DX
 				m_framesThisSecond++;
 			}
 
-			if (m_qpcSecondCounter >= static_cast<uint64>(m_qpcFrequency.QuadPart))
+			if (m_qpcSecondCounter >= static_cast<UINT64>(m_qpcFrequency.QuadPart))
+			{
+				m_framesPerSecond = m_framesThisSecond;
+				m_framesThisSecond = 0;
+				m_qpcSecondCounter %= m_qpcFrequency.QuadPart;
+			}
+		}
+
+		// Advance by exactly one target elapsed time and call Update once, whatever
+		// the real time. Replays step this way so that every run updates the same.
+		template<typename TUpdate>
+		void Step(const TUpdate& update)
+		{
+			LARGE_INTEGER currentTime;
+
+			if (!QueryPerformanceCounter(&currentTime))
+			{
+				throw std::runtime_error("The performance counter failed!");
+			}
+
+			m_qpcSecondCounter += currentTime.QuadPart - m_qpcLastTime.QuadPart;
+			m_qpcLastTime = currentTime;
+
+			m_elapsedTicks = m_targetElapsedTicks;
+			m_totalTicks += m_targetElapsedTicks;
+			m_leftOverTicks = 0;
+			m_frameCount++;
+			m_framesThisSecond++;
+
+			update();
+
+			if (m_qpcSecondCounter >= static_cast<UINT64>(m_qpcFrequency.QuadPart))
 			{
 				m_framesPerSecond = m_framesThisSecond;
 				m_framesThisSecond = 0;
@@ -163,21 +197,21 @@ namespace DX
 		// Source timing data uses QPC units.
 		LARGE_INTEGER m_qpcFrequency;
 		LARGE_INTEGER m_qpcLastTime;
-		uint64 m_qpcMaxDelta;
+		UINT64 m_qpcMaxDelta;
 
 		// Derived timing data uses a canonical tick format.
-		uint64 m_elapsedTicks;
-		uint64 m_totalTicks;
-		uint64 m_leftOverTicks;
+		UINT64 m_elapsedTicks;
+		UINT64 m_totalTicks;
+		UINT64 m_leftOverTicks;
 
 		// Members for tracking the framerate.
-		uint32 m_frameCount;
-		uint32 m_framesPerSecond;
-		uint32 m_framesThisSecond;
-		uint64 m_qpcSecondCounter;
+		UINT32 m_frameCount;
+		UINT32 m_framesPerSecond;
+		UINT32 m_framesThisSecond;
+		UINT64 m_qpcSecondCounter;
 
 		// Members for configuring fixed timestep mode.
 		bool m_isFixedTimeStep;
-		uint64 m_targetElapsedTicks;
+		UINT64 m_targetElapsedTicks;
 	};
 }
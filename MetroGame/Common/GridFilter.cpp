@@ -0,0 +1,155 @@
+#include "GridFilter.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+	// Rows per task.
+	const UINT BandRows = 64;
+}
+
+GridFilter::GridFilter(GridFilterType type, UINT radius, UINT passes) :
+	m_radius(radius), m_passes(passes), m_weights(2 * radius + 1, 1.0f)
+{
+	if (type == GridFilterType::Gaussian && radius > 0)
+	{
+		float sigma = 0.5f * radius;
+		for (UINT k = 0; k < m_weights.size(); ++k)
+		{
+			float x = (float)k - (float)radius;
+			m_weights[k] = expf(-x * x / (2.0f * sigma * sigma));
+		}
+	}
+
+	float sum = 0.0f;
+	for (float w : m_weights)
+		sum += w;
+	for (float& w : m_weights)
+		w /= sum;
+}
+
+void GridFilter::Apply(float* grid, UINT width, UINT height)
+{
+	if (m_radius == 0 || m_passes == 0 || width == 0 || height == 0)
+		return;
+
+	UINT bands = (height + BandRows - 1) / BandRows;
+	m_halo.resize(size_t(bands) * 2 * m_radius * width);
+	for (UINT pass = 0; pass < m_passes; ++pass)
+	{
+		for (UINT band = 0; band < bands; ++band)
+		{
+			UINT i0 = band * BandRows, i1 = (std::min)(i0 + BandRows, height);
+			float* halo = &m_halo[size_t(band) * 2 * m_radius * width];
+			for (UINT k = 0; k < m_radius; ++k)
+			{
+				if (i0 >= m_radius - k)
+					memcpy(halo + size_t(k) * width, grid + size_t(i0 - m_radius + k) * width, width * sizeof(float));
+				if (i1 + k < height)
+					memcpy(halo + size_t(m_radius + k) * width, grid + size_t(i1 + k) * width, width * sizeof(float));
+			}
+		}
+		ParallelFor(0, bands, [&](UINT band)
+		{
+			FilterBand(grid, width, height, band);
+		});
+	}
+}
+
+void GridFilter::FilterBand(float* grid, UINT width, UINT height, UINT band)const
+{
+	UINT radius = m_radius, taps = 2 * radius + 1;
+	const float* weights = m_weights.data();
+	UINT i0 = band * BandRows, i1 = (std::min)(i0 + BandRows, height);
+	const float* halo = &m_halo[size_t(band) * 2 * radius * width];
+
+	// Row k filtered horizontally is ring row k % taps.
+	std::vector<float> ring(size_t(taps) * width);
+	std::vector<const float*> rows(taps);
+	UINT next = i0 > radius ? i0 - radius : 0;
+	for (UINT i = i0; i < i1; ++i)
+	{
+		// Rows of the band past i still hold their input.
+		for (UINT end = (std::min)(i + radius + 1, height); next < end; ++next)
+		{
+			const float* src = next < i0 ? halo + size_t(next + radius - i0) * width :
+				next >= i1 ? halo + size_t(radius + next - i1) * width : grid + size_t(next) * width;
+			FilterRow(src, &ring[size_t(next % taps) * width], width);
+		}
+
+		// Taps [k0, k1) are inside the grid.
+		UINT k0 = i < radius ? radius - i : 0;
+		UINT k1 = (std::min)(taps, height + radius - i);
+		float weight = 0.0f;
+		for (UINT k = k0; k < k1; ++k)
+		{
+			rows[k] = &ring[size_t((i - radius + k) % taps) * width];
+			weight += weights[k];
+		}
+		float scale = k1 - k0 < taps ? 1.0f / weight : 1.0f;
+
+		float* out = grid + size_t(i) * width;
+		UINT j = 0;
+		for (; j + 4 <= width; j += 4)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for (UINT k = k0; k < k1; ++k)
+				sum = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(rows[k] + j)), XMVectorReplicate(weights[k]), sum);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out + j), XMVectorScale(sum, scale));
+		}
+		for (; j < width; ++j)
+		{
+			float sum = 0.0f;
+			for (UINT k = k0; k < k1; ++k)
+				sum += rows[k][j] * weights[k];
+			out[j] = sum * scale;
+		}
+	}
+}
+
+void GridFilter::FilterRow(const float* src, float* dest, UINT width)const
+{
+	UINT radius = m_radius, taps = 2 * radius + 1;
+	const float* weights = m_weights.data();
+
+	// Samples [radius, interiorEnd) have all their taps inside the row.
+	UINT interiorEnd = width > 2 * radius ? width - radius : radius;
+	UINT j = radius;
+	for (; j + 4 <= interiorEnd; j += 4)
+	{
+		XMVECTOR sum = XMVectorZero();
+		for (UINT k = 0; k < taps; ++k)
+			sum = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(src + j - radius + k)), XMVectorReplicate(weights[k]), sum);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dest + j), sum);
+	}
+	for (; j < interiorEnd; ++j)
+	{
+		float sum = 0.0f;
+		for (UINT k = 0; k < taps; ++k)
+			sum += src[j - radius + k] * weights[k];
+		dest[j] = sum;
+	}
+
+	// The borders, [0, radius) and [interiorEnd, width).
+	auto border = [&](UINT j)
+	{
+		UINT k0 = j < radius ? radius - j : 0;
+		UINT k1 = (std::min)(taps, width + radius - j);
+		float sum = 0.0f, weight = 0.0f;
+		for (UINT k = k0; k < k1; ++k)
+		{
+			sum += src[j + k - radius] * weights[k];
+			weight += weights[k];
+		}
+		dest[j] = sum / weight;
+	};
+	for (j = 0; j < (std::min)(radius, width); ++j)
+		border(j);
+	for (j = (std::max)(interiorEnd, radius); j < width; ++j)
+		border(j);
+}
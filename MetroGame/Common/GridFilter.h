@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+// Separable low-pass filter for row-major float grids such as height maps, in
+// place. The grid is split in bands of rows which are filtered in parallel. A band
+// filters its rows horizontally into a ring of 2 * radius + 1 rows, from which the
+// vertical pass writes the final row back, so every pass reads and writes the grid
+// once and the rows under the kernel stay in the cache. Both passes run four
+// samples at a time. Taps past the borders are left out and the remaining weights
+// renormalized, apart from the inner loops.
+// The translation unit doesn't use the precompiled header, so that the filter
+// tests build headless.
+
+namespace DX
+{
+	enum class GridFilterType
+	{
+		Box,
+		Gaussian	// Sigma of radius / 2
+	};
+
+	class GridFilter
+	{
+	public:
+		GridFilter(GridFilterType type = GridFilterType::Box, UINT radius = 1, UINT passes = 1);
+
+		// Filters width x height samples in place.
+		void Apply(float* grid, UINT width, UINT height);
+
+	public:
+		UINT GetRadius()const { return m_radius; }
+		UINT GetPasses()const { return m_passes; }
+
+	private:
+		void FilterBand(float* grid, UINT width, UINT height, UINT band)const;
+		void FilterRow(const float* src, float* dest, UINT width)const;
+
+	private:
+		UINT m_radius;
+		UINT m_passes;
+		std::vector<float> m_weights;	// 2 * radius + 1, summing to 1
+		// The radius rows above and below every band, before the neighbor bands
+		// overwrite them.
+		std::vector<float> m_halo;
+	};
+}
@@ -0,0 +1,177 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace DX;
+
+JobSystem* JobSystem::m_instance = nullptr;
+
+namespace
+{
+	// Deque of a worker thread, -1 on other threads.
+	thread_local int t_workerQueue = -1;
+}
+
+JobSystem::JobSystem(unsigned threadCount) :
+	m_pending(0), m_sleeping(0), m_stop(false)
+{
+	if (m_instance == nullptr)
+		m_instance = this;
+	else
+		throw std::logic_error("Cannot create more than one JobSystem!");
+
+	for (unsigned i = 0; i <= threadCount; ++i)
+		m_queues.push_back(std::make_unique<Queue>());
+	for (unsigned i = 0; i < threadCount; ++i)
+		m_threads.emplace_back(&JobSystem::WorkerMain, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& thread : m_threads)
+		thread.join();
+
+	// Without workers, the jobs nobody waited on are left.
+	while (RunOne(GetQueue()));
+	m_instance = nullptr;
+}
+
+unsigned JobSystem::DefaultThreadCount()
+{
+	return (std::max)(std::thread::hardware_concurrency(), 2u) - 1;
+}
+
+void JobSystem::Run(std::function<void()> work, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter)
+		++counter->m_count;
+
+	Job job = { std::move(work), counter };
+	if (dependency)
+	{
+		std::lock_guard<std::mutex> lock(dependency->m_mutex);
+		if (!dependency->IsDone())
+		{
+			dependency->m_dependents.push_back(std::move(job));
+			return;
+		}
+	}
+	Push(GetQueue(), std::move(job));
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	unsigned queue = GetQueue();
+	while (!counter.IsDone())
+	{
+		// The last jobs may be running on other threads.
+		if (!RunOne(queue))
+			std::this_thread::yield();
+	}
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::WorkerMain(unsigned queue)
+{
+	t_workerQueue = (int)queue;
+	for (;;)
+	{
+		if (RunOne(queue))
+			continue;
+
+		// A job queued after the check below notifies, since it finds m_sleeping raised.
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		++m_sleeping;
+		m_wake.wait(lock, [this]() { return m_pending.load() > 0 || m_stop.load(); });
+		--m_sleeping;
+		if (m_stop && m_pending.load() == 0)
+			return;
+	}
+}
+
+bool JobSystem::RunOne(unsigned queue)
+{
+	Job job;
+	if (!Pop(queue, job))
+		return false;
+
+	job.Work();
+	if (job.Counter)
+		Finish(*job.Counter);
+	return true;
+}
+
+bool JobSystem::Pop(unsigned queue, Job& job)
+{
+	if (m_pending.load() == 0)
+		return false;
+
+	// The newest job of our own deque, whose data is most likely in the cache.
+	{
+		Queue& own = *m_queues[queue];
+		std::lock_guard<std::mutex> lock(own.Mutex);
+		if (!own.Jobs.empty())
+		{
+			job = std::move(own.Jobs.back());
+			own.Jobs.pop_back();
+			--m_pending;
+			return true;
+		}
+	}
+
+	// Otherwise the oldest job of another deque, which tends to be the biggest.
+	unsigned count = (unsigned)m_queues.size();
+	for (unsigned k = 1; k < count; ++k)
+	{
+		Queue& victim = *m_queues[(queue + k) % count];
+		std::lock_guard<std::mutex> lock(victim.Mutex);
+		if (!victim.Jobs.empty())
+		{
+			job = std::move(victim.Jobs.front());
+			victim.Jobs.pop_front();
+			--m_pending;
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::Push(unsigned queue, Job&& job)
+{
+	{
+		Queue& own = *m_queues[queue];
+		std::lock_guard<std::mutex> lock(own.Mutex);
+		own.Jobs.push_back(std::move(job));
+	}
+	++m_pending;
+	if (m_sleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wake.notify_one();
+	}
+}
+
+void JobSystem::Finish(JobCounter& counter)
+{
+	// Under the lock, which Wait takes before it returns and the counter may go away.
+	std::vector<Job> dependents;
+	{
+		std::lock_guard<std::mutex> lock(counter.m_mutex);
+		if (--counter.m_count > 0)
+			return;
+		dependents.swap(counter.m_dependents);
+	}
+	unsigned queue = GetQueue();
+	for (auto& job : dependents)
+		Push(queue, std::move(job));
+}
+
+unsigned JobSystem::GetQueue()const
+{
+	return t_workerQueue >= 0 ? (unsigned)t_workerQueue : (unsigned)m_queues.size() - 1;
+}
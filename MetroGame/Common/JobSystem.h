@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job scheduler. Every worker thread owns a deque, pushes and pops
+// its own jobs at the back and steals from the front of the other deques when it
+// runs dry; threads outside the pool share one more deque. Jobs are counted on a
+// JobCounter, which can be waited on or hold other jobs back until it drops to
+// zero. A waiting thread runs jobs meanwhile, so jobs may wait on the jobs they
+// spawn. Jobs must not throw.
+// It only depends on the standard library, so that it builds on any platform; the
+// translation unit doesn't use the precompiled header.
+
+namespace DX
+{
+	class JobCounter;
+
+	struct Job
+	{
+		std::function<void()> Work;
+		JobCounter* Counter;
+	};
+
+	// Number of unfinished jobs counted on it. It must outlive them, and no job may
+	// be added to it once jobs depend on it.
+	class JobCounter
+	{
+	public:
+		JobCounter() : m_count(0) {}
+		bool IsDone()const { return m_count.load() == 0; }
+
+	private:
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+	private:
+		friend class JobSystem;
+		std::atomic<int> m_count;
+		std::mutex m_mutex;
+		std::vector<Job> m_dependents;	// Queued once the count drops to zero
+	};
+
+	class JobSystem
+	{
+	public:
+		// Starts threadCount workers. The default leaves a hardware thread to the
+		// thread that waits.
+		explicit JobSystem(unsigned threadCount = DefaultThreadCount());
+		// Runs the queued jobs and joins the workers.
+		~JobSystem();
+		// Singleton
+		static JobSystem* Instance() { return m_instance; }
+		static unsigned DefaultThreadCount();
+
+		// Queues work, counted on counter if any. With a dependency, it is only
+		// queued once the jobs counted on dependency are done.
+		void Run(std::function<void()> work, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+		// Runs jobs until counter drops to zero.
+		void Wait(JobCounter& counter);
+		// Calls body(i) for every i in [begin, end), in chunks of grain indices, and
+		// returns once all are done. The calling thread takes chunks too.
+		template<typename Body>
+		void ParallelFor(unsigned begin, unsigned end, const Body& body, unsigned grain = 1);
+
+	public:
+		unsigned GetThreadCount()const { return (unsigned)m_threads.size(); }
+
+	private:
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		void WorkerMain(unsigned queue);
+		bool RunOne(unsigned queue);
+		bool Pop(unsigned queue, Job& job);
+		void Push(unsigned queue, Job&& job);
+		void Finish(JobCounter& counter);
+		// Deque of the calling thread.
+		unsigned GetQueue()const;
+
+	private:
+		struct Queue
+		{
+			std::mutex Mutex;
+			std::deque<Job> Jobs;
+		};
+
+		// One per worker, then the one of the other threads.
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_threads;
+
+		// Queued jobs, and the workers sleeping until there are some.
+		std::atomic<int> m_pending;
+		std::atomic<int> m_sleeping;
+		std::atomic<bool> m_stop;
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wake;
+
+		static JobSystem* m_instance;
+	};
+
+	template<typename Body>
+	void JobSystem::ParallelFor(unsigned begin, unsigned end, const Body& body, unsigned grain)
+	{
+		if (begin >= end)
+			return;
+		grain = grain > 0 ? grain : 1;
+		unsigned chunks = (end - begin - 1) / grain + 1;
+
+		// The jobs claim chunks until none is left, so they balance among themselves.
+		std::atomic<unsigned> next(0);
+		auto work = [&]()
+		{
+			for (unsigned chunk = next.fetch_add(1); chunk < chunks; chunk = next.fetch_add(1))
+			{
+				unsigned i0 = begin + chunk * grain;
+				unsigned i1 = end - i0 > grain ? i0 + grain : end;
+				for (unsigned i = i0; i < i1; ++i)
+					body(i);
+			}
+		};
+
+		JobCounter counter;
+		unsigned jobs = chunks - 1 < GetThreadCount() ? chunks - 1 : GetThreadCount();
+		for (unsigned k = 0; k < jobs; ++k)
+			Run(work, &counter);
+		work();
+		Wait(counter);
+	}
+
+	// Runs on the JobSystem if there is one, otherwise on the calling thread.
+	template<typename Body>
+	void ParallelFor(unsigned begin, unsigned end, const Body& body, unsigned grain = 1)
+	{
+		if (JobSystem* jobSystem = JobSystem::Instance())
+		{
+			jobSystem->ParallelFor(begin, end, body, grain);
+		}
+		else
+		{
+			for (unsigned i = begin; i < end; ++i)
+				body(i);
+		}
+	}
+}
@@ -0,0 +1,135 @@
+#include "MappedFile.h"
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace DX;
+
+#if defined(_WIN32)
+MappedFile::MappedFile()
+	: m_mapping(nullptr), m_data(nullptr), m_size(0)
+{
+}
+
+MappedFile::MappedFile(const std::wstring& filename)
+	: m_mapping(nullptr), m_data(nullptr), m_size(0)
+{
+	Open(filename);
+}
+#else
+MappedFile::MappedFile()
+	: m_file(-1), m_data(nullptr), m_size(0)
+{
+}
+
+MappedFile::MappedFile(const std::wstring& filename)
+	: m_file(-1), m_data(nullptr), m_size(0)
+{
+	Open(filename);
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+bool MappedFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	CREATEFILE2_EXTENDED_PARAMETERS extendedParams = { 0 };
+	extendedParams.dwSize = sizeof(CREATEFILE2_EXTENDED_PARAMETERS);
+	extendedParams.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+	extendedParams.dwFileFlags = FILE_FLAG_SEQUENTIAL_SCAN;
+	extendedParams.dwSecurityQosFlags = SECURITY_ANONYMOUS;
+	extendedParams.lpSecurityAttributes = nullptr;
+	extendedParams.hTemplateFile = nullptr;
+
+	m_file.Attach(CreateFile2(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, &extendedParams));
+	if (!m_file.IsValid())
+		return false;
+
+	FILE_STANDARD_INFO fileInfo = { 0 };
+	if (!GetFileInformationByHandleEx(m_file.Get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)) ||
+		fileInfo.EndOfFile.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingFromApp(m_file.Get(), nullptr, PAGE_READONLY, 0, nullptr);
+	if (m_mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = static_cast<const BYTE*>(MapViewOfFileFromApp(m_mapping, FILE_MAP_READ, 0, 0));
+	if (m_data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(fileInfo.EndOfFile.QuadPart);
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	m_file.Close();
+
+	m_mapping = nullptr;
+	m_data = nullptr;
+	m_size = 0;
+}
+#else
+bool MappedFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	// The names used by the engine are ASCII.
+	m_file = open(std::string(filename.begin(), filename.end()).c_str(), O_RDONLY);
+	if (m_file < 0)
+		return false;
+
+	struct stat fileInfo;
+	if (fstat(m_file, &fileInfo) != 0 || fileInfo.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_data = static_cast<const BYTE*>(data);
+	m_size = static_cast<size_t>(fileInfo.st_size);
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+		munmap(const_cast<BYTE*>(m_data), m_size);
+	if (m_file >= 0)
+		close(m_file);
+
+	m_file = -1;
+	m_data = nullptr;
+	m_size = 0;
+}
+#endif
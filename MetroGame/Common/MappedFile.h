@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Windows.h>
+#include <string>
+#if defined(_WIN32)
+#include <wrl/wrappers/corewrappers.h>
+#endif
+
+// Read-only memory mapped view of a whole file. The view stays valid until the
+// object is destroyed, so spans handed out from it must not outlive it.
+// The translation unit doesn't use the precompiled header; off Windows the file is
+// mapped with mmap, so that the loaders using it also build headless.
+namespace DX
+{
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		explicit MappedFile(const std::wstring& filename);
+		~MappedFile();
+
+		// Maps the file. Returns false if it can not be opened or is empty.
+		bool Open(const std::wstring& filename);
+		void Close();
+
+		bool IsOpen()const { return m_data != nullptr; }
+		const BYTE* GetData()const { return m_data; }
+		size_t GetSize()const { return m_size; }
+
+	private:
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+	private:
+#if defined(_WIN32)
+		Microsoft::WRL::Wrappers::FileHandle m_file;
+		HANDLE m_mapping;
+#else
+		int m_file;
+#endif
+		const BYTE* m_data;
+		size_t m_size;
+	};
+}
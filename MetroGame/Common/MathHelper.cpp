@@ -2,7 +2,6 @@
 // MathHelper.cpp by Frank Luna (C) 2011 All Rights Reserved.
 //***************************************************************************************
 
-#include "pch.h"
 #include "MathHelper.h"
 #include <float.h>
 #include <cmath>
@@ -35,6 +34,85 @@ float MathHelper::AngleFromXY(float x, float y)
 	return theta;
 }
 
+bool MathHelper::IntersectRayBox(FXMVECTOR origin, FXMVECTOR direction, const BoundingBox& box, CXMMATRIX world, float& distance)
+{
+	XMVECTOR det;
+	XMMATRIX invWorld = XMMatrixInverse(&det, world);
+	XMVECTOR localOrigin = XMVector3TransformCoord(origin, invWorld);
+	XMVECTOR localDirection = XMVector3Normalize(XMVector3TransformNormal(direction, invWorld));
+
+	float localDistance;
+	if (!box.Intersects(localOrigin, localDirection, localDistance))
+		return false;
+	XMVECTOR hit = XMVector3TransformCoord(XMVectorMultiplyAdd(XMVectorReplicate(localDistance), localDirection, localOrigin), world);
+	distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(hit, origin)));
+	return true;
+}
+
+void MathHelper::InverseTransposeBatch(const XMFLOAT4X4* M, size_t count, XMFLOAT4X4* result, size_t stride)
+{
+	BYTE* dest = reinterpret_cast<BYTE*>(result);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4, dest += 4 * stride)
+	{
+		// Transpose the upper 3x3 of four matrices, so that every register holds
+		// the same element of all of them. The rows are a, b and c.
+		XMMATRIX a = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i]._11)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i + 1]._11)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i + 2]._11)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i + 3]._11))));
+		XMMATRIX b = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i]._21)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i + 1]._21)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i + 2]._21)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i + 3]._21))));
+		XMMATRIX c = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i]._31)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i + 1]._31)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i + 2]._31)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&M[i + 3]._31))));
+
+		// The inverse-transpose is the cofactor matrix divided by the determinant.
+		// Its rows are b x c, c x a and a x b.
+		XMVECTOR r0[3], r1[3], r2[3];
+		r0[0] = XMVectorNegativeMultiplySubtract(b.r[2], c.r[1], XMVectorMultiply(b.r[1], c.r[2]));
+		r0[1] = XMVectorNegativeMultiplySubtract(b.r[0], c.r[2], XMVectorMultiply(b.r[2], c.r[0]));
+		r0[2] = XMVectorNegativeMultiplySubtract(b.r[1], c.r[0], XMVectorMultiply(b.r[0], c.r[1]));
+		r1[0] = XMVectorNegativeMultiplySubtract(c.r[2], a.r[1], XMVectorMultiply(c.r[1], a.r[2]));
+		r1[1] = XMVectorNegativeMultiplySubtract(c.r[0], a.r[2], XMVectorMultiply(c.r[2], a.r[0]));
+		r1[2] = XMVectorNegativeMultiplySubtract(c.r[1], a.r[0], XMVectorMultiply(c.r[0], a.r[1]));
+		r2[0] = XMVectorNegativeMultiplySubtract(a.r[2], b.r[1], XMVectorMultiply(a.r[1], b.r[2]));
+		r2[1] = XMVectorNegativeMultiplySubtract(a.r[0], b.r[2], XMVectorMultiply(a.r[2], b.r[0]));
+		r2[2] = XMVectorNegativeMultiplySubtract(a.r[1], b.r[0], XMVectorMultiply(a.r[0], b.r[1]));
+
+		XMVECTOR det = XMVectorMultiply(a.r[0], r0[0]);
+		det = XMVectorMultiplyAdd(a.r[1], r0[1], det);
+		det = XMVectorMultiplyAdd(a.r[2], r0[2], det);
+		XMVECTOR invDet = XMVectorReciprocal(det);
+
+		XMVECTOR zero = XMVectorZero();
+		XMMATRIX row0 = XMMatrixTranspose(XMMATRIX(XMVectorMultiply(r0[0], invDet),
+			XMVectorMultiply(r0[1], invDet), XMVectorMultiply(r0[2], invDet), zero));
+		XMMATRIX row1 = XMMatrixTranspose(XMMATRIX(XMVectorMultiply(r1[0], invDet),
+			XMVectorMultiply(r1[1], invDet), XMVectorMultiply(r1[2], invDet), zero));
+		XMMATRIX row2 = XMMatrixTranspose(XMMATRIX(XMVectorMultiply(r2[0], invDet),
+			XMVectorMultiply(r2[1], invDet), XMVectorMultiply(r2[2], invDet), zero));
+		XMVECTOR row3 = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		for (int k = 0; k < 4; ++k)
+		{
+			XMFLOAT4X4* out = reinterpret_cast<XMFLOAT4X4*>(dest + k * stride);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&out->_11), row0.r[k]);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&out->_21), row1.r[k]);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&out->_31), row2.r[k]);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&out->_41), row3);
+		}
+	}
+
+	for (; i < count; ++i, dest += stride)
+		XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(dest), InverseTranspose(XMLoadFloat4x4(&M[i])));
+}
+
 XMVECTOR MathHelper::RandUnitVec3()
 {
 	XMVECTOR One  = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
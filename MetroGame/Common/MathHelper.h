@@ -8,6 +8,8 @@
 
 #include <Windows.h>
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdlib>
 
 namespace DX
 {
@@ -65,6 +67,18 @@ namespace DX
 			return DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&det, A));
 		}
 
+		// Same as InverseTranspose for count matrices, four at a time. The i-th result
+		// is written stride bytes after the previous one, so it may be interleaved
+		// with other per-instance data.
+		static void InverseTransposeBatch(const DirectX::XMFLOAT4X4* M, size_t count,
+			DirectX::XMFLOAT4X4* result, size_t stride = sizeof(DirectX::XMFLOAT4X4));
+
+		// Intersects the ray with box transformed by world, in the object space of the
+		// box, so that rotated boxes aren't hit in the corners of their world space
+		// bounds. direction must be normalized; distance is in world space.
+		static bool IntersectRayBox(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction,
+			const DirectX::BoundingBox& box, DirectX::CXMMATRIX world, float& distance);
+
 		static DirectX::XMVECTOR RandUnitVec3();
 		static DirectX::XMVECTOR RandHemisphereUnitVec3(DirectX::XMVECTOR n);
 
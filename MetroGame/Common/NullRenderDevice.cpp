@@ -0,0 +1,272 @@
+#include "NullRenderDevice.h"
+#include "RecordingRenderContext.h"
+#include <atomic>
+#include <new>
+#include <string.h>
+#include <utility>
+
+using namespace DX;
+
+namespace DX
+{
+	// Refcounted, and reports its last Release to the device.
+	template<typename Interface>
+	class NullObject : public Interface
+	{
+	public:
+		NullObject(NullRenderDevice& device, RenderObjectType type) :
+			m_device(device), m_type(type), m_refCount(1)
+		{
+		}
+		virtual ~NullObject() {}
+
+		virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** object)
+		{
+			if (object)
+				*object = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		virtual ULONG STDMETHODCALLTYPE AddRef()
+		{
+			return ++m_refCount;
+		}
+
+		virtual ULONG STDMETHODCALLTYPE Release()
+		{
+			ULONG refCount = --m_refCount;
+			if (refCount == 0)
+			{
+				m_device.Destroyed(m_type, this, GetByteWidth());
+				delete this;
+			}
+			return refCount;
+		}
+
+	protected:
+		virtual UINT GetByteWidth()const { return 0; }
+
+	private:
+		NullRenderDevice& m_device;
+		RenderObjectType m_type;
+		std::atomic<ULONG> m_refCount;
+	};
+}
+
+namespace
+{
+	template<typename Interface, D3D11_RESOURCE_DIMENSION Dimension>
+	class NullResource : public NullObject<Interface>
+	{
+	public:
+		NullResource(NullRenderDevice& device, RenderObjectType type) : NullObject<Interface>(device, type) {}
+
+		virtual void GetType(D3D11_RESOURCE_DIMENSION* resourceDimension)
+		{
+			*resourceDimension = Dimension;
+		}
+	};
+
+	class NullBuffer : public NullResource<ID3D11Buffer, D3D11_RESOURCE_DIMENSION_BUFFER>
+	{
+	public:
+		NullBuffer(NullRenderDevice& device, RenderObjectType type, const D3D11_BUFFER_DESC& desc) :
+			NullResource(device, type), m_desc(desc)
+		{
+		}
+
+		virtual void GetDesc(D3D11_BUFFER_DESC* desc)
+		{
+			*desc = m_desc;
+		}
+
+	protected:
+		virtual UINT GetByteWidth()const { return m_desc.ByteWidth; }
+
+	private:
+		D3D11_BUFFER_DESC m_desc;
+	};
+}
+
+NullRenderDevice::NullRenderDevice(RecordingRenderContext* context) :
+	m_context(context)
+{
+	memset(&m_counters, 0, sizeof(m_counters));
+}
+
+UINT NullRenderDevice::GetLiveObjects()const
+{
+	UINT live = 0;
+	for (UINT type = 0; type < RenderObjectTypeCount; ++type)
+		live += m_counters.Live[type];
+	return live;
+}
+
+template<typename Object, typename Interface, typename... Args>
+HRESULT NullRenderDevice::Create(RenderObjectType type, Interface** object, Args&&... args)
+{
+	if (!object)
+		return E_INVALIDARG;
+	*object = new (std::nothrow) Object(*this, type, std::forward<Args>(args)...);
+	if (!*object)
+		return E_OUTOFMEMORY;
+	++m_counters.Created[(UINT)type];
+	++m_counters.Live[(UINT)type];
+	return S_OK;
+}
+
+void NullRenderDevice::Destroyed(RenderObjectType type, IUnknown* object, UINT byteWidth)
+{
+	--m_counters.Live[(UINT)type];
+	if (type == RenderObjectType::Buffer)
+	{
+		m_counters.LiveBufferBytes -= byteWidth;
+		if (m_context)
+			m_context->UnregisterBuffer(static_cast<ID3D11Buffer*>(object));
+	}
+}
+
+HRESULT NullRenderDevice::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer)
+{
+	// As Direct3D checks them: constant buffers are multiples of 16 bytes, and
+	// immutable ones need their data.
+	if (!desc || desc->ByteWidth == 0 ||
+		((desc->BindFlags & D3D11_BIND_CONSTANT_BUFFER) && desc->ByteWidth % 16) ||
+		(desc->Usage == D3D11_USAGE_IMMUTABLE && !(initialData && initialData->pSysMem)))
+		return E_INVALIDARG;
+	HRESULT hr = Create<NullBuffer>(RenderObjectType::Buffer, buffer, *desc);
+	if (FAILED(hr))
+		return hr;
+	m_counters.LiveBufferBytes += desc->ByteWidth;
+	if (m_context)
+		m_context->RegisterBuffer(*buffer, desc->ByteWidth, desc->BindFlags);
+	return S_OK;
+}
+
+HRESULT NullRenderDevice::CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture1D** texture)
+{
+	if (!desc)
+		return E_INVALIDARG;
+	return Create<NullResource<ID3D11Texture1D, D3D11_RESOURCE_DIMENSION_TEXTURE1D>>(RenderObjectType::Texture, texture);
+}
+
+HRESULT NullRenderDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture2D** texture)
+{
+	if (!desc || desc->Width == 0 || desc->Height == 0 || desc->ArraySize == 0)
+		return E_INVALIDARG;
+	return Create<NullResource<ID3D11Texture2D, D3D11_RESOURCE_DIMENSION_TEXTURE2D>>(RenderObjectType::Texture, texture);
+}
+
+HRESULT NullRenderDevice::CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture3D** texture)
+{
+	if (!desc)
+		return E_INVALIDARG;
+	return Create<NullResource<ID3D11Texture3D, D3D11_RESOURCE_DIMENSION_TEXTURE3D>>(RenderObjectType::Texture, texture);
+}
+
+HRESULT NullRenderDevice::CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC*,
+	ID3D11ShaderResourceView** view)
+{
+	if (!resource)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11ShaderResourceView>>(RenderObjectType::View, view);
+}
+
+HRESULT NullRenderDevice::CreateUnorderedAccessView(ID3D11Resource* resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC*,
+	ID3D11UnorderedAccessView** view)
+{
+	if (!resource)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11UnorderedAccessView>>(RenderObjectType::View, view);
+}
+
+HRESULT NullRenderDevice::CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC*,
+	ID3D11RenderTargetView** view)
+{
+	if (!resource)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11RenderTargetView>>(RenderObjectType::View, view);
+}
+
+HRESULT NullRenderDevice::CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC*,
+	ID3D11DepthStencilView** view)
+{
+	if (!resource)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11DepthStencilView>>(RenderObjectType::View, view);
+}
+
+HRESULT NullRenderDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT numElements,
+	const void*, SIZE_T, ID3D11InputLayout** inputLayout)
+{
+	if (!elements || numElements == 0)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11InputLayout>>(RenderObjectType::InputLayout, inputLayout);
+}
+
+HRESULT NullRenderDevice::CreateVertexShader(const void*, SIZE_T, ID3D11ClassLinkage*, ID3D11VertexShader** shader)
+{
+	return Create<NullObject<ID3D11VertexShader>>(RenderObjectType::Shader, shader);
+}
+
+HRESULT NullRenderDevice::CreateHullShader(const void*, SIZE_T, ID3D11ClassLinkage*, ID3D11HullShader** shader)
+{
+	return Create<NullObject<ID3D11HullShader>>(RenderObjectType::Shader, shader);
+}
+
+HRESULT NullRenderDevice::CreateDomainShader(const void*, SIZE_T, ID3D11ClassLinkage*, ID3D11DomainShader** shader)
+{
+	return Create<NullObject<ID3D11DomainShader>>(RenderObjectType::Shader, shader);
+}
+
+HRESULT NullRenderDevice::CreateGeometryShader(const void*, SIZE_T, ID3D11ClassLinkage*, ID3D11GeometryShader** shader)
+{
+	return Create<NullObject<ID3D11GeometryShader>>(RenderObjectType::Shader, shader);
+}
+
+HRESULT NullRenderDevice::CreateGeometryShaderWithStreamOutput(const void*, SIZE_T,
+	const D3D11_SO_DECLARATION_ENTRY* entries, UINT numEntries, const UINT*, UINT,
+	UINT, ID3D11ClassLinkage*, ID3D11GeometryShader** shader)
+{
+	if (!entries || numEntries == 0)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11GeometryShader>>(RenderObjectType::Shader, shader);
+}
+
+HRESULT NullRenderDevice::CreatePixelShader(const void*, SIZE_T, ID3D11ClassLinkage*, ID3D11PixelShader** shader)
+{
+	return Create<NullObject<ID3D11PixelShader>>(RenderObjectType::Shader, shader);
+}
+
+HRESULT NullRenderDevice::CreateComputeShader(const void*, SIZE_T, ID3D11ClassLinkage*, ID3D11ComputeShader** shader)
+{
+	return Create<NullObject<ID3D11ComputeShader>>(RenderObjectType::Shader, shader);
+}
+
+HRESULT NullRenderDevice::CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state)
+{
+	if (!desc)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11BlendState>>(RenderObjectType::State, state);
+}
+
+HRESULT NullRenderDevice::CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state)
+{
+	if (!desc)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11DepthStencilState>>(RenderObjectType::State, state);
+}
+
+HRESULT NullRenderDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state)
+{
+	if (!desc)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11RasterizerState>>(RenderObjectType::State, state);
+}
+
+HRESULT NullRenderDevice::CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** state)
+{
+	if (!desc)
+		return E_INVALIDARG;
+	return Create<NullObject<ID3D11SamplerState>>(RenderObjectType::State, state);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+// Creates objects that only know what they are, so that the CPU side of the scenes
+// runs without a GPU, e.g. in SceneBenchmark on Linux. The objects are refcounted
+// and deleted on their last Release; buffers keep their description, and resources
+// their type. Any byte code makes a shader. Buffers are registered with the
+// RecordingRenderContext given, so that its maps expose their size, and forgotten
+// once released. It counts what it creates and what is still alive, must outlive
+// its objects and, like the context, is used from one thread.
+// It only builds against the stand-in headers of the Headless directory, as the
+// Windows interfaces have methods the null objects don't implement; the translation
+// unit doesn't use the precompiled header.
+
+namespace DX
+{
+	class RecordingRenderContext;
+	template<typename Interface>
+	class NullObject;
+
+	enum class RenderObjectType : UINT8
+	{
+		Buffer,
+		Texture,
+		View,
+		Shader,
+		InputLayout,
+		State,
+		Count
+	};
+	const UINT RenderObjectTypeCount = (UINT)RenderObjectType::Count;
+
+	struct RenderObjectCounters
+	{
+		UINT Created[RenderObjectTypeCount];
+		UINT Live[RenderObjectTypeCount];
+		UINT64 LiveBufferBytes;
+	};
+
+	class NullRenderDevice : public RenderDevice
+	{
+	public:
+		explicit NullRenderDevice(RecordingRenderContext* context = nullptr);
+
+		const RenderObjectCounters& GetCounters()const { return m_counters; }
+		// Objects not released yet, of all types.
+		UINT GetLiveObjects()const;
+
+		virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer);
+		virtual HRESULT CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture1D** texture);
+		virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture);
+		virtual HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture);
+
+		virtual HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc,
+			ID3D11ShaderResourceView** view);
+		virtual HRESULT CreateUnorderedAccessView(ID3D11Resource* resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC* desc,
+			ID3D11UnorderedAccessView** view);
+		virtual HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc,
+			ID3D11RenderTargetView** view);
+		virtual HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc,
+			ID3D11DepthStencilView** view);
+
+		virtual HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT numElements,
+			const void* byteCode, SIZE_T byteCodeLength, ID3D11InputLayout** inputLayout);
+		virtual HRESULT CreateVertexShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11VertexShader** shader);
+		virtual HRESULT CreateHullShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11HullShader** shader);
+		virtual HRESULT CreateDomainShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11DomainShader** shader);
+		virtual HRESULT CreateGeometryShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11GeometryShader** shader);
+		virtual HRESULT CreateGeometryShaderWithStreamOutput(const void* byteCode, SIZE_T byteCodeLength,
+			const D3D11_SO_DECLARATION_ENTRY* entries, UINT numEntries, const UINT* strides, UINT numStrides,
+			UINT rasterizedStream, ID3D11ClassLinkage* classLinkage, ID3D11GeometryShader** shader);
+		virtual HRESULT CreatePixelShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11PixelShader** shader);
+		virtual HRESULT CreateComputeShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11ComputeShader** shader);
+
+		virtual HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state);
+		virtual HRESULT CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state);
+		virtual HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state);
+		virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** state);
+
+	private:
+		template<typename Interface>
+		friend class NullObject;
+
+		// Creates an object of type Object, returned as its interface.
+		template<typename Object, typename Interface, typename... Args>
+		HRESULT Create(RenderObjectType type, Interface** object, Args&&... args);
+		void Destroyed(RenderObjectType type, IUnknown* object, UINT byteWidth);
+
+	private:
+		RecordingRenderContext* m_context;
+		RenderObjectCounters m_counters;
+	};
+}
@@ -0,0 +1,258 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+using namespace DX;
+using namespace DirectX;
+
+OcclusionCuller::OcclusionCuller(UINT width, UINT height) :
+	m_width((width + 3) & ~3u),
+	m_height(height)
+{
+	UINT w = m_width, h = m_height;
+	for (;;)
+	{
+		m_levelSizes.push_back(XMUINT2(w, h));
+		m_levels.push_back(std::vector<float>(w * h, 1.0f));
+		if (w == 1 && h == 1)
+			break;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+	XMStoreFloat4x4(&m_viewProj, XMMatrixIdentity());
+}
+
+void OcclusionCuller::Clear(const XMFLOAT4X4& viewProj)
+{
+	m_viewProj = viewProj;
+	std::fill(m_levels[0].begin(), m_levels[0].end(), 1.0f);
+}
+
+void OcclusionCuller::RasterizeOccluder(const XMFLOAT3* positions, UINT stride,
+	const UINT* indices, UINT count, const XMFLOAT4X4& world)
+{
+	Rasterize(positions, stride, indices, count, world);
+}
+
+void OcclusionCuller::RasterizeOccluder(const XMFLOAT3* positions, UINT stride,
+	const USHORT* indices, UINT count, const XMFLOAT4X4& world)
+{
+	Rasterize(positions, stride, indices, count, world);
+}
+
+template<typename Index>
+void OcclusionCuller::Rasterize(const XMFLOAT3* positions, UINT stride,
+	const Index* indices, UINT count, const XMFLOAT4X4& world)
+{
+	// Only the positions the triangles use are moved to clip space.
+	UINT vertexCount = count;
+	if (indices)
+	{
+		vertexCount = 0;
+		for (UINT i = 0; i < count; ++i)
+			vertexCount = (std::max)(vertexCount, (UINT)indices[i] + 1);
+	}
+
+	XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&m_viewProj));
+	m_clipPositions.resize(vertexCount);
+	XMVector3TransformStream(m_clipPositions.data(), sizeof(XMFLOAT4), positions, stride, vertexCount, worldViewProj);
+
+	for (UINT i = 0; i + 2 < count; i += 3)
+	{
+		XMVECTOR a = XMLoadFloat4(&m_clipPositions[indices ? indices[i] : i]);
+		XMVECTOR b = XMLoadFloat4(&m_clipPositions[indices ? indices[i + 1] : i + 1]);
+		XMVECTOR c = XMLoadFloat4(&m_clipPositions[indices ? indices[i + 2] : i + 2]);
+		RasterizeClipped(a, b, c);
+	}
+}
+
+// Drops triangles outside one side of the frustum, clips the others against the
+// near plane and projects them to the buffer.
+void OcclusionCuller::RasterizeClipped(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c)
+{
+	XMFLOAT4 v[3];
+	XMStoreFloat4(&v[0], a);
+	XMStoreFloat4(&v[1], b);
+	XMStoreFloat4(&v[2], c);
+	int outside[6] = {};
+	for (int i = 0; i < 3; ++i)
+	{
+		outside[0] += v[i].x > v[i].w;
+		outside[1] += v[i].x < -v[i].w;
+		outside[2] += v[i].y > v[i].w;
+		outside[3] += v[i].y < -v[i].w;
+		outside[4] += v[i].z > v[i].w;
+		outside[5] += v[i].z < 0.0f;
+	}
+	for (int k = 0; k < 6; ++k)
+		if (outside[k] == 3)
+			return;
+
+	// Keep the part with z >= 0, at most a quad.
+	XMVECTOR in[3] = { a, b, c };
+	XMVECTOR out[4];
+	UINT outCount = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		XMVECTOR p = in[i], q = in[(i + 1) % 3];
+		float dp = XMVectorGetZ(p), dq = XMVectorGetZ(q);
+		if (dp >= 0.0f)
+			out[outCount++] = p;
+		if ((dp >= 0.0f) != (dq >= 0.0f))
+			out[outCount++] = XMVectorLerp(p, q, dp / (dp - dq));
+	}
+	if (outCount < 3)
+		return;
+
+	XMFLOAT3 screen[4];
+	for (UINT i = 0; i < outCount; ++i)
+	{
+		XMFLOAT4 p;
+		XMStoreFloat4(&p, out[i]);
+		float invW = 1.0f / p.w;
+		screen[i].x = (p.x * invW * 0.5f + 0.5f) * m_width;
+		screen[i].y = (0.5f - p.y * invW * 0.5f) * m_height;
+		screen[i].z = p.z * invW;
+	}
+	RasterizeTriangle(screen[0], screen[1], screen[2]);
+	if (outCount == 4)
+		RasterizeTriangle(screen[0], screen[2], screen[3]);
+}
+
+void OcclusionCuller::RasterizeTriangle(const XMFLOAT3& a, const XMFLOAT3& b0, const XMFLOAT3& c0)
+{
+	// Both windings are drawn, so that open meshes like floors occlude from both sides.
+	float area = (b0.x - a.x) * (c0.y - a.y) - (b0.y - a.y) * (c0.x - a.x);
+	if (area == 0.0f)
+		return;
+	const XMFLOAT3& b = area > 0.0f ? b0 : c0;
+	const XMFLOAT3& c = area > 0.0f ? c0 : b0;
+	area = fabsf(area);
+
+	// Pixels whose center is inside the bounds of the triangle.
+	int minX = (std::max)(0, (int)ceilf((std::min)((std::min)(a.x, b.x), c.x) - 0.5f));
+	int maxX = (std::min)((int)m_width - 1, (int)floorf((std::max)((std::max)(a.x, b.x), c.x) - 0.5f));
+	int minY = (std::max)(0, (int)ceilf((std::min)((std::min)(a.y, b.y), c.y) - 0.5f));
+	int maxY = (std::min)((int)m_height - 1, (int)floorf((std::max)((std::max)(a.y, b.y), c.y) - 0.5f));
+	if (minX > maxX || minY > maxY)
+		return;
+	minX &= ~3;
+
+	// Edge functions A * x + B * y + C, positive inside. Edge i is opposite vertex i.
+	const XMFLOAT3* v[3] = { &a, &b, &c };
+	float A[3], B[3], C[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		const XMFLOAT3& p = *v[(i + 1) % 3];
+		const XMFLOAT3& q = *v[(i + 2) % 3];
+		A[i] = p.y - q.y;
+		B[i] = q.x - p.x;
+		C[i] = -(A[i] * p.x + B[i] * p.y);
+	}
+	// Depth is linear in screen space; the edge functions over the area are barycentrics.
+	float invArea = 1.0f / area;
+	float zA = (A[0] * a.z + A[1] * b.z + A[2] * c.z) * invArea;
+	float zB = (B[0] * a.z + B[1] * b.z + B[2] * c.z) * invArea;
+	float zC = (C[0] * a.z + C[1] * b.z + C[2] * c.z) * invArea;
+	// Pixel centers within 1/64 pixel outside an edge are covered too, so that the
+	// rounding of the edge functions leaves no cracks between the triangles of an
+	// occluder, which share their edges.
+	for (int i = 0; i < 3; ++i)
+		C[i] += (fabsf(A[i]) + fabsf(B[i])) * (1.0f / 64.0f);
+
+	XMVECTOR x0 = XMVectorAdd(XMVectorReplicate((float)minX), XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f));
+	XMVECTOR stepE[3], stepZ = XMVectorReplicate(4.0f * zA);
+	for (int i = 0; i < 3; ++i)
+		stepE[i] = XMVectorReplicate(4.0f * A[i]);
+
+	std::vector<float>& depth = m_levels[0];
+	for (int y = minY; y <= maxY; ++y)
+	{
+		float py = y + 0.5f;
+		XMVECTOR e[3];
+		for (int i = 0; i < 3; ++i)
+			e[i] = XMVectorMultiplyAdd(XMVectorReplicate(A[i]), x0, XMVectorReplicate(B[i] * py + C[i]));
+		XMVECTOR z = XMVectorMultiplyAdd(XMVectorReplicate(zA), x0, XMVectorReplicate(zB * py + zC));
+
+		float* row = &depth[y * m_width];
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			XMVECTOR inside = XMVectorGreaterOrEqual(e[0], XMVectorZero());
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(e[1], XMVectorZero()));
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(e[2], XMVectorZero()));
+			if (!XMVector4EqualInt(inside, XMVectorFalseInt()))
+			{
+				XMVECTOR old = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x));
+				XMVECTOR nearer = XMVectorMin(old, XMVectorMax(z, XMVectorZero()));
+				XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(row + x), XMVectorSelect(old, nearer, inside));
+			}
+			for (int i = 0; i < 3; ++i)
+				e[i] = XMVectorAdd(e[i], stepE[i]);
+			z = XMVectorAdd(z, stepZ);
+		}
+	}
+}
+
+void OcclusionCuller::Finalize()
+{
+	for (size_t l = 1; l < m_levels.size(); ++l)
+	{
+		const std::vector<float>& src = m_levels[l - 1];
+		std::vector<float>& dest = m_levels[l];
+		UINT srcWidth = m_levelSizes[l - 1].x, srcHeight = m_levelSizes[l - 1].y;
+		UINT width = m_levelSizes[l].x, height = m_levelSizes[l].y;
+		for (UINT y = 0; y < height; ++y)
+		{
+			UINT y0 = 2 * y, y1 = (std::min)(2 * y + 1, srcHeight - 1);
+			for (UINT x = 0; x < width; ++x)
+			{
+				UINT x0 = 2 * x, x1 = (std::min)(2 * x + 1, srcWidth - 1);
+				dest[y * width + x] = (std::max)(
+					(std::max)(src[y0 * srcWidth + x0], src[y0 * srcWidth + x1]),
+					(std::max)(src[y1 * srcWidth + x0], src[y1 * srcWidth + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const BoundingBox& box, const XMFLOAT4X4& world)const
+{
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+	XMFLOAT4 clip[BoundingBox::CORNER_COUNT];
+	XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&m_viewProj));
+	XMVector3TransformStream(clip, sizeof(XMFLOAT4), corners, sizeof(XMFLOAT3), BoundingBox::CORNER_COUNT, worldViewProj);
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for (size_t i = 0; i < BoundingBox::CORNER_COUNT; ++i)
+	{
+		if (clip[i].z < 0.0f || clip[i].w <= 0.0f)
+			return true;
+		float invW = 1.0f / clip[i].w;
+		float x = (clip[i].x * invW * 0.5f + 0.5f) * m_width;
+		float y = (0.5f - clip[i].y * invW * 0.5f) * m_height;
+		minX = (std::min)(minX, x); maxX = (std::max)(maxX, x);
+		minY = (std::min)(minY, y); maxY = (std::max)(maxY, y);
+		minZ = (std::min)(minZ, clip[i].z * invW);
+	}
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height)
+		return false;
+
+	// Every pixel the box touches, not only those whose center it covers.
+	UINT x0 = (UINT)(std::max)(minX, 0.0f), x1 = (UINT)(std::min)(maxX, m_width - 1.0f);
+	UINT y0 = (UINT)(std::max)(minY, 0.0f), y1 = (UINT)(std::min)(maxY, m_height - 1.0f);
+
+	// The finest level where the rectangle spans at most 4x4 texels.
+	UINT level = 0;
+	while (level + 1 < m_levels.size() && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+		++level;
+
+	const std::vector<float>& depth = m_levels[level];
+	UINT width = m_levelSizes[level].x;
+	for (UINT y = y0 >> level; y <= y1 >> level; ++y)
+		for (UINT x = x0 >> level; x <= x1 >> level; ++x)
+			if (depth[y * width + x] >= minZ)
+				return true;
+	return false;
+}
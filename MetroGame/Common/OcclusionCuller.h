@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+
+// Software occlusion culling for the camera pass. A few large, low-poly
+// occluders are rasterized on the CPU into a small depth buffer, four pixels at
+// a time, and the farthest depth of every 2x2 block is kept in a pyramid. The
+// screen rectangle of a bounding box is then compared against a level where it
+// covers a few texels: it is hidden if every texel is closer than the box.
+// Occluders cover the pixels whose center they contain, so objects peeking
+// through less than a pixel of the small buffer may be culled.
+// The translation unit doesn't use the precompiled header, so that the culling
+// tests build headless.
+
+namespace DX
+{
+	class OcclusionCuller
+	{
+	public:
+		// width is rounded up to a multiple of four.
+		OcclusionCuller(UINT width = 256, UINT height = 128);
+
+		// Clears the depth buffer for a new frame. viewProj is untransposed.
+		void Clear(const DirectX::XMFLOAT4X4& viewProj);
+		// Rasterizes the triangle list with the given world. Without indices, every
+		// three positions make a triangle and count is the number of positions.
+		void RasterizeOccluder(const DirectX::XMFLOAT3* positions, UINT stride,
+			const UINT* indices, UINT count, const DirectX::XMFLOAT4X4& world);
+		void RasterizeOccluder(const DirectX::XMFLOAT3* positions, UINT stride,
+			const USHORT* indices, UINT count, const DirectX::XMFLOAT4X4& world);
+		// Builds the depth pyramid after the last occluder.
+		void Finalize();
+
+		// box is in object space. Boxes crossing the near plane are always visible.
+		bool IsVisible(const DirectX::BoundingBox& box, const DirectX::XMFLOAT4X4& world)const;
+
+	public:
+		const DirectX::XMFLOAT4X4& GetViewProj()const { return m_viewProj; }
+		UINT GetWidth()const { return m_width; }
+		UINT GetHeight()const { return m_height; }
+
+	private:
+		template<typename Index>
+		void Rasterize(const DirectX::XMFLOAT3* positions, UINT stride,
+			const Index* indices, UINT count, const DirectX::XMFLOAT4X4& world);
+		void RasterizeClipped(DirectX::FXMVECTOR a, DirectX::FXMVECTOR b, DirectX::FXMVECTOR c);
+		void RasterizeTriangle(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, const DirectX::XMFLOAT3& c);
+
+	private:
+		UINT m_width;
+		UINT m_height;
+		DirectX::XMFLOAT4X4 m_viewProj;
+
+		// Post projection depth, level 0 is the rasterized buffer and every
+		// further level holds the farthest depth of 2x2 texels of the previous one.
+		std::vector<std::vector<float>> m_levels;
+		std::vector<DirectX::XMUINT2> m_levelSizes;
+		std::vector<DirectX::XMFLOAT4> m_clipPositions;
+	};
+}
@@ -0,0 +1,32 @@
+#include "PathReplay.h"
+#include <algorithm>
+
+using namespace DX;
+
+const double PathReplay::StepSeconds = 1.0 / 60;
+
+PathReplay::PathReplay() :
+	m_frameCount(0), m_step(0), m_running(false)
+{
+}
+
+void PathReplay::Start(const CameraPath& path, UINT frameCount, GameTimer& timer)
+{
+	m_path = path;
+	timer.SetTargetElapsedSeconds(StepSeconds);
+	m_frameCount = frameCount > 0 ? frameCount : (std::max)((UINT)(m_path.GetDuration() / StepSeconds), 1u);
+	m_stats = FrameStats(m_frameCount);
+	m_step = 0;
+	m_running = true;
+}
+
+bool PathReplay::AddFrame(double frameMs, double updateMs, double renderMs)
+{
+	if (!m_running || m_step == 0)
+		return false;
+	m_stats.AddFrame(frameMs, updateMs, renderMs);
+	if (m_stats.GetTotalFrames() < m_frameCount)
+		return false;
+	m_running = false;
+	return true;
+}
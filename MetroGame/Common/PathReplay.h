@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CameraPath.h"
+#include "FrameStats.h"
+#include "GameTimer.h"
+
+// Replays a camera path for a benchmark. Every frame steps the timer exactly once
+// by a fixed 1/60 s and poses the camera at that many steps along the path, so
+// that every run updates the scene the same whatever its frame times. The frames
+// from the first step on go to the statistics. DXFrameworkMain and the headless
+// SceneBenchmark both drive their scenes through it.
+// The translation unit doesn't use the precompiled header.
+
+namespace DX
+{
+	class PathReplay
+	{
+	public:
+		static const double StepSeconds;
+
+		PathReplay();
+
+		// Replays frameCount frames, or the length of the path for 0, and sets the
+		// step of timer.
+		void Start(const CameraPath& path, UINT frameCount, GameTimer& timer);
+		void Stop() { m_running = false; }
+
+		// Steps timer once, posing camera along the path before update runs.
+		template<typename TUpdate>
+		void Step(GameTimer& timer, Camera& camera, const TUpdate& update)
+		{
+			timer.Step([&]()
+			{
+				m_path.Apply(m_step++ * timer.GetElapsedSeconds(), camera);
+				update();
+			});
+		}
+
+		// Adds the times of a frame that ended, ignored before the first step. True
+		// once the last frame is in, which stops the replay.
+		bool AddFrame(double frameMs, double updateMs, double renderMs);
+
+		bool IsRunning()const { return m_running; }
+		UINT GetFrameCount()const { return m_frameCount; }
+		const CameraPath& GetPath()const { return m_path; }
+		const FrameStats& GetStats()const { return m_stats; }
+
+	private:
+		CameraPath m_path;
+		FrameStats m_stats;
+		UINT m_frameCount;
+		UINT m_step;
+		bool m_running;
+	};
+}
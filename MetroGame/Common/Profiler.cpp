@@ -0,0 +1,266 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <stdexcept>
+
+#if DX_PROFILE
+using namespace DX;
+
+Profiler* Profiler::m_instance = nullptr;
+UINT Profiler::m_generations = 0;
+thread_local UINT Profiler::t_generation = 0;
+thread_local ProfileThread* Profiler::t_thread = nullptr;
+
+namespace
+{
+	UINT64 QpcNow()
+	{
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		return counter.QuadPart;
+	}
+
+	double QpcFrequency()
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return (double)frequency.QuadPart;
+	}
+
+#if DX_PROFILE_RDTSC
+	// Now between the two closest of ClockReads pairs of QPC reads, with the QPC
+	// time halfway between them.
+	void ReadClocks(UINT64& qpc, UINT64& ticks)
+	{
+		UINT64 gap = UINT64_MAX;
+		qpc = ticks = 0;
+		for (UINT k = 0; k < Profiler::ClockReads; ++k)
+		{
+			UINT64 before = QpcNow();
+			UINT64 now = Profiler::Now();
+			UINT64 after = QpcNow();
+			if (after - before < gap)
+			{
+				gap = after - before;
+				qpc = before + gap / 2;
+				ticks = now;
+			}
+		}
+	}
+#endif
+
+	UINT BucketOf(double ms)
+	{
+		double us = ms * 1000.0;
+		if (us < 1.0)
+			return 0;
+		return (std::min)(1 + (UINT)(4.0 * log2(us)), ProfileZoneStats::BucketCount - 1);
+	}
+}
+
+double ProfileZoneStats::GetPercentileMs(double p)const
+{
+	UINT64 rank = (UINT64)ceil(p * Calls);
+	UINT64 count = 0;
+	for (UINT k = 0; k < BucketCount; ++k)
+	{
+		count += Buckets[k];
+		if (count >= rank && count > 0)
+			return (std::min)(pow(2.0, k / 4.0) / 1000.0, MaxMs);
+	}
+	return MaxMs;
+}
+
+Profiler::Profiler(double ticksPerSecond) :
+	m_dropped(0), m_captureFrames(0), m_fixedRate(ticksPerSecond > 0.0), m_zoneOverheadNs(0.0),
+	m_generation(++m_generations)
+{
+	if (m_instance == nullptr)
+		m_instance = this;
+	else
+		throw std::logic_error("Cannot create more than one Profiler!");
+
+	m_qpcStart = QpcNow();
+	m_ticksStart = Now();
+	m_ticksPerSecond = m_fixedRate ? ticksPerSecond : QpcFrequency();
+#if DX_PROFILE_RDTSC
+	// Busy-waits for a first rate, which converts the zones drained before
+	// Calibrate has measured over long enough to refine it.
+	if (!m_fixedRate)
+	{
+		ReadClocks(m_qpcStart, m_ticksStart);
+		while (QpcNow() - m_qpcStart < QpcFrequency() * CalibrationMs / 1000);
+		UINT64 qpc, ticks;
+		ReadClocks(qpc, ticks);
+		m_ticksPerSecond = (ticks - m_ticksStart) * QpcFrequency() / (qpc - m_qpcStart);
+	}
+#endif
+	MeasureZoneOverhead();
+}
+
+Profiler::~Profiler()
+{
+	m_instance = nullptr;
+}
+
+ProfileThread* Profiler::RegisterThread()
+{
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	m_threads.push_back(std::make_unique<ProfileThread>((UINT)m_threads.size()));
+	t_thread = m_threads.back().get();
+	t_generation = m_generation;
+	return t_thread;
+}
+
+void Profiler::EndFrame()
+{
+	Calibrate();
+	{
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		for (auto& thread : m_threads)
+			Drain(*thread);
+	}
+
+	if (m_captureFrames > 0)
+	{
+		--m_captureFrames;
+		m_captureFrameStarts.push_back(Now());
+	}
+}
+
+void Profiler::Drain(ProfileThread& thread)
+{
+	UINT64 read = thread.m_read.load(std::memory_order_relaxed);
+	UINT64 write = thread.m_write.load(std::memory_order_acquire);
+	for (; read != write; ++read)
+	{
+		const ProfileEvent& e = thread.m_events[read & (ProfileThread::Capacity - 1)];
+		auto it = m_stats.find(e.Name);
+		if (it == m_stats.end())
+		{
+			ProfileZoneStats stats = {};
+			stats.Name = e.Name;
+			stats.MinMs = DBL_MAX;
+			it = m_stats.emplace(e.Name, stats).first;
+		}
+
+		ProfileZoneStats& stats = it->second;
+		double ms = TicksToMs(e.End - e.Start);
+		++stats.Calls;
+		stats.TotalMs += ms;
+		stats.MinMs = (std::min)(stats.MinMs, ms);
+		stats.MaxMs = (std::max)(stats.MaxMs, ms);
+		++stats.Buckets[BucketOf(ms)];
+
+		if (m_captureFrames > 0)
+			m_capture.push_back({ e, thread.m_id });
+	}
+	thread.m_read.store(read, std::memory_order_release);
+	m_dropped += thread.m_dropped.exchange(0, std::memory_order_relaxed);
+}
+
+void Profiler::Calibrate()
+{
+#if DX_PROFILE_RDTSC
+	// The time stamp counter runs at a constant rate, measured over the whole run.
+	if (m_fixedRate)
+		return;
+	UINT64 qpc, ticks;
+	ReadClocks(qpc, ticks);
+	if (qpc - m_qpcStart > QpcFrequency() / 10)
+		m_ticksPerSecond = (ticks - m_ticksStart) * QpcFrequency() / (qpc - m_qpcStart);
+#endif
+}
+
+void Profiler::Capture(UINT frameCount)
+{
+	m_capture.clear();
+	m_captureFrameStarts.assign(1, Now());
+	m_captureFrames = frameCount;
+}
+
+void Profiler::WriteChromeTrace(std::ostream& out)
+{
+	UINT64 origin = m_captureFrameStarts.empty() ? 0 : m_captureFrameStarts.front();
+	auto us = [&](UINT64 ticks) { return TicksToMs(ticks - origin) * 1000.0; };
+
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for (UINT i = 0; i < m_threads.size(); ++i)
+	{
+		out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << i
+			<< ",\"args\":{\"name\":\"" << (i == 0 ? "Main" : "Thread ") << (i == 0 ? "" : std::to_string(i)) << "\"}},\n";
+	}
+	for (size_t k = 0; k < m_captureFrameStarts.size(); ++k)
+	{
+		out << "{\"ph\":\"i\",\"s\":\"g\",\"name\":\"Frame " << k << "\",\"pid\":0,\"tid\":0,\"ts\":"
+			<< us(m_captureFrameStarts[k]) << "},\n";
+	}
+	for (size_t k = 0; k < m_capture.size(); ++k)
+	{
+		const ProfileEvent& e = m_capture[k].Event;
+		if (e.Start < origin)
+			continue;
+		out << "{\"ph\":\"X\",\"name\":\"" << e.Name << "\",\"pid\":0,\"tid\":" << m_capture[k].Thread
+			<< ",\"ts\":" << us(e.Start) << ",\"dur\":" << TicksToMs(e.End - e.Start) * 1000.0
+			<< ",\"args\":{\"depth\":" << e.Depth << "}},\n";
+	}
+	// Chrome accepts no trailing comma, so the list ends on a metadata event.
+	out << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":0,\"args\":{\"name\":\"MetroGame\"}}\n]}\n";
+
+	m_capture.clear();
+	m_captureFrameStarts.clear();
+}
+
+std::vector<ProfileZoneStats> Profiler::GetZoneStats()const
+{
+	// A name may be spelled by several literals.
+	std::vector<ProfileZoneStats> zones;
+	for (auto& entry : m_stats)
+	{
+		const ProfileZoneStats& stats = entry.second;
+		auto it = std::find_if(zones.begin(), zones.end(), [&](const ProfileZoneStats& z) { return z.Name == stats.Name; });
+		if (it == zones.end())
+		{
+			zones.push_back(stats);
+			continue;
+		}
+		it->Calls += stats.Calls;
+		it->TotalMs += stats.TotalMs;
+		it->MinMs = (std::min)(it->MinMs, stats.MinMs);
+		it->MaxMs = (std::max)(it->MaxMs, stats.MaxMs);
+		for (UINT k = 0; k < ProfileZoneStats::BucketCount; ++k)
+			it->Buckets[k] += stats.Buckets[k];
+	}
+	std::sort(zones.begin(), zones.end(), [](const ProfileZoneStats& a, const ProfileZoneStats& b) { return a.TotalMs > b.TotalMs; });
+	return zones;
+}
+
+void Profiler::ResetStats()
+{
+	m_stats.clear();
+	m_dropped = 0;
+}
+
+void Profiler::MeasureZoneOverhead()
+{
+	// Empty zones in batches the ring holds, dropped afterwards.
+	const UINT Batches = 16;
+	const UINT BatchZones = ProfileThread::Capacity / 2;
+	ProfileThread* thread = GetThread();
+	UINT64 best = UINT64_MAX;
+	for (UINT b = 0; b < Batches; ++b)
+	{
+		UINT64 start = QpcNow();
+		for (UINT k = 0; k < BatchZones; ++k)
+		{
+			DX_PROFILE_ZONE("Profiler overhead");
+		}
+		best = (std::min)(best, QpcNow() - start);
+		thread->m_read.store(thread->m_write.load());
+	}
+	m_zoneOverheadNs = best * 1e9 / QpcFrequency() / BatchZones;
+}
+#endif
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#define DX_PROFILE_RDTSC 1
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define DX_PROFILE_RDTSC 1
+#endif
+
+// Hierarchical CPU profiler. DX_PROFILE_ZONE("Name") times the rest of its scope on
+// the calling thread; zones nest. Every thread writes its finished zones to its own
+// ring buffer without locking, and the main thread drains all of them once a frame,
+// folding them into per-zone statistics and, while capturing, keeping them for a
+// Chrome trace (chrome://tracing or ui.perfetto.dev). A zone reads the time stamp
+// counter twice and stores one event; a full ring drops events.
+// Defining DX_SHIPPING compiles the profiler and every zone out.
+// The translation unit doesn't use the precompiled header, so that the profiler
+// tests build headless.
+
+#if !defined(DX_PROFILE)
+#if defined(DX_SHIPPING)
+#define DX_PROFILE 0
+#else
+#define DX_PROFILE 1
+#endif
+#endif
+
+#if DX_PROFILE
+#define DX_PROFILE_CONCAT_(a, b) a##b
+#define DX_PROFILE_CONCAT(a, b) DX_PROFILE_CONCAT_(a, b)
+// name must be a string literal, or live as long as the profiler.
+#define DX_PROFILE_ZONE(name) DX::ProfileZone DX_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define DX_PROFILE_ZONE(name)
+#endif
+
+#if DX_PROFILE
+namespace DX
+{
+	struct ProfileEvent
+	{
+		const char* Name;
+		UINT64 Start;	// Profiler::Now ticks
+		UINT64 End;
+		UINT Depth;		// Enclosing zones
+	};
+
+	// Zones of one thread, written by it and read by the main thread.
+	class ProfileThread
+	{
+	public:
+		static const UINT Capacity = 1 << 14;
+
+		explicit ProfileThread(UINT id) : m_id(id), m_depth(0), m_write(0), m_read(0), m_dropped(0), m_events(Capacity) {}
+
+		void Enter() { ++m_depth; }
+		void Leave(const char* name, UINT64 start, UINT64 end)
+		{
+			UINT64 write = m_write.load(std::memory_order_relaxed);
+			if (write - m_read.load(std::memory_order_acquire) >= Capacity)
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				--m_depth;
+				return;
+			}
+			ProfileEvent& e = m_events[write & (Capacity - 1)];
+			e.Name = name;
+			e.Start = start;
+			e.End = end;
+			e.Depth = --m_depth;
+			m_write.store(write + 1, std::memory_order_release);
+		}
+
+	private:
+		friend class Profiler;
+		UINT m_id;
+		UINT m_depth;
+		std::atomic<UINT64> m_write;
+		std::atomic<UINT64> m_read;
+		std::atomic<UINT> m_dropped;
+		std::vector<ProfileEvent> m_events;
+	};
+
+	// Durations of a zone, summed over its calls on every thread.
+	struct ProfileZoneStats
+	{
+		// Bucket 0 holds the calls under 1 us, bucket k > 0 those from
+		// 2^((k - 1) / 4) us on, four buckets per octave.
+		static const UINT BucketCount = 96;
+
+		std::string Name;
+		UINT64 Calls;
+		double TotalMs;
+		double MinMs;
+		double MaxMs;
+		UINT64 Buckets[BucketCount];
+
+		double GetAverageMs()const { return Calls > 0 ? TotalMs / Calls : 0.0; }
+		// Upper bound of the bucket holding percentile p in [0, 1].
+		double GetPercentileMs(double p)const;
+	};
+
+	class Profiler
+	{
+	public:
+		// Measures the rate of the time stamp counter and the cost of a zone on the
+		// calling thread, the main thread. Takes CalibrationMs. A ticksPerSecond
+		// other than 0 is used as the rate instead, never refined, so that tests can
+		// check the conversion against a known rate.
+		explicit Profiler(double ticksPerSecond = 0.0);
+		~Profiler();
+		// Singleton
+		static Profiler* Instance() { return m_instance; }
+
+		static UINT64 Now()
+		{
+#if DX_PROFILE_RDTSC
+			return __rdtsc();
+#else
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			return counter.QuadPart;
+#endif
+		}
+
+		// Zone ring of the calling thread.
+		ProfileThread* GetThread()
+		{
+			return t_generation == m_generation ? t_thread : RegisterThread();
+		}
+
+		// Drains the zones of all threads; call once a frame on the main thread.
+		void EndFrame();
+
+		// Keeps the zones of the next frameCount frames for WriteChromeTrace.
+		void Capture(UINT frameCount);
+		bool IsCapturing()const { return m_captureFrames > 0; }
+		bool HasCapture()const { return !IsCapturing() && !m_capture.empty(); }
+		// Writes the captured zones as Chrome trace event JSON, then drops them.
+		void WriteChromeTrace(std::ostream& out);
+
+		// Zones by total time, longest first.
+		std::vector<ProfileZoneStats> GetZoneStats()const;
+		void ResetStats();
+
+	public:
+		double GetZoneOverheadNs()const { return m_zoneOverheadNs; }
+		UINT64 GetDroppedZones()const { return m_dropped; }
+		double TicksToMs(UINT64 ticks)const { return ticks * 1000.0 / m_ticksPerSecond; }
+
+		// Both ends of a rate measurement read Now between two reads of
+		// QueryPerformanceCounter, keeping the closest pair of ClockReads tries, so
+		// that a preemption between the reads doesn't skew them. Each end is off by
+		// at most half the gap of its pair, about a QPC tick, so the first rate is
+		// off by at most two ticks over CalibrationMs, 1e-5 with QPC at 10 MHz, and
+		// less once EndFrame refines it over the whole run.
+		static const UINT CalibrationMs = 20;
+		static const UINT ClockReads = 8;
+
+	private:
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+
+		ProfileThread* RegisterThread();
+		void Drain(ProfileThread& thread);
+		void Calibrate();
+		void MeasureZoneOverhead();
+
+	private:
+		struct CapturedEvent
+		{
+			ProfileEvent Event;
+			UINT Thread;
+		};
+
+		std::mutex m_threadsMutex;
+		std::vector<std::unique_ptr<ProfileThread>> m_threads;
+
+		std::unordered_map<const char*, ProfileZoneStats> m_stats;
+		UINT64 m_dropped;
+
+		UINT m_captureFrames;
+		std::vector<CapturedEvent> m_capture;
+		std::vector<UINT64> m_captureFrameStarts;
+
+		// Now ticks per second, measured against QueryPerformanceCounter by the
+		// constructor and refined over the whole run by every EndFrame, unless fixed.
+		UINT64 m_qpcStart;
+		UINT64 m_ticksStart;
+		double m_ticksPerSecond;
+		bool m_fixedRate;
+		double m_zoneOverheadNs;
+
+		UINT m_generation;
+		static UINT m_generations;
+		static thread_local UINT t_generation;
+		static thread_local ProfileThread* t_thread;
+		static Profiler* m_instance;
+	};
+
+	class ProfileZone
+	{
+	public:
+		explicit ProfileZone(const char* name) : m_name(name), m_thread(nullptr), m_start(0)
+		{
+			if (Profiler* profiler = Profiler::Instance())
+			{
+				m_thread = profiler->GetThread();
+				m_thread->Enter();
+				m_start = Profiler::Now();
+			}
+		}
+		~ProfileZone()
+		{
+			if (m_thread)
+				m_thread->Leave(m_name, m_start, Profiler::Now());
+		}
+
+	private:
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+
+	private:
+		const char* m_name;
+		ProfileThread* m_thread;
+		UINT64 m_start;
+	};
+}
+#endif
@@ -0,0 +1,464 @@
+#include "RecordingRenderContext.h"
+#include <algorithm>
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+	// Differs from every object, for the bindings nothing is known about.
+	const void* const Unknown = reinterpret_cast<const void*>(~(UINT_PTR)0);
+
+	const char* const CommandNames[RenderCommandTypeCount] =
+	{
+		"SetShader", "SetConstantBuffers", "SetShaderResources", "SetSamplers",
+		"SetInputLayout", "SetVertexBuffers", "SetIndexBuffer", "SetPrimitiveTopology",
+		"SetStreamOutTargets", "SetUnorderedAccessViews", "SetRasterizerState", "SetViewports",
+		"SetRenderTargets", "SetBlendState", "SetDepthStencilState",
+		"ClearRenderTarget", "ClearDepthStencil", "Map", "Unmap", "GenerateMips",
+		"Draw", "DrawIndexed", "DrawIndexedInstanced", "DrawAuto", "Dispatch"
+	};
+
+	const char* const StageNames[ShaderStageCount] = { "VS", "HS", "DS", "GS", "PS", "CS" };
+
+	bool IsStageCommand(RenderCommandType type)
+	{
+		return type <= RenderCommandType::SetSamplers;
+	}
+
+	bool IsStateChange(RenderCommandType type)
+	{
+		return type <= RenderCommandType::SetDepthStencilState;
+	}
+}
+
+RecordingRenderContext::RecordingRenderContext(RenderContext* inner) :
+	m_inner(inner), m_logging(true)
+{
+	if (m_inner == nullptr)
+		m_scratch.resize(ScratchBytes);
+	Reset();
+}
+
+void RecordingRenderContext::BeginFrame()
+{
+	m_log.clear();
+	memset(&m_counters, 0, sizeof(m_counters));
+}
+
+void RecordingRenderContext::Reset()
+{
+	BeginFrame();
+	for (UINT stage = 0; stage < ShaderStageCount; ++stage)
+	{
+		Forget(m_shaders[stage]);
+		Forget(m_constantBuffers[stage]);
+		Forget(m_shaderResources[stage]);
+		Forget(m_samplers[stage]);
+	}
+	Forget(m_inputLayout);
+	Forget(m_vertexBuffers);
+	Forget(m_indexBuffer);
+	Forget(m_topology);
+	Forget(m_streamOutTargets);
+	Forget(m_unorderedAccessViews);
+	Forget(m_rasterizerState);
+	Forget(m_renderTargets);
+	Forget(m_blendState);
+	Forget(m_depthStencilState);
+	memset(m_blendFactor, 0, sizeof(m_blendFactor));
+	m_viewports.clear();
+	m_viewportsKnown = false;
+}
+
+void RecordingRenderContext::RegisterBuffer(ID3D11Buffer* buffer, UINT byteWidth, UINT bindFlags)
+{
+	BufferInfo info = { byteWidth, bindFlags };
+	m_buffers[buffer] = info;
+}
+
+void RecordingRenderContext::UnregisterBuffer(ID3D11Buffer* buffer)
+{
+	m_buffers.erase(buffer);
+}
+
+const char* RecordingRenderContext::GetCommandName(RenderCommandType type)
+{
+	return type < RenderCommandType::Count ? CommandNames[(UINT)type] : "Unknown";
+}
+
+template<UINT Capacity>
+bool RecordingRenderContext::Bind(Slots<Capacity>& slots, UINT startSlot, UINT count, const void* const* objects, const UINT64* values)
+{
+	// Slots past the end don't exist; binding them is an error the device reports.
+	bool same = startSlot + count <= Capacity;
+	for (UINT k = 0; k < count && startSlot + k < Capacity; ++k)
+	{
+		const void* object = objects ? objects[k] : nullptr;
+		UINT64 value = values ? values[k] : 0;
+		same = same && slots.Objects[startSlot + k] == object && slots.Values[startSlot + k] == value;
+		slots.Objects[startSlot + k] = object;
+		slots.Values[startSlot + k] = value;
+	}
+	return same;
+}
+
+template<UINT Capacity>
+bool RecordingRenderContext::Bind(Slots<Capacity>& slots, const void* object, UINT64 value)
+{
+	return Bind(slots, 0, 1, &object, &value);
+}
+
+template<UINT Capacity>
+void RecordingRenderContext::Forget(Slots<Capacity>& slots)
+{
+	std::fill(slots.Objects, slots.Objects + Capacity, Unknown);
+	std::fill(slots.Values, slots.Values + Capacity, 0);
+}
+
+void RecordingRenderContext::Record(RenderCommandType type, bool redundant, UINT count, const void* object,
+	UINT slot, UINT arg, ShaderStage stage)
+{
+	++m_counters.Calls[(UINT)type];
+	if (IsStateChange(type))
+	{
+		++m_counters.StateChanges;
+		if (redundant)
+			++m_counters.RedundantStateChanges;
+	}
+
+	if (m_logging)
+	{
+		RenderCommand command = { type, stage, redundant, (UINT8)(std::min)(slot, 255u), count, object, arg };
+		m_log.push_back(command);
+	}
+}
+
+void RecordingRenderContext::SetShader(ShaderStage stage, ID3D11DeviceChild* shader)
+{
+	bool redundant = Bind(m_shaders[(UINT)stage], shader);
+	Record(RenderCommandType::SetShader, redundant, 1, shader, 0, 0, stage);
+	if (m_inner)
+		m_inner->SetShader(stage, shader);
+}
+
+void RecordingRenderContext::SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	bool redundant = Bind(m_constantBuffers[(UINT)stage], startSlot, numBuffers, reinterpret_cast<const void* const*>(buffers));
+	Record(RenderCommandType::SetConstantBuffers, redundant, numBuffers, buffers ? buffers[0] : nullptr, startSlot, 0, stage);
+	if (m_inner)
+		m_inner->SetConstantBuffers(stage, startSlot, numBuffers, buffers);
+}
+
+void RecordingRenderContext::SetConstantBuffers1(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers,
+	const UINT* firstConstants, const UINT* numConstants)
+{
+	// A window is another binding than the whole buffer, or another window of it.
+	UINT64 values[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+	UINT count = (std::min)(numBuffers, (UINT)D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT);
+	for (UINT k = 0; k < count; ++k)
+		values[k] = (UINT64)firstConstants[k] << 32 | numConstants[k];
+
+	bool redundant = Bind(m_constantBuffers[(UINT)stage], startSlot, numBuffers, reinterpret_cast<const void* const*>(buffers), values);
+	Record(RenderCommandType::SetConstantBuffers, redundant, numBuffers, buffers ? buffers[0] : nullptr, startSlot, 0, stage);
+	if (m_inner)
+		m_inner->SetConstantBuffers1(stage, startSlot, numBuffers, buffers, firstConstants, numConstants);
+}
+
+void RecordingRenderContext::SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	bool redundant = Bind(m_shaderResources[(UINT)stage], startSlot, numViews, reinterpret_cast<const void* const*>(views));
+	Record(RenderCommandType::SetShaderResources, redundant, numViews, views ? views[0] : nullptr, startSlot, 0, stage);
+	if (m_inner)
+		m_inner->SetShaderResources(stage, startSlot, numViews, views);
+}
+
+void RecordingRenderContext::SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	bool redundant = Bind(m_samplers[(UINT)stage], startSlot, numSamplers, reinterpret_cast<const void* const*>(samplers));
+	Record(RenderCommandType::SetSamplers, redundant, numSamplers, samplers ? samplers[0] : nullptr, startSlot, 0, stage);
+	if (m_inner)
+		m_inner->SetSamplers(stage, startSlot, numSamplers, samplers);
+}
+
+void RecordingRenderContext::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	bool redundant = Bind(m_inputLayout, inputLayout);
+	Record(RenderCommandType::SetInputLayout, redundant, 1, inputLayout);
+	if (m_inner)
+		m_inner->IASetInputLayout(inputLayout);
+}
+
+void RecordingRenderContext::IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	UINT64 values[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	UINT count = (std::min)(numBuffers, (UINT)D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT);
+	for (UINT k = 0; k < count; ++k)
+		values[k] = (UINT64)(strides ? strides[k] : 0) << 32 | (offsets ? offsets[k] : 0);
+
+	bool redundant = Bind(m_vertexBuffers, startSlot, numBuffers, reinterpret_cast<const void* const*>(buffers), values);
+	Record(RenderCommandType::SetVertexBuffers, redundant, numBuffers, buffers ? buffers[0] : nullptr, startSlot);
+	if (m_inner)
+		m_inner->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+}
+
+void RecordingRenderContext::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	bool redundant = Bind(m_indexBuffer, buffer, (UINT64)format << 32 | offset);
+	Record(RenderCommandType::SetIndexBuffer, redundant, 1, buffer, 0, offset);
+	if (m_inner)
+		m_inner->IASetIndexBuffer(buffer, format, offset);
+}
+
+void RecordingRenderContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	bool redundant = Bind(m_topology, nullptr, (UINT64)topology);
+	Record(RenderCommandType::SetPrimitiveTopology, redundant, 1, nullptr, 0, (UINT)topology);
+	if (m_inner)
+		m_inner->IASetPrimitiveTopology(topology);
+}
+
+void RecordingRenderContext::SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets)
+{
+	// The slots after the targets are unbound. An offset other than -1, append,
+	// moves the write position, a change of state whenever given.
+	const void* objects[D3D11_SO_BUFFER_SLOT_COUNT] = {};
+	bool redundant = true;
+	for (UINT k = 0; k < numBuffers && k < D3D11_SO_BUFFER_SLOT_COUNT; ++k)
+	{
+		objects[k] = targets ? targets[k] : nullptr;
+		if (objects[k] && offsets && offsets[k] != (UINT)-1)
+			redundant = false;
+	}
+	redundant = Bind(m_streamOutTargets, 0, D3D11_SO_BUFFER_SLOT_COUNT, objects) && redundant;
+	Record(RenderCommandType::SetStreamOutTargets, redundant, numBuffers, objects[0]);
+	if (m_inner)
+		m_inner->SOSetTargets(numBuffers, targets, offsets);
+}
+
+void RecordingRenderContext::CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* views, const UINT* initialCounts)
+{
+	// Initial counts reset the counters of the views, a change of state whenever given.
+	bool redundant = Bind(m_unorderedAccessViews, startSlot, numViews, reinterpret_cast<const void* const*>(views));
+	for (UINT k = 0; k < numViews && initialCounts; ++k)
+	{
+		if (initialCounts[k] != (UINT)-1 && views && views[k])
+			redundant = false;
+	}
+	Record(RenderCommandType::SetUnorderedAccessViews, redundant, numViews, views ? views[0] : nullptr, startSlot, 0, ShaderStage::Compute);
+	if (m_inner)
+		m_inner->CSSetUnorderedAccessViews(startSlot, numViews, views, initialCounts);
+}
+
+void RecordingRenderContext::RSSetState(ID3D11RasterizerState* state)
+{
+	bool redundant = Bind(m_rasterizerState, state);
+	Record(RenderCommandType::SetRasterizerState, redundant, 1, state);
+	if (m_inner)
+		m_inner->RSSetState(state);
+}
+
+void RecordingRenderContext::RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports)
+{
+	bool redundant = m_viewportsKnown && m_viewports.size() == numViewports &&
+		(numViewports == 0 || memcmp(m_viewports.data(), viewports, numViewports * sizeof(D3D11_VIEWPORT)) == 0);
+	m_viewports.assign(viewports, viewports + numViewports);
+	m_viewportsKnown = true;
+	Record(RenderCommandType::SetViewports, redundant, numViewports);
+	if (m_inner)
+		m_inner->RSSetViewports(numViewports, viewports);
+}
+
+void RecordingRenderContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView)
+{
+	// The slots after the views are unbound.
+	const void* objects[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT + 1] = {};
+	for (UINT k = 0; k < numViews && k < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++k)
+		objects[k] = views ? views[k] : nullptr;
+	objects[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = depthStencilView;
+
+	bool redundant = Bind(m_renderTargets, 0, D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT + 1, objects);
+	Record(RenderCommandType::SetRenderTargets, redundant, numViews, objects[0]);
+	if (m_inner)
+		m_inner->OMSetRenderTargets(numViews, views, depthStencilView);
+}
+
+void RecordingRenderContext::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+	// A null factor means 1s.
+	const FLOAT ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const FLOAT* factor = blendFactor ? blendFactor : ones;
+	bool redundant = Bind(m_blendState, state, sampleMask) && memcmp(m_blendFactor, factor, sizeof(m_blendFactor)) == 0;
+	memcpy(m_blendFactor, factor, sizeof(m_blendFactor));
+	Record(RenderCommandType::SetBlendState, redundant, 1, state, 0, sampleMask);
+	if (m_inner)
+		m_inner->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void RecordingRenderContext::OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef)
+{
+	bool redundant = Bind(m_depthStencilState, state, stencilRef);
+	Record(RenderCommandType::SetDepthStencilState, redundant, 1, state, 0, stencilRef);
+	if (m_inner)
+		m_inner->OMSetDepthStencilState(state, stencilRef);
+}
+
+void RecordingRenderContext::ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4])
+{
+	Record(RenderCommandType::ClearRenderTarget, false, 1, view);
+	if (m_inner)
+		m_inner->ClearRenderTargetView(view, color);
+}
+
+void RecordingRenderContext::ClearDepthStencilView(ID3D11DepthStencilView* view, UINT clearFlags, FLOAT depth, UINT8 stencil)
+{
+	Record(RenderCommandType::ClearDepthStencil, false, 1, view, 0, clearFlags);
+	if (m_inner)
+		m_inner->ClearDepthStencilView(view, clearFlags, depth, stencil);
+}
+
+RecordingRenderContext::BufferInfo RecordingRenderContext::GetBufferInfo(ID3D11Resource* resource)const
+{
+	auto it = m_buffers.find(resource);
+	if (it != m_buffers.end())
+		return it->second;
+
+	BufferInfo info = {};
+	if (m_inner && resource)
+	{
+		D3D11_RESOURCE_DIMENSION dimension;
+		resource->GetType(&dimension);
+		if (dimension == D3D11_RESOURCE_DIMENSION_BUFFER)
+		{
+			D3D11_BUFFER_DESC desc;
+			static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc);
+			info.ByteWidth = desc.ByteWidth;
+			info.BindFlags = desc.BindFlags;
+		}
+	}
+	return info;
+}
+
+HRESULT RecordingRenderContext::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped)
+{
+	HRESULT hr = S_OK;
+	BufferInfo info = GetBufferInfo(resource);
+	if (m_inner)
+	{
+		hr = m_inner->Map(resource, subresource, mapType, mapFlags, mapped);
+		if (FAILED(hr))
+			return hr;
+		// Textures, by the size of the subresource
+		if (info.ByteWidth == 0)
+			info.ByteWidth = mapped->DepthPitch;
+	}
+	else
+	{
+		if (info.ByteWidth > m_scratch.size())
+			m_scratch.resize(info.ByteWidth);
+		mapped->pData = m_scratch.data();
+		mapped->RowPitch = mapped->DepthPitch = info.ByteWidth;
+	}
+
+	++m_counters.Maps;
+	m_counters.BytesMapped += info.ByteWidth;
+	if (info.BindFlags & D3D11_BIND_CONSTANT_BUFFER)
+		++m_counters.ConstantBufferUploads;
+	Record(RenderCommandType::Map, false, info.ByteWidth, resource, subresource, (UINT)mapType);
+	return hr;
+}
+
+void RecordingRenderContext::Unmap(ID3D11Resource* resource, UINT subresource)
+{
+	Record(RenderCommandType::Unmap, false, 0, resource, subresource);
+	if (m_inner)
+		m_inner->Unmap(resource, subresource);
+}
+
+void RecordingRenderContext::GenerateMips(ID3D11ShaderResourceView* view)
+{
+	Record(RenderCommandType::GenerateMips, false, 1, view);
+	if (m_inner)
+		m_inner->GenerateMips(view);
+}
+
+void RecordingRenderContext::Draw(UINT vertexCount, UINT startVertex)
+{
+	++m_counters.Draws;
+	m_counters.Vertices += vertexCount;
+	Record(RenderCommandType::Draw, false, vertexCount, nullptr, 0, startVertex);
+	if (m_inner)
+		m_inner->Draw(vertexCount, startVertex);
+}
+
+void RecordingRenderContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	++m_counters.Draws;
+	m_counters.Vertices += indexCount;
+	Record(RenderCommandType::DrawIndexed, false, indexCount, nullptr, 0, startIndex);
+	if (m_inner)
+		m_inner->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void RecordingRenderContext::DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+	++m_counters.Draws;
+	m_counters.Vertices += (UINT64)indexCountPerInstance * instanceCount;
+	Record(RenderCommandType::DrawIndexedInstanced, false, indexCountPerInstance, nullptr, 0, instanceCount);
+	if (m_inner)
+		m_inner->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void RecordingRenderContext::DrawAuto()
+{
+	// The vertex count stays on the device.
+	++m_counters.Draws;
+	Record(RenderCommandType::DrawAuto);
+	if (m_inner)
+		m_inner->DrawAuto();
+}
+
+void RecordingRenderContext::Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ)
+{
+	++m_counters.Dispatches;
+	Record(RenderCommandType::Dispatch, false, groupsX * groupsY * groupsZ);
+	if (m_inner)
+		m_inner->Dispatch(groupsX, groupsY, groupsZ);
+}
+
+bool RecordingRenderContext::SupportsConstantBufferOffsets() const
+{
+	// The null backend binds nothing, windows as well as whole buffers.
+	return m_inner ? m_inner->SupportsConstantBufferOffsets() : true;
+}
+
+void RecordingRenderContext::WriteLog(std::ostream& out)const
+{
+	for (const RenderCommand& command : m_log)
+	{
+		if (IsStageCommand(command.Type))
+			out << StageNames[(UINT)command.Stage] << ' ';
+		out << GetCommandName(command.Type) << " slot=" << (UINT)command.Slot << " count=" << command.Count
+			<< " object=" << command.Object << " arg=" << command.Arg;
+		if (command.Redundant)
+			out << " redundant";
+		out << '\n';
+	}
+}
+
+void RecordingRenderContext::WriteCounters(std::ostream& out)const
+{
+	out << "state_changes," << m_counters.StateChanges << '\n'
+		<< "redundant_state_changes," << m_counters.RedundantStateChanges << '\n'
+		<< "draws," << m_counters.Draws << '\n'
+		<< "vertices," << m_counters.Vertices << '\n'
+		<< "dispatches," << m_counters.Dispatches << '\n'
+		<< "maps," << m_counters.Maps << '\n'
+		<< "constant_buffer_uploads," << m_counters.ConstantBufferUploads << '\n'
+		<< "bytes_mapped," << m_counters.BytesMapped << '\n';
+	for (UINT k = 0; k < RenderCommandTypeCount; ++k)
+	{
+		if (m_counters.Calls[k] > 0)
+			out << CommandNames[k] << ',' << m_counters.Calls[k] << '\n';
+	}
+}
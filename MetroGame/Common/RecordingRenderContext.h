@@ -0,0 +1,190 @@
+#pragma once
+
+#include "RenderContext.h"
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Records the calls made on it into a compact command log and counts them: state
+// changes, and those binding what is already bound, draws, maps and the bytes they
+// expose. It forwards every call to an inner context, e.g. the D3D11 one to count a
+// frame of the running game, or, without one, is a null backend that binds and
+// draws nothing. Objects are only compared, never called, unless an inner context
+// maps a buffer, so tests can use any distinct pointers.
+// It only depends on the Direct3D 11 types; the translation unit doesn't use the
+// precompiled header.
+
+namespace DX
+{
+	enum class RenderCommandType : UINT8
+	{
+		SetShader,
+		SetConstantBuffers,
+		SetShaderResources,
+		SetSamplers,
+		SetInputLayout,
+		SetVertexBuffers,
+		SetIndexBuffer,
+		SetPrimitiveTopology,
+		SetStreamOutTargets,
+		SetUnorderedAccessViews,
+		SetRasterizerState,
+		SetViewports,
+		SetRenderTargets,
+		SetBlendState,
+		SetDepthStencilState,
+		ClearRenderTarget,
+		ClearDepthStencil,
+		Map,
+		Unmap,
+		GenerateMips,
+		Draw,
+		DrawIndexed,
+		DrawIndexedInstanced,
+		DrawAuto,
+		Dispatch,
+		Count
+	};
+	const UINT RenderCommandTypeCount = (UINT)RenderCommandType::Count;
+
+	struct RenderCommand
+	{
+		RenderCommandType Type;
+		ShaderStage Stage;		// Of the shader stage calls
+		bool Redundant;			// A state change that left the state as it was
+		UINT8 Slot;				// First slot bound
+		UINT Count;				// Slots bound, vertices or indices drawn, bytes mapped or thread groups
+		const void* Object;		// First object bound, or the resource
+		UINT Arg;				// Start vertex or index, or instances
+	};
+
+	struct RenderCounters
+	{
+		UINT Calls[RenderCommandTypeCount];
+		UINT StateChanges;
+		UINT RedundantStateChanges;
+		UINT Maps;
+		UINT ConstantBufferUploads;
+		UINT64 BytesMapped;
+		UINT Draws;
+		UINT64 Vertices;		// Or indices, over all instances
+		UINT Dispatches;
+	};
+
+	class RecordingRenderContext : public RenderContext
+	{
+	public:
+		// Null backend without inner.
+		explicit RecordingRenderContext(RenderContext* inner = nullptr);
+
+		// Drops the log and counters; the bound state is kept, as the device keeps it.
+		void BeginFrame();
+		// Forgets the bound state too, so that nothing counts as redundant until set again.
+		void Reset();
+		void SetLogging(bool logging) { m_logging = logging; }
+
+		// Size and bind flags of a buffer the null backend maps; maps of other
+		// resources expose ScratchBytes and count no bytes.
+		void RegisterBuffer(ID3D11Buffer* buffer, UINT byteWidth, UINT bindFlags);
+		// Forgets a released buffer, so that one created at its address isn't taken for it.
+		void UnregisterBuffer(ID3D11Buffer* buffer);
+		static const UINT ScratchBytes = 1 << 20;
+
+		const RenderCounters& GetCounters()const { return m_counters; }
+		const std::vector<RenderCommand>& GetLog()const { return m_log; }
+		static const char* GetCommandName(RenderCommandType type);
+
+		// One line a command, or the counters by name.
+		void WriteLog(std::ostream& out)const;
+		void WriteCounters(std::ostream& out)const;
+
+		virtual void SetShader(ShaderStage stage, ID3D11DeviceChild* shader);
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers);
+		virtual void SetConstantBuffers1(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers,
+			const UINT* firstConstants, const UINT* numConstants);
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views);
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers);
+
+		virtual void IASetInputLayout(ID3D11InputLayout* inputLayout);
+		virtual void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+		virtual void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+		virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+		virtual void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets);
+		virtual void CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* views, const UINT* initialCounts);
+		virtual void RSSetState(ID3D11RasterizerState* state);
+		virtual void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports);
+		virtual void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView);
+		virtual void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask);
+		virtual void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef);
+
+		virtual void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]);
+		virtual void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT clearFlags, FLOAT depth, UINT8 stencil);
+		virtual HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped);
+		virtual void Unmap(ID3D11Resource* resource, UINT subresource);
+		virtual void GenerateMips(ID3D11ShaderResourceView* view);
+
+		virtual void Draw(UINT vertexCount, UINT startVertex);
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+		virtual void DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+		virtual void DrawAuto();
+		virtual void Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ);
+
+		virtual bool SupportsConstantBufferOffsets() const;
+
+	private:
+		struct BufferInfo
+		{
+			UINT ByteWidth;
+			UINT BindFlags;
+		};
+
+		// Bindings of one kind, an object and a value like a stride and offset per slot.
+		template<UINT Capacity>
+		struct Slots
+		{
+			const void* Objects[Capacity];
+			UINT64 Values[Capacity];
+		};
+
+		// Binds count slots from startSlot, nullptr objects or values as null and 0.
+		// True if all of them held the same already.
+		template<UINT Capacity>
+		static bool Bind(Slots<Capacity>& slots, UINT startSlot, UINT count, const void* const* objects, const UINT64* values = nullptr);
+		template<UINT Capacity>
+		static bool Bind(Slots<Capacity>& slots, const void* object, UINT64 value = 0);
+		template<UINT Capacity>
+		static void Forget(Slots<Capacity>& slots);
+
+		void Record(RenderCommandType type, bool redundant = false, UINT count = 0, const void* object = nullptr,
+			UINT slot = 0, UINT arg = 0, ShaderStage stage = ShaderStage::Vertex);
+		BufferInfo GetBufferInfo(ID3D11Resource* resource)const;
+
+	private:
+		RenderContext* m_inner;
+		bool m_logging;
+		std::vector<RenderCommand> m_log;
+		RenderCounters m_counters;
+
+		std::unordered_map<const void*, BufferInfo> m_buffers;
+		std::vector<BYTE> m_scratch;
+
+		// The bound state
+		Slots<1> m_shaders[ShaderStageCount];
+		Slots<D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT> m_constantBuffers[ShaderStageCount];
+		Slots<D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT> m_shaderResources[ShaderStageCount];
+		Slots<D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT> m_samplers[ShaderStageCount];
+		Slots<1> m_inputLayout;
+		Slots<D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT> m_vertexBuffers;	// Stride and offset
+		Slots<1> m_indexBuffer;				// Format and offset
+		Slots<1> m_topology;
+		Slots<D3D11_SO_BUFFER_SLOT_COUNT> m_streamOutTargets;
+		Slots<D3D11_PS_CS_UAV_REGISTER_COUNT> m_unorderedAccessViews;
+		Slots<1> m_rasterizerState;
+		Slots<D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT + 1> m_renderTargets;	// And the depth stencil view
+		Slots<1> m_blendState;				// Sample mask
+		Slots<1> m_depthStencilState;		// Stencil reference
+		FLOAT m_blendFactor[4];
+		std::vector<D3D11_VIEWPORT> m_viewports;
+		bool m_viewportsKnown;
+	};
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <d3d11_1.h>
+
+// The calls components make on the immediate context, behind an interface, so that
+// a recording or null backend can stand in for Direct3D 11. The binding calls of the
+// six shader stages go through five per-stage functions; the D3D11 spellings, like
+// VSSetConstantBuffers, forward to them so that call sites read as before.
+// Class instances aren't used by any shader and are dropped.
+// The header only needs the Direct3D 11.1 types, and builds without the precompiled
+// header.
+
+namespace DX
+{
+	enum class ShaderStage : UINT8
+	{
+		Vertex,
+		Hull,
+		Domain,
+		Geometry,
+		Pixel,
+		Compute
+	};
+	const UINT ShaderStageCount = 6;
+
+#define DX_RENDER_CONTEXT_STAGE(prefix, stage, shaderType) \
+		void prefix##SetShader(shaderType* shader, ID3D11ClassInstance* const*, UINT) \
+		{ SetShader(ShaderStage::stage, shader); } \
+		void prefix##SetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) \
+		{ SetConstantBuffers(ShaderStage::stage, startSlot, numBuffers, buffers); } \
+		void prefix##SetConstantBuffers1(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* numConstants) \
+		{ SetConstantBuffers1(ShaderStage::stage, startSlot, numBuffers, buffers, firstConstants, numConstants); } \
+		void prefix##SetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) \
+		{ SetShaderResources(ShaderStage::stage, startSlot, numViews, views); } \
+		void prefix##SetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) \
+		{ SetSamplers(ShaderStage::stage, startSlot, numSamplers, samplers); }
+
+	class RenderContext
+	{
+	public:
+		virtual ~RenderContext() {}
+
+		// Shader stages
+		virtual void SetShader(ShaderStage stage, ID3D11DeviceChild* shader) = 0;
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) = 0;
+		// Binds windows of the buffers, in 16-byte constants from the start, both the
+		// first and the count multiples of 16. Only where SupportsConstantBufferOffsets.
+		virtual void SetConstantBuffers1(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers,
+			const UINT* firstConstants, const UINT* numConstants) = 0;
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) = 0;
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+		DX_RENDER_CONTEXT_STAGE(VS, Vertex, ID3D11VertexShader)
+		DX_RENDER_CONTEXT_STAGE(HS, Hull, ID3D11HullShader)
+		DX_RENDER_CONTEXT_STAGE(DS, Domain, ID3D11DomainShader)
+		DX_RENDER_CONTEXT_STAGE(GS, Geometry, ID3D11GeometryShader)
+		DX_RENDER_CONTEXT_STAGE(PS, Pixel, ID3D11PixelShader)
+		DX_RENDER_CONTEXT_STAGE(CS, Compute, ID3D11ComputeShader)
+
+		// Fixed function stages
+		virtual void IASetInputLayout(ID3D11InputLayout* inputLayout) = 0;
+		virtual void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) = 0;
+		virtual void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) = 0;
+		virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) = 0;
+		virtual void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets) = 0;
+		virtual void CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* views, const UINT* initialCounts) = 0;
+		virtual void RSSetState(ID3D11RasterizerState* state) = 0;
+		virtual void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports) = 0;
+		virtual void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) = 0;
+		virtual void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) = 0;
+		virtual void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) = 0;
+
+		// Resources
+		virtual void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]) = 0;
+		virtual void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT clearFlags, FLOAT depth, UINT8 stencil) = 0;
+		virtual HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) = 0;
+		virtual void Unmap(ID3D11Resource* resource, UINT subresource) = 0;
+		virtual void GenerateMips(ID3D11ShaderResourceView* view) = 0;
+
+		// Work
+		virtual void Draw(UINT vertexCount, UINT startVertex) = 0;
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) = 0;
+		virtual void DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) = 0;
+		virtual void DrawAuto() = 0;
+		virtual void Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ) = 0;
+
+		// Whether constant buffers can be bound by offset and dynamic ones mapped
+		// without overwriting what the GPU may still read.
+		virtual bool SupportsConstantBufferOffsets() const = 0;
+	};
+
+#undef DX_RENDER_CONTEXT_STAGE
+}
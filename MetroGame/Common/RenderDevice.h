@@ -0,0 +1,61 @@
+#pragma once
+
+#include <d3d11_1.h>
+
+// The creation calls components make on the device, behind an interface, so that a
+// null backend can stand in for Direct3D 11 as RecordingRenderContext does for the
+// immediate context. The D3D11 spellings and arguments are kept, so that call sites
+// read as before; what the swap chain and the loaders of DeviceResources need stays
+// on the device itself.
+// The header only needs the Direct3D 11.1 types, and builds without the precompiled
+// header.
+
+namespace DX
+{
+	class RenderDevice
+	{
+	public:
+		virtual ~RenderDevice() {}
+
+		// Resources
+		virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer) = 0;
+		virtual HRESULT CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture1D** texture) = 0;
+		virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture) = 0;
+		virtual HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture) = 0;
+
+		// Views
+		virtual HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc,
+			ID3D11ShaderResourceView** view) = 0;
+		virtual HRESULT CreateUnorderedAccessView(ID3D11Resource* resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC* desc,
+			ID3D11UnorderedAccessView** view) = 0;
+		virtual HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc,
+			ID3D11RenderTargetView** view) = 0;
+		virtual HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc,
+			ID3D11DepthStencilView** view) = 0;
+
+		// Shaders
+		virtual HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT numElements,
+			const void* byteCode, SIZE_T byteCodeLength, ID3D11InputLayout** inputLayout) = 0;
+		virtual HRESULT CreateVertexShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11VertexShader** shader) = 0;
+		virtual HRESULT CreateHullShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11HullShader** shader) = 0;
+		virtual HRESULT CreateDomainShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11DomainShader** shader) = 0;
+		virtual HRESULT CreateGeometryShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11GeometryShader** shader) = 0;
+		virtual HRESULT CreateGeometryShaderWithStreamOutput(const void* byteCode, SIZE_T byteCodeLength,
+			const D3D11_SO_DECLARATION_ENTRY* entries, UINT numEntries, const UINT* strides, UINT numStrides,
+			UINT rasterizedStream, ID3D11ClassLinkage* classLinkage, ID3D11GeometryShader** shader) = 0;
+		virtual HRESULT CreatePixelShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11PixelShader** shader) = 0;
+		virtual HRESULT CreateComputeShader(const void* byteCode, SIZE_T byteCodeLength, ID3D11ClassLinkage* classLinkage,
+			ID3D11ComputeShader** shader) = 0;
+
+		// States
+		virtual HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state) = 0;
+		virtual HRESULT CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state) = 0;
+		virtual HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state) = 0;
+		virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** state) = 0;
+	};
+}
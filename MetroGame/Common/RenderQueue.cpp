@@ -0,0 +1,522 @@
+#include "RenderQueue.h"
+#include "ConstantRingBuffer.h"
+#include <algorithm>
+#include <limits.h>
+#include <stdexcept>
+#include <string.h>
+
+using namespace DX;
+
+bool RenderQueue::m_sortingEnabled = true;
+bool RenderQueue::m_constantRingEnabled = true;
+
+namespace
+{
+	// Differs from every object, for the bindings nothing is known about.
+	template<typename T>
+	T* Unknown()
+	{
+		return reinterpret_cast<T*>(~(UINT_PTR)0);
+	}
+
+	template<typename T>
+	void ForgetAll(T** objects, UINT count)
+	{
+		std::fill(objects, objects + count, Unknown<T>());
+	}
+
+	// The first and one past the last slot in which the bound and wanted objects differ.
+	template<typename T>
+	bool FindChanges(T* const* bound, T* const* wanted, UINT count, UINT& first, UINT& end)
+	{
+		first = 0;
+		while (first < count && bound[first] == wanted[first])
+			++first;
+		if (first == count)
+			return false;
+		end = count;
+		while (bound[end - 1] == wanted[end - 1])
+			--end;
+		return true;
+	}
+
+	void CheckSlots(UINT startSlot, UINT count, UINT capacity)
+	{
+		if (startSlot + count > capacity)
+			throw std::out_of_range("Too many slots for a draw state!");
+	}
+
+	const UINT KeyDepthBits = 30;
+	const UINT KeyStateBits = 16;
+	const UINT KeyProgramBits = 12;
+	const UINT KeyBucketShift = 58;
+	const UINT KeyPassShift = 60;
+
+	// Non-negative floats order as their bits do; the sign bit is left out.
+	UINT64 DepthBits(float depth)
+	{
+		if (!(depth > 0.0f))
+			return 0;
+		UINT bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		return bits >> 1;
+	}
+}
+
+DrawState::DrawState()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+void DrawState::SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	StageBindings& bindings = Stages[(UINT)stage];
+	CheckSlots(startSlot, numBuffers, StageBindings::MaxConstantBuffers);
+	std::copy(buffers, buffers + numBuffers, bindings.ConstantBuffers + startSlot);
+	bindings.ConstantBufferCount = (std::max)(bindings.ConstantBufferCount, startSlot + numBuffers);
+}
+
+void DrawState::SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	StageBindings& bindings = Stages[(UINT)stage];
+	CheckSlots(startSlot, numViews, StageBindings::MaxShaderResources);
+	std::copy(views, views + numViews, bindings.ShaderResources + startSlot);
+	bindings.ShaderResourceCount = (std::max)(bindings.ShaderResourceCount, startSlot + numViews);
+}
+
+void DrawState::SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	StageBindings& bindings = Stages[(UINT)stage];
+	CheckSlots(startSlot, numSamplers, StageBindings::MaxSamplers);
+	std::copy(samplers, samplers + numSamplers, bindings.Samplers + startSlot);
+	bindings.SamplerCount = (std::max)(bindings.SamplerCount, startSlot + numSamplers);
+}
+
+void DrawState::SetVertexBuffers(UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides)
+{
+	CheckSlots(0, numBuffers, MaxVertexBuffers);
+	std::copy(buffers, buffers + numBuffers, VertexBuffers);
+	std::copy(strides, strides + numBuffers, Strides);
+	VertexBufferCount = numBuffers;
+}
+
+RenderQueue::RenderQueue() :
+	m_pass(RenderPass::Color), m_pendingUploads(0), m_ring(nullptr)
+{
+}
+
+void RenderQueue::Begin(RenderPass pass)
+{
+	m_pass = pass;
+	m_states.clear();
+	m_stateProgram.clear();
+	m_programs.clear();
+	m_packets.clear();
+	m_uploads.clear();
+	m_constants.clear();
+	m_pendingUploads = 0;
+	m_items.clear();
+}
+
+UINT RenderQueue::AddState(const DrawState& state)
+{
+	m_states.push_back(state);
+	m_stateProgram.push_back(GetProgram(state));
+	return (UINT)m_states.size() - 1;
+}
+
+UINT RenderQueue::GetProgram(const DrawState& state)
+{
+	for (UINT i = 0; i < m_programs.size(); ++i)
+	{
+		const Program& program = m_programs[i];
+		if (program.InputLayout == state.InputLayout && program.Topology == state.Topology &&
+			std::equal(program.Shaders, program.Shaders + GraphicsStageCount, state.Shaders))
+			return i;
+	}
+
+	Program program;
+	program.InputLayout = state.InputLayout;
+	program.Topology = state.Topology;
+	std::copy(state.Shaders, state.Shaders + GraphicsStageCount, program.Shaders);
+	m_programs.push_back(program);
+	return (UINT)m_programs.size() - 1;
+}
+
+void RenderQueue::SetConstants(ID3D11Buffer* buffer, const void* data, UINT size)
+{
+	Upload upload = { buffer, (UINT)m_constants.size(), size };
+	const BYTE* bytes = static_cast<const BYTE*>(data);
+	m_constants.insert(m_constants.end(), bytes, bytes + size);
+	m_uploads.push_back(upload);
+}
+
+void RenderQueue::Draw(UINT state, UINT vertexCount, UINT startVertex, float depth)
+{
+	AddPacket(state, DrawType::Draw, vertexCount, 1, startVertex, 0, depth);
+}
+
+void RenderQueue::DrawIndexed(UINT state, UINT indexCount, UINT startIndex, INT baseVertex, float depth)
+{
+	AddPacket(state, DrawType::DrawIndexed, indexCount, 1, startIndex, baseVertex, depth);
+}
+
+void RenderQueue::DrawIndexedInstanced(UINT state, UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, float depth)
+{
+	AddPacket(state, DrawType::DrawIndexedInstanced, indexCount, instanceCount, startIndex, baseVertex, depth);
+}
+
+void RenderQueue::AddPacket(UINT state, DrawType type, UINT count, UINT instanceCount, UINT start, INT base, float depth)
+{
+	Packet packet = { state, m_pendingUploads, (UINT)m_uploads.size() - m_pendingUploads, type, count, instanceCount, start, base };
+	m_pendingUploads = (UINT)m_uploads.size();
+
+	SortItem item = { MakeKey(m_pass, m_states[state].Bucket, m_stateProgram[state], state, depth), (UINT)m_packets.size() };
+	m_packets.push_back(packet);
+	m_items.push_back(item);
+}
+
+UINT64 RenderQueue::MakeKey(RenderPass pass, RenderBucket bucket, UINT program, UINT state, float depth)
+{
+	// Programs and states past the bits wrap around, which only sorts them worse.
+	UINT64 key = (UINT64)pass << KeyPassShift | (UINT64)bucket << KeyBucketShift;
+	UINT64 programBits = program & ((1u << KeyProgramBits) - 1);
+	UINT64 stateBits = state & ((1u << KeyStateBits) - 1);
+	UINT64 depthBits = DepthBits(depth);
+	if (bucket == RenderBucket::Opaque)
+		return key | programBits << (KeyStateBits + KeyDepthBits) | stateBits << KeyDepthBits | depthBits;
+
+	depthBits = ((1u << KeyDepthBits) - 1) - depthBits;
+	return key | depthBits << (KeyProgramBits + KeyStateBits) | programBits << KeyStateBits | stateBits;
+}
+
+void RenderQueue::RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+{
+	// Least significant byte first, which keeps equal keys in the order they were
+	// added. Bytes all keys share, like the pass, are skipped.
+	const UINT Digits = sizeof(UINT64);
+	UINT counts[Digits][256] = {};
+	for (const SortItem& item : items)
+		for (UINT d = 0; d < Digits; ++d)
+			++counts[d][(item.Key >> (8 * d)) & 0xff];
+
+	scratch.resize(items.size());
+	for (UINT d = 0; d < Digits; ++d)
+	{
+		UINT* count = counts[d];
+		if (count[(items[0].Key >> (8 * d)) & 0xff] == items.size())
+			continue;
+
+		UINT offset = 0;
+		for (UINT b = 0; b < 256; ++b)
+		{
+			UINT n = count[b];
+			count[b] = offset;
+			offset += n;
+		}
+		for (const SortItem& item : items)
+			scratch[count[(item.Key >> (8 * d)) & 0xff]++] = item;
+		items.swap(scratch);
+	}
+}
+
+void RenderQueue::Execute(RenderContext* context, ConstantRingBuffer* ring)
+{
+	if (m_packets.empty())
+		return;
+
+	if (m_sortingEnabled)
+		RadixSort(m_items, m_scratch);
+
+	Forget();
+	m_ring = nullptr;
+	if (ring && m_constantRingEnabled && context->SupportsConstantBufferOffsets() && WriteToRing(context, ring))
+		m_ring = ring;
+	UINT boundState = UINT_MAX;
+	for (const SortItem& item : m_items)
+	{
+		const Packet& packet = m_packets[item.Index];
+		for (UINT i = packet.FirstUpload; i < packet.FirstUpload + packet.UploadCount; ++i)
+		{
+			if (!m_ring)
+				UploadConstants(context, m_uploads[i]);
+			else if (m_uploadOffsets[i] != UINT_MAX)
+				BindWindow(context, m_states[packet.State], m_uploads[i], m_uploadOffsets[i]);
+		}
+		if (packet.State != boundState)
+		{
+			Bind(context, m_states[packet.State]);
+			boundState = packet.State;
+		}
+
+		switch (packet.Type)
+		{
+		case DrawType::Draw:
+			context->Draw(packet.Count, packet.Start);
+			break;
+		case DrawType::DrawIndexed:
+			context->DrawIndexed(packet.Count, packet.Start, packet.Base);
+			break;
+		case DrawType::DrawIndexedInstanced:
+			context->DrawIndexedInstanced(packet.Count, packet.InstanceCount, packet.Start, packet.Base, 0);
+			break;
+		}
+	}
+	Restore(context);
+	m_ring = nullptr;
+}
+
+void RenderQueue::Forget()
+{
+	// Other components bind between the passes; nothing is known about the state.
+	m_bound.InputLayout = Unknown<ID3D11InputLayout>();
+	m_bound.Topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	ForgetAll(m_bound.VertexBuffers, DrawState::MaxVertexBuffers);
+	std::fill(m_bound.Strides, m_bound.Strides + DrawState::MaxVertexBuffers, ~0u);
+	m_bound.IndexBuffer = Unknown<ID3D11Buffer>();
+	m_bound.IndexFormat = DXGI_FORMAT_UNKNOWN;
+	ForgetAll(m_bound.Shaders, GraphicsStageCount);
+	for (UINT stage = 0; stage < GraphicsStageCount; ++stage)
+	{
+		StageBindings& bindings = m_bound.Stages[stage];
+		ForgetAll(bindings.ConstantBuffers, StageBindings::MaxConstantBuffers);
+		ForgetAll(bindings.ShaderResources, StageBindings::MaxShaderResources);
+		ForgetAll(bindings.Samplers, StageBindings::MaxSamplers);
+		m_boundShaderResources[stage] = 0;
+	}
+	m_bound.RasterizerState = Unknown<ID3D11RasterizerState>();
+	m_bound.BlendState = Unknown<ID3D11BlendState>();
+	m_lastUploads.clear();
+	m_windows.clear();
+}
+
+void RenderQueue::Bind(RenderContext* context, const DrawState& state)
+{
+	// Input assembler
+	if (m_bound.InputLayout != state.InputLayout)
+	{
+		context->IASetInputLayout(state.InputLayout);
+		m_bound.InputLayout = state.InputLayout;
+	}
+	if (m_bound.Topology != state.Topology)
+	{
+		context->IASetPrimitiveTopology(state.Topology);
+		m_bound.Topology = state.Topology;
+	}
+	UINT first = 0, end = 0;
+	for (UINT i = 0; i < state.VertexBufferCount; ++i)
+	{
+		if (m_bound.VertexBuffers[i] != state.VertexBuffers[i] || m_bound.Strides[i] != state.Strides[i])
+		{
+			if (first == end)
+				first = i;
+			end = i + 1;
+		}
+	}
+	if (first != end)
+	{
+		static const UINT offsets[DrawState::MaxVertexBuffers] = {};
+		context->IASetVertexBuffers(first, end - first, state.VertexBuffers + first, state.Strides + first, offsets);
+		std::copy(state.VertexBuffers + first, state.VertexBuffers + end, m_bound.VertexBuffers + first);
+		std::copy(state.Strides + first, state.Strides + end, m_bound.Strides + first);
+	}
+	if (state.IndexBuffer && (m_bound.IndexBuffer != state.IndexBuffer || m_bound.IndexFormat != state.IndexFormat))
+	{
+		context->IASetIndexBuffer(state.IndexBuffer, state.IndexFormat, 0);
+		m_bound.IndexBuffer = state.IndexBuffer;
+		m_bound.IndexFormat = state.IndexFormat;
+	}
+
+	// Shader stages
+	for (UINT stage = 0; stage < GraphicsStageCount; ++stage)
+	{
+		ID3D11DeviceChild* shader = state.Shaders[stage];
+		if (m_bound.Shaders[stage] != shader)
+		{
+			context->SetShader((ShaderStage)stage, shader);
+			m_bound.Shaders[stage] = shader;
+		}
+
+		const StageBindings& wanted = state.Stages[stage];
+		StageBindings& bound = m_bound.Stages[stage];
+		if (FindChanges(bound.ConstantBuffers, wanted.ConstantBuffers, wanted.ConstantBufferCount, first, end))
+		{
+			BindConstantBuffers(context, (ShaderStage)stage, first, end, wanted.ConstantBuffers);
+			std::copy(wanted.ConstantBuffers + first, wanted.ConstantBuffers + end, bound.ConstantBuffers + first);
+		}
+		if (FindChanges(bound.ShaderResources, wanted.ShaderResources, wanted.ShaderResourceCount, first, end))
+		{
+			context->SetShaderResources((ShaderStage)stage, first, end - first, wanted.ShaderResources + first);
+			std::copy(wanted.ShaderResources + first, wanted.ShaderResources + end, bound.ShaderResources + first);
+			m_boundShaderResources[stage] = (std::max)(m_boundShaderResources[stage], end);
+		}
+		if (FindChanges(bound.Samplers, wanted.Samplers, wanted.SamplerCount, first, end))
+		{
+			context->SetSamplers((ShaderStage)stage, first, end - first, wanted.Samplers + first);
+			std::copy(wanted.Samplers + first, wanted.Samplers + end, bound.Samplers + first);
+		}
+	}
+
+	// Rasterizer and output merger
+	if (m_bound.RasterizerState != state.RasterizerState)
+	{
+		context->RSSetState(state.RasterizerState);
+		m_bound.RasterizerState = state.RasterizerState;
+	}
+	if (m_bound.BlendState != state.BlendState)
+	{
+		static const FLOAT blendFactor[4] = {};
+		context->OMSetBlendState(state.BlendState, blendFactor, 0xffffffff);
+		m_bound.BlendState = state.BlendState;
+	}
+}
+
+void RenderQueue::BindConstantBuffers(RenderContext* context, ShaderStage stage, UINT first, UINT end, ID3D11Buffer* const* buffers)
+{
+	if (!m_ring)
+	{
+		context->SetConstantBuffers(stage, first, end - first, buffers + first);
+		return;
+	}
+
+	// Buffers with constants in the ring are bound as their windows, in runs of
+	// slots bound the same way.
+	ID3D11Buffer* ringBuffers[StageBindings::MaxConstantBuffers];
+	UINT firstConstants[StageBindings::MaxConstantBuffers];
+	UINT numConstants[StageBindings::MaxConstantBuffers];
+	bool windowed[StageBindings::MaxConstantBuffers];
+	for (UINT slot = first; slot < end; ++slot)
+	{
+		auto window = std::find_if(m_windows.begin(), m_windows.end(), [&](const Window& w) { return w.Buffer == buffers[slot]; });
+		windowed[slot] = buffers[slot] && window != m_windows.end();
+		if (windowed[slot])
+		{
+			ringBuffers[slot] = m_ring->GetBuffer();
+			firstConstants[slot] = window->FirstConstant;
+			numConstants[slot] = window->NumConstants;
+		}
+	}
+	for (UINT run = first, runEnd; run < end; run = runEnd)
+	{
+		runEnd = run + 1;
+		while (runEnd < end && windowed[runEnd] == windowed[run])
+			++runEnd;
+		if (windowed[run])
+			context->SetConstantBuffers1(stage, run, runEnd - run, ringBuffers + run, firstConstants + run, numConstants + run);
+		else
+			context->SetConstantBuffers(stage, run, runEnd - run, buffers + run);
+	}
+}
+
+bool RenderQueue::IsRepeated(const Upload& upload)
+{
+	// Constants the buffer already holds, like those of the instances of one object
+	// in a pass, aren't written again.
+	const BYTE* data = m_constants.data() + upload.Offset;
+	auto last = std::find_if(m_lastUploads.begin(), m_lastUploads.end(), [&](const Upload& u) { return u.Buffer == upload.Buffer; });
+	if (last != m_lastUploads.end())
+	{
+		if (last->Size == upload.Size && memcmp(m_constants.data() + last->Offset, data, upload.Size) == 0)
+			return true;
+		*last = upload;
+	}
+	else
+	{
+		m_lastUploads.push_back(upload);
+	}
+	return false;
+}
+
+void RenderQueue::UploadConstants(RenderContext* context, const Upload& upload)
+{
+	if (IsRepeated(upload))
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (SUCCEEDED(context->Map(upload.Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		memcpy(mapped.pData, m_constants.data() + upload.Offset, upload.Size);
+		context->Unmap(upload.Buffer, 0);
+	}
+}
+
+bool RenderQueue::WriteToRing(RenderContext* context, ConstantRingBuffer* ring)
+{
+	// In the order the packets are submitted, so that the same uploads repeat.
+	m_uploadOffsets.assign(m_uploads.size(), UINT_MAX);
+	for (const SortItem& item : m_items)
+	{
+		const Packet& packet = m_packets[item.Index];
+		for (UINT i = packet.FirstUpload; i < packet.FirstUpload + packet.UploadCount; ++i)
+		{
+			if (!IsRepeated(m_uploads[i]))
+				m_uploadOffsets[i] = ring->Allocate(m_constants.data() + m_uploads[i].Offset, m_uploads[i].Size);
+		}
+	}
+	m_lastUploads.clear();
+
+	UINT base;
+	if (!ring->Commit(context, base))
+		return false;
+	for (UINT& offset : m_uploadOffsets)
+	{
+		if (offset != UINT_MAX)
+			offset += base;
+	}
+	return true;
+}
+
+void RenderQueue::BindWindow(RenderContext* context, const DrawState& state, const Upload& upload, UINT offset)
+{
+	Window window = { upload.Buffer, 0, 0 };
+	ConstantRingBuffer::GetWindow(offset, upload.Size, window.FirstConstant, window.NumConstants);
+	auto last = std::find_if(m_windows.begin(), m_windows.end(), [&](const Window& w) { return w.Buffer == upload.Buffer; });
+	if (last != m_windows.end())
+		*last = window;
+	else
+		m_windows.push_back(window);
+
+	// Called before the draw's state is bound. The slots holding the buffer that the
+	// draw binds it to as well get the new window; the others are forgotten, to be
+	// bound again when a draw binds the buffer to them.
+	ID3D11Buffer* ringBuffer = m_ring->GetBuffer();
+	for (UINT stage = 0; stage < GraphicsStageCount; ++stage)
+	{
+		const StageBindings& wanted = state.Stages[stage];
+		StageBindings& bound = m_bound.Stages[stage];
+		for (UINT slot = 0; slot < StageBindings::MaxConstantBuffers; ++slot)
+		{
+			if (bound.ConstantBuffers[slot] != upload.Buffer)
+				continue;
+			if (slot < wanted.ConstantBufferCount && wanted.ConstantBuffers[slot] == upload.Buffer)
+				context->SetConstantBuffers1((ShaderStage)stage, slot, 1, &ringBuffer, &window.FirstConstant, &window.NumConstants);
+			else
+				bound.ConstantBuffers[slot] = Unknown<ID3D11Buffer>();
+		}
+	}
+}
+
+void RenderQueue::Restore(RenderContext* context)
+{
+	const ShaderStage unbound[] = { ShaderStage::Hull, ShaderStage::Domain, ShaderStage::Geometry };
+	for (ShaderStage stage : unbound)
+	{
+		if (m_bound.Shaders[(UINT)stage] != nullptr)
+			context->SetShader(stage, nullptr);
+	}
+	if (m_bound.RasterizerState != nullptr)
+		context->RSSetState(nullptr);
+	if (m_bound.BlendState != nullptr)
+	{
+		static const FLOAT blendFactor[4] = {};
+		context->OMSetBlendState(nullptr, blendFactor, 0xffffffff);
+	}
+
+	// Shadow and ssao maps are render targets of the next frame.
+	static ID3D11ShaderResourceView* const nullViews[StageBindings::MaxShaderResources] = {};
+	for (UINT stage = 0; stage < GraphicsStageCount; ++stage)
+	{
+		if (m_boundShaderResources[stage])
+			context->SetShaderResources((ShaderStage)stage, 0, m_boundShaderResources[stage], nullViews);
+	}
+}
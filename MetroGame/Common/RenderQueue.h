@@ -0,0 +1,207 @@
+#pragma once
+
+#include "RenderContext.h"
+#include <vector>
+
+// Collects the draws of one pass as packets instead of issuing them in the order
+// the components are called. Each packet refers to a draw state, the constants to
+// upload before it and a 64-bit sort key; Execute radix-sorts the keys and binds
+// only what differs from the state of the draw before.
+// The key holds, from the highest bits down, the pass, the bucket, and for opaque
+// draws the program (input layout, topology and shaders), the state and the depth
+// front to back; transparent draws sort by depth back to front before the program.
+// Given a constant ring buffer, the constants of all draws are written to it with one
+// map and each draw binds its window of it instead of mapping the buffer it names.
+// The translation unit doesn't use the precompiled header.
+
+namespace DX
+{
+	class ConstantRingBuffer;
+
+	enum class RenderPass : UINT8
+	{
+		Depth,				// Shadow maps
+		NormalDepth,		// View space normals and depth for ssao
+		Color
+	};
+
+	enum class RenderBucket : UINT8
+	{
+		Opaque,
+		Transparent
+	};
+
+	// The stages a draw uses, the first ones of ShaderStage.
+	const UINT GraphicsStageCount = 5;
+
+	// The slots a stage binds from 0; those past the counts are left as they are.
+	struct StageBindings
+	{
+		static const UINT MaxConstantBuffers = 4;
+		static const UINT MaxShaderResources = 5;
+		static const UINT MaxSamplers = 2;
+
+		ID3D11Buffer* ConstantBuffers[MaxConstantBuffers];
+		UINT ConstantBufferCount;
+		ID3D11ShaderResourceView* ShaderResources[MaxShaderResources];
+		UINT ShaderResourceCount;
+		ID3D11SamplerState* Samplers[MaxSamplers];
+		UINT SamplerCount;
+	};
+
+	// The pipeline of a group of draws. Null shaders and states are bound as null.
+	struct DrawState
+	{
+		static const UINT MaxVertexBuffers = 2;
+
+		DrawState();
+
+		void SetShader(ShaderStage stage, ID3D11DeviceChild* shader) { Shaders[(UINT)stage] = shader; }
+		void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers);
+		void SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views);
+		void SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers);
+		void SetVertexBuffers(UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides);
+
+		RenderBucket Bucket;
+		ID3D11InputLayout* InputLayout;
+		D3D11_PRIMITIVE_TOPOLOGY Topology;
+		ID3D11Buffer* VertexBuffers[MaxVertexBuffers];
+		UINT Strides[MaxVertexBuffers];
+		UINT VertexBufferCount;
+		ID3D11Buffer* IndexBuffer;
+		DXGI_FORMAT IndexFormat;
+		ID3D11DeviceChild* Shaders[GraphicsStageCount];
+		StageBindings Stages[GraphicsStageCount];
+		ID3D11RasterizerState* RasterizerState;
+		ID3D11BlendState* BlendState;		// Blend factor of 0s, all samples
+	};
+
+	class RenderQueue
+	{
+	public:
+		RenderQueue();
+
+		// Drops the packets of the previous pass.
+		void Begin(RenderPass pass);
+		RenderPass GetPass() const { return m_pass; }
+
+		// Returns the index the draws of the state refer to.
+		UINT AddState(const DrawState& state);
+
+		// Copies the data, uploaded to the buffer before the next draw added.
+		void SetConstants(ID3D11Buffer* buffer, const void* data, UINT size);
+		template<typename TBuffer>
+		void SetConstants(const TBuffer& buffer) { SetConstants(buffer.GetBuffer(), &buffer.Data, sizeof(buffer.Data)); }
+
+		// Depth is any non-negative value growing with the distance from the eye,
+		// like the squared distance.
+		void Draw(UINT state, UINT vertexCount, UINT startVertex, float depth = 0.0f);
+		void DrawIndexed(UINT state, UINT indexCount, UINT startIndex, INT baseVertex, float depth = 0.0f);
+		void DrawIndexedInstanced(UINT state, UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, float depth = 0.0f);
+
+		// Submits the packets, in key order unless sorting is disabled. Afterwards no
+		// hull, domain or geometry shader, rasterizer or blend state nor any of the
+		// shader resources it bound is left bound. Buffers of constants written to the
+		// ring are left bound as windows of it, and don't hold the constants themselves.
+		// Without a ring, or a context supporting offsets, each upload maps its buffer.
+		void Execute(RenderContext* context, ConstantRingBuffer* ring = nullptr);
+
+		UINT GetPacketCount() const { return (UINT)m_packets.size(); }
+
+		// Off submits in the order the draws were added, to compare the state changes.
+		static void SetSortingEnabled(bool enabled) { m_sortingEnabled = enabled; }
+		static bool IsSortingEnabled() { return m_sortingEnabled; }
+		// Off maps the buffers per upload even given a ring, to compare the maps.
+		static void SetConstantRingEnabled(bool enabled) { m_constantRingEnabled = enabled; }
+		static bool IsConstantRingEnabled() { return m_constantRingEnabled; }
+
+		static UINT64 MakeKey(RenderPass pass, RenderBucket bucket, UINT program, UINT state, float depth);
+
+	private:
+		enum class DrawType : UINT8
+		{
+			Draw,
+			DrawIndexed,
+			DrawIndexedInstanced
+		};
+
+		struct Packet
+		{
+			UINT State;
+			UINT FirstUpload;
+			UINT UploadCount;
+			DrawType Type;
+			UINT Count;			// Vertices or indices
+			UINT InstanceCount;
+			UINT Start;
+			INT Base;
+		};
+
+		struct Upload
+		{
+			ID3D11Buffer* Buffer;
+			UINT Offset;		// Into m_constants
+			UINT Size;
+		};
+
+		// Of a buffer whose constants were last written to the ring.
+		struct Window
+		{
+			ID3D11Buffer* Buffer;
+			UINT FirstConstant;
+			UINT NumConstants;
+		};
+
+		struct Program
+		{
+			ID3D11InputLayout* InputLayout;
+			D3D11_PRIMITIVE_TOPOLOGY Topology;
+			ID3D11DeviceChild* Shaders[GraphicsStageCount];
+		};
+
+		struct SortItem
+		{
+			UINT64 Key;
+			UINT Index;			// Of the packet
+		};
+
+		void AddPacket(UINT state, DrawType type, UINT count, UINT instanceCount, UINT start, INT base, float depth);
+		UINT GetProgram(const DrawState& state);
+		static void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+
+		void Forget();
+		void Bind(RenderContext* context, const DrawState& state);
+		void BindConstantBuffers(RenderContext* context, ShaderStage stage, UINT first, UINT end, ID3D11Buffer* const* buffers);
+		bool IsRepeated(const Upload& upload);
+		void UploadConstants(RenderContext* context, const Upload& upload);
+		bool WriteToRing(RenderContext* context, ConstantRingBuffer* ring);
+		void BindWindow(RenderContext* context, const DrawState& state, const Upload& upload, UINT offset);
+		void Restore(RenderContext* context);
+
+	private:
+		RenderPass m_pass;
+		std::vector<DrawState> m_states;
+		std::vector<UINT> m_stateProgram;
+		std::vector<Program> m_programs;
+		std::vector<Packet> m_packets;
+		std::vector<Upload> m_uploads;
+		std::vector<BYTE> m_constants;
+		UINT m_pendingUploads;
+		std::vector<SortItem> m_items;
+		std::vector<SortItem> m_scratch;
+
+		// What Execute has bound, and the last constants uploaded to each buffer.
+		DrawState m_bound;
+		UINT m_boundShaderResources[GraphicsStageCount];
+		std::vector<Upload> m_lastUploads;
+
+		// The ring Execute writes to, the offset of each upload in it, UINT_MAX for
+		// those repeating the last of their buffer, and the windows bound.
+		ConstantRingBuffer* m_ring;
+		std::vector<UINT> m_uploadOffsets;
+		std::vector<Window> m_windows;
+
+		static bool m_sortingEnabled;
+		static bool m_constantRingEnabled;
+	};
+}
@@ -14,7 +14,7 @@ RenderStateMgr::RenderStateMgr()
 		throw ref new Platform::FailureException("Cannot create more than one RenderStateMgr!");
 }
 
-void RenderStateMgr::Initialize(ID3D11Device* device)
+void RenderStateMgr::Initialize(RenderDevice* device)
 {
 	// WireframeRS
 	D3D11_RASTERIZER_DESC rasterizerDesc;
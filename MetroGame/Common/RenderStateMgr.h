@@ -1,5 +1,7 @@
 #pragma once
 
+#include "RenderDevice.h"
+
 namespace DX
 {
 	class RenderStateMgr
@@ -10,7 +12,7 @@ namespace DX
 		// Singleton
 		static RenderStateMgr* Instance() { return m_instance; }
 		
-		void Initialize(ID3D11Device* device);
+		void Initialize(RenderDevice* device);
 		void Release();
 
 		ID3D11RasterizerState* WireFrameRS() { return m_wireframeRS.Get(); }
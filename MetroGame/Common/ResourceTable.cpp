@@ -0,0 +1,25 @@
+#include "ResourceTable.h"
+#include <wchar.h>
+
+using namespace DX;
+
+ResourceHandle::ResourceHandle(const wchar_t* name) :
+	m_value(Hash(name, wcslen(name)))
+{
+}
+
+unsigned long long ResourceHandle::Hash(const wchar_t* name, size_t length)
+{
+	const unsigned long long offsetBasis = 14695981039346656037ull;
+	const unsigned long long prime = 1099511628211ull;
+
+	// By 16-bit code units, so that handles are the same where wchar_t is wider.
+	unsigned long long hash = offsetBasis;
+	for (size_t i = 0; i < length; ++i)
+	{
+		unsigned code = (unsigned)name[i] & 0xffff;
+		hash = (hash ^ (code & 0xff)) * prime;
+		hash = (hash ^ (code >> 8)) * prime;
+	}
+	return hash != 0 ? hash : 1;
+}
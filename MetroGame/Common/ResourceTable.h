@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Resources named by files, like shaders and textures, are kept by 64-bit handles
+// hashed from the names, and looked up in an open addressing table: the handle
+// picks a slot of a power of two array kept at most half full, and probing goes on
+// to the next slots until the handle or an empty one. Only handles are compared,
+// in an array of their own; the names are kept beside the resources, to tell two
+// names hashing to one handle apart, which throws.
+// It only depends on the standard library; the translation unit doesn't use the
+// precompiled header.
+
+namespace DX
+{
+	class ResourceHandle
+	{
+	public:
+		// No resource
+		ResourceHandle() : m_value(0) {}
+		explicit ResourceHandle(const std::wstring& name) : m_value(Hash(name.c_str(), name.size())) {}
+		explicit ResourceHandle(const wchar_t* name);
+
+		unsigned long long GetValue()const { return m_value; }
+		bool IsValid()const { return m_value != 0; }
+		bool operator==(ResourceHandle other)const { return m_value == other.m_value; }
+		bool operator!=(ResourceHandle other)const { return m_value != other.m_value; }
+
+		// FNV-1a of the UTF-16 code units, never 0.
+		static unsigned long long Hash(const wchar_t* name, size_t length);
+
+	private:
+		unsigned long long m_value;
+	};
+
+	template<typename T>
+	class ResourceTable
+	{
+	public:
+		ResourceTable() : m_count(0) {}
+
+		// nullptr if nothing was added by the handle. Valid until the next Insert.
+		T* Find(ResourceHandle handle)
+		{
+			size_t slot = FindSlot(handle.GetValue());
+			return m_handles.empty() || m_handles[slot] == 0 ? nullptr : &m_resources[slot];
+		}
+		// The same, throwing if what was added by the handle has another name.
+		T* Find(ResourceHandle handle, const std::wstring& name)
+		{
+			size_t slot = FindSlot(handle.GetValue());
+			if (m_handles.empty() || m_handles[slot] == 0)
+				return nullptr;
+			CheckName(slot, name);
+			return &m_resources[slot];
+		}
+
+		// Adds or replaces the resource of the handle. Resources added without a name
+		// aren't checked.
+		void Insert(ResourceHandle handle, const std::wstring& name, const T& resource)
+		{
+			if (!handle.IsValid())
+				throw std::invalid_argument("Invalid resource handle!");
+			if ((m_count + 1) * 2 > m_handles.size())
+				Grow();
+
+			size_t slot = FindSlot(handle.GetValue());
+			if (m_handles[slot] != 0)
+			{
+				CheckName(slot, name);
+			}
+			else
+			{
+				m_handles[slot] = handle.GetValue();
+				m_names[slot] = name;
+				++m_count;
+			}
+			m_resources[slot] = resource;
+		}
+		void Insert(ResourceHandle handle, const T& resource) { Insert(handle, std::wstring(), resource); }
+
+		size_t GetCount()const { return m_count; }
+
+		void Clear()
+		{
+			m_handles.clear();
+			m_names.clear();
+			m_resources.clear();
+			m_count = 0;
+		}
+
+	private:
+		// The slot holding the handle, or the empty one where it would go.
+		size_t FindSlot(unsigned long long handle)const
+		{
+			if (m_handles.empty())
+				return 0;
+			size_t mask = m_handles.size() - 1;
+			size_t slot = (size_t)(handle ^ handle >> 32) & mask;
+			while (m_handles[slot] != 0 && m_handles[slot] != handle)
+				slot = (slot + 1) & mask;
+			return slot;
+		}
+
+		void CheckName(size_t slot, const std::wstring& name)const
+		{
+			if (!name.empty() && !m_names[slot].empty() && m_names[slot] != name)
+				throw std::runtime_error("Two resource names hash to the same handle!");
+		}
+
+		void Grow()
+		{
+			std::vector<unsigned long long> handles(m_handles.empty() ? 16 : m_handles.size() * 2, 0);
+			std::vector<std::wstring> names(handles.size());
+			std::vector<T> resources(handles.size());
+			m_handles.swap(handles);
+			m_names.swap(names);
+			m_resources.swap(resources);
+			for (size_t i = 0; i < handles.size(); ++i)
+			{
+				if (handles[i] == 0)
+					continue;
+				size_t slot = FindSlot(handles[i]);
+				m_handles[slot] = handles[i];
+				m_names[slot].swap(names[i]);
+				m_resources[slot] = resources[i];
+			}
+		}
+
+	private:
+		std::vector<unsigned long long> m_handles;		// 0 for empty slots
+		std::vector<std::wstring> m_names;
+		std::vector<T> m_resources;
+		size_t m_count;
+	};
+}
@@ -68,6 +68,31 @@ D3D11_INPUT_ELEMENT_DESC BasicParticleDesc[5] =
 	{ "TYPE",     0, DXGI_FORMAT_R32_UINT,        0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 };
 
+// Two streams: immutable PosXZTex in slot 0, dynamic height and normal in slot 1.
+D3D11_INPUT_ELEMENT_DESC PosXZTexHeightNormalDesc[4] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "HEIGHT",   0, DXGI_FORMAT_R32_FLOAT,       1, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 4, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+};
+
+D3D11_INPUT_ELEMENT_DESC PosNormalTexTanInstancedDesc[12] =
+{
+	{ "POSITION",          0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,   D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",            0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 12,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD",          0, DXGI_FORMAT_R32G32_FLOAT,       0, 24,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT",           0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "WORLD",             0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,   D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD",             1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD",             2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD",             3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 80,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 96,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 112, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+};
+
 #pragma endregion
 
 #pragma region StreamOut declaration
@@ -108,12 +133,13 @@ ID3D11InputLayout* ShaderMgr::GetInputLayout(InputLayoutType type)
 	}
 }
 
-ID3D11VertexShader* ShaderMgr::GetVS(std::wstring name, InputLayoutType type)
+ID3D11VertexShader* ShaderMgr::GetVS(const std::wstring& name, InputLayoutType type)
 {
 	// Does it already exist?
-	if (m_vs.find(name) != m_vs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_vs.Find(handle, name))
 	{
-		return m_vs[name].Get();
+		return found->Get();
 	}
 	else
 	{
@@ -152,6 +178,12 @@ ID3D11VertexShader* ShaderMgr::GetVS(std::wstring name, InputLayoutType type)
 		case InputLayoutType::BasicParticle:
 			m_loader->LoadShader(file, BasicParticleDesc, 5, vs.GetAddressOf(), inputLayout.GetAddressOf());
 			break;
+		case InputLayoutType::PosXZTexHeightNormal:
+			m_loader->LoadShader(file, PosXZTexHeightNormalDesc, 4, vs.GetAddressOf(), inputLayout.GetAddressOf());
+			break;
+		case InputLayoutType::PosNormalTexTanInstanced:
+			m_loader->LoadShader(file, PosNormalTexTanInstancedDesc, 12, vs.GetAddressOf(), inputLayout.GetAddressOf());
+			break;
 		case InputLayoutType::None:
 			m_loader->LoadShader(file, nullptr, 0, vs.GetAddressOf(), nullptr);
 			break;
@@ -159,7 +191,7 @@ ID3D11VertexShader* ShaderMgr::GetVS(std::wstring name, InputLayoutType type)
 			throw ref new Platform::InvalidArgumentException("No such input layout type!");
 		}
 
-		m_vs[name] = vs;
+		m_vs.Insert(handle, name, vs);
 
 		if (type != InputLayoutType::None)
 		{
@@ -168,12 +200,13 @@ ID3D11VertexShader* ShaderMgr::GetVS(std::wstring name, InputLayoutType type)
 		return vs.Get();
 	}
 }
-concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name, InputLayoutType type)
+concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(const std::wstring& name, InputLayoutType type)
 {
 	// Does it already exist?
-	if (m_vs.find(name) != m_vs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_vs.Find(handle, name))
 	{
-		return concurrency::task_from_result(m_vs[name].Get());
+		return concurrency::task_from_result(found->Get());
 	}
 	else
 	{
@@ -191,7 +224,7 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 		case InputLayoutType::Pos:
 			return m_loader->LoadShaderAsync(file, PosDesc, 1, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
 			{
-				m_vs[name] = vs->Get();
+				m_vs.Insert(handle, name, vs->Get());
 
 				m_inputLayout[type] = inputLayout->Get();
 				return vs->Get();
@@ -199,7 +232,7 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 		case InputLayoutType::Basic32:
 			return m_loader->LoadShaderAsync(file, Basic32Desc, 3, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
 			{
-				m_vs[name] = vs->Get();
+				m_vs.Insert(handle, name, vs->Get());
 
 				m_inputLayout[type] = inputLayout->Get();
 				return vs->Get();
@@ -207,7 +240,7 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 		case InputLayoutType::PosNormalTexTan:
 			return m_loader->LoadShaderAsync(file, PosNormalTexTanDesc, 4, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
 			{
-				m_vs[name] = vs->Get();
+				m_vs.Insert(handle, name, vs->Get());
 
 				m_inputLayout[type] = inputLayout->Get();
 				return vs->Get();
@@ -215,7 +248,7 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 		case InputLayoutType::PosNormalTexTanSkinned:
 			return m_loader->LoadShaderAsync(file, PosNormalTexTanSkinnedDesc, 6, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
 			{
-				m_vs[name] = vs->Get();
+				m_vs.Insert(handle, name, vs->Get());
 
 				m_inputLayout[type] = inputLayout->Get();
 				return vs->Get();
@@ -223,7 +256,7 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 		case InputLayoutType::PosColor:
 			return m_loader->LoadShaderAsync(file, PosColorDesc, 2, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
 			{
-				m_vs[name] = vs->Get();
+				m_vs.Insert(handle, name, vs->Get());
 
 				m_inputLayout[type] = inputLayout->Get();
 				return vs->Get();
@@ -231,7 +264,7 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 		case InputLayoutType::PointSize:
 			return m_loader->LoadShaderAsync(file, PointSizeDesc, 2, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
 			{
-				m_vs[name] = vs->Get();
+				m_vs.Insert(handle, name, vs->Get());
 
 				m_inputLayout[type] = inputLayout->Get();
 				return vs->Get();
@@ -239,7 +272,7 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 		case InputLayoutType::PosTexBound:
 			return m_loader->LoadShaderAsync(file, PosTexBoundDesc, 3, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
 			{
-				m_vs[name] = vs->Get();
+				m_vs.Insert(handle, name, vs->Get());
 
 				m_inputLayout[type] = inputLayout->Get();
 				return vs->Get();
@@ -247,7 +280,23 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 		case InputLayoutType::BasicParticle:
 			return m_loader->LoadShaderAsync(file, BasicParticleDesc, 5, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
 			{
-				m_vs[name] = vs->Get();
+				m_vs.Insert(handle, name, vs->Get());
+
+				m_inputLayout[type] = inputLayout->Get();
+				return vs->Get();
+			});
+		case InputLayoutType::PosXZTexHeightNormal:
+			return m_loader->LoadShaderAsync(file, PosXZTexHeightNormalDesc, 4, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
+			{
+				m_vs.Insert(handle, name, vs->Get());
+
+				m_inputLayout[type] = inputLayout->Get();
+				return vs->Get();
+			});
+		case InputLayoutType::PosNormalTexTanInstanced:
+			return m_loader->LoadShaderAsync(file, PosNormalTexTanInstancedDesc, 12, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
+			{
+				m_vs.Insert(handle, name, vs->Get());
 
 				m_inputLayout[type] = inputLayout->Get();
 				return vs->Get();
@@ -255,7 +304,7 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 		case InputLayoutType::None:
 			return m_loader->LoadShaderAsync(file, nullptr, 0, vs->GetAddressOf(), nullptr).then([=]()
 			{
-				m_vs[name] = vs->Get();
+				m_vs.Insert(handle, name, vs->Get());
 				return vs->Get();
 			});
 		default:
@@ -264,12 +313,13 @@ concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name,
 	}
 }
 
-ID3D11PixelShader* ShaderMgr::GetPS(std::wstring name)
+ID3D11PixelShader* ShaderMgr::GetPS(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_ps.find(name) != m_ps.end())
+	ResourceHandle handle(name);
+	if (auto found = m_ps.Find(handle, name))
 	{
-		return m_ps[name].Get();
+		return found->Get();
 	}
 	else
 	{
@@ -278,17 +328,18 @@ ID3D11PixelShader* ShaderMgr::GetPS(std::wstring name)
 
 		m_loader->LoadShader(file, ps.GetAddressOf());
 
-		m_ps[name] = ps.Get();
+		m_ps.Insert(handle, name, ps.Get());
 		
 		return ps.Get();
 	}
 }
-concurrency::task<ID3D11PixelShader*> ShaderMgr::GetPSAsync(std::wstring name)
+concurrency::task<ID3D11PixelShader*> ShaderMgr::GetPSAsync(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_ps.find(name) != m_ps.end())
+	ResourceHandle handle(name);
+	if (auto found = m_ps.Find(handle, name))
 	{
-		return concurrency::task_from_result(m_ps[name].Get());
+		return concurrency::task_from_result(found->Get());
 	}
 	else
 	{
@@ -297,18 +348,19 @@ concurrency::task<ID3D11PixelShader*> ShaderMgr::GetPSAsync(std::wstring name)
 
 		return m_loader->LoadShaderAsync(file, ps->GetAddressOf()).then([=]()
 		{
-			m_ps[name] = ps->Get();
+			m_ps.Insert(handle, name, ps->Get());
 			return ps->Get();
 		});
 	}
 }
 
-ID3D11ComputeShader* ShaderMgr::GetCS(std::wstring name)
+ID3D11ComputeShader* ShaderMgr::GetCS(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_cs.find(name) != m_cs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_cs.Find(handle, name))
 	{
-		return m_cs[name].Get();
+		return found->Get();
 	}
 	else
 	{
@@ -316,16 +368,17 @@ ID3D11ComputeShader* ShaderMgr::GetCS(std::wstring name)
 		ComPtr<ID3D11ComputeShader> cs;
 
 		m_loader->LoadShader(file, cs.GetAddressOf());
-		m_cs[name] = cs.Get();
+		m_cs.Insert(handle, name, cs.Get());
 		return cs.Get();
 	}
 }
-concurrency::task<ID3D11ComputeShader*> ShaderMgr::GetCSAsync(std::wstring name)
+concurrency::task<ID3D11ComputeShader*> ShaderMgr::GetCSAsync(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_cs.find(name) != m_cs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_cs.Find(handle, name))
 	{
-		return concurrency::task_from_result(m_cs[name].Get());
+		return concurrency::task_from_result(found->Get());
 	}
 	else
 	{
@@ -334,18 +387,19 @@ concurrency::task<ID3D11ComputeShader*> ShaderMgr::GetCSAsync(std::wstring name)
 
 		return m_loader->LoadShaderAsync(file, cs->GetAddressOf()).then([=]()
 		{
-			m_cs[name] = cs->Get();
+			m_cs.Insert(handle, name, cs->Get());
 			return cs->Get();
 		});
 	}
 }
 
-ID3D11GeometryShader* ShaderMgr::GetGS(std::wstring name)
+ID3D11GeometryShader* ShaderMgr::GetGS(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_gs.find(name) != m_gs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_gs.Find(handle, name))
 	{
-		return m_gs[name].Get();
+		return found->Get();
 	}
 	else
 	{
@@ -353,16 +407,17 @@ ID3D11GeometryShader* ShaderMgr::GetGS(std::wstring name)
 		ComPtr<ID3D11GeometryShader> gs;
 
 		m_loader->LoadShader(file, gs.GetAddressOf());
-		m_gs[name] = gs.Get();
+		m_gs.Insert(handle, name, gs.Get());
 		return gs.Get();
 	}
 }
-concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(std::wstring name)
+concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_gs.find(name) != m_gs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_gs.Find(handle, name))
 	{
-		return concurrency::task_from_result(m_gs[name].Get());
+		return concurrency::task_from_result(found->Get());
 	}
 	else
 	{
@@ -371,18 +426,19 @@ concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(std::wstring name
 
 		return m_loader->LoadShaderAsync(file, gs->GetAddressOf()).then([=]()
 		{
-			m_gs[name] = gs->Get();
+			m_gs.Insert(handle, name, gs->Get());
 			return gs->Get();
 		});
 	}
 }
 
-ID3D11GeometryShader* ShaderMgr::GetGS(std::wstring name, StreamOutType type)
+ID3D11GeometryShader* ShaderMgr::GetGS(const std::wstring& name, StreamOutType type)
 {
 	// Does it already exist?
-	if (m_gs.find(name) != m_gs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_gs.Find(handle, name))
 	{
-		return m_gs[name].Get();
+		return found->Get();
 	}
 	else
 	{
@@ -401,16 +457,17 @@ ID3D11GeometryShader* ShaderMgr::GetGS(std::wstring name, StreamOutType type)
 			throw ref new Platform::InvalidArgumentException("No such stream out type!");
 		}
 
-		m_gs[name] = gs.Get();
+		m_gs.Insert(handle, name, gs.Get());
 		return gs.Get();
 	}
 }
-concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(std::wstring name, StreamOutType type)
+concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(const std::wstring& name, StreamOutType type)
 {
 	// Does it already exist?
-	if (m_gs.find(name) != m_gs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_gs.Find(handle, name))
 	{
-		return concurrency::task_from_result(m_gs[name].Get());
+		return concurrency::task_from_result(found->Get());
 	}
 	else
 	{
@@ -424,7 +481,7 @@ concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(std::wstring name
 			uint32 strides[] = { sizeof(BasicParticle) };
 			return m_loader->LoadShaderAsync(file, BasicParticleDecl, 5, strides, 1, 0, gs->GetAddressOf()).then([=]()
 			{
-				m_gs[name] = gs->Get();
+				m_gs.Insert(handle, name, gs->Get());
 				return gs->Get();
 			});
 		}
@@ -434,12 +491,13 @@ concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(std::wstring name
 	}
 }
 
-ID3D11HullShader* ShaderMgr::GetHS(std::wstring name)
+ID3D11HullShader* ShaderMgr::GetHS(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_hs.find(name) != m_hs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_hs.Find(handle, name))
 	{
-		return m_hs[name].Get();
+		return found->Get();
 	}
 	else
 	{
@@ -447,16 +505,17 @@ ID3D11HullShader* ShaderMgr::GetHS(std::wstring name)
 		ComPtr<ID3D11HullShader> hs;
 
 		m_loader->LoadShader(file, hs.GetAddressOf());
-		m_hs[name] = hs.Get();
+		m_hs.Insert(handle, name, hs.Get());
 		return hs.Get();
 	}
 }
-concurrency::task<ID3D11HullShader*> ShaderMgr::GetHSAsync(std::wstring name)
+concurrency::task<ID3D11HullShader*> ShaderMgr::GetHSAsync(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_hs.find(name) != m_hs.end())
+	ResourceHandle handle(name);
+	if (auto found = m_hs.Find(handle, name))
 	{
-		return concurrency::task_from_result(m_hs[name].Get());
+		return concurrency::task_from_result(found->Get());
 	}
 	else
 	{
@@ -465,18 +524,19 @@ concurrency::task<ID3D11HullShader*> ShaderMgr::GetHSAsync(std::wstring name)
 
 		return m_loader->LoadShaderAsync(file, hs->GetAddressOf()).then([=]()
 		{
-			m_hs[name] = hs->Get();
+			m_hs.Insert(handle, name, hs->Get());
 			return hs->Get();
 		});
 	}
 }
 
-ID3D11DomainShader* ShaderMgr::GetDS(std::wstring name)
+ID3D11DomainShader* ShaderMgr::GetDS(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_ds.find(name) != m_ds.end())
+	ResourceHandle handle(name);
+	if (auto found = m_ds.Find(handle, name))
 	{
-		return m_ds[name].Get();
+		return found->Get();
 	}
 	else
 	{
@@ -484,16 +544,17 @@ ID3D11DomainShader* ShaderMgr::GetDS(std::wstring name)
 		ComPtr<ID3D11DomainShader> ds;
 
 		m_loader->LoadShader(file, ds.GetAddressOf());
-		m_ds[name] = ds.Get();
+		m_ds.Insert(handle, name, ds.Get());
 		return ds.Get();
 	}
 }
-concurrency::task<ID3D11DomainShader*> ShaderMgr::GetDSAsync(std::wstring name)
+concurrency::task<ID3D11DomainShader*> ShaderMgr::GetDSAsync(const std::wstring& name)
 {
 	// Does it already exist?
-	if (m_ds.find(name) != m_ds.end())
+	ResourceHandle handle(name);
+	if (auto found = m_ds.Find(handle, name))
 	{
-		return concurrency::task_from_result(m_ds[name].Get());
+		return concurrency::task_from_result(found->Get());
 	}
 	else
 	{
@@ -502,8 +563,44 @@ concurrency::task<ID3D11DomainShader*> ShaderMgr::GetDSAsync(std::wstring name)
 
 		return m_loader->LoadShaderAsync(file, ds->GetAddressOf()).then([=]()
 		{
-			m_ds[name] = ds->Get();
+			m_ds.Insert(handle, name, ds->Get());
 			return ds->Get();
 		});
 	}
 }
+
+ID3D11VertexShader* ShaderMgr::FindVS(ResourceHandle handle)
+{
+	auto found = m_vs.Find(handle);
+	return found ? found->Get() : nullptr;
+}
+
+ID3D11PixelShader* ShaderMgr::FindPS(ResourceHandle handle)
+{
+	auto found = m_ps.Find(handle);
+	return found ? found->Get() : nullptr;
+}
+
+ID3D11ComputeShader* ShaderMgr::FindCS(ResourceHandle handle)
+{
+	auto found = m_cs.Find(handle);
+	return found ? found->Get() : nullptr;
+}
+
+ID3D11GeometryShader* ShaderMgr::FindGS(ResourceHandle handle)
+{
+	auto found = m_gs.Find(handle);
+	return found ? found->Get() : nullptr;
+}
+
+ID3D11HullShader* ShaderMgr::FindHS(ResourceHandle handle)
+{
+	auto found = m_hs.Find(handle);
+	return found ? found->Get() : nullptr;
+}
+
+ID3D11DomainShader* ShaderMgr::FindDS(ResourceHandle handle)
+{
+	auto found = m_ds.Find(handle);
+	return found ? found->Get() : nullptr;
+}
@@ -0,0 +1,351 @@
+#include "StateCacheRenderContext.h"
+#include <algorithm>
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+	// Differs from every object, for the bindings nothing is known about.
+	const void* const Unknown = reinterpret_cast<const void*>(~(UINT_PTR)0);
+}
+
+StateCacheRenderContext::StateCacheRenderContext(RenderContext* inner) :
+	m_inner(inner)
+{
+	BeginFrame();
+	Invalidate();
+}
+
+void StateCacheRenderContext::BeginFrame()
+{
+	memset(&m_counters, 0, sizeof(m_counters));
+}
+
+void StateCacheRenderContext::Invalidate()
+{
+	for (UINT stage = 0; stage < ShaderStageCount; ++stage)
+	{
+		Forget(m_shaders[stage]);
+		Forget(m_constantBuffers[stage]);
+		Forget(m_shaderResources[stage]);
+		Forget(m_samplers[stage]);
+	}
+	Forget(m_inputLayout);
+	Forget(m_vertexBuffers);
+	Forget(m_indexBuffer);
+	Forget(m_topology);
+	Forget(m_streamOutTargets);
+	Forget(m_unorderedAccessViews);
+	Forget(m_rasterizerState);
+	Forget(m_renderTargets);
+	Forget(m_blendState);
+	Forget(m_depthStencilState);
+	memset(m_blendFactor, 0, sizeof(m_blendFactor));
+	m_viewports.clear();
+	m_viewportsKnown = false;
+}
+
+template<UINT Capacity>
+void StateCacheRenderContext::Bind(Slots<Capacity>& slots, UINT startSlot, UINT count, const void* const* objects, const UINT64* values,
+	UINT& first, UINT& end)
+{
+	first = end = startSlot;
+	for (UINT k = 0; k < count; ++k)
+	{
+		UINT slot = startSlot + k;
+		if (slot >= Capacity)
+		{
+			if (first == end)
+				first = slot;
+			end = startSlot + count;
+			return;
+		}
+
+		const void* object = objects ? objects[k] : nullptr;
+		UINT64 value = values ? values[k] : 0;
+		if (slots.Objects[slot] != object || slots.Values[slot] != value)
+		{
+			if (first == end)
+				first = slot;
+			end = slot + 1;
+			slots.Objects[slot] = object;
+			slots.Values[slot] = value;
+		}
+	}
+}
+
+template<UINT Capacity>
+bool StateCacheRenderContext::Bind(Slots<Capacity>& slots, const void* object, UINT64 value)
+{
+	UINT first, end;
+	Bind(slots, 0, 1, &object, &value, first, end);
+	return first != end;
+}
+
+template<UINT Capacity>
+void StateCacheRenderContext::Forget(Slots<Capacity>& slots)
+{
+	std::fill(slots.Objects, slots.Objects + Capacity, Unknown);
+	std::fill(slots.Values, slots.Values + Capacity, 0);
+}
+
+bool StateCacheRenderContext::Count(RenderCommandType type, bool changed)
+{
+	if (changed)
+	{
+		++m_counters.Issued[(UINT)type];
+		++m_counters.IssuedTotal;
+	}
+	else
+	{
+		++m_counters.Skipped[(UINT)type];
+		++m_counters.SkippedTotal;
+	}
+	return changed;
+}
+
+bool StateCacheRenderContext::Count(RenderCommandType type, UINT count, UINT first, UINT end)
+{
+	if (first != end)
+		m_counters.SlotsSkipped += count - (end - first);
+	return Count(type, first != end);
+}
+
+void StateCacheRenderContext::SetShader(ShaderStage stage, ID3D11DeviceChild* shader)
+{
+	if (Count(RenderCommandType::SetShader, Bind(m_shaders[(UINT)stage], shader)))
+		m_inner->SetShader(stage, shader);
+}
+
+void StateCacheRenderContext::SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	UINT first, end;
+	Bind(m_constantBuffers[(UINT)stage], startSlot, numBuffers, reinterpret_cast<const void* const*>(buffers), nullptr, first, end);
+	if (Count(RenderCommandType::SetConstantBuffers, numBuffers, first, end))
+		m_inner->SetConstantBuffers(stage, first, end - first, buffers + (first - startSlot));
+}
+
+void StateCacheRenderContext::SetConstantBuffers1(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers,
+	const UINT* firstConstants, const UINT* numConstants)
+{
+	// A window is another binding than the whole buffer, or another window of it.
+	UINT64 values[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+	UINT count = (std::min)(numBuffers, (UINT)D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT);
+	for (UINT k = 0; k < count; ++k)
+		values[k] = (UINT64)firstConstants[k] << 32 | numConstants[k];
+
+	UINT first, end;
+	Bind(m_constantBuffers[(UINT)stage], startSlot, numBuffers, reinterpret_cast<const void* const*>(buffers), values, first, end);
+	if (Count(RenderCommandType::SetConstantBuffers, numBuffers, first, end))
+	{
+		UINT skip = first - startSlot;
+		m_inner->SetConstantBuffers1(stage, first, end - first, buffers + skip, firstConstants + skip, numConstants + skip);
+	}
+}
+
+void StateCacheRenderContext::SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	UINT first, end;
+	Bind(m_shaderResources[(UINT)stage], startSlot, numViews, reinterpret_cast<const void* const*>(views), nullptr, first, end);
+	if (Count(RenderCommandType::SetShaderResources, numViews, first, end))
+		m_inner->SetShaderResources(stage, first, end - first, views + (first - startSlot));
+}
+
+void StateCacheRenderContext::SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	UINT first, end;
+	Bind(m_samplers[(UINT)stage], startSlot, numSamplers, reinterpret_cast<const void* const*>(samplers), nullptr, first, end);
+	if (Count(RenderCommandType::SetSamplers, numSamplers, first, end))
+		m_inner->SetSamplers(stage, first, end - first, samplers + (first - startSlot));
+}
+
+void StateCacheRenderContext::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	if (Count(RenderCommandType::SetInputLayout, Bind(m_inputLayout, inputLayout)))
+		m_inner->IASetInputLayout(inputLayout);
+}
+
+void StateCacheRenderContext::IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	UINT64 values[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	UINT count = (std::min)(numBuffers, (UINT)D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT);
+	for (UINT k = 0; k < count; ++k)
+		values[k] = (UINT64)strides[k] << 32 | offsets[k];
+
+	UINT first, end;
+	Bind(m_vertexBuffers, startSlot, numBuffers, reinterpret_cast<const void* const*>(buffers), values, first, end);
+	if (Count(RenderCommandType::SetVertexBuffers, numBuffers, first, end))
+	{
+		UINT skip = first - startSlot;
+		m_inner->IASetVertexBuffers(first, end - first, buffers + skip, strides + skip, offsets + skip);
+	}
+}
+
+void StateCacheRenderContext::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	if (Count(RenderCommandType::SetIndexBuffer, Bind(m_indexBuffer, buffer, (UINT64)format << 32 | offset)))
+		m_inner->IASetIndexBuffer(buffer, format, offset);
+}
+
+void StateCacheRenderContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	if (Count(RenderCommandType::SetPrimitiveTopology, Bind(m_topology, nullptr, (UINT64)topology)))
+		m_inner->IASetPrimitiveTopology(topology);
+}
+
+void StateCacheRenderContext::SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets)
+{
+	// The slots after the targets are unbound. An offset other than -1, append,
+	// moves the write position, a change whenever given.
+	const void* objects[D3D11_SO_BUFFER_SLOT_COUNT] = {};
+	bool changed = false;
+	for (UINT k = 0; k < numBuffers && k < D3D11_SO_BUFFER_SLOT_COUNT; ++k)
+	{
+		objects[k] = targets ? targets[k] : nullptr;
+		if (objects[k] && offsets && offsets[k] != (UINT)-1)
+			changed = true;
+	}
+	UINT first, end;
+	Bind(m_streamOutTargets, 0, D3D11_SO_BUFFER_SLOT_COUNT, objects, nullptr, first, end);
+	if (Count(RenderCommandType::SetStreamOutTargets, changed || first != end))
+	{
+		m_inner->SOSetTargets(numBuffers, targets, offsets);
+		Forget(m_vertexBuffers);
+		Forget(m_indexBuffer);
+	}
+}
+
+void StateCacheRenderContext::CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* views, const UINT* initialCounts)
+{
+	UINT first, end;
+	Bind(m_unorderedAccessViews, startSlot, numViews, reinterpret_cast<const void* const*>(views), nullptr, first, end);
+
+	// Initial counts reset the counters of the views, a change whenever given.
+	for (UINT k = 0; k < numViews && initialCounts; ++k)
+	{
+		if (initialCounts[k] != (UINT)-1 && views && views[k])
+		{
+			first = (std::min)(first == end ? startSlot + k : first, startSlot + k);
+			end = (std::max)(end, startSlot + k + 1);
+		}
+	}
+	if (Count(RenderCommandType::SetUnorderedAccessViews, numViews, first, end))
+	{
+		UINT skip = first - startSlot;
+		m_inner->CSSetUnorderedAccessViews(first, end - first, views + skip, initialCounts ? initialCounts + skip : nullptr);
+		for (UINT stage = 0; stage < ShaderStageCount; ++stage)
+			Forget(m_shaderResources[stage]);
+	}
+}
+
+void StateCacheRenderContext::RSSetState(ID3D11RasterizerState* state)
+{
+	if (Count(RenderCommandType::SetRasterizerState, Bind(m_rasterizerState, state)))
+		m_inner->RSSetState(state);
+}
+
+void StateCacheRenderContext::RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports)
+{
+	bool same = m_viewportsKnown && m_viewports.size() == numViewports &&
+		(numViewports == 0 || memcmp(m_viewports.data(), viewports, numViewports * sizeof(D3D11_VIEWPORT)) == 0);
+	if (Count(RenderCommandType::SetViewports, !same))
+	{
+		m_viewports.assign(viewports, viewports + numViewports);
+		m_viewportsKnown = true;
+		m_inner->RSSetViewports(numViewports, viewports);
+	}
+}
+
+void StateCacheRenderContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView)
+{
+	// The slots after the views are unbound.
+	const void* objects[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT + 1] = {};
+	for (UINT k = 0; k < numViews && k < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++k)
+		objects[k] = views ? views[k] : nullptr;
+	objects[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = depthStencilView;
+
+	UINT first, end;
+	Bind(m_renderTargets, 0, D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT + 1, objects, nullptr, first, end);
+	if (Count(RenderCommandType::SetRenderTargets, first != end))
+	{
+		m_inner->OMSetRenderTargets(numViews, views, depthStencilView);
+		for (UINT stage = 0; stage < ShaderStageCount; ++stage)
+			Forget(m_shaderResources[stage]);
+		Forget(m_unorderedAccessViews);
+	}
+}
+
+void StateCacheRenderContext::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+	// A null factor means 1s.
+	const FLOAT ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const FLOAT* factor = blendFactor ? blendFactor : ones;
+	bool changed = Bind(m_blendState, state, sampleMask);
+	changed = memcmp(m_blendFactor, factor, sizeof(m_blendFactor)) != 0 || changed;
+	memcpy(m_blendFactor, factor, sizeof(m_blendFactor));
+	if (Count(RenderCommandType::SetBlendState, changed))
+		m_inner->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void StateCacheRenderContext::OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef)
+{
+	if (Count(RenderCommandType::SetDepthStencilState, Bind(m_depthStencilState, state, stencilRef)))
+		m_inner->OMSetDepthStencilState(state, stencilRef);
+}
+
+void StateCacheRenderContext::ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4])
+{
+	m_inner->ClearRenderTargetView(view, color);
+}
+
+void StateCacheRenderContext::ClearDepthStencilView(ID3D11DepthStencilView* view, UINT clearFlags, FLOAT depth, UINT8 stencil)
+{
+	m_inner->ClearDepthStencilView(view, clearFlags, depth, stencil);
+}
+
+HRESULT StateCacheRenderContext::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped)
+{
+	++m_counters.Maps;
+	return m_inner->Map(resource, subresource, mapType, mapFlags, mapped);
+}
+
+void StateCacheRenderContext::Unmap(ID3D11Resource* resource, UINT subresource)
+{
+	m_inner->Unmap(resource, subresource);
+}
+
+void StateCacheRenderContext::GenerateMips(ID3D11ShaderResourceView* view)
+{
+	m_inner->GenerateMips(view);
+}
+
+void StateCacheRenderContext::Draw(UINT vertexCount, UINT startVertex)
+{
+	m_inner->Draw(vertexCount, startVertex);
+}
+
+void StateCacheRenderContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	m_inner->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void StateCacheRenderContext::DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+	m_inner->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void StateCacheRenderContext::DrawAuto()
+{
+	m_inner->DrawAuto();
+}
+
+void StateCacheRenderContext::Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ)
+{
+	m_inner->Dispatch(groupsX, groupsY, groupsZ);
+}
+
+bool StateCacheRenderContext::SupportsConstantBufferOffsets() const
+{
+	return m_inner->SupportsConstantBufferOffsets();
+}
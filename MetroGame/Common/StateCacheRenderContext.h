@@ -0,0 +1,126 @@
+#pragma once
+
+#include "RecordingRenderContext.h"
+
+// Keeps a shadow of everything bound through it, for every stage and slot, and
+// forwards a binding call to the inner context only for the slots it changes, so
+// components bind all they use without checking what is bound.
+// Whatever changes the device state behind it, like Present or Direct2D, must be
+// followed by Invalidate. Binding a resource as an output unbinds it as an input
+// on the device, and an input bound while it is an output reads as null, so a
+// change of render targets or unordered access views forgets the shader resources,
+// and one of stream out targets the vertex and index buffers.
+// Objects are only compared, so tests can use any distinct pointers with a mock
+// inner context. The translation unit doesn't use the precompiled header.
+
+namespace DX
+{
+	// Binding calls of each state change type of a frame, forwarded or elided, and
+	// the maps.
+	struct StateCacheCounters
+	{
+		UINT Issued[RenderCommandTypeCount];
+		UINT Skipped[RenderCommandTypeCount];
+		UINT IssuedTotal;
+		UINT SkippedTotal;
+		UINT SlotsSkipped;		// Of calls forwarded with fewer slots
+		UINT Maps;
+	};
+
+	class StateCacheRenderContext : public RenderContext
+	{
+	public:
+		explicit StateCacheRenderContext(RenderContext* inner);
+
+		RenderContext* GetInner() const { return m_inner; }
+
+		// Drops the counters of the previous frame.
+		void BeginFrame();
+		// Forgets the bound state, so that the next call of each kind is forwarded.
+		void Invalidate();
+
+		const StateCacheCounters& GetCounters() const { return m_counters; }
+
+		virtual void SetShader(ShaderStage stage, ID3D11DeviceChild* shader);
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers);
+		virtual void SetConstantBuffers1(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers,
+			const UINT* firstConstants, const UINT* numConstants);
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views);
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers);
+
+		virtual void IASetInputLayout(ID3D11InputLayout* inputLayout);
+		virtual void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+		virtual void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+		virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+		virtual void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets);
+		virtual void CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* views, const UINT* initialCounts);
+		virtual void RSSetState(ID3D11RasterizerState* state);
+		virtual void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports);
+		virtual void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView);
+		virtual void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask);
+		virtual void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef);
+
+		virtual void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]);
+		virtual void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT clearFlags, FLOAT depth, UINT8 stencil);
+		virtual HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped);
+		virtual void Unmap(ID3D11Resource* resource, UINT subresource);
+		virtual void GenerateMips(ID3D11ShaderResourceView* view);
+
+		virtual void Draw(UINT vertexCount, UINT startVertex);
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+		virtual void DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+		virtual void DrawAuto();
+		virtual void Dispatch(UINT groupsX, UINT groupsY, UINT groupsZ);
+
+		virtual bool SupportsConstantBufferOffsets() const;
+
+	private:
+		// Bindings of one kind, an object and a value like a stride and offset per slot.
+		template<UINT Capacity>
+		struct Slots
+		{
+			const void* Objects[Capacity];
+			UINT64 Values[Capacity];
+		};
+
+		// Binds count slots from startSlot, nullptr objects or values as null and 0,
+		// and returns the range [first, end) of those that changed, empty if none did.
+		// Slots past the capacity change every time; binding them is an error the
+		// device reports.
+		template<UINT Capacity>
+		static void Bind(Slots<Capacity>& slots, UINT startSlot, UINT count, const void* const* objects, const UINT64* values,
+			UINT& first, UINT& end);
+		template<UINT Capacity>
+		static bool Bind(Slots<Capacity>& slots, const void* object, UINT64 value = 0);
+		template<UINT Capacity>
+		static void Forget(Slots<Capacity>& slots);
+
+		// Counts the call, and returns whether to forward it.
+		bool Count(RenderCommandType type, bool changed);
+		// The same for calls binding count slots, of which those in [first, end) changed.
+		bool Count(RenderCommandType type, UINT count, UINT first, UINT end);
+
+	private:
+		RenderContext* m_inner;
+		StateCacheCounters m_counters;
+
+		// The bound state
+		Slots<1> m_shaders[ShaderStageCount];
+		Slots<D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT> m_constantBuffers[ShaderStageCount];
+		Slots<D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT> m_shaderResources[ShaderStageCount];
+		Slots<D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT> m_samplers[ShaderStageCount];
+		Slots<1> m_inputLayout;
+		Slots<D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT> m_vertexBuffers;	// Stride and offset
+		Slots<1> m_indexBuffer;				// Format and offset
+		Slots<1> m_topology;
+		Slots<D3D11_SO_BUFFER_SLOT_COUNT> m_streamOutTargets;
+		Slots<D3D11_PS_CS_UAV_REGISTER_COUNT> m_unorderedAccessViews;
+		Slots<1> m_rasterizerState;
+		Slots<D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT + 1> m_renderTargets;	// And the depth stencil view
+		Slots<1> m_blendState;				// Sample mask
+		Slots<1> m_depthStencilState;		// Stencil reference
+		FLOAT m_blendFactor[4];
+		std::vector<D3D11_VIEWPORT> m_viewports;
+		bool m_viewportsKnown;
+	};
+}
@@ -7,6 +7,22 @@ using namespace Microsoft::WRL;
 
 TextureMgr* TextureMgr::m_instance = nullptr;
 
+namespace
+{
+	// The files of an array, in order, to tell arrays whose handles collide apart.
+	std::wstring JoinFilenames(const std::vector<std::wstring>& filenames)
+	{
+		std::wstring signature;
+		for (size_t i = 0; i < filenames.size(); ++i)
+		{
+			if (i > 0)
+				signature += L'|';
+			signature += filenames[i];
+		}
+		return signature;
+	}
+}
+
 TextureMgr::TextureMgr(const std::shared_ptr<BasicLoader>& loader) : m_loader(loader)
 {
 	if (m_instance == nullptr)
@@ -15,12 +31,13 @@ TextureMgr::TextureMgr(const std::shared_ptr<BasicLoader>& loader) : m_loader(lo
 		throw ref new Platform::FailureException("Cannot create more than one TextureMgr!");
 }
 
-ID3D11ShaderResourceView* TextureMgr::GetTexture(std::wstring filename)
+ID3D11ShaderResourceView* TextureMgr::GetTexture(const std::wstring& filename)
 {
 	// Does it already exist?
-	if(m_textureSRV.find(filename) != m_textureSRV.end())
+	ResourceHandle handle(filename);
+	if (auto found = m_textureSRV.Find(handle, filename))
 	{
-		return m_textureSRV[filename].Get();
+		return found->Get();
 	}
 	else
 	{
@@ -28,16 +45,17 @@ ID3D11ShaderResourceView* TextureMgr::GetTexture(std::wstring filename)
 		ComPtr<ID3D11ShaderResourceView> textureView;
 
 		m_loader->LoadTexture(file, false, nullptr, textureView.GetAddressOf());
-		m_textureSRV[filename] = textureView.Get();
+		m_textureSRV.Insert(handle, filename, textureView.Get());
 		return textureView.Get();
 	}
 }
-concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureAsync(std::wstring filename)
+concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureAsync(const std::wstring& filename)
 {
 	// Does it already exist?
-	if (m_textureSRV.find(filename) != m_textureSRV.end())
+	ResourceHandle handle(filename);
+	if (auto found = m_textureSRV.Find(handle, filename))
 	{
-		return concurrency::task_from_result(m_textureSRV[filename].Get());
+		return concurrency::task_from_result(found->Get());
 	}
 	else
 	{
@@ -56,18 +74,19 @@ concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureAsync(std::ws
 				throw ref new Platform::FailureException("Cannot load file " + file);
 			}
 
-			m_textureSRV[filename] = textureView->Get();
+			m_textureSRV.Insert(handle, filename, textureView->Get());
 			return textureView->Get();
 		});
 	}
 }
 
-ID3D11ShaderResourceView* TextureMgr::GetTextureArray(std::vector<std::wstring>& filenames, std::wstring name)
+ID3D11ShaderResourceView* TextureMgr::GetTextureArray(std::vector<std::wstring>& filenames, ResourceHandle handle)
 {
 	// Does it already exist?
-	if (m_textureSRV.find(name) != m_textureSRV.end())
+	std::wstring signature = JoinFilenames(filenames);
+	if (auto found = m_textureSRV.Find(handle, signature))
 	{
-		return m_textureSRV[name].Get();
+		return found->Get();
 	}
 	else
 	{
@@ -78,16 +97,17 @@ ID3D11ShaderResourceView* TextureMgr::GetTextureArray(std::vector<std::wstring>&
 		ComPtr<ID3D11ShaderResourceView> textureView;
 
 		m_loader->LoadTextureArray(files, textureView.GetAddressOf());
-		m_textureSRV[name] = textureView.Get();
+		m_textureSRV.Insert(handle, signature, textureView.Get());
 		return textureView.Get();
 	}
 }
-concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureArrayAsync(std::vector<std::wstring>& filenames, std::wstring name)
+concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureArrayAsync(std::vector<std::wstring>& filenames, ResourceHandle handle)
 {
 	// Does it already exist?
-	if (m_textureSRV.find(name) != m_textureSRV.end())
+	std::wstring signature = JoinFilenames(filenames);
+	if (auto found = m_textureSRV.Find(handle, signature))
 	{
-		return concurrency::task_from_result(m_textureSRV[name].Get());
+		return concurrency::task_from_result(found->Get());
 	}
 	else
 	{
@@ -99,8 +119,14 @@ concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureArrayAsync(st
 
 		return m_loader->LoadTextureArrayAsync(files, textureView->GetAddressOf()).then([=]()
 		{
-			m_textureSRV[name] = textureView->Get();
+			m_textureSRV.Insert(handle, signature, textureView->Get());
 			return textureView->Get();
 		});
 	}
-}
\ No newline at end of file
+}
+
+ID3D11ShaderResourceView* TextureMgr::FindTexture(ResourceHandle handle)
+{
+	auto found = m_textureSRV.Find(handle);
+	return found ? found->Get() : nullptr;
+}
@@ -2,9 +2,9 @@
 
 #include "pch.h"
 #include "BasicLoader.h"
+#include "ResourceTable.h"
 #include <ppltasks.h>
 #include <collection.h>
-#include <map>
 
 /// Simple texture manager to avoid loading duplicate textures from file.  That can
 /// happen, for example, if multiple meshes reference the same texture filename. 
@@ -18,14 +18,19 @@ namespace DX
 		// Singleton
 		static TextureMgr* Instance() { return m_instance; }
 
-		ID3D11ShaderResourceView* GetTexture(std::wstring filename);
-		concurrency::task<ID3D11ShaderResourceView*> GetTextureAsync(std::wstring filename);
-		ID3D11ShaderResourceView* GetTextureArray(std::vector<std::wstring>& filenames, std::wstring name);
-		concurrency::task<ID3D11ShaderResourceView*> GetTextureArrayAsync(std::vector<std::wstring>& filenames, std::wstring name);
+		ID3D11ShaderResourceView* GetTexture(const std::wstring& filename);
+		concurrency::task<ID3D11ShaderResourceView*> GetTextureAsync(const std::wstring& filename);
+		// Texture arrays have no file of their own; the handle names the array, and
+		// their files, joined in order, tell arrays whose handles collide apart.
+		ID3D11ShaderResourceView* GetTextureArray(std::vector<std::wstring>& filenames, ResourceHandle handle);
+		concurrency::task<ID3D11ShaderResourceView*> GetTextureArrayAsync(std::vector<std::wstring>& filenames, ResourceHandle handle);
+
+		// A texture or array already loaded, nullptr otherwise.
+		ID3D11ShaderResourceView* FindTexture(ResourceHandle handle);
 
 	private:
 		std::shared_ptr<BasicLoader> m_loader;
-		std::map<std::wstring, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_textureSRV;
+		ResourceTable<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_textureSRV;
 
 		static TextureMgr* m_instance;
 	};
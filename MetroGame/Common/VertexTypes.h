@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+
+// Vertex layouts shared by the engine, the .x3d files and the headless tests.
+
+namespace DX
+{
+	// Basic 32-byte vertex structure.
+	struct Basic32
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT3 Normal;
+		DirectX::XMFLOAT2 Tex;
+	};
+
+	struct PosNormalTexTan
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT3 Normal;
+		DirectX::XMFLOAT2 Tex;
+		DirectX::XMFLOAT3 TangentU;
+	};
+
+	struct PosNormalTexTanSkinned
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT3 Normal;
+		DirectX::XMFLOAT2 Tex;
+		DirectX::XMFLOAT3 TangentU;
+		DirectX::XMFLOAT3 Weights;
+		BYTE BoneIndices[4];
+	};
+
+	struct PosColor
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT4 Color;
+	};
+
+	struct PointSize
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT2 Size;
+	};
+
+	struct PosTexBound
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT2 Tex;
+		DirectX::XMFLOAT2 BoundsY;
+	};
+
+	// Static part of a height field grid. Heights and normals are
+	// streamed from a second vertex buffer (see WaveVertex).
+	struct PosXZTex
+	{
+		DirectX::XMFLOAT2 PosXZ;
+		DirectX::XMFLOAT2 Tex;
+	};
+
+	// Per-instance stream of instanced meshes, next to a PosNormalTexTan stream.
+	// The matrices are stored untransposed and read as row_major by the shaders.
+	struct InstanceWorld
+	{
+		DirectX::XMFLOAT4X4 World;
+		DirectX::XMFLOAT4X4 WorldInvTranspose;
+	};
+
+	struct BasicParticle
+	{
+		DirectX::XMFLOAT3 InitialPos;
+		DirectX::XMFLOAT3 InitialVel;
+		DirectX::XMFLOAT2 Size;
+		float Age;
+		unsigned int Type;
+	};
+}
@@ -4,7 +4,6 @@
 #include <vector>
 #include "Common/DirectXHelper.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
 
 using namespace DXFramework;
@@ -89,6 +88,22 @@ void BasicObject::Initialize(BasicObjectData* data, BasicFeatureConfigure featur
 		}
 	}
 
+	m_unitStarts.resize(units.size());
+	UINT instanceCount = 0;
+	for (size_t i = 0; i < units.size(); ++i)
+	{
+		m_unitStarts[i] = instanceCount;
+		instanceCount += (UINT)units[i].Worlds.size();
+	}
+	if (instanceCount >= BvhMinInstances)
+	{
+		std::vector<BoundingBox> boxes(instanceCount);
+		for (size_t i = 0; i < units.size(); ++i)
+			for (size_t j = 0; j < units[i].Worlds.size(); ++j)
+				boxes[m_unitStarts[i] + j] = GetCullBoundingBox(i, j);
+		m_bvh.Build(boxes);
+	}
+
 #ifdef _DEBUG
 	// Feature dependency check
 	if (!m_texture && m_feature.TextureEnable)
@@ -119,7 +134,7 @@ concurrency::task<void> BasicObject::CreateDeviceDependentResourcesAsync()
 		return concurrency::task_from_result();
 	}
 
-	m_tessSettingsCB.Initialize(m_deviceResources->GetD3DDevice());
+	m_tessSettingsCB.Initialize(m_deviceResources->GetRenderDevice());
 
 	return LoadFeatureAsync(m_feature)
 		.then([=]()
@@ -132,566 +147,252 @@ concurrency::task<void> BasicObject::CreateDeviceDependentResourcesAsync()
 	});
 }
 
-void BasicObject::Render(bool recover /* = false */)
+void BasicObject::Submit(RenderQueue& queue)
 {
-	if (!m_loadingComplete)
+	RenderPass pass = queue.GetPass();
+	if (!m_loadingComplete ||
+		(pass == RenderPass::Depth && !m_feature.ShadowEnable) ||
+		(pass == RenderPass::NormalDepth && !m_feature.SsaoEnable))
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	bool color = pass == RenderPass::Color;
+	bool tess = color ? m_feature.TessEnable : m_feature.Enhance;
+	DrawState state;
+
 	// Set IA stage.
 	UINT stride = m_object->UseEx ? sizeof(PosNormalTexTan) : sizeof(Basic32);
-	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (m_feature.TessEnable)
-	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
-		}
-	}
-	else
-	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		}
-	}
-	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
+	state.InputLayout = m_inputLayout.Get();
+	state.Topology = tess ? D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	state.SetVertexBuffers(1, m_objectVB.GetAddressOf(), &stride);
 	if (m_object->UseIndex)
 	{
-		context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+		state.IndexBuffer = m_objectIB.Get();
+		state.IndexFormat = DXGI_FORMAT_R32_UINT;
 	}
 
-	// Bind shaders, constant buffers, srvs and samplers
+	// Set shaders, constant buffers, srvs and samplers
 	ID3D11Buffer* cbuffers[3] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer(), m_tessSettingsCB.GetBuffer() };
 	ID3D11Buffer* cbuffersT[2] = { cbuffers[0], cbuffers[2] };
 	ID3D11SamplerState* samplers[2] = { renderStateMgr->LinearSam(), renderStateMgr->ShadowSam() };
-	ID3D11ShaderResourceView* srvs[3] = { m_depthMapSRV.Get(), m_ssaoMapSRV.Get(),  m_reflectMapSRV.Get() };
-	
-	// vs
-	if (ShaderChangement::VS != m_basicVS.Get())
+	state.SetConstantBuffers(ShaderStage::Vertex, 0, tess ? 3 : 2, cbuffers);
+	state.SetConstantBuffers(ShaderStage::Pixel, 0, 2, cbuffers);
+	if (tess)
 	{
-		context->VSSetShader(m_basicVS.Get(), nullptr, 0);
-		ShaderChangement::VS = m_basicVS.Get();
+		state.SetConstantBuffers(ShaderStage::Domain, 0, 2, cbuffersT);
+		state.SetSamplers(ShaderStage::Domain, 0, 1, samplers);
 	}
-	if (m_feature.TessEnable)
-		context->VSSetConstantBuffers(0, 3, cbuffers);
-	else
-		context->VSSetConstantBuffers(0, 2, cbuffers);
-	// ps
-	if (ShaderChangement::PS != m_basicPS.Get())
+	switch (pass)
 	{
-		context->PSSetShader(m_basicPS.Get(), nullptr, 0);
-		ShaderChangement::PS = m_basicPS.Get();
-	}
-	context->PSSetConstantBuffers(0, 2, cbuffers);
-	context->PSSetShaderResources(2, 3, srvs);
-	context->PSSetSamplers(0, 2, samplers);
-
-	// hs and ds
-	if (m_feature.TessEnable)
+	case RenderPass::Color:
 	{
-		if (ShaderChangement::HS != m_basicHS.Get())
-		{
-			context->HSSetShader(m_basicHS.Get(), nullptr, 0);
-			ShaderChangement::HS = m_basicHS.Get();
-		}
-		if (ShaderChangement::DS != m_basicDS.Get())
+		ID3D11ShaderResourceView* srvs[3] = { m_depthMapSRV.Get(), m_ssaoMapSRV.Get(), m_reflectMapSRV.Get() };
+		state.SetShader(ShaderStage::Vertex, m_basicVS.Get());
+		state.SetShader(ShaderStage::Pixel, m_basicPS.Get());
+		if (tess)
 		{
-			context->DSSetShader(m_basicDS.Get(), nullptr, 0);
-			ShaderChangement::DS = m_basicDS.Get();
+			state.SetShader(ShaderStage::Hull, m_basicHS.Get());
+			state.SetShader(ShaderStage::Domain, m_basicDS.Get());
 		}
-		context->DSSetConstantBuffers(0, 2, cbuffersT);
-		context->DSSetSamplers(0, 1, samplers);
+		state.SetShaderResources(ShaderStage::Pixel, 2, 3, srvs);
+		state.SetSamplers(ShaderStage::Pixel, 0, 2, samplers);
+		state.RasterizerState = m_feature.ClipEnable ? renderStateMgr->NoCullRS() : nullptr;
+		break;
 	}
-	else
-	{
-		if (ShaderChangement::HS != nullptr)
-		{
-			context->HSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::HS = nullptr;
-		}
-		if (ShaderChangement::DS != nullptr)
+	case RenderPass::Depth:
+		state.SetShader(ShaderStage::Vertex, m_depthVS.Get());
+		if (tess)
 		{
-			context->DSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::DS =nullptr;
+			state.SetShader(ShaderStage::Hull, m_depthHS.Get());
+			state.SetShader(ShaderStage::Domain, m_depthDS.Get());
 		}
-	}
-
-	if (m_feature.ClipEnable)
-	{
-		if (ShaderChangement::RSS != renderStateMgr->NoCullRS())
+		if (m_feature.ClipEnable)
 		{
-			context->RSSetState(renderStateMgr->NoCullRS());
-			ShaderChangement::RSS = renderStateMgr->NoCullRS();
+			state.SetShader(ShaderStage::Pixel, m_depthPS.Get());
+			state.SetSamplers(ShaderStage::Pixel, 0, 1, samplers);
+			state.RasterizerState = renderStateMgr->DepthBiasNoCullRS();
 		}
-	}
-	else if (ShaderChangement::RSS != nullptr)
-	{
-		context->RSSetState(nullptr);
-		ShaderChangement::RSS = nullptr;
-	}
-
-	// Iterate over each unit
-	int totalNum, matBase, matInc, transBase, transInc, texBase, texInc, norBase, norInc;
-	texBase = norBase = 0;
-	if (m_feature.TextureEnable)
-	{
-		texInc = transInc = 0;
-		if (m_feature.NormalEnable)
-			norInc = 0;
 		else
-			norInc = -1;
-	}
-	else
-		texInc = norInc = transInc = -1;
-	for (size_t i = 0; i < m_object->Units.size(); ++i)
-	{
-		BasicElementUnit& item = m_object->Units[i];
-
-		totalNum = (int)item.Worlds.size();
-		matBase = matInc = transBase = 0;
-		if (texInc > 0) texInc = 0;
-		if (norInc > 0) norInc = 0;
-		if (transInc > 0) transInc = 0;
-
-		for (int k = 0; k < totalNum; ++k)
 		{
-			// Set world
-			XMMATRIX world = XMLoadFloat4x4(&item.Worlds[k]);
-			XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-			XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
-			// Set material
-			if (matInc == 0)
-				m_perObjectCB->Data.Mat = item.Material[matBase];
-			if (++matInc >= (int)item.MaterialStepRate)
-			{
-				matInc = 0;
-				++matBase;
-			}
-			// Set texture transform
-			if (transInc == 0)
-			{
-				XMMATRIX texTransform = XMLoadFloat4x4(&item.TextureTransform[transBase]);
-				XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixTranspose(texTransform));
-			}
-			if (transInc >= 0 && ++transInc >= (int)item.TextureTransformStepRate)
-			{
-				transInc = 0;
-				++transBase;
-			}
-			// Set diffuse texture
-			if (texInc == 0)
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[texBase].GetAddressOf());
-			if (texInc >= 0 && ++texInc >= (int)item.TextureStepRate)
-			{
-				texInc = 0;
-				++texBase;
-			}
-			// Set normal texture
-			if (norInc == 0)
-			{
-				context->PSSetShaderResources(1, 1, m_norMapSRV[norBase].GetAddressOf());
-				if (m_feature.TessEnable)
-					context->DSSetShaderResources(0, 1, m_norMapSRV[norBase].GetAddressOf());
-			}
-			if (norInc >= 0 && ++norInc >= (int)item.NorTextureStepRate)
-			{
-				norInc = 0;
-				++norBase;
-			}
-
-			// Update constant buffer
-			m_perObjectCB->ApplyChanges(context);
-
-			// Draw
-			if (m_object->UseIndex)
-				context->DrawIndexed(item.Count, item.Start, item.Base);
-			else
-				context->Draw(item.VCount, item.Base);
+			state.RasterizerState = renderStateMgr->DepthBiasRS();
 		}
-	}
-
-	// Recovery
-	if (recover)
-	{
-		ID3D11ShaderResourceView* nullSRV[3] = { nullptr, nullptr, nullptr };
-		context->PSSetShaderResources(2, 3, nullSRV);
-		if (m_feature.ClipEnable)
+		break;
+	case RenderPass::NormalDepth:
+		state.SetShader(ShaderStage::Vertex, m_norDepVS.Get());
+		state.SetShader(ShaderStage::Pixel, m_norDepPS.Get());
+		if (tess)
 		{
-			context->RSSetState(nullptr);
-			ShaderChangement::RSS = nullptr;
+			state.SetShader(ShaderStage::Hull, m_norDepHS.Get());
+			state.SetShader(ShaderStage::Domain, m_norDepDS.Get());
 		}
-		if (m_feature.TessEnable)
+		if (m_feature.ClipEnable)
 		{
-			ShaderChangement::HS = nullptr;
-			ShaderChangement::DS = nullptr;
-			context->HSSetShader(nullptr, nullptr, 0);
-			context->DSSetShader(nullptr, nullptr, 0);
+			state.SetSamplers(ShaderStage::Pixel, 0, 1, samplers);
+			state.RasterizerState = renderStateMgr->NoCullRS();
 		}
+		break;
 	}
-}
 
-void BasicObject::DepthRender(bool recover /* = false */)
-{
-	if (!m_loadingComplete || !m_feature.ShadowEnable)
-		return;
+	// Textures are sampled by the pixel shader to shade or to clip, and normal maps
+	// by the domain shader to displace.
+	bool diffuse = m_feature.TextureEnable && (color || m_feature.ClipEnable);
+	bool normal = m_feature.TextureEnable && color && m_feature.NormalEnable;
+	bool displace = m_feature.TextureEnable && tess && (m_feature.NormalEnable || !color);
 
-	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
-	// Set IA stage
-	UINT stride = m_object->UseEx ? sizeof(PosNormalTexTan) : sizeof(Basic32);
-	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (m_feature.Enhance)
-	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
-		}
-	}
-	else
-	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		}
-	}
-	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
-	if (m_object->UseIndex)
-	{
-		context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
-	}
-
-	// Bind shaders, constant buffers, srvs and samplers
-	ID3D11Buffer* cbuffers[3] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer(), m_tessSettingsCB.GetBuffer() };
-	ID3D11Buffer* cbuffersT[2] = { cbuffers[0], cbuffers[2] };
-	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
-	// vs
-	if (ShaderChangement::VS != m_depthVS.Get())
-	{
-		context->VSSetShader(m_depthVS.Get(), nullptr, 0);
-		ShaderChangement::VS = m_depthVS.Get();
-	}
-	if (m_feature.Enhance)
-		context->VSSetConstantBuffers(0, 3, cbuffers);
-	else
-		context->VSSetConstantBuffers(0, 2, cbuffers);
-	// ps
-	if (m_feature.ClipEnable)
-	{
-		if (ShaderChangement::PS != m_depthPS.Get())
-		{
-			context->PSSetShader(m_depthPS.Get(), nullptr, 0);
-			ShaderChangement::PS = m_depthPS.Get();
-		}
-		context->PSSetSamplers(0, 1, samplers);
-		if (ShaderChangement::RSS != renderStateMgr->DepthBiasNoCullRS())
-		{
-			context->RSSetState(renderStateMgr->DepthBiasNoCullRS());
-			ShaderChangement::RSS = renderStateMgr->DepthBiasNoCullRS();
-		}
-	}
-	else
-	{
-		if (ShaderChangement::PS != nullptr)
-		{
-			context->PSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::PS = nullptr;
-		}
-		if (ShaderChangement::RSS != renderStateMgr->DepthBiasRS())
-		{
-			context->RSSetState(renderStateMgr->DepthBiasRS());
-			ShaderChangement::RSS = renderStateMgr->DepthBiasRS();
-		}
-	}
-	// hs and ds
-	if (m_feature.Enhance)
-	{
-		if (ShaderChangement::HS != m_depthHS.Get())
-		{
-			context->HSSetShader(m_depthHS.Get(), nullptr, 0);
-			ShaderChangement::HS = m_depthHS.Get();
-		}
-		if (ShaderChangement::DS != m_depthDS.Get())
-		{
-			context->DSSetShader(m_depthDS.Get(), nullptr, 0);
-			ShaderChangement::DS = m_depthDS.Get();
-		}
-		context->DSSetConstantBuffers(0, 2, cbuffersT);
-		context->DSSetSamplers(0, 1, samplers);
-	}
-	else
-	{
-		if (ShaderChangement::HS != nullptr)
-		{
-			context->HSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::HS = nullptr;
-		}
-		if (ShaderChangement::DS != nullptr)
-		{
-			context->DSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::DS = nullptr;
-		}
-	}
-
-	// Iterate over each unit
-	int totalNum, texBase, texInc, norBase, norInc;
-	texBase = norBase = 0;
-	if (m_feature.TextureEnable)
-	{
-		if (m_feature.Enhance) norInc = 0;
-		else norInc = -1;
-		if (m_feature.ClipEnable) texInc = 0;
-		else texInc = -1;
-	}
-	else
-		texInc = norInc = -1;
+	// Iterate over the visible instances of each unit. Materials, texture transforms
+	// and textures advance every StepRate instances, textures are numbered across units.
+	// Instances sharing the textures of the one before share its state.
+	SetCullFrustum();
+	XMVECTOR eye = XMLoadFloat3(&m_perFrameCB->Data.EyePosW);
+	UINT texUnitBase = 0, norUnitBase = 0;
+	UINT stateIndex = UINT_MAX, stateTex = UINT_MAX, stateNor = UINT_MAX;
 	for (size_t i = 0; i < m_object->Units.size(); ++i)
 	{
 		BasicElementUnit& item = m_object->Units[i];
-		totalNum = (int)item.Worlds.size();
-		if (texInc > 0) texInc = 0;
-		if (norInc > 0) norInc = 0;
+		CullUnit(i);
+		CullOccluded(i);
 
-		for (int k = 0; k < totalNum; ++k)
+		for (UINT k : m_visible)
 		{
+			// Set textures
+			UINT tex = texUnitBase + k / item.TextureStepRate;
+			UINT nor = norUnitBase + k / item.NorTextureStepRate;
+			if (stateIndex == UINT_MAX || ((diffuse && tex != stateTex) || ((normal || displace) && nor != stateNor)))
+			{
+				if (diffuse)
+					state.SetShaderResources(ShaderStage::Pixel, 0, 1, m_diffuseMapSRV[tex].GetAddressOf());
+				if (normal)
+					state.SetShaderResources(ShaderStage::Pixel, 1, 1, m_norMapSRV[nor].GetAddressOf());
+				if (displace)
+					state.SetShaderResources(ShaderStage::Domain, 0, 1, m_norMapSRV[nor].GetAddressOf());
+				stateIndex = queue.AddState(state);
+				stateTex = tex;
+				stateNor = nor;
+			}
+
 			// Set world
 			XMMATRIX world = XMLoadFloat4x4(&item.Worlds[k]);
 			XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
 			XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
 			XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
-			// Set diffuse texture
-			if (texInc == 0)
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[texBase].GetAddressOf());
-			if (texInc >= 0 && ++texInc >= (int)item.TextureStepRate)
+			if (color)
 			{
-				texInc = 0;
-				++texBase;
-			}
-			// Set normal texture
-			if (m_feature.Enhance && norInc == 0)
-				context->DSSetShaderResources(0, 1, m_norMapSRV[norBase].GetAddressOf());
-			if (norInc >= 0 && ++norInc >= (int)item.NorTextureStepRate)
-			{
-				norInc = 0;
-				++norBase;
+				// Set material and texture transform
+				m_perObjectCB->Data.Mat = item.Material[k / item.MaterialStepRate];
+				if (m_feature.TextureEnable)
+				{
+					XMMATRIX texTransform = XMLoadFloat4x4(&item.TextureTransform[k / item.TextureTransformStepRate]);
+					XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixTranspose(texTransform));
+				}
 			}
+			queue.SetConstants(*m_perObjectCB);
 
-			// Update constant buffer
-			m_perObjectCB->ApplyChanges(context);
-
-			// Draw
+			// Draw, nearest first
+			XMVECTOR center = XMVector3Transform(XMLoadFloat3(&m_boundingSphere[i].Center), world);
+			float depth = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(center, eye)));
 			if (m_object->UseIndex)
-				context->DrawIndexed(item.Count, item.Start, item.Base);
+				queue.DrawIndexed(stateIndex, item.Count, item.Start, item.Base, depth);
 			else
-				context->Draw(item.VCount, item.Base);
+				queue.Draw(stateIndex, item.VCount, item.Base, depth);
 		}
+		texUnitBase += item.TextureFileNames.size();
+		norUnitBase += item.NorTextureFileNames.size();
 	}
+}
 
-	// Recovery
-	if (recover)
-	{
-		context->RSSetState(nullptr);
-		ShaderChangement::RSS = nullptr;
-		if (m_feature.Enhance)
-		{
-			ShaderChangement::HS = nullptr;
-			ShaderChangement::DS = nullptr;
-			context->HSSetShader(nullptr, nullptr, 0);
-			context->DSSetShader(nullptr, nullptr, 0);
-		}
+void BasicObject::SetCullFrustum()
+{
+	// The per-frame buffer holds the view-projection of the current pass.
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixTranspose(XMLoadFloat4x4(&m_perFrameCB->Data.ViewProj)));
+	m_culler.SetViewProj(viewProj);
+	if (m_bvh.GetItemCount())
+	{
+		if (auto visible = m_frustumQueries.Find(viewProj))
+			m_visibleItems = *visible;
+		else
+			m_bvh.Query(m_culler, m_visibleItems);
 	}
 }
 
-void BasicObject::NorDepRender(bool recover /* = false */)
+void BasicObject::CullFrustums(const XMFLOAT4X4* viewProjs, UINT count)
 {
-	if (!m_loadingComplete || !m_feature.SsaoEnable)
-		return;
+	if (m_bvh.GetItemCount())
+		m_frustumQueries.Query(m_bvh, viewProjs, count);
+}
 
-	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
-	// Set IA stage.
-	UINT stride = m_object->UseEx ? sizeof(PosNormalTexTan) : sizeof(Basic32);
-	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (m_feature.Enhance)
-	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
-		}
-	}
-	else
-	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		}
-	}
-	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
-	if (m_object->UseIndex)
-	{
-		context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+void BasicObject::CullUnit(size_t i)
+{
+	auto& worlds = m_object->Units[i].Worlds;
+	if (m_bvh.GetItemCount())
+	{
+		// The items are sorted, so the unit's are one range of them.
+		UINT start = m_unitStarts[i];
+		auto first = std::lower_bound(m_visibleItems.begin(), m_visibleItems.end(), start);
+		auto last = std::lower_bound(first, m_visibleItems.end(), start + (UINT)worlds.size());
+		m_visible.clear();
+		for (auto item = first; item != last; ++item)
+			m_visible.push_back(*item - start);
+		return;
 	}
 
-	// Bind shaders, constant buffers, srvs and samplers
-	ID3D11Buffer* cbuffers[3] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer(), m_tessSettingsCB.GetBuffer() };
-	ID3D11Buffer* cbuffersT[2] = { cbuffers[0], cbuffers[2] };
-	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
-	// vs
-	if (ShaderChangement::VS != m_norDepVS.Get())
-	{
-		context->VSSetShader(m_norDepVS.Get(), nullptr, 0);
-		ShaderChangement::VS = m_norDepVS.Get();
-	}
-	if (m_feature.Enhance)
-		context->VSSetConstantBuffers(0, 3, cbuffers);
-	else
-		context->VSSetConstantBuffers(0, 2, cbuffers);
-	// ps
-	if (ShaderChangement::PS != m_norDepPS.Get())
-	{
-		context->PSSetShader(m_norDepPS.Get(), nullptr, 0);
-		ShaderChangement::PS = m_norDepPS.Get();
-	}
+	// Displacement moves the surface at most HeightScale along the normal.
+	float padding = m_feature.TessEnable ? m_feature.TessDesc.HeightScale : 0.0f;
+	m_culler.Cull(m_boundingSphere[i], worlds.data(), (UINT)worlds.size(), m_visible, padding);
+}
 
-	if (m_feature.ClipEnable)
-	{
-		context->PSSetSamplers(0, 1, samplers);
-		if (ShaderChangement::RSS != renderStateMgr->NoCullRS())
-		{
-			context->RSSetState(renderStateMgr->NoCullRS());
-			ShaderChangement::RSS = renderStateMgr->NoCullRS();
-		}
-	}
-	else if (ShaderChangement::RSS != nullptr)
-	{
-		context->RSSetState(nullptr);
-		ShaderChangement::RSS = nullptr;
-	}
+void BasicObject::CullOccluded(size_t i)
+{
+	// The occluders are drawn from one view, other passes keep their instances.
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixTranspose(XMLoadFloat4x4(&m_perFrameCB->Data.ViewProj)));
+	if (!m_occlusionCuller || memcmp(&viewProj, &m_occlusionCuller->GetViewProj(), sizeof(viewProj)) != 0)
+		return;
 
-	// hs and ds
-	if (m_feature.Enhance)
+	BoundingBox box = m_boundingBox[i];
+	if (m_feature.TessEnable)
 	{
-		if (ShaderChangement::HS != m_norDepHS.Get())
-		{
-			context->HSSetShader(m_norDepHS.Get(), nullptr, 0);
-			ShaderChangement::HS = m_norDepHS.Get();
-		}
-		if (ShaderChangement::DS != m_norDepDS.Get())
-		{
-			context->DSSetShader(m_norDepDS.Get(), nullptr, 0);
-			ShaderChangement::DS = m_norDepDS.Get();
-		}
-		context->DSSetConstantBuffers(0, 2, cbuffersT);
-		context->DSSetSamplers(0, 1, samplers);
+		float padding = m_feature.TessDesc.HeightScale;
+		box.Extents = XMFLOAT3(box.Extents.x + padding, box.Extents.y + padding, box.Extents.z + padding);
 	}
-	else
+	auto& worlds = m_object->Units[i].Worlds;
+	m_visible.erase(std::remove_if(m_visible.begin(), m_visible.end(), [&](UINT k)
 	{
-		if (ShaderChangement::HS != nullptr)
-		{
-			context->HSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::HS = nullptr;
-		}
-		if (ShaderChangement::DS != nullptr)
-		{
-			context->DSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::DS = nullptr;
-		}
-	}
+		return !m_occlusionCuller->IsVisible(box, worlds[k]);
+	}), m_visible.end());
+}
 
-	// Iterate over each unit
-	int totalNum, texBase, texInc, norBase, norInc;
-	texBase = norBase = 0;
-	if (m_feature.TextureEnable)
+void BasicObject::RasterizeOccluder(DX::OcclusionCuller& culler, int i)
+{
+	auto& item = m_object->Units[i];
+	const XMFLOAT3* positions;
+	UINT stride;
+	if (m_object->UseEx)
 	{
-		if (m_feature.Enhance) norInc = 0;
-		else norInc = -1;
-		if (m_feature.ClipEnable) texInc = 0;
-		else texInc = -1;
+		positions = &m_object->VertexDataEx[item.Base].Pos;
+		stride = sizeof(PosNormalTexTan);
 	}
 	else
-		texInc = norInc = -1;
-	for (size_t i = 0; i < m_object->Units.size(); ++i)
 	{
-		BasicElementUnit& item = m_object->Units[i];
-
-		totalNum = (int)item.Worlds.size();
-		if (texInc > 0) texInc = 0;
-		if (norInc > 0) norInc = 0;
-
-		for (int k = 0; k < totalNum; ++k)
-		{
-			// Set world
-			XMMATRIX world = XMLoadFloat4x4(&item.Worlds[k]);
-			XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-			XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
-			// Set diffuse texture
-			if (texInc == 0)
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[texBase].GetAddressOf());
-			if (texInc >= 0 && ++texInc >= (int)item.TextureStepRate)
-			{
-				texInc = 0;
-				++texBase;
-			}
-			// Set normal texture
-			if (m_feature.Enhance && norInc == 0)
-				context->DSSetShaderResources(0, 1, m_norMapSRV[norBase].GetAddressOf());
-			if (norInc >= 0 && ++norInc >= (int)item.NorTextureStepRate)
-			{
-				norInc = 0;
-				++norBase;
-			}
-
-			// Update constant buffer
-			m_perObjectCB->ApplyChanges(context);
-
-			// Draw
-			if (m_object->UseIndex)
-				context->DrawIndexed(item.Count, item.Start, item.Base);
-			else
-				context->Draw(item.VCount, item.Base);
-		}
+		positions = &m_object->VertexData[item.Base].Pos;
+		stride = sizeof(Basic32);
 	}
+	const UINT* indices = m_object->UseIndex ? &m_object->IndexData[item.Start] : nullptr;
+	UINT count = m_object->UseIndex ? item.Count : item.VCount;
+
+	for (auto& world : item.Worlds)
+		culler.RasterizeOccluder(positions, stride, indices, count, world);
+}
 
-	// Recovery
-	if (recover && m_feature.Enhance)
+BoundingBox BasicObject::GetCullBoundingBox(size_t i, size_t j)
+{
+	BoundingBox box = GetTransBoundingBox((int)i, (int)j);
+	if (m_feature.TessEnable)
 	{
-		if (m_feature.ClipEnable)
-		{
-			context->RSSetState(nullptr);
-			ShaderChangement::RSS = nullptr;
-		}
-		ShaderChangement::HS = nullptr;
-		ShaderChangement::DS = nullptr;
-		context->HSSetShader(nullptr, nullptr, 0);
-		context->DSSetShader(nullptr, nullptr, 0);
+		float padding = m_feature.TessDesc.HeightScale;
+		box.Extents = XMFLOAT3(box.Extents.x + padding, box.Extents.y + padding, box.Extents.z + padding);
 	}
+	return box;
 }
 
 void BasicObject::ReleaseDeviceDependentResources()
@@ -870,7 +571,7 @@ concurrency::task<void> BasicObject::LoadFeatureAsync(const BasicFeatureConfigur
 		if (m_feature.TessEnable)
 		{
 			m_tessSettingsCB.Data = m_feature.TessDesc;
-			m_tessSettingsCB.ApplyChanges(m_deviceResources->GetD3DDeviceContext());
+			m_tessSettingsCB.ApplyChanges(m_deviceResources->GetRenderContext());
 		}
 	});
 }
@@ -913,7 +614,7 @@ concurrency::task<void> BasicObject::BuildDataAsync()
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_objectVB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_objectVB.GetAddressOf()));
 
 	if (m_object->UseIndex)
 	{
@@ -925,14 +626,14 @@ concurrency::task<void> BasicObject::BuildDataAsync()
 		ibd.MiscFlags = 0;
 		D3D11_SUBRESOURCE_DATA iinitData;
 		iinitData.pSysMem = &m_object->IndexData[0];
-		ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_objectIB.GetAddressOf()));
+		ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&ibd, &iinitData, m_objectIB.GetAddressOf()));
 	}
 
 	// Load texture. Avoid loading same file at the same time.
 	std::vector<concurrency::task<void>> LoadTasks;
-	std::vector<std::wstring> fileCache;
-	std::map<UINT, std::wstring> diffuseAd;
-	std::map<UINT, std::wstring> normalAd;
+	std::vector<ResourceHandle> fileCache;
+	std::map<UINT, ResourceHandle> diffuseAd;
+	std::map<UINT, ResourceHandle> normalAd;
 	bool cacheFlag;
 
 	UINT textureCount = 0;
@@ -953,18 +654,19 @@ concurrency::task<void> BasicObject::BuildDataAsync()
 			for (size_t k = 0; k < item.TextureFileNames.size(); ++k)
 			{
 				cacheFlag = false;
+				ResourceHandle handle(item.TextureFileNames[k]);
 				for (auto& file : fileCache)
-					if (file == item.TextureFileNames[k])
+					if (file == handle)
 					{
 						cacheFlag = true;
-						diffuseAd[textureCount] = item.TextureFileNames[k];
+						diffuseAd[textureCount] = handle;
 						break;
 					}
 				if (!cacheFlag)
 				{
 					LoadTasks.push_back(textureMgr->GetTextureAsync(item.TextureFileNames[k])
 						.then([=](ID3D11ShaderResourceView* srv) { m_diffuseMapSRV[textureCount] = srv; }));
-					fileCache.push_back(item.TextureFileNames[k]);
+					fileCache.push_back(handle);
 				}
 				++textureCount;
 			}
@@ -974,18 +676,19 @@ concurrency::task<void> BasicObject::BuildDataAsync()
 			for (size_t k = 0; k < item.NorTextureFileNames.size(); ++k)
 			{
 				cacheFlag = false;
+				ResourceHandle handle(item.NorTextureFileNames[k]);
 				for (auto& file : fileCache)
-					if (file == item.NorTextureFileNames[k])
+					if (file == handle)
 					{
 						cacheFlag = true;
-						normalAd[normalCount] = item.NorTextureFileNames[k];
+						normalAd[normalCount] = handle;
 						break;
 					}
 				if (!cacheFlag)
 				{
 					LoadTasks.push_back(textureMgr->GetTextureAsync(item.NorTextureFileNames[k])
 						.then([=](ID3D11ShaderResourceView* srv) {m_norMapSRV[normalCount] = srv; }));
-					fileCache.push_back(item.NorTextureFileNames[k]);
+					fileCache.push_back(handle);
 				}
 				++normalCount;
 			}
@@ -996,9 +699,9 @@ concurrency::task<void> BasicObject::BuildDataAsync()
 		.then([=]()
 	{
 		for (auto& item : diffuseAd)
-			m_diffuseMapSRV[item.first] = textureMgr->GetTexture(item.second);
+			m_diffuseMapSRV[item.first] = textureMgr->FindTexture(item.second);
 		for (auto& item : normalAd)
-			m_norMapSRV[item.first] = textureMgr->GetTexture(item.second);
+			m_norMapSRV[item.first] = textureMgr->FindTexture(item.second);
 	});
 }
 
@@ -1030,6 +733,16 @@ void BasicObject::UpdateNormalMapSRV(int i, ID3D11ShaderResourceView* srv)
 	m_norMapSRV[i] = srv;
 }
 
+void BasicObject::SetWorld(int i, int j, const XMFLOAT4X4& world)
+{
+	m_object->Units[i].Worlds[j] = world;
+	if (m_bvh.GetItemCount())
+	{
+		m_bvh.Refit(m_unitStarts[i] + j, GetCullBoundingBox(i, j));
+		m_frustumQueries.Clear();
+	}
+}
+
 BoundingBox BasicObject::GetTransBoundingBox(int i, int j)
 {
 	BoundingBox res;
@@ -1042,4 +755,44 @@ BoundingSphere BasicObject::GetTransBoundingSphere(int i, int j)
 	BoundingSphere res;
 	m_boundingSphere[i].Transform(res, XMLoadFloat4x4(&m_object->Units[i].Worlds[j]));
 	return res;
+}
+
+bool BasicObject::Pick(FXMVECTOR origin, FXMVECTOR direction, UINT& i, UINT& j, float& distance)
+{
+	i = j = UINT_MAX;
+	if (m_bvh.GetItemCount())
+	{
+		UINT item;
+		auto unitOf = [&](UINT item)
+		{
+			return (UINT)(std::upper_bound(m_unitStarts.begin(), m_unitStarts.end(), item) - m_unitStarts.begin()) - 1;
+		};
+		if (!m_bvh.RayCast(origin, direction, item, distance, [&](UINT candidate, float& t)
+		{
+			UINT unit = unitOf(candidate);
+			return MathHelper::IntersectRayBox(origin, direction, m_boundingBox[unit],
+				XMLoadFloat4x4(&m_object->Units[unit].Worlds[candidate - m_unitStarts[unit]]), t);
+		}))
+			return false;
+		i = unitOf(item);
+		j = item - m_unitStarts[i];
+		return true;
+	}
+
+	distance = FLT_MAX;
+	for (UINT unit = 0; unit < m_object->Units.size(); ++unit)
+	{
+		auto& worlds = m_object->Units[unit].Worlds;
+		for (UINT k = 0; k < worlds.size(); ++k)
+		{
+			float t;
+			if (MathHelper::IntersectRayBox(origin, direction, m_boundingBox[unit], XMLoadFloat4x4(&worlds[k]), t) && t < distance)
+			{
+				i = unit;
+				j = k;
+				distance = t;
+			}
+		}
+	}
+	return i != UINT_MAX;
 }
\ No newline at end of file
@@ -9,6 +9,10 @@
 #include "Common/GameTimer.h"
 #include "Common/ConstantBuffer.h"
 #include "Common/DeviceResources.h"
+#include "Common/FrustumCuller.h"
+#include "Common/BoundingVolumeHierarchy.h"
+#include "Common/OcclusionCuller.h"
+#include "Common/RenderQueue.h"
 
 
 // Manage basic objects which takes "DX::Basic32" as the input data structure.
@@ -82,9 +86,8 @@ namespace DXFramework
 		void Initialize(BasicObjectData* data, BasicFeatureConfigure feature);
 		concurrency::task<void> CreateDeviceDependentResourcesAsync();
 		void ReleaseDeviceDependentResources();
-		void Render(bool recover = false);
-		void DepthRender(bool recover = false);
-		void NorDepRender(bool recover = false);
+		// Adds the draws of the visible instances for the pass of the queue.
+		void Submit(DX::RenderQueue& queue);
 
 	public:
 		// Config functions
@@ -96,7 +99,17 @@ namespace DXFramework
 		void UpdateDiffuseMapSRV(int i, ID3D11ShaderResourceView* srv);
 		void UpdateNormalMapSRV(int i, ID3D11ShaderResourceView* srv);
 
-		void SetWorld(int i, int j, const DirectX::XMFLOAT4X4& world) { m_object->Units[i].Worlds[j] = world; }
+		// Instances hidden behind the occluders of the culler are skipped in the
+		// passes which share its view-projection.
+		void SetOcclusionCuller(const std::shared_ptr<DX::OcclusionCuller>& culler) { m_occlusionCuller = culler; }
+		// Rasterizes all instances of unit i into the culler.
+		void RasterizeOccluder(DX::OcclusionCuller& culler, int i);
+		// Culls the instances against the frustums of every pass of the frame, given
+		// by their untransposed view-projections, in one walk of the hierarchy. The
+		// passes then use these results until the next call or a SetWorld.
+		void CullFrustums(const DirectX::XMFLOAT4X4* viewProjs, UINT count);
+
+		void SetWorld(int i, int j, const DirectX::XMFLOAT4X4& world);
 		void SetMaterial(int i, int j, const DX::Material& mat) { m_object->Units[i].Material[j] = mat; }
 		void SetTexTranform(int i, int j, const DirectX::XMFLOAT4X4& transform) { m_object->Units[i].TextureTransform[j] = transform; }
 
@@ -105,10 +118,17 @@ namespace DXFramework
 		DirectX::BoundingSphere GetOrgBoundingSphere(int i) { return m_boundingSphere[i]; }
 		DirectX::BoundingBox GetTransBoundingBox(int i, int j = 0);
 		DirectX::BoundingSphere GetTransBoundingSphere(int i, int j = 0);
+		// Finds the closest instance j of unit i whose transformed bounding box the
+		// ray hits; direction must be normalized.
+		bool Pick(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, UINT& i, UINT& j, float& distance);
 
 	private:
 		concurrency::task<void> BuildDataAsync();
 		concurrency::task<void> LoadFeatureAsync(const BasicFeatureConfigure& feature);
+		void SetCullFrustum();
+		void CullUnit(size_t i);
+		DirectX::BoundingBox GetCullBoundingBox(size_t i, size_t j);
+		void CullOccluded(size_t i);
 
 	private:
 		// Cached pointer to shared resources
@@ -151,6 +171,17 @@ namespace DXFramework
 
 		std::vector<DirectX::BoundingBox> m_boundingBox;
 		std::vector<DirectX::BoundingSphere> m_boundingSphere;
+		// Instances of one unit inside the frustum of the current pass. Objects with
+		// many instances keep those of all units in one hierarchy, where instance j
+		// of unit i is item m_unitStarts[i] + j, and query it once per pass.
+		static const UINT BvhMinInstances = 16;
+		DX::FrustumCuller m_culler;
+		DX::BoundingVolumeHierarchy m_bvh;
+		DX::FrustumQueryCache m_frustumQueries;
+		std::vector<UINT> m_unitStarts;
+		std::vector<UINT> m_visibleItems;
+		std::vector<UINT> m_visible;
+		std::shared_ptr<DX::OcclusionCuller> m_occlusionCuller;
 
 		bool m_initialized;
 		bool m_loadingComplete;
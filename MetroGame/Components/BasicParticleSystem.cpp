@@ -2,11 +2,9 @@
 #include "BasicParticleSystem.h"
 #include <algorithm>
 #include <vector>
-#include <sstream>
 #include "Common/DirectXHelper.h"
 #include "Common/GeometryGenerator.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
 
 using namespace Microsoft::WRL;
@@ -24,9 +22,7 @@ BasicParticleSystem::BasicParticleSystem(
 	m_firstRun(true), m_needUpdateCB(false), m_age(0), m_initialized(false), m_loadingComplete(false)
 {
 	++m_signatureIndex;
-	std::wostringstream wos;
-	wos << m_signatureBase << m_signatureIndex;
-	m_textureArraySignature = wos.str();
+	m_textureArrayHandle = ResourceHandle(m_signatureBase + std::to_wstring(m_signatureIndex));
 }
 
 void BasicParticleSystem::Initialize(const BasicParticleSystemInitInfo& initInfo)
@@ -52,12 +48,12 @@ concurrency::task<void> BasicParticleSystem::CreateDeviceDependentResourcesAsync
 	}
 
 	// Initialize constant buffer
-	m_settingsCB.Initialize(m_deviceResources->GetD3DDevice());
+	m_settingsCB.Initialize(m_deviceResources->GetRenderDevice());
 	m_settingsCB.Data.AccelW = m_initInfo.AccelW;
 	m_settingsCB.Data.TexNum = m_initInfo.TexFileNames.size();
 	m_settingsCB.Data.EmitDirW = m_initInfo.EmitDirW;
 	m_settingsCB.Data.EmitPosW = m_initInfo.EmitPosW;
-	m_settingsCB.ApplyChanges(m_deviceResources->GetD3DDeviceContext());
+	m_settingsCB.ApplyChanges(m_deviceResources->GetRenderContext());
 
 	auto shaderMgr = ShaderMgr::Instance();
 	auto textureMgr = TextureMgr::Instance();
@@ -80,7 +76,7 @@ concurrency::task<void> BasicParticleSystem::CreateDeviceDependentResourcesAsync
 	CreateTasks.push_back(shaderMgr->GetPSAsync(m_initInfo.DrawPSFileName)
 		.then([=](ID3D11PixelShader* ps) {m_drawPS = ps; }));
 	// Load textures
-	CreateTasks.push_back(textureMgr->GetTextureArrayAsync(m_initInfo.TexFileNames, m_textureArraySignature)
+	CreateTasks.push_back(textureMgr->GetTextureArrayAsync(m_initInfo.TexFileNames, m_textureArrayHandle)
 		.then([=](ID3D11ShaderResourceView* srv) {m_texArraySRV = srv; }));
 	return concurrency::when_all(CreateTasks.begin(), CreateTasks.end())
 		.then([=]()
@@ -88,7 +84,7 @@ concurrency::task<void> BasicParticleSystem::CreateDeviceDependentResourcesAsync
 		if (m_initInfo.RandomTexSRV != nullptr)
 			m_randomTexSRV = m_initInfo.RandomTexSRV;
 		else
-			CreateRandomTexture1DSRV(m_deviceResources->GetD3DDevice(), m_randomTexSRV.GetAddressOf());
+			CreateRandomTexture1DSRV(m_deviceResources->GetRenderDevice(), m_randomTexSRV.GetAddressOf());
 
 		// Build input data
 		BuildVB();
@@ -103,21 +99,13 @@ void BasicParticleSystem::Render()
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Set IA stage.
 	UINT stride = sizeof(BasicParticle);
 	UINT offset = 0;
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_POINTLIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_POINTLIST;
-	}
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
+	context->IASetInputLayout(m_inputLayout.Get());
 	// On the first pass, use the initialization VB.  Otherwise, use
 	// the VB that contains the current particle list.
 	if (m_firstRun)
@@ -190,11 +178,6 @@ void BasicParticleSystem::Render()
 	context->GSSetShader(nullptr, 0, 0);
 	context->OMSetDepthStencilState(nullptr, 0);
 	context->OMSetBlendState(nullptr, blendFactor, 0xffffffff);
-
-	// Update ShaderChangement cache
-	ShaderChangement::VS = m_drawVS.Get();
-	ShaderChangement::GS = nullptr;
-	ShaderChangement::PS = m_drawPS.Get();
 }
 
 void BasicParticleSystem::ReleaseDeviceDependentResources()
@@ -239,7 +222,7 @@ void BasicParticleSystem::BuildVB()
 	D3D11_SUBRESOURCE_DATA vinitData;
 	vinitData.pSysMem = &p;
 
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_initVB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_initVB.GetAddressOf()));
 
 	//
 	// Create the ping-pong buffers for stream-out and drawing.
@@ -247,8 +230,8 @@ void BasicParticleSystem::BuildVB()
 	vbd.ByteWidth = sizeof(BasicParticle) * m_initInfo.MaxParticles;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_STREAM_OUTPUT;
 
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, 0, m_drawVB.GetAddressOf()));
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, 0, m_streamOutVB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, 0, m_drawVB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, 0, m_streamOutVB.GetAddressOf()));
 }
 
 void BasicParticleSystem::Reset()
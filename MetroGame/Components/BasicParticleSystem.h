@@ -53,7 +53,7 @@ namespace DXFramework
 		void SetAccel(const DirectX::XMFLOAT3& accel) { m_settingsCB.Data.AccelW = accel; m_needUpdateCB = true; }
 
 		float GetAge()const { return m_age; }
-		std::wstring GetTextureArraySignature() { return m_textureArraySignature; };
+		DX::ResourceHandle GetTextureArrayHandle() { return m_textureArrayHandle; };
 		ID3D11ShaderResourceView* GetRandomTexSRV() { return m_randomTexSRV.Get(); }
 
 	private:
@@ -99,7 +99,7 @@ namespace DXFramework
 		bool m_needUpdateCB;
 		float m_age;
 		const std::wstring m_signatureBase = L"BasicParticleSystemTexArray";
-		std::wstring m_textureArraySignature;
+		DX::ResourceHandle m_textureArrayHandle;
 		static int m_signatureIndex;
 
 		bool m_initialized;
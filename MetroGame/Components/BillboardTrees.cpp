@@ -2,11 +2,9 @@
 #include "BillboardTrees.h"
 #include <algorithm>
 #include <vector>
-#include <sstream>
 #include "Common/DirectXHelper.h"
 #include "Common/GeometryGenerator.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
 
 using namespace Microsoft::WRL;
@@ -28,9 +26,7 @@ BillboardTrees::BillboardTrees(
 	m_treeMat.Specular = XMFLOAT4(0.2f, 0.2f, 0.2f, 16.0f);
 
 	++m_signatureIndex;
-	std::wostringstream wos;
-	wos << m_signatureBase << m_signatureIndex;
-	m_textureArraySignature = wos.str();
+	m_textureArrayHandle = ResourceHandle(m_signatureBase + std::to_wstring(m_signatureIndex));
 }
 
 void BillboardTrees::Initialize(const std::vector<PointSize>& data, const std::vector<std::wstring>& treeFileNames)
@@ -55,10 +51,10 @@ concurrency::task<void> BillboardTrees::CreateDeviceDependentResourcesAsync()
 	}
 
 	// Initialize constant buffer
-	m_treeSettingsCB.Initialize(m_deviceResources->GetD3DDevice());
+	m_treeSettingsCB.Initialize(m_deviceResources->GetRenderDevice());
 	m_treeSettingsCB.Data.Mat = m_treeMat;
 	m_treeSettingsCB.Data.TypeNum = m_treeTypeNum;
-	m_treeSettingsCB.ApplyChanges(m_deviceResources->GetD3DDeviceContext());
+	m_treeSettingsCB.ApplyChanges(m_deviceResources->GetRenderContext());
 
 	auto shaderMgr = ShaderMgr::Instance();
 	auto textureMgr = TextureMgr::Instance();
@@ -78,7 +74,7 @@ concurrency::task<void> BillboardTrees::CreateDeviceDependentResourcesAsync()
 		.then([=](ID3D11PixelShader* ps) { m_treeLight3TexClipPS = ps; }));
 	CreateTasks.push_back(shaderMgr->GetPSAsync(L"TreeLight3TexClipFogPS.cso")
 		.then([=](ID3D11PixelShader* ps) { m_treeLight3TexClipFogPS = ps; }));
-	CreateTasks.push_back(textureMgr->GetTextureArrayAsync(m_treeFileNames, m_textureArraySignature)
+	CreateTasks.push_back(textureMgr->GetTextureArrayAsync(m_treeFileNames, m_textureArrayHandle)
 		.then([=](ID3D11ShaderResourceView* srv) {m_treeTextureMapArraySRV = srv; }));
 
 	return concurrency::when_all(CreateTasks.begin(), CreateTasks.end())
@@ -90,68 +86,47 @@ concurrency::task<void> BillboardTrees::CreateDeviceDependentResourcesAsync()
 	});
 }
 
-void BillboardTrees::Render()
+void BillboardTrees::Submit(RenderQueue& queue)
 {
-	if (!m_loadingComplete)
+	if (!m_loadingComplete || queue.GetPass() != RenderPass::Color)
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
 
 	// Set IA stage
+	DrawState state;
 	UINT stride = sizeof(PointSize);
-	UINT offset = 0;
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_POINTLIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_POINTLIST;
-	}
-	if (ShaderChangement::InputLayout != m_treeInputLayout.Get())
-	{
-		context->IASetInputLayout(m_treeInputLayout.Get());
-		ShaderChangement::InputLayout = m_treeInputLayout.Get();
-	}
-	context->IASetVertexBuffers(0, 1, m_treeSpriteVB.GetAddressOf(), &stride, &offset);
+	state.InputLayout = m_treeInputLayout.Get();
+	state.Topology = D3D11_PRIMITIVE_TOPOLOGY_POINTLIST;
+	state.SetVertexBuffers(1, m_treeSpriteVB.GetAddressOf(), &stride);
 
 	ID3D11Buffer* cbuffers[2] = { m_perFrameCB->GetBuffer(), m_treeSettingsCB.GetBuffer() };
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
-	// Bind shaders, constant buffers, srvs and samplers
-	context->VSSetShader(m_treeVS.Get(), 0, 0);
-	ShaderChangement::VS = m_treeVS.Get();
-	context->GSSetShader(m_treeGS.Get(), 0, 0);
-	context->GSSetConstantBuffers(0, 1, cbuffers);
+	// Set shaders, constant buffers, srvs and samplers
+	state.SetShader(ShaderStage::Vertex, m_treeVS.Get());
+	state.SetShader(ShaderStage::Geometry, m_treeGS.Get());
+	state.SetConstantBuffers(ShaderStage::Geometry, 0, 1, cbuffers);
 	switch (m_renderOptions)
 	{
 	case BillTreeRenderOption::Light3:		// Light
-		context->PSSetShader(m_treeLight3PS.Get(), 0, 0);
-		ShaderChangement::PS = m_treeLight3PS.Get();
+		state.SetShader(ShaderStage::Pixel, m_treeLight3PS.Get());
 		break;
 	case BillTreeRenderOption::Light3TexClip:		// LightTexClip
-		context->PSSetShader(m_treeLight3TexClipPS.Get(), 0, 0);
-		ShaderChangement::PS = m_treeLight3TexClipPS.Get();
+		state.SetShader(ShaderStage::Pixel, m_treeLight3TexClipPS.Get());
 		break;
 	case BillTreeRenderOption::Light3TexClipFog:		// LightTexClipFog
-		context->PSSetShader(m_treeLight3TexClipFogPS.Get(), 0, 0);
-		ShaderChangement::PS = m_treeLight3TexClipFogPS.Get();
+		state.SetShader(ShaderStage::Pixel, m_treeLight3TexClipFogPS.Get());
 		break;
 	default:
 		throw ref new Platform::InvalidArgumentException("No such render option");
 	}
-	context->PSSetConstantBuffers(0, 2, cbuffers);
-	context->PSSetSamplers(0, 1, samplers);
-	context->PSSetShaderResources(0, 1, m_treeTextureMapArraySRV.GetAddressOf());
-
-	float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	state.SetConstantBuffers(ShaderStage::Pixel, 0, 2, cbuffers);
+	state.SetSamplers(ShaderStage::Pixel, 0, 1, samplers);
+	state.SetShaderResources(ShaderStage::Pixel, 0, 1, m_treeTextureMapArraySRV.GetAddressOf());
 	if (m_alphaToCoverage)
-		context->OMSetBlendState(renderStateMgr->AlphaToCoverBS(), blendFactor, 0xffffffff);
-	context->Draw(m_treeCount, 0);
+		state.BlendState = renderStateMgr->AlphaToCoverBS();
 
-	// Recover render state
-	if (m_alphaToCoverage)
-		context->OMSetBlendState(nullptr, blendFactor, 0xffffffff);
-	// Remove gs
-	context->GSSetShader(nullptr, 0, 0);
-	ShaderChangement::GS = nullptr;
+	queue.Draw(queue.AddState(state), m_treeCount, 0);
 }
 
 void BillboardTrees::ReleaseDeviceDependentResources()
@@ -179,5 +154,5 @@ void BillboardTrees::BuildTreeSpritesBuffer()
 	vbd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA vinitData;
 	vinitData.pSysMem = &m_positionData[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_treeSpriteVB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_treeSpriteVB.GetAddressOf()));
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "Common/GameTimer.h"
 #include "Common/ConstantBuffer.h"
 #include "Common/DeviceResources.h"
+#include "Common/RenderQueue.h"
 
 // Billboard using alpha to coverage technique. Trees' position data
 // is directly set in the world coordinates.
@@ -29,13 +30,14 @@ namespace DXFramework
 		void Initialize(const std::vector<DX::PointSize>& Data, const std::vector<std::wstring>& treeFileNames);
 		concurrency::task<void> CreateDeviceDependentResourcesAsync();
 		void ReleaseDeviceDependentResources();
-		void Render();
+		// Adds the draw for the color pass of the queue.
+		void Submit(DX::RenderQueue& queue);
 
 	public:
 		// Configure functions
 		void SetRenderOption(BillTreeRenderOption r) { m_renderOptions = r; }
 		void SetAlphaToCoverage(bool a) { m_alphaToCoverage = a; }
-		std::wstring GetTextureArraySignature() { return m_textureArraySignature; };
+		DX::ResourceHandle GetTextureArrayHandle() { return m_textureArrayHandle; };
 
 	private:
 		void BuildTreeSpritesBuffer();
@@ -75,7 +77,7 @@ namespace DXFramework
 		std::vector<DX::PointSize> m_positionData;
 		std::vector<std::wstring> m_treeFileNames;
 		const std::wstring m_signatureBase = L"BillTreeTextureArray";
-		std::wstring m_textureArraySignature;
+		DX::ResourceHandle m_textureArrayHandle;
 		static int m_signatureIndex;
 		BillTreeRenderOption m_renderOptions;
 		bool m_alphaToCoverage;
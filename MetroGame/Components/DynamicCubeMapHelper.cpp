@@ -2,7 +2,6 @@
 #include "DynamicCubeMapHelper.h"
 #include "Common/DirectXHelper.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
 #include "Common/GeometryGenerator.h"
 
@@ -55,7 +54,7 @@ void DynamicCubeMapHelper::Render(const std::function<void()>& DrawMap)
 	if (!m_loadingComplete)
 		return;
 
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	ID3D11RenderTargetView* renderTargets[1];
 	// Generate the cube map.
@@ -162,7 +161,7 @@ void DynamicCubeMapHelper::BuildCubeFaceCamera()
 
 void DynamicCubeMapHelper::BuildCubeMapViews()
 {
-	ID3D11Device* device = m_deviceResources->GetD3DDevice();
+	RenderDevice* device = m_deviceResources->GetRenderDevice();
 
 	// Cube map is a special texture array with 6 elements.
 	D3D11_TEXTURE2D_DESC texDesc;
@@ -9,8 +9,8 @@
 #include "Common/DirectXHelper.h"
 #include "Common/GeometryGenerator.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
+#include "Common/Profiler.h"
 
 using namespace Microsoft::WRL;
 using namespace DXFramework;
@@ -68,17 +68,17 @@ concurrency::task<void> GpuWaves::CreateDeviceDependentResourcesAsync()
 	}
 
 	// Initialize constant buffer
-	m_rareChangedCB.Initialize(m_deviceResources->GetD3DDevice());
-	m_updateConstantsCB.Initialize(m_deviceResources->GetD3DDevice());
-	m_disturbSettingsCB.Initialize(m_deviceResources->GetD3DDevice());
+	m_rareChangedCB.Initialize(m_deviceResources->GetRenderDevice());
+	m_updateConstantsCB.Initialize(m_deviceResources->GetRenderDevice());
+	m_disturbSettingsCB.Initialize(m_deviceResources->GetRenderDevice());
 
 	m_rareChangedCB.Data.GridSpatialStep = m_spatialStep;
 	m_rareChangedCB.Data.DisplacementMapTexelSize = XMFLOAT2(1.0f / m_numCols, 1.0f / m_numRows);
-	m_rareChangedCB.ApplyChanges(m_deviceResources->GetD3DDeviceContext());
+	m_rareChangedCB.ApplyChanges(m_deviceResources->GetRenderContext());
 	m_updateConstantsCB.Data.Constants.x = m_k[0];
 	m_updateConstantsCB.Data.Constants.y = m_k[1];
 	m_updateConstantsCB.Data.Constants.z = m_k[2];
-	m_updateConstantsCB.ApplyChanges(m_deviceResources->GetD3DDeviceContext());
+	m_updateConstantsCB.ApplyChanges(m_deviceResources->GetRenderContext());
 
 	auto shaderMgr = ShaderMgr::Instance();
 	auto textureMgr = TextureMgr::Instance();
@@ -142,6 +142,8 @@ void GpuWaves::Update(DX::GameTimer const& timer)
 
 void GpuWaves::Update(float dt)
 {
+	DX_PROFILE_ZONE("GpuWaves::Update");
+
 	static float t = 0;
 
 	// Accumulate time.
@@ -150,7 +152,7 @@ void GpuWaves::Update(float dt)
 	// Only update the simulation at the specified time step.
 	if (t >= m_timeStep)
 	{
-		ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+		RenderContext* context = m_deviceResources->GetRenderContext();
 		ID3D11Buffer* cbuffers[1] = { m_updateConstantsCB.GetBuffer() };
 		context->CSSetConstantBuffers(0, 1, cbuffers);
 		ID3D11ShaderResourceView* srvs[2] = { m_wavesPrevSolSRV.Get(), m_wavesCurrSolSRV.Get() };
@@ -190,15 +192,12 @@ void GpuWaves::Update(float dt)
 		m_wavesCurrSolUAV.Swap(m_wavesNextSolUAV);
 
 		t = 0.0f; // reset time
-
-		// Update ShaderChangment cache
-		ShaderChangement::CS = nullptr;
 	}
 }
 
 void GpuWaves::Disturb(UINT i, UINT j, float magnitude)
 {
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Update constant buffer
 	m_disturbSettingsCB.Data.Index.x = i;
@@ -225,21 +224,13 @@ void GpuWaves::Render()
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Set IA stage.
 	UINT stride = sizeof(Basic32);
 	UINT offset = 0;
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
-	if (ShaderChangement::InputLayout != m_wavesInputLayout.Get())
-	{
-		context->IASetInputLayout(m_wavesInputLayout.Get());
-		ShaderChangement::InputLayout = m_wavesInputLayout.Get();
-	}
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->IASetInputLayout(m_wavesInputLayout.Get());
 	context->IASetVertexBuffers(0, 1, m_wavesVB.GetAddressOf(), &stride, &offset);
 	context->IASetIndexBuffer(m_wavesIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 
@@ -258,7 +249,6 @@ void GpuWaves::Render()
 	ID3D11SamplerState* samplers[2] = { renderStateMgr->PointSam(), renderStateMgr->AnisotropicSam() };
 	//vs
 	context->VSSetShader(m_wavesVS.Get(), 0, 0);
-	ShaderChangement::VS = m_wavesVS.Get();
 	context->VSSetConstantBuffers(0, 3, cbuffers);
 	context->VSSetSamplers(0, 1,samplers);
 	context->VSSetShaderResources(0, 1, m_wavesCurrSolSRV.GetAddressOf());
@@ -267,15 +257,12 @@ void GpuWaves::Render()
 	{
 	case GpuWavesRenderOption::Light3:		// Light
 		context->PSSetShader(m_wavesLight3PS.Get(), 0, 0);
-		ShaderChangement::PS = m_wavesLight3PS.Get();
 		break;
 	case GpuWavesRenderOption::Light3Tex:		// LightTex
 		context->PSSetShader(m_wavesLight3TexPS.Get(), 0, 0);
-		ShaderChangement::PS = m_wavesLight3TexPS.Get();
 		break;
 	case GpuWavesRenderOption::Light3TexFog:		// LightTexFog
 		context->PSSetShader(m_wavesLight3TexFogPS.Get(), 0, 0);
-		ShaderChangement::PS = m_wavesLight3TexFogPS.Get();
 		break;
 	default:
 		throw ref new Platform::InvalidArgumentException("No such render option");
@@ -352,7 +339,7 @@ void GpuWaves::BuildWaveGeometryBuffers()
 	vbd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA vinitData;
 	vinitData.pSysMem = &vertices[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_wavesVB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_wavesVB.GetAddressOf()));
 
 
 	D3D11_BUFFER_DESC ibd;
@@ -363,7 +350,7 @@ void GpuWaves::BuildWaveGeometryBuffers()
 	ibd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA iinitData;
 	iinitData.pSysMem = &grid.Indices[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_wavesIB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&ibd, &iinitData, m_wavesIB.GetAddressOf()));
 }
 
 void GpuWaves::BuildWaveSimulationViews()
@@ -371,7 +358,7 @@ void GpuWaves::BuildWaveSimulationViews()
 	// All the textures for the wave simulation will be bound as a shader resource and
 	// unordered access view at some point since we ping-pong the buffers.
 
-	ID3D11Device* device = m_deviceResources->GetD3DDevice();
+	RenderDevice* device = m_deviceResources->GetRenderDevice();
 
 	D3D11_TEXTURE2D_DESC texDesc;
 	texDesc.Width = m_numCols;
@@ -2,7 +2,6 @@
 #include "MapDisplayer.h"
 #include "Common/DirectXHelper.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
 #include "Common/GeometryGenerator.h"
 
@@ -52,9 +51,9 @@ concurrency::task<void> MapDisplayer::CreateDeviceDependentResourcesAsync()
 	}
 
 	// Set the offset world
-	m_worldCB.Initialize(m_deviceResources->GetD3DDevice());
+	m_worldCB.Initialize(m_deviceResources->GetRenderDevice());
 	XMStoreFloat4x4(&m_worldCB.Data.World, XMMatrixTranspose(XMLoadFloat4x4(&m_world)));
-	m_worldCB.ApplyChanges(m_deviceResources->GetD3DDeviceContext());
+	m_worldCB.ApplyChanges(m_deviceResources->GetRenderContext());
 
 	// Initialize constant buffer
 	auto shaderMgr = ShaderMgr::Instance();
@@ -95,49 +94,35 @@ void MapDisplayer::Render()
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Set IA stage.
 	UINT stride = sizeof(Basic32);
 	UINT offset = 0;
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->IASetInputLayout(m_inputLayout.Get());
 	// Bind VB and IB
 	context->IASetVertexBuffers(0, 1, m_quadVB.GetAddressOf(), &stride, &offset);
 	context->IASetIndexBuffer(m_quadIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 
 	// Bind shaders, constant buffers, srvs and samplers
 	context->VSSetShader(m_vs.Get(), nullptr, 0);
-	ShaderChangement::VS = m_vs.Get();
 	switch (m_type)
 	{
 	case MapDisplayType::RED:
 		context->PSSetShader(m_redPS.Get(), nullptr, 0);
-		ShaderChangement::PS = m_redPS.Get();
 		break;
 	case MapDisplayType::GREEN:
 		context->PSSetShader(m_greenPS.Get(), nullptr, 0);
-		ShaderChangement::PS = m_greenPS.Get();
 		break;
 	case MapDisplayType::BLUE:
 		context->PSSetShader(m_bluePS.Get(), nullptr, 0);
-		ShaderChangement::PS = m_bluePS.Get();
 		break;
 	case MapDisplayType::ALPHA:
 		context->PSSetShader(m_alphaPS.Get(), nullptr, 0);
-		ShaderChangement::PS = m_alphaPS.Get();
 		break;
 	case MapDisplayType::ALL:
 		context->PSSetShader(m_allPS.Get(), nullptr, 0);
-		ShaderChangement::PS = m_allPS.Get();
 		break;
 	default:
 		throw ref new Platform::FailureException("No such display type!");
@@ -151,9 +136,6 @@ void MapDisplayer::Render()
 
 	context->DrawIndexed(6, 0, 0);
 
-	// Update ShaderChangment cache
-	ShaderChangement::VS = nullptr;
-	ShaderChangement::PS = nullptr;
 	if (m_unbind)
 	{
 		// Unbind srv
@@ -209,7 +191,7 @@ void MapDisplayer::BuildQuadGeometryBuffers()
 	vbd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA vinitData;
 	vinitData.pSysMem = &vertices[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_quadVB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_quadVB.GetAddressOf()));
 
 	// Pack the indices of all the meshes into one index buffer.
 	D3D11_BUFFER_DESC ibd;
@@ -220,7 +202,7 @@ void MapDisplayer::BuildQuadGeometryBuffers()
 	ibd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA iinitData;
 	iinitData.pSysMem = &quad.Indices[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_quadIB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&ibd, &iinitData, m_quadIB.GetAddressOf()));
 }
 
 
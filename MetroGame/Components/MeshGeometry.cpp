@@ -1,14 +1,78 @@
-#include "pch.h"
 #include "MeshGeometry.h"
-#include "Common/DirectXHelper.h"
+#include <algorithm>
+#include <stdexcept>
 #include "Common/MathHelper.h"
 
-using namespace Microsoft::WRL;
 using namespace DXFramework;
 using namespace DirectX;
 
 using namespace DX;
 
+namespace
+{
+	const float InvSqrt2 = 0.70710678f;
+
+	void Dequantize(const USHORT* value, const XMFLOAT3& min, const XMFLOAT3& extent, XMFLOAT3& result)
+	{
+		result.x = min.x + value[0] * (extent.x / 65535.0f);
+		result.y = min.y + value[1] * (extent.y / 65535.0f);
+		result.z = min.z + value[2] * (extent.z / 65535.0f);
+	}
+
+	// Smallest three: the index of the dropped component is in the top bits of the
+	// first two values, the other components have 15 bits each.
+	void DecodeRotation(const USHORT* value, XMFLOAT4& result)
+	{
+		UINT largest = ((value[0] >> 15) << 1) | (value[1] >> 15);
+		float* q = &result.x;
+		float sum = 0.0f;
+		for (UINT i = 0, j = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			q[i] = ((value[j++] & 0x7fff) * (2.0f / 32767.0f) - 1.0f) * InvSqrt2;
+			sum += q[i] * q[i];
+		}
+		q[largest] = sqrtf((std::max)(1.0f - sum, 0.0f));
+	}
+
+	void DecodeKeyframe(const CompressedKeyframes& keys, UINT i, Keyframe& key)
+	{
+		const USHORT* data = keys.Data.data();
+		key.TimePos = keys.StartTime + data[i] * (keys.Duration / 65535.0f);
+
+		if (keys.Flags & CompressedKeyframes::ConstantRotation)
+			DecodeRotation(data + keys.RotationOffset, key.RotationQuat);
+		else
+			DecodeRotation(data + keys.RotationOffset + i * 3, key.RotationQuat);
+
+		if (keys.Flags & CompressedKeyframes::ConstantTranslation)
+			key.Translation = keys.TranslationMin;
+		else
+			Dequantize(data + keys.TranslationOffset + i * 3, keys.TranslationMin, keys.TranslationExtent, key.Translation);
+
+		if (keys.Flags & CompressedKeyframes::ConstantScale)
+			key.Scale = keys.ScaleMin;
+		else
+			Dequantize(data + keys.ScaleOffset + i * 3, keys.ScaleMin, keys.ScaleExtent, key.Scale);
+	}
+}
+
+CompressedKeyframes::CompressedKeyframes()
+	: StartTime(0.0f),
+	Duration(0.0f),
+	Flags(0),
+	KeyCount(0),
+	TranslationMin(0.0f, 0.0f, 0.0f),
+	TranslationExtent(0.0f, 0.0f, 0.0f),
+	ScaleMin(1.0f, 1.0f, 1.0f),
+	ScaleExtent(0.0f, 0.0f, 0.0f),
+	RotationOffset(0),
+	TranslationOffset(0),
+	ScaleOffset(0)
+{
+}
+
 Keyframe::Keyframe()
 	: TimePos(0.0f),
 	Translation(0.0f, 0.0f, 0.0f),
@@ -23,12 +87,18 @@ Keyframe::~Keyframe()
 
 float BoneAnimation::GetStartTime()const
 {
+	if (Keyframes.empty())
+		return Compressed.StartTime + Compressed.Data.front() * (Compressed.Duration / 65535.0f);
+
 	// Keyframes are sorted by time, so first keyframe gives start time.
 	return Keyframes.front().TimePos;
 }
 
 float BoneAnimation::GetEndTime()const
 {
+	if (Keyframes.empty())
+		return Compressed.StartTime + Compressed.Data[Compressed.KeyCount - 1] * (Compressed.Duration / 65535.0f);
+
 	// Keyframes are sorted by time, so last keyframe gives end time.
 	float f = Keyframes.back().TimePos;
 
@@ -37,51 +107,92 @@ float BoneAnimation::GetEndTime()const
 
 void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
 {
-	if (t <= Keyframes.front().TimePos)
-	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.front().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.front().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.front().RotationQuat);
+	UINT cursor = 0;
+	XMStoreFloat4x4(&M, Interpolate(t, cursor));
+}
 
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
-	}
-	else if (t >= Keyframes.back().TimePos)
-	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.back().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.back().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.back().RotationQuat);
+XMMATRIX XM_CALLCONV BoneAnimation::Interpolate(float t, UINT& cursor)const
+{
+	Keyframe k0, k1;
+	float lerpPercent;
+	FindKeyframes(t, cursor, k0, k1, lerpPercent);
 
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
-	}
-	else
-	{
-		for (UINT i = 0; i < Keyframes.size() - 1; ++i)
-		{
-			if (t >= Keyframes[i].TimePos && t <= Keyframes[i + 1].TimePos)
-			{
-				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i + 1].TimePos - Keyframes[i].TimePos);
+	XMVECTOR s0 = XMLoadFloat3(&k0.Scale);
+	XMVECTOR s1 = XMLoadFloat3(&k1.Scale);
 
-				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
-				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i + 1].Scale);
+	XMVECTOR p0 = XMLoadFloat3(&k0.Translation);
+	XMVECTOR p1 = XMLoadFloat3(&k1.Translation);
 
-				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
-				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i + 1].Translation);
+	XMVECTOR q0 = XMLoadFloat4(&k0.RotationQuat);
+	XMVECTOR q1 = XMLoadFloat4(&k1.RotationQuat);
 
-				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
-				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
+	XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
+	XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
+	XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
 
-				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+	XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	return XMMatrixAffineTransformation(S, zero, Q, P);
+}
+
+void BoneAnimation::FindKeyframes(float t, UINT& cursor, Keyframe& k0, Keyframe& k1, float& lerpPercent)const
+{
+	if (Keyframes.empty())
+	{
+		// Compressed times are searched in their quantized units.
+		const USHORT* times = Compressed.Data.data();
+		UINT last = Compressed.KeyCount - 1;
+		float u = Compressed.Duration > 0.0f ? (t - Compressed.StartTime) * (65535.0f / Compressed.Duration) : 0.0f;
 
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		if (u <= times[0])
+		{
+			cursor = 0;
+			DecodeKeyframe(Compressed, 0, k0);
+			k1 = k0;
+			lerpPercent = 0.0f;
+		}
+		else if (u >= times[last])
+		{
+			DecodeKeyframe(Compressed, last, k0);
+			k1 = k0;
+			lerpPercent = 0.0f;
+		}
+		else
+		{
+			if (cursor >= last || u < times[cursor])
+				cursor = 0;
+			while (u > times[cursor + 1])
+				++cursor;
 
-				break;
-			}
+			DecodeKeyframe(Compressed, cursor, k0);
+			DecodeKeyframe(Compressed, cursor + 1, k1);
+			lerpPercent = (u - times[cursor]) / (times[cursor + 1] - times[cursor]);
 		}
+		return;
+	}
+
+	if (t <= Keyframes.front().TimePos)
+	{
+		cursor = 0;
+		k0 = k1 = Keyframes.front();
+		lerpPercent = 0.0f;
+	}
+	else if (t >= Keyframes.back().TimePos)
+	{
+		k0 = k1 = Keyframes.back();
+		lerpPercent = 0.0f;
+	}
+	else
+	{
+		// Restart from the first keyframe if time went backwards (e.g. looping),
+		// otherwise walk forward from where the last call stopped.
+		if (cursor >= Keyframes.size() - 1 || t < Keyframes[cursor].TimePos)
+			cursor = 0;
+		while (t > Keyframes[cursor + 1].TimePos)
+			++cursor;
+
+		k0 = Keyframes[cursor];
+		k1 = Keyframes[cursor + 1];
+		lerpPercent = (t - k0.TimePos) / (k1.TimePos - k0.TimePos);
 	}
 }
 
@@ -119,18 +230,20 @@ void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms
 
 float SkinnedData::GetClipStartTime(const std::wstring& clipName)const
 {
-	auto clip = m_animations.find(clipName);
-	if (clip == m_animations.end())
-		throw ref new Platform::InvalidArgumentException("No such animation data!");
-	return clip->second.GetClipStartTime();
+	return m_clipStartTimes[GetClipHandle(clipName)];
 }
 
 float SkinnedData::GetClipEndTime(const std::wstring& clipName)const
 {
-	auto clip = m_animations.find(clipName);
-	if (clip == m_animations.end())
-		throw ref new Platform::InvalidArgumentException("No such animation data!");
-	return clip->second.GetClipEndTime();
+	return m_clipEndTimes[GetClipHandle(clipName)];
+}
+
+ClipHandle SkinnedData::GetClipHandle(const std::wstring& clipName)const
+{
+	auto clip = m_clipHandles.find(clipName);
+	if (clip == m_clipHandles.end())
+		throw std::invalid_argument("No such animation data!");
+	return clip->second;
 }
 
 UINT SkinnedData::GetBoneCount()const
@@ -142,26 +255,173 @@ void SkinnedData::Initialize(std::vector<XMFLOAT4X4>& boneOffsets,
 	std::map<std::wstring, AnimationClip>& animations)
 {
 	m_boneOffsets = boneOffsets;
-	m_animations = animations;
+
+	UINT numBones = m_boneOffsets.size();
+	UINT numBlocks = (numBones + 3) / 4;
+	m_boneOffsetsSoA.resize(numBlocks * 16);
+	for (UINT block = 0; block < numBlocks; ++block)
+	{
+		for (UINT r = 0; r < 4; ++r)
+		{
+			for (UINT c = 0; c < 4; ++c)
+			{
+				// Pad the last block by repeating the last bone.
+				float* lanes = &m_boneOffsetsSoA[block * 16 + r * 4 + c].x;
+				for (UINT lane = 0; lane < 4; ++lane)
+					lanes[lane] = m_boneOffsets[(std::min)(block * 4 + lane, numBones - 1)].m[r][c];
+			}
+		}
+	}
+
+	// Flatten the clips so they can be addressed by handle, and cache the clip
+	// times which would otherwise walk every bone.
+	m_clips.clear();
+	m_clipStartTimes.clear();
+	m_clipEndTimes.clear();
+	m_clipHandles.clear();
+	for (auto& item : animations)
+	{
+		m_clipHandles[item.first] = m_clips.size();
+		m_clips.push_back(item.second);
+		m_clipStartTimes.push_back(item.second.GetClipStartTime());
+		m_clipEndTimes.push_back(item.second.GetClipEndTime());
+	}
 }
 
-void SkinnedData::GetFinalTransforms(const std::wstring& clipName, float timePos, std::vector<XMFLOAT4X4>& finalTransforms)const
+void SkinnedData::ResetPlayback(AnimationPlayback& playback, ClipHandle clip)const
+{
+	playback.Clip = clip;
+	playback.TimePos = -1.0f;
+	playback.Cursors.assign(m_clips[clip].BoneAnimations.size(), 0);
+}
+
+void SkinnedData::GetFinalTransforms(AnimationPlayback& playback, XMFLOAT4X4* finalTransforms)const
 {
+	static const XMVECTORF32 OneMinusEpsilon = { 1.0f - 0.00001f, 1.0f - 0.00001f, 1.0f - 0.00001f, 1.0f - 0.00001f };
+
+	const AnimationClip& clip = m_clips[playback.Clip];
 	UINT numBones = m_boneOffsets.size();
-	std::vector<XMFLOAT4X4> boneTransforms(numBones);
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR two = XMVectorReplicate(2.0f);
+
+	// Every XMVECTOR below holds the same component of four bones.
+	for (UINT block = 0; block * 4 < numBones; ++block)
+	{
+		// Finding and decoding the keyframes is scalar, per bone.
+		Keyframe k0[4];
+		Keyframe k1[4];
+		XMFLOAT4 lerpPercents;
+		float* lerpLanes = &lerpPercents.x;
+		for (UINT lane = 0; lane < 4; ++lane)
+		{
+			UINT bone = (std::min)(block * 4 + lane, numBones - 1);
+			clip.BoneAnimations[bone].FindKeyframes(playback.TimePos, playback.Cursors[bone], k0[lane], k1[lane], lerpLanes[lane]);
+		}
+		XMVECTOR T = XMLoadFloat4(&lerpPercents);
+
+		// Gather the keyframes and transpose them to SoA.
+		XMMATRIX s0 = XMMatrixTranspose(XMMATRIX(XMLoadFloat3(&k0[0].Scale), XMLoadFloat3(&k0[1].Scale),
+			XMLoadFloat3(&k0[2].Scale), XMLoadFloat3(&k0[3].Scale)));
+		XMMATRIX s1 = XMMatrixTranspose(XMMATRIX(XMLoadFloat3(&k1[0].Scale), XMLoadFloat3(&k1[1].Scale),
+			XMLoadFloat3(&k1[2].Scale), XMLoadFloat3(&k1[3].Scale)));
+		XMMATRIX p0 = XMMatrixTranspose(XMMATRIX(XMLoadFloat3(&k0[0].Translation), XMLoadFloat3(&k0[1].Translation),
+			XMLoadFloat3(&k0[2].Translation), XMLoadFloat3(&k0[3].Translation)));
+		XMMATRIX p1 = XMMatrixTranspose(XMMATRIX(XMLoadFloat3(&k1[0].Translation), XMLoadFloat3(&k1[1].Translation),
+			XMLoadFloat3(&k1[2].Translation), XMLoadFloat3(&k1[3].Translation)));
+		XMMATRIX q0 = XMMatrixTranspose(XMMATRIX(XMLoadFloat4(&k0[0].RotationQuat), XMLoadFloat4(&k0[1].RotationQuat),
+			XMLoadFloat4(&k0[2].RotationQuat), XMLoadFloat4(&k0[3].RotationQuat)));
+		XMMATRIX q1 = XMMatrixTranspose(XMMATRIX(XMLoadFloat4(&k1[0].RotationQuat), XMLoadFloat4(&k1[1].RotationQuat),
+			XMLoadFloat4(&k1[2].RotationQuat), XMLoadFloat4(&k1[3].RotationQuat)));
+
+		XMVECTOR sx = XMVectorLerpV(s0.r[0], s1.r[0], T);
+		XMVECTOR sy = XMVectorLerpV(s0.r[1], s1.r[1], T);
+		XMVECTOR sz = XMVectorLerpV(s0.r[2], s1.r[2], T);
+		XMVECTOR px = XMVectorLerpV(p0.r[0], p1.r[0], T);
+		XMVECTOR py = XMVectorLerpV(p0.r[1], p1.r[1], T);
+		XMVECTOR pz = XMVectorLerpV(p0.r[2], p1.r[2], T);
+
+		// Slerp, following XMQuaternionSlerpV lane by lane.
+		XMVECTOR cosOmega = XMVectorMultiply(q0.r[0], q1.r[0]);
+		cosOmega = XMVectorMultiplyAdd(q0.r[1], q1.r[1], cosOmega);
+		cosOmega = XMVectorMultiplyAdd(q0.r[2], q1.r[2], cosOmega);
+		cosOmega = XMVectorMultiplyAdd(q0.r[3], q1.r[3], cosOmega);
+		XMVECTOR sign = XMVectorSelect(one, XMVectorNegate(one), XMVectorLess(cosOmega, zero));
+		cosOmega = XMVectorMultiply(cosOmega, sign);
+		XMVECTOR control = XMVectorLess(cosOmega, OneMinusEpsilon);
+		XMVECTOR sinOmega = XMVectorSqrt(XMVectorNegativeMultiplySubtract(cosOmega, cosOmega, one));
+		XMVECTOR omega = XMVectorATan2(sinOmega, cosOmega);
+		XMVECTOR invSinOmega = XMVectorReciprocal(sinOmega);
+		XMVECTOR oneMinusT = XMVectorSubtract(one, T);
+		XMVECTOR w0 = XMVectorSelect(oneMinusT, XMVectorMultiply(XMVectorSin(XMVectorMultiply(oneMinusT, omega)), invSinOmega), control);
+		XMVECTOR w1 = XMVectorSelect(T, XMVectorMultiply(XMVectorSin(XMVectorMultiply(T, omega)), invSinOmega), control);
+		w1 = XMVectorMultiply(w1, sign);
+		XMVECTOR qx = XMVectorMultiplyAdd(q1.r[0], w1, XMVectorMultiply(q0.r[0], w0));
+		XMVECTOR qy = XMVectorMultiplyAdd(q1.r[1], w1, XMVectorMultiply(q0.r[1], w0));
+		XMVECTOR qz = XMVectorMultiplyAdd(q1.r[2], w1, XMVectorMultiply(q0.r[2], w0));
+		XMVECTOR qw = XMVectorMultiplyAdd(q1.r[3], w1, XMVectorMultiply(q0.r[3], w0));
+
+		// Scaled rotation rows, as XMMatrixAffineTransformation(S, 0, Q, P) builds them.
+		XMVECTOR xx = XMVectorMultiply(qx, qx), yy = XMVectorMultiply(qy, qy), zz = XMVectorMultiply(qz, qz);
+		XMVECTOR xy = XMVectorMultiply(qx, qy), xz = XMVectorMultiply(qx, qz), yz = XMVectorMultiply(qy, qz);
+		XMVECTOR wx = XMVectorMultiply(qw, qx), wy = XMVectorMultiply(qw, qy), wz = XMVectorMultiply(qw, qz);
+
+		XMVECTOR B[3][3];
+		B[0][0] = XMVectorMultiply(sx, XMVectorNegativeMultiplySubtract(two, XMVectorAdd(yy, zz), one));
+		B[0][1] = XMVectorMultiply(sx, XMVectorMultiply(two, XMVectorAdd(xy, wz)));
+		B[0][2] = XMVectorMultiply(sx, XMVectorMultiply(two, XMVectorSubtract(xz, wy)));
+		B[1][0] = XMVectorMultiply(sy, XMVectorMultiply(two, XMVectorSubtract(xy, wz)));
+		B[1][1] = XMVectorMultiply(sy, XMVectorNegativeMultiplySubtract(two, XMVectorAdd(xx, zz), one));
+		B[1][2] = XMVectorMultiply(sy, XMVectorMultiply(two, XMVectorAdd(yz, wx)));
+		B[2][0] = XMVectorMultiply(sz, XMVectorMultiply(two, XMVectorAdd(xz, wy)));
+		B[2][1] = XMVectorMultiply(sz, XMVectorMultiply(two, XMVectorSubtract(yz, wx)));
+		B[2][2] = XMVectorMultiply(sz, XMVectorNegativeMultiplySubtract(two, XMVectorAdd(xx, yy), one));
+		XMVECTOR P[3] = { px, py, pz };
+
+		// final = offset * bone; the bone's last column is (0, 0, 0, 1), so the
+		// last column of the result is the offset's.
+		const XMFLOAT4* offset = &m_boneOffsetsSoA[block * 16];
+		XMVECTOR F[4][4];
+		for (UINT r = 0; r < 4; ++r)
+		{
+			XMVECTOR o0 = XMLoadFloat4(&offset[r * 4 + 0]);
+			XMVECTOR o1 = XMLoadFloat4(&offset[r * 4 + 1]);
+			XMVECTOR o2 = XMLoadFloat4(&offset[r * 4 + 2]);
+			XMVECTOR o3 = XMLoadFloat4(&offset[r * 4 + 3]);
+			for (UINT c = 0; c < 3; ++c)
+			{
+				XMVECTOR v = XMVectorMultiply(o3, P[c]);
+				v = XMVectorMultiplyAdd(o0, B[0][c], v);
+				v = XMVectorMultiplyAdd(o1, B[1][c], v);
+				F[r][c] = XMVectorMultiplyAdd(o2, B[2][c], v);
+			}
+			F[r][3] = o3;
+		}
+
+		// Pre-transpose: row c of a bone's output is column c of its final matrix,
+		// so transposing (F[0][c] .. F[3][c]) yields that row for all four bones.
+		UINT lanes = (std::min)(4u, numBones - block * 4);
+		XMFLOAT4X4* out = finalTransforms + block * 4;
+		for (UINT c = 0; c < 4; ++c)
+		{
+			XMMATRIX rows = XMMatrixTranspose(XMMATRIX(F[0][c], F[1][c], F[2][c], F[3][c]));
+			for (UINT lane = 0; lane < lanes; ++lane)
+				XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&out[lane].m[c][0]), rows.r[lane]);
+		}
+	}
+}
 
-	// Interpolate all the bones of this clip at the given time instance.
-	auto clip = m_animations.find(clipName);
-	if (clip == m_animations.end())
-		throw ref new Platform::InvalidArgumentException("No such animation data!");
-	clip->second.Interpolate(timePos, boneTransforms);
+void SkinnedData::GetFinalTransforms(const std::wstring& clipName, float timePos, std::vector<XMFLOAT4X4>& finalTransforms)const
+{
+	const AnimationClip& clip = m_clips[GetClipHandle(clipName)];
+	UINT numBones = m_boneOffsets.size();
 
-	// Premultiply by the bone offset transform to get the final transform.
 	for (UINT i = 0; i < numBones; ++i)
 	{
+		UINT cursor = 0;
 		XMMATRIX offset = XMLoadFloat4x4(&m_boneOffsets[i]);
-		XMMATRIX bone = XMLoadFloat4x4(&boneTransforms[i]);
+		XMMATRIX bone = clip.BoneAnimations[i].Interpolate(timePos, cursor);
 		// Pre-transpose
 		XMStoreFloat4x4(&finalTransforms[i], XMMatrixTranspose(XMMatrixMultiply(offset, bone)));
 	}
-}
\ No newline at end of file
+}
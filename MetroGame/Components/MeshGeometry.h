@@ -1,8 +1,9 @@
 #pragma once
 
 #include <DirectXMath.h>
-#include <ppltasks.h>
-#include "Common/ShaderMgr.h"
+#include <map>
+#include <string>
+#include <vector>
 #include "Common/LightHelper.h"
 
 enum class EffectType
@@ -41,14 +42,48 @@ namespace DXFramework
 		DirectX::XMFLOAT4 RotationQuat;
 	};
 
+	// Keyframes of a compressed clip, sampled without decompressing them. Data holds
+	// the times, rotations, translations and scales as X3dSectionId::CompressedClips
+	// stores them (see X3DLoader.h). The offsets are derived from the flags on load.
+	struct CompressedKeyframes
+	{
+		CompressedKeyframes();
+
+		static const UINT ConstantRotation = 0x1;
+		static const UINT ConstantTranslation = 0x2;
+		static const UINT ConstantScale = 0x4;
+
+		float StartTime;
+		float Duration;
+		UINT Flags;
+		UINT KeyCount;
+		DirectX::XMFLOAT3 TranslationMin;
+		DirectX::XMFLOAT3 TranslationExtent;
+		DirectX::XMFLOAT3 ScaleMin;
+		DirectX::XMFLOAT3 ScaleExtent;
+		UINT RotationOffset;
+		UINT TranslationOffset;
+		UINT ScaleOffset;
+		std::vector<USHORT> Data;
+	};
+
 	struct BoneAnimation
 	{
 		float GetStartTime()const;
 		float GetEndTime()const;
 
 		void Interpolate(float t, DirectX::XMFLOAT4X4& M)const;
-
+		// cursor is the keyframe the previous call ended on. The search starts there and
+		// only goes back to the first keyframe if t moved backwards.
+		DirectX::XMMATRIX XM_CALLCONV Interpolate(float t, UINT& cursor)const;
+		// Finds the keyframes around t and the blend factor between them. Outside the
+		// animation both keyframes are the first or the last one. Compressed keyframes
+		// are decoded into k0 and k1.
+		void FindKeyframes(float t, UINT& cursor, Keyframe& k0, Keyframe& k1, float& lerpPercent)const;
+
+		// Empty if the clip was loaded compressed.
 		std::vector<Keyframe> Keyframes;
+		CompressedKeyframes Compressed;
 	};
 
 	struct AnimationClip
@@ -61,26 +96,56 @@ namespace DXFramework
 		std::vector<BoneAnimation> BoneAnimations;
 	};
 
+	// Clip names are resolved to handles once, so playback doesn't touch strings.
+	typedef UINT ClipHandle;
+
+	// Per instance playback state. It keeps one keyframe cursor per bone, so a
+	// clip that plays forward is sampled in O(bones) without searching keyframes.
+	struct AnimationPlayback
+	{
+		AnimationPlayback() : Clip(0), TimePos(-1.0f) {}
+
+		ClipHandle Clip;
+		float TimePos;				// Negative if the animation is stopped
+		std::vector<UINT> Cursors;
+	};
+
 	class SkinnedData
 	{
 	public:
 		UINT GetBoneCount()const;
+		// Handles go from 0 to GetClipCount() - 1, in the order of the clip names.
+		UINT GetClipCount()const { return (UINT)m_clips.size(); }
 		float GetClipStartTime(const std::wstring& clipName)const;
 		float GetClipEndTime(const std::wstring& clipName)const;
+		float GetClipStartTime(ClipHandle clip)const { return m_clipStartTimes[clip]; }
+		float GetClipEndTime(ClipHandle clip)const { return m_clipEndTimes[clip]; }
+		ClipHandle GetClipHandle(const std::wstring& clipName)const;
 
 		void Initialize(
 			std::vector<DirectX::XMFLOAT4X4>& boneOffsets,
 			std::map<std::wstring, AnimationClip>& animations);
 
-		// In a real project, you'd want to cache the result if there was a chance
-		// that you were calling this several times with the same clipName at 
-		// the same timePos.
+		// Binds the playback state to a clip and sizes its cursors. This is the only
+		// place that allocates, playback itself doesn't.
+		void ResetPlayback(AnimationPlayback& playback, ClipHandle clip)const;
+
+		// Writes GetBoneCount() pre-transposed transforms. Bones are evaluated four
+		// at a time in structure-of-arrays form. Different playback states may be
+		// evaluated on different threads at the same time.
+		void GetFinalTransforms(AnimationPlayback& playback, DirectX::XMFLOAT4X4* finalTransforms)const;
 		void GetFinalTransforms(const std::wstring& clipName, float timePos,
 			std::vector<DirectX::XMFLOAT4X4>& finalTransforms)const;
 
 	private:
 		std::vector<DirectX::XMFLOAT4X4> m_boneOffsets;
-		std::map<std::wstring, AnimationClip> m_animations;
+		// Bone offsets in blocks of four bones; element [block*16 + row*4 + col]
+		// holds that matrix element of the four bones.
+		std::vector<DirectX::XMFLOAT4> m_boneOffsetsSoA;
+		std::vector<AnimationClip> m_clips;
+		std::vector<float> m_clipStartTimes;
+		std::vector<float> m_clipEndTimes;
+		std::map<std::wstring, ClipHandle> m_clipHandles;
 	};
 }
 
@@ -3,9 +3,10 @@
 #include <algorithm>
 #include <vector>
 #include "Common/DirectXHelper.h"
+#include "Common/JobSystem.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
+#include "Common/Profiler.h"
 
 using namespace DXFramework;
 using namespace Microsoft::WRL;
@@ -30,7 +31,8 @@ MeshObject::MeshObject(
 	const std::shared_ptr<DX::DeviceResources>& deviceResources,
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>>& perFrameCB,
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>>& perObjectCB)
-	: m_loadingComplete(false), m_initialized(false),
+	: m_loadingComplete(false), m_initialized(false), m_indexFormat(DXGI_FORMAT_R32_UINT),
+	m_instanced(false), m_instancesDirty(false),
 	m_deviceResources(deviceResources), m_perFrameCB(perFrameCB), m_perObjectCB(perObjectCB)
 {
 }
@@ -42,7 +44,7 @@ void MeshObject::Initialize(MeshObjectData* data, const MeshFeatureConfigure& fe
 
 #ifdef _DEBUG
 	// Data check
-	if ((m_object->Skinned && m_object->VertexDataSkinned.size() == 0))
+	if ((m_object->Skinned && m_object->GetSkinnedVertices().empty()))
 		throw ref new Platform::InvalidArgumentException("Lack necessary vertex input data!");
 	if (m_object->Worlds.size() == 0)
 		throw ref new Platform::InvalidArgumentException("Lack necessary mesh object data!");
@@ -55,14 +57,25 @@ void MeshObject::Initialize(MeshObjectData* data, const MeshFeatureConfigure& fe
 
 	if (m_object->Skinned)
 	{
-		BoundingBox::CreateFromPoints(m_boundingBox, m_object->VertexDataSkinned.size(), &m_object->VertexDataSkinned[0].Pos, sizeof(PosNormalTexTanSkinned));
+		auto vertices = m_object->GetSkinnedVertices();
+		BoundingBox::CreateFromPoints(m_boundingBox, vertices.size(), &vertices[0].Pos, sizeof(PosNormalTexTanSkinned));
 		BoundingSphere::CreateFromBoundingBox(m_boundingSphere, m_boundingBox);
 	}
 	else
 	{
-		BoundingBox::CreateFromPoints(m_boundingBox, m_object->VertexData.size(), &m_object->VertexData[0].Pos, sizeof(PosNormalTexTan));
+		auto vertices = m_object->GetVertices();
+		BoundingBox::CreateFromPoints(m_boundingBox, vertices.size(), &vertices[0].Pos, sizeof(PosNormalTexTan));
 		BoundingSphere::CreateFromBoundingBox(m_boundingSphere, m_boundingBox);
 	}
+	// Several static instances are drawn with one call per subset.
+	m_instanced = !m_object->Skinned && m_object->Worlds.size() > 1;
+	if (!m_object->Skinned && m_object->Worlds.size() >= BvhMinInstances)
+	{
+		std::vector<BoundingBox> boxes(m_object->Worlds.size());
+		for (UINT i = 0; i < boxes.size(); ++i)
+			boxes[i] = GetTransBoundingBox(i);
+		m_bvh.Build(boxes);
+	}
 
 	for (UINT i = 0; i < m_object->Material.size(); ++i)
 	{
@@ -76,13 +89,14 @@ void MeshObject::Initialize(MeshObjectData* data, const MeshFeatureConfigure& fe
 
 	if (m_object->Skinned)
 	{
-		m_timePositions.resize(m_object->Worlds.size());
-		m_timePositions.assign(m_timePositions.size(), -1.0f);
-		m_finalTransforms.resize(m_object->Worlds.size());
+		auto& skinInfo = m_object->SkinInfo;
+		UINT numBones = skinInfo.GetBoneCount();
+		m_playbacks.resize(m_object->Worlds.size());
+		m_palettes.resize(m_object->Worlds.size() * numBones);
 		for (UINT i = 0; i < m_object->Worlds.size(); ++i)
 		{
-			m_finalTransforms[i].resize(m_object->SkinInfo.GetBoneCount());
-			m_object->SkinInfo.GetFinalTransforms(m_object->ClipNames[i], 0.0f, m_finalTransforms[i]);
+			skinInfo.ResetPlayback(m_playbacks[i], skinInfo.GetClipHandle(m_object->ClipNames[i]));
+			skinInfo.GetFinalTransforms(m_playbacks[i], &m_palettes[i * numBones]);
 		}
 	}
 	
@@ -103,7 +117,7 @@ concurrency::task<void> MeshObject::CreateDeviceDependentResourcesAsync()
 
 	// Initialize constant buffer
 	if(!m_skinnedCB.GetInitalizeState())
-		m_skinnedCB.Initialize(m_deviceResources->GetD3DDevice());
+		m_skinnedCB.Initialize(m_deviceResources->GetRenderDevice());
 
 	return BuildDataAsync()
 		.then([=]()
@@ -114,6 +128,8 @@ concurrency::task<void> MeshObject::CreateDeviceDependentResourcesAsync()
 
 void MeshObject::Update(float dt)
 {
+	DX_PROFILE_ZONE("MeshObject::Update");
+
 	if (!m_initialized)
 	{
 		OutputDebugString(L"The objects haven't been initialized!");
@@ -123,371 +139,256 @@ void MeshObject::Update(float dt)
 	if (!m_object->Skinned)
 		return;
 
-	for (UINT i = 0; i < m_finalTransforms.size(); ++i)
+	// Instances only share read-only skinning data, so they are evaluated in parallel.
+	const SkinnedData& skinInfo = m_object->SkinInfo;
+	UINT numBones = skinInfo.GetBoneCount();
+	bool loop = m_feature.Loop;
+	ParallelFor(0, (UINT)m_playbacks.size(), [&](UINT i)
 	{
-		if (m_timePositions[i] < 0)
-			continue;
-		m_timePositions[i] += dt;
+		auto& playback = m_playbacks[i];
+		if (playback.TimePos < 0)
+			return;
+		playback.TimePos += dt;
 		// Loop animation
-		if (m_timePositions[i] > m_object->SkinInfo.GetClipEndTime(m_object->ClipNames[i]))
-			if (m_feature.Loop)
-				m_timePositions[i] = 0.0f;
+		if (playback.TimePos > skinInfo.GetClipEndTime(playback.Clip))
+			if (loop)
+				playback.TimePos = 0.0f;
 			else
-				m_timePositions[i] = -1.0f;
-		m_object->SkinInfo.GetFinalTransforms(m_object->ClipNames[i], m_timePositions[i], m_finalTransforms[i]);
-	}	
+				playback.TimePos = -1.0f;
+		skinInfo.GetFinalTransforms(playback, &m_palettes[i * numBones]);
+	});
+}
+
+void MeshObject::SetClipName(int i, const std::wstring& clipName)
+{
+	m_object->ClipNames[i] = clipName;
+	m_object->SkinInfo.ResetPlayback(m_playbacks[i], m_object->SkinInfo.GetClipHandle(clipName));
 }
 
-void MeshObject::Render(bool recover /* = false */)
+void MeshObject::Submit(RenderQueue& queue)
 {
-	if (!m_loadingComplete)
+	RenderPass pass = queue.GetPass();
+	if (!m_loadingComplete ||
+		(pass == RenderPass::Depth && !m_feature.Shadow) ||
+		(pass == RenderPass::NormalDepth && !m_feature.Ssao))
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
-	// Set IA stage.
-	UINT stride = m_object->Skinned ? sizeof(PosNormalTexTanSkinned) : sizeof(PosNormalTexTan);
-	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
-	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+	CullInstances();
+	if (m_visible.empty())
+		return;
+	if (m_instanced)
+		UpdateInstances(m_deviceResources->GetRenderContext());
+
+	DrawState state;
+	SetInputAssembler(state);
 
+	// Set constant buffers, srvs and samplers
 	ID3D11Buffer* cbuffers0[2] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer() };
 	ID3D11Buffer* cbuffers1[1] = { m_skinnedCB.GetBuffer() };
 	ID3D11SamplerState* samplers[2] = { renderStateMgr->LinearSam(), renderStateMgr->ShadowSam() };
-	ID3D11ShaderResourceView* srvs[3] = { m_depthMapSRV.Get(), m_ssaoMapSRV.Get(), m_reflectMapSRV.Get() };
-
-	// Set constant buffers
-	context->VSSetConstantBuffers(0, 2, cbuffers0);
+	state.SetConstantBuffers(ShaderStage::Vertex, 0, 2, cbuffers0);
 	if (m_object->Skinned)
-		context->VSSetConstantBuffers(3, 1, cbuffers1);
-	context->PSSetConstantBuffers(0, 2, cbuffers0);
-
-	// Set srvs & samplers
-	context->PSSetShaderResources(2, 3, srvs);
-	context->PSSetSamplers(0, 2, samplers);
-
-	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
+		state.SetConstantBuffers(ShaderStage::Vertex, 3, 1, cbuffers1);
+	state.SetConstantBuffers(ShaderStage::Pixel, 0, 2, cbuffers0);
+	switch (pass)
 	{
-		// Update constant buffers
-		XMMATRIX world = XMLoadFloat4x4(&m_object->Worlds[i]);
-		XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-		XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
-		XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixIdentity());
-		if (m_object->Skinned)
-		{
-			for (UINT j = 0; j < m_object->SkinInfo.GetBoneCount(); ++j)
-				m_skinnedCB.Data.BoneTransforms[j] = m_finalTransforms[i][j];
-			m_skinnedCB.ApplyChanges(context);
-		}
-
-		// Iterate over each subSet. Each subSet is corespondent to one material of the same index.
-		for (UINT j = 0; j < m_object->Subsets.size(); ++j)
-		{
-			Subset& item = m_object->Subsets[j];
-			UINT index = item.MtlIndex;
-			X3dMaterial& material = m_object->Material[index];
-			// Set material
-			m_perObjectCB->Data.Mat = material.Mat;
-			m_perObjectCB->ApplyChanges(context);
-			// Bind srv
-			ID3D11ShaderResourceView* srvs[2] = { m_diffuseMapSRV[index].Get(), m_norMapSRV[index].Get() };
-			context->PSSetShaderResources(0, 2, srvs);
-			// Bind shaders
-			if (material.Effect != EffectType::Normal)
-			{
-				if (ShaderChangement::VS != m_meshVS.Get())
-				{
-					context->VSSetShader(m_meshVS.Get(), nullptr, 0);
-					ShaderChangement::VS = m_meshVS.Get();
-				}
-			}
-			else
-			{
-				if (ShaderChangement::VS != m_meshVSNormal.Get())
-				{
-					context->VSSetShader(m_meshVSNormal.Get(), nullptr, 0);
-					ShaderChangement::VS = m_meshVSNormal.Get();
-				}
-			}
-			if (ShaderChangement::PS != m_meshPS[index].Get())
-			{
-				context->PSSetShader(m_meshPS[index].Get(), nullptr, 0);
-				ShaderChangement::PS = m_meshPS[index].Get();
-			}
-
-			if (m_feature.AlphaClip)
-			{
-				if (ShaderChangement::RSS != renderStateMgr->NoCullRS())
-				{
-					context->RSSetState(renderStateMgr->NoCullRS());
-					ShaderChangement::RSS = renderStateMgr->NoCullRS();
-				}
-			}
-			else if(ShaderChangement::RSS != nullptr)
-			{
-				context->RSSetState(nullptr);
-				ShaderChangement::RSS = nullptr;
-			}
-
-			context->DrawIndexed(item.IndexCount, item.IndexStart, item.VertexBase);
-		}
-	}
-
-	// Recovery
-	if (recover)
+	case RenderPass::Color:
 	{
-		ID3D11ShaderResourceView* nullSRV[3] = { nullptr, nullptr, nullptr };
-		context->PSSetShaderResources(2, 3, nullSRV);
-
-		if (ShaderChangement::RSS != nullptr)
-		{
-			context->RSSetState(nullptr);
-			ShaderChangement::RSS = nullptr;
-		}
+		ID3D11ShaderResourceView* srvs[3] = { m_depthMapSRV.Get(), m_ssaoMapSRV.Get(), m_reflectMapSRV.Get() };
+		state.SetShaderResources(ShaderStage::Pixel, 2, 3, srvs);
+		state.SetSamplers(ShaderStage::Pixel, 0, 2, samplers);
+		state.RasterizerState = m_feature.AlphaClip ? renderStateMgr->NoCullRS() : nullptr;
+		break;
 	}
-}
-
-void MeshObject::DepthRender(bool recover /* = false */)
-{
-	if (!m_loadingComplete || !m_feature.Shadow)
-		return;
-
-	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
-	// Set IA stage
-	UINT stride = m_object->Skinned ? sizeof(PosNormalTexTanSkinned) : sizeof(PosNormalTexTan);
-	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
+	case RenderPass::Depth:
+		state.SetSamplers(ShaderStage::Pixel, 0, 1, samplers);
+		state.SetShader(ShaderStage::Vertex, m_object->Skinned ? m_depthVSSkinned.Get() : m_depthVS.Get());
+		state.SetShader(ShaderStage::Pixel, m_feature.AlphaClip ? m_depthPSClip.Get() : nullptr);
+		state.RasterizerState = m_feature.AlphaClip ? renderStateMgr->DepthBiasNoCullRS() : renderStateMgr->DepthBiasRS();
+		break;
+	case RenderPass::NormalDepth:
+		state.SetSamplers(ShaderStage::Pixel, 0, 1, samplers);
+		state.SetShader(ShaderStage::Vertex, m_object->Skinned ? m_norDepVSSkinned.Get() : m_norDepVS.Get());
+		state.SetShader(ShaderStage::Pixel, m_feature.AlphaClip ? m_norDepPSClip.Get() : m_norDepPS.Get());
+		state.RasterizerState = m_feature.AlphaClip ? renderStateMgr->NoCullRS() : nullptr;
+		break;
 	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
-	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
-
-	ID3D11Buffer* cbuffers0[2] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer() };
-	ID3D11Buffer* cbuffers1[1] = { m_skinnedCB.GetBuffer() };
-	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
-
-	// Set constant buffers
-	context->VSSetConstantBuffers(0, 2, cbuffers0);
-	if (m_object->Skinned)
-		context->VSSetConstantBuffers(3, 1, cbuffers1);
-	context->PSSetConstantBuffers(0, 2, cbuffers0);
-
-	// Set srvs & samplers
-	context->PSSetSamplers(0, 1, samplers);
 
-	// vs
-	if (m_object->Skinned)
+	// The shaders and textures of a material, which the depth passes only sample to clip.
+	m_materialStates.assign(m_object->Material.size(), UINT_MAX);
+	auto getState = [&](UINT index) -> UINT
 	{
-		if (ShaderChangement::VS != m_depthVSSkinned.Get())
+		if (m_materialStates[index] == UINT_MAX)
 		{
-			context->VSSetShader(m_depthVSSkinned.Get(), nullptr, 0);
-			ShaderChangement::VS = m_depthVSSkinned.Get();
+			if (pass == RenderPass::Color)
+			{
+				ID3D11ShaderResourceView* srvs[2] = { m_diffuseMapSRV[index].Get(), m_norMapSRV[index].Get() };
+				state.SetShaderResources(ShaderStage::Pixel, 0, 2, srvs);
+				state.SetShader(ShaderStage::Vertex, m_object->Material[index].Effect != EffectType::Normal ? m_meshVS.Get() : m_meshVSNormal.Get());
+				state.SetShader(ShaderStage::Pixel, m_meshPS[index].Get());
+			}
+			else if (m_feature.AlphaClip)
+			{
+				state.SetShaderResources(ShaderStage::Pixel, 0, 1, m_diffuseMapSRV[index].GetAddressOf());
+			}
+			m_materialStates[index] = queue.AddState(state);
 		}
-	}
-	else
+		return m_materialStates[index];
+	};
+
+	// Instanced meshes take the worlds of the visible instances from the
+	// instance stream, so the subsets are only walked once, at the depth of
+	// the nearest instance.
+	XMVECTOR eye = XMLoadFloat3(&m_perFrameCB->Data.EyePosW);
+	float nearest = FLT_MAX;
+	if (m_instanced)
 	{
-		if (ShaderChangement::VS != m_depthVS.Get())
+		for (UINT i : m_visible)
 		{
-			context->VSSetShader(m_depthVS.Get(), nullptr, 0);
-			ShaderChangement::VS = m_depthVS.Get();
+			XMVECTOR center = XMVector3Transform(XMLoadFloat3(&m_boundingSphere.Center), XMLoadFloat4x4(&m_object->Worlds[i]));
+			nearest = (std::min)(nearest, XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(center, eye))));
 		}
 	}
-
-	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
+	UINT instanceCount = (UINT)m_visible.size();
+	UINT drawCount = m_instanced ? 1 : instanceCount;
+	UINT numBones = m_object->Skinned ? m_object->SkinInfo.GetBoneCount() : 0;
+	XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixIdentity());
+	for (UINT i = 0; i < drawCount; ++i)
 	{
 		// Set world
-		XMMATRIX world = XMLoadFloat4x4(&m_object->Worlds[i]);
-		XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-		XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
-		XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixIdentity());
-		m_perObjectCB->ApplyChanges(context);
-		if (m_object->Skinned)
+		float depth = nearest;
+		if (!m_instanced)
 		{
-			for (UINT j = 0; j < m_object->SkinInfo.GetBoneCount(); ++j)
-				m_skinnedCB.Data.BoneTransforms[j] = m_finalTransforms[i][j];
-			m_skinnedCB.ApplyChanges(context);
+			XMMATRIX world = XMLoadFloat4x4(&m_object->Worlds[m_visible[i]]);
+			XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
+			XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
+			XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
+			XMVECTOR center = XMVector3Transform(XMLoadFloat3(&m_boundingSphere.Center), world);
+			depth = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(center, eye)));
 		}
 
 		// Iterate over each subSet. Each subSet is corespondent to one material of the same index.
+		// The draws may be reordered, so every one of them carries its constants.
 		for (UINT j = 0; j < m_object->Subsets.size(); ++j)
 		{
 			Subset& item = m_object->Subsets[j];
 			UINT index = item.MtlIndex;
-			X3dMaterial& material = m_object->Material[index];
+			// Set material
+			m_perObjectCB->Data.Mat = m_object->Material[index].Mat;
+			queue.SetConstants(*m_perObjectCB);
+			if (m_object->Skinned)
+				queue.SetConstants(m_skinnedCB.GetBuffer(), &m_palettes[m_visible[i] * numBones], numBones * sizeof(XMFLOAT4X4));
 
-			if (m_feature.AlphaClip)
-			{
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[i].GetAddressOf());
-				if (ShaderChangement::PS != m_depthPSClip.Get())
-				{
-					context->PSSetShader(m_depthPSClip.Get(), nullptr, 0);
-					ShaderChangement::PS = m_depthPSClip.Get();
-				}
-				if (ShaderChangement::RSS != renderStateMgr->DepthBiasNoCullRS())
-				{
-					context->RSSetState(renderStateMgr->DepthBiasNoCullRS());
-					ShaderChangement::RSS = renderStateMgr->DepthBiasNoCullRS();
-				}
-			}
+			if (m_instanced)
+				queue.DrawIndexedInstanced(getState(index), item.IndexCount, instanceCount, item.IndexStart, item.VertexBase, depth);
 			else
-			{
-				context->PSSetShader(nullptr, nullptr, 0);
-				ShaderChangement::PS = nullptr;
-				if (ShaderChangement::RSS != renderStateMgr->DepthBiasRS())
-				{
-					context->RSSetState(renderStateMgr->DepthBiasRS());
-					ShaderChangement::RSS = renderStateMgr->DepthBiasRS();
-				}
-			}
-
-			context->DrawIndexed(item.IndexCount, item.IndexStart, item.VertexBase);
+				queue.DrawIndexed(getState(index), item.IndexCount, item.IndexStart, item.VertexBase, depth);
 		}
 	}
-
-	// Recovery
-	if (recover)
-	{
-		context->RSSetState(nullptr);
-	}
 }
 
-void MeshObject::NorDepRender(bool recover /* = false */)
+void MeshObject::CullInstances()
 {
-	if (!m_loadingComplete || !m_feature.Ssao)
+	UINT count = (UINT)m_object->Worlds.size();
+	// The animated pose may leave the bounds of the bind pose, so skinned
+	// instances are always drawn.
+	if (m_object->Skinned)
+	{
+		m_visible.resize(count);
+		for (UINT i = 0; i < count; ++i)
+			m_visible[i] = i;
 		return;
+	}
 
-	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
-	// Set IA stage.
-	UINT stride = m_object->Skinned ? sizeof(PosNormalTexTanSkinned) : sizeof(PosNormalTexTan);
-	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
+	// The per-frame buffer holds the view-projection of the current pass.
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixTranspose(XMLoadFloat4x4(&m_perFrameCB->Data.ViewProj)));
+	m_culler.SetViewProj(viewProj);
+	if (m_bvh.GetItemCount())
 	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
+		if (auto visible = m_frustumQueries.Find(viewProj))
+			m_visible = *visible;
+		else
+			m_bvh.Query(m_culler, m_visible);
 	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
+	else
+		m_culler.Cull(m_boundingSphere, m_object->Worlds.data(), count, m_visible);
+
+	// The occluders are drawn from one view, other passes keep their instances.
+	if (m_occlusionCuller && memcmp(&viewProj, &m_occlusionCuller->GetViewProj(), sizeof(viewProj)) == 0)
 	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		auto& worlds = m_object->Worlds;
+		m_visible.erase(std::remove_if(m_visible.begin(), m_visible.end(), [&](UINT i)
+		{
+			return !m_occlusionCuller->IsVisible(m_boundingBox, worlds[i]);
+		}), m_visible.end());
 	}
-	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+}
 
-	ID3D11Buffer* cbuffers0[2] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer() };
-	ID3D11Buffer* cbuffers1[1] = { m_skinnedCB.GetBuffer() };
-	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
+void MeshObject::CullFrustums(const XMFLOAT4X4* viewProjs, UINT count)
+{
+	if (m_bvh.GetItemCount())
+		m_frustumQueries.Query(m_bvh, viewProjs, count);
+}
 
-	// Set constant buffers
-	context->VSSetConstantBuffers(0, 2, cbuffers0);
+void MeshObject::RasterizeOccluder(DX::OcclusionCuller& culler)
+{
 	if (m_object->Skinned)
-		context->VSSetConstantBuffers(3, 1, cbuffers1);
-	context->PSSetConstantBuffers(0, 2, cbuffers0);
-
-	// Set srvs & samplers
-	context->PSSetSamplers(0, 1, samplers);
+		return;
 
-	// vs
-	if (m_object->Skinned)
+	auto vertices = m_object->GetVertices();
+	auto indices = m_object->GetIndices();
+	auto indices16 = m_object->GetIndices16();
+	for (auto& world : m_object->Worlds)
 	{
-		if (ShaderChangement::VS != m_norDepVSSkinned.Get())
+		for (auto& subset : m_object->Subsets)
 		{
-			context->VSSetShader(m_norDepVSSkinned.Get(), nullptr, 0);
-			ShaderChangement::VS = m_norDepVSSkinned.Get();
-		}
-	}
-	else
-	{
-		if (ShaderChangement::VS != m_norDepVS.Get())
-		{
-			context->VSSetShader(m_norDepVS.Get(), nullptr, 0);
-			ShaderChangement::VS = m_norDepVS.Get();
+			const XMFLOAT3* positions = &vertices[subset.VertexBase].Pos;
+			if (!indices16.empty())
+				culler.RasterizeOccluder(positions, sizeof(PosNormalTexTan), &indices16[subset.IndexStart], subset.IndexCount, world);
+			else
+				culler.RasterizeOccluder(positions, sizeof(PosNormalTexTan), &indices[subset.IndexStart], subset.IndexCount, world);
 		}
 	}
+}
 
-	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
-	{
-		// Set world
-		XMMATRIX world = XMLoadFloat4x4(&m_object->Worlds[i]);
-		XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-		XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
-		XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixIdentity());
-		m_perObjectCB->ApplyChanges(context);
-		if (m_object->Skinned)
-		{
-			for (UINT j = 0; j < m_object->SkinInfo.GetBoneCount(); ++j)
-				m_skinnedCB.Data.BoneTransforms[j] = m_finalTransforms[i][j];
-			m_skinnedCB.ApplyChanges(context);
-		}
-
-		// Iterate over each subSet. Each subSet is corespondent to one material of the same index.
-		for (UINT j = 0; j < m_object->Subsets.size(); ++j)
-		{
-			Subset& item = m_object->Subsets[j];
-			UINT index = item.MtlIndex;
-			X3dMaterial& material = m_object->Material[index];
-
-			if (m_feature.AlphaClip)
-			{
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[index].GetAddressOf());
-				if (ShaderChangement::PS != m_norDepPSClip.Get())
-				{
-					context->PSSetShader(m_norDepPSClip.Get(), nullptr, 0);
-					ShaderChangement::PS = m_norDepPSClip.Get();
-				}
-				if (ShaderChangement::RSS != renderStateMgr->NoCullRS())
-				{
-					context->RSSetState(renderStateMgr->NoCullRS());
-					ShaderChangement::RSS = renderStateMgr->NoCullRS();
-				}
-			}
-			else 
-			{
-				if (ShaderChangement::PS != m_norDepPS.Get())
-				{
-					context->PSSetShader(m_norDepPS.Get(), nullptr, 0);
-					ShaderChangement::PS = m_norDepPS.Get();
-				}
-				if (ShaderChangement::RSS != nullptr)
-				{
-					context->RSSetState(nullptr);
-					ShaderChangement::RSS = nullptr;
-				}
-			}
-
-			context->DrawIndexed(item.IndexCount, item.IndexStart, item.VertexBase);
-		}
-	}
+void MeshObject::SetInputAssembler(DrawState& state)
+{
+	// VB and IB, plus the instance stream of instanced meshes
+	ID3D11Buffer* vbs[2] = { m_objectVB.Get(), m_instanceVB.Get() };
+	UINT stride = m_object->Skinned ? sizeof(PosNormalTexTanSkinned) : sizeof(PosNormalTexTan);
+	UINT strides[2] = { stride, sizeof(InstanceWorld) };
+	state.InputLayout = m_inputLayout.Get();
+	state.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	state.SetVertexBuffers(m_instanced ? 2 : 1, vbs, strides);
+	state.IndexBuffer = m_objectIB.Get();
+	state.IndexFormat = m_indexFormat;
+}
 
-	if (recover && ShaderChangement::RSS != nullptr)
+void MeshObject::UpdateInstances(RenderContext* context)
+{
+	// The inverse-transposes are only computed again after SetWorld.
+	if (m_instancesDirty)
 	{
-		context->RSSetState(nullptr);
-		ShaderChangement::RSS = nullptr;
+		const auto& worlds = m_object->Worlds;
+		m_instances.resize(worlds.size());
+		for (UINT i = 0; i < worlds.size(); ++i)
+			m_instances[i].World = worlds[i];
+		MathHelper::InverseTransposeBatch(worlds.data(), worlds.size(), &m_instances[0].WorldInvTranspose, sizeof(InstanceWorld));
+		m_instancesDirty = false;
 	}
+
+	// Every pass streams its own visible instances.
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	ThrowIfFailed(context->Map(m_instanceVB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	InstanceWorld* instances = reinterpret_cast<InstanceWorld*>(mappedData.pData);
+	if (m_visible.size() == m_instances.size())
+		memcpy(instances, m_instances.data(), m_instances.size() * sizeof(InstanceWorld));
+	else
+		for (UINT i = 0; i < m_visible.size(); ++i)
+			instances[i] = m_instances[m_visible[i]];
+	context->Unmap(m_instanceVB.Get(), 0);
 }
 
 void MeshObject::ReleaseDeviceDependentResources()
@@ -497,6 +398,7 @@ void MeshObject::ReleaseDeviceDependentResources()
 	// Direct3D data resources 
 	m_objectVB.Reset();
 	m_objectIB.Reset();
+	m_instanceVB.Reset();
 	m_skinnedCB.Reset();
 
 	// Shaders
@@ -526,24 +428,29 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 	auto textureMgr = TextureMgr::Instance();
 
 	std::vector<concurrency::task<void>> CreateTasks;
-	std::vector<std::wstring> fileCache;
-	std::map<UINT, std::wstring> psAd;
-	std::map<UINT, std::wstring> diffuseAd;
-	std::map<UINT, std::wstring> normalAd;
+	std::vector<ResourceHandle> fileCache;
+	std::map<UINT, ResourceHandle> psAd;
+	std::map<UINT, ResourceHandle> diffuseAd;
+	std::map<UINT, ResourceHandle> normalAd;
 	bool cacheFlag;
 
 	// VS
-	std::wstring shaderName = L"BasicVS";
+	std::wstring shaderName = m_instanced ? L"BasicVSInstanced" : L"BasicVS";
 	InputLayoutType inputLayoutType = m_object->Skinned ? InputLayoutType::PosNormalTexTanSkinned : InputLayoutType::PosNormalTexTan;
+	if (m_instanced)
+		inputLayoutType = InputLayoutType::PosNormalTexTanInstanced;
+	size_t normalDigit = shaderName.size();
 	shaderName += L'0';
-	shaderName += L'0';
+	if (!m_instanced)
+		shaderName += L'0';
 	shaderName += m_feature.Shadow ? L'1' : L'0';
 	shaderName += m_feature.Ssao ? L'1' : L'0';
-	shaderName += m_object->Skinned ? L'1' : L'0';
+	if (!m_instanced)
+		shaderName += m_object->Skinned ? L'1' : L'0';
 	shaderName += L".cso";
 	CreateTasks.push_back(shaderMgr->GetVSAsync(shaderName, InputLayoutType::None)
 		.then([=](ID3D11VertexShader* vs) { m_meshVS = vs; }));
-	shaderName[7] = L'1';
+	shaderName[normalDigit] = L'1';
 	CreateTasks.push_back(shaderMgr->GetVSAsync(shaderName, inputLayoutType)
 		.then([=](ID3D11VertexShader* vs)
 	{ 
@@ -569,18 +476,19 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 		shaderName += L".cso";
 
 		cacheFlag = false;
+		ResourceHandle psHandle(shaderName);
 		for (auto& file : fileCache)
-			if (file == shaderName)
+			if (file == psHandle)
 			{
 				cacheFlag = true;
-				psAd[i] = shaderName;
+				psAd[i] = psHandle;
 				break;
 			}
 		if (!cacheFlag)
 		{
 			CreateTasks.push_back(shaderMgr->GetPSAsync(shaderName)
 				.then([=](ID3D11PixelShader* ps) { m_meshPS[i] = ps; }));
-			fileCache.push_back(shaderName);
+			fileCache.push_back(psHandle);
 		}
 			
 		if (material.DiffuseMap == L"" || material.DiffuseMap == L"Null")
@@ -588,11 +496,12 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 		else
 		{
 			cacheFlag = false;
+			ResourceHandle handle(material.DiffuseMap);
 			for (auto& file : fileCache)
-				if (file == material.DiffuseMap)
+				if (file == handle)
 				{
 					cacheFlag = true;
-					diffuseAd[i] = material.DiffuseMap;
+					diffuseAd[i] = handle;
 					break;
 				}
 			if(!cacheFlag)
@@ -604,7 +513,7 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 						m_deviceResources->GetD3DDeviceContext()->GenerateMips(srv);
 					m_diffuseMapSRV[i] = srv; 
 				}));
-				fileCache.push_back(material.DiffuseMap);
+				fileCache.push_back(handle);
 			}
 		}
 		if (material.NormalMap == L"" || material.NormalMap == L"Null")
@@ -612,11 +521,12 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 		else
 		{
 			cacheFlag = false;
+			ResourceHandle handle(material.NormalMap);
 			for (auto& file : fileCache)
-				if (file == material.NormalMap)
+				if (file == handle)
 				{
 					cacheFlag = true;
-					normalAd[i] = material.NormalMap;
+					normalAd[i] = handle;
 					break;
 				}
 			if (!cacheFlag)
@@ -628,7 +538,7 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 						m_deviceResources->GetD3DDeviceContext()->GenerateMips(srv);
 					m_norMapSRV[i] = srv; 
 				}));
-				fileCache.push_back(material.NormalMap);
+				fileCache.push_back(handle);
 			}
 		}
 	}
@@ -641,7 +551,7 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 			CreateTasks.push_back(shaderMgr->GetVSAsync(L"GetDepthVSSkinned.cso", InputLayoutType::None)
 				.then([=](ID3D11VertexShader* vs) { m_depthVSSkinned = vs; }));
 		}
-		CreateTasks.push_back(shaderMgr->GetVSAsync(L"GetDepthVS.cso", InputLayoutType::None)
+		CreateTasks.push_back(shaderMgr->GetVSAsync(m_instanced ? L"GetDepthVSInstanced.cso" : L"GetDepthVS.cso", InputLayoutType::None)
 			.then([=](ID3D11VertexShader* vs) { m_depthVS = vs; }));
 		CreateTasks.push_back(shaderMgr->GetPSAsync(L"GetDepthPSClip.cso")
 			.then([=](ID3D11PixelShader* ps) { m_depthPSClip = ps; }));
@@ -654,7 +564,7 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 			CreateTasks.push_back(shaderMgr->GetVSAsync(L"GetNorDepVSSkinned.cso", InputLayoutType::None)
 				.then([=](ID3D11VertexShader* vs) { m_norDepVSSkinned = vs; }));
 		}
-		CreateTasks.push_back(shaderMgr->GetVSAsync(L"GetNorDepVS.cso", InputLayoutType::None)
+		CreateTasks.push_back(shaderMgr->GetVSAsync(m_instanced ? L"GetNorDepVSInstanced.cso" : L"GetNorDepVS.cso", InputLayoutType::None)
 			.then([=](ID3D11VertexShader* vs) { m_norDepVS = vs; }));
 		CreateTasks.push_back(shaderMgr->GetPSAsync(L"GetNorDepPS.cso")
 			.then([=](ID3D11PixelShader* ps) { m_norDepPS = ps; }));
@@ -673,40 +583,69 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 	{
 		// Create cached files
 		for (auto& item : psAd)
-			m_meshPS[item.first] = shaderMgr->GetPS(item.second);
+			m_meshPS[item.first] = shaderMgr->FindPS(item.second);
 		for (auto& item : diffuseAd)
-			m_diffuseMapSRV[item.first] = textureMgr->GetTexture(item.second);
+			m_diffuseMapSRV[item.first] = textureMgr->FindTexture(item.second);
 		for (auto& item : normalAd)
-			m_norMapSRV[item.first] = textureMgr->GetTexture(item.second);
+			m_norMapSRV[item.first] = textureMgr->FindTexture(item.second);
 
 		// Create VB and IB
 		D3D11_BUFFER_DESC vbd;
 		D3D11_SUBRESOURCE_DATA vinitData;
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;
+		// The buffers are created straight from the mapped file for v2 models.
 		if (m_object->Skinned)
 		{
-			vbd.ByteWidth = sizeof(PosNormalTexTanSkinned) * m_object->VertexDataSkinned.size();
-			vinitData.pSysMem = &m_object->VertexDataSkinned[0];
+			auto vertices = m_object->GetSkinnedVertices();
+			vbd.ByteWidth = sizeof(PosNormalTexTanSkinned) * vertices.size();
+			vinitData.pSysMem = vertices.Data;
 		}
 		else
 		{
-			vbd.ByteWidth = sizeof(PosNormalTexTan) * m_object->VertexData.size();
-			vinitData.pSysMem = &m_object->VertexData[0];
+			auto vertices = m_object->GetVertices();
+			vbd.ByteWidth = sizeof(PosNormalTexTan) * vertices.size();
+			vinitData.pSysMem = vertices.Data;
 		}
 		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 		vbd.CPUAccessFlags = 0;
 		vbd.MiscFlags = 0;
-		ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_objectVB.GetAddressOf()));
+		ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_objectVB.GetAddressOf()));
 
 		D3D11_BUFFER_DESC ibd;
+		D3D11_SUBRESOURCE_DATA iinitData;
 		ibd.Usage = D3D11_USAGE_IMMUTABLE;
-		ibd.ByteWidth = sizeof(UINT) * m_object->IndexData.size();
+		auto indices16 = m_object->GetIndices16();
+		if (!indices16.empty())
+		{
+			ibd.ByteWidth = sizeof(USHORT) * indices16.size();
+			iinitData.pSysMem = indices16.Data;
+			m_indexFormat = DXGI_FORMAT_R16_UINT;
+		}
+		else
+		{
+			auto indices = m_object->GetIndices();
+			ibd.ByteWidth = sizeof(UINT) * indices.size();
+			iinitData.pSysMem = indices.Data;
+			m_indexFormat = DXGI_FORMAT_R32_UINT;
+		}
 		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 		ibd.CPUAccessFlags = 0;
 		ibd.MiscFlags = 0;
-		D3D11_SUBRESOURCE_DATA iinitData;
-		iinitData.pSysMem = &m_object->IndexData[0];
-		ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_objectIB.GetAddressOf()));
+		ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&ibd, &iinitData, m_objectIB.GetAddressOf()));
+
+		// Create instance VB
+		if (m_instanced)
+		{
+			D3D11_BUFFER_DESC instbd;
+			instbd.Usage = D3D11_USAGE_DYNAMIC;
+			instbd.ByteWidth = sizeof(InstanceWorld) * m_object->Worlds.size();
+			instbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+			instbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+			instbd.MiscFlags = 0;
+			instbd.StructureByteStride = 0;
+			ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&instbd, nullptr, m_instanceVB.GetAddressOf()));
+			m_instancesDirty = true;
+		}
 	});
 }
 
@@ -738,6 +677,17 @@ void MeshObject::UpdateNormalMapSRV(int i, ID3D11ShaderResourceView* srv)
 	m_norMapSRV[i] = srv;
 }
 
+void MeshObject::SetWorld(int i, const XMFLOAT4X4& world)
+{
+	m_object->Worlds[i] = world;
+	m_instancesDirty = true;
+	if (m_bvh.GetItemCount())
+	{
+		m_bvh.Refit(i, GetTransBoundingBox(i));
+		m_frustumQueries.Clear();
+	}
+}
+
 BoundingBox MeshObject::GetTransBoundingBox(int i)
 {
 	BoundingBox res;
@@ -750,4 +700,28 @@ BoundingSphere MeshObject::GetTransBoundingSphere(int i)
 	BoundingSphere res;
 	m_boundingSphere.Transform(res, XMLoadFloat4x4(&m_object->Worlds[i]));
 	return res;
+}
+
+bool MeshObject::Pick(FXMVECTOR origin, FXMVECTOR direction, UINT& instance, float& distance)
+{
+	if (m_bvh.GetItemCount())
+	{
+		return m_bvh.RayCast(origin, direction, instance, distance, [&](UINT i, float& t)
+		{
+			return MathHelper::IntersectRayBox(origin, direction, m_boundingBox, XMLoadFloat4x4(&m_object->Worlds[i]), t);
+		});
+	}
+
+	instance = UINT_MAX;
+	distance = FLT_MAX;
+	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
+	{
+		float t;
+		if (MathHelper::IntersectRayBox(origin, direction, m_boundingBox, XMLoadFloat4x4(&m_object->Worlds[i]), t) && t < distance)
+		{
+			instance = i;
+			distance = t;
+		}
+	}
+	return instance != UINT_MAX;
 }
\ No newline at end of file
@@ -9,7 +9,12 @@
 #include "Common/GameTimer.h"
 #include "Common/ConstantBuffer.h"
 #include "Common/DeviceResources.h"
+#include "Common/FrustumCuller.h"
+#include "Common/BoundingVolumeHierarchy.h"
+#include "Common/OcclusionCuller.h"
+#include "Common/RenderQueue.h"
 #include "MeshGeometry.h"
+#include "X3DLoader.h"
 
 
 // Support "Normal", "Reflect", "NoTexture", "Texture".
@@ -24,12 +29,33 @@ namespace DXFramework
 		std::vector<DX::PosNormalTexTanSkinned> VertexDataSkinned;
 		std::vector<UINT> IndexData;
 		std::vector<Subset> Subsets;
+		// Set for .x3d v2 files, whose vertices and indices are used straight from
+		// the mapped file instead of the vectors above.
+		std::shared_ptr<const X3dFile> Source;
 		std::vector<X3dMaterial> Material;
 		SkinnedData SkinInfo;
 
 		// Used for multi instance
 		std::vector<DirectX::XMFLOAT4X4> Worlds;
 		std::vector<std::wstring> ClipNames;
+
+		X3dSpan<DX::PosNormalTexTan> GetVertices()const
+		{
+			return Source ? Source->GetVertices() : X3dSpan<DX::PosNormalTexTan>(VertexData.data(), (UINT)VertexData.size());
+		}
+		X3dSpan<DX::PosNormalTexTanSkinned> GetSkinnedVertices()const
+		{
+			return Source ? Source->GetSkinnedVertices() : X3dSpan<DX::PosNormalTexTanSkinned>(VertexDataSkinned.data(), (UINT)VertexDataSkinned.size());
+		}
+		X3dSpan<UINT> GetIndices()const
+		{
+			return Source ? Source->GetIndices() : X3dSpan<UINT>(IndexData.data(), (UINT)IndexData.size());
+		}
+		// Used instead of GetIndices if it isn't empty.
+		X3dSpan<USHORT> GetIndices16()const
+		{
+			return Source ? Source->GetIndices16() : X3dSpan<USHORT>();
+		}
 	};
 
 	struct MeshFeatureConfigure
@@ -58,9 +84,8 @@ namespace DXFramework
 		concurrency::task<void> CreateDeviceDependentResourcesAsync();
 		void ReleaseDeviceDependentResources();
 		void Update(float dt);
-		void Render(bool recover = false);
-		void DepthRender(bool recover = false);
-		void NorDepRender(bool recover = false);
+		// Adds the draws of the visible instances for the pass of the queue.
+		void Submit(DX::RenderQueue& queue);
 
 	public:
 		void UpdateReflectMapSRV(ID3D11ShaderResourceView* srv);
@@ -69,19 +94,35 @@ namespace DXFramework
 		void UpdateDiffuseMapSRV(int i, ID3D11ShaderResourceView* srv);
 		void UpdateNormalMapSRV(int i, ID3D11ShaderResourceView* srv);
 
-		void StartAnimation(int i) { m_timePositions[i] = 0.0f; }
-		void StopAnimation(int i) { m_timePositions[i] = -1.0f; }
-		void SetWorld(int i, const DirectX::XMFLOAT4X4& world) { m_object->Worlds[i] = world; }
-		void SetClipName(int i, const std::wstring& clipName) { m_object->ClipNames[i] = clipName; m_timePositions[i] = -1.0f; }
+		void StartAnimation(int i) { m_playbacks[i].TimePos = 0.0f; }
+		void StopAnimation(int i) { m_playbacks[i].TimePos = -1.0f; }
+		// Static instances hidden behind the occluders of the culler are skipped in
+		// the passes which share its view-projection.
+		void SetOcclusionCuller(const std::shared_ptr<DX::OcclusionCuller>& culler) { m_occlusionCuller = culler; }
+		// Rasterizes all instances of a static mesh into the culler.
+		void RasterizeOccluder(DX::OcclusionCuller& culler);
+		// Culls the instances against the frustums of every pass of the frame, given
+		// by their untransposed view-projections, in one walk of the hierarchy. The
+		// passes then use these results until the next call or a SetWorld.
+		void CullFrustums(const DirectX::XMFLOAT4X4* viewProjs, UINT count);
+
+		void SetWorld(int i, const DirectX::XMFLOAT4X4& world);
+		void SetClipName(int i, const std::wstring& clipName);
 
 		DirectX::XMFLOAT4X4 GetWorld(int i) { return m_object->Worlds[i]; }
 		DirectX::BoundingBox GetOrgBoundingBox() { return m_boundingBox; }
 		DirectX::BoundingSphere GetOrgBoundingSphere() { return m_boundingSphere; }
 		DirectX::BoundingBox GetTransBoundingBox(int i);
 		DirectX::BoundingSphere GetTransBoundingSphere(int i);
+		// Finds the closest instance whose transformed bounding box the ray hits;
+		// direction must be normalized.
+		bool Pick(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, UINT& instance, float& distance);
 
 	private:
 		concurrency::task<void> BuildDataAsync();
+		void CullInstances();
+		void SetInputAssembler(DX::DrawState& state);
+		void UpdateInstances(DX::RenderContext* context);
 
 	private:
 		// Cached pointer to shared resources
@@ -94,6 +135,13 @@ namespace DXFramework
 		MeshFeatureConfigure m_feature;
 		Microsoft::WRL::ComPtr<ID3D11Buffer> m_objectVB;
 		Microsoft::WRL::ComPtr<ID3D11Buffer> m_objectIB;
+		DXGI_FORMAT m_indexFormat;
+		// Static meshes with several worlds are drawn instanced. Their worlds and
+		// inverse-transposes are streamed per instance, see InstanceWorld.
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_instanceVB;
+		std::vector<DX::InstanceWorld> m_instances;
+		bool m_instanced;
+		bool m_instancesDirty;
 		
 		static bool m_resetFlag;
 		static DX::ConstantBuffer<DX::SkinnedTransforms> m_skinnedCB;
@@ -119,8 +167,20 @@ namespace DXFramework
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_ssaoMapSRV;
 
 		// Custom data
-		std::vector<std::vector<DirectX::XMFLOAT4X4>> m_finalTransforms;
-		std::vector<float> m_timePositions;
+		// Pre-transposed bone palettes of all instances, back to back, in the
+		// layout the skinned constant buffer expects.
+		std::vector<DirectX::XMFLOAT4X4> m_palettes;
+		std::vector<AnimationPlayback> m_playbacks;
+		// The state of each material in the queue submitted to, added on first use.
+		std::vector<UINT> m_materialStates;
+		// Instances inside the frustum of the current pass. Static meshes with
+		// many instances keep them in a hierarchy, the others are tested one by one.
+		static const UINT BvhMinInstances = 16;
+		DX::FrustumCuller m_culler;
+		DX::BoundingVolumeHierarchy m_bvh;
+		DX::FrustumQueryCache m_frustumQueries;
+		std::vector<UINT> m_visible;
+		std::shared_ptr<DX::OcclusionCuller> m_occlusionCuller;
 
 		DirectX::BoundingBox m_boundingBox;
 		DirectX::BoundingSphere m_boundingSphere;
@@ -2,7 +2,6 @@
 #include "ShadowHelper.h"
 #include "Common/DirectXHelper.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
 #include "Common/GeometryGenerator.h"
 
@@ -74,12 +73,19 @@ void ShadowHelper::Update(const DirectX::XMFLOAT3& lightDirection)
 	XMStoreFloat4x4(&m_lightProj, Proj);
 }
 
+XMFLOAT4X4 ShadowHelper::GetLightViewProj()const
+{
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&m_lightView), XMLoadFloat4x4(&m_lightProj)));
+	return viewProj;
+}
+
 void ShadowHelper::Render(const std::function<void()>& DrawMap)
 {
 	if (!m_loadingComplete)
 		return;
 
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	context->RSSetViewports(1, &m_viewport);
 	// Set null render target because we are only going to draw to depth buffer.
@@ -133,7 +139,7 @@ void ShadowHelper::ReleaseDeviceDependentResources()
 
 void ShadowHelper::BuildDepthMapViews()
 {
-	ID3D11Device* device = m_deviceResources->GetD3DDevice();
+	RenderDevice* device = m_deviceResources->GetRenderDevice();
 
 	m_viewport.TopLeftX = 0.0f;
 	m_viewport.TopLeftY = 0.0f;
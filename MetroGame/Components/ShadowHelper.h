@@ -28,6 +28,8 @@ namespace DXFramework
 
 	public:
 		ID3D11ShaderResourceView* GetDepthMapSRV() { return m_depthMapSRV.Get(); }
+		// Untransposed, as Render sets it for the depth pass.
+		DirectX::XMFLOAT4X4 GetLightViewProj()const;
 
 	private:
 		void BuildDepthMapViews();
@@ -2,7 +2,6 @@
 #include "Sky.h"
 #include "Common/DirectXHelper.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
 #include "Common/GeometryGenerator.h"
 
@@ -83,21 +82,13 @@ void Sky::Render()
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Set IA stage.
 	UINT stride = sizeof(XMFLOAT3);
 	UINT offset = 0;
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
-	if (ShaderChangement::InputLayout != m_skyInputLayout.Get())
-	{
-		context->IASetInputLayout(m_skyInputLayout.Get());
-		ShaderChangement::InputLayout = m_skyInputLayout.Get();
-	}
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->IASetInputLayout(m_skyInputLayout.Get());
 	// Bind VB and IB
 	context->IASetVertexBuffers(0, 1, m_skyVB.GetAddressOf(), &stride, &offset);
 	context->IASetIndexBuffer(m_skyIB.Get(), DXGI_FORMAT_R32_UINT, 0);
@@ -107,9 +98,7 @@ void Sky::Render()
 	m_perObjectCB->ApplyChanges(context);
 
 	context->VSSetShader(m_skyVS.Get(), 0, 0);
-	ShaderChangement::VS = m_skyVS.Get();
 	context->PSSetShader(m_skyPS.Get(), 0, 0);
-	ShaderChangement::PS = m_skyPS.Get();
 	ID3D11Buffer* cbuffers[2] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer() };
 	context->VSSetConstantBuffers(0, 2, cbuffers);
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
@@ -125,7 +114,6 @@ void Sky::Render()
 	// recover render state
 	context->OMSetDepthStencilState(nullptr, 0);
 	context->RSSetState(nullptr);
-	ShaderChangement::RSS = nullptr;
 }
 
 void Sky::ReleaseDeviceDependentResources()
@@ -162,7 +150,7 @@ void Sky::BuildSkyGeometryBuffers()
 	vbd.StructureByteStride = 0;
 	D3D11_SUBRESOURCE_DATA vinitData;
 	vinitData.pSysMem = &vertices[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_skyVB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_skyVB.GetAddressOf()));
 
 	m_indexCount = sphere.Indices.size();
 
@@ -175,7 +163,7 @@ void Sky::BuildSkyGeometryBuffers()
 	ibd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA iinitData;
 	iinitData.pSysMem = &sphere.Indices[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_skyIB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&ibd, &iinitData, m_skyIB.GetAddressOf()));
 }
 
 
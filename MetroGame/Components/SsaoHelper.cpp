@@ -2,7 +2,6 @@
 #include "SsaoHelper.h"
 #include "Common/DirectXHelper.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
 #include "Common/GeometryGenerator.h"
 #include <DirectXPackedVector.h>
@@ -68,8 +67,8 @@ concurrency::task<void> SsaoHelper::CreateDeviceDependentResourcesAsync()
 	}
 
 	// Initialize constant buffer
-	m_ssaoSettingsCB.Initialize(m_deviceResources->GetD3DDevice());
-	m_texSettingsCB.Initialize(m_deviceResources->GetD3DDevice());
+	m_ssaoSettingsCB.Initialize(m_deviceResources->GetRenderDevice());
+	m_texSettingsCB.Initialize(m_deviceResources->GetRenderDevice());
 
 	auto shaderMgr = ShaderMgr::Instance();
 
@@ -105,7 +104,7 @@ void SsaoHelper::Render(const std::function<void()>& DrawMap)
 	if (!m_loadingComplete)
 		return;
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	//
 	// Get normal depth map
@@ -131,16 +130,8 @@ void SsaoHelper::Render(const std::function<void()>& DrawMap)
 	// Set IA stage
 	UINT stride = sizeof(Basic32);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
+	context->IASetInputLayout(m_inputLayout.Get());
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// Bind VB and IB
 	context->IASetVertexBuffers(0, 1, m_quadVB.GetAddressOf(), &stride, &offset);
@@ -148,9 +139,7 @@ void SsaoHelper::Render(const std::function<void()>& DrawMap)
 
 	// Bind shaders, constant buffers, srvs and samplers
 	context->VSSetShader(m_ssaoVS.Get(), nullptr, 0);
-	ShaderChangement::VS = m_ssaoVS.Get();
 	context->PSSetShader(m_ssaoPS.Get(), nullptr, 0);
-	ShaderChangement::PS = m_ssaoPS.Get();
 	ID3D11Buffer* cbuffers[2] = { m_perFrameCB->GetBuffer(), m_ssaoSettingsCB.GetBuffer() };
 	ID3D11SamplerState* samplers[2] = { renderStateMgr->LinearSam(), renderStateMgr->SsaoSam() };
 	context->VSSetConstantBuffers(0, 1, cbuffers + 1);
@@ -221,27 +210,18 @@ void SsaoHelper::BlurAmbientMap()
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Set IA stage
 	UINT stride = sizeof(Basic32);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
+	context->IASetInputLayout(m_inputLayout.Get());
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	// Bind VB and IB
 	context->IASetVertexBuffers(0, 1, m_quadVB.GetAddressOf(), &stride, &offset);
 	context->IASetIndexBuffer(m_quadIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 	// Bind vs
 	context->VSSetShader(m_BilateralBlurVS.Get(), nullptr, 0);
-	ShaderChangement::VS = m_BilateralBlurVS.Get();
 	// Set ps
 	ID3D11Buffer* cbuffers[1] = { m_texSettingsCB.GetBuffer() };
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearMipPointSam() };
@@ -268,7 +248,7 @@ void SsaoHelper::BlurAmbientMap()
 
 void SsaoHelper::BlurAmbientMap(ID3D11ShaderResourceView* inputSRV, ID3D11RenderTargetView* outputRTV, bool horzBlur)
 {
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 	ID3D11RenderTargetView* renderTargets[1] = { outputRTV };
 	context->OMSetRenderTargets(1, renderTargets, nullptr);
 	context->ClearRenderTargetView(outputRTV, Colors::Silver);
@@ -278,12 +258,10 @@ void SsaoHelper::BlurAmbientMap(ID3D11ShaderResourceView* inputSRV, ID3D11Render
 	if (horzBlur)
 	{
 		context->PSSetShader(m_BilateralBlurPSHori.Get(), nullptr, 0);
-		ShaderChangement::PS = m_BilateralBlurPSHori.Get();
 	}
 	else
 	{
 		context->PSSetShader(m_BilateralBlurPSVert.Get(), nullptr, 0);
-		ShaderChangement::PS = m_BilateralBlurPSVert.Get();
 	}
 	// Bind srv
 	ID3D11ShaderResourceView* srvs[2] = { inputSRV, m_normalDepthSRV.Get() };
@@ -334,7 +312,7 @@ void SsaoHelper::BuildFullScreenQuad()
 	vbd.StructureByteStride = 0;
 	D3D11_SUBRESOURCE_DATA vinitData;
 	vinitData.pSysMem = v;
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_quadVB.GetAddressOf()));
+	DX::ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_quadVB.GetAddressOf()));
 
 	UINT indices[6] =
 	{
@@ -351,14 +329,14 @@ void SsaoHelper::BuildFullScreenQuad()
 	D3D11_SUBRESOURCE_DATA iinitData;
 	iinitData.pSysMem = indices;
 
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_quadIB.GetAddressOf()));
+	DX::ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&ibd, &iinitData, m_quadIB.GetAddressOf()));
 }
 
 void SsaoHelper::BuildTextureViews()
 {
 	ResetTextureViews();
 
-	ID3D11Device* device = m_deviceResources->GetD3DDevice();
+	RenderDevice* device = m_deviceResources->GetRenderDevice();
 	Windows::Foundation::Size renderTargetSize = m_deviceResources->GetRenderTargetSize();
 	D3D11_TEXTURE2D_DESC texDesc;
 	texDesc.Width = lround(renderTargetSize.Width);
@@ -434,8 +412,8 @@ void SsaoHelper::BuildRandomVectorTexture()
 	initData.pSysMem = color;
 
 	ComPtr<ID3D11Texture2D> tex;
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateTexture2D(&texDesc, &initData, tex.GetAddressOf()));
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateShaderResourceView(tex.Get(), 0, m_randomVectorSRV.GetAddressOf()));
+	DX::ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateTexture2D(&texDesc, &initData, tex.GetAddressOf()));
+	DX::ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateShaderResourceView(tex.Get(), 0, m_randomVectorSRV.GetAddressOf()));
 }
 
 void SsaoHelper::BuildOffsetVectors()
@@ -2,14 +2,14 @@
 #include "Terrain.h"
 #include <algorithm>
 #include <vector>
-#include <sstream>
-#include <ppl.h>
 #include <DirectXPackedVector.h>
 #include "Common/DirectXHelper.h"
+#include "Common/FrustumCuller.h"
 #include "Common/GeometryGenerator.h"
+#include "Common/GridFilter.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
+#include "Common/Profiler.h"
 
 using namespace Microsoft::WRL;
 using namespace DXFramework;
@@ -26,7 +26,7 @@ Terrain::Terrain(
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>>& perObjectCB)
 	: m_deviceResources(deviceResources), m_perFrameCB(perFrameCB),m_perObjectCB(perObjectCB),
 	m_numPatchVertices(0), m_numPatchQuadFaces(0), m_numPatchVertRows(0), m_numPatchVertCols(0),
-	m_renderOptions(TerrainRenderOption::Light3Tex), m_initialized(false), m_loadingComplete(false)
+	m_renderOptions(TerrainRenderOption::Light3Tex), m_streamTile(UINT_MAX), m_initialized(false), m_loadingComplete(false)
 {
 	m_terrainMat.Ambient = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	m_terrainMat.Diffuse = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
@@ -34,13 +34,13 @@ Terrain::Terrain(
 	m_terrainMat.Reflect = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
 
 	++m_signatureIndex;
-	std::wostringstream wos;
-	wos << m_signatureBase << m_signatureIndex;
-	m_textureArraySignature = wos.str();
+	m_textureArrayHandle = ResourceHandle(m_signatureBase + std::to_wstring(m_signatureIndex));
 }
 
 void Terrain::Initialize(const TerrainInitInfo& initInfo)
 {
+	DX_PROFILE_ZONE("Terrain::Initialize");
+
 	m_initInfo = initInfo;
 	// Divide height map into patches such that each patch has CellsPerPatch.
 	m_numPatchVertRows = ((m_initInfo.HeightmapHeight - 1) / CellsPerPatch) + 1;
@@ -50,9 +50,9 @@ void Terrain::Initialize(const TerrainInitInfo& initInfo)
 	m_numPatchQuadFaces = (m_numPatchVertRows - 1)*(m_numPatchVertCols - 1);
 
 	LoadHeightmap();
-	Smooth();
 	CalcAllPatchBoundsY();
-	CalcAllNormal();
+	m_quadtree.Build(m_patchBoundsY, m_numPatchVertRows - 1, m_numPatchVertCols - 1, -0.5f*GetWidth(), 0.5f*GetDepth(),
+		GetWidth() / (m_numPatchVertCols - 1), GetDepth() / (m_numPatchVertRows - 1));
 
 	m_initialized = true;
 }
@@ -69,8 +69,8 @@ concurrency::task<void> Terrain::CreateDeviceDependentResourcesAsync()
 	}
 
 	// Initialize constant buffer
-	m_terrainSettingsCB.Initialize(m_deviceResources->GetD3DDevice());
-	m_frustumCB.Initialize(m_deviceResources->GetD3DDevice());
+	m_terrainSettingsCB.Initialize(m_deviceResources->GetRenderDevice());
+	m_frustumCB.Initialize(m_deviceResources->GetRenderDevice());
 	m_terrainSettingsCB.Data.MaxDist = m_initInfo.MaxDist;
 	m_terrainSettingsCB.Data.MaxTess = m_initInfo.MaxTess;
 	m_terrainSettingsCB.Data.MinDist = m_initInfo.MinDist;
@@ -79,7 +79,7 @@ concurrency::task<void> Terrain::CreateDeviceDependentResourcesAsync()
 	m_terrainSettingsCB.Data.TexelCellSpaceV = 1.0f / m_initInfo.HeightmapHeight;
 	m_terrainSettingsCB.Data.TexScale = m_initInfo.TexScale;
 	m_terrainSettingsCB.Data.WorldCellSpace = m_initInfo.CellSpacing;
-	m_terrainSettingsCB.ApplyChanges(m_deviceResources->GetD3DDeviceContext());
+	m_terrainSettingsCB.ApplyChanges(m_deviceResources->GetRenderContext());
 
 	auto shaderMgr = ShaderMgr::Instance();
 	auto textureMgr = TextureMgr::Instance();
@@ -112,7 +112,7 @@ concurrency::task<void> Terrain::CreateDeviceDependentResourcesAsync()
 	layerFilenames.push_back(m_initInfo.LayerMapFilename2);
 	layerFilenames.push_back(m_initInfo.LayerMapFilename3);
 	layerFilenames.push_back(m_initInfo.LayerMapFilename4);
-	CreateTasks.push_back(textureMgr->GetTextureArrayAsync(layerFilenames, m_textureArraySignature)
+	CreateTasks.push_back(textureMgr->GetTextureArrayAsync(layerFilenames, m_textureArrayHandle)
 		.then([=](ID3D11ShaderResourceView* srv) {m_layerMapArraySRV = srv; }));
 	CreateTasks.push_back(textureMgr->GetTextureAsync(m_initInfo.BlendMapFilename)
 		.then([=](ID3D11ShaderResourceView* srv) {m_blendMapSRV = srv; }));
@@ -131,85 +131,113 @@ concurrency::task<void> Terrain::CreateDeviceDependentResourcesAsync()
 	});
 }
 
-void Terrain::Render()
+void Terrain::Update(const XMFLOAT3& eyePos)
+{
+	DX_PROFILE_ZONE("Terrain::Update");
+
+	if (!m_tiledHeightmap.IsOpen())
+		return;
+
+	// Sample under the eye, clamped to the map.
+	float c = (eyePos.x + 0.5f*GetWidth()) / m_initInfo.CellSpacing;
+	float d = (eyePos.z - 0.5f*GetDepth()) / -m_initInfo.CellSpacing;
+	UINT row = (UINT)MathHelper::Clamp((int)d, 0, (int)m_initInfo.HeightmapHeight - 1);
+	UINT col = (UINT)MathHelper::Clamp((int)c, 0, (int)m_initInfo.HeightmapWidth - 1);
+
+	// The decoded square only moves when the eye enters another tile.
+	UINT tileSize = m_tiledHeightmap.GetTileSize();
+	UINT tile = (row / tileSize) * ((m_initInfo.HeightmapWidth + tileSize - 1) / tileSize) + col / tileSize;
+	if (tile == m_streamTile)
+		return;
+	m_streamTile = tile;
+
+	UINT radius = (UINT)(m_initInfo.MaxDist / m_initInfo.CellSpacing);
+	m_tiledHeightmap.Prefetch(row > radius ? row - radius : 0, col > radius ? col - radius : 0,
+		(std::min)(row + radius + 1, m_initInfo.HeightmapHeight), (std::min)(col + radius + 1, m_initInfo.HeightmapWidth));
+}
+
+void Terrain::Submit(RenderQueue& queue)
 {
-	if (!m_loadingComplete)
+	if (!m_loadingComplete || queue.GetPass() != RenderPass::Color)
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
-	// Set IA stage.
-	UINT stride = sizeof(PosTexBound);
-	UINT offset = 0;
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST;
-	}
-	if (ShaderChangement::InputLayout != m_terrainInputLayout.Get())
+	// Select the patches inside the frustum of the pass, nearest first.
+	XMFLOAT4X4 VP;
+	XMStoreFloat4x4(&VP, XMMatrixTranspose(XMLoadFloat4x4(&m_perFrameCB->Data.ViewProj)));
+	ExtractFrustumPlanes(m_frustumCB.Data.WorldFrustumPlanes, VP);
+	m_quadtree.Select(m_frustumCB.Data.WorldFrustumPlanes, m_perFrameCB->Data.EyePosW, m_visiblePatches);
+	if (m_visiblePatches.empty())
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	ThrowIfFailed(context->Map(m_quadPatchIB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	UINT* indices = reinterpret_cast<UINT*>(mappedData.pData);
+	for (UINT patchID : m_visiblePatches)
 	{
-		context->IASetInputLayout(m_terrainInputLayout.Get());
-		ShaderChangement::InputLayout = m_terrainInputLayout.Get();
+		UINT i = patchID / (m_numPatchVertCols - 1);
+		UINT j = patchID % (m_numPatchVertCols - 1);
+		indices[0] = i*m_numPatchVertCols + j;
+		indices[1] = i*m_numPatchVertCols + j + 1;
+		indices[2] = (i + 1)*m_numPatchVertCols + j;
+		indices[3] = (i + 1)*m_numPatchVertCols + j + 1;
+		indices += 4;
 	}
-	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_quadPatchVB.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_quadPatchIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+	context->Unmap(m_quadPatchIB.Get(), 0);
 
-	// Bind shaders, constant buffers, srvs and samplers
+	// Set IA stage.
+	DrawState state;
+	UINT stride = sizeof(PosTexBound);
+	state.InputLayout = m_terrainInputLayout.Get();
+	state.Topology = D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST;
+	state.SetVertexBuffers(1, m_quadPatchVB.GetAddressOf(), &stride);
+	state.IndexBuffer = m_quadPatchIB.Get();
+	state.IndexFormat = DXGI_FORMAT_R32_UINT;
+
+	// Set shaders, constant buffers, srvs and samplers
 	ID3D11Buffer* cbuffers0[3] = { m_perFrameCB->GetBuffer(), m_terrainSettingsCB.GetBuffer(), m_frustumCB.GetBuffer() };
 	ID3D11Buffer* cbuffers1[3] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer(), m_terrainSettingsCB.GetBuffer() };
 	ID3D11SamplerState* samplers[2] = { renderStateMgr->LinearMipPointSam(), renderStateMgr->LinearSam() };
-	// Update constant buffer.
-	m_perObjectCB->Data.Mat = m_terrainMat;
-	m_perObjectCB->ApplyChanges(context);
-	XMFLOAT4X4 VP;		
-	XMStoreFloat4x4(&VP, XMMatrixTranspose(XMLoadFloat4x4(&m_perFrameCB->Data.ViewProj)));
-	ExtractFrustumPlanes(m_frustumCB.Data.WorldFrustumPlanes, VP);
-	m_frustumCB.ApplyChanges(context);
 	// vs
-	context->VSSetShader(m_terrainVS.Get(), 0, 0);
-	ShaderChangement::VS = m_terrainVS.Get();
-	context->VSSetSamplers(0, 1, samplers);
-	context->VSSetShaderResources(0, 1, m_heightMapSRV.GetAddressOf());
+	state.SetShader(ShaderStage::Vertex, m_terrainVS.Get());
+	state.SetSamplers(ShaderStage::Vertex, 0, 1, samplers);
+	state.SetShaderResources(ShaderStage::Vertex, 0, 1, m_heightMapSRV.GetAddressOf());
 	// hs
-	context->HSSetShader(m_terrainHS.Get(), 0, 0);
-	context->HSSetConstantBuffers(0, 3, cbuffers0);
+	state.SetShader(ShaderStage::Hull, m_terrainHS.Get());
+	state.SetConstantBuffers(ShaderStage::Hull, 0, 3, cbuffers0);
 	// ds
-	context->DSSetShader(m_terrainDS.Get(), 0, 0);
-	context->DSSetConstantBuffers(0, 2, cbuffers0);
-	context->DSSetSamplers(0, 1, samplers);
-	context->DSSetShaderResources(0, 1, m_heightMapSRV.GetAddressOf());
+	state.SetShader(ShaderStage::Domain, m_terrainDS.Get());
+	state.SetConstantBuffers(ShaderStage::Domain, 0, 2, cbuffers0);
+	state.SetSamplers(ShaderStage::Domain, 0, 1, samplers);
+	state.SetShaderResources(ShaderStage::Domain, 0, 1, m_heightMapSRV.GetAddressOf());
 	// ps
 	switch (m_renderOptions)
 	{
 	case TerrainRenderOption::Light3:		// Light
-		context->PSSetShader(m_terrainLight3PS.Get(), 0, 0);
-		ShaderChangement::PS = m_terrainLight3PS.Get();
+		state.SetShader(ShaderStage::Pixel, m_terrainLight3PS.Get());
 		break;
 	case TerrainRenderOption::Light3Tex:		// LightTex
-		context->PSSetShader(m_terrainLight3TexPS.Get(), 0, 0);
-		ShaderChangement::PS = m_terrainLight3TexPS.Get();
+		state.SetShader(ShaderStage::Pixel, m_terrainLight3TexPS.Get());
 		break;
 	case TerrainRenderOption::Light3TexFog:		// LightTexFog
-		context->PSSetShader(m_terrainLight3TexFogPS.Get(), 0, 0);
-		ShaderChangement::PS = m_terrainLight3TexFogPS.Get();
+		state.SetShader(ShaderStage::Pixel, m_terrainLight3TexFogPS.Get());
 		break;
 	default:
 		throw ref new Platform::InvalidArgumentException("No such render option");
 	}
-	context->PSSetConstantBuffers(0, 3, cbuffers1);
-	context->PSSetSamplers(0, 2, samplers);
+	state.SetConstantBuffers(ShaderStage::Pixel, 0, 3, cbuffers1);
+	state.SetSamplers(ShaderStage::Pixel, 0, 2, samplers);
 	ID3D11ShaderResourceView* srvs[] = { m_layerMapArraySRV.Get(), m_blendMapSRV.Get(), m_heightMapSRV.Get() };
-	context->PSSetShaderResources(0, 3, srvs);
+	state.SetShaderResources(ShaderStage::Pixel, 0, 3, srvs);
 
-	context->DrawIndexed(m_numPatchQuadFaces * 4, 0, 0);
+	// Set constant buffers
+	m_perObjectCB->Data.Mat = m_terrainMat;
+	queue.SetConstants(*m_perObjectCB);
+	queue.SetConstants(m_frustumCB);
 
-	// Clear
-	context->HSSetShader(nullptr, 0, 0);
-	context->DSSetShader(nullptr, 0, 0);
-	ShaderChangement::DS = nullptr;
-	ShaderChangement::HS = nullptr;
+	queue.DrawIndexed(queue.AddState(state), (UINT)m_visiblePatches.size() * 4, 0, 0);
 }
 
 void Terrain::ReleaseDeviceDependentResources()
@@ -277,7 +305,7 @@ void Terrain::BuildQuadPatchVB()
 	vbd.StructureByteStride = 0;
 	D3D11_SUBRESOURCE_DATA vinitData;
 	vinitData.pSysMem = &patchVertices[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_quadPatchVB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_quadPatchVB.GetAddressOf()));
 }
 
 void Terrain::BuildQuadPatchIB()
@@ -302,16 +330,17 @@ void Terrain::BuildQuadPatchIB()
 		}
 	}
 
+	// Render rewrites it with the visible patches every pass.
 	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
+	ibd.Usage = D3D11_USAGE_DYNAMIC;
 	ibd.ByteWidth = sizeof(UINT) * indices.size();
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibd.CPUAccessFlags = 0;
+	ibd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	ibd.MiscFlags = 0;
 	ibd.StructureByteStride = 0;
 	D3D11_SUBRESOURCE_DATA iinitData;
 	iinitData.pSysMem = &indices[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_quadPatchIB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&ibd, &iinitData, m_quadPatchIB.GetAddressOf()));
 }
 
 void Terrain::BuildHeightmapSRV()
@@ -330,248 +359,90 @@ void Terrain::BuildHeightmapSRV()
 	texDesc.MiscFlags = 0;
 
 	// HALF is defined in DirectXPackedVector.h, for storing 16-bit float.
-	std::vector<HALF> hmap(m_heightmap.size());
-	std::transform(m_heightmap.begin(), m_heightmap.end(), hmap.begin(), XMConvertFloatToHalf);
+	std::vector<HALF> hmap(size_t(m_initInfo.HeightmapWidth) * m_initInfo.HeightmapHeight);
+	if (m_tiledHeightmap.IsOpen())
+	{
+		// Row by row straight from the file, so the tile cache is left alone.
+		std::vector<float> row(m_initInfo.HeightmapWidth);
+		for (UINT i = 0; i < m_initInfo.HeightmapHeight; ++i)
+		{
+			m_tiledHeightmap.ReadRow(i, row.data());
+			std::transform(row.begin(), row.end(), hmap.begin() + size_t(i) * m_initInfo.HeightmapWidth, XMConvertFloatToHalf);
+		}
+	}
+	else
+	{
+		const std::vector<float>& heightmap = m_heightfield.GetSamples();
+		std::transform(heightmap.begin(), heightmap.end(), hmap.begin(), XMConvertFloatToHalf);
+	}
 	D3D11_SUBRESOURCE_DATA data;
 	data.pSysMem = &hmap[0];
 	data.SysMemPitch = m_initInfo.HeightmapWidth*sizeof(HALF);
 	data.SysMemSlicePitch = 0;
 
 	ComPtr<ID3D11Texture2D> hmapTex;
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateTexture2D(&texDesc, &data, hmapTex.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateTexture2D(&texDesc, &data, hmapTex.GetAddressOf()));
 
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
 	srvDesc.Format = texDesc.Format;
 	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.MipLevels = -1;
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateShaderResourceView(hmapTex.Get(), &srvDesc, m_heightMapSRV.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateShaderResourceView(hmapTex.Get(), &srvDesc, m_heightMapSRV.GetAddressOf()));
 }
 
 void Terrain::LoadHeightmap()
 {
+	DX_PROFILE_ZONE("Terrain::LoadHeightmap");
+
+	if (m_tiledHeightmap.Open(m_initInfo.HeightMapFilename))
+	{
+		if (m_tiledHeightmap.GetWidth() != m_initInfo.HeightmapWidth || m_tiledHeightmap.GetHeight() != m_initInfo.HeightmapHeight)
+			throw ref new Platform::InvalidArgumentException("Terrain initialize data doesn't match the height map provided.");
+
+		// Enough tiles for the square Update keeps around the eye.
+		UINT tileSize = m_tiledHeightmap.GetTileSize();
+		UINT tiles = 2 * (UINT)(m_initInfo.MaxDist / m_initInfo.CellSpacing) / tileSize + 2;
+		m_tiledHeightmap.SetCacheTiles((std::max)(tiles * tiles, TiledHeightmapCacheTiles));
+		m_heightfield.Initialize(m_tiledHeightmap, m_initInfo.CellSpacing);
+		return;
+	}
+
 	// Read binary data
 	std::shared_ptr<std::vector<byte>> heightData = ReadData(m_initInfo.HeightMapFilename);
 
 	if (heightData->size() != m_initInfo.HeightmapHeight * m_initInfo.HeightmapWidth)
 		throw ref new Platform::InvalidArgumentException("Terrain initialize data doesn't match the height map provided.");
 	// Copy the array data into a float array and scale it.
-	m_heightmap.resize(m_initInfo.HeightmapHeight * m_initInfo.HeightmapWidth, 0);
+	std::vector<float> heightmap(m_initInfo.HeightmapHeight * m_initInfo.HeightmapWidth, 0);
 	for (UINT i = 0; i < m_initInfo.HeightmapHeight * m_initInfo.HeightmapWidth; ++i)
 	{
-		m_heightmap[i] = ((*heightData)[i] / 255.0f)*m_initInfo.HeightScale;
+		heightmap[i] = ((*heightData)[i] / 255.0f)*m_initInfo.HeightScale;
 	}
+	Smooth(heightmap);
+	m_heightfield.Initialize(std::move(heightmap), m_initInfo.HeightmapWidth, m_initInfo.HeightmapHeight, m_initInfo.CellSpacing);
 }
 
-void Terrain::Smooth()
-{
-	std::vector<float> dest(m_heightmap.size());
-	// Speed up
-	concurrency::parallel_for(UINT(0), m_initInfo.HeightmapHeight, [&](UINT i)
-	{
-		for (UINT j = 0; j < m_initInfo.HeightmapWidth; ++j)
-		{
-			dest[i*m_initInfo.HeightmapWidth + j] = Average(i, j);
-		}
-	});
-
-	// Replace the old height map with the filtered one.
-	m_heightmap = dest;
-}
-
-bool Terrain::InBounds(int i, int j)
-{
-	// True if ij are valid indices; false otherwise.
-	return
-		i >= 0 && i < (int)m_initInfo.HeightmapHeight &&
-		j >= 0 && j < (int)m_initInfo.HeightmapWidth;
-}
-
-float Terrain::Average(int i, int j)
+void Terrain::Smooth(std::vector<float>& heights)
 {
-	// Function computes the average height of the ij element.
-	// It averages itself with its eight neighbor pixels.  Note
-	// that if a pixel is missing neighbor, we just don't include it
-	// in the average--that is, edge pixels don't have a neighbor pixel.
-	//
-	// ----------
-	// | 1| 2| 3|
-	// ----------
-	// |4 |ij| 6|
-	// ----------
-	// | 7| 8| 9|
-	// ----------
-
-	float avg = 0.0f;
-	float num = 0.0f;
-
-	// Use int to allow negatives.  If we use UINT, @ i=0, m=i-1=UINT_MAX
-	// and no iterations of the outer for loop occur.
-	for (int m = i - 1; m <= i + 1; ++m)
-	{
-		for (int n = j - 1; n <= j + 1; ++n)
-		{
-			if (InBounds(m, n))
-			{
-				avg += m_heightmap[m*m_initInfo.HeightmapWidth + n];
-				num += 1.0f;
-			}
-		}
-	}
+	DX_PROFILE_ZONE("Terrain::Smooth");
 
-	return avg / num;
+	GridFilter filter(m_initInfo.SmoothFilter, m_initInfo.SmoothRadius, m_initInfo.SmoothPasses);
+	filter.Apply(heights.data(), m_initInfo.HeightmapWidth, m_initInfo.HeightmapHeight);
 }
 
 void Terrain::CalcAllPatchBoundsY()
 {
+	// Every patch is a block of the heightfield's pyramid.
 	m_patchBoundsY.resize(m_numPatchQuadFaces);
-
-	// Speed up for each patch
-	concurrency::parallel_for(UINT(0), m_numPatchVertRows - 1, [&](UINT i)
+	const std::vector<XMFLOAT2>& bounds = m_heightfield.GetBoundsY(TerrainHeightfield::PatchLevel);
+	UINT cols = m_heightfield.GetBlockCounts(TerrainHeightfield::PatchLevel).x;
+	for (UINT i = 0; i < m_numPatchVertRows - 1; ++i)
 	{
 		for (UINT j = 0; j < m_numPatchVertCols - 1; ++j)
 		{
-			CalcPatchBoundsY(i, j);
-		}
-	});
-}
-
-void Terrain::CalcPatchBoundsY(UINT i, UINT j)
-{
-	// Scan the height map values this patch covers and compute the min/max height.
-
-	UINT x0 = j*CellsPerPatch;
-	UINT x1 = (j + 1)*CellsPerPatch;
-
-	UINT y0 = i*CellsPerPatch;
-	UINT y1 = (i + 1)*CellsPerPatch;
-
-	float minY = +MathHelper::Infinity;
-	float maxY = -MathHelper::Infinity;
-	for (UINT y = y0; y <= y1; ++y)
-	{
-		for (UINT x = x0; x <= x1; ++x)
-		{
-			UINT k = y*m_initInfo.HeightmapWidth + x;
-			minY = MathHelper::Min(minY, m_heightmap[k]);
-			maxY = MathHelper::Max(maxY, m_heightmap[k]);
+			m_patchBoundsY[i*(m_numPatchVertCols - 1) + j] = bounds[i*cols + j];
 		}
 	}
-
-	UINT patchID = i*(m_numPatchVertCols - 1) + j;
-	m_patchBoundsY[patchID] = XMFLOAT2(minY, maxY);
 }
 
-void Terrain::CalcAllNormal()
-{
-	m_normal.resize(m_heightmap.size());
-
-	// Speed up
-	concurrency::parallel_for(UINT(0), m_initInfo.HeightmapHeight, [&](UINT i)
-	{
-		for (UINT j = 0; j < m_initInfo.HeightmapWidth; ++j)
-		{
-			CalcNormal(i, j);
-		}
-	});
-}
-
-void Terrain::CalcNormal(UINT i, UINT j)
-{
-	//
-	// Estimate normal and tangent using central differences.
-	//
-
-	// do clamp
-	float leftY = m_heightmap[i*m_initInfo.HeightmapWidth + (j == 0 ? 0 : j - 1)];
-	float rightY = m_heightmap[i*m_initInfo.HeightmapWidth + min(j + 1, m_initInfo.HeightmapWidth - 1)];
-	float bottomY = m_heightmap[min((i + 1), m_initInfo.HeightmapHeight - 1)*m_initInfo.HeightmapWidth + j];
-	float topY = m_heightmap[(i == 0 ? 0 : i - 1)*m_initInfo.HeightmapWidth + j];
-
-	XMVECTOR tangent = XMVector3Normalize(XMVectorSet(2.0f*m_initInfo.CellSpacing, rightY - leftY, 0.0f, 0.0f));
-	XMVECTOR bitan = XMVector3Normalize(XMVectorSet(0.0f, bottomY - topY, -2.0f*m_initInfo.CellSpacing, 0.0f));
-	XMVECTOR normal = XMVector3Cross(tangent, bitan);
-	
-	UINT normalID = i*m_initInfo.HeightmapWidth + j;
-	XMStoreFloat3(&m_normal[normalID], normal);
-}
-
-float Terrain::GetHeight(float x, float z)const
-{
-	// Transform from terrain local space to "cell" space.
-	float c = (x + 0.5f*GetWidth()) / m_initInfo.CellSpacing;
-	float d = (z - 0.5f*GetDepth()) / -m_initInfo.CellSpacing;
-
-	// Get the row and column we are in.
-	int row = (int)floorf(d);
-	int col = (int)floorf(c);
-
-	// Grab the heights of the cell we are in.
-	// A*--*B
-	//  | /|
-	//  |/ |
-	// C*--*D
-	float A = m_heightmap[row*m_initInfo.HeightmapWidth + col];
-	float B = m_heightmap[row*m_initInfo.HeightmapWidth + col + 1];
-	float C = m_heightmap[(row + 1)*m_initInfo.HeightmapWidth + col];
-	float D = m_heightmap[(row + 1)*m_initInfo.HeightmapWidth + col + 1];
-
-	// Where we are relative to the cell.
-	float s = c - (float)col;
-	float t = d - (float)row;
-
-	// If upper triangle ABC.
-	if (s + t <= 1.0f)
-	{
-		float uy = B - A;
-		float vy = C - A;
-		return A + s*uy + t*vy;
-	}
-	else // lower triangle DCB.
-	{
-		float uy = C - D;
-		float vy = B - D;
-		return D + (1.0f - s)*uy + (1.0f - t)*vy;
-	}
-}
-
-XMVECTOR Terrain::GetNormal(float x, float z)const
-{
-	// Transform from terrain local space to "cell" space.
-	float c = (x + 0.5f*GetWidth()) / m_initInfo.CellSpacing;
-	float d = (z - 0.5f*GetDepth()) / -m_initInfo.CellSpacing;
-
-	// Get the row and column we are in.
-	int row = (int)floorf(d);
-	int col = (int)floorf(c);
-
-	// Grab the heights of the cell we are in.
-	// A*--*B
-	//  | /|
-	//  |/ |
-	// C*--*D
-	XMVECTOR NA = XMLoadFloat3(&m_normal[row*m_initInfo.HeightmapWidth + col]);
-	XMVECTOR NB = XMLoadFloat3(&m_normal[row*m_initInfo.HeightmapWidth + col + 1]);
-	XMVECTOR NC = XMLoadFloat3(&m_normal[(row + 1)*m_initInfo.HeightmapWidth + col]);
-	XMVECTOR ND = XMLoadFloat3(&m_normal[(row + 1)*m_initInfo.HeightmapWidth + col + 1]);
-
-	// Where we are relative to the cell.
-	float s = c - (float)col;
-	float t = d - (float)row;
-
-	// If upper triangle ABC.
-	if (s + t <= 1.0f)
-	{
-		XMVECTOR uy = NB - NA;
-		XMVECTOR vy = NC - NA;
-		return XMVector3Normalize(NA + s*uy + t*vy);
-	}
-	else // lower triangle DCB.
-	{
-		XMVECTOR uy = NC - ND;
-		XMVECTOR vy = NB - ND;
-		return XMVector3Normalize(ND + (1.0f - s)*uy + (1.0f - t)*vy);
-	}
-}
-
-
@@ -7,9 +7,18 @@
 #include "Common/GameTimer.h"
 #include "Common/ConstantBuffer.h"
 #include "Common/DeviceResources.h"
+#include "Common/RenderQueue.h"
+#include "Common/GridFilter.h"
+#include "TerrainHeightfield.h"
+#include "TerrainQuadtree.h"
+#include "TiledHeightmap.h"
 
 // Using height-map method to simulate a terrain. The terrain data is directly
 // set in the world coordinates.
+// HeightMapFilename is either an 8-bit RAW file, which is kept in memory, or a
+// tiled .tht file, which stays memory mapped and is paged in around the eye by
+// Update. Tiled files are smoothed by the converter and their normals are
+// computed when queried.
 
 namespace DXFramework
 {
@@ -23,7 +32,8 @@ namespace DXFramework
 	struct TerrainInitInfo
 	{
 		TerrainInitInfo() : HeightScale(10.0f), HeightmapWidth(0), HeightmapHeight(0),
-			CellSpacing(0.5f), MaxDist(500.0f), MaxTess(6.0f), MinDist(20.0f), MinTess(0.0f)
+			CellSpacing(0.5f), SmoothFilter(DX::GridFilterType::Box), SmoothRadius(1), SmoothPasses(1),
+			MaxDist(500.0f), MaxTess(6.0f), MinDist(20.0f), MinTess(0.0f)
 		{
 			TexScale = DirectX::XMFLOAT2(50.0f, 50.0f);
 		}
@@ -39,6 +49,11 @@ namespace DXFramework
 		UINT HeightmapWidth;	// Vertices number
 		UINT HeightmapHeight;	// Vertices number
 		float CellSpacing;
+		// Filter of a RAW height map, a radius or pass count of 0 turns it off.
+		// Tiled height maps are smoothed by their converter.
+		DX::GridFilterType SmoothFilter;
+		UINT SmoothRadius;
+		UINT SmoothPasses;
 
 		DirectX::XMFLOAT2 TexScale;
 
@@ -62,7 +77,10 @@ namespace DXFramework
 		void Initialize(const TerrainInitInfo& initInfo);
 		concurrency::task<void> CreateDeviceDependentResourcesAsync();
 		void ReleaseDeviceDependentResources();
-		void Render();
+		// Keeps the tiles around eyePos decoded, only needed by tiled heightmaps.
+		void Update(const DirectX::XMFLOAT3& eyePos);
+		// Adds the draw for the color pass of the queue.
+		void Submit(DX::RenderQueue& queue);
 
 	public:
 		// Configure functions
@@ -71,19 +89,33 @@ namespace DXFramework
 
 		float GetWidth()const{ return (m_initInfo.HeightmapWidth - 1)*m_initInfo.CellSpacing; }
 		float GetDepth()const{ return (m_initInfo.HeightmapHeight - 1)*m_initInfo.CellSpacing; }
-		std::wstring GetTextureArraySignature() { return m_textureArraySignature; };
-		float GetHeight(float x, float z)const;
-		DirectX::XMVECTOR GetNormal(float x, float z)const;
+		DX::ResourceHandle GetTextureArrayHandle() { return m_textureArrayHandle; };
+		// The CPU queries, see TerrainHeightfield.
+		const TerrainHeightfield& GetHeightfield()const { return m_heightfield; }
+		float GetHeight(float x, float z)const { return m_heightfield.GetHeight(x, z); }
+		DirectX::XMVECTOR GetNormal(float x, float z)const { return m_heightfield.GetNormal(x, z); }
+		void GetHeights(const DirectX::XMFLOAT2* points, UINT count, float* heights)const
+		{
+			m_heightfield.GetHeights(points, count, heights);
+		}
+		void GetNormals(const DirectX::XMFLOAT2* points, UINT count, DirectX::XMFLOAT3* normals)const
+		{
+			m_heightfield.GetNormals(points, count, normals);
+		}
+		bool RayCast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, TerrainHit& hit)const
+		{
+			return m_heightfield.RayCast(origin, direction, maxDistance, hit);
+		}
+		void RayCasts(const DirectX::XMFLOAT3* origins, const DirectX::XMFLOAT3* directions, UINT count,
+			float maxDistance, TerrainHit* hits)const
+		{
+			m_heightfield.RayCasts(origins, directions, count, maxDistance, hits);
+		}
 		
 	private:
 		void LoadHeightmap();
-		void Smooth();
-		bool InBounds(int i, int j);
-		float Average(int i, int j);
+		void Smooth(std::vector<float>& heights);
 		void CalcAllPatchBoundsY();
-		void CalcPatchBoundsY(UINT i, UINT j);
-		void CalcAllNormal();
-		void CalcNormal(UINT i, UINT j);
 		void BuildQuadPatchVB();
 		void BuildQuadPatchIB();
 		void BuildHeightmapSRV();
@@ -142,7 +174,7 @@ namespace DXFramework
 		// Divide heightmap into patches such that each patch has CellsPerPatch cells
 		// and CellsPerPatch+1 vertices.  Use 64 so that if we tessellate all the way 
 		// to 64, we use all the data from the heightmap.  
-		static const int CellsPerPatch = 64;
+		static const int CellsPerPatch = 1 << TerrainHeightfield::PatchLevel;
 		TerrainInitInfo m_initInfo;
 		UINT m_numPatchVertices;
 		UINT m_numPatchQuadFaces;
@@ -152,10 +184,16 @@ namespace DXFramework
 
 		TerrainRenderOption m_renderOptions;
 		std::vector<DirectX::XMFLOAT2> m_patchBoundsY;
-		std::vector<DirectX::XMFLOAT3> m_normal;
-		std::vector<float> m_heightmap;
+		// Only the patches inside the frustum of the pass are written to the
+		// dynamic index buffer.
+		TerrainQuadtree m_quadtree;
+		std::vector<UINT> m_visiblePatches;
+		TerrainHeightfield m_heightfield;
+		// The heightfield reads it when the height map is tiled.
+		TiledHeightmap m_tiledHeightmap;
+		UINT m_streamTile;
 		const std::wstring m_signatureBase = L"TerrainLayerTextureArray";
-		std::wstring m_textureArraySignature;
+		DX::ResourceHandle m_textureArrayHandle;
 		static int m_signatureIndex;
 
 		bool m_initialized;
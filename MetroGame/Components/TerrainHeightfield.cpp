@@ -0,0 +1,563 @@
+#include "TerrainHeightfield.h"
+#include <algorithm>
+#include <float.h>
+#include "Common/JobSystem.h"
+#include "Common/MathHelper.h"
+#include "Common/Profiler.h"
+
+using namespace DXFramework;
+using namespace DirectX;
+using namespace DX;
+
+TerrainHeightfield::TerrainHeightfield() :
+	m_width(0), m_height(0), m_cellSpacing(0.0f), m_tiledHeightmap(nullptr)
+{
+}
+
+void TerrainHeightfield::Initialize(std::vector<float> samples, UINT width, UINT height, float cellSpacing)
+{
+	m_heightmap = std::move(samples);
+	m_width = width;
+	m_height = height;
+	m_cellSpacing = cellSpacing;
+	m_tiledHeightmap = nullptr;
+	BuildHeightBounds();
+	CalcAllNormal();
+}
+
+void TerrainHeightfield::Initialize(const TiledHeightmap& tiledHeightmap, float cellSpacing)
+{
+	m_heightmap.clear();
+	m_normal.clear();
+	m_width = tiledHeightmap.GetWidth();
+	m_height = tiledHeightmap.GetHeight();
+	m_cellSpacing = cellSpacing;
+	m_tiledHeightmap = &tiledHeightmap;
+	BuildHeightBounds();
+}
+
+void TerrainHeightfield::BuildHeightBounds()
+{
+	DX_PROFILE_ZONE("TerrainHeightfield::BuildHeightBounds");
+
+	m_heightBounds.clear();
+	m_heightBoundsSizes.clear();
+	UINT cols = m_width - 1, rows = m_height - 1;
+	for (UINT level = 0; ; ++level)
+	{
+		UINT size = 1u << level;
+		m_heightBoundsSizes.push_back(XMUINT2((cols + size - 1) / size, (rows + size - 1) / size));
+		if (m_heightBoundsSizes.back().x == 1 && m_heightBoundsSizes.back().y == 1 && level >= PatchLevel)
+			break;
+	}
+	m_heightBounds.resize(m_heightBoundsSizes.size());
+
+	// The finest level, from the samples or from the tile bounds.
+	UINT base = m_tiledHeightmap ? PatchLevel : 0;
+	XMUINT2 baseSize = m_heightBoundsSizes[base];
+	std::vector<XMFLOAT2>& bounds = m_heightBounds[base];
+	UINT blockSize = 1u << PatchLevel;
+	bounds.resize(baseSize.x * baseSize.y);
+	ParallelFor(0, baseSize.y, [&](UINT i)
+	{
+		for (UINT j = 0; j < baseSize.x; ++j)
+		{
+			if (m_tiledHeightmap)
+			{
+				bounds[i*baseSize.x + j] = m_tiledHeightmap->GetBoundsY(i*blockSize, j*blockSize,
+					(std::min)((i + 1)*blockSize, rows), (std::min)((j + 1)*blockSize, cols));
+				continue;
+			}
+			const float* cell = &m_heightmap[i*m_width + j];
+			float a = cell[0], b = cell[1];
+			float c = cell[m_width], d = cell[m_width + 1];
+			bounds[i*baseSize.x + j] = XMFLOAT2(MathHelper::Min(MathHelper::Min(a, b), MathHelper::Min(c, d)),
+				MathHelper::Max(MathHelper::Max(a, b), MathHelper::Max(c, d)));
+		}
+	});
+
+	// Every further level merges 2x2 blocks of the previous one.
+	for (size_t level = base + 1; level < m_heightBounds.size(); ++level)
+	{
+		const std::vector<XMFLOAT2>& src = m_heightBounds[level - 1];
+		std::vector<XMFLOAT2>& dest = m_heightBounds[level];
+		XMUINT2 srcSize = m_heightBoundsSizes[level - 1], size = m_heightBoundsSizes[level];
+		dest.resize(size.x * size.y);
+		for (UINT i = 0; i < size.y; ++i)
+		{
+			UINT i0 = 2 * i, i1 = (std::min)(2 * i + 1, srcSize.y - 1);
+			for (UINT j = 0; j < size.x; ++j)
+			{
+				UINT j0 = 2 * j, j1 = (std::min)(2 * j + 1, srcSize.x - 1);
+				const XMFLOAT2& a = src[i0*srcSize.x + j0];
+				const XMFLOAT2& b = src[i0*srcSize.x + j1];
+				const XMFLOAT2& c = src[i1*srcSize.x + j0];
+				const XMFLOAT2& d = src[i1*srcSize.x + j1];
+				dest[i*size.x + j] = XMFLOAT2(MathHelper::Min(MathHelper::Min(a.x, b.x), MathHelper::Min(c.x, d.x)),
+					MathHelper::Max(MathHelper::Max(a.y, b.y), MathHelper::Max(c.y, d.y)));
+			}
+		}
+	}
+}
+
+void TerrainHeightfield::CalcAllNormal()
+{
+	DX_PROFILE_ZONE("TerrainHeightfield::CalcAllNormal");
+
+	m_normal.resize(m_heightmap.size());
+
+	// Speed up
+	ParallelFor(0, m_height, [&](UINT i)
+	{
+		for (UINT j = 0; j < m_width; ++j)
+		{
+			XMStoreFloat3(&m_normal[i*m_width + j], CalcNormal(i, j));
+		}
+	}, NormalRows);
+}
+
+XMVECTOR TerrainHeightfield::CalcNormal(UINT i, UINT j)const
+{
+	//
+	// Estimate normal and tangent using central differences.
+	//
+
+	// do clamp
+	float leftY = GetSample(i, j == 0 ? 0 : j - 1);
+	float rightY = GetSample(i, (std::min)(j + 1, m_width - 1));
+	float bottomY = GetSample((std::min)(i + 1, m_height - 1), j);
+	float topY = GetSample(i == 0 ? 0 : i - 1, j);
+
+	XMVECTOR tangent = XMVector3Normalize(XMVectorSet(2.0f*m_cellSpacing, rightY - leftY, 0.0f, 0.0f));
+	XMVECTOR bitan = XMVector3Normalize(XMVectorSet(0.0f, bottomY - topY, -2.0f*m_cellSpacing, 0.0f));
+	return XMVector3Cross(tangent, bitan);
+}
+
+XMVECTOR TerrainHeightfield::GetVertexNormal(UINT i, UINT j)const
+{
+	if (m_normal.empty())
+		return CalcNormal(i, j);
+	return XMLoadFloat3(&m_normal[i*m_width + j]);
+}
+
+// Cell (row, col) holding (x, z) and the position (s, t) inside it. Points off the
+// terrain are moved to its nearest edge. GetCells must give the same results.
+void TerrainHeightfield::GetCell(float x, float z, UINT& row, UINT& col, float& s, float& t)const
+{
+	// Transform from terrain local space to "cell" space.
+	float invSpacing = 1.0f / m_cellSpacing;
+	float c = (x + 0.5f*GetWidth()) * invSpacing;
+	float d = (z - 0.5f*GetDepth()) * -invSpacing;
+
+	// Written so that NaN goes to 0.
+	c = (std::max)(0.0f, (std::min)(c, (float)(m_width - 1)));
+	d = (std::max)(0.0f, (std::min)(d, (float)(m_height - 1)));
+
+	// Get the row and column we are in.
+	row = (std::min)((UINT)d, m_height - 2);
+	col = (std::min)((UINT)c, m_width - 2);
+
+	// Where we are relative to the cell.
+	s = c - (float)col;
+	t = d - (float)row;
+}
+
+float TerrainHeightfield::GetHeight(float x, float z)const
+{
+	UINT row, col;
+	float s, t;
+	GetCell(x, z, row, col, s, t);
+
+	// Grab the heights of the cell we are in.
+	// A*--*B
+	//  | /|
+	//  |/ |
+	// C*--*D
+	float A = GetSample(row, col);
+	float B = GetSample(row, col + 1);
+	float C = GetSample(row + 1, col);
+	float D = GetSample(row + 1, col + 1);
+
+	// If upper triangle ABC.
+	if (s + t <= 1.0f)
+	{
+		float uy = B - A;
+		float vy = C - A;
+		return A + s*uy + t*vy;
+	}
+	else // lower triangle DCB.
+	{
+		float uy = C - D;
+		float vy = B - D;
+		return D + (1.0f - s)*uy + (1.0f - t)*vy;
+	}
+}
+
+XMVECTOR TerrainHeightfield::GetNormal(float x, float z)const
+{
+	UINT row, col;
+	float s, t;
+	GetCell(x, z, row, col, s, t);
+
+	// Grab the normals of the cell we are in.
+	// A*--*B
+	//  | /|
+	//  |/ |
+	// C*--*D
+	XMVECTOR NA = GetVertexNormal(row, col);
+	XMVECTOR NB = GetVertexNormal(row, col + 1);
+	XMVECTOR NC = GetVertexNormal(row + 1, col);
+	XMVECTOR ND = GetVertexNormal(row + 1, col + 1);
+
+	// If upper triangle ABC.
+	if (s + t <= 1.0f)
+	{
+		XMVECTOR uy = NB - NA;
+		XMVECTOR vy = NC - NA;
+		return XMVector3Normalize(NA + s*uy + t*vy);
+	}
+	else // lower triangle DCB.
+	{
+		XMVECTOR uy = NC - ND;
+		XMVECTOR vy = NB - ND;
+		return XMVector3Normalize(ND + (1.0f - s)*uy + (1.0f - t)*vy);
+	}
+}
+
+namespace
+{
+	// Batches of at least ParallelQueries points are split in chunks of QueryChunk.
+	const UINT ParallelQueries = 4096;
+	const UINT QueryChunk = 1024;
+
+	template<typename Query>
+	void RunQueries(UINT count, const Query& query)
+	{
+		if (count < ParallelQueries)
+		{
+			query(0, count);
+			return;
+		}
+		ParallelFor(0, (count + QueryChunk - 1) / QueryChunk, [&](UINT k)
+		{
+			query(k * QueryChunk, (std::min)(QueryChunk, count - k * QueryChunk));
+		});
+	}
+}
+
+void TerrainHeightfield::GetHeights(const XMFLOAT2* points, UINT count, float* heights)const
+{
+	// The tile cache can't be shared between threads.
+	if (m_tiledHeightmap)
+	{
+		for (UINT i = 0; i < count; ++i)
+			heights[i] = GetHeight(points[i].x, points[i].y);
+		return;
+	}
+	RunQueries(count, [&](UINT first, UINT n) { CalcHeights(points + first, n, heights + first); });
+}
+
+void TerrainHeightfield::GetNormals(const XMFLOAT2* points, UINT count, XMFLOAT3* normals)const
+{
+	if (m_tiledHeightmap)
+	{
+		for (UINT i = 0; i < count; ++i)
+			XMStoreFloat3(&normals[i], GetNormal(points[i].x, points[i].y));
+		return;
+	}
+	RunQueries(count, [&](UINT first, UINT n) { CalcNormals(points + first, n, normals + first); });
+}
+
+// GetCell for four points, with the same operations on every lane. cells gets
+// row * HeightmapWidth + col.
+void TerrainHeightfield::GetCells(const XMFLOAT2* points, UINT cells[4], XMVECTOR& s, XMVECTOR& t)const
+{
+	float invSpacing = 1.0f / m_cellSpacing;
+	XMVECTOR p01 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(points));
+	XMVECTOR p23 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(points + 2));
+	XMVECTOR x = XMVectorPermute<0, 2, 4, 6>(p01, p23);
+	XMVECTOR z = XMVectorPermute<1, 3, 5, 7>(p01, p23);
+	XMVECTOR c = XMVectorMultiply(XMVectorAdd(x, XMVectorReplicate(0.5f*GetWidth())), XMVectorReplicate(invSpacing));
+	XMVECTOR d = XMVectorMultiply(XMVectorSubtract(z, XMVectorReplicate(0.5f*GetDepth())), XMVectorReplicate(-invSpacing));
+
+	// (std::max)(0, (std::min)(v, max)), including what it does with NaN.
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR maxC = XMVectorReplicate((float)(m_width - 1));
+	XMVECTOR maxD = XMVectorReplicate((float)(m_height - 1));
+	c = XMVectorSelect(c, maxC, XMVectorLess(maxC, c));
+	c = XMVectorSelect(zero, c, XMVectorGreater(c, zero));
+	d = XMVectorSelect(d, maxD, XMVectorLess(maxD, d));
+	d = XMVectorSelect(zero, d, XMVectorGreater(d, zero));
+
+	XMVECTOR col = XMVectorMin(XMVectorTruncate(c), XMVectorReplicate((float)(m_width - 2)));
+	XMVECTOR row = XMVectorMin(XMVectorTruncate(d), XMVectorReplicate((float)(m_height - 2)));
+	s = XMVectorSubtract(c, col);
+	t = XMVectorSubtract(d, row);
+
+	XMUINT4 rows, cols;
+	XMStoreUInt4(&rows, XMConvertVectorFloatToUInt(row, 0));
+	XMStoreUInt4(&cols, XMConvertVectorFloatToUInt(col, 0));
+	cells[0] = rows.x * m_width + cols.x;
+	cells[1] = rows.y * m_width + cols.y;
+	cells[2] = rows.z * m_width + cols.z;
+	cells[3] = rows.w * m_width + cols.w;
+}
+
+// GetHeight for four points at a time. Both triangles are interpolated with the
+// same operations as GetHeight and the right one is selected, so the results match.
+void TerrainHeightfield::CalcHeights(const XMFLOAT2* points, UINT count, float* heights)const
+{
+	UINT width = m_width;
+	XMVECTOR one = XMVectorSplatOne();
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		UINT cells[4];
+		XMVECTOR vS, vT;
+		GetCells(points + i, cells, vS, vT);
+		float a[4], b[4], c[4], d[4];
+		for (UINT k = 0; k < 4; ++k)
+		{
+			const float* cell = &m_heightmap[cells[k]];
+			a[k] = cell[0];
+			b[k] = cell[1];
+			c[k] = cell[width];
+			d[k] = cell[width + 1];
+		}
+
+		XMVECTOR vA = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a));
+		XMVECTOR vB = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(b));
+		XMVECTOR vC = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(c));
+		XMVECTOR vD = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(d));
+		XMVECTOR upper = XMVectorAdd(XMVectorAdd(vA, XMVectorMultiply(vS, XMVectorSubtract(vB, vA))),
+			XMVectorMultiply(vT, XMVectorSubtract(vC, vA)));
+		XMVECTOR lower = XMVectorAdd(XMVectorAdd(vD, XMVectorMultiply(XMVectorSubtract(one, vS), XMVectorSubtract(vC, vD))),
+			XMVectorMultiply(XMVectorSubtract(one, vT), XMVectorSubtract(vB, vD)));
+		XMVECTOR isUpper = XMVectorLessOrEqual(XMVectorAdd(vS, vT), one);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(heights + i), XMVectorSelect(lower, upper, isUpper));
+	}
+	for (; i < count; ++i)
+		heights[i] = GetHeight(points[i].x, points[i].y);
+}
+
+// GetNormal without the branch. The cells are found four points at a time, then
+// the lanes of a vector hold the xyz of one normal.
+void TerrainHeightfield::CalcNormals(const XMFLOAT2* points, UINT count, XMFLOAT3* normals)const
+{
+	UINT width = m_width;
+	XMVECTOR one = XMVectorSplatOne();
+	UINT i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		UINT cells[4];
+		XMVECTOR vS, vT;
+		GetCells(points + i, cells, vS, vT);
+		float s[4], t[4];
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(s), vS);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(t), vT);
+		for (UINT k = 0; k < 4; ++k)
+		{
+			const XMFLOAT3* cell = &m_normal[cells[k]];
+			XMVECTOR NA = XMLoadFloat3(&cell[0]);
+			XMVECTOR NB = XMLoadFloat3(&cell[1]);
+			XMVECTOR NC = XMLoadFloat3(&cell[width]);
+			XMVECTOR ND = XMLoadFloat3(&cell[width + 1]);
+
+			XMVECTOR sk = XMVectorReplicate(s[k]), tk = XMVectorReplicate(t[k]);
+			XMVECTOR upper = XMVectorAdd(XMVectorAdd(NA, XMVectorMultiply(XMVectorSubtract(NB, NA), sk)),
+				XMVectorMultiply(XMVectorSubtract(NC, NA), tk));
+			XMVECTOR lower = XMVectorAdd(XMVectorAdd(ND, XMVectorMultiply(XMVectorSubtract(NC, ND), XMVectorSubtract(one, sk))),
+				XMVectorMultiply(XMVectorSubtract(NB, ND), XMVectorSubtract(one, tk)));
+			XMVECTOR isUpper = XMVectorLessOrEqual(XMVectorAdd(sk, tk), one);
+			XMStoreFloat3(&normals[i + k], XMVector3Normalize(XMVectorSelect(lower, upper, isUpper)));
+		}
+	}
+	for (; i < count; ++i)
+		XMStoreFloat3(&normals[i], GetNormal(points[i].x, points[i].y));
+}
+
+namespace
+{
+	// Slightly larger blocks, so that rays grazing an edge aren't lost to rounding.
+	const float BlockMargin = 1e-3f;
+	const float CellMargin = 1e-5f;
+
+	// Clips [t0, t1] to where origin + t * direction is in [lo, hi].
+	bool ClipSlab(float origin, float direction, float lo, float hi, float& t0, float& t1)
+	{
+		if (direction == 0.0f)
+			return origin >= lo && origin <= hi;
+		float invDirection = 1.0f / direction;
+		float ta = (lo - origin) * invDirection, tb = (hi - origin) * invDirection;
+		t0 = (std::max)(t0, (std::min)(ta, tb));
+		t1 = (std::min)(t1, (std::max)(ta, tb));
+		return t0 <= t1;
+	}
+}
+
+bool TerrainHeightfield::RayCast(FXMVECTOR origin, FXMVECTOR direction, float maxDistance, TerrainHit& hit)const
+{
+	XMFLOAT3 o, d;
+	XMStoreFloat3(&o, origin);
+	XMStoreFloat3(&d, direction);
+	return CastRay(o, d, maxDistance, hit);
+}
+
+void TerrainHeightfield::RayCasts(const XMFLOAT3* origins, const XMFLOAT3* directions, UINT count,
+	float maxDistance, TerrainHit* hits)const
+{
+	auto cast = [&](UINT first, UINT n)
+	{
+		for (UINT i = first; i < first + n; ++i)
+		{
+			if (!CastRay(origins[i], directions[i], maxDistance, hits[i]))
+				hits[i].Distance = FLT_MAX;
+		}
+	};
+	// The tile cache can't be shared between threads.
+	if (m_tiledHeightmap)
+		cast(0, count);
+	else
+		RunQueries(count, cast);
+}
+
+// Walks the pyramid from the top, visiting the blocks the ray enters in the order
+// it enters them and skipping blocks it enters after the nearest hit so far.
+bool TerrainHeightfield::CastRay(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, TerrainHit& hit)const
+{
+	// In cell space x and z are the column and row, y stays the height.
+	float invSpacing = 1.0f / m_cellSpacing;
+	XMFLOAT3 o((origin.x + 0.5f*GetWidth()) * invSpacing, origin.y, (origin.z - 0.5f*GetDepth()) * -invSpacing);
+	XMFLOAT3 d(direction.x * invSpacing, direction.y, -direction.z * invSpacing);
+	UINT cols = m_width - 1, rows = m_height - 1;
+
+	struct Block
+	{
+		UINT Level;
+		UINT Row;
+		UINT Col;
+		float TEnter;
+		XMFLOAT2 BoundsY;
+	};
+	auto clip = [&](Block& block, float tMax)
+	{
+		float t0 = 0.0f, t1 = tMax;
+		float col0 = (float)(block.Col << block.Level), col1 = (float)(std::min)((block.Col + 1) << block.Level, cols);
+		float row0 = (float)(block.Row << block.Level), row1 = (float)(std::min)((block.Row + 1) << block.Level, rows);
+		if (!ClipSlab(o.x, d.x, col0 - BlockMargin, col1 + BlockMargin, t0, t1) ||
+			!ClipSlab(o.z, d.z, row0 - BlockMargin, row1 + BlockMargin, t0, t1) ||
+			!ClipSlab(o.y, d.y, block.BoundsY.x - BlockMargin, block.BoundsY.y + BlockMargin, t0, t1))
+			return false;
+		block.TEnter = t0;
+		return true;
+	};
+
+	// At most three pending siblings per level.
+	Block stack[4 * 32];
+	UINT size = 0;
+	UINT top = (UINT)m_heightBounds.size() - 1;
+	Block root = { top, 0, 0, 0.0f, m_heightBounds[top][0] };
+	if (!clip(root, maxDistance))
+		return false;
+	stack[size++] = root;
+
+	float nearest = maxDistance;
+	bool found = false;
+	while (size > 0)
+	{
+		Block block = stack[--size];
+		if (block.TEnter > nearest)
+			continue;
+
+		if (block.Level == 0)
+		{
+			float t;
+			XMFLOAT3 normal;
+			if (IntersectCell(block.Row, block.Col, o, d, nearest, t, normal))
+			{
+				nearest = t;
+				found = true;
+				hit.Normal = normal;
+			}
+			continue;
+		}
+
+		// Levels below the finest stored one keep the bounds of their parent.
+		UINT level = block.Level - 1;
+		XMUINT2 levelSize = m_heightBoundsSizes[level];
+		const std::vector<XMFLOAT2>& bounds = m_heightBounds[level];
+		Block children[4];
+		UINT count = 0;
+		for (UINT i = 2 * block.Row; i < (std::min)(2 * block.Row + 2, levelSize.y); ++i)
+		{
+			for (UINT j = 2 * block.Col; j < (std::min)(2 * block.Col + 2, levelSize.x); ++j)
+			{
+				Block child = { level, i, j, 0.0f, bounds.empty() ? block.BoundsY : bounds[i*levelSize.x + j] };
+				if (clip(child, nearest))
+					children[count++] = child;
+			}
+		}
+		// Nearest first, by insertion over the count entered.
+		for (UINT k = 1; k < count; ++k)
+		{
+			Block child = children[k];
+			UINT m = k;
+			for (; m > 0 && children[m - 1].TEnter > child.TEnter; --m)
+				children[m] = children[m - 1];
+			children[m] = child;
+		}
+		for (UINT k = count; k > 0; --k)
+			stack[size++] = children[k - 1];
+	}
+
+	if (!found)
+		return false;
+	hit.Distance = nearest;
+	XMStoreFloat3(&hit.Position, XMVectorAdd(XMLoadFloat3(&origin), XMVectorScale(XMLoadFloat3(&direction), nearest)));
+	return true;
+}
+
+// Intersects the cell space ray with the two triangles of a cell, see GetHeight.
+bool TerrainHeightfield::IntersectCell(UINT row, UINT col, const XMFLOAT3& origin, const XMFLOAT3& direction,
+	float maxT, float& t, XMFLOAT3& normal)const
+{
+	float A = GetSample(row, col);
+	float B = GetSample(row, col + 1);
+	float C = GetSample(row + 1, col);
+	float D = GetSample(row + 1, col + 1);
+	float s0 = origin.x - col, t0 = origin.z - row;
+	float invSpacing = 1.0f / m_cellSpacing;
+	bool found = false;
+
+	// Upper triangle ABC, height A + s*(B - A) + t*(C - A) where s + t <= 1.
+	float g1 = direction.y - (B - A)*direction.x - (C - A)*direction.z;
+	if (g1 != 0.0f)
+	{
+		float tHit = -(origin.y - A - (B - A)*s0 - (C - A)*t0) / g1;
+		float s = s0 + direction.x*tHit, u = t0 + direction.z*tHit;
+		if (tHit >= 0.0f && tHit <= maxT && s >= -CellMargin && u >= -CellMargin && s + u <= 1.0f + CellMargin)
+		{
+			maxT = t = tHit;
+			normal = XMFLOAT3(-(B - A)*invSpacing, 1.0f, (C - A)*invSpacing);
+			found = true;
+		}
+	}
+
+	// Lower triangle DCB, height D + (1 - s)*(C - D) + (1 - t)*(B - D) where s + t >= 1.
+	g1 = direction.y + (C - D)*direction.x + (B - D)*direction.z;
+	if (g1 != 0.0f)
+	{
+		float tHit = -(origin.y - D - (C - D)*(1.0f - s0) - (B - D)*(1.0f - t0)) / g1;
+		float s = s0 + direction.x*tHit, u = t0 + direction.z*tHit;
+		if (tHit >= 0.0f && tHit <= maxT && s <= 1.0f + CellMargin && u <= 1.0f + CellMargin && s + u >= 1.0f - CellMargin)
+		{
+			t = tHit;
+			normal = XMFLOAT3((C - D)*invSpacing, 1.0f, -(B - D)*invSpacing);
+			found = true;
+		}
+	}
+
+	if (found)
+		XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+	return found;
+}
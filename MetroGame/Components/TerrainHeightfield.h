@@ -0,0 +1,103 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <vector>
+#include "TiledHeightmap.h"
+
+// Device independent height field of a terrain: the heights and normals of its
+// vertices, a min/max height pyramid over its cells, and the height, normal and
+// ray queries Terrain answers on the CPU. The samples are either held in memory
+// or read from a tiled height map. Laid out like the terrain, centered at the
+// origin with columns along +x and rows along -z.
+// The translation unit doesn't use the precompiled header, so that the terrain
+// tests build headless.
+
+namespace DXFramework
+{
+	struct TerrainHit
+	{
+		float Distance;		// Along the ray, in lengths of its direction
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT3 Normal;	// Of the triangle that was hit
+	};
+
+	class TerrainHeightfield
+	{
+	public:
+		TerrainHeightfield();
+
+		// Takes the width x height samples row by row, computes their normals and
+		// builds the pyramid.
+		void Initialize(std::vector<float> samples, UINT width, UINT height, float cellSpacing);
+		// Reads the samples from a tiled height map, which must stay open while the
+		// field is used. The normals are computed when queried and the pyramid starts
+		// at level PatchLevel, from the bounds the file stores.
+		void Initialize(const TiledHeightmap& tiledHeightmap, float cellSpacing);
+
+	public:
+		UINT GetSampleCols()const { return m_width; }
+		UINT GetSampleRows()const { return m_height; }
+		float GetWidth()const { return (m_width - 1)*m_cellSpacing; }
+		float GetDepth()const { return (m_height - 1)*m_cellSpacing; }
+		// Empty for a tiled height map.
+		const std::vector<float>& GetSamples()const { return m_heightmap; }
+		// Min and max height of the blocks of 2^level x 2^level cells, row by row.
+		// The pyramid always reaches PatchLevel, and ends with one block.
+		UINT GetLevelCount()const { return (UINT)m_heightBounds.size(); }
+		const std::vector<DirectX::XMFLOAT2>& GetBoundsY(UINT level)const { return m_heightBounds[level]; }
+		DirectX::XMUINT2 GetBlockCounts(UINT level)const { return m_heightBoundsSizes[level]; }
+
+		// Points off the terrain get the height and normal of its nearest edge.
+		float GetHeight(float x, float z)const;
+		DirectX::XMVECTOR GetNormal(float x, float z)const;
+		// Same as GetHeight and GetNormal for count points (x, z), with the same
+		// results. Large batches are split over the thread pool.
+		void GetHeights(const DirectX::XMFLOAT2* points, UINT count, float* heights)const;
+		void GetNormals(const DirectX::XMFLOAT2* points, UINT count, DirectX::XMFLOAT3* normals)const;
+		// First hit of origin + t * direction with the terrain's triangles for t in
+		// [0, maxDistance]. The min/max height pyramid skips every block of cells
+		// the ray passes above or below.
+		bool RayCast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, TerrainHit& hit)const;
+		// RayCast for count rays, split over the thread pool for large batches.
+		// Rays which miss get a Distance of FLT_MAX.
+		void RayCasts(const DirectX::XMFLOAT3* origins, const DirectX::XMFLOAT3* directions, UINT count,
+			float maxDistance, TerrainHit* hits)const;
+
+	public:
+		// Terrain's patches of 64 x 64 cells are the blocks of this level.
+		static const UINT PatchLevel = 6;
+
+	private:
+		void BuildHeightBounds();
+		void CalcAllNormal();
+		DirectX::XMVECTOR CalcNormal(UINT i, UINT j)const;
+		DirectX::XMVECTOR GetVertexNormal(UINT i, UINT j)const;
+		void GetCell(float x, float z, UINT& row, UINT& col, float& s, float& t)const;
+		void GetCells(const DirectX::XMFLOAT2* points, UINT cells[4], DirectX::XMVECTOR& s, DirectX::XMVECTOR& t)const;
+		void CalcHeights(const DirectX::XMFLOAT2* points, UINT count, float* heights)const;
+		void CalcNormals(const DirectX::XMFLOAT2* points, UINT count, DirectX::XMFLOAT3* normals)const;
+		bool CastRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, TerrainHit& hit)const;
+		bool IntersectCell(UINT row, UINT col, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction,
+			float maxT, float& t, DirectX::XMFLOAT3& normal)const;
+		float GetSample(UINT i, UINT j)const
+		{
+			return m_tiledHeightmap ? m_tiledHeightmap->GetSample(i, j) : m_heightmap[i*m_width + j];
+		}
+
+	private:
+		static const UINT NormalRows = 16;	// Heightmap rows per job of CalcAllNormal
+
+		UINT m_width;	// Vertices number
+		UINT m_height;	// Vertices number
+		float m_cellSpacing;
+		// Min and max height of blocks of cells. Level k holds blocks of 2^k x 2^k
+		// cells. A tiled height map has no levels below PatchLevel.
+		std::vector<std::vector<DirectX::XMFLOAT2>> m_heightBounds;
+		std::vector<DirectX::XMUINT2> m_heightBoundsSizes;
+		std::vector<DirectX::XMFLOAT3> m_normal;
+		std::vector<float> m_heightmap;
+		// Replaces m_heightmap and m_normal when the height map is tiled.
+		const TiledHeightmap* m_tiledHeightmap;
+	};
+}
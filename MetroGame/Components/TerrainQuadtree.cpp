@@ -0,0 +1,133 @@
+#include "TerrainQuadtree.h"
+#include <algorithm>
+#include <float.h>
+
+using namespace DXFramework;
+using namespace DirectX;
+
+TerrainQuadtree::TerrainQuadtree() :
+	m_rows(0), m_cols(0), m_minX(0.0f), m_maxZ(0.0f), m_patchWidth(0.0f), m_patchDepth(0.0f)
+{
+}
+
+void TerrainQuadtree::Build(const std::vector<XMFLOAT2>& boundsY, UINT rows, UINT cols,
+	float minX, float maxZ, float patchWidth, float patchDepth)
+{
+	m_boundsY = boundsY;
+	m_rows = rows;
+	m_cols = cols;
+	m_minX = minX;
+	m_maxZ = maxZ;
+	m_patchWidth = patchWidth;
+	m_patchDepth = patchDepth;
+
+	m_nodes.clear();
+	m_children.clear();
+	if (rows && cols)
+		BuildNode(0, rows, 0, cols);
+}
+
+UINT TerrainQuadtree::BuildNode(UINT row0, UINT row1, UINT col0, UINT col1)
+{
+	UINT index = (UINT)m_nodes.size();
+	m_nodes.push_back(Node());
+
+	Node node;
+	node.Row0 = row0;
+	node.Row1 = row1;
+	node.Col0 = col0;
+	node.Col1 = col1;
+	node.FirstChild = 0;
+	node.ChildCount = 0;
+
+	if (row1 - row0 == 1 && col1 - col0 == 1)
+	{
+		XMFLOAT2 y = m_boundsY[row0 * m_cols + col0];
+		node.Min = XMFLOAT3(m_minX + col0 * m_patchWidth, y.x, m_maxZ - row1 * m_patchDepth);
+		node.Max = XMFLOAT3(m_minX + col1 * m_patchWidth, y.y, m_maxZ - row0 * m_patchDepth);
+		m_nodes[index] = node;
+		return index;
+	}
+
+	UINT rowMid = row1 - row0 > 1 ? (row0 + row1) / 2 : row1;
+	UINT colMid = col1 - col0 > 1 ? (col0 + col1) / 2 : col1;
+	UINT children[4];
+	UINT childCount = 0;
+	for (int r = 0; r < 2; ++r)
+	{
+		UINT r0 = r ? rowMid : row0, r1 = r ? row1 : rowMid;
+		for (int c = 0; c < 2; ++c)
+		{
+			UINT c0 = c ? colMid : col0, c1 = c ? col1 : colMid;
+			if (r0 < r1 && c0 < c1)
+				children[childCount++] = BuildNode(r0, r1, c0, c1);
+		}
+	}
+
+	node.Min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	node.Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (UINT k = 0; k < childCount; ++k)
+	{
+		const Node& child = m_nodes[children[k]];
+		XMStoreFloat3(&node.Min, XMVectorMin(XMLoadFloat3(&node.Min), XMLoadFloat3(&child.Min)));
+		XMStoreFloat3(&node.Max, XMVectorMax(XMLoadFloat3(&node.Max), XMLoadFloat3(&child.Max)));
+	}
+	node.FirstChild = (UINT)m_children.size();
+	node.ChildCount = childCount;
+	m_children.insert(m_children.end(), children, children + childCount);
+	m_nodes[index] = node;
+	return index;
+}
+
+void TerrainQuadtree::Select(const XMFLOAT4 planes[6], const XMFLOAT3& eye, std::vector<UINT>& patches)const
+{
+	patches.clear();
+	if (m_nodes.empty())
+		return;
+	SelectNode(0, planes, 0x3f, patches);
+
+	// Front to back, so that early depth rejects most of the hidden pixels.
+	m_order.resize(patches.size());
+	for (size_t k = 0; k < patches.size(); ++k)
+	{
+		UINT i = patches[k] / m_cols, j = patches[k] % m_cols;
+		float dx = m_minX + (j + 0.5f) * m_patchWidth - eye.x;
+		float dz = m_maxZ - (i + 0.5f) * m_patchDepth - eye.z;
+		m_order[k] = std::make_pair(dx * dx + dz * dz, patches[k]);
+	}
+	std::sort(m_order.begin(), m_order.end());
+	for (size_t k = 0; k < patches.size(); ++k)
+		patches[k] = m_order[k].second;
+}
+
+// planeMask has a bit for every plane the parent box isn't completely inside of.
+void TerrainQuadtree::SelectNode(UINT index, const XMFLOAT4 planes[6], UINT planeMask, std::vector<UINT>& patches)const
+{
+	const Node& node = m_nodes[index];
+	XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&node.Min), XMLoadFloat3(&node.Max)), 0.5f);
+	XMVECTOR extents = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&node.Max), XMLoadFloat3(&node.Min)), 0.5f);
+	for (UINT k = 0; k < 6; ++k)
+	{
+		if (!(planeMask & (1u << k)))
+			continue;
+		XMVECTOR plane = XMLoadFloat4(&planes[k]);
+		float distance = XMVectorGetX(XMPlaneDotCoord(plane, center));
+		float radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(plane), extents));
+		if (distance < -radius)
+			return;
+		if (distance >= radius)
+			planeMask &= ~(1u << k);
+	}
+
+	// Inside all planes, or a single patch.
+	if (planeMask == 0 || node.ChildCount == 0)
+	{
+		for (UINT i = node.Row0; i < node.Row1; ++i)
+			for (UINT j = node.Col0; j < node.Col1; ++j)
+				patches.push_back(i * m_cols + j);
+		return;
+	}
+
+	for (UINT k = 0; k < node.ChildCount; ++k)
+		SelectNode(m_children[node.FirstChild + k], planes, planeMask, patches);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <utility>
+#include <vector>
+
+// Device independent quadtree over the patches of a terrain. Every node keeps the
+// world space box of the patches below it, so whole quadrants are dropped or
+// accepted with one test against the frustum. The selected patches come out
+// sorted front to back. The level of detail inside a patch stays with the hull
+// shader, which tessellates continuously with the distance to the eye.
+// The translation unit doesn't use the precompiled header, so that the terrain
+// tests build headless.
+
+namespace DXFramework
+{
+	class TerrainQuadtree
+	{
+	public:
+		TerrainQuadtree();
+
+		// boundsY holds the min and max height of patch i * cols + j. The patches
+		// are laid out like the terrain's: columns grow along +x from minX,
+		// rows grow along -z from maxZ.
+		void Build(const std::vector<DirectX::XMFLOAT2>& boundsY, UINT rows, UINT cols,
+			float minX, float maxZ, float patchWidth, float patchDepth);
+		// Clears patches and fills it with the ids of the patches whose box intersects
+		// the frustum, nearest to eye first. The planes face inwards.
+		void Select(const DirectX::XMFLOAT4 planes[6], const DirectX::XMFLOAT3& eye, std::vector<UINT>& patches)const;
+
+	public:
+		UINT GetPatchCount()const { return m_rows * m_cols; }
+		UINT GetNodeCount()const { return (UINT)m_nodes.size(); }
+
+	private:
+		// The patches in rows [Row0, Row1) and columns [Col0, Col1). A node with
+		// more than one patch splits them in four quadrants, or in two halves along
+		// a strip, listed in m_children from FirstChild on.
+		struct Node
+		{
+			DirectX::XMFLOAT3 Min;
+			UINT Row0, Row1;
+			DirectX::XMFLOAT3 Max;
+			UINT Col0, Col1;
+			UINT FirstChild;
+			UINT ChildCount;
+		};
+
+		UINT BuildNode(UINT row0, UINT row1, UINT col0, UINT col1);
+		void SelectNode(UINT index, const DirectX::XMFLOAT4 planes[6], UINT planeMask, std::vector<UINT>& patches)const;
+
+	private:
+		std::vector<Node> m_nodes;
+		std::vector<UINT> m_children;
+		std::vector<DirectX::XMFLOAT2> m_boundsY;
+		UINT m_rows;
+		UINT m_cols;
+		float m_minX;
+		float m_maxZ;
+		float m_patchWidth;
+		float m_patchDepth;
+
+		// Distances and ids of the selected patches, kept so that sorting them every
+		// frame doesn't allocate.
+		mutable std::vector<std::pair<float, UINT>> m_order;
+	};
+}
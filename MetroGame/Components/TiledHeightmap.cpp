@@ -0,0 +1,169 @@
+#include "TiledHeightmap.h"
+#include <algorithm>
+#include <float.h>
+#include <limits.h>
+#include <stdexcept>
+#include <string.h>
+
+using namespace DXFramework;
+using namespace DirectX;
+
+TiledHeightmap::TiledHeightmap() :
+	m_tilesX(0), m_tilesY(0), m_cacheTiles(0), m_tileBounds(nullptr), m_tiles(nullptr),
+	m_lastTile(UINT_MAX), m_lastHeights(nullptr)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+bool TiledHeightmap::Open(const std::wstring& filename)
+{
+	Close();
+	if (!m_file.Open(filename) || m_file.GetSize() < sizeof(TiledHeightmapHeader))
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&m_header, m_file.GetData(), sizeof(TiledHeightmapHeader));
+	if (m_header.Magic != TiledHeightmapMagic)
+	{
+		Close();
+		return false;
+	}
+	if (m_header.Version != TiledHeightmapVersion || m_header.Width < 2 || m_header.Height < 2 || m_header.TileSize == 0)
+		throw std::runtime_error("Unsupported .tht file!");
+
+	m_tilesX = (m_header.Width + m_header.TileSize - 1) / m_header.TileSize;
+	m_tilesY = (m_header.Height + m_header.TileSize - 1) / m_header.TileSize;
+	size_t tileCount = size_t(m_tilesX) * m_tilesY;
+	size_t boundsEnd = sizeof(TiledHeightmapHeader) + tileCount * sizeof(XMFLOAT2);
+	size_t tilesOffset = (boundsEnd + TiledHeightmapAlignment - 1) / TiledHeightmapAlignment * TiledHeightmapAlignment;
+	size_t tileBytes = size_t(m_header.TileSize) * m_header.TileSize * sizeof(USHORT);
+	if (tilesOffset + tileCount * tileBytes > m_file.GetSize())
+		throw std::runtime_error("Corrupted .tht file!");
+
+	m_tileBounds = reinterpret_cast<const XMFLOAT2*>(m_file.GetData() + sizeof(TiledHeightmapHeader));
+	m_tiles = reinterpret_cast<const USHORT*>(m_file.GetData() + tilesOffset);
+	m_slotOfTile.assign(tileCount, -1);
+	SetCacheTiles(TiledHeightmapCacheTiles);
+	return true;
+}
+
+void TiledHeightmap::Close()
+{
+	m_file.Close();
+	memset(&m_header, 0, sizeof(m_header));
+	m_tilesX = m_tilesY = m_cacheTiles = 0;
+	m_tileBounds = nullptr;
+	m_tiles = nullptr;
+	m_slotOfTile.clear();
+	m_slots.clear();
+	m_lru.clear();
+	m_lastTile = UINT_MAX;
+	m_lastHeights = nullptr;
+}
+
+void TiledHeightmap::SetCacheTiles(UINT count)
+{
+	count = (std::max)(count, 1u);
+	if (count < m_slots.size())
+	{
+		std::fill(m_slotOfTile.begin(), m_slotOfTile.end(), -1);
+		m_slots.clear();
+		m_lru.clear();
+		m_lastTile = UINT_MAX;
+		m_lastHeights = nullptr;
+	}
+	m_cacheTiles = count;
+	m_slots.reserve(m_cacheTiles);
+}
+
+XMFLOAT2 TiledHeightmap::GetBoundsY(UINT row0, UINT col0, UINT row1, UINT col1)const
+{
+	XMFLOAT2 bounds(FLT_MAX, -FLT_MAX);
+	UINT tileRow1 = (std::min)((row1 - 1) / m_header.TileSize, m_tilesY - 1);
+	UINT tileCol1 = (std::min)((col1 - 1) / m_header.TileSize, m_tilesX - 1);
+	for (UINT i = row0 / m_header.TileSize; i <= tileRow1; ++i)
+	{
+		for (UINT j = col0 / m_header.TileSize; j <= tileCol1; ++j)
+		{
+			const XMFLOAT2& tile = m_tileBounds[i * m_tilesX + j];
+			bounds.x = (std::min)(bounds.x, tile.x);
+			bounds.y = (std::max)(bounds.y, tile.y);
+		}
+	}
+	return bounds;
+}
+
+void TiledHeightmap::Prefetch(UINT row0, UINT col0, UINT row1, UINT col1)
+{
+	if (row0 >= row1 || col0 >= col1)
+		return;
+	UINT tileRow1 = (std::min)((row1 - 1) / m_header.TileSize, m_tilesY - 1);
+	UINT tileCol1 = (std::min)((col1 - 1) / m_header.TileSize, m_tilesX - 1);
+	for (UINT i = row0 / m_header.TileSize; i <= tileRow1; ++i)
+		for (UINT j = col0 / m_header.TileSize; j <= tileCol1; ++j)
+			GetTile(i * m_tilesX + j);
+}
+
+void TiledHeightmap::ReadRow(UINT row, float* heights)const
+{
+	UINT tileSize = m_header.TileSize;
+	for (UINT j = 0; j < m_tilesX; ++j)
+	{
+		const USHORT* src = GetTileData((row / tileSize) * m_tilesX + j) + (row % tileSize) * tileSize;
+		UINT count = (std::min)(tileSize, m_header.Width - j * tileSize);
+		for (UINT k = 0; k < count; ++k)
+			heights[j * tileSize + k] = m_header.MinHeight + src[k] * m_header.HeightStep;
+	}
+}
+
+size_t TiledHeightmap::GetResidentBytes()const
+{
+	return m_slots.size() * m_header.TileSize * m_header.TileSize * sizeof(float) +
+		m_slotOfTile.size() * sizeof(int);
+}
+
+const float* TiledHeightmap::GetTile(UINT tile)const
+{
+	int slot = m_slotOfTile[tile];
+	if (slot >= 0)
+	{
+		m_lru.splice(m_lru.begin(), m_lru, m_slots[slot].Lru);
+	}
+	else
+	{
+		if (m_slots.size() < m_cacheTiles)
+		{
+			slot = (int)m_slots.size();
+			m_slots.push_back(Slot());
+			m_slots[slot].Heights.resize(m_header.TileSize * m_header.TileSize);
+			m_lru.push_front(slot);
+		}
+		else
+		{
+			// Evict the least recently used tile.
+			slot = m_lru.back();
+			m_slotOfTile[m_slots[slot].Tile] = -1;
+			m_lru.splice(m_lru.begin(), m_lru, std::prev(m_lru.end()));
+		}
+		m_slots[slot].Tile = tile;
+		m_slots[slot].Lru = m_lru.begin();
+		m_slotOfTile[tile] = slot;
+
+		const USHORT* src = GetTileData(tile);
+		float* dest = m_slots[slot].Heights.data();
+		float minHeight = m_header.MinHeight, step = m_header.HeightStep;
+		for (size_t k = 0, count = m_slots[slot].Heights.size(); k < count; ++k)
+			dest[k] = minHeight + src[k] * step;
+	}
+
+	m_lastTile = tile;
+	m_lastHeights = m_slots[slot].Heights.data();
+	return m_lastHeights;
+}
+
+const USHORT* TiledHeightmap::GetTileData(UINT tile)const
+{
+	return m_tiles + size_t(tile) * m_header.TileSize * m_header.TileSize;
+}
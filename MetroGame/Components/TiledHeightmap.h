@@ -0,0 +1,106 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <list>
+#include <string>
+#include <vector>
+#include "Common/MappedFile.h"
+
+namespace DXFramework
+{
+	// .tht layout, written by x3dConverter/TileHeightmap.cpp. The header is followed by
+	// the min and max height of every tile, and the tiles start on a page boundary.
+	// Tiles are stored row by row and every tile holds TileSize x TileSize quantized
+	// heights, MinHeight + q * HeightStep, row by row. Tiles past the right or bottom
+	// edge of the map repeat its last sample. The bounds of a tile cover its cells, so
+	// they include the first row and column of the next tiles.
+	struct TiledHeightmapHeader
+	{
+		UINT Magic;
+		UINT Version;
+		UINT Width;		// Samples
+		UINT Height;	// Samples
+		UINT TileSize;
+		UINT Reserved;
+		float MinHeight;
+		float HeightStep;
+	};
+
+	const UINT TiledHeightmapMagic = 0x31544854;	// "THT1"
+	const UINT TiledHeightmapVersion = 1;
+	const UINT TiledHeightmapAlignment = 4096;
+	const UINT TiledHeightmapCacheTiles = 256;
+
+	// Read-only view of a .tht file. The file stays memory mapped and the tiles are
+	// decoded to floats on first use into a fixed number of cache slots; the least
+	// recently used tile gives its slot away. Only the cache and the bounds table are
+	// resident, the OS pages the mapping in and out as needed.
+	// Queries update the cache, so a heightmap must not be shared between threads.
+	// The translation unit doesn't use the precompiled header, so that the streaming
+	// benchmark builds headless.
+	class TiledHeightmap
+	{
+	public:
+		TiledHeightmap();
+
+		// Returns false if the file can't be opened or isn't a .tht file,
+		// throws if it is corrupted.
+		bool Open(const std::wstring& filename);
+		void Close();
+		bool IsOpen()const { return m_file.IsOpen(); }
+		// Number of decoded tiles kept. Shrinking the cache drops all of them.
+		void SetCacheTiles(UINT count);
+
+		// Height of sample (row, col), both in range.
+		float GetSample(UINT row, UINT col)const
+		{
+			UINT tile = (row / m_header.TileSize) * m_tilesX + col / m_header.TileSize;
+			const float* heights = tile == m_lastTile ? m_lastHeights : GetTile(tile);
+			return heights[(row % m_header.TileSize) * m_header.TileSize + col % m_header.TileSize];
+		}
+		// Conservative min and max height of the cells [row0, row1) x [col0, col1),
+		// from the bounds of the tiles they touch.
+		DirectX::XMFLOAT2 GetBoundsY(UINT row0, UINT col0, UINT row1, UINT col1)const;
+		// Decodes the tiles holding samples [row0, row1) x [col0, col1) and marks them
+		// as the most recently used. Tiles past the cache size evict each other.
+		void Prefetch(UINT row0, UINT col0, UINT row1, UINT col1);
+		// Decodes one row of the map straight from the file, bypassing the cache.
+		void ReadRow(UINT row, float* heights)const;
+
+	public:
+		UINT GetWidth()const { return m_header.Width; }
+		UINT GetHeight()const { return m_header.Height; }
+		UINT GetTileSize()const { return m_header.TileSize; }
+		UINT GetCacheTiles()const { return m_cacheTiles; }
+		UINT GetResidentTiles()const { return (UINT)m_slots.size(); }
+		size_t GetResidentBytes()const;
+
+	private:
+		const float* GetTile(UINT tile)const;
+		const USHORT* GetTileData(UINT tile)const;
+
+	private:
+		struct Slot
+		{
+			UINT Tile;
+			std::list<UINT>::iterator Lru;
+			std::vector<float> Heights;
+		};
+
+		DX::MappedFile m_file;
+		TiledHeightmapHeader m_header;
+		UINT m_tilesX;
+		UINT m_tilesY;
+		UINT m_cacheTiles;
+		const DirectX::XMFLOAT2* m_tileBounds;
+		const USHORT* m_tiles;
+
+		// Slot of every tile, -1 if it isn't decoded. m_lru lists the slots,
+		// most recently used first.
+		mutable std::vector<int> m_slotOfTile;
+		mutable std::vector<Slot> m_slots;
+		mutable std::list<UINT> m_lru;
+		mutable UINT m_lastTile;
+		mutable const float* m_lastHeights;
+	};
+}
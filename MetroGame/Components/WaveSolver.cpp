@@ -0,0 +1,279 @@
+#include "WaveSolver.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include "Common/JobSystem.h"
+#include "Common/Profiler.h"
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+using namespace DXFramework;
+using namespace DirectX;
+
+WaveSolver::WaveSolver()
+	: m_numRows(0), m_numCols(0), m_timeStep(0.0f), m_spatialStep(0.0f), m_time(0.0f)
+{
+	m_k[0] = 0.0f;
+	m_k[1] = 0.0f;
+	m_k[2] = 0.0f;
+}
+
+void WaveSolver::Initialize(UINT m, UINT n, float dx, float dt, float speed, float damping)
+{
+	// Step writes the boundaries and the interior, which needs a row and a column.
+	if (m < 3 || n < 3)
+		throw std::invalid_argument("A wave grid needs at least 3x3 vertices!");
+
+	m_numRows = m;
+	m_numCols = n;
+
+	m_timeStep = dt;
+	m_spatialStep = dx;
+	m_time = 0.0f;
+
+	float d = damping*dt + 2.0f;
+	float e = (speed*speed)*(dt*dt) / (dx*dx);
+	m_k[0] = (damping*dt - 2.0f) / d;
+	m_k[1] = (4.0f - 8.0f*e) / d;
+	m_k[2] = (2.0f*e) / d;
+
+	m_prevSolution.assign(m*n, 0.0f);
+	m_currSolution.assign(m*n, 0.0f);
+}
+
+bool WaveSolver::Advance(float dt)
+{
+	// Accumulate time.
+	m_time += dt;
+
+	// Only update the simulation at the specified time step.
+	if (m_time < m_timeStep)
+		return false;
+
+	m_time = 0.0f; // reset time
+	return true;
+}
+
+void WaveSolver::Step(WaveVertex* dest)
+{
+	DX_PROFILE_ZONE("WaveSolver::Step");
+
+	// Not initialized: there is no vertex to write.
+	if (m_numRows == 0)
+		return;
+
+	// Only update interior points; we use zero boundary conditions.
+	UINT bandCount = (m_numRows - 2 + BandRows - 1) / BandRows;
+	DX::ParallelFor(0, bandCount, [&](UINT b)
+	{
+		StepBand(1 + b*BandRows, (std::min)(1 + (b + 1)*BandRows, m_numRows - 1), dest);
+	});
+
+	// The first and last row of a band need the new heights of the neighbor bands,
+	// so they are written once every band has been stepped.
+	const float* next = m_prevSolution.data();
+	DX::ParallelFor(0, bandCount, [&](UINT b)
+	{
+		UINT r0 = 1 + b*BandRows;
+		UINT r1 = (std::min)(1 + (b + 1)*BandRows, m_numRows - 1);
+		WriteRow(r0, next, dest);
+		if (r1 - 1 != r0)
+			WriteRow(r1 - 1, next, dest);
+	});
+	WriteBoundaryRow(0, next, dest);
+	WriteBoundaryRow(m_numRows - 1, next, dest);
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(m_prevSolution, m_currSolution);
+}
+
+void WaveSolver::StepBand(UINT r0, UINT r1, WaveVertex* dest)
+{
+	const float* next = m_prevSolution.data();
+	for (UINT i = r0; i < r1; ++i)
+	{
+		StepRow(i);
+
+		// Rows i-2, i-1 and i are all new now, so row i-1 can be written
+		// while they are still in cache.
+		if (i >= r0 + 2)
+			WriteRow(i - 1, next, dest);
+	}
+}
+
+void WaveSolver::StepRow(UINT i)
+{
+	// After this update we will be discarding the old previous
+	// buffer, so overwrite that buffer with the new update.
+	// Note how we can do this inplace (read/write to same element)
+	// because we won't need prev_ij again and the assignment happens last.
+
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+	// Moreover, our +z axis goes "down"; this is just to
+	// keep consistent with our row indices going down.
+
+	// The operation order matches the scalar scheme exactly, so every lane
+	// produces the same bits as the scalar loop.
+	float* next = &m_prevSolution[i*m_numCols];
+	const float* curr = &m_currSolution[i*m_numCols];
+	const float* up = curr - m_numCols;
+	const float* down = curr + m_numCols;
+	const UINT end = m_numCols - 1;
+
+	UINT j = 1;
+#if defined(__AVX__)
+	const __m256 k0x8 = _mm256_set1_ps(m_k[0]);
+	const __m256 k1x8 = _mm256_set1_ps(m_k[1]);
+	const __m256 k2x8 = _mm256_set1_ps(m_k[2]);
+	for (; j + 8 <= end; j += 8)
+	{
+		__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+			_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j)),
+			_mm256_loadu_ps(curr + j + 1)), _mm256_loadu_ps(curr + j - 1));
+		__m256 h = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(k0x8, _mm256_loadu_ps(next + j)),
+			_mm256_mul_ps(k1x8, _mm256_loadu_ps(curr + j))),
+			_mm256_mul_ps(k2x8, sum));
+		_mm256_storeu_ps(next + j, h);
+	}
+#endif
+	const XMVECTOR k0 = XMVectorReplicate(m_k[0]);
+	const XMVECTOR k1 = XMVectorReplicate(m_k[1]);
+	const XMVECTOR k2 = XMVectorReplicate(m_k[2]);
+	for (; j + 4 <= end; j += 4)
+	{
+		XMVECTOR sum = XMVectorAdd(XMVectorAdd(XMVectorAdd(
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(down + j)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(up + j))),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(curr + j + 1))),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(curr + j - 1)));
+		XMVECTOR h = XMVectorAdd(XMVectorAdd(
+			XMVectorMultiply(k0, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(next + j))),
+			XMVectorMultiply(k1, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(curr + j)))),
+			XMVectorMultiply(k2, sum));
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(next + j), h);
+	}
+	for (; j < end; ++j)
+	{
+		next[j] =
+			m_k[0]*next[j] +
+			m_k[1]*curr[j] +
+			m_k[2]*(down[j] +
+				up[j] +
+				curr[j + 1] +
+				curr[j - 1]);
+	}
+}
+
+void WaveSolver::WriteRow(UINT i, const float* h, WaveVertex* dest)
+{
+	// Compute normals using finite difference scheme. The normalization follows
+	// XMVector3Normalize: ((x*x + y*y) + z*z), square root, then divide.
+	// The lanes are computed as separate h/x/y/z rows and transposed into
+	// WaveVertex order on the way out.
+	const float* row = h + i*m_numCols;
+	const float* top = row - m_numCols;
+	const float* bottom = row + m_numCols;
+	WaveVertex* out = dest + i*m_numCols;
+	const float y = 2.0f*m_spatialStep;
+	const UINT end = m_numCols - 1;
+
+	// The first and last column are boundaries: flat, pointing up.
+	out[0].Height = row[0];
+	out[0].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	out[end].Height = row[end];
+	out[end].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+
+	UINT j = 1;
+#if defined(__AVX__)
+	const __m256 yx8 = _mm256_set1_ps(y);
+	const __m256 yyx8 = _mm256_mul_ps(yx8, yx8);
+	for (; j + 8 <= end; j += 8)
+	{
+		__m256 x = _mm256_sub_ps(_mm256_loadu_ps(row + j - 1), _mm256_loadu_ps(row + j + 1));
+		__m256 z = _mm256_sub_ps(_mm256_loadu_ps(bottom + j), _mm256_loadu_ps(top + j));
+		__m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), yyx8), _mm256_mul_ps(z, z)));
+		__m256 hv = _mm256_loadu_ps(row + j);
+		__m256 nx = _mm256_div_ps(x, len);
+		__m256 ny = _mm256_div_ps(yx8, len);
+		__m256 nz = _mm256_div_ps(z, len);
+
+		__m128 r0 = _mm256_castps256_ps128(hv), r1 = _mm256_castps256_ps128(nx);
+		__m128 r2 = _mm256_castps256_ps128(ny), r3 = _mm256_castps256_ps128(nz);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(&out[j].Height, r0);
+		_mm_storeu_ps(&out[j + 1].Height, r1);
+		_mm_storeu_ps(&out[j + 2].Height, r2);
+		_mm_storeu_ps(&out[j + 3].Height, r3);
+
+		r0 = _mm256_extractf128_ps(hv, 1); r1 = _mm256_extractf128_ps(nx, 1);
+		r2 = _mm256_extractf128_ps(ny, 1); r3 = _mm256_extractf128_ps(nz, 1);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(&out[j + 4].Height, r0);
+		_mm_storeu_ps(&out[j + 5].Height, r1);
+		_mm_storeu_ps(&out[j + 6].Height, r2);
+		_mm_storeu_ps(&out[j + 7].Height, r3);
+	}
+#endif
+	const XMVECTOR yx4 = XMVectorReplicate(y);
+	const XMVECTOR yyx4 = XMVectorMultiply(yx4, yx4);
+	for (; j + 4 <= end; j += 4)
+	{
+		XMVECTOR x = XMVectorSubtract(
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + j - 1)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + j + 1)));
+		XMVECTOR z = XMVectorSubtract(
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(bottom + j)),
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(top + j)));
+		XMVECTOR len = XMVectorSqrt(XMVectorAdd(XMVectorAdd(XMVectorMultiply(x, x), yyx4), XMVectorMultiply(z, z)));
+
+		XMMATRIX v(
+			XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + j)),
+			XMVectorDivide(x, len),
+			XMVectorDivide(yx4, len),
+			XMVectorDivide(z, len));
+		v = XMMatrixTranspose(v);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out + j), v.r[0]);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out + j + 1), v.r[1]);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out + j + 2), v.r[2]);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out + j + 3), v.r[3]);
+	}
+	for (; j < end; ++j)
+	{
+		float x = row[j - 1] - row[j + 1];
+		float z = bottom[j] - top[j];
+		float len = sqrtf((x*x + y*y) + z*z);
+		out[j].Height = row[j];
+		out[j].Normal = XMFLOAT3(x / len, y / len, z / len);
+	}
+}
+
+void WaveSolver::WriteBoundaryRow(UINT i, const float* h, WaveVertex* dest)
+{
+	const float* row = h + i*m_numCols;
+	WaveVertex* out = dest + i*m_numCols;
+	for (UINT j = 0; j < m_numCols; ++j)
+	{
+		out[j].Height = row[j];
+		out[j].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	}
+}
+
+void WaveSolver::Disturb(UINT i, UINT j, float magnitude)
+{
+	// Don't disturb boundaries.
+	assert(i > 1 && i < m_numRows - 2);
+	assert(j > 1 && j < m_numCols - 2);
+
+	float halfMag = 0.5f*magnitude;
+	// Disturb the ijth vertex height and its neighbors.
+	m_currSolution[i*m_numCols + j] += magnitude;
+	m_currSolution[i*m_numCols + j + 1] += halfMag;
+	m_currSolution[i*m_numCols + j - 1] += halfMag;
+	m_currSolution[(i + 1)*m_numCols + j] += halfMag;
+	m_currSolution[(i - 1)*m_numCols + j] += halfMag;
+}
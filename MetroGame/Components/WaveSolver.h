@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+// Device independent height field solver for the CPU waves.
+// Only the heights are stepped, so they are kept in structure-of-arrays form
+// instead of full positions. The height step and the normal pass are fused into
+// one sweep and the grid is split into row bands which are solved in parallel.
+// On SSE/AVX the results are bit-for-bit identical to the scalar scheme.
+// Each step writes its heights and normals straight into a vertex stream, which is
+// meant to be mapped GPU memory, so no staging copy is needed.
+// The translation unit doesn't use the precompiled header, so that the solver
+// builds headless for its benchmark.
+
+namespace DXFramework
+{
+	// Dynamic part of a wave vertex; the grid positions live in a static stream.
+	struct WaveVertex
+	{
+		float Height;
+		DirectX::XMFLOAT3 Normal;
+	};
+
+	class WaveSolver
+	{
+	public:
+		WaveSolver();
+
+		// Throws std::invalid_argument for grids smaller than 3x3.
+		void Initialize(UINT m, UINT n, float dx, float dt, float speed, float damping);
+		// Accumulates time and returns true once a whole time step has passed.
+		// The caller should then call Step.
+		bool Advance(float dt);
+		// Steps the simulation and writes every vertex of the new solution into dest,
+		// boundaries included, so dest may be memory mapped with WRITE_DISCARD.
+		void Step(WaveVertex* dest);
+		void Disturb(UINT i, UINT j, float magnitude);
+
+	public:
+		UINT GetRowCount()const { return m_numRows; }
+		UINT GetColumnCount()const { return m_numCols; }
+		UINT GetVertexCount()const { return m_numRows*m_numCols; }
+		float GetTimeStep()const { return m_timeStep; }
+		float GetSpatialStep()const { return m_spatialStep; }
+		float GetWidth()const { return m_numCols*m_spatialStep; }
+		float GetDepth()const { return m_numRows*m_spatialStep; }
+
+		float GetHeight(UINT i)const { return m_currSolution[i]; }
+		const float* GetHeights()const { return m_currSolution.data(); }
+
+	private:
+		void StepBand(UINT r0, UINT r1, WaveVertex* dest);
+		void StepRow(UINT i);
+		void WriteRow(UINT i, const float* h, WaveVertex* dest);
+		void WriteBoundaryRow(UINT i, const float* h, WaveVertex* dest);
+
+	private:
+		// Rows per band handed to one worker.
+		static const UINT BandRows = 32;
+
+		UINT m_numRows;
+		UINT m_numCols;
+
+		float m_k[3];		// Simulation constants we can pre-compute.
+		float m_timeStep;
+		float m_spatialStep;
+		float m_time;
+
+		std::vector<float> m_prevSolution;
+		std::vector<float> m_currSolution;
+	};
+}
@@ -7,8 +7,8 @@
 #include <vector>
 #include "Common/DirectXHelper.h"
 #include "Common/MathHelper.h"
-#include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
+#include "Common/Profiler.h"
 
 using namespace Microsoft::WRL;
 using namespace DXFramework;
@@ -22,19 +22,11 @@ Waves::Waves(
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>>& perFrameCB,
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>>& perObjectCB)
 	: m_numRows(0), m_numCols(0), m_triangleCount(0), m_vertexCount(0),
-	m_timeStep(0.0f), m_spatialStep(0.0f), m_renderOptions(WavesRenderOption::Light3TexFog),
+	m_renderOptions(WavesRenderOption::Light3TexFog),
 	m_loadingComplete(false), m_initialized(false),
 	m_deviceResources(deviceResources), m_perFrameCB(perFrameCB),
 	m_perObjectCB(perObjectCB)
 {
-	m_k[0] = 0.0f;
-	m_k[1] = 0.0f;
-	m_k[2] = 0.0f;
-
-	m_currSolution = nullptr;
-	m_prevSolution = nullptr;
-	m_normals = nullptr;
-
 	XMStoreFloat4x4(&m_wavesTexTransform, XMMatrixIdentity());
 	XMStoreFloat4x4(&m_wavesWorld, XMMatrixIdentity());
 	m_wavesMat.Ambient = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
@@ -42,16 +34,6 @@ Waves::Waves(
 	m_wavesMat.Specular = XMFLOAT4(0.8f, 0.8f, 0.8f, 32.0f);
 }
 
-Waves::~Waves()
-{
-	if (m_prevSolution != nullptr)
-		delete[] m_prevSolution;
-	if (m_currSolution != nullptr)
-		delete[] m_currSolution;
-	if (m_normals != nullptr)
-		delete[] m_normals;
-}
-
 void Waves::Initialize(UINT m, UINT n, float dx, float dt, float speed, float damping, std::wstring texName)
 {
 	m_numRows = m;
@@ -61,43 +43,7 @@ void Waves::Initialize(UINT m, UINT n, float dx, float dt, float speed, float da
 	m_vertexCount = m*n;
 	m_triangleCount = (m - 1)*(n - 1) * 2;
 
-	m_timeStep = dt;
-	m_spatialStep = dx;
-
-	float d = damping*dt + 2.0f;
-	float e = (speed*speed)*(dt*dt) / (dx*dx);
-	m_k[0] = (damping*dt - 2.0f) / d;
-	m_k[1] = (4.0f - 8.0f*e) / d;
-	m_k[2] = (2.0f*e) / d;
-
-	if(m_prevSolution != nullptr)
-		delete[] m_prevSolution;
-	if(m_currSolution != nullptr)
-		delete[] m_currSolution;
-	if(m_normals != nullptr)
-		delete[] m_normals;
-
-	m_prevSolution = new XMFLOAT3[m*n];
-	m_currSolution = new XMFLOAT3[m*n];
-	m_normals = new XMFLOAT3[m*n];
-
-	// Generate grid vertices in system memory.
-
-	float halfWidth = (n - 1)*dx*0.5f;
-	float halfDepth = (m - 1)*dx*0.5f;
-
-	for (UINT i = 0; i < m; ++i)
-	{
-		float z = halfDepth - i*dx;
-		for (UINT j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j*dx;
-
-			m_prevSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-			m_currSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-			m_normals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-		}
-	}
+	m_solver.Initialize(m, n, dx, dt, speed, damping);
 
 	m_initialized = true;
 }
@@ -115,20 +61,20 @@ concurrency::task<void> Waves::CreateDeviceDependentResourcesAsync()
 
 	// Initialize constant buffer
 	if (!m_perFrameCB->GetInitalizeState())
-		m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
+		m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
 	if (!m_perObjectCB->GetInitalizeState())
-		m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+		m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	auto shaderMgr = ShaderMgr::Instance();
 	auto textureMgr = TextureMgr::Instance();
 
 	std::vector<concurrency::task<void>> CreateTasks;
 	// Load shaders
-	CreateTasks.push_back(shaderMgr->GetVSAsync(L"BasicVS0000.cso", InputLayoutType::Basic32)
+	CreateTasks.push_back(shaderMgr->GetVSAsync(L"WavesCpuVS.cso", InputLayoutType::PosXZTexHeightNormal)
 		.then([=](ID3D11VertexShader* vs)
 	{
 		m_wavesVS = vs;
-		m_wavesInputLayout = shaderMgr->GetInputLayout(InputLayoutType::Basic32);
+		m_wavesInputLayout = shaderMgr->GetInputLayout(InputLayoutType::PosXZTexHeightNormal);
 	}));
 	CreateTasks.push_back(shaderMgr->GetPSAsync(L"BasicPS00000300.cso")
 		.then([=](ID3D11PixelShader* ps) {m_wavesLight3PS = ps; }));
@@ -150,6 +96,8 @@ concurrency::task<void> Waves::CreateDeviceDependentResourcesAsync()
 
 void Waves::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("Waves::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
@@ -165,104 +113,18 @@ void Waves::Update(DX::GameTimer const& timer)
 		DWORD j = 5 + rand() % (m_numCols - 10);
 
 		float r = MathHelper::RandF(1.0f, 2.0f);
-		Disturb(i, j, r);
-	}
-	Update((float)timer.GetElapsedSeconds());
-
-	// Update the wave vertex buffer with the new solution.
-	D3D11_MAPPED_SUBRESOURCE mappedData;
-	ThrowIfFailed(m_deviceResources->GetD3DDeviceContext()->Map(m_wavesVB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
-	Basic32* v = reinterpret_cast<Basic32*>(mappedData.pData);
-	
-	float width = m_numCols*m_spatialStep;
-	float depth = m_numRows*m_spatialStep;
-
-	for (UINT i = 0; i < m_vertexCount; ++i)
-	{
-		v[i].Pos = m_currSolution[i];
-		v[i].Normal = m_normals[i];
-
-		// Derive texture-coordinates in [0,1] from position.
-		v[i].Tex.x = 0.5f + m_currSolution[i].x / width;
-		v[i].Tex.y = 0.5f - m_currSolution[i].z / depth;
+		m_solver.Disturb(i, j, r);
 	}
-	m_deviceResources->GetD3DDeviceContext()->Unmap(m_wavesVB.Get(), 0);
-}
-
-void Waves::Update(float dt)
-{
-	static float t = 0;
-
-	// Accumulate time.
-	t += dt;
-
-	// Only update the simulation at the specified time step.
-	if (t >= m_timeStep)
-	{
-		// Only update interior points; we use zero boundary conditions.
-		for (UINT i = 1; i < m_numRows - 1; ++i)
-		{
-			for (UINT j = 1; j < m_numCols - 1; ++j)
-			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				m_prevSolution[i*m_numCols + j].y =
-					m_k[0]*m_prevSolution[i*m_numCols + j].y +
-					m_k[1]*m_currSolution[i*m_numCols + j].y +
-					m_k[2]*(m_currSolution[(i + 1)*m_numCols + j].y +
-						m_currSolution[(i - 1)*m_numCols + j].y +
-						m_currSolution[i*m_numCols + j + 1].y +
-						m_currSolution[i*m_numCols + j - 1].y);
-			}
-		}
-
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(m_prevSolution, m_currSolution);
-
-		t = 0.0f; // reset time
 
-		// Compute normals using finite difference scheme.
-		for (UINT i = 1; i < m_numRows - 1; ++i)
-		{
-			for (UINT j = 1; j < m_numCols - 1; ++j)
-			{
-				float l = m_currSolution[i*m_numCols + j - 1].y;
-				float r = m_currSolution[i*m_numCols + j + 1].y;
-				float t = m_currSolution[(i - 1)*m_numCols + j].y;
-				float b = m_currSolution[(i + 1)*m_numCols + j].y;
-				m_normals[i*m_numCols + j].x = -r + l;
-				m_normals[i*m_numCols + j].y = 2.0f*m_spatialStep;
-				m_normals[i*m_numCols + j].z = b - t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&m_normals[i*m_numCols + j]));
-				XMStoreFloat3(&m_normals[i*m_numCols + j], n);
-			}
-		}
-	}
-}
+	// Only upload on frames where the solution actually changes. The solver
+	// writes straight into the mapped buffer.
+	if (!m_solver.Advance((float)timer.GetElapsedSeconds()))
+		return;
 
-void Waves::Disturb(UINT i, UINT j, float magnitude)
-{
-	// Don't disturb boundaries.
-	assert(i > 1 && i < m_numRows - 2);
-	assert(j > 1 && j < m_numCols - 2);
-
-	float halfMag = 0.5f*magnitude;
-	// Disturb the ijth vertex height and its neighbors.
-	m_currSolution[i*m_numCols + j].y += magnitude;
-	m_currSolution[i*m_numCols + j + 1].y += halfMag;
-	m_currSolution[i*m_numCols + j - 1].y += halfMag;
-	m_currSolution[(i + 1)*m_numCols + j].y += halfMag;
-	m_currSolution[(i - 1)*m_numCols + j].y += halfMag;
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	ThrowIfFailed(m_deviceResources->GetRenderContext()->Map(m_wavesVB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	m_solver.Step(reinterpret_cast<WaveVertex*>(mappedData.pData));
+	m_deviceResources->GetRenderContext()->Unmap(m_wavesVB.Get(), 0);
 }
 
 void Waves::Render()
@@ -271,23 +133,16 @@ void Waves::Render()
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Set IA stage.
-	UINT stride = sizeof(Basic32);
-	UINT offset = 0;
+	ID3D11Buffer* vbs[2] = { m_wavesStaticVB.Get(), m_wavesVB.Get() };
+	UINT strides[2] = { sizeof(PosXZTex), sizeof(WaveVertex) };
+	UINT offsets[2] = { 0, 0 };
 
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
-	if (ShaderChangement::InputLayout != m_wavesInputLayout.Get())
-	{
-		context->IASetInputLayout(m_wavesInputLayout.Get());
-		ShaderChangement::InputLayout = m_wavesInputLayout.Get();
-	}
-	context->IASetVertexBuffers(0, 1, m_wavesVB.GetAddressOf(), &stride, &offset);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->IASetInputLayout(m_wavesInputLayout.Get());
+	context->IASetVertexBuffers(0, 2, vbs, strides, offsets);
 	context->IASetIndexBuffer(m_wavesIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 
 	// Update per-object constant buffer.
@@ -305,35 +160,19 @@ void Waves::Render()
 	ID3D11Buffer* cbuffers[2] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer() };
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->AnisotropicSam() };
 	// vs
-	if (ShaderChangement::VS != m_wavesVS.Get())
-	{
-		context->VSSetShader(m_wavesVS.Get(), 0, 0);
-		ShaderChangement::VS = m_wavesVS.Get();
-	}
+	context->VSSetShader(m_wavesVS.Get(), 0, 0);
 	context->VSSetConstantBuffers(0, 2, cbuffers);
 	// ps
 	switch (m_renderOptions)
 	{
 	case WavesRenderOption::Light3:		// Light
-		if (ShaderChangement::PS != m_wavesLight3PS.Get())
-		{
-			context->PSSetShader(m_wavesLight3PS.Get(), 0, 0);
-			ShaderChangement::PS = m_wavesLight3PS.Get();
-		}
+		context->PSSetShader(m_wavesLight3PS.Get(), 0, 0);
 		break;
 	case WavesRenderOption::Light3Tex:		// LightTex
-		if (ShaderChangement::PS != m_wavesLight3TexPS.Get())
-		{
-			context->PSSetShader(m_wavesLight3TexPS.Get(), 0, 0);
-			ShaderChangement::PS = m_wavesLight3TexPS.Get();
-		}
+		context->PSSetShader(m_wavesLight3TexPS.Get(), 0, 0);
 		break;
 	case WavesRenderOption::Light3TexFog:		// LightTexFog
-		if (ShaderChangement::PS != m_wavesLight3TexFogPS.Get())
-		{
-			context->PSSetShader(m_wavesLight3TexFogPS.Get(), 0, 0);
-			ShaderChangement::PS = m_wavesLight3TexFogPS.Get();
-		}
+		context->PSSetShader(m_wavesLight3TexFogPS.Get(), 0, 0);
 		break;
 	default:
 		throw ref new Platform::InvalidArgumentException("No such render option");
@@ -356,6 +195,7 @@ void Waves::ReleaseDeviceDependentResources()
 {
 	m_loadingComplete = true;
 
+	m_wavesStaticVB.Reset();
 	m_wavesVB.Reset();
 	m_wavesIB.Reset();
 	m_wavesInputLayout.Reset();
@@ -368,15 +208,53 @@ void Waves::ReleaseDeviceDependentResources()
 
 void Waves::BuildWaveGeometryBuffers()
 {
-	// Create the vertex buffer.  Note that we allocate space only, as
-	// we will be updating the data every time step of the simulation.
+	// Create the static vertex buffer. The grid never moves in x and z, so
+	// positions and texture coordinates are uploaded once.
+	std::vector<PosXZTex> grid(m_vertexCount);
+	float dx = m_solver.GetSpatialStep();
+	float width = m_solver.GetWidth();
+	float depth = m_solver.GetDepth();
+	float halfWidth = (m_numCols - 1)*dx*0.5f;
+	float halfDepth = (m_numRows - 1)*dx*0.5f;
+	for (UINT i = 0; i < m_numRows; ++i)
+	{
+		float z = halfDepth - i*dx;
+		for (UINT j = 0; j < m_numCols; ++j)
+		{
+			UINT k = i*m_numCols + j;
+			float x = -halfWidth + j*dx;
+
+			grid[k].PosXZ = XMFLOAT2(x, z);
+			// Derive texture-coordinates in [0,1] from position.
+			grid[k].Tex.x = 0.5f + x / width;
+			grid[k].Tex.y = 0.5f - z / depth;
+		}
+	}
+
+	D3D11_BUFFER_DESC svbd;
+	svbd.Usage = D3D11_USAGE_IMMUTABLE;
+	svbd.ByteWidth = sizeof(PosXZTex) * m_vertexCount;
+	svbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	svbd.CPUAccessFlags = 0;
+	svbd.MiscFlags = 0;
+	D3D11_SUBRESOURCE_DATA sinitData;
+	sinitData.pSysMem = &grid[0];
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&svbd, &sinitData, m_wavesStaticVB.GetAddressOf()));
+
+	// Create the dynamic vertex buffer. It starts out flat and is rewritten
+	// every time step of the simulation.
+	WaveVertex flat = { 0.0f, XMFLOAT3(0.0f, 1.0f, 0.0f) };
+	std::vector<WaveVertex> heights(m_vertexCount, flat);
+
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_DYNAMIC;
-	vbd.ByteWidth = sizeof(Basic32) * m_vertexCount;
+	vbd.ByteWidth = sizeof(WaveVertex) * m_vertexCount;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	vbd.MiscFlags = 0;
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, 0, m_wavesVB.GetAddressOf()));
+	D3D11_SUBRESOURCE_DATA vinitData;
+	vinitData.pSysMem = &heights[0];
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&vbd, &vinitData, m_wavesVB.GetAddressOf()));
 
 
 	// Create the index buffer.  The index buffer is fixed, so we only 
@@ -410,6 +288,6 @@ void Waves::BuildWaveGeometryBuffers()
 	ibd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA iinitData;
 	iinitData.pSysMem = &indices[0];
-	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_wavesIB.GetAddressOf()));
+	ThrowIfFailed(m_deviceResources->GetRenderDevice()->CreateBuffer(&ibd, &iinitData, m_wavesIB.GetAddressOf()));
 }
 	
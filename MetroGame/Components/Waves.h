@@ -7,6 +7,7 @@
 #include "Common/GameTimer.h"
 #include "Common/ConstantBuffer.h"
 #include "Common/DeviceResources.h"
+#include "WaveSolver.h"
 
 // Waves simulation without computer shaders.
 
@@ -25,7 +26,6 @@ namespace DXFramework
 		Waves(const std::shared_ptr<DX::DeviceResources>& deviceResources,
 			const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>>& perFrameCB,
 			const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>>& perObjectCB);
-		~Waves();
 
 		void Initialize(UINT m, UINT n, float dx, float dt, float speed, float damping, std::wstring texName);
 		concurrency::task<void> CreateDeviceDependentResourcesAsync();
@@ -40,12 +40,10 @@ namespace DXFramework
 		void SetTexTransform(const DirectX::XMFLOAT4X4& trans) { m_wavesTexTransform = trans; }
 		void SetRenderOption(WavesRenderOption r) { m_renderOptions = r; }
 		void UpdateTextureSRV(ID3D11ShaderResourceView* srv) { m_wavesMapSRV = srv; }
-		float GetWidth()const { return m_numCols*m_spatialStep; }
-		float GetDepth()const { return m_numRows*m_spatialStep; }
+		float GetWidth()const { return m_solver.GetWidth(); }
+		float GetDepth()const { return m_solver.GetDepth(); }
 
 	private:
-		void Update(float dt);
-		void Disturb(UINT i, UINT j, float magnitude);
 		void BuildWaveGeometryBuffers();
 
 	private:
@@ -55,6 +53,9 @@ namespace DXFramework
 		std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>> m_perObjectCB;
 
 		// Direct3D data resources 
+		// The static stream holds the grid positions and texture coordinates, the
+		// dynamic stream receives heights and normals from the solver.
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_wavesStaticVB;
 		Microsoft::WRL::ComPtr<ID3D11Buffer> m_wavesVB;
 		Microsoft::WRL::ComPtr<ID3D11Buffer> m_wavesIB;
 
@@ -81,18 +82,7 @@ namespace DXFramework
 		DirectX::XMFLOAT4X4 m_wavesWorld;
 		WavesRenderOption m_renderOptions;
 
-		float m_k[3];		// Simulation constants we can pre-compute.
-		float m_timeStep;
-		float m_spatialStep;
-
-		DirectX::XMFLOAT3* m_prevSolution;
-		DirectX::XMFLOAT3* m_currSolution;
-		DirectX::XMFLOAT3* m_normals;
-
-		// Warning! Using smart pointer will cause a worse performance.
-		//std::unique_ptr<DirectX::XMFLOAT3[]> m_prevSolution;
-		//std::unique_ptr<DirectX::XMFLOAT3[]> m_currSolution;
-		//std::unique_ptr<DirectX::XMFLOAT3[]> m_normals;
+		WaveSolver m_solver;
 
 		bool m_initialized;
 		bool m_loadingComplete;
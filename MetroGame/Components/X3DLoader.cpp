@@ -1,10 +1,6 @@
-#include "pch.h"
 #include "X3DLoader.h"
-#include "Common/DirectXHelper.h"
-#include "Common/MathHelper.h"
-#include <fstream>
+#include "Common/Profiler.h"
 
-using namespace Microsoft::WRL;
 using namespace DXFramework;
 using namespace DirectX;
 
@@ -12,14 +8,187 @@ using namespace DX;
 
 // Note: do not use wifstream to read ASCII data. It is too slow.
 
-void X3DLoader::LoadX3dStatic(const std::wstring& filename,
+// v2 sections are used in place, so the vertex layouts must not drift from the file format.
+static_assert(sizeof(PosNormalTexTan) == 44, "PosNormalTexTan doesn't match the .x3d v2 layout");
+static_assert(sizeof(PosNormalTexTanSkinned) == 60, "PosNormalTexTanSkinned doesn't match the .x3d v2 layout");
+static_assert(sizeof(Subset) == 16, "Subset doesn't match the .x3d v2 layout");
+static_assert(sizeof(X3dSection) == 16 && sizeof(X3dHeader) == 16, "The .x3d v2 header must stay 16 byte aligned");
+static_assert(sizeof(X3dCompressedBone) == 64, "X3dCompressedBone doesn't match the .x3d v2 layout");
+
+namespace
+{
+	// Gives a mapped section the ifstream::read interface, so materials and
+	// animation clips share their decoding with the v1 path.
+	class SectionReader
+	{
+	public:
+		SectionReader(const BYTE* data, size_t size) : m_cur(data), m_end(data + size) {}
+
+		void read(char* dest, size_t count)
+		{
+			if (count > size_t(m_end - m_cur))
+				throw std::runtime_error("Corrupted .x3d section!");
+			memcpy(dest, m_cur, count);
+			m_cur += count;
+		}
+
+	private:
+		const BYTE* m_cur;
+		const BYTE* m_end;
+	};
+
+	std::ifstream OpenBinary(const std::wstring& filename)
+	{
+#if defined(_WIN32)
+		return std::ifstream(filename, std::ios::binary);
+#else
+		// Only MSVC opens streams by wide names; the names used are ASCII.
+		return std::ifstream(std::string(filename.begin(), filename.end()), std::ios::binary);
+#endif
+	}
+
+	// Whether the indices of the subset are in the section and, offset by its
+	// VertexBase, name vertices of the file.
+	template<typename Index>
+	bool SubsetInBounds(const Subset& subset, X3dSpan<Index> indices, UINT numVertices)
+	{
+		if (UINT64(subset.IndexStart) + subset.IndexCount > indices.size())
+			return false;
+		for (UINT i = subset.IndexStart; i < subset.IndexStart + subset.IndexCount; ++i)
+		{
+			if (UINT64(subset.VertexBase) + indices[i] >= numVertices)
+				return false;
+		}
+		return true;
+	}
+}
+
+X3dFile::X3dFile()
+	: m_sections(nullptr)
+{
+	ZeroMemory(&m_header, sizeof(X3dHeader));
+}
+
+bool X3dFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	if (!m_file.Open(filename) || m_file.GetSize() < sizeof(X3dHeader))
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&m_header, m_file.GetData(), sizeof(X3dHeader));
+	if (m_header.Magic != X3dMagic)
+	{
+		Close();
+		return false;
+	}
+
+	size_t fileSize = m_file.GetSize();
+	if (m_header.Version != X3dVersion ||
+		sizeof(X3dHeader) + UINT64(m_header.SectionCount) * sizeof(X3dSection) > fileSize)
+		throw std::runtime_error("Unsupported .x3d file!");
+
+	m_sections = reinterpret_cast<const X3dSection*>(m_file.GetData() + sizeof(X3dHeader));
+	for (UINT i = 0; i < m_header.SectionCount; ++i)
+	{
+		const X3dSection& section = m_sections[i];
+		if (section.Offset % X3dSectionAlignment != 0 || UINT64(section.Offset) + section.Size > fileSize)
+			throw std::runtime_error("Corrupted .x3d section!");
+	}
+
+	// The subsets are drawn and rasterized straight from the mapped sections.
+	const X3dSection* materials = FindSection(X3dSectionId::Materials);
+	UINT numMaterials = materials ? materials->Count : 0;
+	UINT numVertices = IsSkinned() ? GetSkinnedVertices().size() : GetVertices().size();
+	auto indices = GetIndices();
+	auto indices16 = GetIndices16();
+	for (const Subset& subset : GetSubsets())
+	{
+		bool inBounds = subset.MtlIndex < numMaterials &&
+			(!indices.empty() || !indices16.empty() || subset.IndexCount == 0) &&
+			(indices.empty() || SubsetInBounds(subset, indices, numVertices)) &&
+			(indices16.empty() || SubsetInBounds(subset, indices16, numVertices));
+		if (!inBounds)
+			throw std::runtime_error("Corrupted .x3d subset!");
+	}
+
+	return true;
+}
+
+void X3dFile::Close()
+{
+	m_file.Close();
+	ZeroMemory(&m_header, sizeof(X3dHeader));
+	m_sections = nullptr;
+}
+
+const X3dSection* X3dFile::FindSection(X3dSectionId id)const
+{
+	for (UINT i = 0; i < m_header.SectionCount; ++i)
+	{
+		if (m_sections[i].Id == (UINT)id)
+			return &m_sections[i];
+	}
+	return nullptr;
+}
+
+void X3dFile::ReadMaterials(std::vector<X3dMaterial>& mats)const
+{
+	const X3dSection* section = FindSection(X3dSectionId::Materials);
+	if (section == nullptr)
+	{
+		mats.clear();
+		return;
+	}
+	SectionReader reader(m_file.GetData() + section->Offset, section->Size);
+	X3DLoader::ReadMaterials(reader, section->Count, mats);
+}
+
+void X3dFile::ReadAnimationClips(UINT numBones, std::map<std::wstring, AnimationClip>& animations)const
+{
+	const X3dSection* section = FindSection(X3dSectionId::CompressedClips);
+	if (section != nullptr)
+	{
+		SectionReader reader(m_file.GetData() + section->Offset, section->Size);
+		X3DLoader::ReadCompressedClips(reader, numBones, section->Count, animations);
+		return;
+	}
+
+	section = FindSection(X3dSectionId::AnimationClips);
+	if (section == nullptr)
+		return;
+	SectionReader reader(m_file.GetData() + section->Offset, section->Size);
+	X3DLoader::ReadAnimationClips(reader, numBones, section->Count, animations);
+}
+
+std::shared_ptr<const X3dFile> X3DLoader::LoadX3dStatic(const std::wstring& filename,
 	std::vector<PosNormalTexTan>& vertices,
 	std::vector<UINT>& indices,
 	std::vector<Subset>& subsets,
 	std::vector<X3dMaterial>& mats)
 {
+	DX_PROFILE_ZONE("X3DLoader::LoadX3dStatic");
+
+	// v2 files are mapped, and their vertices and indices are used from there.
+	auto file = std::make_shared<X3dFile>();
+	if (file->Open(filename))
+	{
+		if (file->IsSkinned())
+			throw std::runtime_error("Can not load a skinned .x3d model as a static one!");
+
+		auto fileSubsets = file->GetSubsets();
+		file->ReadMaterials(mats);
+		subsets.assign(fileSubsets.begin(), fileSubsets.end());
+		vertices.clear();
+		indices.clear();
+		return file;
+	}
+
 	// Read binary data
-	std::ifstream fin(filename, std::ios::binary);
+	std::ifstream fin = OpenBinary(filename);
 
 	UINT numMaterials = 0;
 	UINT numSubsets = 0;
@@ -38,20 +207,45 @@ void X3DLoader::LoadX3dStatic(const std::wstring& filename,
 		ReadVertices(fin, numVertices, vertices);
 		ReadIndices(fin, numIndices, indices);
 
-		return;
+		return nullptr;
 	}
-	throw ref new Platform::FailureException("Can not load .m3d model!");
+	throw std::runtime_error("Can not load .m3d model!");
 }
 
-void X3DLoader::LoadX3dSkinned(const std::wstring& filename,
+std::shared_ptr<const X3dFile> X3DLoader::LoadX3dSkinned(const std::wstring& filename,
 	std::vector<PosNormalTexTanSkinned>& vertices,
 	std::vector<UINT>& indices,
 	std::vector<Subset>& subsets,
 	std::vector<X3dMaterial>& mats,
 	SkinnedData& skinInfo)
 {
+	DX_PROFILE_ZONE("X3DLoader::LoadX3dSkinned");
+
+	// v2 files are mapped, and their vertices and indices are used from there.
+	auto file = std::make_shared<X3dFile>();
+	if (file->Open(filename))
+	{
+		if (!file->IsSkinned())
+			throw std::runtime_error("The .x3d model has no skinning data!");
+
+		auto fileSubsets = file->GetSubsets();
+		auto fileBoneOffsets = file->GetBoneOffsets();
+
+		std::vector<XMFLOAT4X4> boneOffsets(fileBoneOffsets.begin(), fileBoneOffsets.end());
+		std::map<std::wstring, AnimationClip> animations;
+
+		file->ReadMaterials(mats);
+		subsets.assign(fileSubsets.begin(), fileSubsets.end());
+		vertices.clear();
+		indices.clear();
+		file->ReadAnimationClips(fileBoneOffsets.size(), animations);
+
+		skinInfo.Initialize(boneOffsets, animations);
+		return file;
+	}
+
 	// Read binary data
-	std::ifstream fin(filename, std::ios::binary);
+	std::ifstream fin = OpenBinary(filename);
 
 	UINT numMaterials = 0;
 	UINT numSubsets = 0;
@@ -81,13 +275,13 @@ void X3DLoader::LoadX3dSkinned(const std::wstring& filename,
 
 		skinInfo.Initialize(boneOffsets, animations);
 
-		return;
+		return nullptr;
 	}
-	throw ref new Platform::FailureException("Can not load .m3d model!");
+	throw std::runtime_error("Can not load .m3d model!");
 }
 
-
-void X3DLoader::ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<X3dMaterial>& mats)
+template<typename Stream>
+void X3DLoader::ReadMaterials(Stream& fin, UINT numMaterials, std::vector<X3dMaterial>& mats)
 {
 	mats.resize(numMaterials);
 	std::string diffuseMapName, normalMapName;
@@ -169,10 +363,10 @@ void X3DLoader::ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::v
 		item.Weights.y = weights[1];
 		item.Weights.z = weights[2];
 
-		item.BoneIndices[0] = (byte)boneIndices[0];
-		item.BoneIndices[1] = (byte)boneIndices[1];
-		item.BoneIndices[2] = (byte)boneIndices[2];
-		item.BoneIndices[3] = (byte)boneIndices[3];
+		item.BoneIndices[0] = (BYTE)boneIndices[0];
+		item.BoneIndices[1] = (BYTE)boneIndices[1];
+		item.BoneIndices[2] = (BYTE)boneIndices[2];
+		item.BoneIndices[3] = (BYTE)boneIndices[3];
 	}
 }
 
@@ -184,7 +378,8 @@ void X3DLoader::ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<X
 		fin.read((char*)&item, sizeof(XMFLOAT4X4));
 }
 
-void X3DLoader::ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAnimationClips,
+template<typename Stream>
+void X3DLoader::ReadAnimationClips(Stream& fin, UINT numBones, UINT numAnimationClips,
 	std::map<std::wstring, AnimationClip>& animations)
 {
 	for (UINT clipIndex = 0; clipIndex < numAnimationClips; ++clipIndex)
@@ -200,14 +395,15 @@ void X3DLoader::ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAn
 
 		for (UINT boneIndex = 0; boneIndex < numBones; ++boneIndex)
 		{
-			ReadBoneKeyframes(fin, numBones, clip.BoneAnimations[boneIndex]);
+			ReadBoneKeyframes(fin, clip.BoneAnimations[boneIndex]);
 		}
 
 		animations[std::wstring(clipName.begin(), clipName.end())] = clip;
 	}
 }
 
-void X3DLoader::ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimation& boneAnimation)
+template<typename Stream>
+void X3DLoader::ReadBoneKeyframes(Stream& fin, BoneAnimation& boneAnimation)
 {
 	UINT numKeyframes = 0;
 	fin.read((char*)&numKeyframes, sizeof(int));
@@ -231,3 +427,55 @@ void X3DLoader::ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimati
 	}
 }
 
+template<typename Stream>
+void X3DLoader::ReadCompressedClips(Stream& fin, UINT numBones, UINT numAnimationClips,
+	std::map<std::wstring, AnimationClip>& animations)
+{
+	for (UINT clipIndex = 0; clipIndex < numAnimationClips; ++clipIndex)
+	{
+		int intTemp;
+		std::string clipName;
+		fin.read((char*)&intTemp, sizeof(int));
+		clipName.resize(intTemp);
+		fin.read((char*)&clipName[0], intTemp);
+
+		AnimationClip& clip = animations[std::wstring(clipName.begin(), clipName.end())];
+		clip.BoneAnimations.resize(numBones);
+
+		for (UINT boneIndex = 0; boneIndex < numBones; ++boneIndex)
+		{
+			ReadCompressedBone(fin, clip.BoneAnimations[boneIndex]);
+		}
+	}
+}
+
+template<typename Stream>
+void X3DLoader::ReadCompressedBone(Stream& fin, BoneAnimation& boneAnimation)
+{
+	X3dCompressedBone bone;
+	fin.read((char*)&bone, sizeof(X3dCompressedBone));
+	if (bone.KeyCount == 0)
+		throw std::runtime_error("Corrupted .x3d section!");
+
+	// The keys stay quantized; only the track offsets are worked out here.
+	CompressedKeyframes& keys = boneAnimation.Compressed;
+	keys.StartTime = bone.StartTime;
+	keys.Duration = bone.Duration;
+	keys.Flags = bone.Flags;
+	keys.KeyCount = bone.KeyCount;
+	keys.TranslationMin = bone.TranslationMin;
+	keys.TranslationExtent = bone.TranslationExtent;
+	keys.ScaleMin = bone.ScaleMin;
+	keys.ScaleExtent = bone.ScaleExtent;
+
+	UINT rotationCount = (bone.Flags & CompressedKeyframes::ConstantRotation) ? 1 : bone.KeyCount;
+	UINT translationCount = (bone.Flags & CompressedKeyframes::ConstantTranslation) ? 0 : bone.KeyCount;
+	UINT scaleCount = (bone.Flags & CompressedKeyframes::ConstantScale) ? 0 : bone.KeyCount;
+	keys.RotationOffset = bone.KeyCount;
+	keys.TranslationOffset = keys.RotationOffset + rotationCount * 3;
+	keys.ScaleOffset = keys.TranslationOffset + translationCount * 3;
+
+	keys.Data.resize(keys.ScaleOffset + scaleCount * 3);
+	fin.read((char*)keys.Data.data(), keys.Data.size() * sizeof(USHORT));
+	boneAnimation.Keyframes.clear();
+}
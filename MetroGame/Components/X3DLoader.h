@@ -1,21 +1,150 @@
 #pragma once
 
 #include <DirectXMath.h>
-#include <sstream>
-#include "Common/ShaderMgr.h"
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include "Common/VertexTypes.h"
+#include "Common/MappedFile.h"
 #include "MeshGeometry.h"
 
 namespace DXFramework
 {
+	// .x3d v2 layout. A 16 byte header is followed by a table of sections and every
+	// section starts on a 16 byte boundary. Subsets, vertices, indices and bone offsets
+	// are stored in the engine's in-memory layout, so they can be used directly from
+	// the mapped file. Materials and animation clips keep their v1 encoding.
+	// v1 files have no header and start with the material count.
+	//
+	// CompressedClips replaces AnimationClips. Per clip it holds the length prefixed
+	// name, then for every bone an X3dCompressedBone followed by KeyCount quantized
+	// times, the smallest three rotations (3 values per key, 1 key if constant) and
+	// the quantized translations and scales (3 values per key, none if constant).
+	// See CompressedKeyframes in MeshGeometry.h.
+	// The translation unit doesn't use the precompiled header, so that the loader
+	// builds headless for its benchmark.
+	struct X3dHeader
+	{
+		UINT Magic;
+		UINT Version;
+		UINT Flags;
+		UINT SectionCount;
+	};
+
+	struct X3dSection
+	{
+		UINT Id;
+		UINT Count;		// Number of elements
+		UINT Offset;	// From the beginning of the file
+		UINT Size;		// In bytes
+	};
+
+	enum class X3dSectionId : UINT
+	{
+		Materials,
+		Subsets,
+		Vertices,
+		SkinnedVertices,
+		Indices,
+		BoneOffsets,
+		AnimationClips,
+		Indices16,
+		CompressedClips
+	};
+
+	struct X3dCompressedBone
+	{
+		float StartTime;
+		float Duration;
+		UINT Flags;					// CompressedKeyframes::Constant*
+		UINT KeyCount;
+		DirectX::XMFLOAT3 TranslationMin;
+		DirectX::XMFLOAT3 TranslationExtent;
+		DirectX::XMFLOAT3 ScaleMin;
+		DirectX::XMFLOAT3 ScaleExtent;
+	};
+
+	const UINT X3dMagic = 0x32443358;	// "X3D2"
+	const UINT X3dVersion = 2;
+	const UINT X3dSkinnedFlag = 0x1;
+	const UINT X3dSectionAlignment = 16;
+
+	// Read only view of a section, valid as long as the X3dFile it came from.
+	template<typename T>
+	struct X3dSpan
+	{
+		X3dSpan() : Data(nullptr), Count(0) {}
+		X3dSpan(const T* data, UINT count) : Data(data), Count(count) {}
+
+		const T* begin()const { return Data; }
+		const T* end()const { return Data + Count; }
+		UINT size()const { return Count; }
+		bool empty()const { return Count == 0; }
+		const T& operator[](UINT i)const { return Data[i]; }
+
+		const T* Data;
+		UINT Count;
+	};
+
+	// Memory mapped .x3d v2 file.
+	class X3dFile
+	{
+	public:
+		X3dFile();
+
+		// Returns false if the file can not be mapped or isn't a v2 file.
+		// Throws if it claims to be v2 but the section table is broken, or a subset
+		// reaches past the indices, vertices or materials of the file.
+		bool Open(const std::wstring& filename);
+		void Close();
+
+		bool IsSkinned()const { return (m_header.Flags & X3dSkinnedFlag) != 0; }
+		bool HasCompressedClips()const { return FindSection(X3dSectionId::CompressedClips) != nullptr; }
+
+		X3dSpan<Subset> GetSubsets()const { return GetSection<Subset>(X3dSectionId::Subsets); }
+		X3dSpan<DX::PosNormalTexTan> GetVertices()const { return GetSection<DX::PosNormalTexTan>(X3dSectionId::Vertices); }
+		X3dSpan<DX::PosNormalTexTanSkinned> GetSkinnedVertices()const { return GetSection<DX::PosNormalTexTanSkinned>(X3dSectionId::SkinnedVertices); }
+		X3dSpan<UINT> GetIndices()const { return GetSection<UINT>(X3dSectionId::Indices); }
+		// Only present if the vertices of every subset span at most 65536.
+		X3dSpan<USHORT> GetIndices16()const { return GetSection<USHORT>(X3dSectionId::Indices16); }
+		X3dSpan<DirectX::XMFLOAT4X4> GetBoneOffsets()const { return GetSection<DirectX::XMFLOAT4X4>(X3dSectionId::BoneOffsets); }
+
+		void ReadMaterials(std::vector<X3dMaterial>& mats)const;
+		void ReadAnimationClips(UINT numBones, std::map<std::wstring, AnimationClip>& animations)const;
+
+	private:
+		const X3dSection* FindSection(X3dSectionId id)const;
+
+		template<typename T>
+		X3dSpan<T> GetSection(X3dSectionId id)const
+		{
+			const X3dSection* section = FindSection(id);
+			if (section == nullptr)
+				return X3dSpan<T>();
+			// 64-bit, so that the product can't wrap around on 32-bit platforms.
+			if (UINT64(section->Count) * sizeof(T) != section->Size)
+				throw std::runtime_error("Corrupted .x3d section!");
+			return X3dSpan<T>(reinterpret_cast<const T*>(m_file.GetData() + section->Offset), section->Count);
+		}
+
+	private:
+		DX::MappedFile m_file;
+		X3dHeader m_header;
+		const X3dSection* m_sections;
+	};
+
 	class X3DLoader
 	{
 	public:
-		static void LoadX3dStatic(const std::wstring& filename,
+		// v2 files stay mapped and are returned: their vertices and indices are used
+		// in place, through X3dFile::GetVertices and the like, and vertices and
+		// indices are left empty. v1 files are read into them and nullptr is returned.
+		static std::shared_ptr<const X3dFile> LoadX3dStatic(const std::wstring& filename,
 			std::vector<DX::PosNormalTexTan>& vertices,
 			std::vector<UINT>& indices,
 			std::vector<Subset>& subsets,
 			std::vector<X3dMaterial>& mats);
-		static void X3DLoader::LoadX3dSkinned(const std::wstring& filename,
+		static std::shared_ptr<const X3dFile> LoadX3dSkinned(const std::wstring& filename,
 			std::vector<DX::PosNormalTexTanSkinned>& vertices,
 			std::vector<UINT>& indices,
 			std::vector<Subset>& subsets,
@@ -23,16 +152,22 @@ namespace DXFramework
 			SkinnedData& skinInfo);
 
 	private:
-		static void ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<X3dMaterial>& mats);
+		friend class X3dFile;
+
+		template<typename Stream>
+		static void ReadMaterials(Stream& fin, UINT numMaterials, std::vector<X3dMaterial>& mats);
 		static void ReadSubsetTable(std::ifstream& fin, UINT numSubsets, std::vector<Subset>& subsets);
 		static void ReadVertices(std::ifstream& fin, UINT numVertices, std::vector<DX::PosNormalTexTan>& vertices);
 		static void ReadIndices(std::ifstream& fin, UINT numTriangles, std::vector<UINT>& indices);
 		static void ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::vector<DX::PosNormalTexTanSkinned>& vertices);
 		static void ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<DirectX::XMFLOAT4X4>& boneOffsets);
-		static void ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAnimationClips, std::map<std::wstring, AnimationClip>& animations);
-		static void ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimation& boneAnimation);
+		template<typename Stream>
+		static void ReadAnimationClips(Stream& fin, UINT numBones, UINT numAnimationClips, std::map<std::wstring, AnimationClip>& animations);
+		template<typename Stream>
+		static void ReadBoneKeyframes(Stream& fin, BoneAnimation& boneAnimation);
+		template<typename Stream>
+		static void ReadCompressedClips(Stream& fin, UINT numBones, UINT numAnimationClips, std::map<std::wstring, AnimationClip>& animations);
+		template<typename Stream>
+		static void ReadCompressedBone(Stream& fin, BoneAnimation& boneAnimation);
 	};
 }
-
-
-
@@ -4,7 +4,7 @@
 #include "Common\MathHelper.h"
 #include "Common\GeometryGenerator.h"
 #include "Common\BasicReaderWriter.h"
-#include "Common\ShaderChangement.h"
+#include "Common\Profiler.h"
 #include <fstream>
 
 using namespace DXFramework;
@@ -75,8 +75,8 @@ void DynamicMapObjectsRenderer::CreateDeviceDependentResources()
 	}
 
 	// Initialize constant buffer
-	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
-	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
+	m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	m_centerSphere->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -115,6 +115,8 @@ void DynamicMapObjectsRenderer::CreateWindowSizeDependentResources()
 // Called once per frame, rotates the cube and calculates the model and view matrices.
 void DynamicMapObjectsRenderer::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("DynamicMapObjectsRenderer::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
@@ -133,13 +135,15 @@ void DynamicMapObjectsRenderer::Update(DX::GameTimer const& timer)
 // Renders one frame using the vertex and pixel shaders.
 void DynamicMapObjectsRenderer::Render()
 {
+	DX_PROFILE_ZONE("DynamicMapObjectsRenderer::Render");
+
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
-	ComPtr<ID3D11DeviceContext> context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 	// Update per-frame constant buffer
 	XMMATRIX view = m_camera->View();
 	XMMATRIX proj = m_camera->Proj();
@@ -160,22 +164,26 @@ void DynamicMapObjectsRenderer::Render()
 	m_perFrameCB->Data.FogRange = 60.0f;
 	m_perFrameCB->Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
 
-	m_perFrameCB->ApplyChanges(context.Get());
+	m_perFrameCB->ApplyChanges(context);
 
 	m_dynamicCube->Render([&]()
 	{
-		m_skull->Render();
-		m_sphere->Render();
-		m_base->Render(true);
+		m_renderQueue.Begin(RenderPass::Color);
+		m_skull->Submit(m_renderQueue);
+		m_sphere->Submit(m_renderQueue);
+		m_base->Submit(m_renderQueue);
+		m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 		m_sky->Render();
 	});
 
 	m_centerSphere->UpdateReflectMapSRV(m_dynamicCube->GetDynamicCubeMapSRV());
 
-	m_centerSphere->Render();
-	m_skull->Render();
-	m_sphere->Render();
-	m_base->Render(true);
+	m_renderQueue.Begin(RenderPass::Color);
+	m_centerSphere->Submit(m_renderQueue);
+	m_skull->Submit(m_renderQueue);
+	m_sphere->Submit(m_renderQueue);
+	m_base->Submit(m_renderQueue);
+	m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 	m_sky->Render();
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Content\SceneRenderer.h"
 #include "Common\GameTimer.h"
 #include "Common\DeviceResources.h"
 #include "Common\Camera.h"
@@ -15,7 +16,7 @@
 namespace DXFramework
 {
 	// This sample renderer instantiates a basic rendering pipeline.
-	class DynamicMapObjectsRenderer
+	class DynamicMapObjectsRenderer : public SceneRenderer
 	{
 	public:
 		DynamicMapObjectsRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources, const std::shared_ptr<DX::Camera>& camera);
@@ -49,6 +50,7 @@ namespace DXFramework
 		std::shared_ptr<DX::Camera> m_camera;
 		std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>> m_perFrameCB;
 		std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>> m_perObjectCB;
+		DX::RenderQueue m_renderQueue;
 		
 		// Custom data
 		std::unique_ptr<BasicObject> m_centerSphere;
@@ -5,7 +5,7 @@
 #include "Common\MathHelper.h"
 #include "Common\GeometryGenerator.h"
 #include "Common\BasicReaderWriter.h"
-#include "Common\ShaderChangement.h"
+#include "Common\Profiler.h"
 #include <sstream>
 
 
@@ -76,8 +76,8 @@ void GPUWavesRenderer::CreateDeviceDependentResources()
 	}
 
 	// Initialize constant buffer
-	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
-	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
+	m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	m_waves->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -108,6 +108,8 @@ void GPUWavesRenderer::CreateWindowSizeDependentResources()
 // Called once per frame, rotates the cube and calculates the model and view matrices.
 void GPUWavesRenderer::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("GPUWavesRenderer::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
@@ -131,6 +133,8 @@ void GPUWavesRenderer::Update(DX::GameTimer const& timer)
 // Renders one frame using the vertex and pixel shaders.
 void GPUWavesRenderer::Render()
 {
+	DX_PROFILE_ZONE("GPUWavesRenderer::Render");
+
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
@@ -138,7 +142,7 @@ void GPUWavesRenderer::Render()
 	}
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ComPtr<ID3D11DeviceContext> context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Update per-frame constant buffer
 	XMMATRIX view = m_camera->View();
@@ -160,11 +164,13 @@ void GPUWavesRenderer::Render()
 	m_perFrameCB->Data.FogRange = 250.0f;
 	XMStoreFloat4(&m_perFrameCB->Data.FogColor, Colors::Silver);
 
-	m_perFrameCB->ApplyChanges(context.Get());
+	m_perFrameCB->ApplyChanges(context);
 
-	m_land->Render();
-	m_crate->Render(true);
-	m_trees->Render();
+	m_renderQueue.Begin(RenderPass::Color);
+	m_land->Submit(m_renderQueue);
+	m_crate->Submit(m_renderQueue);
+	m_trees->Submit(m_renderQueue);
+	m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 	m_waves->Render();
 }
 
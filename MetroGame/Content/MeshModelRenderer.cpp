@@ -4,7 +4,7 @@
 #include "Common\MathHelper.h"
 #include "Common\GeometryGenerator.h"
 #include "Common\BasicReaderWriter.h"
-#include "Common\ShaderChangement.h"
+#include "Common\Profiler.h"
 #include <fstream>
 
 using namespace DXFramework;
@@ -65,8 +65,8 @@ void MeshModelRenderer::CreateDeviceDependentResources()
 	}
 
 	// Initialize constant buffer
-	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
-	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
+	m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	m_mesh->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -85,6 +85,8 @@ void MeshModelRenderer::CreateWindowSizeDependentResources()
 // Called once per frame, rotates the cube and calculates the model and view matrices.
 void MeshModelRenderer::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("MeshModelRenderer::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
@@ -104,13 +106,15 @@ void MeshModelRenderer::Update(DX::GameTimer const& timer)
 // Renders one frame using the vertex and pixel shaders.
 void MeshModelRenderer::Render()
 {
+	DX_PROFILE_ZONE("MeshModelRenderer::Render");
+
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
-	ComPtr<ID3D11DeviceContext> context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 	// Update per-frame constant buffer
 	XMMATRIX view = m_camera->View();
 	XMMATRIX proj = m_camera->Proj();
@@ -131,13 +135,15 @@ void MeshModelRenderer::Render()
 	m_perFrameCB->Data.FogRange = 60.0f;
 	m_perFrameCB->Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
 
-	m_perFrameCB->ApplyChanges(context.Get());
+	m_perFrameCB->ApplyChanges(context);
 	
 
 	auto renderStateMgr = RenderStateMgr::Instance();
 	context->RSSetState(renderStateMgr->NoCullRS());
 
-	m_mesh->Render(true);
+	m_renderQueue.Begin(RenderPass::Color);
+	m_mesh->Submit(m_renderQueue);
+	m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 }
 
 void MeshModelRenderer::ReleaseDeviceDependentResources()
@@ -154,7 +160,7 @@ void MeshModelRenderer::InitMesh()
 	MeshObjectData* objectData = new MeshObjectData();
 	MeshFeatureConfigure objectFeature = { 0 };
 	objectData->Skinned = false;
-	X3DLoader::LoadX3dStatic(L"Media\\Meshes\\Eagle\\Eagle.x3d", objectData->VertexData, objectData->IndexData, objectData->Subsets, objectData->Material);
+	objectData->Source = X3DLoader::LoadX3dStatic(L"Media\\Meshes\\Eagle\\Eagle.x3d", objectData->VertexData, objectData->IndexData, objectData->Subsets, objectData->Material);
 	
 	objectData->Worlds.resize(1);
 	// Reflect to change coordinate system from the RHS the data was exported out as.
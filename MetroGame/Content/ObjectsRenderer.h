@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Content\SceneRenderer.h"
 #include "Common\GameTimer.h"
 #include "Common\DeviceResources.h"
 #include "Common\Camera.h"
@@ -14,7 +15,7 @@
 namespace DXFramework
 {
 	// This sample renderer instantiates a basic rendering pipeline.
-	class ObjectsRenderer
+	class ObjectsRenderer : public SceneRenderer
 	{
 	public:
 		ObjectsRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources, const std::shared_ptr<DX::Camera>& camera);
@@ -47,11 +48,13 @@ namespace DXFramework
 		std::shared_ptr<DX::Camera> m_camera;
 		std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>> m_perFrameCB;
 		std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>> m_perObjectCB;
+		DX::RenderQueue m_renderQueue;
 		
 		// Custom data
 		std::unique_ptr<BasicObject> m_skull;
 		std::unique_ptr<BasicObject> m_sphere;
 		std::unique_ptr<BasicObject> m_base;
+		std::shared_ptr<DX::OcclusionCuller> m_occlusionCuller;
 		std::unique_ptr<Sky> m_sky;
 		DX::DirectionalLight m_dirLights[3];
 
@@ -5,7 +5,7 @@
 #include "Common\MathHelper.h"
 #include "Common\GeometryGenerator.h"
 #include "Common\BasicReaderWriter.h"
-#include "Common\ShaderChangement.h"
+#include "Common\Profiler.h"
 
 using namespace DXFramework;
 
@@ -120,8 +120,8 @@ void ParticleSystemRenderer::CreateDeviceDependentResources()
 	}
 
 	// Initialize constant buffer
-	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
-	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
+	m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	m_sky->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -152,6 +152,8 @@ void ParticleSystemRenderer::CreateWindowSizeDependentResources()
 // Called once per frame, rotates the cube and calculates the model and view matrices.
 void ParticleSystemRenderer::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("ParticleSystemRenderer::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
@@ -172,13 +174,15 @@ void ParticleSystemRenderer::Update(DX::GameTimer const& timer)
 // Renders one frame using the vertex and pixel shaders.
 void ParticleSystemRenderer::Render()
 {
+	DX_PROFILE_ZONE("ParticleSystemRenderer::Render");
+
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
-	ComPtr<ID3D11DeviceContext> context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Update per-frame constant buffer
 	XMMATRIX view = m_camera->View();
@@ -200,9 +204,11 @@ void ParticleSystemRenderer::Render()
 	m_perFrameCB->Data.FogRange = 175.0f;
 	m_perFrameCB->Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
 
-	m_perFrameCB->ApplyChanges(context.Get());
+	m_perFrameCB->ApplyChanges(context);
 
-	m_terrain->Render();
+	m_renderQueue.Begin(RenderPass::Color);
+	m_terrain->Submit(m_renderQueue);
+	m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 	m_sky->Render();
 	m_fire->Render();
 	m_rain->SetEmitPos(m_camera->GetPosition());
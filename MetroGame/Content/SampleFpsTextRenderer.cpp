@@ -2,15 +2,18 @@
 #include "SampleFpsTextRenderer.h"
 
 #include "Common/DirectXHelper.h"
+#include "Common/Profiler.h"
 
 using namespace DXFramework;
 
 // Initializes D2D resources used for text rendering.
 SampleFpsTextRenderer::SampleFpsTextRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources) : 
 	m_text(L""),
-	m_deviceResources(deviceResources)
+	m_deviceResources(deviceResources),
+	m_statsTime(-1.0)
 {
 	ZeroMemory(&m_textMetrics, sizeof(DWRITE_TEXT_METRICS));
+	ZeroMemory(&m_statsMetrics, sizeof(DWRITE_TEXT_METRICS));
 
 	// Create device independent resources
 	DX::ThrowIfFailed(
@@ -30,14 +33,37 @@ SampleFpsTextRenderer::SampleFpsTextRenderer(const std::shared_ptr<DX::DeviceRes
 		m_textFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_NEAR)
 		);
 
+	DX::ThrowIfFailed(
+		m_deviceResources->GetDWriteFactory()->CreateTextFormat(
+			L"Segoe UI",
+			nullptr,
+			DWRITE_FONT_WEIGHT_NORMAL,
+			DWRITE_FONT_STYLE_NORMAL,
+			DWRITE_FONT_STRETCH_NORMAL,
+			14.0f,
+			L"en-US",
+			&m_statsFormat
+			)
+		);
+
+	DX::ThrowIfFailed(
+		m_statsFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_NEAR)
+		);
+
+	DX::ThrowIfFailed(
+		m_statsFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_TRAILING)
+		);
+
 	DX::ThrowIfFailed(
 		m_deviceResources->GetD2DFactory()->CreateDrawingStateBlock(&m_stateBlock)
 		);
 }
 
 // Updates the text to be displayed.
-void SampleFpsTextRenderer::Update(DX::GameTimer const& timer)
+void SampleFpsTextRenderer::Update(DX::GameTimer const& timer, DX::FrameStats const& stats)
 {
+	DX_PROFILE_ZONE("SampleFpsTextRenderer::Update");
+
 	// Update display text.
 	uint32 fps = timer.GetFramesPerSecond();
 	m_text = (fps > 0) ? std::to_wstring(fps) + L" FPS" : L" - FPS";
@@ -56,11 +82,47 @@ void SampleFpsTextRenderer::Update(DX::GameTimer const& timer)
 	DX::ThrowIfFailed(
 		m_textLayout->GetMetrics(&m_textMetrics)
 		);
+
+	double time = timer.GetTotalSeconds();
+	if (m_statsTime >= 0.0 && time - m_statsTime < 0.25)
+		return;
+	m_statsTime = time;
+
+	// Binding calls and maps of the last frame rendered
+	const DX::StateCacheCounters& binds = m_deviceResources->GetStateCache()->GetCounters();
+	wchar_t statsText[320];
+	swprintf_s(statsText,
+		L"frame  p50 %.1f  p95 %.1f  p99 %.1f  max %.1f ms\n"
+		L"update %.2f  render %.2f ms\n"
+		L"hitches > %.1f ms  %u of %u frames, %llu total\n"
+		L"binds  %u issued  %u skipped  maps %u",
+		stats.GetPercentileMs(0.5), stats.GetPercentileMs(0.95), stats.GetPercentileMs(0.99), stats.GetMaxMs(),
+		stats.GetAverageUpdateMs(), stats.GetAverageRenderMs(),
+		stats.GetHitchMs(), stats.GetHitches(), stats.GetFrameCount(), stats.GetTotalHitches(),
+		binds.IssuedTotal, binds.SkippedTotal, binds.Maps);
+	m_statsText = statsText;
+
+	DX::ThrowIfFailed(
+		m_deviceResources->GetDWriteFactory()->CreateTextLayout(
+			m_statsText.c_str(),
+			(uint32) m_statsText.length(),
+			m_statsFormat.Get(),
+			360.0f, // Max width of the input text.
+			80.0f, // Max height of the input text.
+			&m_statsLayout
+			)
+		);
+
+	DX::ThrowIfFailed(
+		m_statsLayout->GetMetrics(&m_statsMetrics)
+		);
 }
 
 // Renders a frame to the screen.
 void SampleFpsTextRenderer::Render()
 {
+	DX_PROFILE_ZONE("SampleFpsTextRenderer::Render");
+
 	ID2D1DeviceContext* context = m_deviceResources->GetD2DDeviceContext();
 	Windows::Foundation::Size logicalSize = m_deviceResources->GetLogicalSize();
 
@@ -85,6 +147,21 @@ void SampleFpsTextRenderer::Render()
 		m_whiteBrush.Get()
 		);
 
+	// Statistics right above the FPS
+	if (m_statsLayout)
+	{
+		D2D1::Matrix3x2F statsTranslation = D2D1::Matrix3x2F::Translation(
+			logicalSize.Width - m_statsMetrics.layoutWidth,
+			logicalSize.Height - m_textMetrics.height - m_statsMetrics.height
+			);
+		context->SetTransform(statsTranslation * m_deviceResources->GetOrientationTransform2D());
+		context->DrawTextLayout(
+			D2D1::Point2F(0.f, 0.f),
+			m_statsLayout.Get(),
+			m_whiteBrush.Get()
+			);
+	}
+
 	// Ignore D2DERR_RECREATE_TARGET here. This error indicates that the device
 	// is lost. It will be handled during the next call to Present.
 	HRESULT hr = context->EndDraw();
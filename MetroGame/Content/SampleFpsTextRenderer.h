@@ -3,17 +3,19 @@
 #include <string>
 #include "..\Common\DeviceResources.h"
 #include "..\Common\GameTimer.h"
+#include "..\Common\FrameStats.h"
 
 namespace DXFramework
 {
-	// Renders the current FPS value in the bottom right corner of the screen using Direct2D and DirectWrite.
+	// Renders the current FPS value in the bottom right corner of the screen using Direct2D and DirectWrite,
+	// with the frame time statistics above it.
 	class SampleFpsTextRenderer
 	{
 	public:
 		SampleFpsTextRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources);
 		void CreateDeviceDependentResources();
 		void ReleaseDeviceDependentResources();
-		void Update(DX::GameTimer const& timer);
+		void Update(DX::GameTimer const& timer, DX::FrameStats const& stats);
 		void Render();
 
 	private:
@@ -27,5 +29,12 @@ namespace DXFramework
 		Microsoft::WRL::ComPtr<ID2D1DrawingStateBlock>  m_stateBlock;
 		Microsoft::WRL::ComPtr<IDWriteTextLayout>       m_textLayout;
 		Microsoft::WRL::ComPtr<IDWriteTextFormat>		m_textFormat;
+
+		// Frame time statistics, refreshed a few times a second to stay readable.
+		std::wstring                                    m_statsText;
+		DWRITE_TEXT_METRICS	                            m_statsMetrics;
+		Microsoft::WRL::ComPtr<IDWriteTextLayout>       m_statsLayout;
+		Microsoft::WRL::ComPtr<IDWriteTextFormat>		m_statsFormat;
+		double                                          m_statsTime;
 	};
 }
\ No newline at end of file
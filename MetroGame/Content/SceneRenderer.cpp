@@ -0,0 +1,43 @@
+#include "pch.h"
+#include "SceneRenderer.h"
+#include "ObjectsRenderer.h"
+#include "DynamicMapObjectsRenderer.h"
+#include "ShadowObjectsRenderer.h"
+#include "SsaoObjectsRenderer.h"
+#include "TerrainRenderer.h"
+#include "ParticleSystemRenderer.h"
+#include "GPUWavesRenderer.h"
+#include "MeshModelRenderer.h"
+#include "SkinnedMeshModelRenderer.h"
+
+using namespace DXFramework;
+
+const wchar_t* const SceneRenderer::Names[] =
+{
+	L"Objects", L"DynamicMap", L"Shadow", L"Ssao", L"Terrain", L"ParticleSystem",
+	L"GPUWaves", L"MeshModel", L"SkinnedMeshModel", nullptr
+};
+
+std::unique_ptr<SceneRenderer> SceneRenderer::Create(const std::wstring& name,
+	const std::shared_ptr<DX::DeviceResources>& deviceResources, std::shared_ptr<DX::Camera>& camera)
+{
+	if (name == L"Objects")
+		return std::make_unique<ObjectsRenderer>(deviceResources, camera);
+	if (name == L"DynamicMap")
+		return std::make_unique<DynamicMapObjectsRenderer>(deviceResources, camera);
+	if (name == L"Shadow")
+		return std::make_unique<ShadowObjectsRenderer>(deviceResources, camera);
+	if (name == L"Ssao")
+		return std::make_unique<SsaoObjectsRenderer>(deviceResources, camera);
+	if (name == L"Terrain")
+		return std::make_unique<TerrainRenderer>(deviceResources, camera);
+	if (name == L"ParticleSystem")
+		return std::make_unique<ParticleSystemRenderer>(deviceResources, camera);
+	if (name == L"GPUWaves")
+		return std::make_unique<GPUWavesRenderer>(deviceResources, camera);
+	if (name == L"MeshModel")
+		return std::make_unique<MeshModelRenderer>(deviceResources, camera);
+	if (name == L"SkinnedMeshModel")
+		return std::make_unique<SkinnedMeshModelRenderer>(deviceResources, camera);
+	return nullptr;
+}
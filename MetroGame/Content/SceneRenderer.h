@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Common/GameTimer.h"
+#include "Common/Camera.h"
+#include <memory>
+#include <string>
+
+namespace DX
+{
+	class DeviceResources;
+}
+
+namespace DXFramework
+{
+	// The interface DXFrameworkMain drives a scene through. Only the input handlers
+	// and Create need C++/CX, so that the headless scenes of SceneBenchmark implement
+	// it too.
+	class SceneRenderer
+	{
+	public:
+		virtual ~SceneRenderer() {}
+
+#if defined(__cplusplus_winrt)
+		// Creates the scene with the given name, e.g. L"Terrain"; nullptr for an unknown name.
+		static std::unique_ptr<SceneRenderer> Create(const std::wstring& name,
+			const std::shared_ptr<DX::DeviceResources>& deviceResources, std::shared_ptr<DX::Camera>& camera);
+		// Names Create accepts, null terminated.
+		static const wchar_t* const Names[];
+#endif
+
+		virtual void Initialize() = 0;
+		virtual void CreateDeviceDependentResources() = 0;
+		virtual void CreateWindowSizeDependentResources() = 0;
+		virtual void ReleaseDeviceDependentResources() = 0;
+		virtual void Update(DX::GameTimer const& timer) = 0;
+		virtual void Render() = 0;
+
+#if defined(__cplusplus_winrt)
+		virtual void OnPointerPressed(Windows::UI::Core::PointerEventArgs^ args) = 0;
+		virtual void OnPointerReleased(Windows::UI::Core::PointerEventArgs^ args) = 0;
+		virtual void OnPointerMoved(Windows::UI::Core::PointerEventArgs^ args) = 0;
+		virtual void OnKeyDown(Windows::UI::Core::KeyEventArgs^ args) = 0;
+		virtual void OnKeyUp(Windows::UI::Core::KeyEventArgs^ args) = 0;
+#endif
+
+		virtual bool GetLoadState() = 0;
+		virtual bool GetInitializedState() = 0;
+	};
+}
@@ -4,7 +4,7 @@
 #include "Common\MathHelper.h"
 #include "Common\GeometryGenerator.h"
 #include "Common\BasicReaderWriter.h"
-#include "Common\ShaderChangement.h"
+#include "Common\Profiler.h"
 #include <fstream>
 
 using namespace DXFramework;
@@ -50,6 +50,9 @@ ShadowObjectsRenderer::ShadowObjectsRenderer(const std::shared_ptr<DX::DeviceRes
 	m_skull = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_sphere = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_base = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
+	m_occlusionCuller = std::make_shared<OcclusionCuller>();
+	m_skull->SetOcclusionCuller(m_occlusionCuller);
+	m_sphere->SetOcclusionCuller(m_occlusionCuller);
 	m_shadowHelper = std::make_unique<ShadowHelper>(deviceResources, m_perFrameCB, m_camera);
 	m_sky = std::make_unique<Sky>(deviceResources, m_perFrameCB, m_perObjectCB, m_camera);
 }
@@ -87,8 +90,8 @@ void ShadowObjectsRenderer::CreateDeviceDependentResources()
 	}
 
 	// Initialize constant buffer
-	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
-	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
+	m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	m_skull->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -123,6 +126,8 @@ void ShadowObjectsRenderer::CreateWindowSizeDependentResources()
 // Called once per frame, rotates the cube and calculates the model and view matrices.
 void ShadowObjectsRenderer::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("ShadowObjectsRenderer::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
@@ -145,13 +150,15 @@ void ShadowObjectsRenderer::Update(DX::GameTimer const& timer)
 // Renders one frame using the vertex and pixel shaders.
 void ShadowObjectsRenderer::Render()
 {
+	DX_PROFILE_ZONE("ShadowObjectsRenderer::Render");
+
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
-	ComPtr<ID3D11DeviceContext> context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 	// Update per-frame constant buffer
 	XMMATRIX view = m_camera->View();
 	XMMATRIX proj = m_camera->Proj();
@@ -163,6 +170,20 @@ void ShadowObjectsRenderer::Render()
 	XMStoreFloat4x4(&m_perFrameCB->Data.InvProj, XMMatrixTranspose(XMMatrixInverse(&XMMatrixDeterminant(proj), proj)));
 	XMStoreFloat4x4(&m_perFrameCB->Data.ViewProj, XMMatrixTranspose(viewProj));
 
+	// The box and the cylinders hide the skull and the spheres behind them.
+	XMFLOAT4X4 cullViewProj;
+	XMStoreFloat4x4(&cullViewProj, viewProj);
+	m_occlusionCuller->Clear(cullViewProj);
+	m_base->RasterizeOccluder(*m_occlusionCuller, 0);
+	m_base->RasterizeOccluder(*m_occlusionCuller, 2);
+	m_occlusionCuller->Finalize();
+
+	// The shadow and the camera passes cull in one walk of each hierarchy.
+	XMFLOAT4X4 passViewProjs[2] = { m_shadowHelper->GetLightViewProj(), cullViewProj };
+	m_skull->CullFrustums(passViewProjs, 2);
+	m_sphere->CullFrustums(passViewProjs, 2);
+	m_base->CullFrustums(passViewProjs, 2);
+
 	m_perFrameCB->Data.DirLights[0] = m_dirLights[0];
 	m_perFrameCB->Data.DirLights[1] = m_dirLights[1];
 	m_perFrameCB->Data.DirLights[2] = m_dirLights[2];
@@ -172,22 +193,26 @@ void ShadowObjectsRenderer::Render()
 	m_perFrameCB->Data.FogRange = 60.0f;
 	m_perFrameCB->Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
 
-	m_perFrameCB->ApplyChanges(context.Get());
+	m_perFrameCB->ApplyChanges(context);
 
 	m_shadowHelper->Render([&]()
 	{
-		m_skull->DepthRender();
-		m_sphere->DepthRender();
-		m_base->DepthRender(true);
+		m_renderQueue.Begin(RenderPass::Depth);
+		m_skull->Submit(m_renderQueue);
+		m_sphere->Submit(m_renderQueue);
+		m_base->Submit(m_renderQueue);
+		m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 	});
 
 	m_skull->UpdateShadowMapSRV(m_shadowHelper->GetDepthMapSRV());
 	m_sphere->UpdateShadowMapSRV(m_shadowHelper->GetDepthMapSRV());
 	m_base->UpdateShadowMapSRV(m_shadowHelper->GetDepthMapSRV());
 
-	m_skull->Render();
-	m_sphere->Render();
-	m_base->Render(true);
+	m_renderQueue.Begin(RenderPass::Color);
+	m_skull->Submit(m_renderQueue);
+	m_sphere->Submit(m_renderQueue);
+	m_base->Submit(m_renderQueue);
+	m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 	m_sky->Render();
 }
 
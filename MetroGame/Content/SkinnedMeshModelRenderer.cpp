@@ -4,7 +4,7 @@
 #include "Common\MathHelper.h"
 #include "Common\GeometryGenerator.h"
 #include "Common\BasicReaderWriter.h"
-#include "Common\ShaderChangement.h"
+#include "Common\Profiler.h"
 #include <fstream>
 
 using namespace DXFramework;
@@ -66,8 +66,8 @@ void SkinnedMeshModelRenderer::CreateDeviceDependentResources()
 	}
 
 	// Initialize constant buffer
-	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
-	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
+	m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	m_mesh->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -86,6 +86,8 @@ void SkinnedMeshModelRenderer::CreateWindowSizeDependentResources()
 // Called once per frame, rotates the cube and calculates the model and view matrices.
 void SkinnedMeshModelRenderer::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("SkinnedMeshModelRenderer::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
@@ -106,13 +108,15 @@ void SkinnedMeshModelRenderer::Update(DX::GameTimer const& timer)
 // Renders one frame using the vertex and pixel shaders.
 void SkinnedMeshModelRenderer::Render()
 {
+	DX_PROFILE_ZONE("SkinnedMeshModelRenderer::Render");
+
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
-	ComPtr<ID3D11DeviceContext> context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 	// Update per-frame constant buffer
 	XMMATRIX view = m_camera->View();
 	XMMATRIX proj = m_camera->Proj();
@@ -133,9 +137,11 @@ void SkinnedMeshModelRenderer::Render()
 	m_perFrameCB->Data.FogRange = 60.0f;
 	m_perFrameCB->Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
 
-	m_perFrameCB->ApplyChanges(context.Get());
+	m_perFrameCB->ApplyChanges(context);
 	
-	m_mesh->Render(true);
+	m_renderQueue.Begin(RenderPass::Color);
+	m_mesh->Submit(m_renderQueue);
+	m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 }
 
 void SkinnedMeshModelRenderer::ReleaseDeviceDependentResources()
@@ -152,7 +158,7 @@ void SkinnedMeshModelRenderer::InitMesh()
 	MeshObjectData* objectData = new MeshObjectData();
 	MeshFeatureConfigure objectFeature = { 0 };
 	objectData->Skinned = true;
-	X3DLoader::LoadX3dSkinned(L"Media\\Meshes\\DHellFighter\\DHellFighter.x3d", objectData->VertexDataSkinned, objectData->IndexData, objectData->Subsets, objectData->Material, objectData->SkinInfo);
+	objectData->Source = X3DLoader::LoadX3dSkinned(L"Media\\Meshes\\DHellFighter\\DHellFighter.x3d", objectData->VertexDataSkinned, objectData->IndexData, objectData->Subsets, objectData->Material, objectData->SkinInfo);
 	
 	// Make sure that the clip name (or animation stack name) exists in the original file.
 	// Or a exception will be thrown.
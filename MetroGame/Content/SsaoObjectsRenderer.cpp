@@ -4,7 +4,7 @@
 #include "Common\MathHelper.h"
 #include "Common\GeometryGenerator.h"
 #include "Common\BasicReaderWriter.h"
-#include "Common\ShaderChangement.h"
+#include "Common\Profiler.h"
 #include <fstream>
 
 using namespace DXFramework;
@@ -43,6 +43,9 @@ SsaoObjectsRenderer::SsaoObjectsRenderer(const std::shared_ptr<DX::DeviceResourc
 	m_skull = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_sphere = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_base = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
+	m_occlusionCuller = std::make_shared<OcclusionCuller>();
+	m_skull->SetOcclusionCuller(m_occlusionCuller);
+	m_sphere->SetOcclusionCuller(m_occlusionCuller);
 	m_shadowHelper = std::make_unique<ShadowHelper>(deviceResources, m_perFrameCB, m_camera);
 	m_ssaoHelper = std::make_unique<SsaoHelper>(deviceResources, m_perFrameCB, m_camera);
 	m_sky = std::make_unique<Sky>(deviceResources, m_perFrameCB, m_perObjectCB, m_camera);
@@ -88,8 +91,8 @@ void SsaoObjectsRenderer::CreateDeviceDependentResources()
 	}
 
 	// Initialize constant buffer
-	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
-	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
+	m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	m_skull->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -132,6 +135,8 @@ void SsaoObjectsRenderer::CreateWindowSizeDependentResources()
 // Called once per frame, rotates the cube and calculates the model and view matrices.
 void SsaoObjectsRenderer::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("SsaoObjectsRenderer::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
@@ -154,13 +159,15 @@ void SsaoObjectsRenderer::Update(DX::GameTimer const& timer)
 // Renders one frame using the vertex and pixel shaders.
 void SsaoObjectsRenderer::Render()
 {
+	DX_PROFILE_ZONE("SsaoObjectsRenderer::Render");
+
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
-	ComPtr<ID3D11DeviceContext> context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 	// Update per-frame constant buffer
 	XMMATRIX view = m_camera->View();
 	XMMATRIX proj = m_camera->Proj();
@@ -172,6 +179,20 @@ void SsaoObjectsRenderer::Render()
 	XMStoreFloat4x4(&m_perFrameCB->Data.InvProj, XMMatrixTranspose(XMMatrixInverse(&XMMatrixDeterminant(proj), proj)));
 	XMStoreFloat4x4(&m_perFrameCB->Data.ViewProj, XMMatrixTranspose(viewProj));
 
+	// The box and the cylinders hide the skull and the spheres behind them.
+	XMFLOAT4X4 cullViewProj;
+	XMStoreFloat4x4(&cullViewProj, viewProj);
+	m_occlusionCuller->Clear(cullViewProj);
+	m_base->RasterizeOccluder(*m_occlusionCuller, 0);
+	m_base->RasterizeOccluder(*m_occlusionCuller, 2);
+	m_occlusionCuller->Finalize();
+
+	// The shadow and the camera passes cull in one walk of each hierarchy.
+	XMFLOAT4X4 passViewProjs[2] = { m_shadowHelper->GetLightViewProj(), cullViewProj };
+	m_skull->CullFrustums(passViewProjs, 2);
+	m_sphere->CullFrustums(passViewProjs, 2);
+	m_base->CullFrustums(passViewProjs, 2);
+
 	m_perFrameCB->Data.DirLights[0] = m_dirLights[0];
 	m_perFrameCB->Data.DirLights[1] = m_dirLights[1];
 	m_perFrameCB->Data.DirLights[2] = m_dirLights[2];
@@ -181,20 +202,24 @@ void SsaoObjectsRenderer::Render()
 	m_perFrameCB->Data.FogRange = 60.0f;
 	m_perFrameCB->Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
 
-	m_perFrameCB->ApplyChanges(context.Get());
+	m_perFrameCB->ApplyChanges(context);
 
 	m_shadowHelper->Render([&]()
 	{
-		m_skull->DepthRender();
-		m_sphere->DepthRender();
-		m_base->DepthRender(true);
+		m_renderQueue.Begin(RenderPass::Depth);
+		m_skull->Submit(m_renderQueue);
+		m_sphere->Submit(m_renderQueue);
+		m_base->Submit(m_renderQueue);
+		m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 	});
 
 	m_ssaoHelper->Render([&]()
 	{
-		m_skull->NorDepRender();
-		m_sphere->NorDepRender();
-		m_base->NorDepRender(true);
+		m_renderQueue.Begin(RenderPass::NormalDepth);
+		m_skull->Submit(m_renderQueue);
+		m_sphere->Submit(m_renderQueue);
+		m_base->Submit(m_renderQueue);
+		m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 	});
 
 	m_skull->UpdateShadowMapSRV(m_shadowHelper->GetDepthMapSRV());
@@ -208,9 +233,11 @@ void SsaoObjectsRenderer::Render()
 	//m_mapDisplayer->UpdateMapSRV(m_ssaoHelper->GetSsaoMapSRV());
 	m_mapDisplayer->UpdateMapSRV(m_shadowHelper->GetDepthMapSRV());
 
-	m_skull->Render();
-	m_sphere->Render();
-	m_base->Render(true);
+	m_renderQueue.Begin(RenderPass::Color);
+	m_skull->Submit(m_renderQueue);
+	m_sphere->Submit(m_renderQueue);
+	m_base->Submit(m_renderQueue);
+	m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 	m_mapDisplayer->Render();
 	m_sky->Render();
 }
@@ -5,7 +5,7 @@
 #include "Common\MathHelper.h"
 #include "Common\GeometryGenerator.h"
 #include "Common\BasicReaderWriter.h"
-#include "Common\ShaderChangement.h"
+#include "Common\Profiler.h"
 
 using namespace DXFramework;
 
@@ -88,8 +88,8 @@ void TerrainRenderer::CreateDeviceDependentResources()
 	}
 
 	// Initialize constant buffer
-	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
-	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
+	m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	m_sky->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -112,12 +112,15 @@ void TerrainRenderer::CreateWindowSizeDependentResources()
 // Called once per frame, rotates the cube and calculates the model and view matrices.
 void TerrainRenderer::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("TerrainRenderer::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
 	XMFLOAT3 camPos = m_camera->GetPosition();
+	m_terrain->Update(camPos);
 	float y = m_terrain->GetHeight(camPos.x, camPos.z);
 	m_camera->SetPosition(camPos.x, y + 2.0f, camPos.z);
 
@@ -127,13 +130,15 @@ void TerrainRenderer::Update(DX::GameTimer const& timer)
 // Renders one frame using the vertex and pixel shaders.
 void TerrainRenderer::Render()
 {
+	DX_PROFILE_ZONE("TerrainRenderer::Render");
+
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
-	ComPtr<ID3D11DeviceContext> context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Update per-frame constant buffer
 	XMMATRIX view = m_camera->View();
@@ -155,9 +160,11 @@ void TerrainRenderer::Render()
 	m_perFrameCB->Data.FogRange = 175.0f;
 	m_perFrameCB->Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
 
-	m_perFrameCB->ApplyChanges(context.Get());
+	m_perFrameCB->ApplyChanges(context);
 
-	m_terrain->Render();
+	m_renderQueue.Begin(RenderPass::Color);
+	m_terrain->Submit(m_renderQueue);
+	m_renderQueue.Execute(context, m_deviceResources->GetConstantRing());
 	m_sky->Render();
 }
 
@@ -5,7 +5,7 @@
 #include "Common\MathHelper.h"
 #include "Common\GeometryGenerator.h"
 #include "Common\BasicReaderWriter.h"
-#include "Common\ShaderChangement.h"
+#include "Common\Profiler.h"
 
 using namespace DXFramework;
 
@@ -64,8 +64,8 @@ void TextureTestRenderer::CreateDeviceDependentResources(DX::TextureMgr* texture
 	}
 
 	// Initialize constant buffer
-	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
-	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_perFrameCB->Initialize(m_deviceResources->GetRenderDevice());
+	m_perObjectCB->Initialize(m_deviceResources->GetRenderDevice());
 
 	m_objects->CreateDeviceDependentResources(textureMgr, shaderMgr)
 		.then([=]()
@@ -84,6 +84,8 @@ void TextureTestRenderer::CreateWindowSizeDependentResources()
 // Called once per frame, rotates the cube and calculates the model and view matrices.
 void TextureTestRenderer::Update(DX::GameTimer const& timer)
 {
+	DX_PROFILE_ZONE("TextureTestRenderer::Update");
+
 	if (!m_loadingComplete)
 	{
 		return;
@@ -93,13 +95,15 @@ void TextureTestRenderer::Update(DX::GameTimer const& timer)
 // Renders one frame using the vertex and pixel shaders.
 void TextureTestRenderer::Render()
 {
+	DX_PROFILE_ZONE("TextureTestRenderer::Render");
+
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
-	ComPtr<ID3D11DeviceContext> context = m_deviceResources->GetD3DDeviceContext();
+	RenderContext* context = m_deviceResources->GetRenderContext();
 
 	// Update per-frame constant buffer
 	XMMATRIX view = m_camera->View();
@@ -121,11 +125,9 @@ void TextureTestRenderer::Render()
 	m_perFrameCB->Data.FogRange = 60.0f;
 	m_perFrameCB->Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
 
-	m_perFrameCB->ApplyChanges(context.Get());
+	m_perFrameCB->ApplyChanges(context);
 
 	m_objects->Render();
-
-	ShaderChangement::Reset();
 }
 
 void TextureTestRenderer::ReleaseDeviceDependentResources()
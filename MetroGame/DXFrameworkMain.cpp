@@ -2,7 +2,9 @@
 #include "DXFrameworkMain.h"
 #include "Common\DirectXHelper.h"
 #include "Common\MathHelper.h"
-#include "Common\ShaderChangement.h"
+#include "Common\RenderQueue.h"
+#include <fstream>
+#include <sstream>
 
 using namespace DXFramework;
 using namespace Windows::Foundation;
@@ -14,7 +16,10 @@ using namespace DirectX;
 
 // Loads and initializes application assets when the application is loaded.
 DXFrameworkMain::DXFrameworkMain(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
-	m_deviceResources(deviceResources), m_updating(false), m_firstFlag(false), m_forward(false), m_back(false), m_left(false), m_right(false), m_cameraSpeed(10.0f)
+	m_deviceResources(deviceResources), m_updating(false), m_firstFlag(false), m_forward(false), m_back(false), m_left(false), m_right(false), m_cameraSpeed(10.0f),
+	m_updateMs(0.0), m_renderMs(0.0), m_frameRendered(false),
+	m_recording(false), m_pathStartTicks(0), m_exitAfterBenchmark(false),
+	m_recordFrame(false)
 {
 #ifdef _DEBUG
 	RecordMainThread();
@@ -22,6 +27,10 @@ DXFrameworkMain::DXFrameworkMain(const std::shared_ptr<DX::DeviceResources>& dev
 	// Register to be notified if the Device is lost or recreated
 	m_deviceResources->RegisterDeviceNotify(this);
 
+#if DX_PROFILE
+	m_profiler = std::make_unique<Profiler>();
+#endif
+	m_jobSystem = std::make_unique<JobSystem>();
 	m_loader = std::make_shared<BasicLoader>(deviceResources->GetD3DDevice(), deviceResources->GetD3DDeviceContext(),
 		deviceResources->GetWicImagingFactory());
 	m_camera = std::make_shared<Camera>();
@@ -31,7 +40,7 @@ DXFrameworkMain::DXFrameworkMain(const std::shared_ptr<DX::DeviceResources>& dev
 	m_renderStateMgr = std::make_unique<RenderStateMgr>();
 	m_loadScreen = std::make_unique<LoadScreen>();
 
-	m_renderStateMgr->Initialize(m_deviceResources->GetD3DDevice());
+	m_renderStateMgr->Initialize(m_deviceResources->GetRenderDevice());
 	m_loadScreen->Initialize(
 		m_deviceResources->GetD2DDevice(),
 		m_deviceResources->GetD2DDeviceContext(),
@@ -48,15 +57,8 @@ DXFrameworkMain::DXFrameworkMain(const std::shared_ptr<DX::DeviceResources>& dev
 	// TODO: Replace this with your App's content initialization.
 	m_fpsTextRenderer = std::make_unique<SampleFpsTextRenderer>(m_deviceResources);
 	m_fpsTextRenderer->CreateDeviceDependentResources();
-	//m_sceneRenderer = std::make_unique<ObjectsRenderer>(m_deviceResources, m_camera);
-	//m_sceneRenderer = std::make_unique<DynamicMapObjectsRenderer>(m_deviceResources, m_camera);
-	//m_sceneRenderer = std::make_unique<ShadowObjectsRenderer>(m_deviceResources, m_camera);
-	//m_sceneRenderer = std::make_unique<SsaoObjectsRenderer>(m_deviceResources, m_camera);
-	//m_sceneRenderer = std::make_unique<TerrainRenderer>(m_deviceResources, m_camera);
-	//m_sceneRenderer = std::make_unique<ParticleSystemRenderer>(m_deviceResources, m_camera);
-	//m_sceneRenderer = std::make_unique<GPUWavesRenderer>(m_deviceResources, m_camera);
-	//m_sceneRenderer = std::make_unique<MeshModelRenderer>(m_deviceResources, m_camera);
-	m_sceneRenderer = std::make_unique<SkinnedMeshModelRenderer>(m_deviceResources, m_camera);
+	m_sceneName = L"SkinnedMeshModel";
+	m_sceneRenderer = SceneRenderer::Create(m_sceneName, m_deviceResources, m_camera);
 	m_sceneRenderer->Initialize();
 	
 	CreateWindowSizeDependentResources();
@@ -99,13 +101,143 @@ void DXFrameworkMain::CreateWindowSizeDependentResources()
 	m_sceneRenderer->CreateWindowSizeDependentResources();
 }
 
+void DXFrameworkMain::LoadScene(const std::wstring& name)
+{
+	for (UINT i = 0; SceneRenderer::Names[i]; ++i)
+	{
+		if (name == SceneRenderer::Names[i])
+		{
+			m_nextSceneName = name;
+			return;
+		}
+	}
+	throw ref new Platform::InvalidArgumentException(ref new Platform::String((L"Unknown scene " + name).c_str()));
+}
+
+// The loading tasks of the current scene must have finished.
+void DXFrameworkMain::SwitchScene()
+{
+	m_sceneRenderer->ReleaseDeviceDependentResources();
+	m_sceneRenderer = SceneRenderer::Create(m_nextSceneName, m_deviceResources, m_camera);
+	m_sceneName = m_nextSceneName;
+	m_nextSceneName.clear();
+	m_firstFlag = false;
+
+	m_sceneRenderer->Initialize();
+	m_sceneRenderer->CreateWindowSizeDependentResources();
+}
+
+void DXFrameworkMain::StartBenchmark(const std::wstring& scene, const DX::CameraPath& path, UINT frameCount, bool exitWhenDone)
+{
+	if (scene != m_sceneName)
+		LoadScene(scene);
+
+	m_replay.Start(path, frameCount, m_timer);
+	m_recording = false;
+	m_exitAfterBenchmark = exitWhenDone;
+	m_updating = true;
+}
+
+void DXFrameworkMain::ApplyLaunchArguments(const std::wstring& arguments)
+{
+	std::wistringstream in(arguments);
+	std::wstring option, scene, pathFile;
+	UINT frameCount = 0;
+	if (!(in >> option) || option != L"-benchmark")
+		return;
+	if (!(in >> scene))
+		throw ref new Platform::InvalidArgumentException("-benchmark needs a scene name!");
+	if (!(in >> frameCount))
+		frameCount = 0;
+	else
+		in >> pathFile;
+
+	CameraPath path;
+	if (pathFile.empty())
+	{
+		path = CameraPath::Orbit(XMFLOAT3(0.0f, 0.0f, 0.0f), 30.0f, 10.0f, 20.0);
+	}
+	else
+	{
+		std::wstring fileName = std::wstring(Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data()) + L"\\" + pathFile;
+		std::ifstream fin(fileName);
+		if (!fin)
+			throw ref new Platform::InvalidArgumentException(ref new Platform::String((L"Cannot open " + fileName).c_str()));
+		path.Load(fin);
+	}
+	StartBenchmark(scene, path, frameCount, true);
+}
+
+void DXFrameworkMain::FinishBenchmark()
+{
+	std::string label;
+	for (wchar_t c : m_sceneName)
+		label += (char)c;
+
+	std::wstring folder(Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data());
+	std::ofstream frames(folder + L"\\benchmark_" + m_sceneName + L".csv");
+	m_replay.GetStats().WriteCsv(frames);
+
+	// One line per run, appended, for comparing builds.
+	std::wstring summaryPath = folder + L"\\benchmark_summary.csv";
+	bool newFile = !std::ifstream(summaryPath);
+	std::ofstream summary(summaryPath, std::ios::app);
+	if (newFile)
+		FrameStats::WriteSummaryCsvHeader(summary);
+	m_replay.GetStats().WriteSummaryCsv(summary, label);
+	OutputDebugString((L"Benchmark of " + m_sceneName + L" written to " + folder + L"\n").c_str());
+
+	if (m_exitAfterBenchmark)
+		Windows::ApplicationModel::Core::CoreApplication::Exit();
+}
+
 // Updates the application state once per frame.
 void DXFrameworkMain::Update() 
 {
+#if DX_PROFILE
+	// The zones of the previous frame
+	m_profiler->EndFrame();
+	if (m_profiler->HasCapture())
+	{
+		std::wstring path = std::wstring(Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data()) + L"\\profile.json";
+		std::ofstream fout(path);
+		m_profiler->WriteChromeTrace(fout);
+		OutputDebugString((L"Profile written to " + path + L"\n").c_str());
+	}
+#endif
+	DX_PROFILE_ZONE("DXFrameworkMain::Update");
+
+	// The previous frame ends here.
+	auto frameStart = std::chrono::steady_clock::now();
+	if (m_frameRendered)
+	{
+		double frameMs = std::chrono::duration<double, std::milli>(frameStart - m_frameStart).count();
+		m_frameStats.AddFrame(frameMs, m_updateMs, m_renderMs);
+		if (m_replay.AddFrame(frameMs, m_updateMs, m_renderMs))
+			FinishBenchmark();
+	}
+	m_frameStart = frameStart;
+	m_frameRendered = false;
+
 	if (!m_sceneRenderer->GetLoadState())
 		return;
+	if (!m_nextSceneName.empty())
+	{
+		SwitchScene();
+		return;
+	}
+
+	if (m_replay.IsRunning())
+	{
+		// Exactly one step a frame, so that every run updates the scene the same.
+		m_replay.Step(m_timer, *m_camera, [&]()
+		{
+			m_sceneRenderer->Update(m_timer);
+			m_fpsTextRenderer->Update(m_timer, m_frameStats);
+		});
+	}
 	// Update scene objects.
-	if (m_updating)
+	else if (m_updating)
 	{
 		m_timer.Tick([&]()
 		{
@@ -120,25 +252,37 @@ void DXFrameworkMain::Update()
 				m_camera->Strafe(delta);
 
 			m_camera->UpdateViewMatrix();
+			if (m_recording)
+				m_cameraPath.Record(GameTimer::TicksToSeconds(m_timer.GetTotalTicks() - m_pathStartTicks), *m_camera);
 
 			// TODO: Replace this with your app's content update functions.
 			m_sceneRenderer->Update(m_timer);
-			m_fpsTextRenderer->Update(m_timer);
+			m_fpsTextRenderer->Update(m_timer, m_frameStats);
 		});
 	}
+	m_updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
 }
 
 // Renders the current frame according to the current application state.
 // Returns true if the frame was rendered and is ready to be displayed.
 bool DXFrameworkMain::Render()
 {
+	DX_PROFILE_ZONE("DXFrameworkMain::Render");
+	auto renderStart = std::chrono::steady_clock::now();
+
 	// Don't try to render anything before the first Update.
 	if (/*m_timer.GetFrameCount() == 0 ||*/ !m_updating)
 	{
 		return false;
 	}
 
-	auto context = m_deviceResources->GetD3DDeviceContext();
+	// Present, Direct2D and resizing change the device state behind the state cache,
+	// and released views may come back at the same addresses.
+	auto stateCache = m_deviceResources->GetStateCache();
+	stateCache->BeginFrame();
+	stateCache->Invalidate();
+
+	auto context = m_deviceResources->GetRenderContext();
 
 	// Reset the viewport to target the whole screen.
 	auto viewport = m_deviceResources->GetScreenViewport();
@@ -169,12 +313,45 @@ bool DXFrameworkMain::Render()
 
 	// Render the scene objects.
 	// TODO: Replace this with your app's content rendering functions.
+	if (m_recordFrame)
+	{
+		m_recordingContext = std::make_unique<RecordingRenderContext>(m_deviceResources->GetStateCache());
+		m_deviceResources->SetRenderContext(m_recordingContext.get());
+	}
 	m_sceneRenderer->Render();
+	if (m_recordFrame)
+	{
+		m_deviceResources->SetRenderContext(nullptr);
+		WriteRecordedFrame();
+		m_recordingContext.reset();
+		m_recordFrame = false;
+	}
 	m_fpsTextRenderer->Render();
 
+	m_renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart).count();
+	m_frameRendered = true;
 	return true;
 }
 
+void DXFrameworkMain::WriteRecordedFrame()
+{
+	std::wstring folder(Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data());
+	std::ofstream commands(folder + L"\\commands.txt");
+	m_recordingContext->WriteLog(commands);
+	std::ofstream counters(folder + L"\\submission.csv");
+	m_recordingContext->WriteCounters(counters);
+
+	// The recording is in front of the state cache, which forwards what isn't redundant.
+	const RenderCounters& c = m_recordingContext->GetCounters();
+	const StateCacheCounters& cache = m_deviceResources->GetStateCache()->GetCounters();
+	wchar_t text[512];
+	swprintf_s(text, L"Frame submission, %s draws, constants %s: %u state changes (%u redundant, %u issued by the state cache), %u draws, %u maps of %llu bytes, written to %s\n",
+		RenderQueue::IsSortingEnabled() ? L"sorted" : L"unsorted",
+		RenderQueue::IsConstantRingEnabled() && m_deviceResources->GetConstantRing() ? L"in the ring" : L"mapped per draw",
+		c.StateChanges, c.RedundantStateChanges, cache.IssuedTotal, c.Draws, c.Maps, c.BytesMapped, folder.c_str());
+	OutputDebugString(text);
+}
+
 // Notifies renderers that device resources need to be released.
 void DXFrameworkMain::OnDeviceLost()
 {
@@ -189,8 +366,6 @@ void DXFrameworkMain::OnDeviceLost()
 	m_shaderMgr.reset();
 	m_textureMgr.reset();
 	m_renderStateMgr.reset();
-
-	ShaderChangement::Reset();
 }
 
 // Notifies renderers that device resources may now be recreated.
@@ -205,7 +380,7 @@ void DXFrameworkMain::OnDeviceRestored()
 	m_textureMgr = std::make_unique<TextureMgr>(m_loader);
 	m_renderStateMgr = std::make_unique<RenderStateMgr>();
 
-	m_renderStateMgr->Initialize(m_deviceResources->GetD3DDevice());
+	m_renderStateMgr->Initialize(m_deviceResources->GetRenderDevice());
 	m_loadScreen->Initialize(
 		m_deviceResources->GetD2DDevice(),
 		m_deviceResources->GetD2DDeviceContext(),
@@ -281,6 +456,59 @@ void DXFrameworkMain::OnKeyDown(Windows::UI::Core::KeyEventArgs^ args)
 	case Windows::System::VirtualKey::F1:
 		WireFrameRender = !WireFrameRender;
 		break;
+#if DX_PROFILE
+	case Windows::System::VirtualKey::F2:
+		// Chrome trace of the next 120 frames, written to the local app data folder
+		if (!m_profiler->IsCapturing())
+			m_profiler->Capture(120);
+		break;
+#endif
+	case Windows::System::VirtualKey::F3:
+	{
+		// Frame times of the statistics window and their summary, for the regression dashboards
+		std::wstring folder(Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data());
+		std::ofstream frames(folder + L"\\frames.csv");
+		m_frameStats.WriteCsv(frames);
+		std::ofstream summary(folder + L"\\summary.csv");
+		FrameStats::WriteSummaryCsvHeader(summary);
+		m_frameStats.WriteSummaryCsv(summary, "MetroGame");
+		OutputDebugString((L"Frame statistics written to " + folder + L"\n").c_str());
+		break;
+	}
+	case Windows::System::VirtualKey::F4:
+	{
+		// Starts recording the camera path, or stops and writes it to the local app data folder
+		if (m_replay.IsRunning())
+			break;
+		if (!m_recording)
+		{
+			m_cameraPath.Clear();
+			m_pathStartTicks = m_timer.GetTotalTicks();
+			m_recording = true;
+			break;
+		}
+		m_recording = false;
+		std::ofstream fout(std::wstring(Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data()) + L"\\camera.path");
+		m_cameraPath.Save(fout);
+		break;
+	}
+	case Windows::System::VirtualKey::F5:
+		// Benchmarks the current scene along the last recorded camera path
+		if (!m_replay.IsRunning() && !m_recording && !m_cameraPath.IsEmpty())
+			StartBenchmark(m_sceneName, m_cameraPath, 0, false);
+		break;
+	case Windows::System::VirtualKey::F6:
+		// Records the submission of the next frame's scene to the local app data folder
+		m_recordFrame = true;
+		break;
+	case Windows::System::VirtualKey::F7:
+		// Toggles sorting the queued draws, to compare the state changes F6 records
+		RenderQueue::SetSortingEnabled(!RenderQueue::IsSortingEnabled());
+		break;
+	case Windows::System::VirtualKey::F8:
+		// Toggles writing the queued constants to the ring, to compare the maps F6 records
+		RenderQueue::SetConstantRingEnabled(!RenderQueue::IsConstantRingEnabled());
+		break;
 	case Windows::System::VirtualKey::Up:
 		m_cameraSpeed += 1.0f;
 		if (m_cameraSpeed > 30.0f)
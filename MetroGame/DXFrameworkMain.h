@@ -1,20 +1,20 @@
 ﻿#pragma once
 
+#include <chrono>
+
 #include "Content\SampleFpsTextRenderer.h"
-#include "Content\ObjectsRenderer.h"
-#include "Content\DynamicMapObjectsRenderer.h"
-#include "Content\ShadowObjectsRenderer.h"
-#include "Content\SsaoObjectsRenderer.h"
-#include "Content\TerrainRenderer.h"
-#include "Content\ParticleSystemRenderer.h"
-#include "Content\GPUWavesRenderer.h"
-#include "Content\MeshModelRenderer.h"
-#include "Content\SkinnedMeshModelRenderer.h"
+#include "Content\SceneRenderer.h"
 
 #include "Common\GameTimer.h"
+#include "Common\FrameStats.h"
+#include "Common\JobSystem.h"
+#include "Common\Profiler.h"
+#include "Common\RecordingRenderContext.h"
 #include "Common\DeviceResources.h"
 #include "Common\BasicLoader.h"
 #include "Common\Camera.h"
+#include "Common\CameraPath.h"
+#include "Common\PathReplay.h"
 #include "Common\RenderStateMgr.h"
 #include "Common\ShaderMgr.h"
 #include "Common\TextureMgr.h"
@@ -32,6 +32,17 @@ namespace DXFramework
 		void Update();
 		bool Render();
 
+		// Switches to the scene with the given name (see SceneRenderer::Names) once the
+		// current one has loaded.
+		void LoadScene(const std::wstring& name);
+		// Replays path through the scene, one fixed 1/60 s step a frame, and writes the
+		// frame, update and render times to the local app data folder. frameCount 0 plays
+		// the whole path.
+		void StartBenchmark(const std::wstring& scene, const DX::CameraPath& path, UINT frameCount, bool exitWhenDone);
+		// "-benchmark <scene> [frameCount [pathFile]]" starts a benchmark and exits after it.
+		// pathFile is in the local app data folder; without one the camera orbits the origin.
+		void ApplyLaunchArguments(const std::wstring& arguments);
+
 		// IDeviceNotify
 		virtual void OnDeviceLost();
 		virtual void OnDeviceRestored();
@@ -46,10 +57,22 @@ namespace DXFramework
 		void OnKeyDown(Windows::UI::Core::KeyEventArgs^ args);
 		void OnKeyUp(Windows::UI::Core::KeyEventArgs^ args);
 
+	private:
+		void SwitchScene();
+		void FinishBenchmark();
+		void WriteRecordedFrame();
+
 	private:
 		// Cached pointer to device resources.
 		std::shared_ptr<DX::DeviceResources> m_deviceResources;
 
+#if DX_PROFILE
+		// Outlives every thread recording zones
+		std::unique_ptr<DX::Profiler> m_profiler;
+#endif
+		// Worker threads of ParallelFor, destroyed after everything using them
+		std::unique_ptr<DX::JobSystem> m_jobSystem;
+
 		// Shared between classes
 		std::shared_ptr<DX::BasicLoader> m_loader;
 		std::shared_ptr<DX::Camera> m_camera;
@@ -61,18 +84,29 @@ namespace DXFramework
 		// Game time controller
 		DX::GameTimer m_timer;
 
-		// TODO: Replace with your own content renderers.
-		//std::unique_ptr<ObjectsRenderer> m_sceneRenderer;
-		//std::unique_ptr<DynamicMapObjectsRenderer> m_sceneRenderer;
-		//std::unique_ptr<ShadowObjectsRenderer> m_sceneRenderer;
-		//std::unique_ptr<SsaoObjectsRenderer> m_sceneRenderer;
-		//std::unique_ptr<TerrainRenderer> m_sceneRenderer;
-		//std::unique_ptr<ParticleSystemRenderer> m_sceneRenderer;
-		//std::unique_ptr<GPUWavesRenderer> m_sceneRenderer;
-		//std::unique_ptr<MeshModelRenderer> m_sceneRenderer;
-		std::unique_ptr<SkinnedMeshModelRenderer> m_sceneRenderer;
+		// Frame, update and render times of the frames showing the scene
+		DX::FrameStats m_frameStats;
+		std::chrono::steady_clock::time_point m_frameStart;
+		double m_updateMs;
+		double m_renderMs;
+		bool m_frameRendered;
+
+		std::unique_ptr<SceneRenderer> m_sceneRenderer;
+		std::wstring m_sceneName;
+		std::wstring m_nextSceneName;	// Loaded once the current scene has loaded
 		std::unique_ptr<SampleFpsTextRenderer> m_fpsTextRenderer;
 
+		// Camera path recorded with F4, and the one a benchmark replays
+		DX::CameraPath m_cameraPath;
+		bool m_recording;
+		uint64 m_pathStartTicks;
+		DX::PathReplay m_replay;
+		bool m_exitAfterBenchmark;
+
+		// Wraps the D3D11 context while the scene of a frame renders, after F6
+		std::unique_ptr<DX::RecordingRenderContext> m_recordingContext;
+		bool m_recordFrame;
+
 		std::unique_ptr<DX::LoadScreen> m_loadScreen;
 
 		bool m_updating;
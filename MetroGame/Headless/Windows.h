@@ -0,0 +1,71 @@
+#pragma once
+
+// Stands in for the part of the Windows headers which the portable units use, so
+// that they also build on other platforms. Only CMakeLists.txt puts this directory
+// on the include path, and only off Windows.
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+typedef uint8_t BYTE;
+typedef uint8_t UINT8;
+typedef uint16_t USHORT;
+typedef uint16_t UINT16;
+typedef uint32_t UINT;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int32_t INT;
+typedef int64_t INT64;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef uint32_t ULONG;
+typedef uintptr_t UINT_PTR;
+typedef size_t SIZE_T;
+typedef float FLOAT;
+typedef const char* LPCSTR;
+typedef int32_t HRESULT;
+
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_INVALIDARG ((HRESULT)0x80070057)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000E)
+#define E_NOINTERFACE ((HRESULT)0x80004002)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#define ZeroMemory(destination, length) memset((destination), 0, (length))
+#define CopyMemory(destination, source, length) memcpy((destination), (source), (length))
+#define _ASSERT(expression) assert(expression)
+
+#define STDMETHODCALLTYPE
+
+struct GUID
+{
+	uint32_t Data1;
+	uint16_t Data2;
+	uint16_t Data3;
+	uint8_t Data4[8];
+};
+typedef GUID IID;
+#define REFIID const IID&
+
+typedef union _LARGE_INTEGER
+{
+	int64_t QuadPart;
+} LARGE_INTEGER;
+
+// The performance counter counts nanoseconds of the steady clock.
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER* counter)
+{
+	counter->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	return 1;
+}
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency)
+{
+	frequency->QuadPart = 1000000000;
+	return 1;
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+// Stands in for the part of the Direct3D 11.1 headers which the portable units use,
+// with the same names and values, so that they also build on other platforms. The
+// interfaces only declare the methods those units call; nothing implements them
+// but the null objects of NullRenderDevice and the mock objects of the tests.
+// Descriptions nothing portable fills in are only declared.
+
+#include <Windows.h>
+
+#define D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT (14)
+#define D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT (128)
+#define D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT (16)
+#define D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT (32)
+#define D3D11_PS_CS_UAV_REGISTER_COUNT (8)
+#define D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT (8)
+#define D3D11_SO_BUFFER_SLOT_COUNT (4)
+#define D3D11_APPEND_ALIGNED_ELEMENT (0xffffffff)
+#define D3D11_FLOAT32_MAX (3.402823466e+38f)
+
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+	DXGI_FORMAT_R32G32B32_FLOAT = 6,
+	DXGI_FORMAT_R32G32_FLOAT = 16,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+	DXGI_FORMAT_R8G8B8A8_UINT = 30,
+	DXGI_FORMAT_R32_UINT = 42,
+	DXGI_FORMAT_R16_FLOAT = 54,
+	DXGI_FORMAT_R16_UINT = 57
+};
+
+enum D3D11_PRIMITIVE_TOPOLOGY
+{
+	D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+	D3D11_PRIMITIVE_TOPOLOGY_POINTLIST = 1,
+	D3D11_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+	D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP = 3,
+	D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+	D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5,
+	D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST = 36
+};
+
+enum D3D11_MAP
+{
+	D3D11_MAP_READ = 1,
+	D3D11_MAP_WRITE = 2,
+	D3D11_MAP_READ_WRITE = 3,
+	D3D11_MAP_WRITE_DISCARD = 4,
+	D3D11_MAP_WRITE_NO_OVERWRITE = 5
+};
+
+enum D3D11_USAGE
+{
+	D3D11_USAGE_DEFAULT = 0,
+	D3D11_USAGE_IMMUTABLE = 1,
+	D3D11_USAGE_DYNAMIC = 2,
+	D3D11_USAGE_STAGING = 3
+};
+
+enum D3D11_BIND_FLAG
+{
+	D3D11_BIND_VERTEX_BUFFER = 0x1,
+	D3D11_BIND_INDEX_BUFFER = 0x2,
+	D3D11_BIND_CONSTANT_BUFFER = 0x4,
+	D3D11_BIND_SHADER_RESOURCE = 0x8,
+	D3D11_BIND_STREAM_OUTPUT = 0x10,
+	D3D11_BIND_RENDER_TARGET = 0x20,
+	D3D11_BIND_DEPTH_STENCIL = 0x40,
+	D3D11_BIND_UNORDERED_ACCESS = 0x80
+};
+
+enum D3D11_CPU_ACCESS_FLAG
+{
+	D3D11_CPU_ACCESS_WRITE = 0x10000,
+	D3D11_CPU_ACCESS_READ = 0x20000
+};
+
+enum D3D11_CLEAR_FLAG
+{
+	D3D11_CLEAR_DEPTH = 0x1,
+	D3D11_CLEAR_STENCIL = 0x2
+};
+
+enum D3D11_RESOURCE_DIMENSION
+{
+	D3D11_RESOURCE_DIMENSION_UNKNOWN = 0,
+	D3D11_RESOURCE_DIMENSION_BUFFER = 1,
+	D3D11_RESOURCE_DIMENSION_TEXTURE1D = 2,
+	D3D11_RESOURCE_DIMENSION_TEXTURE2D = 3,
+	D3D11_RESOURCE_DIMENSION_TEXTURE3D = 4
+};
+
+enum D3D11_INPUT_CLASSIFICATION
+{
+	D3D11_INPUT_PER_VERTEX_DATA = 0,
+	D3D11_INPUT_PER_INSTANCE_DATA = 1
+};
+
+enum D3D11_FILTER
+{
+	D3D11_FILTER_MIN_MAG_MIP_POINT = 0,
+	D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT = 0x14,
+	D3D11_FILTER_MIN_MAG_MIP_LINEAR = 0x15,
+	D3D11_FILTER_ANISOTROPIC = 0x55,
+	D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT = 0x94
+};
+
+enum D3D11_TEXTURE_ADDRESS_MODE
+{
+	D3D11_TEXTURE_ADDRESS_WRAP = 1,
+	D3D11_TEXTURE_ADDRESS_MIRROR = 2,
+	D3D11_TEXTURE_ADDRESS_CLAMP = 3,
+	D3D11_TEXTURE_ADDRESS_BORDER = 4
+};
+
+enum D3D11_COMPARISON_FUNC
+{
+	D3D11_COMPARISON_NEVER = 1,
+	D3D11_COMPARISON_LESS = 2,
+	D3D11_COMPARISON_EQUAL = 3,
+	D3D11_COMPARISON_LESS_EQUAL = 4,
+	D3D11_COMPARISON_GREATER = 5,
+	D3D11_COMPARISON_NOT_EQUAL = 6,
+	D3D11_COMPARISON_GREATER_EQUAL = 7,
+	D3D11_COMPARISON_ALWAYS = 8
+};
+
+enum D3D11_FILL_MODE
+{
+	D3D11_FILL_WIREFRAME = 2,
+	D3D11_FILL_SOLID = 3
+};
+
+enum D3D11_CULL_MODE
+{
+	D3D11_CULL_NONE = 1,
+	D3D11_CULL_FRONT = 2,
+	D3D11_CULL_BACK = 3
+};
+
+struct D3D11_VIEWPORT
+{
+	FLOAT TopLeftX;
+	FLOAT TopLeftY;
+	FLOAT Width;
+	FLOAT Height;
+	FLOAT MinDepth;
+	FLOAT MaxDepth;
+};
+
+struct D3D11_MAPPED_SUBRESOURCE
+{
+	void* pData;
+	UINT RowPitch;
+	UINT DepthPitch;
+};
+
+struct D3D11_BUFFER_DESC
+{
+	UINT ByteWidth;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+	UINT StructureByteStride;
+};
+
+struct D3D11_SUBRESOURCE_DATA
+{
+	const void* pSysMem;
+	UINT SysMemPitch;
+	UINT SysMemSlicePitch;
+};
+
+struct DXGI_SAMPLE_DESC
+{
+	UINT Count;
+	UINT Quality;
+};
+
+struct D3D11_TEXTURE2D_DESC
+{
+	UINT Width;
+	UINT Height;
+	UINT MipLevels;
+	UINT ArraySize;
+	DXGI_FORMAT Format;
+	DXGI_SAMPLE_DESC SampleDesc;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+};
+
+struct D3D11_INPUT_ELEMENT_DESC
+{
+	LPCSTR SemanticName;
+	UINT SemanticIndex;
+	DXGI_FORMAT Format;
+	UINT InputSlot;
+	UINT AlignedByteOffset;
+	D3D11_INPUT_CLASSIFICATION InputSlotClass;
+	UINT InstanceDataStepRate;
+};
+
+struct D3D11_SAMPLER_DESC
+{
+	D3D11_FILTER Filter;
+	D3D11_TEXTURE_ADDRESS_MODE AddressU;
+	D3D11_TEXTURE_ADDRESS_MODE AddressV;
+	D3D11_TEXTURE_ADDRESS_MODE AddressW;
+	FLOAT MipLODBias;
+	UINT MaxAnisotropy;
+	D3D11_COMPARISON_FUNC ComparisonFunc;
+	FLOAT BorderColor[4];
+	FLOAT MinLOD;
+	FLOAT MaxLOD;
+};
+
+struct D3D11_RASTERIZER_DESC
+{
+	D3D11_FILL_MODE FillMode;
+	D3D11_CULL_MODE CullMode;
+	BOOL FrontCounterClockwise;
+	INT DepthBias;
+	FLOAT DepthBiasClamp;
+	FLOAT SlopeScaledDepthBias;
+	BOOL DepthClipEnable;
+	BOOL ScissorEnable;
+	BOOL MultisampleEnable;
+	BOOL AntialiasedLineEnable;
+};
+
+struct D3D11_TEXTURE1D_DESC;
+struct D3D11_TEXTURE3D_DESC;
+struct D3D11_SHADER_RESOURCE_VIEW_DESC;
+struct D3D11_UNORDERED_ACCESS_VIEW_DESC;
+struct D3D11_RENDER_TARGET_VIEW_DESC;
+struct D3D11_DEPTH_STENCIL_VIEW_DESC;
+struct D3D11_SO_DECLARATION_ENTRY;
+struct D3D11_BLEND_DESC;
+struct D3D11_DEPTH_STENCIL_DESC;
+
+struct IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) = 0;
+	virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+	virtual ULONG STDMETHODCALLTYPE Release() = 0;
+
+protected:
+	~IUnknown() {}
+};
+
+struct ID3D11DeviceChild : IUnknown {};
+struct ID3D11Resource : ID3D11DeviceChild
+{
+	virtual void GetType(D3D11_RESOURCE_DIMENSION* resourceDimension) = 0;
+};
+struct ID3D11Buffer : ID3D11Resource
+{
+	virtual void GetDesc(D3D11_BUFFER_DESC* desc) = 0;
+};
+struct ID3D11Texture1D : ID3D11Resource {};
+struct ID3D11Texture2D : ID3D11Resource {};
+struct ID3D11Texture3D : ID3D11Resource {};
+struct ID3D11View : ID3D11DeviceChild {};
+struct ID3D11ShaderResourceView : ID3D11View {};
+struct ID3D11RenderTargetView : ID3D11View {};
+struct ID3D11DepthStencilView : ID3D11View {};
+struct ID3D11UnorderedAccessView : ID3D11View {};
+struct ID3D11VertexShader : ID3D11DeviceChild {};
+struct ID3D11HullShader : ID3D11DeviceChild {};
+struct ID3D11DomainShader : ID3D11DeviceChild {};
+struct ID3D11GeometryShader : ID3D11DeviceChild {};
+struct ID3D11PixelShader : ID3D11DeviceChild {};
+struct ID3D11ComputeShader : ID3D11DeviceChild {};
+struct ID3D11ClassInstance : ID3D11DeviceChild {};
+struct ID3D11ClassLinkage : ID3D11DeviceChild {};
+struct ID3D11InputLayout : ID3D11DeviceChild {};
+struct ID3D11SamplerState : ID3D11DeviceChild {};
+struct ID3D11RasterizerState : ID3D11DeviceChild {};
+struct ID3D11BlendState : ID3D11DeviceChild {};
+struct ID3D11DepthStencilState : ID3D11DeviceChild {};
@@ -0,0 +1,107 @@
+#pragma once
+
+// Stands in for the ComPtr of the Windows Runtime C++ Template Library, with the
+// members the portable units use, so that they hold Direct3D objects the same way
+// on other platforms.
+
+#include <Windows.h>
+#include <utility>
+
+namespace Microsoft
+{
+	namespace WRL
+	{
+		template<typename T>
+		class ComPtr
+		{
+		public:
+			typedef T InterfaceType;
+
+			ComPtr() : m_ptr(nullptr) {}
+			ComPtr(decltype(nullptr)) : m_ptr(nullptr) {}
+			ComPtr(T* ptr) : m_ptr(ptr) { InternalAddRef(); }
+			ComPtr(const ComPtr& other) : m_ptr(other.m_ptr) { InternalAddRef(); }
+			ComPtr(ComPtr&& other) : m_ptr(other.m_ptr) { other.m_ptr = nullptr; }
+			~ComPtr() { InternalRelease(); }
+
+			ComPtr& operator=(decltype(nullptr))
+			{
+				InternalRelease();
+				return *this;
+			}
+			ComPtr& operator=(T* ptr)
+			{
+				ComPtr(ptr).Swap(*this);
+				return *this;
+			}
+			ComPtr& operator=(const ComPtr& other)
+			{
+				ComPtr(other).Swap(*this);
+				return *this;
+			}
+			ComPtr& operator=(ComPtr&& other)
+			{
+				ComPtr(std::move(other)).Swap(*this);
+				return *this;
+			}
+
+			void Swap(ComPtr& other) { std::swap(m_ptr, other.m_ptr); }
+
+			T* Get() const { return m_ptr; }
+			T* operator->() const { return m_ptr; }
+			explicit operator bool() const { return m_ptr != nullptr; }
+
+			T* const* GetAddressOf() const { return &m_ptr; }
+			T** GetAddressOf() { return &m_ptr; }
+			T** ReleaseAndGetAddressOf()
+			{
+				InternalRelease();
+				return &m_ptr;
+			}
+
+			// Takes over a reference without adding one, or gives it up.
+			void Attach(T* ptr)
+			{
+				InternalRelease();
+				m_ptr = ptr;
+			}
+			T* Detach()
+			{
+				T* ptr = m_ptr;
+				m_ptr = nullptr;
+				return ptr;
+			}
+
+			ULONG Reset()
+			{
+				return InternalRelease();
+			}
+
+		private:
+			void InternalAddRef() const
+			{
+				if (m_ptr)
+					m_ptr->AddRef();
+			}
+			ULONG InternalRelease()
+			{
+				ULONG refCount = 0;
+				T* ptr = m_ptr;
+				if (ptr)
+				{
+					m_ptr = nullptr;
+					refCount = ptr->Release();
+				}
+				return refCount;
+			}
+
+		private:
+			T* m_ptr;
+		};
+
+		template<typename T, typename U>
+		bool operator==(const ComPtr<T>& a, const ComPtr<U>& b) { return a.Get() == b.Get(); }
+		template<typename T, typename U>
+		bool operator!=(const ComPtr<T>& a, const ComPtr<U>& b) { return a.Get() != b.Get(); }
+	}
+}
@@ -1,6 +1,8 @@
 // Note the specific vs shader should be named in this pattern: 
 // "BasicVS1111.hlsl", the digit is according to normal, displace,
 // shadow and ssao features.
+// The instanced ones are named "BasicVSInstanced111.hlsl", after
+// normal, shadow and ssao.
 
 #ifndef NORMAL_ENABLE
 #define NORMAL_ENABLE 0
@@ -22,6 +24,12 @@
 #define SKINNED_ENABLE 0
 #endif
 
+// World matrices come from the per-instance stream instead of cbPerObject.
+// Only supported without tessellation and skinning.
+#ifndef INSTANCED_ENABLE
+#define INSTANCED_ENABLE 0
+#endif
+
 #include "../ShaderInclude.hlsl"
 
 cbuffer cbPerObject : register(b1)
@@ -62,6 +70,10 @@ struct VertexIn
 	float3 Weights    : WEIGHTS;
 	uint4 BoneIndices : BONEINDICES;
 #endif
+#if INSTANCED_ENABLE==1
+	row_major float4x4 World             : WORLD;
+	row_major float4x4 WorldInvTranspose : WORLDINVTRANSPOSE;
+#endif
 };
 
 #if NORMAL_ENABLE==1 && TESS_ENABLE==1
@@ -170,11 +182,18 @@ VertexOut main(VertexIn vin)
 VertexOut main(VertexIn vin)
 {
 	VertexOut vout;
+#if INSTANCED_ENABLE==1
+	float4x4 world = vin.World;
+	float4x4 worldInvTranspose = vin.WorldInvTranspose;
+#else
+	float4x4 world = gWorld;
+	float4x4 worldInvTranspose = gWorldInvTranspose;
+#endif
 	// Transform to world space space.
-	vout.PosW = mul(float4(vin.PosL, 1.0f), gWorld).xyz;
-	vout.NormalW = mul(vin.NormalL, (float3x3)gWorldInvTranspose);
+	vout.PosW = mul(float4(vin.PosL, 1.0f), world).xyz;
+	vout.NormalW = mul(vin.NormalL, (float3x3)worldInvTranspose);
 #if NORMAL_ENABLE==1
-	vout.TangentW = mul(vin.TangentL, (float3x3)gWorld);
+	vout.TangentW = mul(vin.TangentL, (float3x3)world);
 #endif
 
 	// Transform to homogeneous clip space.
@@ -0,0 +1,8 @@
+#define NORMAL_ENABLE 0
+#define TESS_ENABLE 0
+#define SHADOW_ENABLE 0
+#define SSAO_ENABLE 1
+#define SKINNED_ENABLE 0
+#define INSTANCED_ENABLE 1
+
+#include "../BasicBaseVS.hlsl"
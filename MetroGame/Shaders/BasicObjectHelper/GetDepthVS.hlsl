@@ -6,6 +6,12 @@
 #define SKINNED_ENABLE 0
 #endif
 
+// World matrices come from the per-instance stream instead of cbPerObject.
+// Only supported without tessellation and skinning.
+#ifndef INSTANCED_ENABLE
+#define INSTANCED_ENABLE 0
+#endif
+
 #include "../ShaderInclude.hlsl"
 
 cbuffer cbPerObject : register(b1)
@@ -44,6 +50,9 @@ struct VertexIn
 	float3 Weights    : WEIGHTS;
 	uint4 BoneIndices : BONEINDICES;
 #endif
+#if INSTANCED_ENABLE==1
+	row_major float4x4 World : WORLD;
+#endif
 };
 
 #if TESS_ENABLE==1
@@ -118,7 +127,11 @@ VertexOut main(VertexIn vin)
 	VertexOut vout;
 
 	// Transform to world space space.
+#if INSTANCED_ENABLE==1
+	float3 posW = mul(float4(vin.PosL, 1.0f), vin.World).xyz;
+#else
 	float3 posW = mul(float4(vin.PosL, 1.0f), gWorld).xyz;
+#endif
 
 	// Transform to homogeneous clip space.
 	vout.PosH = mul(float4(posW, 1.0f), gViewProj);
@@ -6,6 +6,12 @@
 #define SKINNED_ENABLE 0
 #endif
 
+// World matrices come from the per-instance stream instead of cbPerObject.
+// Only supported without tessellation and skinning.
+#ifndef INSTANCED_ENABLE
+#define INSTANCED_ENABLE 0
+#endif
+
 #include "../ShaderInclude.hlsl"
 
 cbuffer cbPerObject : register(b1)
@@ -44,6 +50,10 @@ struct VertexIn
 	float3 Weights    : WEIGHTS;
 	uint4 BoneIndices : BONEINDICES;
 #endif
+#if INSTANCED_ENABLE==1
+	row_major float4x4 World             : WORLD;
+	row_major float4x4 WorldInvTranspose : WORLDINVTRANSPOSE;
+#endif
 };
 
 #if TESS_ENABLE==1
@@ -133,8 +143,13 @@ VertexOut main(VertexIn vin)
     VertexOut vout;
 	
 	// Transform to world space space.
+#if INSTANCED_ENABLE==1
+	float3 posW = mul(float4(vin.PosL, 1.0f), vin.World).xyz;
+	float3 normalW = mul(vin.NormalL, (float3x3)vin.WorldInvTranspose);
+#else
 	float3 posW = mul(float4(vin.PosL, 1.0f), gWorld).xyz;
 	float3 normalW = mul(vin.NormalL, (float3x3)gWorldInvTranspose);
+#endif
 	// Transform to view space
 	vout.PosV = mul(float4(posW, 1.0f), gView).xyz;
 	vout.NormalV = mul(normalW, (float3x3)gView);
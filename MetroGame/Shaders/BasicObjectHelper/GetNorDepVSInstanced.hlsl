@@ -0,0 +1,5 @@
+#define TESS_ENABLE 0
+#define SKINNED_ENABLE 0
+#define INSTANCED_ENABLE 1
+
+#include "GetNorDepVS.hlsl"
\ No newline at end of file
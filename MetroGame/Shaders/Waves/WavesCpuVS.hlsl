@@ -0,0 +1,46 @@
+#include "../ShaderInclude.hlsl"
+
+cbuffer cbPerObject : register(b1)
+{
+	float4x4 gWorld;
+	float4x4 gWorldInvTranspose;
+	float4x4 gTexTransform;
+	Material gMaterial;
+};
+
+// The grid xz positions and texture coordinates never change, so they live in an
+// immutable buffer in slot 0. Only heights and normals are streamed in slot 1.
+struct VertexIn
+{
+	float2 PosXZ   : POSITION;
+	float2 Tex     : TEXCOORD;
+	float  Height  : HEIGHT;
+	float3 NormalL : NORMAL;
+};
+
+struct VertexOut
+{
+	float4 PosH    : SV_POSITION;
+	float3 PosW    : POSITION;
+	float3 NormalW : NORMAL;
+	float2 Tex     : TEXCOORD0;
+};
+
+VertexOut main(VertexIn vin)
+{
+	VertexOut vout;
+
+	float3 posL = float3(vin.PosXZ.x, vin.Height, vin.PosXZ.y);
+
+	// Transform to world space space.
+	vout.PosW = mul(float4(posL, 1.0f), gWorld).xyz;
+	vout.NormalW = mul(vin.NormalL, (float3x3)gWorldInvTranspose);
+
+	// Transform to homogeneous clip space.
+	vout.PosH = mul(float4(vout.PosW, 1.0f), gViewProj);
+
+	// Output vertex attributes for interpolation across triangle.
+	vout.Tex = mul(float4(vin.Tex, 0.0f, 1.0f), gTexTransform).xy;
+
+	return vout;
+}
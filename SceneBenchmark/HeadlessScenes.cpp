@@ -0,0 +1,856 @@
+#include "HeadlessScenes.h"
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <string.h>
+#include <vector>
+#include <wrl/client.h>
+#include "Common/ConstantBuffer.h"
+#include "Common/ConstantRingBuffer.h"
+#include "Common/FrustumCuller.h"
+#include "Common/GridFilter.h"
+#include "Common/JobSystem.h"
+#include "Common/MathHelper.h"
+#include "Common/RenderQueue.h"
+#include "Common/VertexTypes.h"
+#include "Components/TerrainHeightfield.h"
+#include "Components/TerrainQuadtree.h"
+#include "Components/X3DLoader.h"
+
+using namespace DirectX;
+using namespace DXFramework;
+using namespace DX;
+using Microsoft::WRL::ComPtr;
+
+namespace DXFramework
+{
+	const char* const HeadlessSceneNames[] = { "Terrain", "MeshModel", "SkinnedMeshModel", nullptr };
+}
+
+namespace
+{
+	void ThrowIfFailed(HRESULT hr, const char* what)
+	{
+		if (FAILED(hr))
+			throw std::runtime_error(std::string("Can not create ") + what + "!");
+	}
+
+	ComPtr<ID3D11Buffer> CreateBuffer(RenderDevice* device, UINT byteWidth, UINT bindFlags, const void* data)
+	{
+		D3D11_BUFFER_DESC desc;
+		desc.Usage = data ? D3D11_USAGE_IMMUTABLE : D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = byteWidth;
+		desc.BindFlags = bindFlags;
+		desc.CPUAccessFlags = data ? 0 : D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = 0;
+		desc.StructureByteStride = 0;
+		D3D11_SUBRESOURCE_DATA initData;
+		initData.pSysMem = data;
+		initData.SysMemPitch = 0;
+		initData.SysMemSlicePitch = 0;
+		ComPtr<ID3D11Buffer> buffer;
+		ThrowIfFailed(device->CreateBuffer(&desc, data ? &initData : nullptr, buffer.GetAddressOf()), "a buffer");
+		return buffer;
+	}
+
+	// The view of an empty texture standing in for one read from a file.
+	ComPtr<ID3D11ShaderResourceView> CreateTextureView(RenderDevice* device, UINT width, UINT height, UINT arraySize, DXGI_FORMAT format)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = arraySize;
+		desc.Format = format;
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+		ComPtr<ID3D11Texture2D> texture;
+		ThrowIfFailed(device->CreateTexture2D(&desc, nullptr, texture.GetAddressOf()), "a texture");
+		ComPtr<ID3D11ShaderResourceView> view;
+		ThrowIfFailed(device->CreateShaderResourceView(texture.Get(), nullptr, view.GetAddressOf()), "a texture view");
+		return view;
+	}
+
+	ComPtr<ID3D11SamplerState> CreateSampler(RenderDevice* device, D3D11_FILTER filter, D3D11_TEXTURE_ADDRESS_MODE address)
+	{
+		D3D11_SAMPLER_DESC desc;
+		ZeroMemory(&desc, sizeof(desc));
+		desc.Filter = filter;
+		desc.AddressU = address;
+		desc.AddressV = address;
+		desc.AddressW = address;
+		desc.MaxAnisotropy = 1;
+		desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+		desc.MinLOD = -FLT_MAX;
+		desc.MaxLOD = FLT_MAX;
+		ComPtr<ID3D11SamplerState> sampler;
+		ThrowIfFailed(device->CreateSamplerState(&desc, sampler.GetAddressOf()), "a sampler");
+		return sampler;
+	}
+
+	// Stands in for a shader loaded from its .cso, as only the object is compared.
+	template<typename Shader>
+	ComPtr<Shader> CreateShader(RenderDevice* device);
+	template<>
+	ComPtr<ID3D11VertexShader> CreateShader(RenderDevice* device)
+	{
+		ComPtr<ID3D11VertexShader> shader;
+		ThrowIfFailed(device->CreateVertexShader(nullptr, 0, nullptr, shader.GetAddressOf()), "a vertex shader");
+		return shader;
+	}
+	template<>
+	ComPtr<ID3D11HullShader> CreateShader(RenderDevice* device)
+	{
+		ComPtr<ID3D11HullShader> shader;
+		ThrowIfFailed(device->CreateHullShader(nullptr, 0, nullptr, shader.GetAddressOf()), "a hull shader");
+		return shader;
+	}
+	template<>
+	ComPtr<ID3D11DomainShader> CreateShader(RenderDevice* device)
+	{
+		ComPtr<ID3D11DomainShader> shader;
+		ThrowIfFailed(device->CreateDomainShader(nullptr, 0, nullptr, shader.GetAddressOf()), "a domain shader");
+		return shader;
+	}
+	template<>
+	ComPtr<ID3D11PixelShader> CreateShader(RenderDevice* device)
+	{
+		ComPtr<ID3D11PixelShader> shader;
+		ThrowIfFailed(device->CreatePixelShader(nullptr, 0, nullptr, shader.GetAddressOf()), "a pixel shader");
+		return shader;
+	}
+
+	// As in ShaderMgr.cpp
+	const D3D11_INPUT_ELEMENT_DESC PosNormalTexTanDesc[4] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,       0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+
+	const D3D11_INPUT_ELEMENT_DESC PosNormalTexTanSkinnedDesc[6] =
+	{
+		{ "POSITION",     0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL",       0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD",     0, DXGI_FORMAT_R32G32_FLOAT,    0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT",      0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "WEIGHTS",      0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 44, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "BONEINDICES",  0, DXGI_FORMAT_R8G8B8A8_UINT,   0, 56, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+
+	const D3D11_INPUT_ELEMENT_DESC PosTexBoundDesc[3] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 1, DXGI_FORMAT_R32G32_FLOAT, 0, 20, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+
+	ComPtr<ID3D11InputLayout> CreateInputLayout(RenderDevice* device, const D3D11_INPUT_ELEMENT_DESC* elements, UINT numElements)
+	{
+		ComPtr<ID3D11InputLayout> inputLayout;
+		ThrowIfFailed(device->CreateInputLayout(elements, numElements, nullptr, 0, inputLayout.GetAddressOf()), "an input layout");
+		return inputLayout;
+	}
+
+	std::wstring Widen(const std::string& s) { return std::wstring(s.begin(), s.end()); }
+
+	// What the renderers share: the per-frame and per-object constants, the lights,
+	// the samplers of RenderStateMgr, the queue and the constant ring of
+	// DeviceResources, one per scene here.
+	class HeadlessScene : public SceneRenderer
+	{
+	public:
+		HeadlessScene(RenderDevice* device, RecordingRenderContext* context, const std::shared_ptr<Camera>& camera) :
+			m_device(device), m_context(context), m_camera(camera), m_initialized(false), m_loadingComplete(false)
+		{
+		}
+
+		virtual void CreateWindowSizeDependentResources() {}
+		virtual bool GetLoadState() { return m_loadingComplete; }
+		virtual bool GetInitializedState() { return m_initialized; }
+
+	protected:
+		void CreateSharedResources()
+		{
+			m_perFrameCB.Initialize(m_device);
+			m_perObjectCB.Initialize(m_device);
+			m_linearSam = CreateSampler(m_device, D3D11_FILTER_MIN_MAG_MIP_LINEAR, D3D11_TEXTURE_ADDRESS_WRAP);
+			m_linearMipPointSam = CreateSampler(m_device, D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT, D3D11_TEXTURE_ADDRESS_WRAP);
+			m_shadowSam = CreateSampler(m_device, D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT, D3D11_TEXTURE_ADDRESS_BORDER);
+			m_constantRing.Initialize(m_device, 256 * 1024);
+		}
+
+		void ReleaseSharedResources()
+		{
+			m_perFrameCB.Reset();
+			m_perObjectCB.Reset();
+			m_linearSam.Reset();
+			m_linearMipPointSam.Reset();
+			m_shadowSam.Reset();
+			m_constantRing.Reset();
+		}
+
+		// Updates the per-frame constant buffer, as the renderers' Render does.
+		void ApplyPerFrame(float fogStart, float fogRange)
+		{
+			XMMATRIX view = m_camera->View();
+			XMMATRIX proj = m_camera->Proj();
+			XMMATRIX viewProj = m_camera->ViewProj();
+
+			XMStoreFloat4x4(&m_perFrameCB.Data.View, XMMatrixTranspose(view));
+			XMVECTOR det = XMMatrixDeterminant(view);
+			XMStoreFloat4x4(&m_perFrameCB.Data.InvView, XMMatrixTranspose(XMMatrixInverse(&det, view)));
+			XMStoreFloat4x4(&m_perFrameCB.Data.Proj, XMMatrixTranspose(proj));
+			det = XMMatrixDeterminant(proj);
+			XMStoreFloat4x4(&m_perFrameCB.Data.InvProj, XMMatrixTranspose(XMMatrixInverse(&det, proj)));
+			XMStoreFloat4x4(&m_perFrameCB.Data.ViewProj, XMMatrixTranspose(viewProj));
+
+			m_perFrameCB.Data.DirLights[0] = m_dirLights[0];
+			m_perFrameCB.Data.DirLights[1] = m_dirLights[1];
+			m_perFrameCB.Data.DirLights[2] = m_dirLights[2];
+			m_perFrameCB.Data.EyePosW = m_camera->GetPosition();
+
+			m_perFrameCB.Data.FogStart = fogStart;
+			m_perFrameCB.Data.FogRange = fogRange;
+			m_perFrameCB.Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
+
+			m_perFrameCB.ApplyChanges(m_context);
+		}
+
+	protected:
+		RenderDevice* m_device;
+		RecordingRenderContext* m_context;
+		std::shared_ptr<Camera> m_camera;
+
+		ConstantBuffer<BasicPerFrameCB> m_perFrameCB;
+		ConstantBuffer<BasicPerObjectCB> m_perObjectCB;
+		ComPtr<ID3D11SamplerState> m_linearSam;
+		ComPtr<ID3D11SamplerState> m_linearMipPointSam;
+		ComPtr<ID3D11SamplerState> m_shadowSam;
+		DirectionalLight m_dirLights[3];
+		RenderQueue m_renderQueue;
+		ConstantRingBuffer m_constantRing;
+
+		bool m_initialized;
+		bool m_loadingComplete;
+	};
+
+	// TerrainRenderer with Terrain, without the sky.
+	class TerrainScene : public HeadlessScene
+	{
+	public:
+		TerrainScene(RenderDevice* device, RecordingRenderContext* context, const std::shared_ptr<Camera>& camera) :
+			HeadlessScene(device, context, camera), m_numPatchVertRows(0), m_numPatchVertCols(0)
+		{
+			m_camera->SetPosition(0.0f, 2.0f, 60.0f);
+			m_camera->UpdateViewMatrix();
+
+			m_dirLights[0].Ambient = XMFLOAT4(0.3f, 0.3f, 0.3f, 1.0f);
+			m_dirLights[0].Diffuse = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			m_dirLights[0].Specular = XMFLOAT4(0.8f, 0.8f, 0.7f, 1.0f);
+			m_dirLights[0].Direction = XMFLOAT3(0.707f, -0.707f, 0.0f);
+
+			m_dirLights[1].Ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			m_dirLights[1].Diffuse = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+			m_dirLights[1].Specular = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+			m_dirLights[1].Direction = XMFLOAT3(0.57735f, -0.57735f, 0.57735f);
+
+			m_dirLights[2].Ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			m_dirLights[2].Diffuse = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+			m_dirLights[2].Specular = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+			m_dirLights[2].Direction = XMFLOAT3(-0.57735f, -0.57735f, -0.57735f);
+
+			m_terrainMat.Ambient = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			m_terrainMat.Diffuse = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			m_terrainMat.Specular = XMFLOAT4(0.0f, 0.0f, 0.0f, 64.0f);
+			m_terrainMat.Reflect = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+
+		virtual void Initialize()
+		{
+			m_numPatchVertRows = ((HeightmapSize - 1) / CellsPerPatch) + 1;
+			m_numPatchVertCols = ((HeightmapSize - 1) / CellsPerPatch) + 1;
+
+			// Rolling hills in [0, HeightScale], smoothed as a RAW height map is.
+			std::vector<float> heightmap(HeightmapSize * HeightmapSize);
+			for (UINT i = 0; i < HeightmapSize; ++i)
+			{
+				for (UINT j = 0; j < HeightmapSize; ++j)
+				{
+					float h = 0.5f + 0.25f * sinf(0.011f * j) * cosf(0.013f * i) + 0.25f * sinf(0.037f * j + 0.029f * i);
+					heightmap[i * HeightmapSize + j] = h * HeightScale;
+				}
+			}
+			GridFilter filter(GridFilterType::Box, 1, 1);
+			filter.Apply(heightmap.data(), HeightmapSize, HeightmapSize);
+			m_heightfield.Initialize(std::move(heightmap), HeightmapSize, HeightmapSize, CellSpacing);
+
+			// Every patch is a block of the heightfield's pyramid.
+			m_patchBoundsY.resize((m_numPatchVertRows - 1) * (m_numPatchVertCols - 1));
+			const std::vector<XMFLOAT2>& bounds = m_heightfield.GetBoundsY(TerrainHeightfield::PatchLevel);
+			UINT cols = m_heightfield.GetBlockCounts(TerrainHeightfield::PatchLevel).x;
+			for (UINT i = 0; i < m_numPatchVertRows - 1; ++i)
+				for (UINT j = 0; j < m_numPatchVertCols - 1; ++j)
+					m_patchBoundsY[i * (m_numPatchVertCols - 1) + j] = bounds[i * cols + j];
+			m_quadtree.Build(m_patchBoundsY, m_numPatchVertRows - 1, m_numPatchVertCols - 1, -0.5f * GetWidth(), 0.5f * GetWidth(),
+				GetWidth() / (m_numPatchVertCols - 1), GetWidth() / (m_numPatchVertRows - 1));
+
+			m_initialized = true;
+		}
+
+		virtual void CreateDeviceDependentResources()
+		{
+			if (!m_initialized)
+				return;
+
+			CreateSharedResources();
+			m_terrainSettingsCB.Initialize(m_device);
+			m_frustumCB.Initialize(m_device);
+			m_terrainSettingsCB.Data.MaxDist = 500.0f;
+			m_terrainSettingsCB.Data.MaxTess = 6.0f;
+			m_terrainSettingsCB.Data.MinDist = 20.0f;
+			m_terrainSettingsCB.Data.MinTess = 0.0f;
+			m_terrainSettingsCB.Data.TexelCellSpaceU = 1.0f / HeightmapSize;
+			m_terrainSettingsCB.Data.TexelCellSpaceV = 1.0f / HeightmapSize;
+			m_terrainSettingsCB.Data.TexScale = XMFLOAT2(50.0f, 50.0f);
+			m_terrainSettingsCB.Data.WorldCellSpace = CellSpacing;
+			m_terrainSettingsCB.ApplyChanges(m_context);
+
+			m_terrainVS = CreateShader<ID3D11VertexShader>(m_device);
+			m_terrainInputLayout = CreateInputLayout(m_device, PosTexBoundDesc, 3);
+			m_terrainHS = CreateShader<ID3D11HullShader>(m_device);
+			m_terrainDS = CreateShader<ID3D11DomainShader>(m_device);
+			m_terrainLight3TexPS = CreateShader<ID3D11PixelShader>(m_device);
+			m_layerMapArraySRV = CreateTextureView(m_device, 512, 512, 5, DXGI_FORMAT_R8G8B8A8_UNORM);
+			m_blendMapSRV = CreateTextureView(m_device, 512, 512, 1, DXGI_FORMAT_R8G8B8A8_UNORM);
+			m_heightMapSRV = CreateTextureView(m_device, HeightmapSize, HeightmapSize, 1, DXGI_FORMAT_R16_FLOAT);
+
+			BuildQuadPatchVB();
+			BuildQuadPatchIB();
+			m_loadingComplete = true;
+		}
+
+		virtual void ReleaseDeviceDependentResources()
+		{
+			m_loadingComplete = false;
+			ReleaseSharedResources();
+			m_terrainSettingsCB.Reset();
+			m_frustumCB.Reset();
+			m_quadPatchVB.Reset();
+			m_quadPatchIB.Reset();
+			m_terrainInputLayout.Reset();
+			m_terrainVS.Reset();
+			m_terrainHS.Reset();
+			m_terrainDS.Reset();
+			m_terrainLight3TexPS.Reset();
+			m_layerMapArraySRV.Reset();
+			m_blendMapSRV.Reset();
+			m_heightMapSRV.Reset();
+		}
+
+		virtual void Update(GameTimer const&)
+		{
+			if (!m_loadingComplete)
+				return;
+
+			XMFLOAT3 camPos = m_camera->GetPosition();
+			float y = m_heightfield.GetHeight(camPos.x, camPos.z);
+			m_camera->SetPosition(camPos.x, y + 2.0f, camPos.z);
+		}
+
+		virtual void Render()
+		{
+			if (!m_loadingComplete)
+				return;
+
+			ApplyPerFrame(15.0f, 175.0f);
+			m_renderQueue.Begin(RenderPass::Color);
+			Submit(m_renderQueue);
+			m_renderQueue.Execute(m_context, &m_constantRing);
+		}
+
+	private:
+		struct TerrainSettingsCB
+		{
+			XMFLOAT2 TexScale;
+			float MinDist;
+			float MaxDist;
+			float MinTess;
+			float MaxTess;
+			float TexelCellSpaceU;
+			float TexelCellSpaceV;
+			float WorldCellSpace;
+		};
+		struct FrustumCB
+		{
+			XMFLOAT4 WorldFrustumPlanes[6];
+		};
+
+		static const UINT HeightmapSize = 2049;
+		static const UINT CellsPerPatch = 1 << TerrainHeightfield::PatchLevel;
+		static constexpr float CellSpacing = 0.5f;
+		static constexpr float HeightScale = 50.0f;
+
+		float GetWidth()const { return (HeightmapSize - 1) * CellSpacing; }
+
+		// As Terrain::Submit
+		void Submit(RenderQueue& queue)
+		{
+			XMFLOAT4X4 VP;
+			XMStoreFloat4x4(&VP, XMMatrixTranspose(XMLoadFloat4x4(&m_perFrameCB.Data.ViewProj)));
+			ExtractFrustumPlanes(m_frustumCB.Data.WorldFrustumPlanes, VP);
+			m_quadtree.Select(m_frustumCB.Data.WorldFrustumPlanes, m_perFrameCB.Data.EyePosW, m_visiblePatches);
+			if (m_visiblePatches.empty())
+				return;
+
+			D3D11_MAPPED_SUBRESOURCE mappedData;
+			ThrowIfFailed(m_context->Map(m_quadPatchIB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData), "an index buffer mapping");
+			UINT* indices = reinterpret_cast<UINT*>(mappedData.pData);
+			for (UINT patchID : m_visiblePatches)
+			{
+				UINT i = patchID / (m_numPatchVertCols - 1);
+				UINT j = patchID % (m_numPatchVertCols - 1);
+				indices[0] = i*m_numPatchVertCols + j;
+				indices[1] = i*m_numPatchVertCols + j + 1;
+				indices[2] = (i + 1)*m_numPatchVertCols + j;
+				indices[3] = (i + 1)*m_numPatchVertCols + j + 1;
+				indices += 4;
+			}
+			m_context->Unmap(m_quadPatchIB.Get(), 0);
+
+			DrawState state;
+			UINT stride = sizeof(PosTexBound);
+			state.InputLayout = m_terrainInputLayout.Get();
+			state.Topology = D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST;
+			state.SetVertexBuffers(1, m_quadPatchVB.GetAddressOf(), &stride);
+			state.IndexBuffer = m_quadPatchIB.Get();
+			state.IndexFormat = DXGI_FORMAT_R32_UINT;
+
+			ID3D11Buffer* cbuffers0[3] = { m_perFrameCB.GetBuffer(), m_terrainSettingsCB.GetBuffer(), m_frustumCB.GetBuffer() };
+			ID3D11Buffer* cbuffers1[3] = { m_perFrameCB.GetBuffer(), m_perObjectCB.GetBuffer(), m_terrainSettingsCB.GetBuffer() };
+			ID3D11SamplerState* samplers[2] = { m_linearMipPointSam.Get(), m_linearSam.Get() };
+			state.SetShader(ShaderStage::Vertex, m_terrainVS.Get());
+			state.SetSamplers(ShaderStage::Vertex, 0, 1, samplers);
+			state.SetShaderResources(ShaderStage::Vertex, 0, 1, m_heightMapSRV.GetAddressOf());
+			state.SetShader(ShaderStage::Hull, m_terrainHS.Get());
+			state.SetConstantBuffers(ShaderStage::Hull, 0, 3, cbuffers0);
+			state.SetShader(ShaderStage::Domain, m_terrainDS.Get());
+			state.SetConstantBuffers(ShaderStage::Domain, 0, 2, cbuffers0);
+			state.SetSamplers(ShaderStage::Domain, 0, 1, samplers);
+			state.SetShaderResources(ShaderStage::Domain, 0, 1, m_heightMapSRV.GetAddressOf());
+			state.SetShader(ShaderStage::Pixel, m_terrainLight3TexPS.Get());
+			state.SetConstantBuffers(ShaderStage::Pixel, 0, 3, cbuffers1);
+			state.SetSamplers(ShaderStage::Pixel, 0, 2, samplers);
+			ID3D11ShaderResourceView* srvs[] = { m_layerMapArraySRV.Get(), m_blendMapSRV.Get(), m_heightMapSRV.Get() };
+			state.SetShaderResources(ShaderStage::Pixel, 0, 3, srvs);
+
+			m_perObjectCB.Data.Mat = m_terrainMat;
+			queue.SetConstants(m_perObjectCB);
+			queue.SetConstants(m_frustumCB);
+
+			queue.DrawIndexed(queue.AddState(state), (UINT)m_visiblePatches.size() * 4, 0, 0);
+		}
+
+		void BuildQuadPatchVB()
+		{
+			std::vector<PosTexBound> patchVertices(m_numPatchVertRows*m_numPatchVertCols);
+			float halfWidth = 0.5f*GetWidth();
+			float patchWidth = GetWidth() / (m_numPatchVertCols - 1);
+			float patchDepth = GetWidth() / (m_numPatchVertRows - 1);
+			float du = 1.0f / (m_numPatchVertCols - 1);
+			float dv = 1.0f / (m_numPatchVertRows - 1);
+			for (UINT i = 0; i < m_numPatchVertRows; ++i)
+			{
+				for (UINT j = 0; j < m_numPatchVertCols; ++j)
+				{
+					PosTexBound& vertex = patchVertices[i*m_numPatchVertCols + j];
+					vertex.Pos = XMFLOAT3(-halfWidth + j*patchWidth, 0.0f, halfWidth - i*patchDepth);
+					vertex.Tex = XMFLOAT2(j*du, i*dv);
+					vertex.BoundsY = XMFLOAT2(0.0f, 0.0f);
+				}
+			}
+			for (UINT i = 0; i < m_numPatchVertRows - 1; ++i)
+				for (UINT j = 0; j < m_numPatchVertCols - 1; ++j)
+					patchVertices[i*m_numPatchVertCols + j].BoundsY = m_patchBoundsY[i*(m_numPatchVertCols - 1) + j];
+			m_quadPatchVB = CreateBuffer(m_device, (UINT)(sizeof(PosTexBound) * patchVertices.size()), D3D11_BIND_VERTEX_BUFFER,
+				patchVertices.data());
+		}
+
+		void BuildQuadPatchIB()
+		{
+			// Submit rewrites it with the visible patches every pass.
+			UINT quads = (m_numPatchVertRows - 1)*(m_numPatchVertCols - 1);
+			m_quadPatchIB = CreateBuffer(m_device, sizeof(UINT) * quads * 4, D3D11_BIND_INDEX_BUFFER, nullptr);
+		}
+
+	private:
+		ConstantBuffer<TerrainSettingsCB> m_terrainSettingsCB;
+		ConstantBuffer<FrustumCB> m_frustumCB;
+		ComPtr<ID3D11Buffer> m_quadPatchVB;
+		ComPtr<ID3D11Buffer> m_quadPatchIB;
+		ComPtr<ID3D11InputLayout> m_terrainInputLayout;
+		ComPtr<ID3D11VertexShader> m_terrainVS;
+		ComPtr<ID3D11HullShader> m_terrainHS;
+		ComPtr<ID3D11DomainShader> m_terrainDS;
+		ComPtr<ID3D11PixelShader> m_terrainLight3TexPS;
+		ComPtr<ID3D11ShaderResourceView> m_layerMapArraySRV;
+		ComPtr<ID3D11ShaderResourceView> m_blendMapSRV;
+		ComPtr<ID3D11ShaderResourceView> m_heightMapSRV;
+
+		UINT m_numPatchVertRows;
+		UINT m_numPatchVertCols;
+		Material m_terrainMat;
+		std::vector<XMFLOAT2> m_patchBoundsY;
+		TerrainQuadtree m_quadtree;
+		std::vector<UINT> m_visiblePatches;
+		TerrainHeightfield m_heightfield;
+	};
+
+	// MeshModelRenderer or SkinnedMeshModelRenderer with their MeshObject, one
+	// instance drawn in the color pass.
+	class MeshScene : public HeadlessScene
+	{
+	public:
+		MeshScene(RenderDevice* device, RecordingRenderContext* context, const std::shared_ptr<Camera>& camera,
+			const std::string& mediaDir, bool skinned) :
+			HeadlessScene(device, context, camera), m_mediaDir(mediaDir), m_skinned(skinned), m_lightRotationAngle(0.0f)
+		{
+			m_dirLights[0].Ambient = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+			m_dirLights[0].Diffuse = XMFLOAT4(0.7f, 0.7f, 0.6f, 1.0f);
+			m_dirLights[0].Specular = XMFLOAT4(0.8f, 0.8f, 0.7f, 1.0f);
+			m_dirLights[0].Direction = XMFLOAT3(-0.57735f, -0.57735f, 0.57735f);
+
+			m_dirLights[1].Ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			m_dirLights[1].Diffuse = XMFLOAT4(0.40f, 0.40f, 0.40f, 1.0f);
+			m_dirLights[1].Specular = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+			m_dirLights[1].Direction = XMFLOAT3(0.707f, -0.707f, 0.0f);
+
+			m_dirLights[2].Ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			m_dirLights[2].Diffuse = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+			m_dirLights[2].Specular = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+			m_dirLights[2].Direction = XMFLOAT3(0.0f, 0.0, -1.0f);
+
+			for (int i = 0; i < 3; ++i)
+				m_originalLightDir[i] = m_dirLights[i].Direction;
+		}
+
+		virtual void Initialize()
+		{
+			XMMATRIX world;
+			if (m_skinned)
+			{
+				m_source = X3DLoader::LoadX3dSkinned(Widen(m_mediaDir + "/Meshes/DHellFighter/DHellFighter.x3d"),
+					m_skinnedVertices, m_indices, m_subsets, m_materials, m_skinInfo);
+				world = XMMatrixScaling(0.1f, 0.1f, 0.1f) * XMMatrixRotationY(MathHelper::Pi) * XMMatrixTranslation(0.0f, -5.0f, 10.0f);
+			}
+			else
+			{
+				m_source = X3DLoader::LoadX3dStatic(Widen(m_mediaDir + "/Meshes/Rocket/Rocket.x3d"),
+					m_vertices, m_indices, m_subsets, m_materials);
+				world = XMMatrixScaling(0.1f, 0.1f, 0.1f) * XMMatrixRotationX(-0.5f * MathHelper::Pi) * XMMatrixTranslation(0.0f, 0.0f, 10.0f);
+			}
+			m_worlds.resize(1);
+			XMStoreFloat4x4(&m_worlds[0], world);
+
+			if (m_skinned)
+			{
+				auto vertices = GetSkinnedVertices();
+				BoundingBox::CreateFromPoints(m_boundingBox, vertices.size(), &vertices[0].Pos, sizeof(PosNormalTexTanSkinned));
+			}
+			else
+			{
+				auto vertices = GetVertices();
+				BoundingBox::CreateFromPoints(m_boundingBox, vertices.size(), &vertices[0].Pos, sizeof(PosNormalTexTan));
+			}
+			BoundingSphere::CreateFromBoundingBox(m_boundingSphere, m_boundingBox);
+
+			// The clip is started, so that every frame poses the bones.
+			if (m_skinned)
+			{
+				UINT numBones = m_skinInfo.GetBoneCount();
+				m_playbacks.resize(m_worlds.size());
+				m_palettes.resize(m_worlds.size() * numBones);
+				for (UINT i = 0; i < m_worlds.size(); ++i)
+				{
+					m_skinInfo.ResetPlayback(m_playbacks[i], m_skinInfo.GetClipHandle(L"all_in_one"));
+					m_skinInfo.GetFinalTransforms(m_playbacks[i], &m_palettes[i * numBones]);
+					m_playbacks[i].TimePos = 0.0f;
+				}
+			}
+			m_initialized = true;
+		}
+
+		virtual void CreateDeviceDependentResources()
+		{
+			if (!m_initialized)
+				return;
+
+			CreateSharedResources();
+			if (m_skinned)
+				m_skinnedCB.Initialize(m_device);
+			D3D11_RASTERIZER_DESC noCullDesc;
+			ZeroMemory(&noCullDesc, sizeof(noCullDesc));
+			noCullDesc.FillMode = D3D11_FILL_SOLID;
+			noCullDesc.CullMode = D3D11_CULL_NONE;
+			noCullDesc.DepthClipEnable = true;
+			ThrowIfFailed(m_device->CreateRasterizerState(&noCullDesc, m_noCullRS.GetAddressOf()), "a rasterizer state");
+
+			m_meshVS = CreateShader<ID3D11VertexShader>(m_device);
+			m_meshVSNormal = CreateShader<ID3D11VertexShader>(m_device);
+			m_inputLayout = m_skinned ? CreateInputLayout(m_device, PosNormalTexTanSkinnedDesc, 6) :
+				CreateInputLayout(m_device, PosNormalTexTanDesc, 4);
+
+			// One pixel shader per effect and one view per texture file, shared by the
+			// materials using them as ShaderMgr and TextureMgr share them.
+			std::map<EffectType, ComPtr<ID3D11PixelShader>> shaders;
+			std::map<std::wstring, ComPtr<ID3D11ShaderResourceView>> textures;
+			auto getTexture = [&](const std::wstring& name)
+			{
+				if (name == L"" || name == L"Null")
+					return ComPtr<ID3D11ShaderResourceView>();
+				auto& view = textures[name];
+				if (!view)
+					view = CreateTextureView(m_device, 512, 512, 1, DXGI_FORMAT_R8G8B8A8_UNORM);
+				return view;
+			};
+			for (auto& material : m_materials)
+			{
+				auto& ps = shaders[material.Effect];
+				if (!ps)
+					ps = CreateShader<ID3D11PixelShader>(m_device);
+				m_meshPS.push_back(ps);
+				m_diffuseMapSRV.push_back(getTexture(material.DiffuseMap));
+				m_norMapSRV.push_back(getTexture(material.NormalMap));
+			}
+
+			if (m_skinned)
+			{
+				auto vertices = GetSkinnedVertices();
+				m_objectVB = CreateBuffer(m_device, (UINT)(sizeof(PosNormalTexTanSkinned) * vertices.size()), D3D11_BIND_VERTEX_BUFFER, vertices.Data);
+			}
+			else
+			{
+				auto vertices = GetVertices();
+				m_objectVB = CreateBuffer(m_device, (UINT)(sizeof(PosNormalTexTan) * vertices.size()), D3D11_BIND_VERTEX_BUFFER, vertices.Data);
+			}
+			auto indices16 = m_source ? m_source->GetIndices16() : X3dSpan<USHORT>();
+			if (!indices16.empty())
+			{
+				m_objectIB = CreateBuffer(m_device, (UINT)(sizeof(USHORT) * indices16.size()), D3D11_BIND_INDEX_BUFFER, indices16.Data);
+				m_indexFormat = DXGI_FORMAT_R16_UINT;
+			}
+			else
+			{
+				auto indices = m_source ? m_source->GetIndices() : X3dSpan<UINT>(m_indices.data(), (UINT)m_indices.size());
+				m_objectIB = CreateBuffer(m_device, (UINT)(sizeof(UINT) * indices.size()), D3D11_BIND_INDEX_BUFFER, indices.Data);
+				m_indexFormat = DXGI_FORMAT_R32_UINT;
+			}
+			m_loadingComplete = true;
+		}
+
+		virtual void ReleaseDeviceDependentResources()
+		{
+			m_loadingComplete = false;
+			ReleaseSharedResources();
+			m_skinnedCB.Reset();
+			m_noCullRS.Reset();
+			m_objectVB.Reset();
+			m_objectIB.Reset();
+			m_inputLayout.Reset();
+			m_meshVS.Reset();
+			m_meshVSNormal.Reset();
+			m_meshPS.clear();
+			m_diffuseMapSRV.clear();
+			m_norMapSRV.clear();
+		}
+
+		virtual void Update(GameTimer const& timer)
+		{
+			if (!m_loadingComplete)
+				return;
+
+			// Animate the lights (and hence shadows).
+			m_lightRotationAngle += 0.5f*(float)timer.GetElapsedSeconds();
+			XMMATRIX R = XMMatrixRotationY(m_lightRotationAngle);
+			for (int i = 0; i < 3; ++i)
+			{
+				XMVECTOR lightDir = XMLoadFloat3(&m_originalLightDir[i]);
+				lightDir = XMVector3TransformNormal(lightDir, R);
+				XMStoreFloat3(&m_dirLights[i].Direction, lightDir);
+			}
+
+			// As MeshObject::Update, the clip looping.
+			if (!m_skinned)
+				return;
+			float dt = (float)timer.GetElapsedSeconds();
+			const SkinnedData& skinInfo = m_skinInfo;
+			UINT numBones = skinInfo.GetBoneCount();
+			ParallelFor(0, (UINT)m_playbacks.size(), [&](UINT i)
+			{
+				auto& playback = m_playbacks[i];
+				if (playback.TimePos < 0)
+					return;
+				playback.TimePos += dt;
+				if (playback.TimePos > skinInfo.GetClipEndTime(playback.Clip))
+					playback.TimePos = 0.0f;
+				skinInfo.GetFinalTransforms(playback, &m_palettes[i * numBones]);
+			});
+		}
+
+		virtual void Render()
+		{
+			if (!m_loadingComplete)
+				return;
+
+			ApplyPerFrame(10.0f, 60.0f);
+			m_context->RSSetState(m_noCullRS.Get());
+			m_renderQueue.Begin(RenderPass::Color);
+			Submit(m_renderQueue);
+			m_renderQueue.Execute(m_context, &m_constantRing);
+		}
+
+	private:
+		X3dSpan<PosNormalTexTan> GetVertices()const
+		{
+			return m_source ? m_source->GetVertices() : X3dSpan<PosNormalTexTan>(m_vertices.data(), (UINT)m_vertices.size());
+		}
+		X3dSpan<PosNormalTexTanSkinned> GetSkinnedVertices()const
+		{
+			return m_source ? m_source->GetSkinnedVertices() : X3dSpan<PosNormalTexTanSkinned>(m_skinnedVertices.data(), (UINT)m_skinnedVertices.size());
+		}
+
+		// As MeshObject::CullInstances and Submit for the color pass.
+		void Submit(RenderQueue& queue)
+		{
+			UINT count = (UINT)m_worlds.size();
+			if (m_skinned)
+			{
+				m_visible.resize(count);
+				for (UINT i = 0; i < count; ++i)
+					m_visible[i] = i;
+			}
+			else
+			{
+				XMFLOAT4X4 viewProj;
+				XMStoreFloat4x4(&viewProj, XMMatrixTranspose(XMLoadFloat4x4(&m_perFrameCB.Data.ViewProj)));
+				m_culler.SetViewProj(viewProj);
+				m_culler.Cull(m_boundingSphere, m_worlds.data(), count, m_visible);
+			}
+			if (m_visible.empty())
+				return;
+
+			DrawState state;
+			UINT stride = m_skinned ? sizeof(PosNormalTexTanSkinned) : sizeof(PosNormalTexTan);
+			state.InputLayout = m_inputLayout.Get();
+			state.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			state.SetVertexBuffers(1, m_objectVB.GetAddressOf(), &stride);
+			state.IndexBuffer = m_objectIB.Get();
+			state.IndexFormat = m_indexFormat;
+
+			ID3D11Buffer* cbuffers0[2] = { m_perFrameCB.GetBuffer(), m_perObjectCB.GetBuffer() };
+			ID3D11Buffer* cbuffers1[1] = { m_skinnedCB.GetBuffer() };
+			ID3D11SamplerState* samplers[2] = { m_linearSam.Get(), m_shadowSam.Get() };
+			state.SetConstantBuffers(ShaderStage::Vertex, 0, 2, cbuffers0);
+			if (m_skinned)
+				state.SetConstantBuffers(ShaderStage::Vertex, 3, 1, cbuffers1);
+			state.SetConstantBuffers(ShaderStage::Pixel, 0, 2, cbuffers0);
+			ID3D11ShaderResourceView* maps[3] = { nullptr, nullptr, nullptr };
+			state.SetShaderResources(ShaderStage::Pixel, 2, 3, maps);
+			state.SetSamplers(ShaderStage::Pixel, 0, 2, samplers);
+
+			m_materialStates.assign(m_materials.size(), UINT_MAX);
+			auto getState = [&](UINT index) -> UINT
+			{
+				if (m_materialStates[index] == UINT_MAX)
+				{
+					ID3D11ShaderResourceView* srvs[2] = { m_diffuseMapSRV[index].Get(), m_norMapSRV[index].Get() };
+					state.SetShaderResources(ShaderStage::Pixel, 0, 2, srvs);
+					state.SetShader(ShaderStage::Vertex, m_materials[index].Effect != EffectType::Normal ? m_meshVS.Get() : m_meshVSNormal.Get());
+					state.SetShader(ShaderStage::Pixel, m_meshPS[index].Get());
+					m_materialStates[index] = queue.AddState(state);
+				}
+				return m_materialStates[index];
+			};
+
+			XMVECTOR eye = XMLoadFloat3(&m_perFrameCB.Data.EyePosW);
+			UINT numBones = m_skinned ? m_skinInfo.GetBoneCount() : 0;
+			XMStoreFloat4x4(&m_perObjectCB.Data.TexTransform, XMMatrixIdentity());
+			for (UINT i : m_visible)
+			{
+				XMMATRIX world = XMLoadFloat4x4(&m_worlds[i]);
+				XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
+				XMStoreFloat4x4(&m_perObjectCB.Data.World, XMMatrixTranspose(world));
+				XMStoreFloat4x4(&m_perObjectCB.Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
+				XMVECTOR center = XMVector3Transform(XMLoadFloat3(&m_boundingSphere.Center), world);
+				float depth = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(center, eye)));
+
+				for (auto& item : m_subsets)
+				{
+					m_perObjectCB.Data.Mat = m_materials[item.MtlIndex].Mat;
+					queue.SetConstants(m_perObjectCB);
+					if (m_skinned)
+						queue.SetConstants(m_skinnedCB.GetBuffer(), &m_palettes[i * numBones], numBones * sizeof(XMFLOAT4X4));
+					queue.DrawIndexed(getState(item.MtlIndex), item.IndexCount, item.IndexStart, item.VertexBase, depth);
+				}
+			}
+		}
+
+	private:
+		std::string m_mediaDir;
+		bool m_skinned;
+
+		// The mesh as MeshObjectData holds it
+		std::vector<PosNormalTexTan> m_vertices;
+		std::vector<PosNormalTexTanSkinned> m_skinnedVertices;
+		std::vector<UINT> m_indices;
+		std::vector<Subset> m_subsets;
+		std::shared_ptr<const X3dFile> m_source;
+		std::vector<X3dMaterial> m_materials;
+		SkinnedData m_skinInfo;
+		std::vector<XMFLOAT4X4> m_worlds;
+		BoundingBox m_boundingBox;
+		BoundingSphere m_boundingSphere;
+
+		std::vector<AnimationPlayback> m_playbacks;
+		std::vector<XMFLOAT4X4> m_palettes;
+		FrustumCuller m_culler;
+		std::vector<UINT> m_visible;
+		std::vector<UINT> m_materialStates;
+
+		ConstantBuffer<SkinnedTransforms> m_skinnedCB;
+		ComPtr<ID3D11RasterizerState> m_noCullRS;
+		ComPtr<ID3D11Buffer> m_objectVB;
+		ComPtr<ID3D11Buffer> m_objectIB;
+		DXGI_FORMAT m_indexFormat;
+		ComPtr<ID3D11InputLayout> m_inputLayout;
+		ComPtr<ID3D11VertexShader> m_meshVS;
+		ComPtr<ID3D11VertexShader> m_meshVSNormal;
+		std::vector<ComPtr<ID3D11PixelShader>> m_meshPS;
+		std::vector<ComPtr<ID3D11ShaderResourceView>> m_diffuseMapSRV;
+		std::vector<ComPtr<ID3D11ShaderResourceView>> m_norMapSRV;
+
+		float m_lightRotationAngle;
+		XMFLOAT3 m_originalLightDir[3];
+	};
+}
+
+std::unique_ptr<SceneRenderer> DXFramework::CreateHeadlessScene(const std::string& name, RenderDevice* device,
+	RecordingRenderContext* context, const std::shared_ptr<Camera>& camera, const std::string& mediaDir)
+{
+	if (name == "Terrain")
+		return std::unique_ptr<SceneRenderer>(new TerrainScene(device, context, camera));
+	if (name == "MeshModel")
+		return std::unique_ptr<SceneRenderer>(new MeshScene(device, context, camera, mediaDir, false));
+	if (name == "SkinnedMeshModel")
+		return std::unique_ptr<SceneRenderer>(new MeshScene(device, context, camera, mediaDir, true));
+	return nullptr;
+}
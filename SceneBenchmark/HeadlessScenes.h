@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Common/Camera.h"
+#include "Common/RecordingRenderContext.h"
+#include "Common/RenderDevice.h"
+#include "Content/SceneRenderer.h"
+#include <memory>
+#include <string>
+
+// The CPU side of scenes of the game, as SceneRenderers that run without a window
+// or GPU: they create their resources on a RenderDevice, usually NullRenderDevice,
+// and submit every frame through a RenderQueue to a RecordingRenderContext, usually
+// its null backend. They mirror TerrainRenderer with Terrain, and MeshModelRenderer
+// and SkinnedMeshModelRenderer with MeshObject, which still need C++/CX: the same
+// selection, culling, animation, constants and draws, without the sky. Shaders have
+// no byte code and the views of the texture files are made of empty textures, so
+// the device has to be a null one.
+// The terrain's height map is generated, as Media has no terrain.raw, the static
+// mesh is Rocket, as it has no Eagle, and the skinned mesh's clip is started.
+
+namespace DXFramework
+{
+	// Names CreateHeadlessScene accepts, null terminated.
+	extern const char* const HeadlessSceneNames[];
+
+	// The scene with the given name, e.g. "Terrain", nullptr for an unknown one.
+	// Meshes are read from mediaDir, the Media folder of the game. device and
+	// context must outlive it.
+	std::unique_ptr<SceneRenderer> CreateHeadlessScene(const std::string& name, DX::RenderDevice* device,
+		DX::RecordingRenderContext* context, const std::shared_ptr<DX::Camera>& camera, const std::string& mediaDir);
+}
@@ -0,0 +1,179 @@
+// Runs the CPU side of scenes of the game without a window or GPU: each scene is
+// created on a NullRenderDevice and replays a camera path through PathReplay, one
+// fixed GameTimer::Step a frame, submitting to a null RecordingRenderContext. The
+// frame times go to benchmark_<scene>.csv and a line per scene is appended to
+// benchmark_summary.csv, as the game's benchmark mode writes them, and the recorded
+// commands of the run are printed. Fails if a scene draws nothing or leaves objects
+// of the device alive once released.
+//
+// Usage: SceneBenchmark MediaDir [scene...] [-frames N] [-path path.txt] [-quick]
+// Without scenes all of them run. The path defaults to an orbit around the origin,
+// and the frames to its length, or 120 with -quick.
+
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Common/CameraPath.h"
+#include "Common/NullRenderDevice.h"
+#include "Common/PathReplay.h"
+#include "HeadlessScenes.h"
+
+using namespace std;
+using namespace DirectX;
+using namespace DX;
+using namespace DXFramework;
+
+namespace
+{
+	double Milliseconds(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end)
+	{
+		return chrono::duration<double, milli>(end - start).count();
+	}
+
+	// Returns false if the scene drew nothing or leaked.
+	bool RunScene(const string& name, const string& mediaDir, const CameraPath& path, UINT frameCount)
+	{
+		RecordingRenderContext context;
+		context.SetLogging(false);
+		NullRenderDevice device(&context);
+		auto camera = make_shared<Camera>();
+		camera->SetLens(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+		GameTimer timer;
+		timer.SetFixedTimeStep(true);
+		PathReplay replay;
+		UINT64 draws = 0, indices = 0, maps = 0, bytesMapped = 0, stateChanges = 0, redundant = 0;
+		{
+			unique_ptr<SceneRenderer> scene = CreateHeadlessScene(name, &device, &context, camera, mediaDir);
+			if (!scene)
+			{
+				cout << "Unknown scene " << name << endl;
+				return false;
+			}
+			auto loadStart = chrono::steady_clock::now();
+			scene->Initialize();
+			scene->CreateDeviceDependentResources();
+			scene->CreateWindowSizeDependentResources();
+			cout << name << ": loaded in " << Milliseconds(loadStart, chrono::steady_clock::now()) << " ms, "
+				<< device.GetLiveObjects() << " objects" << endl;
+
+			replay.Start(path, frameCount, timer);
+			auto frameStart = chrono::steady_clock::now();
+			double updateMs = 0.0, renderMs = 0.0;
+			while (true)
+			{
+				// The previous frame ends here, as in DXFrameworkMain::Update.
+				auto now = chrono::steady_clock::now();
+				if (replay.AddFrame(Milliseconds(frameStart, now), updateMs, renderMs))
+					break;
+				frameStart = now;
+
+				replay.Step(timer, *camera, [&]()
+				{
+					scene->Update(timer);
+				});
+				auto updateEnd = chrono::steady_clock::now();
+				context.BeginFrame();
+				scene->Render();
+				auto renderEnd = chrono::steady_clock::now();
+				updateMs = Milliseconds(now, updateEnd);
+				renderMs = Milliseconds(updateEnd, renderEnd);
+
+				const RenderCounters& counters = context.GetCounters();
+				draws += counters.Draws;
+				indices += counters.Vertices;
+				maps += counters.Maps;
+				bytesMapped += counters.BytesMapped;
+				stateChanges += counters.StateChanges;
+				redundant += counters.RedundantStateChanges;
+			}
+			scene->ReleaseDeviceDependentResources();
+		}
+
+		const FrameStats& stats = replay.GetStats();
+		ofstream frames("benchmark_" + name + ".csv");
+		stats.WriteCsv(frames);
+		// One line per run, appended, for comparing builds.
+		bool newFile = !ifstream("benchmark_summary.csv");
+		ofstream summary("benchmark_summary.csv", ios::app);
+		if (newFile)
+			FrameStats::WriteSummaryCsvHeader(summary);
+		stats.WriteSummaryCsv(summary, name);
+
+		UINT64 frameTotal = stats.GetTotalFrames();
+		cout << name << ": " << frameTotal << " frames, average " << stats.GetAverageMs() << " ms (update "
+			<< stats.GetAverageUpdateMs() << ", render " << stats.GetAverageRenderMs() << "), 99th percentile "
+			<< stats.GetPercentileMs(0.99) << " ms" << endl;
+		cout << name << ": per frame " << (double)draws / frameTotal << " draws, " << (double)indices / frameTotal
+			<< " indices, " << (double)maps / frameTotal << " maps of " << (double)bytesMapped / frameTotal << " bytes, "
+			<< (double)stateChanges / frameTotal << " state changes of which " << (double)redundant / frameTotal
+			<< " redundant" << endl;
+
+		bool passed = true;
+		if (draws == 0)
+		{
+			cout << name << ": nothing was drawn" << endl;
+			passed = false;
+		}
+		if (device.GetLiveObjects() != 0)
+		{
+			cout << name << ": " << device.GetLiveObjects() << " objects are still alive" << endl;
+			passed = false;
+		}
+		return passed;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cout << "Usage: SceneBenchmark MediaDir [scene...] [-frames N] [-path path.txt] [-quick]" << endl;
+		return -1;
+	}
+	string mediaDir = argv[1];
+	vector<string> scenes;
+	string pathFile;
+	UINT frameCount = 0;
+	for (int i = 2; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "-quick")
+			frameCount = frameCount ? frameCount : 120;
+		else if (arg == "-frames" && i + 1 < argc)
+			frameCount = (UINT)stoul(argv[++i]);
+		else if (arg == "-path" && i + 1 < argc)
+			pathFile = argv[++i];
+		else
+			scenes.push_back(arg);
+	}
+	if (scenes.empty())
+		for (const char* const* name = HeadlessSceneNames; *name; ++name)
+			scenes.push_back(*name);
+
+	try
+	{
+		CameraPath path = CameraPath::Orbit(XMFLOAT3(0.0f, 0.0f, 0.0f), 30.0f, 10.0f, 20.0);
+		if (!pathFile.empty())
+		{
+			ifstream fin(pathFile);
+			if (!fin)
+				throw runtime_error("Can not open the path file!");
+			path.Load(fin);
+		}
+
+		bool passed = true;
+		for (auto& scene : scenes)
+			passed = RunScene(scene, mediaDir, path, frameCount) && passed;
+		return passed ? 0 : 1;
+	}
+	catch (exception& e)
+	{
+		cout << "Error: " << e.what() << endl;
+		return -1;
+	}
+}
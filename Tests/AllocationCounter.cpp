@@ -0,0 +1,32 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "AllocationCounter.h"
+
+namespace
+{
+	std::atomic<unsigned long long> g_allocations(0);
+}
+
+unsigned long long DX::Test::GetAllocations()
+{
+	return g_allocations;
+}
+
+void* operator new(size_t size)
+{
+	++g_allocations;
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// Counts the calls to the global operator new, for the tests checking that a path
+// allocates nothing. The operators are replaced in AllocationCounter.cpp, a unit of
+// their own, so that they aren't inlined into the callers, where GCC takes the free
+// in operator delete for freeing memory from new.
+
+namespace DX
+{
+	namespace Test
+	{
+		unsigned long long GetAllocations();
+	}
+}
@@ -0,0 +1,136 @@
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Components/X3DLoader.h"
+#include "TestHelpers.h"
+
+// Samples every clip of the skinned meshes OptimizeX3D converted with and without
+// -compress-clips, and checks the compressed palettes stay within the tolerances of
+// the compressor. It prints the max errors and the load times of both files.
+// Usage: AnimationCompressionTest v2Directory
+
+using namespace DirectX;
+using namespace DXFramework;
+
+namespace
+{
+	struct Mesh
+	{
+		const char* Name;
+	};
+
+	const Mesh Meshes[] = { { "DTiger" }, { "DHellFighter" }, { "DZombie0" }, { "DZombie1" } };
+
+	const UINT SamplesPerClip = 300;
+
+	// The compressor keeps rotations within 0.002 rad and translations within 0.0005
+	// of the clip extent, but keys closer together than its 16-bit time step move
+	// by up to 0.4 degrees around them (DHellFighter's all_in_one clip). Bones
+	// add up the errors of their tracks, and translations are measured against
+	// the mesh here.
+	const float MaxRotationError = 0.01f;
+	const float MaxTranslationError = 0.01f;
+
+	struct SkinnedMesh
+	{
+		std::shared_ptr<const X3dFile> Source;
+		std::vector<DX::PosNormalTexTanSkinned> Vertices;
+		std::vector<UINT> Indices;
+		std::vector<Subset> Subsets;
+		std::vector<X3dMaterial> Materials;
+		SkinnedData SkinInfo;
+	};
+
+	double Load(const std::string& filename, SkinnedMesh& mesh)
+	{
+		DX::Test::Stopwatch watch;
+		mesh.Source = X3DLoader::LoadX3dSkinned(std::wstring(filename.begin(), filename.end()),
+			mesh.Vertices, mesh.Indices, mesh.Subsets, mesh.Materials, mesh.SkinInfo);
+		return watch.GetMs();
+	}
+
+	// The size of the mesh, which the translation errors are relative to.
+	float GetExtent(const SkinnedMesh& mesh)
+	{
+		BoundingBox box;
+		auto vertices = mesh.Source->GetSkinnedVertices();
+		BoundingBox::CreateFromPoints(box, vertices.size(), &vertices[0].Pos, sizeof(DX::PosNormalTexTanSkinned));
+		return 2.0f * (std::max)((std::max)(box.Extents.x, box.Extents.y), box.Extents.z);
+	}
+
+	// Plays every clip of both meshes forward and returns the max error of the
+	// rotation part, relative to its scale, and of the translation.
+	void Compare(const SkinnedMesh& raw, const SkinnedMesh& compressed, float& rotationError, float& translationError)
+	{
+		UINT numBones = raw.SkinInfo.GetBoneCount();
+		std::vector<XMFLOAT4X4> expected(numBones), actual(numBones);
+		AnimationPlayback rawPlayback, compressedPlayback;
+		rotationError = translationError = 0.0f;
+		for (ClipHandle clip = 0; clip < raw.SkinInfo.GetClipCount(); ++clip)
+		{
+			raw.SkinInfo.ResetPlayback(rawPlayback, clip);
+			compressed.SkinInfo.ResetPlayback(compressedPlayback, clip);
+			float startTime = raw.SkinInfo.GetClipStartTime(clip);
+			float endTime = raw.SkinInfo.GetClipEndTime(clip);
+			for (UINT sample = 0; sample <= SamplesPerClip; ++sample)
+			{
+				rawPlayback.TimePos = compressedPlayback.TimePos = startTime + (endTime - startTime) * sample / SamplesPerClip;
+				raw.SkinInfo.GetFinalTransforms(rawPlayback, expected.data());
+				compressed.SkinInfo.GetFinalTransforms(compressedPlayback, actual.data());
+				for (UINT b = 0; b < numBones; ++b)
+				{
+					// Pre-transposed: the rows hold the axes, the last column the translation.
+					const XMFLOAT4X4& e = expected[b];
+					const XMFLOAT4X4& a = actual[b];
+					float scale = 0.0f;
+					for (int r = 0; r < 3; ++r)
+						scale = (std::max)(scale, sqrtf(e.m[r][0] * e.m[r][0] + e.m[r][1] * e.m[r][1] + e.m[r][2] * e.m[r][2]));
+					for (int r = 0; r < 3; ++r)
+					{
+						for (int c = 0; c < 3; ++c)
+							rotationError = (std::max)(rotationError, fabsf(a.m[r][c] - e.m[r][c]) / scale);
+						translationError = (std::max)(translationError, fabsf(a.m[r][3] - e.m[r][3]));
+					}
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: AnimationCompressionTest v2Directory\n");
+		return 1;
+	}
+	std::string v2Directory = argv[1];
+
+	printf("%-14s %6s %6s %12s %12s %10s %10s\n", "Mesh", "Bones", "Clips", "Rotation", "Translation", "Raw ms", "Packed ms");
+	for (const Mesh& info : Meshes)
+	{
+		SkinnedMesh raw, compressed;
+		double rawMs = Load(v2Directory + "/" + info.Name + ".x3d", raw);
+		double compressedMs = Load(v2Directory + "/" + info.Name + "Compressed.x3d", compressed);
+		if (!DX_CHECK(raw.Source != nullptr && compressed.Source != nullptr))
+			continue;
+		DX_CHECK(!raw.Source->HasCompressedClips() && compressed.Source->HasCompressedClips());
+		DX_CHECK(raw.SkinInfo.GetBoneCount() == compressed.SkinInfo.GetBoneCount());
+		if (!DX_CHECK(raw.SkinInfo.GetClipCount() == compressed.SkinInfo.GetClipCount()))
+			continue;
+		for (ClipHandle clip = 0; clip < raw.SkinInfo.GetClipCount(); ++clip)
+			DX_CHECK(fabsf(raw.SkinInfo.GetClipEndTime(clip) - compressed.SkinInfo.GetClipEndTime(clip)) < 1e-3f);
+
+		float rotationError, translationError;
+		Compare(raw, compressed, rotationError, translationError);
+		translationError /= GetExtent(raw);
+		DX_CHECK(rotationError < MaxRotationError);
+		DX_CHECK(translationError < MaxTranslationError);
+		printf("%-14s %6u %6u %12.5f %12.5f %10.3f %10.3f\n", info.Name, raw.SkinInfo.GetBoneCount(), raw.SkinInfo.GetClipCount(),
+			rotationError, translationError, rawMs, compressedMs);
+	}
+	return DX::Test::Result();
+}
@@ -0,0 +1,174 @@
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Common/BoundingVolumeHierarchy.h"
+#include "TestHelpers.h"
+
+// Checks the frustum queries of BoundingVolumeHierarchy against testing every box
+// against the planes, for random boxes and random perspective and orthographic
+// frustums, before and after refitting, one frustum and many per walk.
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+	const UINT ItemCount = 5000;
+	const float WorldSize = 200.0f;
+
+	std::vector<BoundingBox> RandomBoxes(std::mt19937& random, UINT count)
+	{
+		std::uniform_real_distribution<float> position(-0.5f * WorldSize, 0.5f * WorldSize);
+		std::uniform_real_distribution<float> extent(0.05f, 3.0f);
+		std::vector<BoundingBox> boxes(count);
+		for (auto& box : boxes)
+		{
+			box.Center = XMFLOAT3(position(random), position(random), position(random));
+			box.Extents = XMFLOAT3(extent(random), extent(random), extent(random));
+		}
+		return boxes;
+	}
+
+	// Alternates between the camera frustum and the orthographic volume of a shadow pass.
+	XMFLOAT4X4 RandomViewProj(std::mt19937& random, UINT i)
+	{
+		std::uniform_real_distribution<float> position(-0.5f * WorldSize, 0.5f * WorldSize);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		XMVECTOR eye = XMVectorSet(position(random), position(random), position(random), 1.0f);
+		XMVECTOR target = XMVectorSet(position(random), position(random), position(random), 1.0f);
+		XMMATRIX view = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj;
+		if (i % 2 == 0)
+			proj = XMMatrixPerspectiveFovLH(0.5f + 1.5f * unit(random), 0.5f + 1.5f * unit(random), 0.1f + unit(random), 20.0f + 150.0f * unit(random));
+		else
+		{
+			float w = 10.0f + 80.0f * unit(random), h = 10.0f + 80.0f * unit(random);
+			proj = XMMatrixOrthographicOffCenterLH(-w, w, -h, h, -50.0f * unit(random), 20.0f + 150.0f * unit(random));
+		}
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, proj));
+		return viewProj;
+	}
+
+	// The items whose box isn't fully behind one of the planes, in increasing order.
+	std::vector<UINT> BruteForce(const std::vector<BoundingBox>& boxes, const FrustumCuller& frustum)
+	{
+		std::vector<UINT> visible;
+		const XMFLOAT4* p = frustum.GetPlanes();
+		for (UINT i = 0; i < (UINT)boxes.size(); ++i)
+		{
+			XMVECTOR center = XMLoadFloat3(&boxes[i].Center);
+			XMVECTOR extents = XMLoadFloat3(&boxes[i].Extents);
+			bool inside = true;
+			for (UINT k = 0; k < 6 && inside; ++k)
+			{
+				XMVECTOR plane = XMLoadFloat4(&p[k]);
+				float distance = XMVectorGetX(XMPlaneDotCoord(plane, center));
+				float radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(plane), extents));
+				inside = distance >= -radius;
+			}
+			if (inside)
+				visible.push_back(i);
+		}
+		return visible;
+	}
+
+	// Boxes given as center and extents come back from the hierarchy's min and max
+	// with other rounding, so the boxes are snapped to values both represent exactly.
+	void Snap(std::vector<BoundingBox>& boxes)
+	{
+		for (auto& box : boxes)
+		{
+			float* c = &box.Center.x;
+			float* e = &box.Extents.x;
+			for (int k = 0; k < 3; ++k)
+			{
+				c[k] = (float)(int)(c[k] * 64.0f) / 64.0f;
+				e[k] = (float)((int)(e[k] * 64.0f) + 1) / 64.0f;
+			}
+		}
+	}
+
+	void CheckQueries(const BoundingVolumeHierarchy& bvh, const std::vector<BoundingBox>& boxes, std::mt19937& random)
+	{
+		// Up to 10 frustums, so that some queries take two walks.
+		size_t found = 0;
+		for (UINT count = 1; count <= 10; ++count)
+		{
+			std::vector<XMFLOAT4X4> viewProjs(count);
+			std::vector<FrustumCuller> frustums(count);
+			for (UINT f = 0; f < count; ++f)
+			{
+				viewProjs[f] = RandomViewProj(random, f + count);
+				frustums[f].SetViewProj(viewProjs[f]);
+			}
+
+			std::vector<std::vector<UINT>> visible(count);
+			bvh.Query(frustums.data(), count, visible.data());
+			std::vector<UINT> single;
+			for (UINT f = 0; f < count; ++f)
+			{
+				auto expected = BruteForce(boxes, frustums[f]);
+				DX_CHECK(visible[f] == expected);
+				found += expected.size();
+				bvh.Query(frustums[f], single);
+				DX_CHECK(single == expected);
+			}
+
+			FrustumQueryCache cache;
+			cache.Query(bvh, viewProjs.data(), count);
+			for (UINT f = 0; f < count; ++f)
+			{
+				auto cached = cache.Find(viewProjs[f]);
+				DX_CHECK(cached && *cached == visible[f]);
+			}
+			XMFLOAT4X4 other = RandomViewProj(random, 0);
+			DX_CHECK(cache.Find(other) == nullptr);
+			cache.Clear();
+			DX_CHECK(cache.Find(viewProjs[0]) == nullptr);
+		}
+		// Not all trivially empty.
+		DX_CHECK(found > 0);
+	}
+
+	void CheckEmpty()
+	{
+		BoundingVolumeHierarchy bvh;
+		FrustumCuller frustum;
+		std::mt19937 random(3);
+		frustum.SetViewProj(RandomViewProj(random, 0));
+		std::vector<UINT> visible(1, 7);
+		bvh.Query(frustum, visible);
+		DX_CHECK(visible.empty());
+	}
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	auto boxes = RandomBoxes(random, ItemCount);
+	Snap(boxes);
+
+	BoundingVolumeHierarchy bvh;
+	bvh.Build(boxes);
+	DX_CHECK(bvh.GetItemCount() == ItemCount);
+	CheckQueries(bvh, boxes, random);
+
+	// Move a third of the items, some far away, and refit.
+	std::uniform_int_distribution<UINT> item(0, ItemCount - 1);
+	auto moved = RandomBoxes(random, ItemCount / 3);
+	Snap(moved);
+	for (auto& box : moved)
+	{
+		UINT i = item(random);
+		boxes[i] = box;
+		bvh.Refit(i, box);
+	}
+	CheckQueries(bvh, boxes, random);
+
+	CheckEmpty();
+	printf("%u items, %u nodes\n", bvh.GetItemCount(), bvh.GetNodeCount());
+	return DX::Test::Result();
+}
@@ -0,0 +1,156 @@
+#include <string.h>
+#include <vector>
+#include "Common/ConstantRingBuffer.h"
+#include "Common/NullRenderDevice.h"
+#include "Common/RecordingRenderContext.h"
+#include "TestHelpers.h"
+
+// Checks ConstantRingBuffer on NullRenderDevice and the null backend of
+// RecordingRenderContext: allocations are aligned and copied, a batch is written
+// with one map after what was written before, discarding the buffer when it doesn't
+// fit, a batch larger than the buffer grows it, releasing the old one, windows are
+// counted in whole aligned constants, and nothing is left alive after Reset.
+
+using namespace DX;
+
+namespace
+{
+	// The batch as written to the buffer of the null backend, which maps every
+	// buffer to the same memory.
+	bool Written(RecordingRenderContext& context, ConstantRingBuffer& ring, UINT offset, const void* data, UINT size)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(context.Map(ring.GetBuffer(), 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped)))
+			return false;
+		bool same = memcmp(static_cast<BYTE*>(mapped.pData) + offset, data, size) == 0;
+		context.Unmap(ring.GetBuffer(), 0);
+		return same;
+	}
+
+	// The map of the last commit, checking that it was unmapped.
+	bool LastMap(const RecordingRenderContext& context, D3D11_MAP mapType, UINT byteWidth)
+	{
+		const std::vector<RenderCommand>& log = context.GetLog();
+		if (log.size() < 2)
+			return false;
+		const RenderCommand& map = log[log.size() - 2];
+		const RenderCommand& unmap = log.back();
+		return map.Type == RenderCommandType::Map && map.Arg == (UINT)mapType && map.Count == byteWidth &&
+			unmap.Type == RenderCommandType::Unmap && unmap.Object == map.Object;
+	}
+
+	void CheckAllocate()
+	{
+		RecordingRenderContext context;
+		NullRenderDevice device(&context);
+		ConstantRingBuffer ring;
+		ring.Initialize(&device, 1000);
+		DX_CHECK(ring.GetBuffer() != nullptr);
+		DX_CHECK(ring.GetByteWidth() == 1024);
+		DX_CHECK(device.GetLiveObjects() == 1);
+
+		// Before the first batch the head is at the end.
+		UINT base = 0;
+		DX_CHECK(ring.Commit(&context, base) && base == 1024);
+		DX_CHECK(context.GetCounters().Maps == 0);
+
+		BYTE a[64], b[300], c[16];
+		memset(a, 1, sizeof(a));
+		memset(b, 2, sizeof(b));
+		memset(c, 3, sizeof(c));
+		DX_CHECK(ring.Allocate(a, sizeof(a)) == 0);
+		DX_CHECK(ring.Allocate(b, sizeof(b)) == 256);
+		DX_CHECK(ring.Allocate(c, sizeof(c)) == 768);
+		DX_CHECK(ring.GetBatchSize() == 1024);
+
+		DX_CHECK(ring.Commit(&context, base) && base == 0);
+		DX_CHECK(ring.GetBatchSize() == 0);
+		DX_CHECK(context.GetCounters().Maps == 1);
+		DX_CHECK(LastMap(context, D3D11_MAP_WRITE_DISCARD, 1024));
+		DX_CHECK(Written(context, ring, base, a, sizeof(a)));
+		DX_CHECK(Written(context, ring, base + 256, b, sizeof(b)));
+		DX_CHECK(Written(context, ring, base + 768, c, sizeof(c)));
+
+		ring.Reset();
+		DX_CHECK(ring.GetBuffer() == nullptr);
+		DX_CHECK(device.GetLiveObjects() == 0);
+	}
+
+	void CheckWrap()
+	{
+		RecordingRenderContext context;
+		NullRenderDevice device(&context);
+		ConstantRingBuffer ring;
+		ring.Initialize(&device, 4096);
+
+		std::vector<BYTE> data(4096, 7);
+		UINT base = 0;
+		ring.Allocate(data.data(), 1024);
+		DX_CHECK(ring.Commit(&context, base) && base == 0);
+		DX_CHECK(LastMap(context, D3D11_MAP_WRITE_DISCARD, 4096));
+
+		// What fits goes after the last batch, leaving what the GPU may still read.
+		for (UINT k = 0; k < 3; ++k)
+			ring.Allocate(data.data(), 256);
+		DX_CHECK(ring.Commit(&context, base) && base == 1024);
+		DX_CHECK(LastMap(context, D3D11_MAP_WRITE_NO_OVERWRITE, 4096));
+		ring.Allocate(data.data(), 2048);
+		DX_CHECK(ring.Commit(&context, base) && base == 1792);
+		DX_CHECK(LastMap(context, D3D11_MAP_WRITE_NO_OVERWRITE, 4096));
+
+		// What doesn't starts over.
+		ring.Allocate(data.data(), 512);
+		DX_CHECK(ring.Commit(&context, base) && base == 0);
+		DX_CHECK(LastMap(context, D3D11_MAP_WRITE_DISCARD, 4096));
+		DX_CHECK(ring.Commit(&context, base) && base == 512);
+		DX_CHECK(context.GetCounters().Maps == 4);
+	}
+
+	void CheckGrowth()
+	{
+		RecordingRenderContext context;
+		NullRenderDevice device(&context);
+		ConstantRingBuffer ring;
+		ring.Initialize(&device, 1024);
+
+		std::vector<BYTE> data(5000);
+		for (size_t k = 0; k < data.size(); ++k)
+			data[k] = (BYTE)k;
+		ring.Allocate(data.data(), (UINT)data.size());
+		UINT base = 0;
+		DX_CHECK(ring.Commit(&context, base) && base == 0);
+		DX_CHECK(ring.GetByteWidth() == 8192);
+		DX_CHECK(LastMap(context, D3D11_MAP_WRITE_DISCARD, 8192));
+		DX_CHECK(Written(context, ring, base, data.data(), (UINT)data.size()));
+
+		// The smaller buffer is released.
+		DX_CHECK(device.GetLiveObjects() == 1);
+		DX_CHECK(device.GetCounters().LiveBufferBytes == 8192);
+		ring.Reset();
+		DX_CHECK(device.GetLiveObjects() == 0);
+		DX_CHECK(device.GetCounters().LiveBufferBytes == 0);
+	}
+
+	void CheckWindows()
+	{
+		UINT firstConstant, numConstants;
+		ConstantRingBuffer::GetWindow(0, 256, firstConstant, numConstants);
+		DX_CHECK(firstConstant == 0 && numConstants == 16);
+		ConstantRingBuffer::GetWindow(256, 64, firstConstant, numConstants);
+		DX_CHECK(firstConstant == 16 && numConstants == 16);
+		// Counts are whole multiples of 16 constants.
+		ConstantRingBuffer::GetWindow(512, 300, firstConstant, numConstants);
+		DX_CHECK(firstConstant == 32 && numConstants == 32);
+		ConstantRingBuffer::GetWindow(1024, 257, firstConstant, numConstants);
+		DX_CHECK(firstConstant == 64 && numConstants == 32);
+	}
+}
+
+int main()
+{
+	CheckAllocate();
+	CheckWrap();
+	CheckGrowth();
+	CheckWindows();
+	return DX::Test::Result();
+}
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Common/FrameStats.h"
+#include "AllocationCounter.h"
+#include "TestHelpers.h"
+
+// Checks FrameStats against sorting the frames of the window: percentiles rounded
+// up to the bucket, the maximum, averages and hitches, while the window fills,
+// once frames leave it and with frames past the last bucket. Adding frames
+// allocates nothing, and the CSV has the frames of the window, oldest first.
+
+using namespace DX;
+
+namespace
+{
+	struct Frame
+	{
+		double FrameMs;
+		double UpdateMs;
+		double RenderMs;
+	};
+
+	unsigned ToUs(double ms)
+	{
+		return ms > 0.0 ? (unsigned)(ms * 1000.0 + 0.5) : 0;
+	}
+
+	// The frames of the window sorted, the rank ceil(p * n) rounded up to the bucket.
+	double Percentile(const std::vector<Frame>& window, double p)
+	{
+		std::vector<unsigned> us;
+		for (auto& frame : window)
+			us.push_back(ToUs(frame.FrameMs));
+		std::sort(us.begin(), us.end());
+		size_t rank = (std::max)((size_t)ceil(p * us.size()), (size_t)1);
+		unsigned bucket = us[rank - 1] / FrameStats::BucketUs;
+		double maxMs = us.back() / 1000.0;
+		if (bucket >= FrameStats::BucketCount)
+			return maxMs;
+		return (std::min)((bucket + 1) * FrameStats::BucketUs / 1000.0, maxMs);
+	}
+
+	bool Near(double a, double b)
+	{
+		return fabs(a - b) < 1e-9;
+	}
+
+	void CheckWindow(const FrameStats& stats, const std::vector<Frame>& window, double hitchMs)
+	{
+		DX_CHECK(stats.GetFrameCount() == window.size());
+		if (window.empty())
+		{
+			DX_CHECK(stats.GetPercentileMs(0.5) == 0.0 && stats.GetMaxMs() == 0.0 && stats.GetAverageMs() == 0.0);
+			return;
+		}
+		unsigned long long frameUs = 0, updateUs = 0, renderUs = 0, maxUs = 0;
+		unsigned hitches = 0;
+		for (auto& frame : window)
+		{
+			frameUs += ToUs(frame.FrameMs);
+			updateUs += ToUs(frame.UpdateMs);
+			renderUs += ToUs(frame.RenderMs);
+			maxUs = (std::max)(maxUs, (unsigned long long)ToUs(frame.FrameMs));
+			if (ToUs(frame.FrameMs) > ToUs(hitchMs))
+				++hitches;
+		}
+		double n = (double)window.size();
+		DX_CHECK(Near(stats.GetAverageMs(), frameUs / 1000.0 / n));
+		DX_CHECK(Near(stats.GetAverageUpdateMs(), updateUs / 1000.0 / n));
+		DX_CHECK(Near(stats.GetAverageRenderMs(), renderUs / 1000.0 / n));
+		DX_CHECK(Near(stats.GetMaxMs(), maxUs / 1000.0));
+		DX_CHECK(stats.GetHitches() == hitches);
+		bool percentiles = true;
+		for (double p : { 0.0, 0.01, 0.5, 0.9, 0.95, 0.99, 1.0 })
+			percentiles = percentiles && Near(stats.GetPercentileMs(p), Percentile(window, p));
+		DX_CHECK(percentiles);
+	}
+
+	Frame RandomFrame(std::mt19937& random)
+	{
+		// Mostly around 60 Hz, some hitches and a few frames past the last bucket.
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		double u = uniform(random);
+		double frameMs = u < 0.9 ? 14.0 + 6.0 * uniform(random) : u < 0.98 ? 30.0 + 60.0 * uniform(random) : 100.0 + 400.0 * uniform(random);
+		double updateMs = frameMs * 0.3 * uniform(random);
+		return { frameMs, updateMs, frameMs * 0.5 * uniform(random) };
+	}
+
+	void CheckSlidingWindow(std::mt19937& random)
+	{
+		for (unsigned windowFrames : { 1u, 7u, 600u })
+		{
+			const double HitchMs = 33.3;
+			FrameStats stats(windowFrames, HitchMs);
+			DX_CHECK(stats.GetWindowFrames() == windowFrames);
+			std::vector<Frame> frames;
+			unsigned long long totalHitches = 0;
+			CheckWindow(stats, frames, HitchMs);
+			for (unsigned n = 0; n < 3 * windowFrames + 5; ++n)
+			{
+				Frame frame = RandomFrame(random);
+				frames.push_back(frame);
+				if (ToUs(frame.FrameMs) > ToUs(HitchMs))
+					++totalHitches;
+				stats.AddFrame(frame.FrameMs, frame.UpdateMs, frame.RenderMs);
+				size_t first = frames.size() > windowFrames ? frames.size() - windowFrames : 0;
+				CheckWindow(stats, std::vector<Frame>(frames.begin() + first, frames.end()), HitchMs);
+			}
+			DX_CHECK(stats.GetTotalFrames() == frames.size());
+			DX_CHECK(stats.GetTotalHitches() == totalHitches);
+
+			// A new threshold counts the hitches of the window again, not the totals.
+			std::vector<Frame> window(frames.end() - windowFrames, frames.end());
+			stats.SetHitchMs(16.7);
+			DX_CHECK(Near(stats.GetHitchMs(), 16.7));
+			CheckWindow(stats, window, 16.7);
+			DX_CHECK(stats.GetTotalHitches() == totalHitches);
+
+			stats.Reset();
+			DX_CHECK(stats.GetTotalFrames() == 0 && stats.GetTotalHitches() == 0);
+			CheckWindow(stats, std::vector<Frame>(), 16.7);
+		}
+	}
+
+	// Percentiles land on the bucket above, but never past the longest frame.
+	void CheckBuckets()
+	{
+		FrameStats stats(4);
+		stats.AddFrame(16.0, 0.0, 0.0);
+		stats.AddFrame(16.05, 0.0, 0.0);
+		stats.AddFrame(16.66, 0.0, 0.0);
+		stats.AddFrame(16.64, 0.0, 0.0);
+		DX_CHECK(Near(stats.GetPercentileMs(0.25), 16.1));
+		DX_CHECK(Near(stats.GetPercentileMs(0.5), 16.1));
+		DX_CHECK(Near(stats.GetPercentileMs(1.0), 16.66));
+		DX_CHECK(Near(stats.GetMaxMs(), 16.66));
+
+		// Negative and NaN times count as zero, huge ones are clamped.
+		stats.Reset();
+		stats.AddFrame(-1.0, NAN, -5.0);
+		DX_CHECK(stats.GetMaxMs() == 0.0 && stats.GetAverageUpdateMs() == 0.0 && stats.GetAverageRenderMs() == 0.0);
+		stats.AddFrame(1e12, 0.0, 0.0);
+		DX_CHECK(stats.GetMaxMs() > 3.9e6 && stats.GetPercentileMs(1.0) == stats.GetMaxMs());
+		DX_CHECK(stats.GetHitches() == 1);
+	}
+
+	void CheckAllocations(std::mt19937& random)
+	{
+		FrameStats stats(600);
+		std::vector<Frame> frames(5000);
+		for (auto& frame : frames)
+			frame = RandomFrame(random);
+		unsigned long long before = DX::Test::GetAllocations();
+		for (auto& frame : frames)
+		{
+			stats.AddFrame(frame.FrameMs, frame.UpdateMs, frame.RenderMs);
+			stats.GetPercentileMs(0.99);
+		}
+		stats.SetHitchMs(20.0);
+		DX_CHECK(DX::Test::GetAllocations() == before);
+	}
+
+	void CheckCsv()
+	{
+		FrameStats stats(3);
+		for (int n = 1; n <= 5; ++n)
+			stats.AddFrame(10.0 * n, 1.0 * n, 2.0 * n);
+		std::ostringstream out;
+		stats.WriteCsv(out);
+		DX_CHECK(out.str() == "frame,frame_ms,update_ms,render_ms\n2,30,3,6\n3,40,4,8\n4,50,5,10\n");
+
+		std::ostringstream summary;
+		FrameStats::WriteSummaryCsvHeader(summary);
+		stats.WriteSummaryCsv(summary, "run");
+		std::string text = summary.str();
+		size_t header = text.find('\n');
+		DX_CHECK(header != std::string::npos);
+		std::string line = text.substr(header + 1);
+		DX_CHECK(std::count(text.begin(), text.begin() + header, ',') == std::count(line.begin(), line.end(), ','));
+		DX_CHECK(line == "run,3,40,40.1,50,50,50,2,33.3,4,8\n");
+	}
+}
+
+int main()
+{
+	std::mt19937 random(19);
+	CheckSlidingWindow(random);
+	CheckBuckets();
+	CheckAllocations(random);
+	CheckCsv();
+	return DX::Test::Result();
+}
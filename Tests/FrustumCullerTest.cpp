@@ -0,0 +1,194 @@
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Common/FrustumCuller.h"
+#include "TestHelpers.h"
+
+// Checks FrustumCuller, which tests four spheres at once, against BoundingFrustum for
+// random perspective frustums: spheres BoundingFrustum::Contains or Intersects are
+// never culled, including those straddling a plane, the planes pass through the
+// corners of the frustum, and spheres are culled exactly when a scalar test against
+// the planes culls them, padded or not. The counts aren't multiples of four.
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+	const float WorldSize = 200.0f;
+	const UINT RandomCount = 1003;
+	const UINT StraddlingCount = 201;
+	// Closer to a plane than this, rounding decides.
+	const float Tolerance = 1e-2f;
+
+	struct TestFrustum
+	{
+		XMFLOAT4X4 ViewProj;
+		BoundingFrustum Bounds;		// In world space
+	};
+
+	TestFrustum RandomFrustum(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-0.5f * WorldSize, 0.5f * WorldSize);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		XMVECTOR eye = XMVectorSet(position(random), position(random), position(random), 1.0f);
+		XMVECTOR target = XMVectorSet(position(random), position(random), position(random), 1.0f);
+		XMMATRIX view = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.5f + 1.5f * unit(random), 0.5f + 1.5f * unit(random),
+			0.1f + unit(random), 20.0f + 150.0f * unit(random));
+
+		TestFrustum frustum;
+		XMStoreFloat4x4(&frustum.ViewProj, XMMatrixMultiply(view, proj));
+		BoundingFrustum::CreateFromMatrix(frustum.Bounds, proj);
+		frustum.Bounds.Transform(frustum.Bounds, XMMatrixInverse(nullptr, view));
+		return frustum;
+	}
+
+	// A random point inside the frustum, weighing its corners.
+	XMVECTOR RandomInside(std::mt19937& random, const BoundingFrustum& bounds)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		XMFLOAT3 corners[BoundingFrustum::CORNER_COUNT];
+		bounds.GetCorners(corners);
+		XMVECTOR point = XMVectorZero();
+		float total = 0.0f;
+		for (const XMFLOAT3& corner : corners)
+		{
+			float weight = 0.01f + unit(random);
+			point = XMVectorAdd(point, XMVectorScale(XMLoadFloat3(&corner), weight));
+			total += weight;
+		}
+		return XMVectorScale(point, 1.0f / total);
+	}
+
+	// A point on the boundary, bisecting between a point inside and one far outside.
+	XMVECTOR RandomOnBoundary(std::mt19937& random, const BoundingFrustum& bounds)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		XMVECTOR inside = RandomInside(random, bounds);
+		XMVECTOR direction = XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.0f));
+		XMVECTOR outside = XMVectorAdd(inside, XMVectorScale(direction, 10.0f * WorldSize));
+		for (int k = 0; k < 40; ++k)
+		{
+			XMVECTOR middle = XMVectorScale(XMVectorAdd(inside, outside), 0.5f);
+			if (bounds.Contains(middle) != DISJOINT)
+				inside = middle;
+			else
+				outside = middle;
+		}
+		return inside;
+	}
+
+	// A world putting sphere at center with a random scale and rotation.
+	XMFLOAT4X4 RandomWorld(std::mt19937& random, const BoundingSphere& sphere, FXMVECTOR center)
+	{
+		std::uniform_real_distribution<float> scale(0.05f, 3.0f);
+		std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+		XMMATRIX world = XMMatrixMultiply(XMMatrixScaling(scale(random), scale(random), scale(random)),
+			XMMatrixRotationY(angle(random)));
+		XMVECTOR offset = XMVector3Transform(XMLoadFloat3(&sphere.Center), world);
+		world.r[3] = XMVectorSetW(XMVectorSubtract(center, XMVectorSetW(offset, 0.0f)), 1.0f);
+		XMFLOAT4X4 result;
+		XMStoreFloat4x4(&result, world);
+		return result;
+	}
+
+	// The distance of the world sphere from the plane it is farthest behind.
+	float MinDistance(const FrustumCuller& culler, const BoundingSphere& sphere)
+	{
+		float distance = FLT_MAX;
+		for (UINT p = 0; p < 6; ++p)
+			distance = (std::min)(distance, XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&culler.GetPlanes()[p]), XMLoadFloat3(&sphere.Center))));
+		return distance;
+	}
+
+	void CheckPlanes(const FrustumCuller& culler, const BoundingFrustum& bounds)
+	{
+		// Every corner lies on three planes and behind none.
+		XMFLOAT3 corners[BoundingFrustum::CORNER_COUNT];
+		bounds.GetCorners(corners);
+		for (const XMFLOAT3& corner : corners)
+		{
+			UINT on = 0;
+			for (UINT p = 0; p < 6; ++p)
+			{
+				float distance = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&culler.GetPlanes()[p]), XMLoadFloat3(&corner)));
+				DX_CHECK(distance > -Tolerance);
+				if (fabsf(distance) < Tolerance)
+					++on;
+			}
+			DX_CHECK(on >= 3);
+		}
+	}
+
+	void CheckFrustum(std::mt19937& random, const TestFrustum& frustum)
+	{
+		FrustumCuller culler;
+		culler.SetViewProj(frustum.ViewProj);
+		CheckPlanes(culler, frustum.Bounds);
+
+		// Spheres around the frustum, then spheres whose center is on its boundary.
+		BoundingSphere sphere(XMFLOAT3(0.5f, -0.25f, 1.0f), 1.0f);
+		XMFLOAT3 corners[BoundingFrustum::CORNER_COUNT];
+		frustum.Bounds.GetCorners(corners);
+		BoundingBox around;
+		BoundingBox::CreateFromPoints(around, BoundingFrustum::CORNER_COUNT, corners, sizeof(XMFLOAT3));
+		std::uniform_real_distribution<float> unit(-1.2f, 1.2f);
+		std::vector<XMFLOAT4X4> worlds;
+		for (UINT i = 0; i < RandomCount; ++i)
+		{
+			XMVECTOR center = XMVectorMultiplyAdd(XMVectorSet(unit(random), unit(random), unit(random), 0.0f),
+				XMLoadFloat3(&around.Extents), XMLoadFloat3(&around.Center));
+			worlds.push_back(RandomWorld(random, sphere, center));
+		}
+		for (UINT i = 0; i < StraddlingCount; ++i)
+			worlds.push_back(RandomWorld(random, sphere, RandomOnBoundary(random, frustum.Bounds)));
+
+		const float Padding = 0.5f;
+		std::vector<UINT> visible, padded;
+		culler.Cull(sphere, worlds.data(), (UINT)worlds.size(), visible);
+		culler.Cull(sphere, worlds.data(), (UINT)worlds.size(), padded, Padding);
+		DX_CHECK(std::is_sorted(visible.begin(), visible.end()) && std::is_sorted(padded.begin(), padded.end()));
+		DX_CHECK(std::includes(padded.begin(), padded.end(), visible.begin(), visible.end()));
+
+		for (UINT i = 0; i < (UINT)worlds.size(); ++i)
+		{
+			BoundingSphere world;
+			sphere.Transform(world, XMLoadFloat4x4(&worlds[i]));
+			bool isVisible = std::binary_search(visible.begin(), visible.end(), i);
+			bool isPadded = std::binary_search(padded.begin(), padded.end(), i);
+
+			if (frustum.Bounds.Contains(world) == CONTAINS || frustum.Bounds.Intersects(world))
+				DX_CHECK(isVisible);
+			if (i >= RandomCount)
+				DX_CHECK(frustum.Bounds.Intersects(world) && isVisible);
+
+			float distance = MinDistance(culler, world);
+			if (fabsf(distance + world.Radius) > Tolerance)
+				DX_CHECK(isVisible == (distance > -world.Radius));
+			if (fabsf(distance + world.Radius + Padding) > Tolerance)
+				DX_CHECK(isPadded == (distance > -world.Radius - Padding));
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 random(7);
+	for (UINT f = 0; f < 50; ++f)
+		CheckFrustum(random, RandomFrustum(random));
+
+	// Nothing is culled before a frustum is set.
+	FrustumCuller culler;
+	BoundingSphere sphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 1.0f);
+	std::vector<XMFLOAT4X4> worlds(5);
+	for (UINT i = 0; i < worlds.size(); ++i)
+		XMStoreFloat4x4(&worlds[i], XMMatrixTranslation(1e6f * i, 0.0f, 0.0f));
+	std::vector<UINT> visible;
+	culler.Cull(sphere, worlds.data(), (UINT)worlds.size(), visible);
+	DX_CHECK(visible == std::vector<UINT>({ 0, 1, 2, 3, 4 }));
+	return DX::Test::Result();
+}
@@ -0,0 +1,172 @@
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Common/GridFilter.h"
+#include "Common/JobSystem.h"
+#include "TestHelpers.h"
+
+// Checks GridFilter against filtering every sample directly: a box of radius 1
+// against the 3x3 average Terrain smoothed its height maps with before, and box
+// and Gaussian filters of other radii and pass counts against the 2D kernel,
+// with the taps past the borders left out. The grids have sizes around the
+// vector width and the row bands, and some are smaller than the kernel.
+
+using namespace DX;
+
+namespace
+{
+	std::vector<float> RandomGrid(std::mt19937& random, UINT width, UINT height)
+	{
+		std::uniform_real_distribution<float> value(0.0f, 10.0f);
+		std::vector<float> grid(size_t(width) * height);
+		for (auto& h : grid)
+			h = value(random);
+		return grid;
+	}
+
+	// Terrain::Average: every sample averaged with its neighbors inside the grid.
+	std::vector<float> Average3x3(const std::vector<float>& grid, UINT width, UINT height)
+	{
+		std::vector<float> dest(grid.size());
+		for (int i = 0; i < (int)height; ++i)
+		{
+			for (int j = 0; j < (int)width; ++j)
+			{
+				float avg = 0.0f, num = 0.0f;
+				for (int m = i - 1; m <= i + 1; ++m)
+				{
+					for (int n = j - 1; n <= j + 1; ++n)
+					{
+						if (m >= 0 && m < (int)height && n >= 0 && n < (int)width)
+						{
+							avg += grid[m * width + n];
+							num += 1.0f;
+						}
+					}
+				}
+				dest[i * width + j] = avg / num;
+			}
+		}
+		return dest;
+	}
+
+	// The weights GridFilter documents: flat, or a Gaussian of sigma radius / 2.
+	std::vector<double> Weights(GridFilterType type, UINT radius)
+	{
+		std::vector<double> weights(2 * radius + 1, 1.0);
+		if (type == GridFilterType::Gaussian)
+		{
+			double sigma = 0.5 * radius;
+			for (UINT k = 0; k < weights.size(); ++k)
+			{
+				double x = (double)k - radius;
+				weights[k] = exp(-x * x / (2.0 * sigma * sigma));
+			}
+		}
+		return weights;
+	}
+
+	std::vector<float> Filter2D(const std::vector<float>& grid, UINT width, UINT height, GridFilterType type, UINT radius)
+	{
+		std::vector<double> weights = Weights(type, radius);
+		std::vector<float> dest(grid.size());
+		int r = (int)radius;
+		for (int i = 0; i < (int)height; ++i)
+		{
+			for (int j = 0; j < (int)width; ++j)
+			{
+				double sum = 0.0, weight = 0.0;
+				for (int m = (std::max)(i - r, 0); m <= (std::min)(i + r, (int)height - 1); ++m)
+				{
+					for (int n = (std::max)(j - r, 0); n <= (std::min)(j + r, (int)width - 1); ++n)
+					{
+						double w = weights[m - i + r] * weights[n - j + r];
+						sum += w * grid[m * width + n];
+						weight += w;
+					}
+				}
+				dest[i * width + j] = (float)(sum / weight);
+			}
+		}
+		return dest;
+	}
+
+	float MaxError(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		float error = 0.0f;
+		for (size_t k = 0; k < a.size(); ++k)
+			error = (std::max)(error, fabsf(a[k] - b[k]));
+		return error;
+	}
+
+	void CheckAverage(std::mt19937& random)
+	{
+		for (UINT width : { 1u, 2u, 3u, 5u, 8u, 67u, 130u })
+		{
+			for (UINT height : { 1u, 2u, 63u, 64u, 65u, 200u })
+			{
+				std::vector<float> grid = RandomGrid(random, width, height);
+				std::vector<float> expected = Average3x3(grid, width, height);
+				GridFilter filter(GridFilterType::Box, 1, 1);
+				filter.Apply(grid.data(), width, height);
+				DX_CHECK(MaxError(grid, expected) < 1e-5f);
+			}
+		}
+	}
+
+	void CheckKernels(std::mt19937& random)
+	{
+		for (GridFilterType type : { GridFilterType::Box, GridFilterType::Gaussian })
+		{
+			for (UINT radius : { 1u, 2u, 3u, 6u })
+			{
+				for (UINT passes : { 1u, 3u })
+				{
+					for (UINT size : { 4u, 37u, 150u })
+					{
+						UINT width = size + radius, height = size;
+						std::vector<float> grid = RandomGrid(random, width, height);
+						std::vector<float> expected = grid;
+						for (UINT pass = 0; pass < passes; ++pass)
+							expected = Filter2D(expected, width, height, type, radius);
+						GridFilter filter(type, radius, passes);
+						DX_CHECK(filter.GetRadius() == radius && filter.GetPasses() == passes);
+						filter.Apply(grid.data(), width, height);
+						DX_CHECK(MaxError(grid, expected) < 1e-4f);
+					}
+				}
+			}
+		}
+	}
+
+	// A flat grid stays flat, and a radius or pass count of 0 leaves the grid alone.
+	void CheckIdentities(std::mt19937& random)
+	{
+		std::vector<float> flat(97 * 71, 3.25f);
+		GridFilter(GridFilterType::Gaussian, 5, 2).Apply(flat.data(), 97, 71);
+		DX_CHECK(MaxError(flat, std::vector<float>(flat.size(), 3.25f)) < 1e-5f);
+
+		std::vector<float> grid = RandomGrid(random, 33, 17), copy = grid;
+		GridFilter(GridFilterType::Box, 0, 3).Apply(grid.data(), 33, 17);
+		GridFilter(GridFilterType::Box, 2, 0).Apply(grid.data(), 33, 17);
+		DX_CHECK(grid == copy);
+	}
+}
+
+int main()
+{
+	std::mt19937 random(29);
+	CheckIdentities(random);
+	// On the calling thread, then in bands over the pool.
+	CheckAverage(random);
+	CheckKernels(random);
+	{
+		JobSystem jobSystem(3);
+		CheckAverage(random);
+		CheckKernels(random);
+	}
+	return DX::Test::Result();
+}
@@ -0,0 +1,238 @@
+#include <DirectXMath.h>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Common/ConstantBuffer.h"
+#include "Common/MathHelper.h"
+#include "Common/RecordingRenderContext.h"
+#include "Common/RenderQueue.h"
+#include "Common/VertexTypes.h"
+#include "TestHelpers.h"
+
+// Submits a mesh of several subsets drawn at many worlds the two ways
+// MeshObject::Submit does, one draw per instance and subset, each with its own
+// world in the per-object constants, or one instanced draw per subset after a
+// batched inverse-transpose into the instance stream. The commands are recorded
+// by the null backend of RecordingRenderContext, checked, and the CPU time of
+// building and executing the queue is printed.
+// Usage: InstancedSubmissionBenchmark [-quick]
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+	const UINT SubsetCount = 4;
+	const UINT IndicesPerSubset = 3000;
+
+	// Objects are only compared, so any distinct pointers do.
+	template<typename T>
+	T* FakeObject(UINT_PTR id)
+	{
+		return reinterpret_cast<T*>(id * 16);
+	}
+
+	struct Mesh
+	{
+		Mesh(UINT instanceCount) : Worlds(instanceCount), Instances(instanceCount)
+		{
+			for (UINT i = 0; i < instanceCount; ++i)
+			{
+				XMMATRIX world = XMMatrixScaling(1.0f + 0.01f * (i % 7), 1.0f, 1.0f + 0.02f * (i % 5)) *
+					XMMatrixRotationY(0.1f * i) * XMMatrixTranslation(3.0f * (i % 32), 0.0f, 3.0f * (i / 32));
+				XMStoreFloat4x4(&Worlds[i], world);
+			}
+			for (UINT j = 0; j < SubsetCount; ++j)
+			{
+				Materials[j].Diffuse = XMFLOAT4(0.2f * j, 0.5f, 0.5f, 1.0f);
+				Materials[j].Ambient = Materials[j].Specular = Materials[j].Reflect = Materials[j].Diffuse;
+			}
+		}
+
+		std::vector<XMFLOAT4X4> Worlds;
+		std::vector<InstanceWorld> Instances;
+		Material Materials[SubsetCount];
+	};
+
+	ID3D11Buffer* const PerObjectCB = FakeObject<ID3D11Buffer>(1);
+	ID3D11Buffer* const InstanceVB = FakeObject<ID3D11Buffer>(2);
+	ID3D11Buffer* const ObjectVB = FakeObject<ID3D11Buffer>(3);
+	ID3D11Buffer* const ObjectIB = FakeObject<ID3D11Buffer>(4);
+
+	DrawState MakeState(bool instanced, UINT subset)
+	{
+		DrawState state;
+		ID3D11Buffer* vbs[2] = { ObjectVB, InstanceVB };
+		UINT strides[2] = { sizeof(PosNormalTexTan), sizeof(InstanceWorld) };
+		state.InputLayout = FakeObject<ID3D11InputLayout>(instanced ? 10 : 11);
+		state.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		state.SetVertexBuffers(instanced ? 2 : 1, vbs, strides);
+		state.IndexBuffer = ObjectIB;
+		state.IndexFormat = DXGI_FORMAT_R32_UINT;
+		state.SetConstantBuffers(ShaderStage::Vertex, 1, 1, &PerObjectCB);
+		state.SetConstantBuffers(ShaderStage::Pixel, 1, 1, &PerObjectCB);
+		state.SetShader(ShaderStage::Vertex, FakeObject<ID3D11VertexShader>(instanced ? 20 : 21));
+		state.SetShader(ShaderStage::Pixel, FakeObject<ID3D11PixelShader>(30 + subset));
+		return state;
+	}
+
+	// One draw per instance and subset, each uploading the world and material.
+	void SubmitPerInstance(Mesh& mesh, RenderQueue& queue)
+	{
+		UINT states[SubsetCount];
+		for (UINT j = 0; j < SubsetCount; ++j)
+			states[j] = queue.AddState(MakeState(false, j));
+
+		BasicPerObjectCB constants;
+		XMStoreFloat4x4(&constants.TexTransform, XMMatrixIdentity());
+		for (UINT i = 0; i < mesh.Worlds.size(); ++i)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&mesh.Worlds[i]);
+			XMStoreFloat4x4(&constants.World, XMMatrixTranspose(world));
+			XMStoreFloat4x4(&constants.WorldInvTranspose, XMMatrixTranspose(MathHelper::InverseTranspose(world)));
+			for (UINT j = 0; j < SubsetCount; ++j)
+			{
+				constants.Mat = mesh.Materials[j];
+				queue.SetConstants(PerObjectCB, &constants, sizeof(constants));
+				queue.DrawIndexed(states[j], IndicesPerSubset, j * IndicesPerSubset, 0, (float)i);
+			}
+		}
+	}
+
+	// The worlds go to the instance stream with one map, and every subset is
+	// drawn once for all of them.
+	void SubmitInstanced(Mesh& mesh, RenderContext* context, RenderQueue& queue)
+	{
+		UINT count = (UINT)mesh.Worlds.size();
+		for (UINT i = 0; i < count; ++i)
+			mesh.Instances[i].World = mesh.Worlds[i];
+		MathHelper::InverseTransposeBatch(mesh.Worlds.data(), count, &mesh.Instances[0].WorldInvTranspose, sizeof(InstanceWorld));
+
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (SUCCEEDED(context->Map(InstanceVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		{
+			memcpy(mapped.pData, mesh.Instances.data(), count * sizeof(InstanceWorld));
+			context->Unmap(InstanceVB, 0);
+		}
+
+		BasicPerObjectCB constants = {};
+		XMStoreFloat4x4(&constants.TexTransform, XMMatrixIdentity());
+		for (UINT j = 0; j < SubsetCount; ++j)
+		{
+			constants.Mat = mesh.Materials[j];
+			queue.SetConstants(PerObjectCB, &constants, sizeof(constants));
+			queue.DrawIndexedInstanced(queue.AddState(MakeState(true, j)), IndicesPerSubset, count, j * IndicesPerSubset, 0);
+		}
+	}
+
+	void Submit(bool instanced, Mesh& mesh, RecordingRenderContext& context, RenderQueue& queue)
+	{
+		context.BeginFrame();
+		queue.Begin(RenderPass::Color);
+		if (instanced)
+			SubmitInstanced(mesh, &context, queue);
+		else
+			SubmitPerInstance(mesh, queue);
+		queue.Execute(&context);
+	}
+
+	bool NearlyEqual(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				if (fabsf(a.m[r][c] - b.m[r][c]) > 1e-5f * (1.0f + fabsf(b.m[r][c])))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void CheckInverseTransposes(const Mesh& mesh)
+	{
+		for (UINT i = 0; i < mesh.Worlds.size(); ++i)
+		{
+			XMFLOAT4X4 expected;
+			XMStoreFloat4x4(&expected, MathHelper::InverseTranspose(XMLoadFloat4x4(&mesh.Worlds[i])));
+			if (!DX_CHECK(NearlyEqual(mesh.Instances[i].WorldInvTranspose, expected)))
+				return;
+		}
+	}
+
+	void CheckCommands(UINT instanceCount)
+	{
+		Mesh mesh(instanceCount);
+		RecordingRenderContext context;
+		context.RegisterBuffer(InstanceVB, instanceCount * sizeof(InstanceWorld), D3D11_BIND_VERTEX_BUFFER);
+		context.RegisterBuffer(PerObjectCB, sizeof(BasicPerObjectCB), D3D11_BIND_CONSTANT_BUFFER);
+		RenderQueue queue;
+
+		Submit(false, mesh, context, queue);
+		RenderCounters perInstance = context.GetCounters();
+		DX_CHECK(perInstance.Draws == instanceCount * SubsetCount);
+		DX_CHECK(perInstance.Calls[(UINT)RenderCommandType::DrawIndexed] == instanceCount * SubsetCount);
+		DX_CHECK(perInstance.ConstantBufferUploads == instanceCount * SubsetCount);
+
+		Submit(true, mesh, context, queue);
+		RenderCounters instanced = context.GetCounters();
+		DX_CHECK(instanced.Draws == SubsetCount);
+		DX_CHECK(instanced.Calls[(UINT)RenderCommandType::DrawIndexedInstanced] == SubsetCount);
+		DX_CHECK(instanced.Calls[(UINT)RenderCommandType::DrawIndexed] == 0);
+		DX_CHECK(instanced.ConstantBufferUploads == SubsetCount);
+		// The constants of the subsets and the instance stream.
+		DX_CHECK(instanced.Maps == SubsetCount + 1);
+		// Both draw every triangle of every instance.
+		DX_CHECK(instanced.Vertices == perInstance.Vertices);
+		for (auto& command : context.GetLog())
+		{
+			if (command.Type == RenderCommandType::DrawIndexedInstanced)
+				DX_CHECK(command.Arg == instanceCount);
+		}
+		CheckInverseTransposes(mesh);
+	}
+
+	// µs per frame, best of the runs.
+	double Time(bool instanced, UINT instanceCount, UINT runs)
+	{
+		Mesh mesh(instanceCount);
+		RecordingRenderContext context;
+		context.SetLogging(false);
+		context.RegisterBuffer(InstanceVB, instanceCount * sizeof(InstanceWorld), D3D11_BIND_VERTEX_BUFFER);
+		context.RegisterBuffer(PerObjectCB, sizeof(BasicPerObjectCB), D3D11_BIND_CONSTANT_BUFFER);
+		RenderQueue queue;
+		Submit(instanced, mesh, context, queue);
+
+		double best = 1e30;
+		for (UINT run = 0; run < runs; ++run)
+		{
+			DX::Test::Stopwatch watch;
+			Submit(instanced, mesh, context, queue);
+			best = (std::min)(best, watch.GetMs() * 1000.0);
+		}
+		return best;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = DX::Test::HasArgument(argc, argv, "-quick");
+	UINT runs = quick ? 5 : 50;
+
+	CheckCommands(1);
+	CheckCommands(7);
+	CheckCommands(1000);
+
+	printf("%u subsets\n", SubsetCount);
+	printf("%10s %16s %16s %10s\n", "Instances", "Per instance us", "Instanced us", "Speedup");
+	const UINT counts[] = { 10, 100, 1000, 4000 };
+	for (UINT count : counts)
+	{
+		if (quick && count > 1000)
+			continue;
+		double perInstance = Time(false, count, runs);
+		double instanced = Time(true, count, runs);
+		printf("%10u %16.1f %16.1f %9.1fx\n", count, perInstance, instanced, perInstance / instanced);
+	}
+	return DX::Test::Result();
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "Common/JobSystem.h"
+#include "TestHelpers.h"
+
+// Times JobSystem with 0 workers up to twice the hardware threads: ParallelFor
+// over compute bound rows, the speedup over running them on the calling thread,
+// and the cost per job of many empty jobs queued and waited on.
+// -quick runs less work.
+// Usage: JobSystemBenchmark [-quick]
+
+using namespace DX;
+
+namespace
+{
+	// Some math per row, so that the rows don't share cache lines.
+	float Row(unsigned i, unsigned work)
+	{
+		float x = (float)i;
+		for (unsigned k = 0; k < work; ++k)
+			x = sqrtf(x * x + 1.0f) * 0.999f;
+		return x;
+	}
+
+	double TimeRows(JobSystem& jobSystem, unsigned rows, unsigned work, std::vector<float>& results)
+	{
+		DX::Test::Stopwatch stopwatch;
+		jobSystem.ParallelFor(0, rows, [&](unsigned i) { results[i] = Row(i, work); }, 4);
+		return stopwatch.GetMs();
+	}
+
+	double TimeEmptyJobs(JobSystem& jobSystem, unsigned jobs)
+	{
+		std::atomic<unsigned> count(0);
+		DX::Test::Stopwatch stopwatch;
+		JobCounter counter;
+		for (unsigned k = 0; k < jobs; ++k)
+			jobSystem.Run([&]() { ++count; }, &counter);
+		jobSystem.Wait(counter);
+		double ms = stopwatch.GetMs();
+		DX_CHECK(count == jobs);
+		return ms;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = DX::Test::HasArgument(argc, argv, "-quick");
+	unsigned rows = quick ? 2000 : 20000, work = 2000, jobs = quick ? 20000 : 500000;
+	unsigned hardwareThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+	std::vector<float> expected(rows), results(rows);
+	for (unsigned i = 0; i < rows; ++i)
+		expected[i] = Row(i, work);
+
+	double serialMs = 0.0;
+	for (unsigned threadCount = 0; threadCount <= 2 * hardwareThreads; threadCount = threadCount ? 2 * threadCount : 1)
+	{
+		JobSystem jobSystem(threadCount);
+		// Once to wake the workers up.
+		TimeRows(jobSystem, rows, work, results);
+		double rowsMs = TimeRows(jobSystem, rows, work, results);
+		DX_CHECK(results == expected);
+		if (threadCount == 0)
+			serialMs = rowsMs;
+		double jobsMs = TimeEmptyJobs(jobSystem, jobs);
+		printf("%2u worker threads: rows %.1f ms, %.2fx the calling thread alone, empty jobs %.0f ns each\n",
+			threadCount, rowsMs, serialMs / rowsMs, 1e6 * jobsMs / jobs);
+	}
+	printf("%u hardware threads\n", hardwareThreads);
+	return DX::Test::Result();
+}
@@ -0,0 +1,171 @@
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Common/JobSystem.h"
+#include "TestHelpers.h"
+
+// Stresses JobSystem: ParallelFor visits every index once for any range and grain,
+// jobs wait on the jobs they spawn down a deep tree, jobs held back by a counter
+// see the work of the jobs counted on it, threads outside the pool queue and wait
+// at the same time, and the jobs nobody waited on run before the destructor
+// returns. Repeated many times, so that a race shows up.
+
+using namespace DX;
+
+namespace
+{
+	void CheckParallelFor(JobSystem& jobSystem)
+	{
+		std::vector<std::atomic<unsigned>> visits(10000);
+		for (unsigned grain : { 0u, 1u, 3u, 64u, 20000u })
+		{
+			for (unsigned end : { 0u, 1u, 2u, 7u, 1000u, 10000u })
+			{
+				for (auto& v : visits)
+					v = 0;
+				unsigned begin = end > 5 ? 5 : 0;
+				jobSystem.ParallelFor(begin, end, [&](unsigned i) { ++visits[i]; }, grain);
+				bool once = true;
+				for (unsigned i = 0; i < visits.size(); ++i)
+					once = once && visits[i] == (i >= begin && i < end ? 1u : 0u);
+				DX_CHECK(once);
+			}
+		}
+
+		// Many small loops in a row, where the workers go to sleep and wake up.
+		std::atomic<unsigned> sum(0);
+		for (int n = 0; n < 2000; ++n)
+			jobSystem.ParallelFor(0, 16, [&](unsigned i) { sum += i; });
+		DX_CHECK(sum == 2000u * 120u);
+	}
+
+	// Every job spawns two children and waits on them, down to depth 0.
+	void Spawn(JobSystem& jobSystem, unsigned depth, std::atomic<unsigned>& leaves)
+	{
+		if (depth == 0)
+		{
+			++leaves;
+			return;
+		}
+		JobCounter counter;
+		jobSystem.Run([&]() { Spawn(jobSystem, depth - 1, leaves); }, &counter);
+		jobSystem.Run([&]() { Spawn(jobSystem, depth - 1, leaves); }, &counter);
+		jobSystem.Wait(counter);
+	}
+
+	void CheckNestedWaits(JobSystem& jobSystem)
+	{
+		for (int n = 0; n < 20; ++n)
+		{
+			std::atomic<unsigned> leaves(0);
+			Spawn(jobSystem, 10, leaves);
+			DX_CHECK(leaves == 1024u);
+		}
+
+		// ParallelFor inside ParallelFor.
+		std::atomic<unsigned> count(0);
+		jobSystem.ParallelFor(0, 32, [&](unsigned)
+		{
+			jobSystem.ParallelFor(0, 100, [&](unsigned) { ++count; });
+		});
+		DX_CHECK(count == 3200u);
+	}
+
+	// A chain of stages, every one held back until the previous one is done.
+	void CheckDependencies(JobSystem& jobSystem)
+	{
+		const unsigned Stages = 8, Width = 16;
+		for (int n = 0; n < 50; ++n)
+		{
+			std::vector<std::atomic<unsigned>> done(Stages);
+			std::vector<JobCounter> counters(Stages);
+			std::atomic<unsigned> early(0);
+			for (unsigned stage = 0; stage < Stages; ++stage)
+			{
+				done[stage] = 0;
+				for (unsigned k = 0; k < Width; ++k)
+				{
+					jobSystem.Run([&, stage]()
+					{
+						if (stage > 0 && done[stage - 1] != Width)
+							++early;
+						++done[stage];
+					}, &counters[stage], stage > 0 ? &counters[stage - 1] : nullptr);
+				}
+			}
+			jobSystem.Wait(counters[Stages - 1]);
+			DX_CHECK(early == 0);
+			DX_CHECK(done[Stages - 1] == Width);
+			// Earlier stages are done too, the last one only started after them.
+			for (unsigned stage = 0; stage < Stages; ++stage)
+				jobSystem.Wait(counters[stage]);
+		}
+	}
+
+	// Threads outside the pool share one deque.
+	void CheckOutsideThreads(JobSystem& jobSystem)
+	{
+		std::atomic<unsigned> count(0);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&]()
+			{
+				for (int n = 0; n < 200; ++n)
+				{
+					JobCounter counter;
+					for (int k = 0; k < 8; ++k)
+						jobSystem.Run([&]() { ++count; }, &counter);
+					jobSystem.Wait(counter);
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		DX_CHECK(count == 4u * 200u * 8u);
+	}
+
+	void CheckDestructor(unsigned threadCount)
+	{
+		std::atomic<unsigned> count(0);
+		{
+			JobSystem jobSystem(threadCount);
+			for (int k = 0; k < 1000; ++k)
+				jobSystem.Run([&]() { ++count; });
+		}
+		DX_CHECK(count == 1000u);
+		DX_CHECK(JobSystem::Instance() == nullptr);
+	}
+}
+
+int main()
+{
+	for (unsigned threadCount : { 0u, 1u, 3u, 8u })
+	{
+		JobSystem jobSystem(threadCount);
+		DX_CHECK(JobSystem::Instance() == &jobSystem);
+		DX_CHECK(jobSystem.GetThreadCount() == threadCount);
+		bool threw = false;
+		try
+		{
+			JobSystem second(1);
+		}
+		catch (std::logic_error&)
+		{
+			threw = true;
+		}
+		DX_CHECK(threw);
+		DX_CHECK(JobSystem::Instance() == &jobSystem);
+
+		CheckParallelFor(jobSystem);
+		CheckNestedWaits(jobSystem);
+		CheckDependencies(jobSystem);
+		CheckOutsideThreads(jobSystem);
+	}
+	CheckDestructor(0);
+	CheckDestructor(4);
+	printf("default thread count %u\n", JobSystem::DefaultThreadCount());
+	return DX::Test::Result();
+}
@@ -0,0 +1,113 @@
+#include <vector>
+#include "MeshOptimizer.h"
+#include "TestHelpers.h"
+
+// Checks the per subset decision of Use16BitIndices on meshes with more than
+// 65536 vertices, and that subsets and indices are left as they were when the
+// mesh needs 32 bit indices.
+
+namespace
+{
+	struct Subset
+	{
+		int MtlIndex;
+		int VertexBase;
+		int IndexStart;
+		int IndexCount;
+	};
+
+	// A strip of triangles over the vertices [first, last] of the range.
+	void AddSubset(std::vector<Subset>& subsets, std::vector<int>& indices, int vertexBase, int first, int last)
+	{
+		subsets.push_back({ (int)subsets.size(), vertexBase, (int)indices.size(), 0 });
+		for (int i = first; i + 2 <= last; i += 2)
+		{
+			indices.push_back(i);
+			indices.push_back(i + 1);
+			indices.push_back(i + 2);
+		}
+		indices.push_back(last - 1);
+		indices.push_back(last);
+		indices.push_back(first);
+		subsets.back().IndexCount = (int)indices.size() - subsets.back().IndexStart;
+	}
+
+	// The vertices every subset uses, after Use16BitIndices.
+	std::vector<int> AbsoluteIndices(const std::vector<Subset>& subsets, const std::vector<int>& indices)
+	{
+		std::vector<int> result;
+		for (auto& subset : subsets)
+		{
+			for (int i = 0; i < subset.IndexCount; ++i)
+				result.push_back(subset.VertexBase + indices[subset.IndexStart + i]);
+		}
+		return result;
+	}
+
+	void CheckSmallRange()
+	{
+		std::vector<Subset> subsets;
+		std::vector<int> indices;
+		AddSubset(subsets, indices, 0, 0, 40000);
+		AddSubset(subsets, indices, 40001, 0, 20000);
+		auto before = indices;
+		DX_CHECK(Use16BitIndices(subsets, indices));
+		DX_CHECK(indices == before);
+		DX_CHECK(subsets[0].VertexBase == 0 && subsets[1].VertexBase == 40001);
+	}
+
+	void CheckSharedLargeRange()
+	{
+		// Two subsets share a range of 100001 vertices, but each of them uses
+		// less than 65536 of them.
+		std::vector<Subset> subsets;
+		std::vector<int> indices;
+		AddSubset(subsets, indices, 10, 0, 60000);
+		AddSubset(subsets, indices, 10, 50000, 100000);
+		auto before = AbsoluteIndices(subsets, indices);
+		DX_CHECK(Use16BitIndices(subsets, indices));
+		DX_CHECK(AbsoluteIndices(subsets, indices) == before);
+		DX_CHECK(subsets[0].VertexBase == 10);
+		DX_CHECK(subsets[1].VertexBase == 50010);
+		for (int index : indices)
+			DX_CHECK(index >= 0 && index < 65536);
+	}
+
+	void CheckLargeSubset()
+	{
+		// The third subset uses 70001 vertices, so the mesh needs 32 bit indices,
+		// and the second, which would fit if moved, stays where it was.
+		std::vector<Subset> subsets;
+		std::vector<int> indices;
+		AddSubset(subsets, indices, 0, 0, 1000);
+		AddSubset(subsets, indices, 0, 66000, 67000);
+		AddSubset(subsets, indices, 0, 5000, 75000);
+		auto before = indices;
+		DX_CHECK(!Use16BitIndices(subsets, indices));
+		DX_CHECK(indices == before);
+		for (auto& subset : subsets)
+			DX_CHECK(subset.VertexBase == 0);
+	}
+
+	void CheckBoundary()
+	{
+		std::vector<Subset> subsets;
+		std::vector<int> indices;
+		AddSubset(subsets, indices, 0, 0, 65535);
+		DX_CHECK(Use16BitIndices(subsets, indices));
+
+		subsets.clear();
+		indices.clear();
+		AddSubset(subsets, indices, 0, 0, 65536);
+		DX_CHECK(!Use16BitIndices(subsets, indices));
+	}
+}
+
+int main()
+{
+	CheckSmallRange();
+	CheckSharedLargeRange();
+	CheckLargeSubset();
+	CheckBoundary();
+	return DX::Test::Result();
+}
@@ -0,0 +1,164 @@
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Common/FrustumCuller.h"
+#include "Common/OcclusionCuller.h"
+#include "TestHelpers.h"
+
+// Walks a camera down the streets of a city of boxes and times the occlusion
+// culler per frame: rasterizing the buildings and building the pyramid, then
+// testing the objects inside the frustum. Prints the share of them culled.
+// Usage: OcclusionCullerBenchmark [-quick]
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+	const UINT BlockCount = 16;
+	const float BlockSize = 20.0f;
+	const float BuildingSize = 14.0f;
+	const UINT ObjectCount = 20000;
+
+	struct City
+	{
+		std::vector<XMFLOAT4X4> Buildings;		// Scale and translation of a unit cube
+		std::vector<BoundingBox> Objects;
+	};
+
+	// A unit cube centered at the origin, as a closed occluder.
+	const XMFLOAT3 CubePositions[8] =
+	{
+		XMFLOAT3(-0.5f, -0.5f, -0.5f), XMFLOAT3(-0.5f, 0.5f, -0.5f), XMFLOAT3(0.5f, 0.5f, -0.5f), XMFLOAT3(0.5f, -0.5f, -0.5f),
+		XMFLOAT3(-0.5f, -0.5f, 0.5f), XMFLOAT3(-0.5f, 0.5f, 0.5f), XMFLOAT3(0.5f, 0.5f, 0.5f), XMFLOAT3(0.5f, -0.5f, 0.5f),
+	};
+	const USHORT CubeIndices[36] =
+	{
+		0, 1, 2, 0, 2, 3,  4, 6, 5, 4, 7, 6,  4, 5, 1, 4, 1, 0,
+		3, 2, 6, 3, 6, 7,  1, 5, 6, 1, 6, 2,  4, 0, 3, 4, 3, 7,
+	};
+
+	// Buildings of random heights on a grid of blocks, and small objects
+	// scattered over the streets and the roofs.
+	City BuildCity()
+	{
+		City city;
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> height(8.0f, 60.0f);
+		std::vector<float> heights;
+		for (UINT z = 0; z < BlockCount; ++z)
+		{
+			for (UINT x = 0; x < BlockCount; ++x)
+			{
+				float h = height(random);
+				heights.push_back(h);
+				XMFLOAT4X4 world;
+				XMStoreFloat4x4(&world, XMMatrixMultiply(XMMatrixScaling(BuildingSize, h, BuildingSize),
+					XMMatrixTranslation((x + 0.5f) * BlockSize, 0.5f * h, (z + 0.5f) * BlockSize)));
+				city.Buildings.push_back(world);
+			}
+		}
+
+		std::uniform_real_distribution<float> position(0.0f, BlockCount * BlockSize);
+		std::uniform_real_distribution<float> extent(0.3f, 1.5f);
+		std::uniform_int_distribution<int> onRoof(0, 9);
+		for (UINT i = 0; i < ObjectCount; ++i)
+		{
+			XMFLOAT3 center(position(random), 0.0f, position(random));
+			XMFLOAT3 extents(extent(random), extent(random), extent(random));
+			UINT bx = (UINT)(center.x / BlockSize), bz = (UINT)(center.z / BlockSize);
+			float lx = center.x - (bx + 0.5f) * BlockSize, lz = center.z - (bz + 0.5f) * BlockSize;
+			bool inBuilding = fabsf(lx) < 0.5f * BuildingSize && fabsf(lz) < 0.5f * BuildingSize;
+			if (inBuilding && onRoof(random) != 0)
+				continue;
+			center.y = (inBuilding ? heights[bz * BlockCount + bx] : 0.0f) + extents.y;
+			city.Objects.push_back(BoundingBox(center, extents));
+		}
+		return city;
+	}
+
+	// Looking down a street at eye height, turning slowly.
+	XMFLOAT4X4 GetViewProj(UINT frame, UINT frameCount, float aspect)
+	{
+		float t = (float)frame / frameCount;
+		float extent = BlockCount * BlockSize;
+		XMVECTOR eye = XMVectorSet(0.1f * extent + 0.8f * extent * t, 1.7f, 3.0f * BlockSize, 1.0f);
+		float angle = 0.6f * sinf(6.0f * t);
+		XMVECTOR direction = XMVectorSet(sinf(angle), -0.02f, cosf(angle), 0.0f);
+		XMMATRIX view = XMMatrixLookToLH(eye, direction, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * XM_PI, aspect, 1.0f, 1000.0f);
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, proj));
+		return viewProj;
+	}
+
+	bool InFrustum(const FrustumCuller& frustum, const BoundingBox& box)
+	{
+		const XMFLOAT4* p = frustum.GetPlanes();
+		for (UINT k = 0; k < 6; ++k)
+		{
+			XMVECTOR plane = XMLoadFloat4(&p[k]);
+			float distance = XMVectorGetX(XMPlaneDotCoord(plane, XMLoadFloat3(&box.Center)));
+			float radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(plane), XMLoadFloat3(&box.Extents)));
+			if (distance < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	void Benchmark(const City& city, UINT width, UINT height, UINT frameCount)
+	{
+		OcclusionCuller culler(width, height);
+		FrustumCuller frustum;
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+		double rasterizeMs = 0.0, testMs = 0.0;
+		size_t inFrustum = 0, culled = 0;
+		std::vector<UINT> candidates;
+		for (UINT frame = 0; frame < frameCount; ++frame)
+		{
+			XMFLOAT4X4 viewProj = GetViewProj(frame, frameCount, (float)width / height);
+			frustum.SetViewProj(viewProj);
+			candidates.clear();
+			for (UINT i = 0; i < (UINT)city.Objects.size(); ++i)
+				if (InFrustum(frustum, city.Objects[i]))
+					candidates.push_back(i);
+
+			DX::Test::Stopwatch stopwatch;
+			culler.Clear(viewProj);
+			for (auto& world : city.Buildings)
+				culler.RasterizeOccluder(CubePositions, sizeof(XMFLOAT3), CubeIndices, 36, world);
+			culler.Finalize();
+			rasterizeMs += stopwatch.GetMs();
+
+			stopwatch.Restart();
+			for (UINT i : candidates)
+				culled += !culler.IsVisible(city.Objects[i], identity);
+			testMs += stopwatch.GetMs();
+			inFrustum += candidates.size();
+		}
+
+		double culledPercent = inFrustum ? 100.0 * culled / inFrustum : 0.0;
+		printf("%ux%u: %.1f objects in the frustum, %.1f%% culled, rasterize %.1f us/frame, test %.1f us/frame (%.3f us/object)\n",
+			width, height, (double)inFrustum / frameCount, culledPercent,
+			1000.0 * rasterizeMs / frameCount, 1000.0 * testMs / frameCount, inFrustum ? 1000.0 * testMs / inFrustum : 0.0);
+		// Down a street most of the city is behind the first buildings.
+		DX_CHECK(culledPercent > 50.0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = DX::Test::HasArgument(argc, argv, "-quick");
+	City city = BuildCity();
+	printf("%zu buildings, %zu objects\n", city.Buildings.size(), city.Objects.size());
+
+	UINT frameCount = quick ? 20 : 500;
+	Benchmark(city, 256, 128, frameCount);
+	Benchmark(city, 512, 256, frameCount);
+	return DX::Test::Result();
+}
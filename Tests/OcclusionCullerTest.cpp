@@ -0,0 +1,187 @@
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Common/OcclusionCuller.h"
+#include "TestHelpers.h"
+
+// Checks OcclusionCuller with a wall in front of the camera: boxes behind it are
+// hidden, boxes in front of it, beside it or crossing the near plane are not, and
+// random boxes peeking out by more than a pixel are never culled.
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+	const UINT Width = 256;
+	const UINT Height = 128;
+	const float WallZ = 10.0f;
+	const float WallHalfWidth = 5.0f;
+	const float WallHalfHeight = 3.0f;
+
+	// The camera is at the origin and looks down +z.
+	XMFLOAT4X4 GetViewProj()
+	{
+		XMMATRIX view = XMMatrixLookAtLH(XMVectorZero(), XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PI / 3.0f, (float)Width / Height, 0.1f, 100.0f);
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, proj));
+		return viewProj;
+	}
+
+	XMFLOAT4X4 Translation(float x, float y, float z)
+	{
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixTranslation(x, y, z));
+		return world;
+	}
+
+	// Two triangles facing the camera.
+	const XMFLOAT3 WallPositions[4] =
+	{
+		XMFLOAT3(-WallHalfWidth, -WallHalfHeight, 0.0f), XMFLOAT3(-WallHalfWidth, WallHalfHeight, 0.0f),
+		XMFLOAT3(WallHalfWidth, WallHalfHeight, 0.0f), XMFLOAT3(WallHalfWidth, -WallHalfHeight, 0.0f),
+	};
+	const UINT WallIndices[6] = { 0, 1, 2, 0, 2, 3 };
+	const USHORT WallIndices16[6] = { 0, 1, 2, 0, 2, 3 };
+
+	void DrawWall(OcclusionCuller& culler, int indexSize)
+	{
+		culler.Clear(GetViewProj());
+		XMFLOAT4X4 world = Translation(0.0f, 0.0f, WallZ);
+		if (indexSize == 32)
+			culler.RasterizeOccluder(WallPositions, sizeof(XMFLOAT3), WallIndices, 6, world);
+		else if (indexSize == 16)
+			culler.RasterizeOccluder(WallPositions, sizeof(XMFLOAT3), WallIndices16, 6, world);
+		else
+		{
+			XMFLOAT3 list[6];
+			for (int i = 0; i < 6; ++i)
+				list[i] = WallPositions[WallIndices[i]];
+			culler.RasterizeOccluder(list, sizeof(XMFLOAT3), (const UINT*)nullptr, 6, world);
+		}
+		culler.Finalize();
+	}
+
+	bool IsVisible(const OcclusionCuller& culler, float x, float y, float z, float extent = 0.5f)
+	{
+		BoundingBox box(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(extent, extent, extent));
+		return culler.IsVisible(box, Translation(x, y, z));
+	}
+
+	void CheckWall()
+	{
+		OcclusionCuller culler(Width, Height);
+		DX_CHECK(culler.GetWidth() == Width && culler.GetHeight() == Height);
+		for (int indexSize : { 16, 32, 0 })
+		{
+			DrawWall(culler, indexSize);
+			DX_CHECK(!IsVisible(culler, 0.0f, 0.0f, 20.0f));
+			DX_CHECK(!IsVisible(culler, 2.0f, -1.0f, 60.0f, 2.0f));
+			DX_CHECK(IsVisible(culler, 0.0f, 0.0f, 5.0f));
+			DX_CHECK(IsVisible(culler, 15.0f, 0.0f, 20.0f));
+			DX_CHECK(IsVisible(culler, 0.0f, 9.0f, 20.0f));
+			// Half in front of the wall.
+			DX_CHECK(IsVisible(culler, 0.0f, 0.0f, WallZ, 1.0f));
+			// Crossing the near plane, and behind the camera.
+			DX_CHECK(IsVisible(culler, 0.0f, 0.0f, 0.0f));
+			DX_CHECK(IsVisible(culler, 0.0f, 0.0f, -20.0f));
+		}
+
+		// A new frame without occluders hides nothing.
+		culler.Clear(GetViewProj());
+		culler.Finalize();
+		DX_CHECK(IsVisible(culler, 0.0f, 0.0f, 20.0f));
+	}
+
+	void CheckWidthRounding()
+	{
+		OcclusionCuller culler(250, 100);
+		DX_CHECK(culler.GetWidth() == 252 && culler.GetHeight() == 100);
+	}
+
+	// Screen rectangle of the corners, as IsVisible projects them.
+	void Project(const XMFLOAT3* corners, UINT count, float rect[4])
+	{
+		XMFLOAT4X4 viewProj = GetViewProj();
+		XMMATRIX M = XMLoadFloat4x4(&viewProj);
+		rect[0] = rect[1] = FLT_MAX;
+		rect[2] = rect[3] = -FLT_MAX;
+		for (UINT i = 0; i < count; ++i)
+		{
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corners[i]), M));
+			float x = (clip.x / clip.w * 0.5f + 0.5f) * Width;
+			float y = (0.5f - clip.y / clip.w * 0.5f) * Height;
+			rect[0] = (std::min)(rect[0], x);
+			rect[1] = (std::min)(rect[1], y);
+			rect[2] = (std::max)(rect[2], x);
+			rect[3] = (std::max)(rect[3], y);
+		}
+	}
+
+	// Random boxes behind the wall, many of them around its edges. A box must be
+	// visible if it peeks out by more than a pixel, and hidden if it is well
+	// inside: the texels of the pyramid level it is tested at are smaller than it.
+	void CheckRandomBoxes()
+	{
+		OcclusionCuller culler(Width, Height);
+		DrawWall(culler, 32);
+
+		XMFLOAT3 wallCorners[4];
+		for (int i = 0; i < 4; ++i)
+			wallCorners[i] = XMFLOAT3(WallPositions[i].x, WallPositions[i].y, WallZ);
+		float wall[4];
+		Project(wallCorners, 4, wall);
+
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> depth(WallZ + 1.0f, 80.0f);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> extent(0.05f, 2.0f);
+		UINT hidden = 0, visible = 0;
+		for (int n = 0; n < 20000; ++n)
+		{
+			float z = depth(random);
+			// Spread over one and a half times the wall's shadow at that depth.
+			float scale = 1.5f * z / WallZ;
+			XMFLOAT3 center(unit(random) * WallHalfWidth * scale, unit(random) * WallHalfHeight * scale, z);
+			XMFLOAT3 extents(extent(random), extent(random), extent(random));
+			if (center.z - extents.z <= WallZ)
+				continue;
+			BoundingBox box(center, extents);
+			XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+			box.GetCorners(corners);
+			float rect[4];
+			Project(corners, BoundingBox::CORNER_COUNT, rect);
+
+			XMFLOAT4X4 identity;
+			XMStoreFloat4x4(&identity, XMMatrixIdentity());
+			bool isVisible = culler.IsVisible(box, identity);
+			bool peeks = rect[0] < wall[0] - 1.0f || rect[1] < wall[1] - 1.0f ||
+				rect[2] > wall[2] + 1.0f || rect[3] > wall[3] + 1.0f;
+			float size = (std::max)(rect[2] - rect[0], rect[3] - rect[1]) + 2.0f;
+			bool inside = rect[0] > wall[0] + size && rect[1] > wall[1] + size &&
+				rect[2] < wall[2] - size && rect[3] < wall[3] - size;
+			if (peeks)
+				DX_CHECK(isVisible);
+			if (inside)
+				DX_CHECK(!isVisible);
+			hidden += !isVisible;
+			visible += isVisible;
+		}
+		printf("random boxes: %u hidden, %u visible\n", hidden, visible);
+		DX_CHECK(hidden > 1000 && visible > 1000);
+	}
+}
+
+int main()
+{
+	CheckWall();
+	CheckWidthRounding();
+	CheckRandomBoxes();
+	return DX::Test::Result();
+}
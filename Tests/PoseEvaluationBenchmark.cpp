@@ -0,0 +1,119 @@
+#include <DirectXMath.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Common/JobSystem.h"
+#include "Components/X3DLoader.h"
+#include "TestHelpers.h"
+
+// Evaluates the poses of a crowd of zombies with a JobSystem of 1 to N threads,
+// the way MeshObject::Update does, checks that every thread count writes the same
+// palettes and prints the scaling.
+// Usage: PoseEvaluationBenchmark DZombie0.x3d [-quick]
+
+using namespace DirectX;
+using namespace DXFramework;
+
+namespace
+{
+	const wchar_t* ClipName = L"Walking";
+	const UINT InstanceCount = 800;
+	const float FrameTime = 1.0f / 60.0f;
+
+	struct Crowd
+	{
+		std::vector<AnimationPlayback> Playbacks;
+		std::vector<XMFLOAT4X4> Palettes;
+	};
+
+	void StartCrowd(const SkinnedData& skinInfo, Crowd& crowd)
+	{
+		ClipHandle clip = skinInfo.GetClipHandle(ClipName);
+		float endTime = skinInfo.GetClipEndTime(clip);
+		crowd.Playbacks.resize(InstanceCount);
+		crowd.Palettes.resize(InstanceCount * skinInfo.GetBoneCount());
+		for (UINT i = 0; i < InstanceCount; ++i)
+		{
+			skinInfo.ResetPlayback(crowd.Playbacks[i], clip);
+			crowd.Playbacks[i].TimePos = endTime * i / InstanceCount;
+		}
+	}
+
+	void UpdateCrowd(const SkinnedData& skinInfo, Crowd& crowd)
+	{
+		UINT numBones = skinInfo.GetBoneCount();
+		DX::ParallelFor(0, InstanceCount, [&](UINT i)
+		{
+			auto& playback = crowd.Playbacks[i];
+			playback.TimePos += FrameTime;
+			if (playback.TimePos > skinInfo.GetClipEndTime(playback.Clip))
+				playback.TimePos = 0.0f;
+			skinInfo.GetFinalTransforms(playback, &crowd.Palettes[i * numBones]);
+		});
+	}
+
+	// ms per frame, best of the runs.
+	double TimeCrowd(const SkinnedData& skinInfo, UINT frames, UINT runs, std::vector<XMFLOAT4X4>& palettes)
+	{
+		double best = 1e30;
+		for (UINT run = 0; run < runs; ++run)
+		{
+			Crowd crowd;
+			StartCrowd(skinInfo, crowd);
+			DX::Test::Stopwatch watch;
+			for (UINT frame = 0; frame < frames; ++frame)
+				UpdateCrowd(skinInfo, crowd);
+			best = (std::min)(best, watch.GetMs() / frames);
+			palettes.swap(crowd.Palettes);
+		}
+		return best;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: PoseEvaluationBenchmark DZombie0.x3d [-quick]\n");
+		return 1;
+	}
+	std::string filename = argv[1];
+	bool quick = DX::Test::HasArgument(argc, argv, "-quick");
+	UINT frames = quick ? 20 : 300;
+	UINT runs = quick ? 1 : 3;
+	// Two threads at least, so that the parallel path runs on any machine.
+	UINT maxThreads = (std::max)(std::thread::hardware_concurrency(), 2u);
+	if (quick)
+		maxThreads = (std::min)(maxThreads, 4u);
+
+	std::vector<DX::PosNormalTexTanSkinned> vertices;
+	std::vector<UINT> indices;
+	std::vector<Subset> subsets;
+	std::vector<X3dMaterial> materials;
+	SkinnedData skinInfo;
+	auto file = X3DLoader::LoadX3dSkinned(std::wstring(filename.begin(), filename.end()), vertices, indices, subsets, materials, skinInfo);
+	if (!DX_CHECK(skinInfo.GetBoneCount() > 0))
+		return DX::Test::Result();
+
+	printf("%u instances of %u bones\n", InstanceCount, skinInfo.GetBoneCount());
+	printf("%8s %10s %10s %10s\n", "Threads", "ms/frame", "Speedup", "Efficiency");
+
+	// Without a JobSystem, ParallelFor runs on the calling thread.
+	std::vector<XMFLOAT4X4> expected;
+	double serialMs = TimeCrowd(skinInfo, frames, runs, expected);
+	printf("%8u %10.3f %10.2f %9.0f%%\n", 1u, serialMs, 1.0, 100.0);
+
+	for (UINT threads = 2; threads <= maxThreads; ++threads)
+	{
+		// The calling thread takes part, so it makes one more.
+		DX::JobSystem jobSystem(threads - 1);
+		std::vector<XMFLOAT4X4> palettes;
+		double ms = TimeCrowd(skinInfo, frames, runs, palettes);
+		DX_CHECK(palettes.size() == expected.size() &&
+			memcmp(palettes.data(), expected.data(), expected.size() * sizeof(XMFLOAT4X4)) == 0);
+		printf("%8u %10.3f %10.2f %9.0f%%\n", threads, ms, serialMs / ms, 100.0 * serialMs / ms / threads);
+	}
+	return DX::Test::Result();
+}
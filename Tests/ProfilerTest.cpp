@@ -0,0 +1,257 @@
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Common/Profiler.h"
+#include "TestHelpers.h"
+
+// Checks the Profiler: a fixed rate converts ticks exactly and zones fall between
+// the Now reads around and inside them; the measured rate matches the steady clock
+// in the first frame, before EndFrame has refined it, and in later ones; zones
+// nest, threads register their own rings, a full ring drops zones, names spelled
+// by several literals are merged, and a capture writes every zone and frame to the
+// Chrome trace. No check depends on how long a spin takes under load.
+
+using namespace DX;
+
+namespace
+{
+	void Spin(double ms)
+	{
+		DX::Test::Stopwatch stopwatch;
+		while (stopwatch.GetMs() < ms);
+	}
+
+	const ProfileZoneStats* Find(const std::vector<ProfileZoneStats>& zones, const char* name)
+	{
+		for (auto& zone : zones)
+		{
+			if (zone.Name == name)
+				return &zone;
+		}
+		return nullptr;
+	}
+
+	// The rate is off by far less than this, see Profiler::CalibrationMs.
+	const double RateTolerance = 0.1;
+
+	// A fixed rate converts ticks exactly, and zones take no longer than the Now
+	// reads around them and no less than those inside them.
+	void CheckFixedRate(Profiler& profiler)
+	{
+		DX_CHECK(profiler.TicksToMs(3000000) == 3.0);
+
+		UINT64 outerStart = Profiler::Now();
+		UINT64 innerStart, innerEnd;
+		{
+			DX_PROFILE_ZONE("Outer");
+			Spin(1.0);
+			innerStart = Profiler::Now();
+			{
+				DX_PROFILE_ZONE("Inner");
+				Spin(1.0);
+			}
+			innerEnd = Profiler::Now();
+		}
+		UINT64 outerEnd = Profiler::Now();
+		profiler.EndFrame();
+
+		auto zones = profiler.GetZoneStats();
+		const ProfileZoneStats* outer = Find(zones, "Outer");
+		const ProfileZoneStats* inner = Find(zones, "Inner");
+		DX_CHECK(outer && outer->Calls == 1);
+		DX_CHECK(inner && inner->Calls == 1);
+		if (outer && inner)
+		{
+			double innerMs = profiler.TicksToMs(innerEnd - innerStart);
+			DX_CHECK(inner->TotalMs > 0.0 && inner->TotalMs <= innerMs);
+			DX_CHECK(outer->TotalMs >= innerMs && outer->TotalMs <= profiler.TicksToMs(outerEnd - outerStart));
+		}
+
+		// EndFrame doesn't refine a fixed rate.
+		Spin(120.0);
+		profiler.EndFrame();
+		DX_CHECK(profiler.TicksToMs(3000000) == 3.0);
+	}
+
+	// The measured rate against the steady clock, which the Now reads are taken
+	// inside of, then around, so that a preemption lengthens both alike.
+	void CheckRate(const Profiler& profiler)
+	{
+		DX::Test::Stopwatch outer;
+		UINT64 start = Profiler::Now();
+		Spin(20.0);
+		UINT64 end = Profiler::Now();
+		DX_CHECK(profiler.TicksToMs(end - start) <= outer.GetMs() * (1.0 + RateTolerance));
+
+		start = Profiler::Now();
+		DX::Test::Stopwatch inner;
+		Spin(20.0);
+		double innerMs = inner.GetMs();
+		end = Profiler::Now();
+		DX_CHECK(profiler.TicksToMs(end - start) >= innerMs * (1.0 - RateTolerance));
+	}
+
+	void CheckTimes(Profiler& profiler)
+	{
+		// Right after the constructor, the first frame. Zones last at least as long
+		// as the spins they hold.
+		CheckRate(profiler);
+		{
+			DX_PROFILE_ZONE("Outer");
+			Spin(8.0);
+			{
+				DX_PROFILE_ZONE("Inner");
+				Spin(4.0);
+			}
+		}
+		profiler.EndFrame();
+		auto zones = profiler.GetZoneStats();
+		const ProfileZoneStats* outer = Find(zones, "Outer");
+		const ProfileZoneStats* inner = Find(zones, "Inner");
+		DX_CHECK(outer && outer->Calls == 1 && outer->TotalMs >= 12.0 * (1.0 - RateTolerance));
+		DX_CHECK(inner && inner->Calls == 1 && inner->TotalMs >= 4.0 * (1.0 - RateTolerance));
+		// Longest first.
+		DX_CHECK(!zones.empty() && zones[0].Name == "Outer");
+
+		// Later frames, once the rate is refined.
+		Spin(120.0);
+		profiler.ResetStats();
+		for (int n = 0; n < 5; ++n)
+		{
+			{
+				DX_PROFILE_ZONE("Frame");
+				Spin(2.0);
+			}
+			profiler.EndFrame();
+		}
+		CheckRate(profiler);
+		zones = profiler.GetZoneStats();
+		const ProfileZoneStats* frame = Find(zones, "Frame");
+		DX_CHECK(frame && frame->Calls == 5 && frame->MinMs >= 2.0 * (1.0 - RateTolerance));
+		DX_CHECK(frame && frame->MinMs <= frame->MaxMs && frame->GetPercentileMs(0.5) <= frame->MaxMs);
+		DX_CHECK(Find(zones, "Outer") == nullptr);
+	}
+
+	void CheckThreads(Profiler& profiler)
+	{
+		profiler.ResetStats();
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([]()
+			{
+				for (int n = 0; n < 1000; ++n)
+				{
+					DX_PROFILE_ZONE("Worker");
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		profiler.EndFrame();
+		const ProfileZoneStats* worker = Find(profiler.GetZoneStats(), "Worker");
+		DX_CHECK(worker && worker->Calls == 4000);
+		DX_CHECK(profiler.GetDroppedZones() == 0);
+	}
+
+	void CheckDropped(Profiler& profiler)
+	{
+		profiler.ResetStats();
+		const UINT Zones = ProfileThread::Capacity + 1000;
+		for (UINT n = 0; n < Zones; ++n)
+		{
+			DX_PROFILE_ZONE("Flood");
+		}
+		profiler.EndFrame();
+		const ProfileZoneStats* flood = Find(profiler.GetZoneStats(), "Flood");
+		DX_CHECK(flood && flood->Calls == ProfileThread::Capacity);
+		DX_CHECK(profiler.GetDroppedZones() == 1000);
+	}
+
+	void CheckMergedNames(Profiler& profiler)
+	{
+		static const char first[] = "Merged";
+		static const char second[] = "Merged";
+		profiler.ResetStats();
+		{
+			DX_PROFILE_ZONE(first);
+		}
+		{
+			DX_PROFILE_ZONE(second);
+		}
+		profiler.EndFrame();
+		const ProfileZoneStats* merged = Find(profiler.GetZoneStats(), "Merged");
+		DX_CHECK(merged && merged->Calls == 2);
+	}
+
+	void CheckCapture(Profiler& profiler)
+	{
+		profiler.Capture(3);
+		DX_CHECK(profiler.IsCapturing() && !profiler.HasCapture());
+		for (int n = 0; n < 3; ++n)
+		{
+			{
+				DX_PROFILE_ZONE("Captured");
+				Spin(1.0);
+			}
+			profiler.EndFrame();
+		}
+		DX_CHECK(profiler.HasCapture());
+		std::ostringstream out;
+		profiler.WriteChromeTrace(out);
+		std::string trace = out.str();
+		size_t zones = 0, frames = 0;
+		for (size_t at = trace.find("\"name\":\"Captured\""); at != std::string::npos; at = trace.find("\"name\":\"Captured\"", at + 1))
+			++zones;
+		for (size_t at = trace.find("\"name\":\"Frame "); at != std::string::npos; at = trace.find("\"name\":\"Frame ", at + 1))
+			++frames;
+		DX_CHECK(zones == 3 && frames == 4);
+		DX_CHECK(trace.compare(0, 1, "{") == 0 && trace.find("]}") != std::string::npos);
+		DX_CHECK(!profiler.HasCapture());
+	}
+}
+
+int main()
+{
+	{
+		// A billion ticks a second.
+		Profiler profiler(1e9);
+		CheckFixedRate(profiler);
+	}
+	{
+		Profiler profiler;
+		DX_CHECK(Profiler::Instance() == &profiler);
+		bool threw = false;
+		try
+		{
+			Profiler second;
+		}
+		catch (std::logic_error&)
+		{
+			threw = true;
+		}
+		DX_CHECK(threw);
+		DX_CHECK(profiler.GetZoneOverheadNs() > 0.0 && profiler.GetZoneOverheadNs() < 1000.0);
+
+		CheckTimes(profiler);
+		CheckThreads(profiler);
+		CheckDropped(profiler);
+		CheckMergedNames(profiler);
+		CheckCapture(profiler);
+		printf("zone overhead %.1f ns\n", profiler.GetZoneOverheadNs());
+	}
+	DX_CHECK(Profiler::Instance() == nullptr);
+
+	// A new profiler registers the threads again.
+	Profiler profiler;
+	{
+		DX_PROFILE_ZONE("Again");
+	}
+	profiler.EndFrame();
+	DX_CHECK(Find(profiler.GetZoneStats(), "Again") != nullptr);
+	return DX::Test::Result();
+}
@@ -0,0 +1,128 @@
+#include <vector>
+#include "Common/RecordingRenderContext.h"
+#include "Common/RenderQueue.h"
+#include "TestHelpers.h"
+
+// Checks the order RenderQueue submits draws added out of order in: opaque draws by
+// program, state and depth front to back, then transparent ones back to front, as
+// their keys order. And the state changes it makes on the null backend of
+// RecordingRenderContext, sorted and in the order added, none of them redundant.
+
+using namespace DX;
+
+namespace
+{
+	// Objects are only compared, so any distinct pointers do.
+	template<typename T>
+	T* FakeObject(UINT_PTR id)
+	{
+		return reinterpret_cast<T*>(id * 16);
+	}
+
+	DrawState MakeState(UINT_PTR program, UINT_PTR texture, RenderBucket bucket)
+	{
+		DrawState state;
+		state.Bucket = bucket;
+		state.InputLayout = FakeObject<ID3D11InputLayout>(1);
+		state.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		state.SetShader(ShaderStage::Vertex, FakeObject<ID3D11DeviceChild>(10 + program));
+		state.SetShader(ShaderStage::Pixel, FakeObject<ID3D11DeviceChild>(20 + program));
+		ID3D11ShaderResourceView* view = FakeObject<ID3D11ShaderResourceView>(30 + texture);
+		state.SetShaderResources(ShaderStage::Pixel, 0, 1, &view);
+		if (bucket == RenderBucket::Transparent)
+			state.BlendState = FakeObject<ID3D11BlendState>(40);
+		return state;
+	}
+
+	struct TestDraw
+	{
+		UINT State;
+		float Depth;
+	};
+
+	// Submits the draws, each drawing 3 vertices from its index, and returns the
+	// indices in the order drawn.
+	std::vector<UINT> Submit(RecordingRenderContext& context, const std::vector<TestDraw>& draws)
+	{
+		RenderQueue queue;
+		queue.Begin(RenderPass::Color);
+		// Programs 0 and 1, the last state transparent.
+		queue.AddState(MakeState(0, 0, RenderBucket::Opaque));
+		queue.AddState(MakeState(0, 1, RenderBucket::Opaque));
+		queue.AddState(MakeState(1, 2, RenderBucket::Opaque));
+		queue.AddState(MakeState(0, 0, RenderBucket::Transparent));
+		for (UINT i = 0; i < draws.size(); ++i)
+			queue.Draw(draws[i].State, 3, i, draws[i].Depth);
+		DX_CHECK(queue.GetPacketCount() == draws.size());
+
+		context.Reset();
+		context.BeginFrame();
+		queue.Execute(&context);
+
+		std::vector<UINT> order;
+		for (const RenderCommand& command : context.GetLog())
+		{
+			if (command.Type == RenderCommandType::Draw)
+				order.push_back(command.Arg);
+		}
+		return order;
+	}
+
+	void CheckOrder()
+	{
+		const std::vector<TestDraw> draws =
+		{
+			{ 2, 3.0f }, { 0, 5.0f }, { 3, 1.0f }, { 1, 2.0f },
+			{ 0, 1.0f }, { 2, 1.0f }, { 3, 4.0f }, { 1, 7.0f },
+		};
+		RecordingRenderContext context;
+
+		std::vector<UINT> sorted = Submit(context, draws);
+		DX_CHECK(sorted == std::vector<UINT>({ 4, 1, 3, 7, 5, 0, 6, 2 }));
+		// The first state binds the input layout, topology, the shaders of every
+		// stage, the view, the rasterizer and blend state; the second only its view,
+		// the third its shaders and view, the transparent one its shaders, view and
+		// blend state. Afterwards the blend state and view are unbound.
+		RenderCounters counters = context.GetCounters();
+		DX_CHECK(counters.Draws == 8);
+		DX_CHECK(counters.StateChanges == 10 + 1 + 3 + 4 + 2);
+		DX_CHECK(counters.Calls[(UINT)RenderCommandType::SetShader] == 5 + 2 + 2);
+		DX_CHECK(counters.Calls[(UINT)RenderCommandType::SetShaderResources] == 4 + 1);
+		DX_CHECK(counters.RedundantStateChanges == 0);
+
+		// In the order added every draw changes the state.
+		RenderQueue::SetSortingEnabled(false);
+		std::vector<UINT> added = Submit(context, draws);
+		RenderQueue::SetSortingEnabled(true);
+		DX_CHECK(added == std::vector<UINT>({ 0, 1, 2, 3, 4, 5, 6, 7 }));
+		RenderCounters unsorted = context.GetCounters();
+		DX_CHECK(unsorted.Draws == 8);
+		DX_CHECK(unsorted.StateChanges == 10 + 3 + 1 + 2 + 1 + 3 + 4 + 2 + 1);
+		DX_CHECK(unsorted.Calls[(UINT)RenderCommandType::SetShader] == 5 + 2 + 2 + 2);
+		DX_CHECK(unsorted.Calls[(UINT)RenderCommandType::SetShaderResources] == 7 + 1);
+		DX_CHECK(unsorted.RedundantStateChanges == 0);
+	}
+
+	void CheckKeys()
+	{
+		// The pass comes first, then the bucket; opaque draws sort by program before
+		// depth, transparent ones by depth, farthest first.
+		DX_CHECK(RenderQueue::MakeKey(RenderPass::Depth, RenderBucket::Transparent, 9, 9, 9.0f) <
+			RenderQueue::MakeKey(RenderPass::Color, RenderBucket::Opaque, 0, 0, 0.0f));
+		DX_CHECK(RenderQueue::MakeKey(RenderPass::Color, RenderBucket::Opaque, 9, 9, 9.0f) <
+			RenderQueue::MakeKey(RenderPass::Color, RenderBucket::Transparent, 0, 0, 0.0f));
+		DX_CHECK(RenderQueue::MakeKey(RenderPass::Color, RenderBucket::Opaque, 0, 0, 9.0f) <
+			RenderQueue::MakeKey(RenderPass::Color, RenderBucket::Opaque, 1, 0, 1.0f));
+		DX_CHECK(RenderQueue::MakeKey(RenderPass::Color, RenderBucket::Opaque, 0, 0, 1.0f) <
+			RenderQueue::MakeKey(RenderPass::Color, RenderBucket::Opaque, 0, 0, 2.0f));
+		DX_CHECK(RenderQueue::MakeKey(RenderPass::Color, RenderBucket::Transparent, 1, 1, 2.0f) <
+			RenderQueue::MakeKey(RenderPass::Color, RenderBucket::Transparent, 0, 0, 1.0f));
+	}
+}
+
+int main()
+{
+	CheckOrder();
+	CheckKeys();
+	return DX::Test::Result();
+}
@@ -0,0 +1,135 @@
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Common/ResourceTable.h"
+#include "TestHelpers.h"
+
+// Times looking up resources named like the shaders and textures of the game: the
+// std::map by name ShaderMgr and TextureMgr used before, against ResourceTable by
+// name, hashing the name and comparing it, and by a handle hashed beforehand, as
+// the components keep them. Tables of 84 names, as many as the sources load, and
+// of 5000. Checks that every lookup finds its resource, that names not added
+// aren't found and that two names with one handle throw.
+// -quick does fewer lookups.
+// Usage: ResourceTableBenchmark [-quick]
+
+using namespace DX;
+
+namespace
+{
+	// Pixel shader permutations and textures, with the long common prefixes of the
+	// real names.
+	std::vector<std::wstring> MakeNames(size_t count)
+	{
+		std::vector<std::wstring> names;
+		for (size_t k = 0; k < count; ++k)
+		{
+			wchar_t name[64];
+			if (k % 2 == 0)
+				swprintf(name, 64, L"BasicPS%08zu.cso", k * 7919 % 100000000);
+			else
+				swprintf(name, 64, L"Media/Textures/Terrain/layer%zu_diffuse.dds", k);
+			names.push_back(name);
+		}
+		return names;
+	}
+
+	// The order of the lookups, the same for every container.
+	std::vector<size_t> MakeOrder(size_t names, size_t lookups)
+	{
+		std::vector<size_t> order(lookups);
+		unsigned long long state = 88172645463325252ull;
+		for (size_t k = 0; k < lookups; ++k)
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			order[k] = (size_t)(state % names);
+		}
+		return order;
+	}
+
+	void Report(const char* name, double ms, size_t lookups, double baselineMs)
+	{
+		printf("  %s: %.1f ms, %.1f ns a lookup, %.1fx the map\n", name, ms, ms * 1e6 / lookups, baselineMs / ms);
+	}
+
+	void Benchmark(size_t count, size_t lookups)
+	{
+		printf("%zu names, %zu lookups\n", count, lookups);
+		std::vector<std::wstring> names = MakeNames(count);
+		std::vector<ResourceHandle> handles;
+		std::map<std::wstring, size_t> map;
+		ResourceTable<size_t> table;
+		for (size_t k = 0; k < count; ++k)
+		{
+			handles.push_back(ResourceHandle(names[k]));
+			map[names[k]] = k;
+			table.Insert(handles[k], names[k], k);
+		}
+		DX_CHECK(table.GetCount() == count);
+		std::vector<size_t> order = MakeOrder(count, lookups);
+
+		// The sums are checked, so that the lookups aren't optimized away.
+		size_t expected = 0;
+		for (size_t k : order)
+			expected += k;
+
+		size_t sum = 0;
+		DX::Test::Stopwatch stopwatch;
+		for (size_t k : order)
+			sum += map.find(names[k])->second;
+		double mapMs = stopwatch.GetMs();
+		DX_CHECK(sum == expected);
+		Report("std::map by name", mapMs, lookups, mapMs);
+
+		sum = 0;
+		stopwatch.Restart();
+		for (size_t k : order)
+			sum += *table.Find(ResourceHandle(names[k]), names[k]);
+		double nameMs = stopwatch.GetMs();
+		DX_CHECK(sum == expected);
+		Report("ResourceTable by name", nameMs, lookups, mapMs);
+
+		sum = 0;
+		stopwatch.Restart();
+		for (size_t k : order)
+			sum += *table.Find(handles[k]);
+		double handleMs = stopwatch.GetMs();
+		DX_CHECK(sum == expected);
+		Report("ResourceTable by handle", handleMs, lookups, mapMs);
+	}
+
+	void CheckMisses()
+	{
+		ResourceTable<int> table;
+		DX_CHECK(table.Find(ResourceHandle(L"BasicVS.cso")) == nullptr);
+		table.Insert(ResourceHandle(L"BasicVS.cso"), L"BasicVS.cso", 1);
+		DX_CHECK(table.Find(ResourceHandle(L"BasicPS.cso"), L"BasicPS.cso") == nullptr);
+		DX_CHECK(*table.Find(ResourceHandle(L"BasicVS.cso"), L"BasicVS.cso") == 1);
+
+		// Another name by the handle of one added.
+		bool threw = false;
+		try
+		{
+			table.Find(ResourceHandle(L"BasicVS.cso"), L"BasicPS.cso");
+		}
+		catch (const std::runtime_error&)
+		{
+			threw = true;
+		}
+		DX_CHECK(threw);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = DX::Test::HasArgument(argc, argv, "-quick");
+	size_t lookups = quick ? 100000 : 10000000;
+	CheckMisses();
+	Benchmark(84, lookups);
+	Benchmark(5000, lookups);
+	return DX::Test::Result();
+}
@@ -0,0 +1,236 @@
+#include <DirectXMath.h>
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "Common/NullRenderDevice.h"
+#include "Common/RenderQueue.h"
+#include "HeadlessScenes.h"
+#include "TestHelpers.h"
+
+// Runs the CPU side of the headless scenes on NullRenderDevice and checks the
+// commands their frames record on the null backend of RecordingRenderContext:
+// every draw has its shaders, input layout and index buffer bound, every map is of
+// a buffer the device created and is unmapped before the next draw, the same frame
+// records the same commands twice, the constant ring draws what the per-draw
+// uploads draw, mapping each buffer once, a static mesh behind the camera is culled, and
+// nothing is left alive once the scene is released.
+// Usage: SceneSubmissionTest MediaDir
+
+using namespace DirectX;
+using namespace DX;
+using namespace DXFramework;
+
+namespace
+{
+	struct Frame
+	{
+		RenderCounters Counters;
+		std::vector<RenderCommand> Log;
+	};
+
+	class SceneRun
+	{
+	public:
+		SceneRun(const std::string& name, const std::string& mediaDir) :
+			m_device(&m_context), m_camera(std::make_shared<Camera>())
+		{
+			m_camera->SetLens(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f);
+			m_timer.SetFixedTimeStep(true);
+			m_scene = CreateHeadlessScene(name, &m_device, &m_context, m_camera, mediaDir);
+			if (m_scene)
+			{
+				m_scene->Initialize();
+				m_scene->CreateDeviceDependentResources();
+				m_scene->CreateWindowSizeDependentResources();
+			}
+		}
+
+		SceneRenderer* GetScene()const { return m_scene.get(); }
+		NullRenderDevice& GetDevice() { return m_device; }
+
+		void LookAt(const XMFLOAT3& position, const XMFLOAT3& target)
+		{
+			m_camera->LookAt(position, target, XMFLOAT3(0.0f, 1.0f, 0.0f));
+			m_camera->UpdateViewMatrix();
+		}
+
+		void Update()
+		{
+			m_timer.Step([&]()
+			{
+				m_scene->Update(m_timer);
+			});
+			m_camera->UpdateViewMatrix();
+		}
+
+		Frame Render()
+		{
+			m_context.BeginFrame();
+			m_scene->Render();
+			Frame frame;
+			frame.Counters = m_context.GetCounters();
+			frame.Log = m_context.GetLog();
+			return frame;
+		}
+
+		void Release()
+		{
+			m_scene->ReleaseDeviceDependentResources();
+			m_scene.reset();
+		}
+
+	private:
+		RecordingRenderContext m_context;
+		NullRenderDevice m_device;
+		std::shared_ptr<Camera> m_camera;
+		GameTimer m_timer;
+		std::unique_ptr<SceneRenderer> m_scene;
+	};
+
+	bool IsDraw(RenderCommandType type)
+	{
+		return type == RenderCommandType::Draw || type == RenderCommandType::DrawIndexed ||
+			type == RenderCommandType::DrawIndexedInstanced || type == RenderCommandType::DrawAuto;
+	}
+
+	// Walks the log keeping what is bound, as the device would. With the constant
+	// ring no buffer is mapped twice in a frame.
+	void CheckCommands(const char* name, const Frame& frame, bool ring)
+	{
+		std::set<const void*> mappedBuffers;
+		const void* shaders[ShaderStageCount] = {};
+		const void* inputLayout = nullptr;
+		const void* indexBuffer = nullptr;
+		const void* mapped = nullptr;
+		UINT draws = 0;
+		for (const RenderCommand& command : frame.Log)
+		{
+			switch (command.Type)
+			{
+			case RenderCommandType::SetShader:
+				shaders[(UINT)command.Stage] = command.Object;
+				break;
+			case RenderCommandType::SetInputLayout:
+				inputLayout = command.Object;
+				break;
+			case RenderCommandType::SetIndexBuffer:
+				indexBuffer = command.Object;
+				break;
+			case RenderCommandType::Map:
+				// Registered by the device, so the null backend knows its size.
+				if (!DX_CHECK(command.Count > 0) || !DX_CHECK(mapped == nullptr))
+					printf("%s: map of %p\n", name, command.Object);
+				mapped = command.Object;
+				if (ring)
+					DX_CHECK(mappedBuffers.insert(command.Object).second);
+				break;
+			case RenderCommandType::Unmap:
+				DX_CHECK(command.Object == mapped);
+				mapped = nullptr;
+				break;
+			default:
+				if (IsDraw(command.Type))
+				{
+					++draws;
+					DX_CHECK(mapped == nullptr);
+					DX_CHECK(shaders[(UINT)ShaderStage::Vertex] != nullptr);
+					DX_CHECK(shaders[(UINT)ShaderStage::Pixel] != nullptr);
+					DX_CHECK(inputLayout != nullptr);
+					if (command.Type != RenderCommandType::Draw && command.Type != RenderCommandType::DrawAuto)
+						DX_CHECK(indexBuffer != nullptr);
+				}
+				break;
+			}
+		}
+		DX_CHECK(draws == frame.Counters.Draws);
+		DX_CHECK(mapped == nullptr);
+	}
+
+	// The map types of the ring differ from frame to frame, and what the first frame
+	// binds is still bound in the second, so neither is compared.
+	bool SameCommands(const Frame& a, const Frame& b)
+	{
+		if (a.Log.size() != b.Log.size())
+			return false;
+		for (size_t i = 0; i < a.Log.size(); ++i)
+		{
+			const RenderCommand& x = a.Log[i];
+			const RenderCommand& y = b.Log[i];
+			if (x.Type != y.Type || x.Stage != y.Stage || x.Slot != y.Slot ||
+				x.Count != y.Count || x.Object != y.Object || (x.Type != RenderCommandType::Map && x.Arg != y.Arg))
+				return false;
+		}
+		return true;
+	}
+
+	void CheckScene(const char* name, const std::string& mediaDir, const XMFLOAT3& position, const XMFLOAT3& target)
+	{
+		SceneRun run(name, mediaDir);
+		if (!DX_CHECK(run.GetScene() != nullptr) || !DX_CHECK(run.GetScene()->GetLoadState()))
+			return;
+		DX_CHECK(run.GetDevice().GetLiveObjects() > 0);
+		DX_CHECK(run.GetDevice().GetCounters().LiveBufferBytes > 0);
+
+		run.LookAt(position, target);
+		run.Update();
+		Frame frame = run.Render();
+		printf("%s: %u draws, %u maps, %u state changes of which %u redundant\n", name, frame.Counters.Draws,
+			frame.Counters.Maps, frame.Counters.StateChanges, frame.Counters.RedundantStateChanges);
+		DX_CHECK(frame.Counters.Draws > 0);
+		DX_CHECK(frame.Counters.Vertices > 0);
+		CheckCommands(name, frame, true);
+
+		// Without an update in between the frame is the same.
+		Frame again = run.Render();
+		DX_CHECK(SameCommands(frame, again));
+
+		// The ring writes the per-draw constants of the queue with one map.
+		RenderQueue::SetConstantRingEnabled(false);
+		Frame perDraw = run.Render();
+		RenderQueue::SetConstantRingEnabled(true);
+		CheckCommands(name, perDraw, false);
+		DX_CHECK(perDraw.Counters.Draws == frame.Counters.Draws);
+		DX_CHECK(perDraw.Counters.Vertices == frame.Counters.Vertices);
+		DX_CHECK(perDraw.Counters.Maps >= frame.Counters.Maps);
+		if (frame.Counters.Draws > 1)
+			DX_CHECK(perDraw.Counters.Maps > frame.Counters.Maps);
+
+		run.Release();
+		DX_CHECK(run.GetDevice().GetLiveObjects() == 0);
+		DX_CHECK(run.GetDevice().GetCounters().LiveBufferBytes == 0);
+	}
+
+	// The static mesh is culled by its bounds, which reach some 500 units from the
+	// origin along the rocket.
+	void CheckCulling(const std::string& mediaDir)
+	{
+		SceneRun run("MeshModel", mediaDir);
+		if (!DX_CHECK(run.GetScene() != nullptr))
+			return;
+		run.LookAt(XMFLOAT3(0.0f, 0.0f, -800.0f), XMFLOAT3(0.0f, 0.0f, -900.0f));
+		run.Update();
+		DX_CHECK(run.Render().Counters.Draws == 0);
+		run.LookAt(XMFLOAT3(0.0f, 0.0f, -800.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+		DX_CHECK(run.Render().Counters.Draws > 0);
+		run.Release();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: SceneSubmissionTest MediaDir\n");
+		return -1;
+	}
+	std::string mediaDir = argv[1];
+
+	DX_CHECK(CreateHeadlessScene("Sky", nullptr, nullptr, nullptr, mediaDir) == nullptr);
+	CheckScene("Terrain", mediaDir, XMFLOAT3(0.0f, 60.0f, -100.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	CheckScene("MeshModel", mediaDir, XMFLOAT3(0.0f, 5.0f, -30.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	CheckScene("SkinnedMeshModel", mediaDir, XMFLOAT3(0.0f, 5.0f, -30.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	CheckCulling(mediaDir);
+	return DX::Test::Result();
+}
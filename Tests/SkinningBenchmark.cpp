@@ -0,0 +1,172 @@
+#include <DirectXMath.h>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "Components/X3DLoader.h"
+#include "TestHelpers.h"
+
+// Plays a clip of the tiger on 500 instances through AnimationPlayback, checks the
+// palettes against the name based GetFinalTransforms, which searches keyframes
+// from the first one, checks that playback doesn't allocate and times both.
+// Usage: SkinningBenchmark DTiger.x3d [-quick]
+
+using namespace DirectX;
+using namespace DXFramework;
+
+namespace
+{
+	std::atomic<unsigned> Allocations(0);
+}
+
+void* operator new(size_t size)
+{
+	++Allocations;
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+namespace
+{
+	const wchar_t* ClipName = L"Idle_Lie Prone";
+	const UINT InstanceCount = 500;
+	const float FrameTime = 1.0f / 60.0f;
+
+	struct Crowd
+	{
+		std::vector<AnimationPlayback> Playbacks;
+		std::vector<XMFLOAT4X4> Palettes;
+	};
+
+	// Instances start at different times, like MeshObject::Update plays them.
+	void StartCrowd(const SkinnedData& skinInfo, Crowd& crowd)
+	{
+		ClipHandle clip = skinInfo.GetClipHandle(ClipName);
+		float endTime = skinInfo.GetClipEndTime(clip);
+		crowd.Playbacks.resize(InstanceCount);
+		crowd.Palettes.resize(InstanceCount * skinInfo.GetBoneCount());
+		for (UINT i = 0; i < InstanceCount; ++i)
+		{
+			skinInfo.ResetPlayback(crowd.Playbacks[i], clip);
+			crowd.Playbacks[i].TimePos = endTime * i / InstanceCount;
+		}
+	}
+
+	void UpdateCrowd(const SkinnedData& skinInfo, Crowd& crowd)
+	{
+		UINT numBones = skinInfo.GetBoneCount();
+		for (UINT i = 0; i < InstanceCount; ++i)
+		{
+			auto& playback = crowd.Playbacks[i];
+			playback.TimePos += FrameTime;
+			if (playback.TimePos > skinInfo.GetClipEndTime(playback.Clip))
+				playback.TimePos = 0.0f;
+			skinInfo.GetFinalTransforms(playback, &crowd.Palettes[i * numBones]);
+		}
+	}
+
+	bool NearlyEqual(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				if (fabsf(a.m[r][c] - b.m[r][c]) > 1e-3f * (1.0f + fabsf(b.m[r][c])))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Every palette matches the name based path at the same time, across the
+	// loop, which takes the cursors back to the first keyframes.
+	void CheckPalettes(const SkinnedData& skinInfo, UINT frames)
+	{
+		Crowd crowd;
+		StartCrowd(skinInfo, crowd);
+		UINT numBones = skinInfo.GetBoneCount();
+		std::vector<XMFLOAT4X4> expected(numBones);
+		UINT mismatches = 0;
+		for (UINT frame = 0; frame < frames; ++frame)
+		{
+			UpdateCrowd(skinInfo, crowd);
+			for (UINT i = 0; i < InstanceCount; i += 7)
+			{
+				skinInfo.GetFinalTransforms(ClipName, crowd.Playbacks[i].TimePos, expected);
+				for (UINT b = 0; b < numBones; ++b)
+					mismatches += NearlyEqual(crowd.Palettes[i * numBones + b], expected[b]) ? 0 : 1;
+			}
+		}
+		DX_CHECK(mismatches == 0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: SkinningBenchmark DTiger.x3d [-quick]\n");
+		return 1;
+	}
+	std::string filename = argv[1];
+	UINT frames = DX::Test::HasArgument(argc, argv, "-quick") ? 60 : 600;
+
+	std::vector<DX::PosNormalTexTanSkinned> vertices;
+	std::vector<UINT> indices;
+	std::vector<Subset> subsets;
+	std::vector<X3dMaterial> materials;
+	SkinnedData skinInfo;
+	auto file = X3DLoader::LoadX3dSkinned(std::wstring(filename.begin(), filename.end()), vertices, indices, subsets, materials, skinInfo);
+	UINT numBones = skinInfo.GetBoneCount();
+	float endTime = skinInfo.GetClipEndTime(ClipName);
+	if (!DX_CHECK(numBones > 0 && endTime > 0.0f))
+		return DX::Test::Result();
+
+	CheckPalettes(skinInfo, (UINT)(endTime / FrameTime) + 10);
+
+	Crowd crowd;
+	StartCrowd(skinInfo, crowd);
+	UpdateCrowd(skinInfo, crowd);
+
+	// Playback allocates nothing once the playback states are reset.
+	unsigned allocations = Allocations;
+	DX::Test::Stopwatch watch;
+	for (UINT frame = 0; frame < frames; ++frame)
+		UpdateCrowd(skinInfo, crowd);
+	double playbackMs = watch.GetMs() / frames;
+	allocations = Allocations - allocations;
+	DX_CHECK(allocations == 0);
+
+	// The name based path, which resolves the clip and searches the keyframes
+	// of every bone from the first one on each call.
+	std::vector<XMFLOAT4X4> transforms(numBones);
+	UINT nameFrames = (std::max)(frames / 10, 1u);
+	watch.Restart();
+	for (UINT frame = 0; frame < nameFrames; ++frame)
+	{
+		for (UINT i = 0; i < InstanceCount; ++i)
+			skinInfo.GetFinalTransforms(ClipName, crowd.Playbacks[i].TimePos, transforms);
+	}
+	double nameMs = watch.GetMs() / nameFrames;
+
+	printf("%u instances of %u bones, %.2f s clip\n", InstanceCount, numBones, endTime);
+	printf("%-22s %10s %14s\n", "Path", "ms/frame", "ns/instance");
+	printf("%-22s %10.3f %14.1f\n", "By name, from key 0", nameMs, nameMs * 1e6 / InstanceCount);
+	printf("%-22s %10.3f %14.1f\n", "Playback cursors", playbackMs, playbackMs * 1e6 / InstanceCount);
+	printf("Speedup %.1fx, %u allocations during playback\n", nameMs / playbackMs, allocations);
+	return DX::Test::Result();
+}
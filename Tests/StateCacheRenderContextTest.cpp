@@ -0,0 +1,435 @@
+#include <vector>
+#include "Common/StateCacheRenderContext.h"
+#include "TestHelpers.h"
+
+// Checks what StateCacheRenderContext forwards to a mock context recording every
+// call it gets: repeated bindings are dropped, changed slots are forwarded as the
+// narrowest range, windows of constant buffers, strides, offsets and formats count
+// as part of a binding, outputs forget the inputs they unbind, Invalidate forgets
+// everything, and draws and maps always go through.
+
+using namespace DX;
+
+namespace
+{
+	// Objects are only compared, so any distinct pointers do.
+	template<typename T>
+	T* FakeObject(UINT_PTR id)
+	{
+		return reinterpret_cast<T*>(id * 16);
+	}
+
+	struct Call
+	{
+		RenderCommandType Type;
+		ShaderStage Stage;
+		UINT StartSlot;
+		std::vector<const void*> Objects;
+		std::vector<UINT64> Values;
+	};
+
+	// Records the calls forwarded to it, with the objects and values of the slots.
+	class MockRenderContext : public RenderContext
+	{
+	public:
+		std::vector<Call> Calls;
+
+		const Call& Last()const { return Calls.back(); }
+
+		virtual void SetShader(ShaderStage stage, ID3D11DeviceChild* shader)
+		{
+			Add(RenderCommandType::SetShader, stage, 0, 1, &shader);
+		}
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+		{
+			Add(RenderCommandType::SetConstantBuffers, stage, startSlot, numBuffers, buffers);
+		}
+		virtual void SetConstantBuffers1(ShaderStage stage, UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers,
+			const UINT* firstConstants, const UINT* numConstants)
+		{
+			Add(RenderCommandType::SetConstantBuffers, stage, startSlot, numBuffers, buffers, firstConstants, numConstants);
+		}
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+		{
+			Add(RenderCommandType::SetShaderResources, stage, startSlot, numViews, views);
+		}
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+		{
+			Add(RenderCommandType::SetSamplers, stage, startSlot, numSamplers, samplers);
+		}
+
+		virtual void IASetInputLayout(ID3D11InputLayout* inputLayout)
+		{
+			Add(RenderCommandType::SetInputLayout, ShaderStage::Vertex, 0, 1, &inputLayout);
+		}
+		virtual void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+		{
+			Add(RenderCommandType::SetVertexBuffers, ShaderStage::Vertex, startSlot, numBuffers, buffers, strides, offsets);
+		}
+		virtual void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+		{
+			UINT f = (UINT)format;
+			Add(RenderCommandType::SetIndexBuffer, ShaderStage::Vertex, 0, 1, &buffer, &f, &offset);
+		}
+		virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+		{
+			UINT t = (UINT)topology;
+			Add<void>(RenderCommandType::SetPrimitiveTopology, ShaderStage::Vertex, 0, 1, nullptr, &t);
+		}
+		virtual void SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets)
+		{
+			Add(RenderCommandType::SetStreamOutTargets, ShaderStage::Vertex, 0, numBuffers, targets, offsets);
+		}
+		virtual void CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* views, const UINT* initialCounts)
+		{
+			Add(RenderCommandType::SetUnorderedAccessViews, ShaderStage::Compute, startSlot, numViews, views, initialCounts);
+		}
+		virtual void RSSetState(ID3D11RasterizerState* state)
+		{
+			Add(RenderCommandType::SetRasterizerState, ShaderStage::Vertex, 0, 1, &state);
+		}
+		virtual void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT*)
+		{
+			Add<void>(RenderCommandType::SetViewports, ShaderStage::Vertex, 0, numViewports, nullptr);
+		}
+		virtual void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView*)
+		{
+			Add(RenderCommandType::SetRenderTargets, ShaderStage::Pixel, 0, numViews, views);
+		}
+		virtual void OMSetBlendState(ID3D11BlendState* state, const FLOAT[4], UINT sampleMask)
+		{
+			Add(RenderCommandType::SetBlendState, ShaderStage::Pixel, 0, 1, &state, &sampleMask);
+		}
+		virtual void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef)
+		{
+			Add(RenderCommandType::SetDepthStencilState, ShaderStage::Pixel, 0, 1, &state, &stencilRef);
+		}
+
+		virtual void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT[4])
+		{
+			Add(RenderCommandType::ClearRenderTarget, ShaderStage::Pixel, 0, 1, &view);
+		}
+		virtual void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT, FLOAT, UINT8)
+		{
+			Add(RenderCommandType::ClearDepthStencil, ShaderStage::Pixel, 0, 1, &view);
+		}
+		virtual HRESULT Map(ID3D11Resource* resource, UINT, D3D11_MAP, UINT, D3D11_MAPPED_SUBRESOURCE* mapped)
+		{
+			Add(RenderCommandType::Map, ShaderStage::Vertex, 0, 1, &resource);
+			mapped->pData = m_scratch;
+			mapped->RowPitch = mapped->DepthPitch = sizeof(m_scratch);
+			return S_OK;
+		}
+		virtual void Unmap(ID3D11Resource* resource, UINT)
+		{
+			Add(RenderCommandType::Unmap, ShaderStage::Vertex, 0, 1, &resource);
+		}
+		virtual void GenerateMips(ID3D11ShaderResourceView* view)
+		{
+			Add(RenderCommandType::GenerateMips, ShaderStage::Pixel, 0, 1, &view);
+		}
+
+		virtual void Draw(UINT vertexCount, UINT)
+		{
+			Add<void>(RenderCommandType::Draw, ShaderStage::Vertex, 0, 1, nullptr, &vertexCount);
+		}
+		virtual void DrawIndexed(UINT indexCount, UINT, INT)
+		{
+			Add<void>(RenderCommandType::DrawIndexed, ShaderStage::Vertex, 0, 1, nullptr, &indexCount);
+		}
+		virtual void DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT, INT, UINT)
+		{
+			Add<void>(RenderCommandType::DrawIndexedInstanced, ShaderStage::Vertex, 0, 1, nullptr, &indexCountPerInstance, &instanceCount);
+		}
+		virtual void DrawAuto()
+		{
+			Add<void>(RenderCommandType::DrawAuto, ShaderStage::Vertex, 0, 0, nullptr);
+		}
+		virtual void Dispatch(UINT groupsX, UINT, UINT)
+		{
+			Add<void>(RenderCommandType::Dispatch, ShaderStage::Compute, 0, 1, nullptr, &groupsX);
+		}
+
+		virtual bool SupportsConstantBufferOffsets() const { return true; }
+
+	private:
+		// Each slot's value packs the two per-slot arguments, like the cache does.
+		template<typename T>
+		void Add(RenderCommandType type, ShaderStage stage, UINT startSlot, UINT count, T* const* objects,
+			const UINT* high = nullptr, const UINT* low = nullptr)
+		{
+			Call call;
+			call.Type = type;
+			call.Stage = stage;
+			call.StartSlot = startSlot;
+			for (UINT k = 0; k < count; ++k)
+			{
+				call.Objects.push_back(objects ? objects[k] : nullptr);
+				UINT64 value = high ? high[k] : 0;
+				call.Values.push_back(low ? value << 32 | low[k] : value);
+			}
+			Calls.push_back(call);
+		}
+
+		BYTE m_scratch[256];
+	};
+
+	void CheckShadersAndStates()
+	{
+		MockRenderContext mock;
+		StateCacheRenderContext cache(&mock);
+
+		ID3D11VertexShader* vs = FakeObject<ID3D11VertexShader>(1);
+		cache.VSSetShader(vs, nullptr, 0);
+		cache.VSSetShader(vs, nullptr, 0);
+		DX_CHECK(mock.Calls.size() == 1);
+		// The stages are bound apart.
+		cache.SetShader(ShaderStage::Pixel, vs);
+		DX_CHECK(mock.Calls.size() == 2 && mock.Last().Stage == ShaderStage::Pixel);
+		// Unbinding is a change too.
+		cache.VSSetShader(nullptr, nullptr, 0);
+		DX_CHECK(mock.Calls.size() == 3 && mock.Last().Objects[0] == nullptr);
+
+		ID3D11RasterizerState* rs = FakeObject<ID3D11RasterizerState>(2);
+		cache.RSSetState(rs);
+		cache.RSSetState(rs);
+		ID3D11DepthStencilState* ds = FakeObject<ID3D11DepthStencilState>(3);
+		cache.OMSetDepthStencilState(ds, 0);
+		cache.OMSetDepthStencilState(ds, 0);
+		cache.OMSetDepthStencilState(ds, 1);
+		DX_CHECK(mock.Calls.size() == 6);
+		DX_CHECK(mock.Last().Type == RenderCommandType::SetDepthStencilState && mock.Last().Values[0] == 1);
+
+		// A null blend factor means 1s, the same as passing them.
+		ID3D11BlendState* bs = FakeObject<ID3D11BlendState>(4);
+		const FLOAT ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		const FLOAT halves[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+		cache.OMSetBlendState(bs, nullptr, 0xffffffff);
+		cache.OMSetBlendState(bs, ones, 0xffffffff);
+		DX_CHECK(mock.Calls.size() == 7);
+		cache.OMSetBlendState(bs, halves, 0xffffffff);
+		cache.OMSetBlendState(bs, halves, 0xff);
+		DX_CHECK(mock.Calls.size() == 9);
+
+		cache.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		cache.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		cache.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
+		DX_CHECK(mock.Calls.size() == 11);
+
+		D3D11_VIEWPORT viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+		cache.RSSetViewports(1, &viewport);
+		cache.RSSetViewports(1, &viewport);
+		viewport.Width = 640.0f;
+		cache.RSSetViewports(1, &viewport);
+		DX_CHECK(mock.Calls.size() == 13);
+
+		const StateCacheCounters& counters = cache.GetCounters();
+		DX_CHECK(counters.IssuedTotal == 13);
+		DX_CHECK(counters.SkippedTotal == 6);
+		DX_CHECK(counters.Issued[(UINT)RenderCommandType::SetShader] == 3);
+		DX_CHECK(counters.Skipped[(UINT)RenderCommandType::SetShader] == 1);
+		DX_CHECK(counters.Skipped[(UINT)RenderCommandType::SetBlendState] == 1);
+
+		// Everything is forwarded again after Invalidate, and BeginFrame drops the counters.
+		cache.BeginFrame();
+		DX_CHECK(cache.GetCounters().IssuedTotal == 0 && cache.GetCounters().SkippedTotal == 0);
+		cache.Invalidate();
+		cache.VSSetShader(nullptr, nullptr, 0);
+		cache.RSSetState(rs);
+		cache.RSSetViewports(1, &viewport);
+		DX_CHECK(mock.Calls.size() == 16);
+		DX_CHECK(cache.GetCounters().IssuedTotal == 3);
+	}
+
+	void CheckSlotRanges()
+	{
+		MockRenderContext mock;
+		StateCacheRenderContext cache(&mock);
+
+		ID3D11ShaderResourceView* views[4];
+		for (UINT k = 0; k < 4; ++k)
+			views[k] = FakeObject<ID3D11ShaderResourceView>(10 + k);
+		cache.PSSetShaderResources(0, 4, views);
+		DX_CHECK(mock.Calls.size() == 1 && mock.Last().StartSlot == 0 && mock.Last().Objects.size() == 4);
+
+		// Only the changed slots are forwarded, as one range from the first to the last.
+		views[2] = FakeObject<ID3D11ShaderResourceView>(20);
+		cache.PSSetShaderResources(0, 4, views);
+		DX_CHECK(mock.Calls.size() == 2 && mock.Last().StartSlot == 2 && mock.Last().Objects.size() == 1);
+		DX_CHECK(mock.Last().Objects[0] == views[2]);
+		DX_CHECK(cache.GetCounters().SlotsSkipped == 3);
+
+		views[1] = FakeObject<ID3D11ShaderResourceView>(21);
+		views[3] = FakeObject<ID3D11ShaderResourceView>(22);
+		cache.PSSetShaderResources(0, 4, views);
+		DX_CHECK(mock.Calls.size() == 3 && mock.Last().StartSlot == 1 && mock.Last().Objects.size() == 3);
+
+		// The same views at other slots are other bindings.
+		cache.PSSetShaderResources(4, 4, views);
+		DX_CHECK(mock.Calls.size() == 4 && mock.Last().StartSlot == 4);
+		cache.PSSetShaderResources(4, 4, views);
+		cache.PSSetShaderResources(0, 8, nullptr);
+		DX_CHECK(mock.Calls.size() == 5 && mock.Last().StartSlot == 0 && mock.Last().Objects.size() == 8);
+
+		// Slots past the capacity are left to the device to report, every time.
+		ID3D11Buffer* buffers[4] = {};
+		cache.VSSetConstantBuffers(D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT - 2, 4, buffers);
+		cache.VSSetConstantBuffers(D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT - 2, 4, buffers);
+		DX_CHECK(mock.Calls.size() == 7);
+	}
+
+	void CheckConstantBufferWindows()
+	{
+		MockRenderContext mock;
+		StateCacheRenderContext cache(&mock);
+
+		ID3D11Buffer* ring = FakeObject<ID3D11Buffer>(1);
+		UINT first = 0, count = 16;
+		cache.VSSetConstantBuffers1(1, 1, &ring, &first, &count);
+		cache.VSSetConstantBuffers1(1, 1, &ring, &first, &count);
+		DX_CHECK(mock.Calls.size() == 1);
+
+		// Another window of the same buffer is another binding.
+		first = 16;
+		cache.VSSetConstantBuffers1(1, 1, &ring, &first, &count);
+		DX_CHECK(mock.Calls.size() == 2 && mock.Last().Values[0] == ((UINT64)16 << 32 | 16));
+
+		// And so is the whole buffer, and a window after it.
+		cache.VSSetConstantBuffers(1, 1, &ring);
+		cache.VSSetConstantBuffers(1, 1, &ring);
+		DX_CHECK(mock.Calls.size() == 3 && mock.Last().Values[0] == 0);
+		cache.VSSetConstantBuffers1(1, 1, &ring, &first, &count);
+		DX_CHECK(mock.Calls.size() == 4);
+
+		// A window of one slot among others keeps the others.
+		ID3D11Buffer* buffers[3] = { FakeObject<ID3D11Buffer>(2), ring, FakeObject<ID3D11Buffer>(3) };
+		UINT firsts[3] = { 0, 32, 0 };
+		UINT counts[3] = { 16, 16, 16 };
+		cache.PSSetConstantBuffers1(0, 3, buffers, firsts, counts);
+		firsts[1] = 48;
+		cache.PSSetConstantBuffers1(0, 3, buffers, firsts, counts);
+		DX_CHECK(mock.Calls.size() == 6 && mock.Last().StartSlot == 1 && mock.Last().Objects.size() == 1);
+		DX_CHECK(mock.Last().Values[0] == ((UINT64)48 << 32 | 16));
+	}
+
+	void CheckInputAssembler()
+	{
+		MockRenderContext mock;
+		StateCacheRenderContext cache(&mock);
+
+		ID3D11Buffer* vbs[2] = { FakeObject<ID3D11Buffer>(1), FakeObject<ID3D11Buffer>(2) };
+		UINT strides[2] = { 32, 64 };
+		UINT offsets[2] = { 0, 0 };
+		cache.IASetVertexBuffers(0, 2, vbs, strides, offsets);
+		cache.IASetVertexBuffers(0, 2, vbs, strides, offsets);
+		DX_CHECK(mock.Calls.size() == 1);
+		// A stride or an offset alone changes the binding.
+		strides[1] = 48;
+		cache.IASetVertexBuffers(0, 2, vbs, strides, offsets);
+		DX_CHECK(mock.Calls.size() == 2 && mock.Last().StartSlot == 1 && mock.Last().Values[0] == ((UINT64)48 << 32));
+		offsets[0] = 128;
+		cache.IASetVertexBuffers(0, 2, vbs, strides, offsets);
+		DX_CHECK(mock.Calls.size() == 3 && mock.Last().StartSlot == 0 && mock.Last().Objects.size() == 1);
+
+		ID3D11Buffer* ib = FakeObject<ID3D11Buffer>(3);
+		cache.IASetIndexBuffer(ib, DXGI_FORMAT_R16_UINT, 0);
+		cache.IASetIndexBuffer(ib, DXGI_FORMAT_R16_UINT, 0);
+		cache.IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
+		cache.IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 12);
+		DX_CHECK(mock.Calls.size() == 6);
+
+		ID3D11InputLayout* layout = FakeObject<ID3D11InputLayout>(4);
+		cache.IASetInputLayout(layout);
+		cache.IASetInputLayout(layout);
+		DX_CHECK(mock.Calls.size() == 7);
+
+		// Stream out targets unbind the vertex and index buffers on the device.
+		ID3D11Buffer* so = FakeObject<ID3D11Buffer>(5);
+		UINT append = (UINT)-1;
+		cache.SOSetTargets(1, &so, &append);
+		cache.SOSetTargets(1, &so, &append);
+		DX_CHECK(mock.Calls.size() == 8);
+		// An offset other than append moves the write position.
+		UINT start = 0;
+		cache.SOSetTargets(1, &so, &start);
+		DX_CHECK(mock.Calls.size() == 9);
+		cache.IASetVertexBuffers(0, 2, vbs, strides, offsets);
+		cache.IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 12);
+		DX_CHECK(mock.Calls.size() == 11);
+		// The input layout isn't an input resource and stays.
+		cache.IASetInputLayout(layout);
+		DX_CHECK(mock.Calls.size() == 11);
+	}
+
+	void CheckOutputs()
+	{
+		MockRenderContext mock;
+		StateCacheRenderContext cache(&mock);
+
+		ID3D11RenderTargetView* rtv = FakeObject<ID3D11RenderTargetView>(1);
+		ID3D11DepthStencilView* dsv = FakeObject<ID3D11DepthStencilView>(2);
+		ID3D11ShaderResourceView* srv = FakeObject<ID3D11ShaderResourceView>(3);
+		ID3D11UnorderedAccessView* uav = FakeObject<ID3D11UnorderedAccessView>(4);
+
+		cache.OMSetRenderTargets(1, &rtv, dsv);
+		cache.PSSetShaderResources(0, 1, &srv);
+		cache.OMSetRenderTargets(1, &rtv, dsv);
+		cache.PSSetShaderResources(0, 1, &srv);
+		DX_CHECK(mock.Calls.size() == 2);
+
+		// Another target forgets the inputs, as the device may have unbound them.
+		cache.OMSetRenderTargets(1, &rtv, nullptr);
+		cache.PSSetShaderResources(0, 1, &srv);
+		DX_CHECK(mock.Calls.size() == 4);
+		// Fewer targets unbind the others.
+		cache.OMSetRenderTargets(0, nullptr, nullptr);
+		DX_CHECK(mock.Calls.size() == 5);
+
+		// So do unordered access views, and initial counts reset their counters.
+		cache.CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
+		cache.CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
+		DX_CHECK(mock.Calls.size() == 6);
+		cache.PSSetShaderResources(0, 1, &srv);
+		DX_CHECK(mock.Calls.size() == 7);
+		UINT keep = (UINT)-1, reset = 0;
+		cache.CSSetUnorderedAccessViews(0, 1, &uav, &keep);
+		DX_CHECK(mock.Calls.size() == 7);
+		cache.CSSetUnorderedAccessViews(0, 1, &uav, &reset);
+		cache.CSSetUnorderedAccessViews(0, 1, &uav, &reset);
+		DX_CHECK(mock.Calls.size() == 9);
+	}
+
+	void CheckWork()
+	{
+		MockRenderContext mock;
+		StateCacheRenderContext cache(&mock);
+
+		ID3D11Buffer* buffer = FakeObject<ID3D11Buffer>(1);
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		DX_CHECK(SUCCEEDED(cache.Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)) && mapped.pData != nullptr);
+		cache.Unmap(buffer, 0);
+		cache.Draw(3, 0);
+		cache.Draw(3, 0);
+		cache.DrawIndexed(6, 0, 0);
+		cache.DrawIndexedInstanced(6, 10, 0, 0, 0);
+		cache.DrawAuto();
+		cache.Dispatch(8, 1, 1);
+		cache.Dispatch(8, 1, 1);
+		DX_CHECK(mock.Calls.size() == 9);
+		DX_CHECK(cache.GetCounters().Maps == 1);
+		DX_CHECK(cache.GetCounters().IssuedTotal == 0 && cache.GetCounters().SkippedTotal == 0);
+		DX_CHECK(mock.Calls[6].Type == RenderCommandType::DrawAuto);
+		DX_CHECK(cache.SupportsConstantBufferOffsets());
+	}
+}
+
+int main()
+{
+	CheckShadersAndStates();
+	CheckSlotRanges();
+	CheckConstantBufferWindows();
+	CheckInputAssembler();
+	CheckOutputs();
+	CheckWork();
+	return DX::Test::Result();
+}
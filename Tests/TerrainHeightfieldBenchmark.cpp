@@ -0,0 +1,193 @@
+#include <DirectXMath.h>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Common/JobSystem.h"
+#include "Components/TerrainHeightfield.h"
+#include "TestHelpers.h"
+
+// Times the height and normal queries of TerrainHeightfield on a 4097 x 4097 map:
+// one point at a time, batched on the calling thread and batched over the thread
+// pool, and checks that the batches match the single point queries. Times ray
+// casts looking down at the terrain, grazing it and passing above it, one at a
+// time and over the pool, and checks the hits lie on the terrain.
+// -quick uses a 513 x 513 map and fewer points and rays.
+// Usage: TerrainHeightfieldBenchmark [-quick]
+
+using namespace DirectX;
+using namespace DXFramework;
+
+namespace
+{
+	const float CellSpacing = 0.5f;
+
+	std::vector<float> MakeSamples(UINT size)
+	{
+		std::vector<float> samples(size_t(size) * size);
+		for (UINT i = 0; i < size; ++i)
+			for (UINT j = 0; j < size; ++j)
+				samples[size_t(i) * size + j] = 20.0f * sinf(0.01f * j) * cosf(0.013f * i) + 2.0f * sinf(0.2f * (i + 2 * j));
+		return samples;
+	}
+
+	// Points scattered over the map, like the particles and units an update queries.
+	std::vector<XMFLOAT2> MakePoints(const TerrainHeightfield& field, UINT count)
+	{
+		std::mt19937 random(19);
+		float halfWidth = 0.5f * field.GetWidth(), halfDepth = 0.5f * field.GetDepth();
+		std::uniform_real_distribution<float> x(-halfWidth, halfWidth), z(-halfDepth, halfDepth);
+		std::vector<XMFLOAT2> points(count);
+		for (auto& p : points)
+			p = XMFLOAT2(x(random), z(random));
+		return points;
+	}
+
+	struct Timings
+	{
+		double HeightsMs;
+		double NormalsMs;
+	};
+
+	Timings TimeBatches(const TerrainHeightfield& field, const std::vector<XMFLOAT2>& points,
+		std::vector<float>& heights, std::vector<XMFLOAT3>& normals)
+	{
+		Timings timings;
+		DX::Test::Stopwatch stopwatch;
+		field.GetHeights(points.data(), (UINT)points.size(), heights.data());
+		timings.HeightsMs = stopwatch.GetMs();
+		stopwatch.Restart();
+		field.GetNormals(points.data(), (UINT)points.size(), normals.data());
+		timings.NormalsMs = stopwatch.GetMs();
+		return timings;
+	}
+
+	// Rays from a camera above the map looking down at it, rays grazing the ground
+	// over long distances, and rays passing above every block.
+	void MakeRays(const TerrainHeightfield& field, UINT count, int kind,
+		std::vector<XMFLOAT3>& origins, std::vector<XMFLOAT3>& directions)
+	{
+		std::mt19937 random(23 + kind);
+		float halfWidth = 0.5f * field.GetWidth(), halfDepth = 0.5f * field.GetDepth();
+		std::uniform_real_distribution<float> x(-halfWidth, halfWidth), z(-halfDepth, halfDepth), unit(-1.0f, 1.0f);
+		origins.resize(count);
+		directions.resize(count);
+		for (UINT i = 0; i < count; ++i)
+		{
+			float px = x(random), pz = z(random);
+			XMVECTOR d = XMVector3Normalize(XMVectorSet(unit(random), 0.0f, unit(random), 0.0f));
+			if (kind == 0)
+			{
+				origins[i] = XMFLOAT3(px, field.GetHeight(px, pz) + 30.0f, pz);
+				d = XMVector3Normalize(XMVectorSetY(d, -0.3f - 0.5f * fabsf(unit(random))));
+			}
+			else if (kind == 1)
+			{
+				origins[i] = XMFLOAT3(px, field.GetHeight(px, pz) + 1.0f, pz);
+				d = XMVector3Normalize(XMVectorSetY(d, -0.005f));
+			}
+			else
+				origins[i] = XMFLOAT3(px, 100.0f, pz);
+			XMStoreFloat3(&directions[i], d);
+		}
+	}
+
+	void BenchmarkRays(const TerrainHeightfield& field, UINT count)
+	{
+		const char* names[] = { "looking down", "grazing", "above" };
+		const float maxDistance = 1000.0f;
+		std::vector<XMFLOAT3> origins, directions;
+		std::vector<TerrainHit> hits(count), batch(count);
+		for (int kind = 0; kind < 3; ++kind)
+		{
+			MakeRays(field, count, kind, origins, directions);
+			DX::Test::Stopwatch stopwatch;
+			UINT hitCount = 0;
+			for (UINT i = 0; i < count; ++i)
+			{
+				if (field.RayCast(XMLoadFloat3(&origins[i]), XMLoadFloat3(&directions[i]), maxDistance, hits[i]))
+					++hitCount;
+				else
+					hits[i].Distance = FLT_MAX;
+			}
+			double singleMs = stopwatch.GetMs();
+
+			double batchMs;
+			{
+				DX::JobSystem jobSystem;
+				stopwatch.Restart();
+				field.RayCasts(origins.data(), directions.data(), count, maxDistance, batch.data());
+				batchMs = stopwatch.GetMs();
+			}
+
+			UINT mismatches = 0, offTerrain = 0;
+			for (UINT i = 0; i < count; ++i)
+			{
+				mismatches += batch[i].Distance != hits[i].Distance;
+				if (hits[i].Distance != FLT_MAX)
+					offTerrain += fabsf(field.GetHeight(hits[i].Position.x, hits[i].Position.z) - hits[i].Position.y) > 1e-2f;
+			}
+			DX_CHECK(mismatches == 0);
+			DX_CHECK(offTerrain == 0);
+			DX_CHECK(kind == 2 ? hitCount == 0 : hitCount > 0);
+			printf("  rays %s: %u of %u hit, %.2f us/ray one at a time, %.2f over the pool\n",
+				names[kind], hitCount, count, 1000.0 * singleMs / count, 1000.0 * batchMs / count);
+		}
+	}
+
+	void Benchmark(UINT size, UINT count, UINT rayCount)
+	{
+		DX::Test::Stopwatch stopwatch;
+		TerrainHeightfield field;
+		field.Initialize(MakeSamples(size), size, size, CellSpacing);
+		double initializeMs = stopwatch.GetMs();
+		std::vector<XMFLOAT2> points = MakePoints(field, count);
+
+		std::vector<float> expectedHeights(count);
+		std::vector<XMFLOAT3> expectedNormals(count);
+		stopwatch.Restart();
+		for (UINT i = 0; i < count; ++i)
+			expectedHeights[i] = field.GetHeight(points[i].x, points[i].y);
+		double heightMs = stopwatch.GetMs();
+		stopwatch.Restart();
+		for (UINT i = 0; i < count; ++i)
+			XMStoreFloat3(&expectedNormals[i], field.GetNormal(points[i].x, points[i].y));
+		double normalMs = stopwatch.GetMs();
+
+		std::vector<float> heights(count);
+		std::vector<XMFLOAT3> normals(count);
+		Timings serial = TimeBatches(field, points, heights, normals);
+		DX_CHECK(heights == expectedHeights);
+		bool equal = true;
+		for (UINT i = 0; i < count; ++i)
+			equal = equal && normals[i].x == expectedNormals[i].x && normals[i].y == expectedNormals[i].y && normals[i].z == expectedNormals[i].z;
+		DX_CHECK(equal);
+
+		Timings parallel;
+		unsigned threads;
+		{
+			DX::JobSystem jobSystem;
+			threads = jobSystem.GetThreadCount();
+			parallel = TimeBatches(field, points, heights, normals);
+		}
+		DX_CHECK(heights == expectedHeights);
+
+		printf("%ux%u, initialized in %.1f ms, %u points\n", size, size, initializeMs, count);
+		printf("  heights: %.1f ns/point one at a time, %.1f batched, %.1f over %u threads\n",
+			1e6 * heightMs / count, 1e6 * serial.HeightsMs / count, 1e6 * parallel.HeightsMs / count, threads + 1);
+		printf("  normals: %.1f ns/point one at a time, %.1f batched, %.1f over %u threads\n",
+			1e6 * normalMs / count, 1e6 * serial.NormalsMs / count, 1e6 * parallel.NormalsMs / count, threads + 1);
+		BenchmarkRays(field, rayCount);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = DX::Test::HasArgument(argc, argv, "-quick");
+	if (quick)
+		Benchmark(513, 100000, 20000);
+	else
+		Benchmark(4097, 4000000, 200000);
+	return DX::Test::Result();
+}
@@ -0,0 +1,388 @@
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <vector>
+#include "Common/JobSystem.h"
+#include "Components/TerrainHeightfield.h"
+#include "TestHelpers.h"
+
+// Checks that the batched queries of TerrainHeightfield give exactly the results
+// of the single point ones: on random points, on the edges and diagonals of the
+// cells, at the vertices, off the terrain and for NaN and infinite coordinates,
+// in batches small enough to run on the calling thread and large enough to be
+// split over the thread pool. Checks the ray casts against intersecting every
+// triangle, for a map in memory and a tiled one, whose pyramid starts at the
+// patches.
+
+using namespace DirectX;
+using namespace DXFramework;
+
+namespace
+{
+	// Odd sizes, so that the last block of every pyramid level is cut short.
+	const UINT Width = 203;
+	const UINT Height = 141;
+	const float CellSpacing = 0.5f;
+	const char* TiledFileName = "TerrainHeightfieldTest.tht";
+	const wchar_t* WideTiledFileName = L"TerrainHeightfieldTest.tht";
+	const UINT TileSize = 32;
+	const float MinHeight = -20.0f;
+	const float HeightStep = 0.001f;
+
+	// Hills with some noise, like a smoothed RAW file.
+	std::vector<float> MakeSamples(UINT width, UINT height, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> noise(-0.2f, 0.2f);
+		std::vector<float> samples(size_t(width) * height);
+		for (UINT i = 0; i < height; ++i)
+			for (UINT j = 0; j < width; ++j)
+				samples[size_t(i) * width + j] = 8.0f * sinf(0.05f * j) * cosf(0.07f * i) + 3.0f * sinf(0.31f * (i + j)) + noise(random);
+		return samples;
+	}
+
+	std::vector<XMFLOAT2> MakePoints(const TerrainHeightfield& field, std::mt19937& random, UINT count)
+	{
+		float halfWidth = 0.5f * field.GetWidth(), halfDepth = 0.5f * field.GetDepth();
+		std::uniform_real_distribution<float> x(-halfWidth, halfWidth), z(-halfDepth, halfDepth);
+		std::uniform_int_distribution<UINT> row(0, field.GetSampleRows() - 1), col(0, field.GetSampleCols() - 1);
+		std::uniform_int_distribution<int> kind(0, 9);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const float nan = std::numeric_limits<float>::quiet_NaN(), inf = std::numeric_limits<float>::infinity();
+		std::vector<XMFLOAT2> points(count);
+		for (auto& p : points)
+		{
+			float vx = -halfWidth + col(random) * CellSpacing, vz = halfDepth - row(random) * CellSpacing;
+			switch (kind(random))
+			{
+			case 0:		// A vertex
+				p = XMFLOAT2(vx, vz);
+				break;
+			case 1:		// On the diagonal of a cell, where s + t is 1
+			{
+				float s = unit(random);
+				p = XMFLOAT2(vx + s * CellSpacing, vz - (1.0f - s) * CellSpacing);
+				break;
+			}
+			case 2:		// On an edge of a cell
+				p = XMFLOAT2(vx + unit(random) * CellSpacing, vz);
+				break;
+			case 3:		// Off the terrain
+				p = XMFLOAT2(x(random) * 3.0f, z(random) * 3.0f);
+				break;
+			case 4:
+			{
+				const float odd[] = { nan, inf, -inf, 1e30f, -1e30f };
+				std::uniform_int_distribution<int> pick(0, 4);
+				if (unit(random) < 0.5f)
+					p = XMFLOAT2(odd[pick(random)], z(random));
+				else
+					p = XMFLOAT2(x(random), odd[pick(random)]);
+				break;
+			}
+			default:
+				p = XMFLOAT2(x(random), z(random));
+				break;
+			}
+		}
+		return points;
+	}
+
+	void CheckBatches(const TerrainHeightfield& field, std::mt19937& random)
+	{
+		// Tails of 1 to 3 points, and batches split over the pool.
+		for (UINT count : { 1u, 3u, 4u, 7u, 1000u, 4097u, 20003u })
+		{
+			std::vector<XMFLOAT2> points = MakePoints(field, random, count);
+			std::vector<float> heights(count);
+			std::vector<XMFLOAT3> normals(count);
+			field.GetHeights(points.data(), count, heights.data());
+			field.GetNormals(points.data(), count, normals.data());
+			UINT heightMismatches = 0, normalMismatches = 0, notFinite = 0;
+			for (UINT i = 0; i < count; ++i)
+			{
+				heightMismatches += heights[i] != field.GetHeight(points[i].x, points[i].y);
+				XMFLOAT3 normal;
+				XMStoreFloat3(&normal, field.GetNormal(points[i].x, points[i].y));
+				normalMismatches += normals[i].x != normal.x || normals[i].y != normal.y || normals[i].z != normal.z;
+				notFinite += !std::isfinite(heights[i]) || !std::isfinite(normals[i].y);
+			}
+			DX_CHECK(heightMismatches == 0);
+			DX_CHECK(normalMismatches == 0);
+			DX_CHECK(notFinite == 0);
+		}
+	}
+
+	// The heights at the vertices are the samples, and points off the terrain get
+	// the height of its nearest edge.
+	void CheckSamples(const TerrainHeightfield& field, const std::vector<float>& samples)
+	{
+		float halfWidth = 0.5f * field.GetWidth(), halfDepth = 0.5f * field.GetDepth();
+		bool equal = true;
+		// The last row and column are the far corners of their cells, which are
+		// interpolated.
+		for (UINT i = 0; i < Height - 1; i += 7)
+			for (UINT j = 0; j < Width - 1; j += 5)
+				equal = equal && field.GetHeight(-halfWidth + j * CellSpacing, halfDepth - i * CellSpacing) == samples[i * Width + j];
+		DX_CHECK(equal);
+		DX_CHECK(field.GetHeight(-halfWidth - 100.0f, halfDepth + 100.0f) == samples[0]);
+		DX_CHECK(field.GetHeight(halfWidth + 100.0f, -halfDepth - 100.0f) == samples.back());
+		DX_CHECK(field.GetHeight(std::numeric_limits<float>::quiet_NaN(), halfDepth) == samples[0]);
+	}
+
+	// Every block of the pyramid holds the samples of its cells.
+	void CheckBounds(const TerrainHeightfield& field, const std::vector<float>& samples)
+	{
+		DX_CHECK(field.GetLevelCount() > TerrainHeightfield::PatchLevel);
+		XMUINT2 top = field.GetBlockCounts(field.GetLevelCount() - 1);
+		DX_CHECK(top.x == 1 && top.y == 1);
+		bool inside = true;
+		for (UINT level = 0; level < field.GetLevelCount(); ++level)
+		{
+			XMUINT2 counts = field.GetBlockCounts(level);
+			const std::vector<XMFLOAT2>& bounds = field.GetBoundsY(level);
+			DX_CHECK(bounds.size() == size_t(counts.x) * counts.y);
+			for (UINT i = 0; i < Height; ++i)
+			{
+				for (UINT j = 0; j < Width; ++j)
+				{
+					// A sample belongs to the cells on both sides of it.
+					UINT row = (std::min)(i, Height - 2) >> level, col = (std::min)(j, Width - 2) >> level;
+					const XMFLOAT2& y = bounds[row * counts.x + col];
+					inside = inside && samples[i * Width + j] >= y.x && samples[i * Width + j] <= y.y;
+				}
+			}
+		}
+		DX_CHECK(inside);
+	}
+
+	// Writes the samples quantized to a .tht file, see TiledHeightmapBenchmark, and
+	// returns the heights the file holds.
+	std::vector<float> WriteTiledMap(const std::vector<float>& samples)
+	{
+		std::vector<USHORT> quantized(samples.size());
+		std::vector<float> heights(samples.size());
+		for (size_t k = 0; k < samples.size(); ++k)
+		{
+			quantized[k] = (USHORT)lroundf((samples[k] - MinHeight) / HeightStep);
+			heights[k] = MinHeight + quantized[k] * HeightStep;
+		}
+
+		UINT tilesX = (Width + TileSize - 1) / TileSize, tilesY = (Height + TileSize - 1) / TileSize;
+		TiledHeightmapHeader header = {};
+		header.Magic = TiledHeightmapMagic;
+		header.Version = TiledHeightmapVersion;
+		header.Width = Width;
+		header.Height = Height;
+		header.TileSize = TileSize;
+		header.MinHeight = MinHeight;
+		header.HeightStep = HeightStep;
+
+		std::ofstream fout(TiledFileName, std::ios::binary);
+		size_t tilesOffset = sizeof(header) + size_t(tilesX) * tilesY * sizeof(XMFLOAT2);
+		tilesOffset = (tilesOffset + TiledHeightmapAlignment - 1) / TiledHeightmapAlignment * TiledHeightmapAlignment;
+		fout.seekp(tilesOffset);
+		std::vector<XMFLOAT2> bounds;
+		std::vector<USHORT> tile(TileSize * TileSize);
+		for (UINT ty = 0; ty < tilesY; ++ty)
+		{
+			for (UINT tx = 0; tx < tilesX; ++tx)
+			{
+				USHORT minQ = 65535, maxQ = 0;
+				for (UINT i = ty * TileSize; i <= (std::min)((ty + 1) * TileSize, Height - 1); ++i)
+				{
+					for (UINT j = tx * TileSize; j <= (std::min)((tx + 1) * TileSize, Width - 1); ++j)
+					{
+						minQ = (std::min)(minQ, quantized[i * Width + j]);
+						maxQ = (std::max)(maxQ, quantized[i * Width + j]);
+					}
+				}
+				bounds.push_back(XMFLOAT2(MinHeight + minQ * HeightStep, MinHeight + maxQ * HeightStep));
+				for (UINT i = 0; i < TileSize; ++i)
+					for (UINT j = 0; j < TileSize; ++j)
+						tile[i * TileSize + j] = quantized[(std::min)(ty * TileSize + i, Height - 1) * Width + (std::min)(tx * TileSize + j, Width - 1)];
+				fout.write(reinterpret_cast<const char*>(tile.data()), tile.size() * sizeof(USHORT));
+			}
+		}
+		fout.seekp(0);
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fout.write(reinterpret_cast<const char*>(bounds.data()), bounds.size() * sizeof(XMFLOAT2));
+		return heights;
+	}
+
+	// Nearest hit of the ray with triangle p0 p1 p2 for t in [0, maxDistance].
+	bool IntersectTriangle(const XMFLOAT3& origin, const XMFLOAT3& direction, const XMFLOAT3& p0,
+		const XMFLOAT3& p1, const XMFLOAT3& p2, float maxDistance, double& t)
+	{
+		double e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+		double e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+		double d[3] = { direction.x, direction.y, direction.z };
+		double p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+		double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (det == 0.0)
+			return false;
+		double s[3] = { origin.x - p0.x, origin.y - p0.y, origin.z - p0.z };
+		double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+		double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+		double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+		if (u < 0.0 || v < 0.0 || u + v > 1.0)
+			return false;
+		t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+		return t >= 0.0 && t <= maxDistance;
+	}
+
+	// The nearest hit with the two triangles of every cell, split like GetHeight splits them.
+	bool BruteForceRayCast(const std::vector<float>& heights, const XMFLOAT3& origin, const XMFLOAT3& direction,
+		float maxDistance, double& distance)
+	{
+		float halfWidth = 0.5f * (Width - 1) * CellSpacing, halfDepth = 0.5f * (Height - 1) * CellSpacing;
+		auto vertex = [&](UINT i, UINT j)
+		{
+			return XMFLOAT3(-halfWidth + j * CellSpacing, heights[i * Width + j], halfDepth - i * CellSpacing);
+		};
+		distance = DBL_MAX;
+		for (UINT i = 0; i + 1 < Height; ++i)
+		{
+			for (UINT j = 0; j + 1 < Width; ++j)
+			{
+				XMFLOAT3 a = vertex(i, j), b = vertex(i, j + 1), c = vertex(i + 1, j), d = vertex(i + 1, j + 1);
+				double t;
+				if (IntersectTriangle(origin, direction, a, b, c, maxDistance, t) && t < distance)
+					distance = t;
+				if (IntersectTriangle(origin, direction, d, c, b, maxDistance, t) && t < distance)
+					distance = t;
+			}
+		}
+		return distance != DBL_MAX;
+	}
+
+	// Rays looking down at the terrain from above it and from off the map, grazing
+	// ones, straight down and straight up, and some from below it.
+	void MakeRays(std::mt19937& random, UINT count, std::vector<XMFLOAT3>& origins, std::vector<XMFLOAT3>& directions)
+	{
+		float halfWidth = 0.5f * (Width - 1) * CellSpacing, halfDepth = 0.5f * (Height - 1) * CellSpacing;
+		std::uniform_real_distribution<float> x(-1.3f * halfWidth, 1.3f * halfWidth), z(-1.3f * halfDepth, 1.3f * halfDepth);
+		std::uniform_real_distribution<float> y(-15.0f, 40.0f), unit(-1.0f, 1.0f);
+		std::uniform_int_distribution<int> kind(0, 9);
+		origins.resize(count);
+		directions.resize(count);
+		for (UINT i = 0; i < count; ++i)
+		{
+			origins[i] = XMFLOAT3(x(random), y(random), z(random));
+			XMFLOAT3 d(unit(random), unit(random), unit(random));
+			switch (kind(random))
+			{
+			case 0:
+				d = XMFLOAT3(0.0f, -1.0f, 0.0f);
+				break;
+			case 1:
+				d = XMFLOAT3(0.0f, 1.0f, 0.0f);
+				break;
+			case 2:		// Grazing along an axis
+				origins[i].y = 2.0f * unit(random);
+				d = XMFLOAT3(unit(random) < 0.0f ? -1.0f : 1.0f, 0.01f * unit(random), 0.0f);
+				break;
+			case 3:
+				origins[i].y = 2.0f * unit(random);
+				d.y = 0.02f * unit(random);
+				break;
+			default:
+				d.y = -fabsf(d.y);
+				break;
+			}
+			// Directions needn't be unit length.
+			float scale = 0.5f + fabsf(unit(random));
+			directions[i] = XMFLOAT3(d.x * scale, d.y * scale, d.z * scale);
+		}
+	}
+
+	void CheckRayCasts(const TerrainHeightfield& field, const std::vector<float>& heights, std::mt19937& random)
+	{
+		const UINT count = 600;
+		std::vector<XMFLOAT3> origins, directions;
+		MakeRays(random, count, origins, directions);
+		std::uniform_real_distribution<float> maxDistance(1.0f, 300.0f);
+		UINT hits = 0, hitMismatches = 0, distanceMismatches = 0, normalMismatches = 0;
+		for (UINT i = 0; i < count; ++i)
+		{
+			float maxT = i % 2 ? FLT_MAX : maxDistance(random);
+			TerrainHit hit;
+			bool found = field.RayCast(XMLoadFloat3(&origins[i]), XMLoadFloat3(&directions[i]), maxT, hit);
+			double expected;
+			bool expectedFound = BruteForceRayCast(heights, origins[i], directions[i], maxT, expected);
+			if (found != expectedFound)
+			{
+				++hitMismatches;
+				continue;
+			}
+			if (!found)
+				continue;
+			++hits;
+			distanceMismatches += fabs(hit.Distance - expected) > 1e-4 * (1.0 + expected);
+			// The height under the hit, and a normal facing up.
+			normalMismatches += hit.Normal.y <= 0.0f || fabsf(XMVectorGetX(XMVector3Length(XMLoadFloat3(&hit.Normal))) - 1.0f) > 1e-4f;
+			distanceMismatches += fabsf(field.GetHeight(hit.Position.x, hit.Position.z) - hit.Position.y) > 1e-3f;
+		}
+		DX_CHECK(hitMismatches == 0);
+		DX_CHECK(distanceMismatches == 0);
+		DX_CHECK(normalMismatches == 0);
+		DX_CHECK(hits > count / 4);
+
+		// The batch gives the same hits, and FLT_MAX for the misses.
+		std::vector<TerrainHit> batch(count);
+		field.RayCasts(origins.data(), directions.data(), count, 500.0f, batch.data());
+		UINT batchMismatches = 0;
+		for (UINT i = 0; i < count; ++i)
+		{
+			TerrainHit hit;
+			if (field.RayCast(XMLoadFloat3(&origins[i]), XMLoadFloat3(&directions[i]), 500.0f, hit))
+				batchMismatches += batch[i].Distance != hit.Distance || batch[i].Normal.y != hit.Normal.y;
+			else
+				batchMismatches += batch[i].Distance != FLT_MAX;
+		}
+		DX_CHECK(batchMismatches == 0);
+		printf("%u of %u rays hit\n", hits, count);
+	}
+
+	void CheckTiledRayCasts(const std::vector<float>& samples, std::mt19937& random)
+	{
+		std::vector<float> heights = WriteTiledMap(samples);
+		TiledHeightmap tiledHeightmap;
+		DX_CHECK(tiledHeightmap.Open(WideTiledFileName));
+		TerrainHeightfield field;
+		field.Initialize(tiledHeightmap, CellSpacing);
+		DX_CHECK(field.GetSamples().empty());
+		DX_CHECK(field.GetBoundsY(0).empty() && !field.GetBoundsY(TerrainHeightfield::PatchLevel).empty());
+		CheckRayCasts(field, heights, random);
+		tiledHeightmap.Close();
+		std::remove(TiledFileName);
+	}
+}
+
+int main()
+{
+	std::mt19937 random(17);
+	std::vector<float> samples = MakeSamples(Width, Height, random);
+	TerrainHeightfield field;
+	field.Initialize(samples, Width, Height, CellSpacing);
+	DX_CHECK(field.GetSampleCols() == Width && field.GetSampleRows() == Height);
+	DX_CHECK(field.GetSamples() == samples);
+	CheckSamples(field, samples);
+	CheckBounds(field, samples);
+
+	// On the calling thread, then over the pool.
+	CheckBatches(field, random);
+	CheckRayCasts(field, samples, random);
+	{
+		DX::JobSystem jobSystem(4);
+		CheckBatches(field, random);
+		CheckRayCasts(field, samples, random);
+	}
+	CheckTiledRayCasts(samples, random);
+	printf("%ux%u samples, %u pyramid levels\n", Width, Height, field.GetLevelCount());
+	return DX::Test::Result();
+}
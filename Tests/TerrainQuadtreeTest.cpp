@@ -0,0 +1,137 @@
+#include <DirectXMath.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include "Common/FrustumCuller.h"
+#include "Components/TerrainQuadtree.h"
+#include "TestHelpers.h"
+
+// Checks the patches TerrainQuadtree selects against testing every patch against
+// the planes, that they come out nearest first, and that selecting again doesn't
+// allocate.
+
+using namespace DirectX;
+using namespace DXFramework;
+
+namespace
+{
+	std::atomic<unsigned> Allocations(0);
+}
+
+void* operator new(size_t size)
+{
+	++Allocations;
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+namespace
+{
+	// Odd sizes, so that some nodes split in halves along a strip.
+	const UINT Rows = 45;
+	const UINT Cols = 70;
+	const float MinX = -350.0f;
+	const float MaxZ = 225.0f;
+	const float PatchWidth = 10.0f;
+	const float PatchDepth = 10.0f;
+
+	bool Intersects(const XMFLOAT4 planes[6], const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&min), XMLoadFloat3(&max)), 0.5f);
+		XMVECTOR extents = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&max), XMLoadFloat3(&min)), 0.5f);
+		for (UINT k = 0; k < 6; ++k)
+		{
+			XMVECTOR plane = XMLoadFloat4(&planes[k]);
+			float distance = XMVectorGetX(XMPlaneDotCoord(plane, center));
+			float radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(plane), extents));
+			if (distance < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	float DistanceSq(UINT patch, const XMFLOAT3& eye)
+	{
+		UINT i = patch / Cols, j = patch % Cols;
+		float dx = MinX + (j + 0.5f) * PatchWidth - eye.x;
+		float dz = MaxZ - (i + 0.5f) * PatchDepth - eye.z;
+		return dx * dx + dz * dz;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> height(-20.0f, 40.0f);
+	std::vector<XMFLOAT2> boundsY(Rows * Cols);
+	for (auto& y : boundsY)
+	{
+		float a = height(random), b = height(random);
+		y = XMFLOAT2((std::min)(a, b), (std::max)(a, b));
+	}
+	TerrainQuadtree quadtree;
+	quadtree.Build(boundsY, Rows, Cols, MinX, MaxZ, PatchWidth, PatchDepth);
+	DX_CHECK(quadtree.GetPatchCount() == Rows * Cols);
+
+	std::uniform_real_distribution<float> x(MinX, MinX + Cols * PatchWidth);
+	std::uniform_real_distribution<float> z(MaxZ - Rows * PatchDepth, MaxZ);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<UINT> patches, expected;
+	patches.reserve(Rows * Cols);
+	expected.reserve(Rows * Cols);
+	size_t selected = 0;
+	for (int n = 0; n < 200; ++n)
+	{
+		XMFLOAT3 eye(x(random), 30.0f + 50.0f * unit(random), z(random));
+		XMVECTOR target = XMVectorSet(x(random), 0.0f, z(random), 1.0f);
+		XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&eye), target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * XM_PI + unit(random), 1.0f + unit(random), 1.0f, 100.0f + 600.0f * unit(random));
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, proj));
+		XMFLOAT4 planes[6];
+		DX::ExtractFrustumPlanes(planes, viewProj);
+
+		// The first call may grow the scratch buffer, selecting again must not.
+		quadtree.Select(planes, eye, patches);
+		unsigned allocations = Allocations;
+		quadtree.Select(planes, eye, patches);
+		DX_CHECK(Allocations == allocations);
+
+		expected.clear();
+		for (UINT i = 0; i < Rows; ++i)
+		{
+			for (UINT j = 0; j < Cols; ++j)
+			{
+				XMFLOAT2 y = boundsY[i * Cols + j];
+				XMFLOAT3 min(MinX + j * PatchWidth, y.x, MaxZ - (i + 1) * PatchDepth);
+				XMFLOAT3 max(MinX + (j + 1) * PatchWidth, y.y, MaxZ - i * PatchDepth);
+				if (Intersects(planes, min, max))
+					expected.push_back(i * Cols + j);
+			}
+		}
+		std::vector<UINT> sorted = patches;
+		std::sort(sorted.begin(), sorted.end());
+		DX_CHECK(sorted == expected);
+		for (size_t k = 1; k < patches.size(); ++k)
+			DX_CHECK(DistanceSq(patches[k - 1], eye) <= DistanceSq(patches[k], eye));
+		selected += patches.size();
+	}
+	printf("%u nodes, %.1f patches selected on average\n", quadtree.GetNodeCount(), selected / 200.0);
+	DX_CHECK(selected > 0);
+	return DX::Test::Result();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Shared by the headless tests and benchmarks. Each is a program of its own that
+// returns non-zero when a check failed. Benchmarks run their full sizes by default
+// and small ones with -quick, which is how ctest runs them.
+
+namespace DX
+{
+	namespace Test
+	{
+		inline unsigned& Failures()
+		{
+			static unsigned failures = 0;
+			return failures;
+		}
+
+		inline bool Check(bool passed, const char* expression, const char* file, int line)
+		{
+			if (!passed)
+			{
+				++Failures();
+				printf("%s(%d): check failed: %s\n", file, line, expression);
+			}
+			return passed;
+		}
+
+		inline int Result()
+		{
+			if (Failures() > 0)
+				printf("%u checks failed\n", Failures());
+			return Failures() > 0 ? 1 : 0;
+		}
+
+		inline bool HasArgument(int argc, char** argv, const char* name)
+		{
+			for (int i = 1; i < argc; ++i)
+			{
+				if (strcmp(argv[i], name) == 0)
+					return true;
+			}
+			return false;
+		}
+
+		class Stopwatch
+		{
+		public:
+			Stopwatch() : m_start(std::chrono::steady_clock::now()) {}
+			void Restart() { m_start = std::chrono::steady_clock::now(); }
+			double GetMs()const
+			{
+				return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+			}
+
+		private:
+			std::chrono::steady_clock::time_point m_start;
+		};
+	}
+}
+
+#define DX_CHECK(expression) DX::Test::Check((expression), #expression, __FILE__, __LINE__)
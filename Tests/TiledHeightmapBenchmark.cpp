@@ -0,0 +1,251 @@
+#include <DirectXMath.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Components/TiledHeightmap.h"
+#include "TestHelpers.h"
+
+// Writes a 32k x 32k .tht file, 2 GB, opens it and walks the eye across it like
+// Terrain::Update does: the tiles around the eye are prefetched whenever it enters
+// another tile and the heights around it are sampled every frame. Checks the
+// samples, rows and bounds against the generated heights and that only the cache
+// stays resident, and times opening, the walk, random samples and row reads.
+// -quick uses a 4000 x 3000 map, whose last tiles run past its edges.
+// Usage: TiledHeightmapBenchmark [-quick]
+
+using namespace DirectX;
+using namespace DXFramework;
+
+namespace
+{
+	const char* FileName = "TiledHeightmapBenchmark.tht";
+	const wchar_t* WideFileName = L"TiledHeightmapBenchmark.tht";
+	const UINT TileSize = 64;
+	const float MinHeight = -100.0f;
+	const float HeightStep = 0.01f;
+	// Terrain::Update prefetches MaxDist / CellSpacing samples around the eye.
+	const UINT StreamRadius = 512;
+	const UINT SampleRadius = 64;
+
+	// Quantized height of sample (row, col): hills with some noise on them.
+	USHORT Quantized(UINT row, UINT col)
+	{
+		UINT hills = ((row >> 3) * 5 + (col >> 4) * 3) & 0x3fff;
+		UINT noise = (row * 2654435761u ^ col * 40503u) >> 24;
+		return (USHORT)(hills * 3 + noise);
+	}
+
+	float Height(UINT row, UINT col)
+	{
+		return MinHeight + Quantized(row, col) * HeightStep;
+	}
+
+	// Writes the layout of TileHeightmap.cpp in the converter, with the heights
+	// above instead of a smoothed RAW file.
+	void WriteMap(UINT width, UINT height)
+	{
+		UINT tilesX = (width + TileSize - 1) / TileSize, tilesY = (height + TileSize - 1) / TileSize;
+		TiledHeightmapHeader header = {};
+		header.Magic = TiledHeightmapMagic;
+		header.Version = TiledHeightmapVersion;
+		header.Width = width;
+		header.Height = height;
+		header.TileSize = TileSize;
+		header.MinHeight = MinHeight;
+		header.HeightStep = HeightStep;
+
+		std::ofstream fout(FileName, std::ios::binary);
+		size_t tilesOffset = sizeof(header) + size_t(tilesX) * tilesY * sizeof(XMFLOAT2);
+		tilesOffset = (tilesOffset + TiledHeightmapAlignment - 1) / TiledHeightmapAlignment * TiledHeightmapAlignment;
+		fout.seekp(tilesOffset);
+
+		std::vector<XMFLOAT2> bounds;
+		std::vector<USHORT> tile(TileSize * TileSize);
+		for (UINT ty = 0; ty < tilesY; ++ty)
+		{
+			for (UINT tx = 0; tx < tilesX; ++tx)
+			{
+				// The bounds cover the cells, so the first row and column of the next tiles.
+				USHORT minQ = 65535, maxQ = 0;
+				for (UINT i = ty * TileSize; i <= (std::min)((ty + 1) * TileSize, height - 1); ++i)
+				{
+					for (UINT j = tx * TileSize; j <= (std::min)((tx + 1) * TileSize, width - 1); ++j)
+					{
+						minQ = (std::min)(minQ, Quantized(i, j));
+						maxQ = (std::max)(maxQ, Quantized(i, j));
+					}
+				}
+				bounds.push_back(XMFLOAT2(MinHeight + minQ * HeightStep, MinHeight + maxQ * HeightStep));
+
+				// Samples past the edge repeat the last one.
+				for (UINT i = 0; i < TileSize; ++i)
+					for (UINT j = 0; j < TileSize; ++j)
+						tile[i * TileSize + j] = Quantized((std::min)(ty * TileSize + i, height - 1), (std::min)(tx * TileSize + j, width - 1));
+				fout.write(reinterpret_cast<const char*>(tile.data()), tile.size() * sizeof(USHORT));
+			}
+		}
+		fout.seekp(0);
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fout.write(reinterpret_cast<const char*>(bounds.data()), bounds.size() * sizeof(XMFLOAT2));
+		if (!fout)
+			throw std::runtime_error("Can not write the heightmap");
+	}
+
+	void CheckSamples(TiledHeightmap& map, std::mt19937& random)
+	{
+		UINT width = map.GetWidth(), height = map.GetHeight();
+		std::uniform_int_distribution<UINT> row(0, height - 1), col(0, width - 1);
+		for (int n = 0; n < 100000; ++n)
+		{
+			UINT i = row(random), j = col(random);
+			DX_CHECK(map.GetSample(i, j) == Height(i, j));
+		}
+
+		std::vector<float> heights(width);
+		for (UINT i : { 0u, height / 2, height - 1, row(random) })
+		{
+			map.ReadRow(i, heights.data());
+			bool equal = true;
+			for (UINT j = 0; j < width; ++j)
+				equal = equal && heights[j] == Height(i, j);
+			DX_CHECK(equal);
+		}
+
+		// The bounds of cells [row0, row1) x [col0, col1) hold their corner samples.
+		std::uniform_int_distribution<UINT> size(1, 200);
+		for (int n = 0; n < 200; ++n)
+		{
+			UINT i0 = row(random) % (height - 1), j0 = col(random) % (width - 1);
+			UINT i1 = (std::min)(i0 + size(random), height - 1), j1 = (std::min)(j0 + size(random), width - 1);
+			XMFLOAT2 bounds = map.GetBoundsY(i0, j0, i1, j1);
+			bool inside = true;
+			for (UINT i = i0; i <= i1; ++i)
+				for (UINT j = j0; j <= j1; ++j)
+					inside = inside && Height(i, j) >= bounds.x && Height(i, j) <= bounds.y;
+			DX_CHECK(inside);
+		}
+	}
+
+	void CheckCorruptFiles()
+	{
+		TiledHeightmap map;
+		DX_CHECK(!map.Open(L"TiledHeightmapBenchmark.missing"));
+
+		// Cut off in the middle of the tiles.
+		{
+			TiledHeightmapHeader header = {};
+			header.Magic = TiledHeightmapMagic;
+			header.Version = TiledHeightmapVersion;
+			header.Width = header.Height = 1000;
+			header.TileSize = TileSize;
+			std::ofstream fout(FileName, std::ios::binary);
+			fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			std::vector<char> rest(3 * TiledHeightmapAlignment);
+			fout.write(rest.data(), rest.size());
+		}
+		bool threw = false;
+		try
+		{
+			map.Open(WideFileName);
+		}
+		catch (std::runtime_error&)
+		{
+			threw = true;
+		}
+		DX_CHECK(threw);
+
+		// Not a .tht file.
+		{
+			std::ofstream fout(FileName, std::ios::binary);
+			fout << "Not a heightmap, but long enough to hold a header.";
+		}
+		DX_CHECK(!map.Open(WideFileName));
+		DX_CHECK(!map.IsOpen());
+	}
+
+	void Benchmark(UINT width, UINT height, UINT frames)
+	{
+		DX::Test::Stopwatch stopwatch;
+		WriteMap(width, height);
+		double writeMs = stopwatch.GetMs();
+
+		TiledHeightmap map;
+		stopwatch.Restart();
+		DX_CHECK(map.Open(WideFileName));
+		double openMs = stopwatch.GetMs();
+		DX_CHECK(map.GetWidth() == width && map.GetHeight() == height && map.GetTileSize() == TileSize);
+		size_t openBytes = map.GetResidentBytes();
+		// Only the slot of every tile, not a byte per sample.
+		DX_CHECK(openBytes <= size_t((width + TileSize - 1) / TileSize) * ((height + TileSize - 1) / TileSize) * sizeof(int));
+
+		// As Terrain::LoadHeightmap sizes the cache.
+		UINT tiles = 2 * StreamRadius / TileSize + 2;
+		map.SetCacheTiles((std::max)(tiles * tiles, TiledHeightmapCacheTiles));
+		size_t cacheBytes = size_t(map.GetCacheTiles()) * TileSize * TileSize * sizeof(float);
+
+		// Diagonally across the map.
+		double worstMs = 0.0, sum = 0.0;
+		UINT lastTile = UINT_MAX;
+		stopwatch.Restart();
+		for (UINT f = 0; f < frames; ++f)
+		{
+			DX::Test::Stopwatch frame;
+			UINT row = (UINT)((double)f / frames * (height - 1)), col = (UINT)((double)f / frames * (width - 1));
+			UINT tile = (row / TileSize) * ((width + TileSize - 1) / TileSize) + col / TileSize;
+			if (tile != lastTile)
+			{
+				lastTile = tile;
+				map.Prefetch(row > StreamRadius ? row - StreamRadius : 0, col > StreamRadius ? col - StreamRadius : 0,
+					(std::min)(row + StreamRadius + 1, height), (std::min)(col + StreamRadius + 1, width));
+			}
+			for (UINT i = row > SampleRadius ? row - SampleRadius : 0; i < (std::min)(row + SampleRadius, height); ++i)
+				for (UINT j = col > SampleRadius ? col - SampleRadius : 0; j < (std::min)(col + SampleRadius, width); ++j)
+					sum += map.GetSample(i, j);
+			worstMs = (std::max)(worstMs, frame.GetMs());
+		}
+		double walkMs = stopwatch.GetMs();
+		DX_CHECK(map.GetResidentBytes() <= cacheBytes + openBytes);
+
+		std::mt19937 random(13);
+		std::uniform_int_distribution<UINT> row(0, height - 1), col(0, width - 1);
+		const UINT randomCount = 1000000;
+		stopwatch.Restart();
+		for (UINT n = 0; n < randomCount; ++n)
+			sum += map.GetSample(row(random), col(random));
+		double randomMs = stopwatch.GetMs();
+
+		std::vector<float> heights(width);
+		const UINT rowCount = 256;
+		stopwatch.Restart();
+		for (UINT n = 0; n < rowCount; ++n)
+			map.ReadRow(row(random), heights.data());
+		double rowMs = stopwatch.GetMs();
+
+		CheckSamples(map, random);
+		printf("%ux%u, %.0f MB file written in %.0f ms, opened in %.3f ms with %.1f KB resident\n",
+			width, height, (double)width * height * sizeof(USHORT) / (1 << 20), writeMs, openMs, openBytes / 1024.0);
+		printf("  walk: %.1f us/frame, worst %.2f ms, %.1f MB resident at most (%u tiles cached)\n",
+			1000.0 * walkMs / frames, worstMs, (cacheBytes + openBytes) / (1024.0 * 1024.0), map.GetCacheTiles());
+		printf("  random samples: %.1f ns each, rows: %.1f us each, checksum %g\n",
+			1e6 * randomMs / randomCount, 1000.0 * rowMs / rowCount, sum);
+		map.Close();
+		std::remove(FileName);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = DX::Test::HasArgument(argc, argv, "-quick");
+	CheckCorruptFiles();
+	if (quick)
+		Benchmark(4000, 3000, 2000);
+	else
+		Benchmark(32768, 32768, 20000);
+	std::remove(FileName);
+	return DX::Test::Result();
+}
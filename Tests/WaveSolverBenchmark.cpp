@@ -0,0 +1,197 @@
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "Common/JobSystem.h"
+#include "Components/WaveSolver.h"
+#include "TestHelpers.h"
+
+// Checks WaveSolver against the scalar scheme it replaced, bit for bit, and times
+// both on 256x256, 1024x1024 and 4096x4096 grids.
+
+using namespace DirectX;
+using namespace DXFramework;
+
+namespace
+{
+	const float SpatialStep = 0.8f;
+	const float TimeStep = 0.03f;
+	const float Speed = 3.25f;
+	const float Damping = 0.4f;
+
+	// The former Waves::Update, on whole positions.
+	class ScalarWaves
+	{
+	public:
+		ScalarWaves(UINT m, UINT n) : m_numRows(m), m_numCols(n),
+			m_prevSolution(m*n, XMFLOAT3(0.0f, 0.0f, 0.0f)), m_currSolution(m*n, XMFLOAT3(0.0f, 0.0f, 0.0f)),
+			m_normals(m*n, XMFLOAT3(0.0f, 1.0f, 0.0f))
+		{
+			float d = Damping*TimeStep + 2.0f;
+			float e = (Speed*Speed)*(TimeStep*TimeStep) / (SpatialStep*SpatialStep);
+			m_k1 = (Damping*TimeStep - 2.0f) / d;
+			m_k2 = (4.0f - 8.0f*e) / d;
+			m_k3 = (2.0f*e) / d;
+		}
+
+		void Step()
+		{
+			UINT n = m_numCols;
+			for (UINT i = 1; i < m_numRows - 1; ++i)
+			{
+				for (UINT j = 1; j < n - 1; ++j)
+				{
+					m_prevSolution[i*n + j].y =
+						m_k1*m_prevSolution[i*n + j].y +
+						m_k2*m_currSolution[i*n + j].y +
+						m_k3*(m_currSolution[(i + 1)*n + j].y +
+							m_currSolution[(i - 1)*n + j].y +
+							m_currSolution[i*n + j + 1].y +
+							m_currSolution[i*n + j - 1].y);
+				}
+			}
+			std::swap(m_prevSolution, m_currSolution);
+
+			for (UINT i = 1; i < m_numRows - 1; ++i)
+			{
+				for (UINT j = 1; j < n - 1; ++j)
+				{
+					float l = m_currSolution[i*n + j - 1].y;
+					float r = m_currSolution[i*n + j + 1].y;
+					float t = m_currSolution[(i - 1)*n + j].y;
+					float b = m_currSolution[(i + 1)*n + j].y;
+					XMFLOAT3 normal(-r + l, 2.0f*SpatialStep, b - t);
+					XMStoreFloat3(&m_normals[i*n + j], XMVector3Normalize(XMLoadFloat3(&normal)));
+				}
+			}
+		}
+
+		void Disturb(UINT i, UINT j, float magnitude)
+		{
+			float halfMag = 0.5f*magnitude;
+			m_currSolution[i*m_numCols + j].y += magnitude;
+			m_currSolution[i*m_numCols + j + 1].y += halfMag;
+			m_currSolution[i*m_numCols + j - 1].y += halfMag;
+			m_currSolution[(i + 1)*m_numCols + j].y += halfMag;
+			m_currSolution[(i - 1)*m_numCols + j].y += halfMag;
+		}
+
+		float GetHeight(UINT i)const { return m_currSolution[i].y; }
+		const XMFLOAT3& GetNormal(UINT i)const { return m_normals[i]; }
+
+	private:
+		UINT m_numRows;
+		UINT m_numCols;
+		float m_k1, m_k2, m_k3;
+		std::vector<XMFLOAT3> m_prevSolution;
+		std::vector<XMFLOAT3> m_currSolution;
+		std::vector<XMFLOAT3> m_normals;
+	};
+
+	bool RejectsGrid(UINT m, UINT n)
+	{
+		WaveSolver solver;
+		try
+		{
+			solver.Initialize(m, n, SpatialStep, TimeStep, Speed, Damping);
+		}
+		catch (const std::invalid_argument&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	bool SameBits(float a, float b) { return memcmp(&a, &b, sizeof(float)) == 0; }
+
+	void CheckSize(UINT m, UINT n, UINT steps)
+	{
+		ScalarWaves reference(m, n);
+		WaveSolver solver;
+		solver.Initialize(m, n, SpatialStep, TimeStep, Speed, Damping);
+		std::vector<WaveVertex> vertices(m*n);
+
+		std::mt19937 random(m*n);
+		UINT mismatches = 0;
+		for (UINT step = 0; step < steps; ++step)
+		{
+			if (step % 4 == 0 && m > 5 && n > 5)
+			{
+				UINT i = 2 + random() % (m - 4);
+				UINT j = 2 + random() % (n - 4);
+				float magnitude = 1.0f + (random() % 100) / 50.0f;
+				reference.Disturb(i, j, magnitude);
+				solver.Disturb(i, j, magnitude);
+			}
+			reference.Step();
+			solver.Step(vertices.data());
+
+			for (UINT k = 0; k < m*n; ++k)
+			{
+				const XMFLOAT3& normal = reference.GetNormal(k);
+				if (!SameBits(reference.GetHeight(k), solver.GetHeight(k)) ||
+					!SameBits(reference.GetHeight(k), vertices[k].Height) ||
+					!SameBits(normal.x, vertices[k].Normal.x) ||
+					!SameBits(normal.y, vertices[k].Normal.y) ||
+					!SameBits(normal.z, vertices[k].Normal.z))
+					++mismatches;
+			}
+		}
+		if (!DX_CHECK(mismatches == 0))
+			printf("%ux%u: %u vertices differ from the scalar scheme\n", m, n, mismatches);
+	}
+
+	void Benchmark(UINT size, UINT steps)
+	{
+		ScalarWaves reference(size, size);
+		WaveSolver solver;
+		solver.Initialize(size, size, SpatialStep, TimeStep, Speed, Damping);
+		std::vector<WaveVertex> vertices(size*size);
+		reference.Disturb(size / 2, size / 2, 2.0f);
+		solver.Disturb(size / 2, size / 2, 2.0f);
+
+		DX::Test::Stopwatch watch;
+		for (UINT step = 0; step < steps; ++step)
+			reference.Step();
+		double scalarMs = watch.GetMs() / steps;
+
+		watch.Restart();
+		for (UINT step = 0; step < steps; ++step)
+			solver.Step(vertices.data());
+		double solverMs = watch.GetMs() / steps;
+
+		printf("%4ux%-4u  scalar %9.3f ms/step  solver %9.3f ms/step  %5.2fx\n",
+			size, size, scalarMs, solverMs, scalarMs / solverMs);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = DX::Test::HasArgument(argc, argv, "-quick");
+	DX::JobSystem jobSystem;
+
+	// Grids without an interior vertex would leave the mapped stream unwritten.
+	DX_CHECK(RejectsGrid(2, 8));
+	DX_CHECK(RejectsGrid(8, 1));
+	DX_CHECK(RejectsGrid(0, 0));
+
+	// Odd sizes cover the scalar tails and the bands cut short.
+	const UINT sizes[][2] = { { 3, 3 }, { 34, 9 }, { 37, 45 }, { 66, 130 }, { 160, 160 } };
+	for (auto& size : sizes)
+		CheckSize(size[0], size[1], 200);
+	CheckSize(256, 256, quick ? 20 : 100);
+
+	printf("%u worker threads\n", jobSystem.GetThreadCount());
+	const UINT benchmarkSizes[] = { 256, 1024, 4096 };
+	for (UINT size : benchmarkSizes)
+	{
+		if (quick && size > 1024)
+			break;
+		UINT steps = (std::max)(8u, (quick ? 1u << 23 : 1u << 26) / (size*size));
+		Benchmark(size, steps);
+	}
+	return DX::Test::Result();
+}
@@ -0,0 +1,268 @@
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Components/X3DLoader.h"
+#include "TestHelpers.h"
+
+// Loads the bundled meshes as .x3d v1 files and as the v2 files OptimizeX3D makes
+// of them, checks that both describe the same meshes and times both, including
+// a pass over the vertices like MeshObject::Initialize makes. Checks that files
+// whose sections or subsets reach past their data are rejected.
+// Usage: X3DLoaderBenchmark meshDirectory v2Directory [-quick]
+
+using namespace DirectX;
+using namespace DXFramework;
+
+namespace
+{
+	struct Mesh
+	{
+		const char* Path;		// Under the mesh directory, without extension
+		const char* Name;		// Of the v2 file
+		bool Skinned;
+	};
+
+	const Mesh Meshes[] =
+	{
+		{ "DTiger/DTiger", "DTiger", true },
+		{ "DHellFighter/DHellFighter", "DHellFighter", true },
+		{ "DZombie/DZombie0", "DZombie0", true },
+		{ "DZombie/DZombie1", "DZombie1", true },
+		{ "Rocket/Rocket", "Rocket", false },
+	};
+
+	struct LoadedMesh
+	{
+		std::shared_ptr<const X3dFile> Source;
+		std::vector<DX::PosNormalTexTan> Vertices;
+		std::vector<DX::PosNormalTexTanSkinned> SkinnedVertices;
+		std::vector<UINT> Indices;
+		std::vector<Subset> Subsets;
+		std::vector<X3dMaterial> Materials;
+		SkinnedData SkinInfo;
+		BoundingBox Bounds;
+
+		UINT GetVertexCount()const
+		{
+			if (Source)
+				return Source->IsSkinned() ? Source->GetSkinnedVertices().size() : Source->GetVertices().size();
+			return (UINT)(Vertices.size() + SkinnedVertices.size());
+		}
+		UINT GetIndexCount()const
+		{
+			if (Source)
+				return (std::max)(Source->GetIndices().size(), Source->GetIndices16().size());
+			return (UINT)Indices.size();
+		}
+	};
+
+	std::wstring Widen(const std::string& s) { return std::wstring(s.begin(), s.end()); }
+
+	void Load(const std::string& filename, bool skinned, LoadedMesh& mesh)
+	{
+		if (skinned)
+		{
+			mesh.Source = X3DLoader::LoadX3dSkinned(Widen(filename), mesh.SkinnedVertices, mesh.Indices, mesh.Subsets, mesh.Materials, mesh.SkinInfo);
+			auto vertices = mesh.Source ? mesh.Source->GetSkinnedVertices() : X3dSpan<DX::PosNormalTexTanSkinned>(mesh.SkinnedVertices.data(), (UINT)mesh.SkinnedVertices.size());
+			BoundingBox::CreateFromPoints(mesh.Bounds, vertices.size(), &vertices[0].Pos, sizeof(DX::PosNormalTexTanSkinned));
+		}
+		else
+		{
+			mesh.Source = X3DLoader::LoadX3dStatic(Widen(filename), mesh.Vertices, mesh.Indices, mesh.Subsets, mesh.Materials);
+			auto vertices = mesh.Source ? mesh.Source->GetVertices() : X3dSpan<DX::PosNormalTexTan>(mesh.Vertices.data(), (UINT)mesh.Vertices.size());
+			BoundingBox::CreateFromPoints(mesh.Bounds, vertices.size(), &vertices[0].Pos, sizeof(DX::PosNormalTexTan));
+		}
+	}
+
+	// Best of runs, in ms.
+	double TimeLoad(const std::string& filename, bool skinned, UINT runs)
+	{
+		double best = 1e30;
+		for (UINT run = 0; run < runs; ++run)
+		{
+			DX::Test::Stopwatch watch;
+			LoadedMesh mesh;
+			Load(filename, skinned, mesh);
+			best = (std::min)(best, watch.GetMs());
+		}
+		return best;
+	}
+
+	UINT CountIndices(const std::vector<Subset>& subsets)
+	{
+		UINT count = 0;
+		for (auto& subset : subsets)
+			count += subset.IndexCount;
+		return count;
+	}
+
+	void CheckSameMesh(const Mesh& info, const LoadedMesh& v1, const LoadedMesh& v2)
+	{
+		if (!DX_CHECK(v1.Source == nullptr && v2.Source != nullptr))
+			return;
+		// The v2 geometry stays in the mapped file.
+		DX_CHECK(v2.Vertices.empty() && v2.SkinnedVertices.empty() && v2.Indices.empty());
+		DX_CHECK(v2.Source->IsSkinned() == info.Skinned);
+
+		// OptimizeX3D welds and reorders vertices and triangles, but keeps the
+		// triangles of every subset and the bounds.
+		DX_CHECK(v1.Subsets.size() == v2.Subsets.size());
+		DX_CHECK(CountIndices(v1.Subsets) == CountIndices(v2.Subsets));
+		DX_CHECK(v1.GetIndexCount() == v2.GetIndexCount());
+		DX_CHECK(v2.GetVertexCount() > 0 && v2.GetVertexCount() <= v1.GetVertexCount());
+		for (size_t i = 0; i < v1.Subsets.size() && i < v2.Subsets.size(); ++i)
+		{
+			DX_CHECK(v1.Subsets[i].MtlIndex == v2.Subsets[i].MtlIndex);
+			DX_CHECK(v1.Subsets[i].IndexCount == v2.Subsets[i].IndexCount);
+			DX_CHECK(v2.Subsets[i].IndexStart + v2.Subsets[i].IndexCount <= v2.GetIndexCount());
+		}
+		DX_CHECK(memcmp(&v1.Bounds, &v2.Bounds, sizeof(BoundingBox)) == 0);
+
+		DX_CHECK(v1.Materials.size() == v2.Materials.size());
+		for (size_t i = 0; i < v1.Materials.size() && i < v2.Materials.size(); ++i)
+		{
+			DX_CHECK(v1.Materials[i].DiffuseMap == v2.Materials[i].DiffuseMap);
+			DX_CHECK(v1.Materials[i].NormalMap == v2.Materials[i].NormalMap);
+			DX_CHECK(memcmp(&v1.Materials[i].Mat, &v2.Materials[i].Mat, sizeof(DX::Material)) == 0);
+		}
+		if (info.Skinned)
+			DX_CHECK(v1.SkinInfo.GetBoneCount() == v2.SkinInfo.GetBoneCount() && v1.SkinInfo.GetBoneCount() > 0);
+	}
+
+	// A v2 file with a single section.
+	void WriteFile(const char* filename, const X3dSection& section)
+	{
+		X3dHeader header = { X3dMagic, X3dVersion, 0, 1 };
+		std::ofstream fout(filename, std::ios::binary);
+		fout.write((const char*)&header, sizeof(header));
+		fout.write((const char*)&section, sizeof(section));
+		std::vector<char> padding(64, 0);
+		fout.write(padding.data(), padding.size());
+	}
+
+	bool OpenThrows(const char* filename)
+	{
+		try
+		{
+			X3dFile file;
+			file.Open(Widen(filename));
+			file.GetVertices();
+		}
+		catch (const std::runtime_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	// A v2 file of one material, one subset, numVertices vertices and the indices.
+	void WriteFile(const char* filename, const Subset& subset, UINT numVertices, const std::vector<UINT>& indices)
+	{
+		auto align = [](UINT offset) { return (offset + X3dSectionAlignment - 1) / X3dSectionAlignment * X3dSectionAlignment; };
+		X3dSection sections[4] =
+		{
+			{ (UINT)X3dSectionId::Materials, 1, 0, 0 },
+			{ (UINT)X3dSectionId::Subsets, 1, 0, sizeof(Subset) },
+			{ (UINT)X3dSectionId::Vertices, numVertices, 0, numVertices * (UINT)sizeof(DX::PosNormalTexTan) },
+			{ (UINT)X3dSectionId::Indices, (UINT)indices.size(), 0, (UINT)(indices.size() * sizeof(UINT)) },
+		};
+		UINT offset = sizeof(X3dHeader) + sizeof(sections);
+		for (X3dSection& section : sections)
+		{
+			section.Offset = offset;
+			offset = align(offset + section.Size);
+		}
+
+		std::vector<char> data(offset, 0);
+		X3dHeader header = { X3dMagic, X3dVersion, 0, 4 };
+		memcpy(data.data(), &header, sizeof(header));
+		memcpy(data.data() + sizeof(header), sections, sizeof(sections));
+		memcpy(data.data() + sections[1].Offset, &subset, sizeof(subset));
+		if (!indices.empty())
+			memcpy(data.data() + sections[3].Offset, indices.data(), sections[3].Size);
+		std::ofstream fout(filename, std::ios::binary);
+		fout.write(data.data(), data.size());
+	}
+
+	void CheckCorruptSections()
+	{
+		// 0x40000000 vertices of 44 bytes wrap around to 0 bytes in 32 bits.
+		X3dSection wrapped = { (UINT)X3dSectionId::Vertices, 0x40000000, 32, 0 };
+		WriteFile("WrappedSection.x3d", wrapped);
+		DX_CHECK(OpenThrows("WrappedSection.x3d"));
+
+		// The end of the section wraps around to 16.
+		X3dSection past = { (UINT)X3dSectionId::Vertices, 0, 0xFFFFFFF0, 32 };
+		WriteFile("PastSection.x3d", past);
+		DX_CHECK(OpenThrows("PastSection.x3d"));
+
+		X3dSection valid = { (UINT)X3dSectionId::Vertices, 1, 32, sizeof(DX::PosNormalTexTan) };
+		WriteFile("ValidSection.x3d", valid);
+		DX_CHECK(!OpenThrows("ValidSection.x3d"));
+	}
+
+	// Subsets are used in place, so those reaching past the file are rejected.
+	void CheckCorruptSubsets()
+	{
+		std::vector<UINT> indices = { 0, 1, 2, 1, 2, 3 };
+		Subset valid = { 0, 1, 0, 3 };
+		WriteFile("ValidSubset.x3d", valid, 4, indices);
+		DX_CHECK(!OpenThrows("ValidSubset.x3d"));
+
+		Subset pastIndices = { 0, 0, 3, 6 };
+		WriteFile("PastIndices.x3d", pastIndices, 4, indices);
+		DX_CHECK(OpenThrows("PastIndices.x3d"));
+
+		// IndexStart + IndexCount wraps around to 2.
+		Subset wrappedIndices = { 0, 0, 3, 0xFFFFFFFF };
+		WriteFile("WrappedIndices.x3d", wrappedIndices, 4, indices);
+		DX_CHECK(OpenThrows("WrappedIndices.x3d"));
+
+		// Index 3 of the second triangle is past the vertices from VertexBase 1.
+		Subset pastVertices = { 0, 1, 0, 6 };
+		WriteFile("PastVertices.x3d", pastVertices, 4, indices);
+		DX_CHECK(OpenThrows("PastVertices.x3d"));
+
+		Subset pastMaterials = { 1, 0, 0, 3 };
+		WriteFile("PastMaterials.x3d", pastMaterials, 4, indices);
+		DX_CHECK(OpenThrows("PastMaterials.x3d"));
+
+		WriteFile("NoIndices.x3d", valid, 4, std::vector<UINT>());
+		DX_CHECK(OpenThrows("NoIndices.x3d"));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		printf("Usage: X3DLoaderBenchmark meshDirectory v2Directory [-quick]\n");
+		return 1;
+	}
+	std::string meshDirectory = argv[1];
+	std::string v2Directory = argv[2];
+	UINT runs = DX::Test::HasArgument(argc, argv, "-quick") ? 3 : 20;
+
+	CheckCorruptSections();
+	CheckCorruptSubsets();
+
+	printf("%-14s %10s %10s %10s %10s\n", "Mesh", "Vertices", "v1 ms", "v2 ms", "Speedup");
+	for (const Mesh& info : Meshes)
+	{
+		std::string v1File = meshDirectory + "/" + info.Path + ".x3d";
+		std::string v2File = v2Directory + "/" + info.Name + ".x3d";
+
+		LoadedMesh v1, v2;
+		Load(v1File, info.Skinned, v1);
+		Load(v2File, info.Skinned, v2);
+		CheckSameMesh(info, v1, v2);
+
+		double v1Ms = TimeLoad(v1File, info.Skinned, runs);
+		double v2Ms = TimeLoad(v2File, info.Skinned, runs);
+		printf("%-14s %10u %10.3f %10.3f %9.1fx\n", info.Name, v1.GetVertexCount(), v1Ms, v2Ms, v1Ms / v2Ms);
+	}
+	return DX::Test::Result();
+}
@@ -0,0 +1,151 @@
+#include <DirectXMath.h>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Components/X3DLoader.h"
+#include "TestHelpers.h"
+
+// Runs OptimizeX3D on v1 static meshes of 100000 vertices and checks that every
+// subset of the v2 file it writes draws the triangles of the source. The vertices
+// of a subset in one mesh span less than 65536, but reach past it, so the subsets
+// are moved to 16 bit indices; in the other a subset spans all of them, so the mesh
+// keeps 32 bit indices.
+// Usage: X3DRoundTripTest OptimizeX3D
+
+using namespace DXFramework;
+
+namespace
+{
+	const UINT NumVertices = 100000;
+
+	// A triangle by the vertices it draws, which are told apart by their x, rotated
+	// so that the smallest comes first without changing the winding.
+	typedef std::array<int, 3> Triangle;
+
+	Triangle MakeTriangle(int a, int b, int c)
+	{
+		if (b < a && b < c)
+			return Triangle{ { b, c, a } };
+		if (c < a && c < b)
+			return Triangle{ { c, a, b } };
+		return Triangle{ { a, b, c } };
+	}
+
+	struct Mesh
+	{
+		std::vector<Subset> Subsets;
+		std::vector<UINT> Indices;
+
+		// A strip of triangles over vertices first to last, from VertexBase 0.
+		void AddSubset(UINT first, UINT last)
+		{
+			Subset subset = { 0, 0, (UINT)Indices.size(), 0 };
+			for (UINT i = first; i + 2 <= last; ++i)
+			{
+				Indices.push_back(i);
+				Indices.push_back(i + 1);
+				Indices.push_back(i + 2);
+				subset.IndexCount += 3;
+			}
+			Subsets.push_back(subset);
+		}
+	};
+
+	void WriteV1(const char* filename, const Mesh& mesh)
+	{
+		std::ofstream fout(filename, std::ios::binary);
+		int header[4] = { 1, (int)mesh.Subsets.size(), (int)NumVertices, (int)mesh.Indices.size() };
+		fout.write((const char*)header, sizeof(header));
+
+		// A material without maps.
+		float material[13] = {};
+		int effect = 0, noMap = 0;
+		fout.write((const char*)material, sizeof(material));
+		fout.write((const char*)&effect, sizeof(effect));
+		fout.write((const char*)&noMap, sizeof(noMap));
+		fout.write((const char*)&noMap, sizeof(noMap));
+
+		fout.write((const char*)mesh.Subsets.data(), mesh.Subsets.size() * sizeof(Subset));
+		for (UINT i = 0; i < NumVertices; ++i)
+		{
+			// Position, normal, tangent and texture coordinates.
+			float vertex[11] = { (float)i, (float)(i % 3), (float)(i % 2), 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+			fout.write((const char*)vertex, sizeof(vertex));
+		}
+		fout.write((const char*)mesh.Indices.data(), mesh.Indices.size() * sizeof(UINT));
+	}
+
+	template<typename Index>
+	std::vector<Triangle> Draw(const Subset& subset, X3dSpan<Index> indices, X3dSpan<DX::PosNormalTexTan> vertices)
+	{
+		std::vector<Triangle> triangles;
+		for (UINT i = subset.IndexStart; i + 2 < subset.IndexStart + subset.IndexCount; i += 3)
+		{
+			int corners[3];
+			for (UINT k = 0; k < 3; ++k)
+				corners[k] = (int)vertices[subset.VertexBase + indices[i + k]].Pos.x;
+			triangles.push_back(MakeTriangle(corners[0], corners[1], corners[2]));
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	void CheckRoundTrip(const std::string& optimizer, const char* name, const Mesh& mesh, bool use16BitIndices)
+	{
+		std::string input = std::string(name) + "V1.x3d";
+		std::string output = std::string(name) + ".x3d";
+		WriteV1(input.c_str(), mesh);
+		std::string command = "\"" + optimizer + "\" " + input + " " + output;
+		if (!DX_CHECK(std::system(command.c_str()) == 0))
+			return;
+
+		X3dFile file;
+		if (!DX_CHECK(file.Open(std::wstring(output.begin(), output.end()))))
+			return;
+		X3dSpan<Subset> subsets = file.GetSubsets();
+		X3dSpan<DX::PosNormalTexTan> vertices = file.GetVertices();
+		DX_CHECK(vertices.size() == NumVertices);
+		DX_CHECK((file.GetIndices16().size() > 0) == use16BitIndices);
+		DX_CHECK((file.GetIndices().size() > 0) == !use16BitIndices);
+		if (!DX_CHECK(subsets.size() == mesh.Subsets.size()))
+			return;
+
+		for (UINT i = 0; i < subsets.size(); ++i)
+		{
+			std::vector<Triangle> expected;
+			const Subset& source = mesh.Subsets[i];
+			for (UINT k = source.IndexStart; k < source.IndexStart + source.IndexCount; k += 3)
+				expected.push_back(MakeTriangle(mesh.Indices[k], mesh.Indices[k + 1], mesh.Indices[k + 2]));
+			std::sort(expected.begin(), expected.end());
+
+			std::vector<Triangle> drawn = use16BitIndices ?
+				Draw(subsets[i], file.GetIndices16(), vertices) : Draw(subsets[i], file.GetIndices(), vertices);
+			DX_CHECK(drawn == expected);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: X3DRoundTripTest OptimizeX3D\n");
+		return 1;
+	}
+
+	// The second subset shares vertices with the first and uses those past 65536.
+	Mesh shared;
+	shared.AddSubset(0, 59999);
+	shared.AddSubset(50000, NumVertices - 1);
+	CheckRoundTrip(argv[1], "RoundTrip16", shared, true);
+
+	// The third spans every vertex, so no subset is moved.
+	Mesh spanning = shared;
+	spanning.AddSubset(0, NumVertices - 1);
+	CheckRoundTrip(argv[1], "RoundTrip32", spanning, false);
+	return DX::Test::Result();
+}
@@ -0,0 +1,437 @@
+#include "AnimationCompressor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+#pragma region Help functions
+namespace
+{
+	const float InvSqrt2 = 0.70710678f;
+
+	// Decoded key of one bone
+	struct Pose
+	{
+		float Translation[3];
+		float Scale[3];
+		float RotationQuat[4];
+	};
+
+	unsigned short Quantize(float value, float lower, float extent)
+	{
+		if (extent <= 0.0f)
+			return 0;
+		float unit = (value - lower) / extent;
+		return (unsigned short)(min(max(unit, 0.0f), 1.0f) * 65535.0f + 0.5f);
+	}
+
+	float Dequantize(unsigned short value, float lower, float extent)
+	{
+		return lower + value * (extent / 65535.0f);
+	}
+
+	// Drops the largest component, which is made positive, and stores the other three
+	// in 15 bits each. The index of the dropped one goes into the top bits of the first two.
+	void EncodeRotation(const float q[4], unsigned short out[3])
+	{
+		int largest = 0;
+		for (int i = 1; i < 4; ++i)
+			if (fabs(q[i]) > fabs(q[largest]))
+				largest = i;
+		float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+		for (int i = 0, j = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			float unit = (q[i] * sign * InvSqrt2 + 0.5f);
+			out[j++] = (unsigned short)(min(max(unit, 0.0f), 1.0f) * 32767.0f + 0.5f);
+		}
+		out[0] |= (unsigned short)((largest >> 1) << 15);
+		out[1] |= (unsigned short)((largest & 1) << 15);
+	}
+
+	// Must match BoneAnimation's decoding in MetroGame/Components/MeshGeometry.cpp.
+	void DecodeRotation(const unsigned short in[3], float q[4])
+	{
+		int largest = ((in[0] >> 15) << 1) | (in[1] >> 15);
+		float sum = 0.0f;
+		for (int i = 0, j = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			q[i] = ((in[j++] & 0x7fff) * (2.0f / 32767.0f) - 1.0f) * InvSqrt2;
+			sum += q[i] * q[i];
+		}
+		q[largest] = sqrt(max(1.0f - sum, 0.0f));
+	}
+
+	// Same as XMQuaternionSlerp
+	void Slerp(const float q0[4], const float q1[4], float t, float q[4])
+	{
+		float cosOmega = q0[0] * q1[0] + q0[1] * q1[1] + q0[2] * q1[2] + q0[3] * q1[3];
+		float sign = cosOmega < 0.0f ? -1.0f : 1.0f;
+		cosOmega *= sign;
+
+		float w0 = 1.0f - t;
+		float w1 = t;
+		if (cosOmega < 1.0f - 0.00001f)
+		{
+			float sinOmega = sqrt(1.0f - cosOmega * cosOmega);
+			float omega = atan2(sinOmega, cosOmega);
+			w0 = sin(w0 * omega) / sinOmega;
+			w1 = sin(w1 * omega) / sinOmega;
+		}
+		w1 *= sign;
+
+		for (int i = 0; i < 4; ++i)
+			q[i] = q0[i] * w0 + q1[i] * w1;
+	}
+
+	void Interpolate(const Pose& p0, const Pose& p1, float t, Pose& p)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			p.Translation[i] = p0.Translation[i] + (p1.Translation[i] - p0.Translation[i]) * t;
+			p.Scale[i] = p0.Scale[i] + (p1.Scale[i] - p0.Scale[i]) * t;
+		}
+		Slerp(p0.RotationQuat, p1.RotationQuat, t, p.RotationQuat);
+	}
+
+	// Angle between two rotations. acos of the dot product is too coarse in float for
+	// small angles, so it is computed from the chord between the unit quaternions.
+	float RotationError(const float q0[4], const float q1[4])
+	{
+		double len0 = 0.0, len1 = 0.0, dot = 0.0;
+		for (int i = 0; i < 4; ++i)
+		{
+			len0 += (double)q0[i] * q0[i];
+			len1 += (double)q1[i] * q1[i];
+			dot += (double)q0[i] * q1[i];
+		}
+		len0 = sqrt(len0);
+		len1 = dot < 0.0 ? -sqrt(len1) : sqrt(len1);
+
+		double chord = 0.0;
+		for (int i = 0; i < 4; ++i)
+		{
+			double d = q0[i] / len0 - q1[i] / len1;
+			chord += d * d;
+		}
+		return (float)(4.0 * asin(min(sqrt(chord) * 0.5, 1.0)));
+	}
+
+	float Distance(const float a[3], const float b[3])
+	{
+		float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+		return sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+	float MaxDifference(const float a[3], const float b[3])
+	{
+		return max(max(fabs(a[0] - b[0]), fabs(a[1] - b[1])), fabs(a[2] - b[2]));
+	}
+
+	class BoneCompressor
+	{
+	public:
+		BoneCompressor(const vector<X3dKeyframe>& keys, const AnimationTolerance& tolerance, float translationTolerance)
+			: m_keys(keys), m_tolerance(tolerance), m_translationTolerance(translationTolerance)
+		{}
+
+		void Compress(string& out, BoneCompressionStats& stats);
+
+	private:
+		void FindConstantTracks();
+		void QuantizeKeys();
+		bool SegmentFits(size_t a, size_t b)const;
+		void Reduce();
+		void Sample(float time, Pose& pose)const;
+		void Write(string& out)const;
+		void Measure(BoneCompressionStats& stats)const;
+
+	private:
+		const vector<X3dKeyframe>& m_keys;
+		const AnimationTolerance& m_tolerance;
+		float m_translationTolerance;
+
+		X3dCompressedBone m_header;
+		vector<unsigned short> m_times;
+		vector<unsigned short> m_rotations;
+		vector<unsigned short> m_translations;
+		vector<unsigned short> m_scales;
+		vector<Pose> m_decoded;		// What the engine gets back for every source key
+		vector<size_t> m_kept;		// Source keys which are written
+	};
+
+	void BoneCompressor::Compress(string& out, BoneCompressionStats& stats)
+	{
+		memset(&m_header, 0, sizeof(X3dCompressedBone));
+		m_header.StartTime = m_keys.front().TimePos;
+		m_header.Duration = m_keys.back().TimePos - m_keys.front().TimePos;
+
+		FindConstantTracks();
+		QuantizeKeys();
+		Reduce();
+
+		size_t start = out.size();
+		Write(out);
+		Measure(stats);
+		stats.CompressedBytes = out.size() - start;
+	}
+
+	void BoneCompressor::FindConstantTracks()
+	{
+		const X3dKeyframe& first = m_keys.front();
+		bool constantRotation = true, constantTranslation = true, constantScale = true;
+		for (auto& key : m_keys)
+		{
+			constantRotation = constantRotation && RotationError(key.RotationQuat, first.RotationQuat) <= m_tolerance.Rotation;
+			constantTranslation = constantTranslation && Distance(key.Translation, first.Translation) <= m_translationTolerance;
+			constantScale = constantScale && MaxDifference(key.Scale, first.Scale) <= m_tolerance.Scale;
+		}
+		m_header.Flags = (constantRotation ? X3dConstantRotation : 0) |
+			(constantTranslation ? X3dConstantTranslation : 0) |
+			(constantScale ? X3dConstantScale : 0);
+
+		// Constant tracks keep the first value exactly, animated ones their bounds.
+		for (int i = 0; i < 3; ++i)
+		{
+			float tMin = first.Translation[i], tMax = first.Translation[i];
+			float sMin = first.Scale[i], sMax = first.Scale[i];
+			if (!constantTranslation || !constantScale)
+			{
+				for (auto& key : m_keys)
+				{
+					tMin = min(tMin, key.Translation[i]);
+					tMax = max(tMax, key.Translation[i]);
+					sMin = min(sMin, key.Scale[i]);
+					sMax = max(sMax, key.Scale[i]);
+				}
+			}
+			m_header.TranslationMin[i] = constantTranslation ? first.Translation[i] : tMin;
+			m_header.TranslationExtent[i] = constantTranslation ? 0.0f : tMax - tMin;
+			m_header.ScaleMin[i] = constantScale ? first.Scale[i] : sMin;
+			m_header.ScaleExtent[i] = constantScale ? 0.0f : sMax - sMin;
+		}
+	}
+
+	void BoneCompressor::QuantizeKeys()
+	{
+		size_t keyCount = m_keys.size();
+		m_times.resize(keyCount);
+		m_rotations.resize(keyCount * 3);
+		m_translations.resize(keyCount * 3);
+		m_scales.resize(keyCount * 3);
+		m_decoded.resize(keyCount);
+
+		for (size_t k = 0; k < keyCount; ++k)
+		{
+			const X3dKeyframe& key = m_keys[(m_header.Flags & X3dConstantRotation) ? 0 : k];
+			m_times[k] = Quantize(m_keys[k].TimePos, m_header.StartTime, m_header.Duration);
+
+			float q[4];
+			float length = sqrt(key.RotationQuat[0] * key.RotationQuat[0] + key.RotationQuat[1] * key.RotationQuat[1] +
+				key.RotationQuat[2] * key.RotationQuat[2] + key.RotationQuat[3] * key.RotationQuat[3]);
+			for (int i = 0; i < 4; ++i)
+				q[i] = key.RotationQuat[i] / length;
+			EncodeRotation(q, &m_rotations[k * 3]);
+			DecodeRotation(&m_rotations[k * 3], m_decoded[k].RotationQuat);
+
+			for (int i = 0; i < 3; ++i)
+			{
+				m_translations[k * 3 + i] = Quantize(m_keys[k].Translation[i], m_header.TranslationMin[i], m_header.TranslationExtent[i]);
+				m_scales[k * 3 + i] = Quantize(m_keys[k].Scale[i], m_header.ScaleMin[i], m_header.ScaleExtent[i]);
+				m_decoded[k].Translation[i] = Dequantize(m_translations[k * 3 + i], m_header.TranslationMin[i], m_header.TranslationExtent[i]);
+				m_decoded[k].Scale[i] = Dequantize(m_scales[k * 3 + i], m_header.ScaleMin[i], m_header.ScaleExtent[i]);
+			}
+		}
+	}
+
+	// Whether the keys between a and b are within the tolerance when they are
+	// interpolated from the quantized a and b. Constant tracks were checked already.
+	bool BoneCompressor::SegmentFits(size_t a, size_t b)const
+	{
+		float span = (float)(m_times[b] - m_times[a]);
+		for (size_t k = a + 1; k < b; ++k)
+		{
+			Pose pose;
+			Interpolate(m_decoded[a], m_decoded[b], (m_times[k] - m_times[a]) / span, pose);
+
+			const X3dKeyframe& key = m_keys[k];
+			if (!(m_header.Flags & X3dConstantRotation) && RotationError(pose.RotationQuat, key.RotationQuat) > m_tolerance.Rotation)
+				return false;
+			if (!(m_header.Flags & X3dConstantTranslation) && Distance(pose.Translation, key.Translation) > m_translationTolerance)
+				return false;
+			if (!(m_header.Flags & X3dConstantScale) && MaxDifference(pose.Scale, key.Scale) > m_tolerance.Scale)
+				return false;
+		}
+		return true;
+	}
+
+	// Greedy: every segment is extended as long as the keys it skips still fit.
+	void BoneCompressor::Reduce()
+	{
+		const unsigned int allConstant = X3dConstantRotation | X3dConstantTranslation | X3dConstantScale;
+
+		m_kept.clear();
+		m_kept.push_back(0);
+		if ((m_header.Flags & allConstant) == allConstant)
+			return;
+
+		size_t last = m_keys.size() - 1;
+		size_t a = 0;
+		while (a < last)
+		{
+			// Keys which quantize to the time of a can't be told apart from it.
+			size_t b = a + 1;
+			while (b < last && m_times[b] == m_times[a])
+				++b;
+			if (m_times[b] == m_times[a])
+				break;
+			while (b < last && SegmentFits(a, b + 1))
+				++b;
+			m_kept.push_back(b);
+			a = b;
+		}
+	}
+
+	// Samples the kept keys the way BoneAnimation does.
+	void BoneCompressor::Sample(float time, Pose& pose)const
+	{
+		float unit = m_header.Duration > 0.0f ? (time - m_header.StartTime) * (65535.0f / m_header.Duration) : 0.0f;
+		size_t first = m_kept.front(), last = m_kept.back();
+		if (unit <= m_times[first])
+			pose = m_decoded[first];
+		else if (unit >= m_times[last])
+			pose = m_decoded[last];
+		else
+		{
+			size_t i = 0;
+			while (unit > m_times[m_kept[i + 1]])
+				++i;
+			size_t k0 = m_kept[i], k1 = m_kept[i + 1];
+			Interpolate(m_decoded[k0], m_decoded[k1], (unit - m_times[k0]) / (m_times[k1] - m_times[k0]), pose);
+		}
+
+		// Constant tracks always decode to the first key.
+		if (m_header.Flags & X3dConstantRotation)
+			memcpy(pose.RotationQuat, m_decoded[0].RotationQuat, sizeof(pose.RotationQuat));
+	}
+
+	void BoneCompressor::Write(string& out)const
+	{
+		X3dCompressedBone header = m_header;
+		header.KeyCount = m_kept.size();
+
+		vector<unsigned short> data;
+		for (auto k : m_kept)
+			data.push_back(m_times[k]);
+		for (size_t i = 0; i < ((header.Flags & X3dConstantRotation) ? 1 : m_kept.size()); ++i)
+			data.insert(data.end(), &m_rotations[m_kept[i] * 3], &m_rotations[m_kept[i] * 3] + 3);
+		if (!(header.Flags & X3dConstantTranslation))
+			for (auto k : m_kept)
+				data.insert(data.end(), &m_translations[k * 3], &m_translations[k * 3] + 3);
+		if (!(header.Flags & X3dConstantScale))
+			for (auto k : m_kept)
+				data.insert(data.end(), &m_scales[k * 3], &m_scales[k * 3] + 3);
+
+		out.append((char*)&header, sizeof(X3dCompressedBone));
+		out.append((char*)data.data(), data.size() * sizeof(unsigned short));
+	}
+
+	void BoneCompressor::Measure(BoneCompressionStats& stats)const
+	{
+		stats.KeyCount = m_keys.size();
+		stats.CompressedKeyCount = m_kept.size();
+		stats.RawBytes = sizeof(int) + m_keys.size() * sizeof(X3dKeyframe);
+		stats.ConstantTracks = m_header.Flags;
+
+		for (auto& key : m_keys)
+		{
+			Pose pose;
+			Sample(key.TimePos, pose);
+			stats.MaxRotationError = max(stats.MaxRotationError, RotationError(pose.RotationQuat, key.RotationQuat));
+			stats.MaxTranslationError = max(stats.MaxTranslationError, Distance(pose.Translation, key.Translation));
+			stats.MaxScaleError = max(stats.MaxScaleError, MaxDifference(pose.Scale, key.Scale));
+		}
+	}
+}
+#pragma endregion
+
+void CompressAnimationClip(const string& name, const vector<vector<X3dKeyframe>>& bones,
+	const AnimationTolerance& tolerance, string& out, vector<BoneCompressionStats>* stats)
+{
+	// The translation tolerance scales with the size of the animated skeleton.
+	float lower[3] = { 0.0f, 0.0f, 0.0f }, upper[3] = { 0.0f, 0.0f, 0.0f };
+	bool empty = true;
+	for (auto& bone : bones)
+	{
+		for (auto& key : bone)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				lower[i] = empty ? key.Translation[i] : min(lower[i], key.Translation[i]);
+				upper[i] = empty ? key.Translation[i] : max(upper[i], key.Translation[i]);
+			}
+			empty = false;
+		}
+	}
+	float translationTolerance = tolerance.Translation * Distance(lower, upper);
+
+	int nameLength = name.length();
+	out.append((char*)&nameLength, sizeof(int));
+	out.append(name);
+
+	if (stats)
+		stats->assign(bones.size(), BoneCompressionStats());
+	for (size_t i = 0; i < bones.size(); ++i)
+	{
+		// A bone without keys gets the identity, like the engine's default keyframe.
+		vector<X3dKeyframe> identity;
+		const vector<X3dKeyframe>* keys = &bones[i];
+		if (keys->empty())
+		{
+			X3dKeyframe key = { 0.0f, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } };
+			identity.push_back(key);
+			keys = &identity;
+		}
+
+		BoneCompressionStats boneStats;
+		BoneCompressor(*keys, tolerance, translationTolerance).Compress(out, boneStats);
+		if (stats)
+			(*stats)[i] = boneStats;
+	}
+}
+
+void PrintClipStats(ostream& out, const string& name, const vector<BoneCompressionStats>& stats)
+{
+	int keyCount = 0, compressedKeyCount = 0, rawBytes = 0, compressedBytes = 0;
+	float maxRotationError = 0.0f, maxTranslationError = 0.0f;
+	for (auto& bone : stats)
+	{
+		keyCount += bone.KeyCount;
+		compressedKeyCount += bone.CompressedKeyCount;
+		rawBytes += bone.RawBytes;
+		compressedBytes += bone.CompressedBytes;
+		maxRotationError = max(maxRotationError, bone.MaxRotationError);
+		maxTranslationError = max(maxTranslationError, bone.MaxTranslationError);
+	}
+
+	const float toDegrees = 57.2957795f;
+	out << "Clip " << name << ": " << keyCount << " -> " << compressedKeyCount << " keys, "
+		<< rawBytes << " -> " << compressedBytes << " bytes ("
+		<< (compressedBytes ? (float)rawBytes / compressedBytes : 0.0f) << "x), max error "
+		<< maxRotationError * toDegrees << " deg, " << maxTranslationError << endl;
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		const BoneCompressionStats& bone = stats[i];
+		out << "  Bone" << i << ": " << bone.KeyCount << " -> " << bone.CompressedKeyCount << " keys,"
+			<< ((bone.ConstantTracks & X3dConstantRotation) ? " constant R" : "")
+			<< ((bone.ConstantTracks & X3dConstantTranslation) ? " constant T" : "")
+			<< ((bone.ConstantTracks & X3dConstantScale) ? " constant S" : "")
+			<< " max error " << bone.MaxRotationError * toDegrees << " deg, "
+			<< bone.MaxTranslationError << ", " << bone.MaxScaleError << endl;
+	}
+}
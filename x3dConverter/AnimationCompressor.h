@@ -0,0 +1,51 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "X3dFormat.h"
+
+// Offline animation clip compression shared by the converter modules and the
+// standalone x3d optimizer. Every bone is encoded in the X3dCompressedClips layout:
+// tracks which don't move are stored once, the keys which can be interpolated
+// from their neighbours within the tolerance are dropped, rotations are stored as
+// smallest three quaternions and times, translations and scales are quantized
+// to 16 bits. The tolerances are checked against the quantized values, the way
+// the engine samples them. Source keys closer than Duration / 65535 to each other
+// share one quantized time, so long clips with near discontinuities may exceed the
+// tolerance around them; the reported errors include that.
+
+struct AnimationTolerance
+{
+	AnimationTolerance() : Rotation(0.002f), Translation(0.0005f), Scale(0.0001f)
+	{}
+
+	float Rotation;		// Radians
+	float Translation;	// Relative to the extent of all translations of the clip
+	float Scale;
+};
+
+struct BoneCompressionStats
+{
+	BoneCompressionStats() : KeyCount(0), CompressedKeyCount(0), RawBytes(0), CompressedBytes(0),
+		ConstantTracks(0), MaxRotationError(0.0f), MaxTranslationError(0.0f), MaxScaleError(0.0f)
+	{}
+
+	int KeyCount;
+	int CompressedKeyCount;
+	int RawBytes;
+	int CompressedBytes;
+	unsigned int ConstantTracks;	// X3dConstant* flags
+	// Measured at every source keyframe
+	float MaxRotationError;			// Radians
+	float MaxTranslationError;
+	float MaxScaleError;
+};
+
+// Encodes one clip in the X3dCompressedClips layout and appends it to out.
+// bones[i] holds the keyframes of bone i in time order.
+void CompressAnimationClip(const std::string& name, const std::vector<std::vector<X3dKeyframe>>& bones,
+	const AnimationTolerance& tolerance, std::string& out, std::vector<BoneCompressionStats>* stats = nullptr);
+
+// Prints the size of the clip before and after and the max error of every bone.
+void PrintClipStats(std::ostream& out, const std::string& name, const std::vector<BoneCompressionStats>& stats);
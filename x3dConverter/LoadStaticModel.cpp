@@ -9,6 +9,8 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include "X3dFormat.h"
+#include "MeshOptimizer.h"
 
 using namespace std;
 using namespace DirectX;
@@ -208,6 +210,12 @@ int main()
 
 	PackVI();
 
+	cout << "Optimize data ..." << endl;
+	MeshStats before, after;
+	OptimizeMesh(Vertices, Indices, Subsets, &before, &after);
+	cout << "Before: " << before.VertexCount << " vertices, ACMR " << before.ACMR() << ", ATVR " << before.ATVR() << endl;
+	cout << "After: " << after.VertexCount << " vertices, ACMR " << after.ACMR() << ", ATVR " << after.ATVR() << endl;
+
 	cout << "Write data ..." << endl;
 	WriteX3DText();
 	WriteX3DBinary();
@@ -949,65 +957,67 @@ void WriteX3DText()
 	fout.close();
 }
 
-// Binary output
+// Binary output (.x3d v2)
+// Every section is encoded in memory first, so the offset table can be written up front.
 void WriteX3DBinary()
 {
-	ofstream fout("resBinary.x3d", ios::binary);
-	int intTemp;
+	if (Indices.size() % 3 != 0)
+		throw new exception("Lack indices data!");
 
-	// File header
-	intTemp = Materials.size();
-	fout.write((char*)&intTemp, sizeof(int));
-	intTemp = Subsets.size();
-	fout.write((char*)&intTemp, sizeof(int));
-	intTemp = Vertices.size();
-	fout.write((char*)&intTemp, sizeof(int));
-	intTemp = Indices.size();
-	fout.write((char*)&intTemp, sizeof(int));
+	vector<X3dSection> table;
+	vector<string> data;
+	int intTemp;
 
 	// Material
+	ostringstream materials(ios::binary);
 	for (auto& item : Materials)
 	{
-		fout.write((char*)&item.Ambient, sizeof(XMFLOAT3));
-		fout.write((char*)&item.Diffuse, sizeof(XMFLOAT3));
-		fout.write((char*)&item.Specular, sizeof(XMFLOAT3));
-		fout.write((char*)&item.SpecPower, sizeof(float));
-		fout.write((char*)&item.Reflectivity, sizeof(XMFLOAT3));
+		materials.write((char*)&item.Ambient, sizeof(XMFLOAT3));
+		materials.write((char*)&item.Diffuse, sizeof(XMFLOAT3));
+		materials.write((char*)&item.Specular, sizeof(XMFLOAT3));
+		materials.write((char*)&item.SpecPower, sizeof(float));
+		materials.write((char*)&item.Reflectivity, sizeof(XMFLOAT3));
 		intTemp = (int)item.Effect;
-		fout.write((char*)&intTemp, sizeof(int));
+		materials.write((char*)&intTemp, sizeof(int));
 		intTemp = item.DiffuseMap.length();
-		fout.write((char*)&intTemp, sizeof(int));
-		fout.write(item.DiffuseMap.c_str(), intTemp);
+		materials.write((char*)&intTemp, sizeof(int));
+		materials.write(item.DiffuseMap.c_str(), intTemp);
 		intTemp = item.NormalMap.length();
-		fout.write((char*)&intTemp, sizeof(int));
-		fout.write(item.NormalMap.c_str(), intTemp);
+		materials.write((char*)&intTemp, sizeof(int));
+		materials.write(item.NormalMap.c_str(), intTemp);
 	}
+	table.push_back({ X3dMaterials, (unsigned int)Materials.size(), 0, 0 });
+	data.push_back(materials.str());
 
-	// SubSets
-	for (auto& item : Subsets)
-	{
-		fout.write((char*)&item.MtlIndex, sizeof(int));
-		fout.write((char*)&item.VertexBase, sizeof(int));
-		fout.write((char*)&item.IndexStart, sizeof(int));
-		fout.write((char*)&item.IndexCount, sizeof(int));
-	}
+	// SubSets, after deciding the index format, which may move them
+	bool use16BitIndices = Use16BitIndices(Subsets, Indices);
+	table.push_back({ X3dSubsets, (unsigned int)Subsets.size(), 0, 0 });
+	data.push_back(string((char*)Subsets.data(), Subsets.size() * sizeof(Subset)));
 
-	// Vertices
+	// Vertices, in the engine's PosNormalTexTan order
+	ostringstream vertices(ios::binary);
 	for (auto& item : Vertices)
 	{
-		fout.write((char*)&item.Position, sizeof(XMFLOAT3));
-		fout.write((char*)&item.Normal, sizeof(XMFLOAT3));
-		fout.write((char*)&item.Tangent, sizeof(XMFLOAT3));
-		fout.write((char*)&item.TexUV, sizeof(XMFLOAT2));
+		vertices.write((char*)&item.Position, sizeof(XMFLOAT3));
+		vertices.write((char*)&item.Normal, sizeof(XMFLOAT3));
+		vertices.write((char*)&item.TexUV, sizeof(XMFLOAT2));
+		vertices.write((char*)&item.Tangent, sizeof(XMFLOAT3));
 	}
+	table.push_back({ X3dVertices, (unsigned int)Vertices.size(), 0, 0 });
+	data.push_back(vertices.str());
 
-	// Indices
-	if (Indices.size() % 3 != 0)
-		throw new exception("Lack indices data!");
-	for (auto& item : Indices)
+	// Indices, 16 bit if every vertex range allows it
+	if (use16BitIndices)
 	{
-		fout.write((char*)&item, sizeof(int));
+		vector<unsigned short> indices16(Indices.begin(), Indices.end());
+		table.push_back({ X3dIndices16, (unsigned int)indices16.size(), 0, 0 });
+		data.push_back(string((char*)indices16.data(), indices16.size() * sizeof(unsigned short)));
 	}
-	fout.flush();
-	fout.close();
+	else
+	{
+		table.push_back({ X3dIndices, (unsigned int)Indices.size(), 0, 0 });
+		data.push_back(string((char*)Indices.data(), Indices.size() * sizeof(int)));
+	}
+
+	WriteX3DSections("resBinary.x3d", 0, table, data);
 }
@@ -0,0 +1,234 @@
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace std;
+
+#pragma region Help functions
+namespace
+{
+	// FNV-1a over the raw vertex bytes.
+	struct VertexKey
+	{
+		const unsigned char* Data;
+		size_t Size;
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key)const
+		{
+			unsigned int hash = 2166136261u;
+			for (size_t i = 0; i < key.Size; ++i)
+			{
+				hash ^= key.Data[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+	};
+
+	struct VertexKeyEqual
+	{
+		bool operator()(const VertexKey& a, const VertexKey& b)const
+		{
+			return a.Size == b.Size && memcmp(a.Data, b.Data, a.Size) == 0;
+		}
+	};
+
+	// Scoring constants from Forsyth's paper.
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	float VertexScore(int cachePosition, int remainingValence)
+	{
+		// No triangle needs this vertex anymore
+		if (remainingValence == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			// The vertices of the last triangle get a fixed score, so the next
+			// triangle doesn't simply reuse the same edge.
+			if (cachePosition < 3)
+				score = LastTriScore;
+			else
+			{
+				float scaler = 1.0f / (VertexCacheSize - 3);
+				score = powf(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+			}
+		}
+
+		// Boost vertices with few triangles left, so lone triangles get finished.
+		score += ValenceBoostScale * powf((float)remainingValence, -ValenceBoostPower);
+		return score;
+	}
+}
+#pragma endregion
+
+int BuildWeldRemap(const void* vertices, size_t stride, int vertexCount, vector<int>& remap)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+	unordered_map<VertexKey, int, VertexKeyHash, VertexKeyEqual> unique(vertexCount);
+
+	remap.resize(vertexCount);
+	int uniqueCount = 0;
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		VertexKey key = { bytes + i * stride, stride };
+		auto result = unique.insert(make_pair(key, uniqueCount));
+		if (result.second)
+			++uniqueCount;
+		remap[i] = result.first->second;
+	}
+	return uniqueCount;
+}
+
+void OptimizeVertexCache(int* indices, int indexCount, int vertexCount)
+{
+	int triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	// Triangles adjacent to each vertex. The first Remaining[v] entries of a
+	// vertex's list are the triangles which haven't been emitted yet.
+	vector<int> adjacencyStart(vertexCount + 1, 0);
+	for (int i = 0; i < indexCount; ++i)
+		++adjacencyStart[indices[i] + 1];
+	for (int v = 0; v < vertexCount; ++v)
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	vector<int> adjacency(indexCount);
+	vector<int> remaining(vertexCount, 0);
+	for (int i = 0; i < indexCount; ++i)
+	{
+		int v = indices[i];
+		adjacency[adjacencyStart[v] + remaining[v]++] = i / 3;
+	}
+
+	vector<float> vertexScore(vertexCount);
+	for (int v = 0; v < vertexCount; ++v)
+		vertexScore[v] = VertexScore(-1, remaining[v]);
+
+	vector<float> triangleScore(triangleCount);
+	vector<bool> emitted(triangleCount, false);
+	int bestTriangle = 0;
+	for (int t = 0; t < triangleCount; ++t)
+	{
+		triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+		if (triangleScore[t] > triangleScore[bestTriangle])
+			bestTriangle = t;
+	}
+
+	vector<int> cache, newCache;
+	cache.reserve(VertexCacheSize + 3);
+	newCache.reserve(VertexCacheSize + 3);
+	vector<int> result;
+	result.reserve(indexCount);
+	int nextUnemitted = 0;
+
+	for (int n = 0; n < triangleCount; ++n)
+	{
+		// Nothing left in the cache: fall back to the next unemitted triangle.
+		if (bestTriangle < 0)
+		{
+			while (emitted[nextUnemitted])
+				++nextUnemitted;
+			bestTriangle = nextUnemitted;
+		}
+
+		const int* tri = &indices[3 * bestTriangle];
+		emitted[bestTriangle] = true;
+		result.insert(result.end(), tri, tri + 3);
+
+		// Remove the triangle from the pending lists of its vertices.
+		for (int k = 0; k < 3; ++k)
+		{
+			int v = tri[k];
+			int* list = &adjacency[adjacencyStart[v]];
+			for (int i = 0; i < remaining[v]; ++i)
+			{
+				if (list[i] == bestTriangle)
+				{
+					list[i] = list[--remaining[v]];
+					break;
+				}
+			}
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache.
+		newCache.assign(tri, tri + 3);
+		for (int v : cache)
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache.push_back(v);
+		for (size_t i = VertexCacheSize; i < newCache.size(); ++i)
+		{
+			int v = newCache[i];
+			vertexScore[v] = VertexScore(-1, remaining[v]);
+		}
+		if (newCache.size() > (size_t)VertexCacheSize)
+			newCache.resize(VertexCacheSize);
+		cache.swap(newCache);
+
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			int v = cache[i];
+			vertexScore[v] = VertexScore(i, remaining[v]);
+		}
+
+		// Rescore the triangles touching the cache and pick the best one.
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int v : cache)
+		{
+			const int* list = &adjacency[adjacencyStart[v]];
+			for (int i = 0; i < remaining[v]; ++i)
+			{
+				int t = list[i];
+				const int* tv = &indices[3 * t];
+				triangleScore[t] = vertexScore[tv[0]] + vertexScore[tv[1]] + vertexScore[tv[2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	memcpy(indices, result.data(), sizeof(int) * indexCount);
+}
+
+int BuildFirstUseRemap(const int* indices, int indexCount, int vertexCount, vector<int>& remap)
+{
+	remap.assign(vertexCount, -1);
+	int usedCount = 0;
+	for (int i = 0; i < indexCount; ++i)
+	{
+		if (remap[indices[i]] < 0)
+			remap[indices[i]] = usedCount++;
+	}
+	return usedCount;
+}
+
+void AccumulateStats(const int* indices, int indexCount, int vertexCount, MeshStats& stats)
+{
+	// A vertex is still in the FIFO if fewer than VertexCacheSize misses happened
+	// since it was loaded.
+	vector<int> loadedAt(vertexCount, -1);
+	int misses = 0;
+	for (int i = 0; i < indexCount; ++i)
+	{
+		int v = indices[i];
+		if (loadedAt[v] < 0 || misses - loadedAt[v] >= VertexCacheSize)
+		{
+			loadedAt[v] = misses;
+			++misses;
+		}
+	}
+	stats.CacheMisses += misses;
+	stats.TriangleCount += indexCount / 3;
+}
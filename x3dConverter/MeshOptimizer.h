@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+// Offline mesh optimizations shared by the converter modules and the standalone
+// x3d optimizer. Everything works on index lists and remap tables, so the vertex
+// type stays with the caller; it only has to be a plain struct without padding,
+// because duplicates are found by comparing bytes.
+//
+// Subsets with the same VertexBase share one vertex range. Vertices are welded
+// and reordered per range, triangles are reordered per subset.
+
+const int VertexCacheSize = 32;
+
+struct MeshStats
+{
+	MeshStats() : VertexCount(0), TriangleCount(0), CacheMisses(0)
+	{}
+
+	int VertexCount;
+	int TriangleCount;
+	int CacheMisses;
+
+	// Average cache miss ratio: transformed vertices per triangle. 0.5 is the optimum.
+	float ACMR()const { return TriangleCount ? (float)CacheMisses / TriangleCount : 0.0f; }
+	// Average transform to vertex ratio: how often each vertex is transformed. 1.0 is the optimum.
+	float ATVR()const { return VertexCount ? (float)CacheMisses / VertexCount : 0.0f; }
+};
+
+// Builds remap[old] = new so that byte-identical vertices share one slot.
+// New slots keep first occurrence order. Returns the number of unique vertices.
+int BuildWeldRemap(const void* vertices, size_t stride, int vertexCount, std::vector<int>& remap);
+
+// Reorders the triangles of one draw call for the post-transform vertex cache,
+// using Tom Forsyth's linear-speed vertex cache optimization.
+void OptimizeVertexCache(int* indices, int indexCount, int vertexCount);
+
+// Builds remap[old] = new in the order the vertices are first referenced, so the
+// vertex fetch walks the buffer forward. Unreferenced vertices map to -1.
+// Returns the number of referenced vertices.
+int BuildFirstUseRemap(const int* indices, int indexCount, int vertexCount, std::vector<int>& remap);
+
+// Accumulates the misses of a FIFO cache of VertexCacheSize entries for one draw call.
+void AccumulateStats(const int* indices, int indexCount, int vertexCount, MeshStats& stats);
+
+// Applies remap to a vertex array, dropping vertices which map to -1.
+template<typename T>
+void RemapVertices(std::vector<T>& vertices, const std::vector<int>& remap, int newCount)
+{
+	std::vector<T> result(newCount);
+	for (size_t i = 0; i < remap.size(); ++i)
+		if (remap[i] >= 0)
+			result[remap[i]] = vertices[i];
+	vertices.swap(result);
+}
+
+// Welds duplicate vertices, reorders every subset for the vertex cache and puts the
+// vertices of every range in first-use order. SubsetT needs the VertexBase,
+// IndexStart and IndexCount members of the x3d Subset.
+template<typename VertexT, typename SubsetT>
+void OptimizeMesh(std::vector<VertexT>& vertices, std::vector<int>& indices, std::vector<SubsetT>& subsets,
+	MeshStats* before = nullptr, MeshStats* after = nullptr)
+{
+	// Sort the distinct vertex bases to find the ranges.
+	std::vector<int> bases;
+	for (auto& subset : subsets)
+		bases.push_back(subset.VertexBase);
+	std::sort(bases.begin(), bases.end());
+	bases.erase(std::unique(bases.begin(), bases.end()), bases.end());
+
+	std::vector<VertexT> result;
+	std::vector<int> newBases(bases.size());
+	for (size_t r = 0; r < bases.size(); ++r)
+	{
+		int rangeStart = bases[r];
+		int rangeEnd = r + 1 < bases.size() ? bases[r + 1] : (int)vertices.size();
+		int rangeCount = rangeEnd - rangeStart;
+
+		std::vector<SubsetT*> rangeSubsets;
+		for (auto& subset : subsets)
+			if (subset.VertexBase == rangeStart)
+				rangeSubsets.push_back(&subset);
+
+		if (before)
+		{
+			before->VertexCount += rangeCount;
+			for (auto subset : rangeSubsets)
+				AccumulateStats(&indices[subset->IndexStart], subset->IndexCount, rangeCount, *before);
+		}
+
+		// Weld exact duplicates
+		std::vector<VertexT> rangeVertices(vertices.begin() + rangeStart, vertices.begin() + rangeEnd);
+		std::vector<int> remap;
+		int uniqueCount = BuildWeldRemap(rangeVertices.data(), sizeof(VertexT), rangeCount, remap);
+		for (auto subset : rangeSubsets)
+			for (int i = subset->IndexStart; i < subset->IndexStart + subset->IndexCount; ++i)
+				indices[i] = remap[indices[i]];
+		RemapVertices(rangeVertices, remap, uniqueCount);
+
+		// Reorder triangles per draw call
+		for (auto subset : rangeSubsets)
+			OptimizeVertexCache(&indices[subset->IndexStart], subset->IndexCount, uniqueCount);
+
+		// Reorder vertices to first use over all subsets of the range
+		std::vector<int> rangeIndices;
+		for (auto subset : rangeSubsets)
+			rangeIndices.insert(rangeIndices.end(), indices.begin() + subset->IndexStart,
+				indices.begin() + subset->IndexStart + subset->IndexCount);
+		int usedCount = BuildFirstUseRemap(rangeIndices.data(), rangeIndices.size(), uniqueCount, remap);
+		for (auto subset : rangeSubsets)
+			for (int i = subset->IndexStart; i < subset->IndexStart + subset->IndexCount; ++i)
+				indices[i] = remap[indices[i]];
+		RemapVertices(rangeVertices, remap, usedCount);
+
+		if (after)
+		{
+			after->VertexCount += usedCount;
+			for (auto subset : rangeSubsets)
+				AccumulateStats(&indices[subset->IndexStart], subset->IndexCount, usedCount, *after);
+		}
+
+		newBases[r] = result.size();
+		result.insert(result.end(), rangeVertices.begin(), rangeVertices.end());
+	}
+
+	for (auto& subset : subsets)
+		subset.VertexBase = newBases[std::lower_bound(bases.begin(), bases.end(), subset.VertexBase) - bases.begin()];
+	vertices.swap(result);
+}
+
+// Decides per subset whether its indices fit in 16 bits, which they do if the
+// vertices it uses span at most 65536. Subsets that don't fit as they are get
+// moved up to the first vertex they use: VertexBase is raised and their indices
+// lowered by the same amount, so a vertex range larger than 65536 shared by
+// several subsets doesn't need 32 bit indices. The mesh has a single index
+// buffer and format, so 16 bit indices are used if every subset fits; only then
+// are subsets moved, and otherwise subsets and indices are left as they were.
+// Write the subsets after calling it.
+template<typename SubsetT>
+bool Use16BitIndices(std::vector<SubsetT>& subsets, std::vector<int>& indices)
+{
+	std::vector<int> lowest(subsets.size(), 0);
+	for (size_t i = 0; i < subsets.size(); ++i)
+	{
+		const auto& subset = subsets[i];
+		if (subset.IndexCount == 0)
+			continue;
+		auto first = indices.begin() + subset.IndexStart;
+		auto range = std::minmax_element(first, first + subset.IndexCount);
+		if (*range.second < 65536)
+			continue;
+		if (*range.second - *range.first >= 65536)
+			return false;
+		lowest[i] = *range.first;
+	}
+
+	for (size_t i = 0; i < subsets.size(); ++i)
+	{
+		if (lowest[i] == 0)
+			continue;
+		auto first = indices.begin() + subsets[i].IndexStart;
+		subsets[i].VertexBase += lowest[i];
+		for (auto index = first; index != first + subsets[i].IndexCount; ++index)
+			*index -= lowest[i];
+	}
+	return true;
+}
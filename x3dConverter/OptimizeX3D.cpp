@@ -0,0 +1,399 @@
+// Standalone .x3d optimizer. Reads a v1 or v2 .x3d file, welds duplicate vertices,
+// reorders triangles and vertices for the vertex cache and writes the result as v2.
+// It doesn't need the FBX SDK: build it together with MeshOptimizer.cpp and
+// AnimationCompressor.cpp.
+//
+// Usage: OptimizeX3D input.x3d output.x3d [-skinned] [-compress-clips]
+// v1 files don't record whether they are skinned, so pass -skinned for them.
+// -compress-clips replaces the animation clips of a skinned mesh with compressed ones.
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <sstream>
+#include <vector>
+#include "AnimationCompressor.h"
+#include "MeshOptimizer.h"
+#include "X3dFormat.h"
+
+using namespace std;
+
+struct Subset
+{
+	int MtlIndex;
+	int VertexBase;
+	int IndexStart;
+	int IndexCount;
+};
+
+// Same layout as the engine's PosNormalTexTan
+struct StaticVertex
+{
+	float Pos[3];
+	float Normal[3];
+	float Tex[2];
+	float TangentU[3];
+};
+
+// Same layout as the engine's PosNormalTexTanSkinned
+struct SkinnedVertex
+{
+	float Pos[3];
+	float Normal[3];
+	float Tex[2];
+	float TangentU[3];
+	float Weights[3];
+	unsigned char BoneIndices[4];
+};
+
+// Materials, bone offsets and animation clips are carried through as raw bytes.
+struct X3dModel
+{
+	X3dModel() : Skinned(false), MaterialCount(0), BoneCount(0), ClipCount(0), ClipsCompressed(false)
+	{}
+
+	bool Skinned;
+	int MaterialCount;
+	string Materials;
+	vector<Subset> Subsets;
+	vector<StaticVertex> Vertices;
+	vector<SkinnedVertex> SkinnedVertices;
+	vector<int> Indices;
+	int BoneCount;
+	string BoneOffsets;
+	int ClipCount;
+	string Animations;
+	bool ClipsCompressed;		// Animations holds X3dCompressedClips
+};
+
+#pragma region Declaration
+class ByteReader;
+void ReadX3D(const char* filename, bool skinned, X3dModel& model);
+void ReadX3DV1(ByteReader& reader, X3dModel& model);
+void ReadX3DV2(const string& file, X3dModel& model);
+void WriteX3D(const char* filename, X3dModel& model);
+void CompressClips(X3dModel& model);
+void PrintStats(const char* label, const MeshStats& stats);
+#pragma endregion
+
+class ByteReader
+{
+public:
+	explicit ByteReader(const string& data) : m_data(data), m_pos(0)
+	{}
+
+	void Read(void* dest, size_t size)
+	{
+		if (size > m_data.size() - m_pos)
+			throw runtime_error("Unexpected end of file!");
+		memcpy(dest, m_data.data() + m_pos, size);
+		m_pos += size;
+	}
+	int ReadInt()
+	{
+		int value;
+		Read(&value, sizeof(int));
+		return value;
+	}
+	string ReadBytes(size_t size)
+	{
+		string result(size, '\0');
+		if (size)
+			Read(&result[0], size);
+		return result;
+	}
+	string Slice(size_t start, size_t end)const { return m_data.substr(start, end - start); }
+	size_t GetPosition()const { return m_pos; }
+	size_t GetRemaining()const { return m_data.size() - m_pos; }
+
+private:
+	const string& m_data;
+	size_t m_pos;
+};
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		cout << "Usage: OptimizeX3D input.x3d output.x3d [-skinned] [-compress-clips]" << endl;
+		return -1;
+	}
+	bool skinned = false;
+	bool compressClips = false;
+	for (int i = 3; i < argc; ++i)
+	{
+		skinned = skinned || string(argv[i]) == "-skinned";
+		compressClips = compressClips || string(argv[i]) == "-compress-clips";
+	}
+
+	try
+	{
+		X3dModel model;
+		ReadX3D(argv[1], skinned, model);
+
+		MeshStats before, after;
+		if (model.Skinned)
+			OptimizeMesh(model.SkinnedVertices, model.Indices, model.Subsets, &before, &after);
+		else
+			OptimizeMesh(model.Vertices, model.Indices, model.Subsets, &before, &after);
+
+		PrintStats("Before", before);
+		PrintStats("After", after);
+
+		if (compressClips && model.Skinned && !model.ClipsCompressed)
+			CompressClips(model);
+
+		WriteX3D(argv[2], model);
+	}
+	catch (exception& e)
+	{
+		cout << "Error: " << e.what() << endl;
+		return -1;
+	}
+
+	return 0;
+}
+
+void ReadX3D(const char* filename, bool skinned, X3dModel& model)
+{
+	ifstream fin(filename, ios::binary);
+	if (!fin)
+		throw runtime_error("Can not open the input file!");
+	string file((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
+
+	X3dHeader header = {};
+	if (file.size() >= sizeof(X3dHeader))
+		memcpy(&header, file.data(), sizeof(X3dHeader));
+
+	if (header.Magic == X3dMagic)
+	{
+		ReadX3DV2(file, model);
+	}
+	else
+	{
+		model.Skinned = skinned;
+		ByteReader reader(file);
+		ReadX3DV1(reader, model);
+	}
+}
+
+void ReadX3DV1(ByteReader& reader, X3dModel& model)
+{
+	model.MaterialCount = reader.ReadInt();
+	int numSubsets = reader.ReadInt();
+	int numVertices = reader.ReadInt();
+	int numIndices = reader.ReadInt();
+	if (model.Skinned)
+	{
+		model.BoneCount = reader.ReadInt();
+		model.ClipCount = reader.ReadInt();
+	}
+
+	// Material: 13 floats, the effect and two length prefixed strings
+	size_t materialStart = reader.GetPosition();
+	for (int i = 0; i < model.MaterialCount; ++i)
+	{
+		reader.ReadBytes(13 * sizeof(float) + sizeof(int));
+		reader.ReadBytes(reader.ReadInt());
+		reader.ReadBytes(reader.ReadInt());
+	}
+	model.Materials = reader.Slice(materialStart, reader.GetPosition());
+
+	// SubSets
+	model.Subsets.resize(numSubsets);
+	if (numSubsets)
+		reader.Read(&model.Subsets[0], numSubsets * sizeof(Subset));
+
+	// Vertices: v1 stores the tangent before the texture coordinates and
+	// skinned vertices with four int bone indices and four weights.
+	if (model.Skinned)
+	{
+		model.SkinnedVertices.resize(numVertices);
+		for (auto& item : model.SkinnedVertices)
+		{
+			int boneIndices[4];
+			float weights[4];
+			reader.Read(item.Pos, sizeof(item.Pos));
+			reader.Read(item.Normal, sizeof(item.Normal));
+			reader.Read(item.TangentU, sizeof(item.TangentU));
+			reader.Read(item.Tex, sizeof(item.Tex));
+			reader.Read(boneIndices, sizeof(boneIndices));
+			reader.Read(weights, sizeof(weights));
+			for (int i = 0; i < 3; ++i)
+				item.Weights[i] = weights[i];
+			for (int i = 0; i < 4; ++i)
+				item.BoneIndices[i] = (unsigned char)boneIndices[i];
+		}
+	}
+	else
+	{
+		model.Vertices.resize(numVertices);
+		for (auto& item : model.Vertices)
+		{
+			reader.Read(item.Pos, sizeof(item.Pos));
+			reader.Read(item.Normal, sizeof(item.Normal));
+			reader.Read(item.TangentU, sizeof(item.TangentU));
+			reader.Read(item.Tex, sizeof(item.Tex));
+		}
+	}
+
+	// Indices
+	model.Indices.resize(numIndices);
+	if (numIndices)
+		reader.Read(&model.Indices[0], numIndices * sizeof(int));
+
+	if (model.Skinned)
+	{
+		model.BoneOffsets = reader.ReadBytes(model.BoneCount * 16 * sizeof(float));
+		model.Animations = reader.ReadBytes(reader.GetRemaining());
+	}
+}
+
+void ReadX3DV2(const string& file, X3dModel& model)
+{
+	ByteReader reader(file);
+	X3dHeader header;
+	reader.Read(&header, sizeof(X3dHeader));
+	if (header.Version != X3dVersion)
+		throw runtime_error("Unsupported .x3d version!");
+	model.Skinned = (header.Flags & X3dSkinnedFlag) != 0;
+
+	vector<X3dSection> sections(header.SectionCount);
+	if (header.SectionCount)
+		reader.Read(&sections[0], header.SectionCount * sizeof(X3dSection));
+
+	for (auto& section : sections)
+	{
+		if ((size_t)section.Offset + section.Size > file.size())
+			throw runtime_error("Corrupted .x3d section!");
+		string data = file.substr(section.Offset, section.Size);
+
+		switch (section.Id)
+		{
+		case X3dMaterials:
+			model.MaterialCount = section.Count;
+			model.Materials = data;
+			break;
+		case X3dSubsets:
+			model.Subsets.resize(section.Count);
+			memcpy(model.Subsets.data(), data.data(), min(data.size(), section.Count * sizeof(Subset)));
+			break;
+		case X3dVertices:
+			model.Vertices.resize(section.Count);
+			memcpy(model.Vertices.data(), data.data(), min(data.size(), section.Count * sizeof(StaticVertex)));
+			break;
+		case X3dSkinnedVertices:
+			model.SkinnedVertices.resize(section.Count);
+			memcpy(model.SkinnedVertices.data(), data.data(), min(data.size(), section.Count * sizeof(SkinnedVertex)));
+			break;
+		case X3dIndices:
+			model.Indices.resize(section.Count);
+			memcpy(model.Indices.data(), data.data(), min(data.size(), section.Count * sizeof(int)));
+			break;
+		case X3dIndices16:
+			model.Indices.resize(section.Count);
+			for (unsigned int i = 0; i < section.Count && 2 * i + 1 < data.size(); ++i)
+				model.Indices[i] = (unsigned char)data[2 * i] | ((unsigned char)data[2 * i + 1] << 8);
+			break;
+		case X3dBoneOffsets:
+			model.BoneCount = section.Count;
+			model.BoneOffsets = data;
+			break;
+		case X3dAnimationClips:
+			model.ClipCount = section.Count;
+			model.Animations = data;
+			break;
+		case X3dCompressedClips:
+			model.ClipCount = section.Count;
+			model.Animations = data;
+			model.ClipsCompressed = true;
+			break;
+		}
+	}
+}
+
+void WriteX3D(const char* filename, X3dModel& model)
+{
+	vector<X3dSection> table;
+	vector<string> data;
+
+	table.push_back({ X3dMaterials, (unsigned int)model.MaterialCount, 0, 0 });
+	data.push_back(model.Materials);
+
+	// Deciding the index format may move subsets, so they are written after it.
+	bool use16BitIndices = Use16BitIndices(model.Subsets, model.Indices);
+	table.push_back({ X3dSubsets, (unsigned int)model.Subsets.size(), 0, 0 });
+	data.push_back(string((char*)model.Subsets.data(), model.Subsets.size() * sizeof(Subset)));
+
+	int vertexCount;
+	if (model.Skinned)
+	{
+		vertexCount = model.SkinnedVertices.size();
+		table.push_back({ X3dSkinnedVertices, (unsigned int)vertexCount, 0, 0 });
+		data.push_back(string((char*)model.SkinnedVertices.data(), vertexCount * sizeof(SkinnedVertex)));
+	}
+	else
+	{
+		vertexCount = model.Vertices.size();
+		table.push_back({ X3dVertices, (unsigned int)vertexCount, 0, 0 });
+		data.push_back(string((char*)model.Vertices.data(), vertexCount * sizeof(StaticVertex)));
+	}
+
+	if (use16BitIndices)
+	{
+		vector<unsigned short> indices16(model.Indices.begin(), model.Indices.end());
+		table.push_back({ X3dIndices16, (unsigned int)indices16.size(), 0, 0 });
+		data.push_back(string((char*)indices16.data(), indices16.size() * sizeof(unsigned short)));
+		cout << "Using 16 bit indices" << endl;
+	}
+	else
+	{
+		table.push_back({ X3dIndices, (unsigned int)model.Indices.size(), 0, 0 });
+		data.push_back(string((char*)model.Indices.data(), model.Indices.size() * sizeof(int)));
+	}
+
+	if (model.Skinned)
+	{
+		table.push_back({ X3dBoneOffsets, (unsigned int)model.BoneCount, 0, 0 });
+		data.push_back(model.BoneOffsets);
+		table.push_back({ model.ClipsCompressed ? X3dCompressedClips : X3dAnimationClips, (unsigned int)model.ClipCount, 0, 0 });
+		data.push_back(model.Animations);
+	}
+
+	WriteX3DSections(filename, model.Skinned ? X3dSkinnedFlag : 0, table, data);
+}
+
+void CompressClips(X3dModel& model)
+{
+	ByteReader reader(model.Animations);
+	string compressed;
+	for (int clipIndex = 0; clipIndex < model.ClipCount; ++clipIndex)
+	{
+		string name = reader.ReadBytes(reader.ReadInt());
+		vector<vector<X3dKeyframe>> bones(model.BoneCount);
+		for (auto& bone : bones)
+		{
+			bone.resize(reader.ReadInt());
+			if (!bone.empty())
+				reader.Read(&bone[0], bone.size() * sizeof(X3dKeyframe));
+		}
+
+		vector<BoneCompressionStats> stats;
+		CompressAnimationClip(name, bones, AnimationTolerance(), compressed, &stats);
+		PrintClipStats(cout, name, stats);
+	}
+
+	cout << "Animation clips: " << model.Animations.size() << " -> " << compressed.size() << " bytes" << endl;
+	model.Animations = compressed;
+	model.ClipsCompressed = true;
+}
+
+void PrintStats(const char* label, const MeshStats& stats)
+{
+	cout << label << ": " << stats.VertexCount << " vertices, " << stats.TriangleCount << " triangles, "
+		<< "ACMR " << stats.ACMR() << ", ATVR " << stats.ATVR() << endl;
+}
@@ -0,0 +1,193 @@
+// Standalone heightmap tiler. Reads a RAW heightmap, smooths it the same way the
+// engine smooths RAW heightmaps and writes it as a tiled .tht file, which the
+// engine keeps memory mapped and decodes tile by tile around the camera.
+// It needs no other file of the converter.
+//
+// Usage: TileHeightmap input.raw output.tht width height heightScale [-16] [-tile N]
+// The input holds width x height 8-bit samples, or little endian 16-bit samples
+// with -16. Heights are sample / maxSample * heightScale. Tiles are N x N samples,
+// 64 by default, so that every terrain patch gets the bounds of a single tile.
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// .tht layout, must match MetroGame/Components/TiledHeightmap.h.
+struct TiledHeightmapHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int TileSize;
+	unsigned int Reserved;
+	float MinHeight;
+	float HeightStep;
+};
+
+const unsigned int TiledHeightmapMagic = 0x31544854;	// "THT1"
+const unsigned int TiledHeightmapVersion = 1;
+const unsigned int TiledHeightmapAlignment = 4096;
+
+struct Heightmap
+{
+	unsigned int Width;
+	unsigned int Height;
+	vector<unsigned short> Samples;
+
+	// Average of the sample and its neighbors inside the map, as Terrain::Smooth.
+	float Smoothed(unsigned int i, unsigned int j)const
+	{
+		unsigned int i0 = i == 0 ? 0 : i - 1, i1 = min(i + 1, Height - 1);
+		unsigned int j0 = j == 0 ? 0 : j - 1, j1 = min(j + 1, Width - 1);
+		unsigned int sum = 0;
+		for (unsigned int m = i0; m <= i1; ++m)
+			for (unsigned int n = j0; n <= j1; ++n)
+				sum += Samples[size_t(m) * Width + n];
+		return (float)sum / ((i1 - i0 + 1) * (j1 - j0 + 1));
+	}
+};
+
+void ReadRaw(const string& filename, bool wide, Heightmap& map)
+{
+	ifstream fin(filename, ios::binary);
+	if (!fin)
+		throw runtime_error("Can not open " + filename);
+
+	size_t count = size_t(map.Width) * map.Height;
+	map.Samples.resize(count);
+	if (wide)
+	{
+		fin.read(reinterpret_cast<char*>(map.Samples.data()), count * sizeof(unsigned short));
+	}
+	else
+	{
+		vector<unsigned char> bytes(count);
+		fin.read(reinterpret_cast<char*>(bytes.data()), count);
+		copy(bytes.begin(), bytes.end(), map.Samples.begin());
+	}
+	if (!fin || fin.peek() != EOF)
+		throw runtime_error("The size of " + filename + " doesn't match width x height");
+}
+
+void WriteTiles(const string& filename, const Heightmap& map, float heightScale, unsigned int tileSize, bool wide)
+{
+	unsigned int tilesX = (map.Width + tileSize - 1) / tileSize;
+	unsigned int tilesY = (map.Height + tileSize - 1) / tileSize;
+
+	// Smoothed heights stay within the range of the samples.
+	auto range = minmax_element(map.Samples.begin(), map.Samples.end());
+	float unit = heightScale / (wide ? 65535.0f : 255.0f);
+	TiledHeightmapHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Magic = TiledHeightmapMagic;
+	header.Version = TiledHeightmapVersion;
+	header.Width = map.Width;
+	header.Height = map.Height;
+	header.TileSize = tileSize;
+	header.MinHeight = *range.first * unit;
+	header.HeightStep = (*range.second - *range.first) * unit / 65535.0f;
+	float invStep = header.HeightStep > 0.0f ? 1.0f / header.HeightStep : 0.0f;
+
+	ofstream fout(filename, ios::binary);
+	if (!fout)
+		throw runtime_error("Can not create " + filename);
+	size_t tilesOffset = sizeof(header) + size_t(tilesX) * tilesY * 2 * sizeof(float);
+	tilesOffset = (tilesOffset + TiledHeightmapAlignment - 1) / TiledHeightmapAlignment * TiledHeightmapAlignment;
+	fout.seekp(tilesOffset);
+
+	// A band of tiles at a time, with the first row of the next band for the bounds.
+	vector<float> bounds;
+	vector<unsigned short> band(size_t(tileSize + 1) * map.Width);
+	vector<unsigned short> tile(size_t(tileSize) * tileSize);
+	for (unsigned int ty = 0; ty < tilesY; ++ty)
+	{
+		unsigned int row0 = ty * tileSize;
+		unsigned int rows = min(tileSize + 1, map.Height - row0);
+		for (unsigned int i = 0; i < rows; ++i)
+		{
+			for (unsigned int j = 0; j < map.Width; ++j)
+			{
+				float q = (map.Smoothed(row0 + i, j) * unit - header.MinHeight) * invStep + 0.5f;
+				band[size_t(i) * map.Width + j] = (unsigned short)min(q, 65535.0f);
+			}
+		}
+
+		for (unsigned int tx = 0; tx < tilesX; ++tx)
+		{
+			unsigned int col0 = tx * tileSize;
+			unsigned int cols = min(tileSize + 1, map.Width - col0);
+			unsigned short minQ = 65535, maxQ = 0;
+			for (unsigned int i = 0; i < rows; ++i)
+			{
+				for (unsigned int j = 0; j < cols; ++j)
+				{
+					minQ = min(minQ, band[size_t(i) * map.Width + col0 + j]);
+					maxQ = max(maxQ, band[size_t(i) * map.Width + col0 + j]);
+				}
+			}
+			bounds.push_back(header.MinHeight + minQ * header.HeightStep);
+			bounds.push_back(header.MinHeight + maxQ * header.HeightStep);
+
+			// Samples past the edge repeat the last one.
+			for (unsigned int i = 0; i < tileSize; ++i)
+			{
+				const unsigned short* src = &band[size_t(min(i, rows - 1)) * map.Width];
+				for (unsigned int j = 0; j < tileSize; ++j)
+					tile[size_t(i) * tileSize + j] = src[min(col0 + j, map.Width - 1)];
+			}
+			fout.write(reinterpret_cast<const char*>(tile.data()), tile.size() * sizeof(unsigned short));
+		}
+	}
+
+	fout.seekp(0);
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fout.write(reinterpret_cast<const char*>(bounds.data()), bounds.size() * sizeof(float));
+	if (!fout)
+		throw runtime_error("Can not write " + filename);
+
+	cout << map.Width << " x " << map.Height << " samples in " << tilesX << " x " << tilesY << " tiles of "
+		<< tileSize << ", heights [" << header.MinHeight << ", " << header.MinHeight + 65535 * header.HeightStep
+		<< "] in steps of " << header.HeightStep << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 6)
+	{
+		cout << "Usage: TileHeightmap input.raw output.tht width height heightScale [-16] [-tile N]" << endl;
+		return -1;
+	}
+	bool wide = false;
+	unsigned int tileSize = 64;
+	for (int i = 6; i < argc; ++i)
+	{
+		wide = wide || string(argv[i]) == "-16";
+		if (string(argv[i]) == "-tile" && i + 1 < argc)
+			tileSize = (unsigned int)stoul(argv[++i]);
+	}
+
+	try
+	{
+		Heightmap map;
+		map.Width = (unsigned int)stoul(argv[3]);
+		map.Height = (unsigned int)stoul(argv[4]);
+		if (map.Width < 2 || map.Height < 2 || tileSize == 0)
+			throw runtime_error("Invalid size");
+		ReadRaw(argv[1], wide, map);
+		WriteTiles(argv[2], map, stof(argv[5]), tileSize, wide);
+	}
+	catch (exception& e)
+	{
+		cout << "Error: " << e.what() << endl;
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// .x3d v2 file layout, must match MetroGame/Components/X3DLoader.h.
+struct X3dHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned int Flags;
+	unsigned int SectionCount;
+};
+
+struct X3dSection
+{
+	unsigned int Id;
+	unsigned int Count;
+	unsigned int Offset;
+	unsigned int Size;
+};
+
+enum X3dSectionId
+{
+	X3dMaterials,
+	X3dSubsets,
+	X3dVertices,
+	X3dSkinnedVertices,
+	X3dIndices,
+	X3dBoneOffsets,
+	X3dAnimationClips,
+	X3dIndices16,
+	X3dCompressedClips
+};
+
+const unsigned int X3dMagic = 0x32443358;	// "X3D2"
+const unsigned int X3dVersion = 2;
+const unsigned int X3dSkinnedFlag = 0x1;
+const unsigned int X3dSectionAlignment = 16;
+
+// Keyframe of the X3dAnimationClips section.
+struct X3dKeyframe
+{
+	float TimePos;
+	float Translation[3];
+	float Scale[3];
+	float RotationQuat[4];
+};
+
+// X3dCompressedClips: per clip the length prefixed name, then for every bone an
+// X3dCompressedBone followed by its unsigned shorts:
+//   KeyCount times, quantized over [StartTime, StartTime + Duration]
+//   rotations, 3 per key (1 key if constant), smallest three with 15 bits each;
+//     the index of the dropped component is stored in the top bits of the first two
+//   translations, 3 per key quantized over [Min, Min + Extent], none if constant
+//   scales, the same as translations
+// A constant translation or scale is stored exactly in its Min.
+struct X3dCompressedBone
+{
+	float StartTime;
+	float Duration;
+	unsigned int Flags;
+	unsigned int KeyCount;
+	float TranslationMin[3];
+	float TranslationExtent[3];
+	float ScaleMin[3];
+	float ScaleExtent[3];
+};
+
+const unsigned int X3dConstantRotation = 0x1;
+const unsigned int X3dConstantTranslation = 0x2;
+const unsigned int X3dConstantScale = 0x4;
+
+// Writes the header, the offset table and every section on a 16 byte boundary.
+// table[i] only needs Id and Count, offsets and sizes are filled in from data[i].
+inline void WriteX3DSections(const char* filename, unsigned int flags, const std::vector<X3dSection>& table, const std::vector<std::string>& data)
+{
+	std::ofstream fout(filename, std::ios::binary);
+
+	X3dHeader header = { X3dMagic, X3dVersion, flags, (unsigned int)table.size() };
+	fout.write((char*)&header, sizeof(X3dHeader));
+
+	// Lay out the sections on 16 byte boundaries after the table.
+	std::vector<X3dSection> sections = table;
+	unsigned int offset = sizeof(X3dHeader) + sections.size() * sizeof(X3dSection);
+	for (size_t i = 0; i < sections.size(); ++i)
+	{
+		offset = (offset + X3dSectionAlignment - 1) & ~(X3dSectionAlignment - 1);
+		sections[i].Offset = offset;
+		sections[i].Size = data[i].size();
+		offset += sections[i].Size;
+	}
+	fout.write((char*)sections.data(), sections.size() * sizeof(X3dSection));
+
+	unsigned int pos = sizeof(X3dHeader) + sections.size() * sizeof(X3dSection);
+	for (size_t i = 0; i < sections.size(); ++i)
+	{
+		const char padding[X3dSectionAlignment] = { 0 };
+		fout.write(padding, sections[i].Offset - pos);
+		fout.write(data[i].data(), data[i].size());
+		pos = sections[i].Offset + sections[i].Size;
+	}
+	fout.flush();
+	fout.close();
+}